@@ -0,0 +1,628 @@
+/*
+ * BenchAdmission.cpp - Connection admission: rules, cost per check and a
+ * reconnect storm against a local RealmServer
+ *
+ * Three parts:
+ *   rules:  the verdicts an Admission gives on a made-up clock: an
+ *           address's burst, its ban after hammering on and the ban's
+ *           expiry, refill, a subnet's burst, the server limit, manual
+ *           bans and a table too small for the addresses seen;
+ *   checks: nanoseconds per ADMIT_Check over a large address population,
+ *           against a Fog-style hack list (a ban list searched linearly
+ *           under a lock) of maxBans entries;
+ *   storm:  legitimate clients, each from its own 127.1.x.y address, all
+ *           connect and log on at once and retry with backoff when turned
+ *           away, while abusers from 127.2.0.x reconnect every couple of
+ *           milliseconds without ever logging on. Run once without and
+ *           once with admission control.
+ *
+ * Verification:
+ *   - rules: every verdict as described above;
+ *   - storm, both runs: every legitimate client logs on;
+ *   - storm with admission: each abuser is banned (and nobody else), and
+ *     the server takes no more abuser connections than their bursts and
+ *     refill allow.
+ *
+ * Usage: bench_admission [legitimate clients] [abusers]
+ */
+
+#include "../Realm/RealmServer.hpp"
+
+#include "../Net/Admission.hpp"
+#include "../Net/EventLoop.hpp"
+#include "../Net/NetBuffer.hpp"
+#include "../Net/RealmProtocol.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define SERVER_THREADS 2
+#define RULES_START_MS 1000000
+#define CHECK_POPULATION 200000
+#define CHECKS_PER_THREAD 1000000
+#define HACK_LIST_ENTRIES 4096
+#define STORM_IP_RATE 2
+#define STORM_IP_BURST 4
+#define STORM_BAN_AFTER 8
+#define ABUSE_INTERVAL_MS 2
+#define FIRST_BACKOFF_MS 50
+#define MAX_BACKOFF_MS 800
+#define MIN_STORM_MS 1000
+#define STORM_TIMEOUT_MS 60000
+
+static DWORD MakeAddress(BYTE a, BYTE b, BYTE c, BYTE d)
+{
+    DWORD address;
+    BYTE *pBytes = (BYTE *)&address;
+    pBytes[0] = a;
+    pBytes[1] = b;
+    pBytes[2] = c;
+    pBytes[3] = d;
+    return address;
+}
+
+static DWORD NextRandom(DWORD *pState)
+{
+    DWORD x = *pState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *pState = x;
+}
+
+// =============================================================================
+// RULES
+// =============================================================================
+
+static BOOL Expect(const char *szWhat, BYTE verdict, BYTE expected)
+{
+    if (verdict != expected)
+    {
+        printf("  %s: %s, expected %s\n", szWhat, ADMIT_VerdictName(verdict), ADMIT_VerdictName(expected));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// count checks of one address at one time, all with the same verdict
+static BOOL ExpectRun(Admission *pAdmission, const char *szWhat, DWORD address, DWORD count, uint64_t nowMs,
+                      BYTE expected)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        if (!Expect(szWhat, ADMIT_Check(pAdmission, address, nowMs), expected))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static BOOL CheckAddressRules(void)
+{
+    AdmissionDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.ipRate = 2;
+    desc.ipBurst = 8;
+    desc.banAfter = 16;
+    desc.banSeconds = 300;
+    Admission *pAdmission = ADMIT_Create(&desc);
+    if (!pAdmission)
+    {
+        return FALSE;
+    }
+    uint64_t t = RULES_START_MS;
+    BOOL ok = TRUE;
+
+    // Burst, then refusals that count toward a ban, then the ban
+    DWORD hammer = MakeAddress(10, 0, 0, 1);
+    ok &= ExpectRun(pAdmission, "burst", hammer, 8, t, ADMIT_OK);
+    ok &= ExpectRun(pAdmission, "past the burst", hammer, 15, t, ADMIT_IP_RATE);
+    ok &= Expect("hammering on", ADMIT_Check(pAdmission, hammer, t), ADMIT_BANNED);
+    ok &= ADMIT_IsBanned(pAdmission, hammer, t + 1000);
+    ok &= Expect("during the ban", ADMIT_Check(pAdmission, hammer, t + 299000), ADMIT_BANNED);
+    ok &= Expect("after the ban", ADMIT_Check(pAdmission, hammer, t + 301000), ADMIT_OK);
+
+    // Refill: one connection per 1/ipRate seconds once the burst is spent
+    DWORD steady = MakeAddress(10, 0, 0, 2);
+    ok &= ExpectRun(pAdmission, "burst", steady, 8, t, ADMIT_OK);
+    ok &= Expect("refilled", ADMIT_Check(pAdmission, steady, t + 500), ADMIT_OK);
+    ok &= Expect("not yet refilled", ADMIT_Check(pAdmission, steady, t + 500), ADMIT_IP_RATE);
+
+    // Manual bans
+    DWORD banned = MakeAddress(20, 0, 0, 1);
+    ok &= ADMIT_Ban(pAdmission, banned, 60, t);
+    ok &= ADMIT_IsBanned(pAdmission, banned, t + 59000) && !ADMIT_IsBanned(pAdmission, banned, t + 61000);
+    ok &= Expect("banned by hand", ADMIT_Check(pAdmission, banned, t), ADMIT_BANNED);
+    ADMIT_Unban(pAdmission, banned);
+    ok &= !ADMIT_IsBanned(pAdmission, banned, t);
+    ok &= Expect("unbanned", ADMIT_Check(pAdmission, banned, t), ADMIT_OK);
+
+    AdmissionStats stats;
+    ADMIT_GetStats(pAdmission, t, &stats);
+    ok &= stats.bans == 2 && stats.activeBans == 1 && stats.admitted == 19 && stats.refused[ADMIT_IP_RATE] == 16 &&
+          stats.refused[ADMIT_BANNED] == 3 && stats.checked == 38;
+    ADMIT_Destroy(pAdmission);
+    return ok;
+}
+
+static BOOL CheckSharedRules(void)
+{
+    AdmissionDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.subnetRate = 50;
+    desc.subnetBurst = 200;
+    desc.globalRate = 1000;
+    desc.globalBurst = 300;
+    Admission *pAdmission = ADMIT_Create(&desc);
+    if (!pAdmission)
+    {
+        return FALSE;
+    }
+    uint64_t t = RULES_START_MS;
+    BOOL ok = TRUE;
+
+    // A /24's burst, spread over its addresses
+    for (DWORD i = 0; i < 200; i++)
+    {
+        ok &= Expect("subnet burst", ADMIT_Check(pAdmission, MakeAddress(10, 1, 0, (BYTE)(i + 1)), t), ADMIT_OK);
+    }
+    ok &= Expect("subnet spent", ADMIT_Check(pAdmission, MakeAddress(10, 1, 0, 201), t), ADMIT_SUBNET_RATE);
+    ok &= Expect("next subnet", ADMIT_Check(pAdmission, MakeAddress(10, 1, 1, 1), t), ADMIT_OK);
+    // Refused by the subnet, an address keeps its own allowance: no ban
+    ok &= ExpectRun(pAdmission, "held back by the subnet", MakeAddress(10, 1, 0, 202), 40, t, ADMIT_SUBNET_RATE);
+    ok &= Expect("subnet refilled", ADMIT_Check(pAdmission, MakeAddress(10, 1, 0, 202), t + 20), ADMIT_OK);
+
+    // What is left of the server's burst after the 202 connections above,
+    // with 20 ms of refill
+    for (DWORD i = 0; i < 118; i++)
+    {
+        ok &= Expect("server burst", ADMIT_Check(pAdmission, MakeAddress(10, 2, (BYTE)i, 1), t + 20), ADMIT_OK);
+    }
+    DWORD waiting = MakeAddress(10, 3, 0, 1);
+    ok &= ExpectRun(pAdmission, "server spent", waiting, 40, t + 20, ADMIT_GLOBAL_RATE);
+    ok &= Expect("server refilled", ADMIT_Check(pAdmission, waiting, t + 21), ADMIT_OK);
+    ok &= Expect("server spent again", ADMIT_Check(pAdmission, MakeAddress(10, 3, 0, 2), t + 21), ADMIT_GLOBAL_RATE);
+    ADMIT_Destroy(pAdmission);
+
+    // More addresses than the table holds at once: refused, never let in
+    // untracked, until their buckets refill and the entries are taken over
+    memset(&desc, 0, sizeof(desc));
+    desc.trackedAddresses = 64;
+    desc.ipRate = 1;
+    desc.ipBurst = 1;
+    desc.subnetRate = 10000;
+    desc.subnetBurst = 10000;
+    pAdmission = ADMIT_Create(&desc);
+    if (!pAdmission)
+    {
+        return FALSE;
+    }
+    DWORD admitted = 0, full = 0, firstFull = 0;
+    for (DWORD i = 0; i < 256; i++)
+    {
+        DWORD address = MakeAddress(10, 4, 0, (BYTE)i);
+        BYTE verdict = ADMIT_Check(pAdmission, address, t);
+        admitted += verdict == ADMIT_OK;
+        if (verdict == ADMIT_TABLE_FULL && !full++)
+        {
+            firstFull = address;
+        }
+    }
+    ok &= admitted <= 64 && full == 256 - admitted && full > 0;
+    ok &= Expect("entries taken over", ADMIT_Check(pAdmission, firstFull, t + 1000), ADMIT_OK);
+    ADMIT_Destroy(pAdmission);
+    return ok;
+}
+
+// =============================================================================
+// CHECKS
+// =============================================================================
+
+// Fog's hack list, as far as an accept is concerned
+typedef struct HackList
+{
+    std::mutex lock;
+    std::vector<DWORD> banned;
+} HackList;
+
+static BOOL HackListAdmits(HackList *pList, DWORD address)
+{
+    std::lock_guard<std::mutex> lock(pList->lock);
+    for (size_t i = 0; i < pList->banned.size(); i++)
+    {
+        if (pList->banned[i] == address)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void CheckThread(Admission *pAdmission, HackList *pList, const DWORD *pAddresses, DWORD seed,
+                        DWORD *pAdmitted)
+{
+    DWORD state = seed;
+    DWORD admitted = 0;
+    for (DWORD i = 0; i < CHECKS_PER_THREAD; i++)
+    {
+        DWORD address = pAddresses[NextRandom(&state) % CHECK_POPULATION];
+        if (pAdmission)
+        {
+            // 100 checks per millisecond of the made-up clock
+            admitted += ADMIT_Check(pAdmission, address, RULES_START_MS + i / 100) == ADMIT_OK;
+        }
+        else
+        {
+            admitted += HackListAdmits(pList, address);
+        }
+    }
+    *pAdmitted = admitted;
+}
+
+// Wall-clock nanoseconds per check, all threads together
+static double TimeChecks(Admission *pAdmission, HackList *pList, const DWORD *pAddresses, DWORD threads)
+{
+    std::vector<std::thread> workers;
+    std::vector<DWORD> admitted(threads);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < threads; i++)
+    {
+        workers.push_back(std::thread(CheckThread, pAdmission, pList, pAddresses, 0x9E3779B9u + i, &admitted[i]));
+    }
+    for (DWORD i = 0; i < threads; i++)
+    {
+        workers[i].join();
+    }
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                             start)
+                    .count();
+    return ns / ((double)CHECKS_PER_THREAD * threads);
+}
+
+static void RunChecks(void)
+{
+    std::vector<DWORD> addresses(CHECK_POPULATION);
+    DWORD state = 12345;
+    for (DWORD i = 0; i < CHECK_POPULATION; i++)
+    {
+        addresses[i] = NextRandom(&state) | 1;
+    }
+    HackList list;
+    for (DWORD i = 0; i < HACK_LIST_ENTRIES; i++)
+    {
+        list.banned.push_back(MakeAddress(192, 0, (BYTE)(i >> 8), (BYTE)i));
+    }
+
+    printf("checks: %u addresses, %u checks per thread, %u hardware threads\n", CHECK_POPULATION,
+           CHECKS_PER_THREAD, std::thread::hardware_concurrency());
+    DWORD threadCounts[] = {1, 4};
+    for (DWORD i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++)
+    {
+        AdmissionDesc desc;
+        memset(&desc, 0, sizeof(desc));
+        desc.trackedAddresses = 1 << 18;
+        desc.maxBans = HACK_LIST_ENTRIES;
+        Admission *pAdmission = ADMIT_Create(&desc);
+        if (!pAdmission)
+        {
+            return;
+        }
+        double admissionNs = TimeChecks(pAdmission, NULL, &addresses[0], threadCounts[i]);
+        double listNs = TimeChecks(NULL, &list, &addresses[0], threadCounts[i]);
+        printf("  %u thread%s: admission %.1f ns per check, hack list of %u bans %.1f ns (%.1fx)\n",
+               threadCounts[i], threadCounts[i] == 1 ? " " : "s", admissionNs, HACK_LIST_ENTRIES, listNs,
+               admissionNs > 0.0 ? listNs / admissionNs : 0.0);
+        ADMIT_Destroy(pAdmission);
+    }
+}
+
+// =============================================================================
+// STORM
+// =============================================================================
+
+enum
+{
+    CLIENT_WAITING,
+    CLIENT_CONNECTING,
+    CLIENT_LOGGING_ON,
+    CLIENT_DONE
+};
+
+typedef struct StormRun StormRun;
+
+typedef struct StormClient
+{
+    StormRun *pRun;
+    BOOL abuser;
+    DWORD address;
+    char szAccount[REALM_MAX_NAME];
+    int state;
+    NetSocket s;
+    DWORD loopId;
+    uint64_t retryAtMs;
+    DWORD backoffMs;
+    BYTE in[64];
+    DWORD inSize;
+} StormClient;
+
+struct StormRun
+{
+    EventLoop *pLoop;
+    WORD port;
+    DWORD random;
+    DWORD loggedOn;
+    uint64_t lastLogonMs;
+    uint64_t legitAttempts;
+    uint64_t abuseAttempts;
+};
+
+static void Disconnect(StormClient *pClient, uint64_t retryAtMs)
+{
+    EVLOOP_Remove(pClient->pRun->pLoop, pClient->loopId);
+    if (pClient->abuser)
+    {
+        NET_Reset(pClient->s);
+    }
+    else
+    {
+        NET_Close(pClient->s);
+    }
+    pClient->s = NET_INVALID_SOCKET;
+    pClient->state = CLIENT_WAITING;
+    pClient->retryAtMs = retryAtMs;
+}
+
+// Turned away: try again after a growing, jittered pause
+static void Backoff(StormClient *pClient)
+{
+    StormRun *pRun = pClient->pRun;
+    DWORD jitter = NextRandom(&pRun->random) % (pClient->backoffMs / 2 + 1);
+    Disconnect(pClient, EVLOOP_NowMs() + pClient->backoffMs + jitter);
+    pClient->backoffMs = pClient->backoffMs * 2 < MAX_BACKOFF_MS ? pClient->backoffMs * 2 : MAX_BACKOFF_MS;
+}
+
+static BOOL SendLogon(StormClient *pClient)
+{
+    NetBuffer buffer;
+    NETBUF_Init(&buffer, 0, 256);
+    RealmWriter writer;
+    REALM_BeginFrame(&writer, &buffer, REALM_CMD_LOGON, 0, 1);
+    REALM_PutDword(&writer, 0);
+    REALM_PutString(&writer, pClient->szAccount);
+    BOOL ok = REALM_EndFrame(&writer) &&
+              NET_Send(pClient->s, NETBUF_Data(&buffer), NETBUF_Size(&buffer)) == (int)NETBUF_Size(&buffer);
+    NETBUF_Free(&buffer);
+    return ok;
+}
+
+static void __cdecl OnClientEvent(void *pContext, DWORD events)
+{
+    StormClient *pClient = (StormClient *)pContext;
+    if (pClient->state == CLIENT_CONNECTING)
+    {
+        int result = (events & NET_HANGUP) ? -1 : NET_FinishConnect(pClient->s);
+        if (result == 0)
+        {
+            return;
+        }
+        if (pClient->abuser)
+        {
+            // Connected or not, straight back at it
+            Disconnect(pClient, EVLOOP_NowMs() + ABUSE_INTERVAL_MS);
+            return;
+        }
+        if (result < 0 || !SendLogon(pClient))
+        {
+            Backoff(pClient);
+            return;
+        }
+        pClient->state = CLIENT_LOGGING_ON;
+        EVLOOP_SetInterest(pClient->pRun->pLoop, pClient->loopId, NET_READ);
+        return;
+    }
+
+    if (pClient->state == CLIENT_LOGGING_ON)
+    {
+        int received = NET_Recv(pClient->s, pClient->in + pClient->inSize, sizeof(pClient->in) - pClient->inSize);
+        if (received > 0)
+        {
+            pClient->inSize += (DWORD)received;
+        }
+        RealmFrame frame;
+        int size = REALM_ParseFrame(pClient->in, pClient->inSize, &frame);
+        if (size > 0 && frame.command == (REALM_CMD_LOGON | 1) && frame.status == REALM_OK)
+        {
+            pClient->state = CLIENT_DONE;
+            pClient->pRun->loggedOn++;
+            pClient->pRun->lastLogonMs = EVLOOP_NowMs();
+            EVLOOP_SetInterest(pClient->pRun->pLoop, pClient->loopId, 0);
+        }
+        else if (size != 0 || received < 0 || (events & NET_HANGUP))
+        {
+            Backoff(pClient);
+        }
+    }
+}
+
+static void Connect(StormClient *pClient)
+{
+    StormRun *pRun = pClient->pRun;
+    if (pClient->abuser)
+    {
+        pRun->abuseAttempts++;
+    }
+    else
+    {
+        pRun->legitAttempts++;
+    }
+    pClient->inSize = 0;
+    pClient->s = NET_ConnectFrom("127.0.0.1", pRun->port, pClient->address);
+    if (pClient->s != NET_INVALID_SOCKET)
+    {
+        pClient->loopId = EVLOOP_Add(pRun->pLoop, pClient->s, NET_WRITE, OnClientEvent, pClient);
+        if (pClient->loopId != EVLOOP_INVALID_ID)
+        {
+            pClient->state = CLIENT_CONNECTING;
+            return;
+        }
+        NET_Close(pClient->s);
+        pClient->s = NET_INVALID_SOCKET;
+    }
+    pClient->retryAtMs = EVLOOP_NowMs() + (pClient->abuser ? ABUSE_INTERVAL_MS : pClient->backoffMs);
+}
+
+typedef struct StormResult
+{
+    BOOL ok;
+    DWORD loggedOn;
+    DWORD logonMs; // Until the last client logged on
+    DWORD elapsedMs;
+    uint64_t legitAttempts;
+    uint64_t abuseAttempts;
+    uint64_t abuseAccepted;
+    uint64_t cpuUs;
+} StormResult;
+
+static void Storm(const char *szName, BOOL admission, DWORD legit, DWORD abusers, StormResult *pResult)
+{
+    memset(pResult, 0, sizeof(*pResult));
+    AdmissionDesc admissionDesc;
+    memset(&admissionDesc, 0, sizeof(admissionDesc));
+    admissionDesc.ipRate = STORM_IP_RATE;
+    admissionDesc.ipBurst = STORM_IP_BURST;
+    admissionDesc.banAfter = STORM_BAN_AFTER;
+    RealmServerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szAddress = "127.0.0.1";
+    desc.threads = SERVER_THREADS;
+    desc.pAdmission = admission ? &admissionDesc : NULL;
+    RealmServer *pServer = REALMSRV_Create(&desc);
+    if (!pServer)
+    {
+        printf("%s: cannot start the realm\n", szName);
+        return;
+    }
+
+    StormRun run;
+    run.pLoop = EVLOOP_Create(legit + abusers + 16);
+    run.port = REALMSRV_GetPort(pServer);
+    run.random = 0x2545F491;
+    run.loggedOn = 0;
+    run.lastLogonMs = 0;
+    run.legitAttempts = 0;
+    run.abuseAttempts = 0;
+    std::vector<StormClient> clients(legit + abusers);
+    for (DWORD i = 0; i < legit + abusers; i++)
+    {
+        StormClient *pClient = &clients[i];
+        pClient->pRun = &run;
+        pClient->abuser = i >= legit;
+        pClient->address = pClient->abuser ? MakeAddress(127, 2, 0, (BYTE)(i - legit + 1))
+                                           : MakeAddress(127, 1, (BYTE)(i / 50), (BYTE)(i % 50 + 1));
+        snprintf(pClient->szAccount, sizeof(pClient->szAccount), "storm%u", i);
+        pClient->state = CLIENT_WAITING;
+        pClient->s = NET_INVALID_SOCKET;
+        pClient->retryAtMs = 0;
+        pClient->backoffMs = FIRST_BACKOFF_MS;
+    }
+
+    RealmServerStats before, after;
+    REALMSRV_GetStats(pServer, &before);
+    uint64_t startMs = EVLOOP_NowMs();
+    uint64_t nowMs = startMs;
+    while ((run.loggedOn < legit || nowMs - startMs < MIN_STORM_MS) && nowMs - startMs < STORM_TIMEOUT_MS)
+    {
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            if (clients[i].state == CLIENT_WAITING && clients[i].retryAtMs <= nowMs)
+            {
+                Connect(&clients[i]);
+            }
+        }
+        EVLOOP_Run(run.pLoop, 1);
+        nowMs = EVLOOP_NowMs();
+    }
+    pResult->elapsedMs = (DWORD)(nowMs - startMs);
+    REALMSRV_GetStats(pServer, &after);
+
+    AdmissionStats admitted;
+    memset(&admitted, 0, sizeof(admitted));
+    BOOL hasAdmission = REALMSRV_GetAdmissionStats(pServer, &admitted);
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        if (clients[i].state != CLIENT_WAITING)
+        {
+            Disconnect(&clients[i], 0);
+        }
+    }
+    EVLOOP_Destroy(run.pLoop);
+
+    // Every legitimate client was taken exactly once: after a connection is
+    // accepted the server turns nobody away
+    uint64_t accepted = after.accepted - before.accepted;
+    pResult->loggedOn = run.loggedOn;
+    pResult->logonMs = run.lastLogonMs ? (DWORD)(run.lastLogonMs - startMs) : 0;
+    pResult->legitAttempts = run.legitAttempts;
+    pResult->abuseAttempts = run.abuseAttempts;
+    pResult->abuseAccepted = accepted > run.loggedOn ? accepted - run.loggedOn : 0;
+    pResult->cpuUs = after.cpuUs - before.cpuUs;
+    pResult->ok = run.loggedOn == legit && after.logons - before.logons == legit;
+
+    printf("%s: %u of %u clients logged on in %u ms (%llu attempts); %u abusers made %llu attempts, "
+           "%llu taken\n",
+           szName, run.loggedOn, legit, pResult->logonMs, (unsigned long long)run.legitAttempts, abusers,
+           (unsigned long long)run.abuseAttempts, (unsigned long long)pResult->abuseAccepted);
+    printf("  server: %llu connections accepted, %.1f ms worker CPU over %u ms\n", (unsigned long long)accepted,
+           pResult->cpuUs / 1000.0, pResult->elapsedMs);
+    if (hasAdmission)
+    {
+        printf("  admission: %llu checked, %llu admitted", (unsigned long long)admitted.checked,
+               (unsigned long long)admitted.admitted);
+        for (BYTE verdict = ADMIT_BANNED; verdict < ADMIT_VERDICT_COUNT; verdict++)
+        {
+            printf(", %llu %s", (unsigned long long)admitted.refused[verdict], ADMIT_VerdictName(verdict));
+        }
+        printf("; %llu bans, %u active\n", (unsigned long long)admitted.bans, admitted.activeBans);
+
+        // Before its ban an abuser gets its burst, plus what refills while
+        // it is still hammering: bounded generously by the whole run
+        uint64_t allowance = (uint64_t)abusers * (STORM_IP_BURST + STORM_IP_RATE * (pResult->elapsedMs / 1000 + 1));
+        pResult->ok = pResult->ok && admitted.bans == abusers && admitted.activeBans == abusers &&
+                      pResult->abuseAccepted <= allowance;
+    }
+    REALMSRV_Destroy(pServer);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD legit = (argc > 1) ? (DWORD)atoi(argv[1]) : 2000;
+    DWORD abusers = (argc > 2) ? (DWORD)atoi(argv[2]) : 16;
+    if (legit == 0 || legit > 50 * 256 || abusers == 0 || abusers > 254)
+    {
+        printf("usage: bench_admission [legitimate clients 1-12800] [abusers 1-254]\n");
+        return 1;
+    }
+
+    BOOL rulesOk = CheckAddressRules() && CheckSharedRules();
+    printf("rules: %s\n", rulesOk ? "ok" : "FAILED");
+    RunChecks();
+
+    NET_Startup();
+    printf("storm: %u clients log on at once while %u abusers reconnect every %u ms, %u server threads\n", legit,
+           abusers, ABUSE_INTERVAL_MS, SERVER_THREADS);
+    StormResult open, guarded;
+    Storm("without admission", FALSE, legit, abusers, &open);
+    Storm("with admission   ", TRUE, legit, abusers, &guarded);
+    NET_Cleanup();
+
+    BOOL ok = rulesOk && open.ok && guarded.ok;
+    printf("verify: rules %s, storm without %s, storm with %s -> %s\n", rulesOk ? "ok" : "FAILED",
+           open.ok ? "ok" : "FAILED", guarded.ok ? "ok" : "FAILED", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
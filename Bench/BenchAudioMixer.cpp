@@ -0,0 +1,249 @@
+/*
+ * BenchAudioMixer.cpp - Native mixer throughput and contention benchmark
+ *
+ *   1. Verification: a scripted scene (fades, pans, loops, resampled and
+ *      stereo voices, voice stealing) is rendered with the scalar and SSE2
+ *      kernels; the outputs must be bit-identical.
+ *   2. Throughput: 64 looping voices rendered offline, scalar vs SIMD,
+ *      reported as nanoseconds per block and percent of one core at 44.1 kHz.
+ *   3. Contention: the mixer thread runs in real time on the null device while
+ *      the game thread floods the command ring; reports worst block time.
+ *
+ * Usage: bench_audiomixer [seconds] [--wav scene.wav]
+ */
+
+#include "../Sound/AudioMixer.hpp"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#define EFFECT_COUNT 24
+
+static AudioSample g_effects[EFFECT_COUNT];
+static AudioSample g_music;
+
+static int16_t *MakeTone(DWORD frames, WORD channels, DWORD rate, float hz, float decay)
+{
+    int16_t *pcm = (int16_t *)malloc(frames * channels * sizeof(int16_t));
+    for (DWORD i = 0; i < frames; i++)
+    {
+        float t = (float)i / (float)rate;
+        float env = expf(-decay * t);
+        for (WORD c = 0; c < channels; c++)
+        {
+            float v = sinf(6.2831853f * hz * (1.0f + 0.01f * c) * t) * env * 12000.0f;
+            pcm[i * channels + c] = (int16_t)v;
+        }
+    }
+    return pcm;
+}
+
+static void BuildSamples(void)
+{
+    for (DWORD i = 0; i < EFFECT_COUNT; i++)
+    {
+        // D2 effects: mostly 22050 Hz mono, some 44100 Hz
+        DWORD rate = (i % 3 == 0) ? 44100 : 22050;
+        DWORD frames = rate / 2 + i * 101;
+        g_effects[i].pcm = MakeTone(frames, 1, rate, 180.0f + i * 37.0f, 3.0f);
+        g_effects[i].frames = frames;
+        g_effects[i].sampleRate = rate;
+        g_effects[i].channels = 1;
+    }
+
+    g_music.frames = 44100 * 4;
+    g_music.pcm = MakeTone(g_music.frames, 2, 44100, 110.0f, 0.0f);
+    g_music.sampleRate = 44100;
+    g_music.channels = 2;
+}
+
+/*
+ * RenderScene
+ * Deterministic command script interleaved with block rendering on one
+ * thread (valid SPSC usage: pushes and pops never overlap).
+ */
+static int16_t *RenderScene(BOOL forceScalar, DWORD blocks, AudioMixerStats *pStats)
+{
+    AudioMixerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.maxVoices = 32;
+    desc.forceScalar = forceScalar;
+
+    AudioMixer *pMixer = MIXER_Create(&desc);
+    int16_t *pOut = (int16_t *)malloc(blocks * MIXER_BLOCK_FRAMES * 2 * sizeof(int16_t));
+    DWORD musicId = MIXER_Play(pMixer, &g_music, 0.4f, 0.0f, MIXPRIORITY_CRITICAL, MIXVOICE_LOOP, 4410);
+    DWORD lastId = 0;
+    MixerEvent event;
+
+    for (DWORD b = 0; b < blocks; b++)
+    {
+        // Burst of effects every few blocks, enough to force stealing
+        if (b % 3 == 0)
+        {
+            for (DWORD k = 0; k < 4; k++)
+            {
+                DWORD e = (b + k * 7) % EFFECT_COUNT;
+                float pan = ((float)((b * 13 + k * 29) % 200) - 100.0f) / 100.0f;
+                lastId = MIXER_Play(pMixer, &g_effects[e], 0.7f, pan, (k == 0) ? MIXPRIORITY_EFFECT : MIXPRIORITY_AMBIENT,
+                                    0, (k & 1) ? 128 : 0);
+            }
+        }
+        if (b % 17 == 5)
+        {
+            MIXER_SetPan(pMixer, lastId, -0.5f, 300);
+            MIXER_SetVolume(pMixer, musicId, (b & 32) ? 0.2f : 0.5f, 2000);
+        }
+        if (b % 41 == 40)
+        {
+            MIXER_StopVoice(pMixer, lastId, 512);
+        }
+
+        MIXER_RenderBlock(pMixer, pOut + (size_t)b * MIXER_BLOCK_FRAMES * 2);
+        while (MIXER_PollEvent(pMixer, &event))
+        {
+        }
+    }
+
+    MIXER_GetStats(pMixer, pStats);
+    MIXER_Destroy(pMixer);
+    return pOut;
+}
+
+static double MeasureThroughput(BOOL forceScalar, DWORD seconds, BOOL *pSimd)
+{
+    AudioMixerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.maxVoices = 64;
+    desc.forceScalar = forceScalar;
+
+    AudioMixer *pMixer = MIXER_Create(&desc);
+    int16_t block[MIXER_BLOCK_FRAMES * 2];
+    *pSimd = MIXER_IsSimd(pMixer);
+
+    // 64 looping voices: a quarter resampled (22050 Hz), one stereo music bed
+    MIXER_Play(pMixer, &g_music, 0.3f, 0.0f, MIXPRIORITY_CRITICAL, MIXVOICE_LOOP, 0);
+    for (DWORD v = 1; v < 64; v++)
+    {
+        const AudioSample *pSample = &g_effects[(v % 4 == 0) ? 1 : (v % 8) * 3];
+        MIXER_Play(pMixer, pSample, 0.1f, ((float)(v % 21) - 10.0f) / 10.0f, MIXPRIORITY_EFFECT, MIXVOICE_LOOP, 0);
+    }
+
+    DWORD blocks = seconds * MIXER_GetSampleRate(pMixer) / MIXER_BLOCK_FRAMES;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (DWORD b = 0; b < blocks; b++)
+    {
+        // Volume automation keeps the ramp path hot
+        if (b % 8 == 0)
+        {
+            MIXER_SetVolume(pMixer, 2 + (b / 8) % 60, 0.05f + (float)(b % 5) * 0.02f, 256);
+        }
+        MIXER_RenderBlock(pMixer, block);
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    MIXER_Destroy(pMixer);
+    return elapsed * 1e9 / blocks;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD seconds = 20;
+    const char *szWavPath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--wav") == 0 && i + 1 < argc)
+            szWavPath = argv[++i];
+        else
+            seconds = (DWORD)atoi(argv[i]);
+    }
+
+    BuildSamples();
+
+    // ---------------------------------------------------------------- verify
+    const DWORD sceneBlocks = 1500;
+    AudioMixerStats statsScalar, statsSimd;
+    int16_t *pScalar = RenderScene(TRUE, sceneBlocks, &statsScalar);
+    int16_t *pSimd = RenderScene(FALSE, sceneBlocks, &statsSimd);
+    size_t sceneBytes = (size_t)sceneBlocks * MIXER_BLOCK_FRAMES * 2 * sizeof(int16_t);
+    BOOL identical = memcmp(pScalar, pSimd, sceneBytes) == 0;
+
+    printf("scene:      %u blocks, %u stolen, %u dropped, peak %u voices -> scalar/SIMD %s\n",
+           sceneBlocks, statsSimd.voicesStolen, statsSimd.voicesDropped, statsSimd.peakVoices,
+           identical ? "identical" : "MISMATCH");
+
+    if (szWavPath)
+    {
+        AudioDevice device;
+        if (AUDIODEVICE_InitWavFile(&device, szWavPath) && device.pfnOpen(&device, MIXER_DEFAULT_RATE, 2))
+        {
+            device.pfnWrite(&device, pSimd, sceneBlocks * MIXER_BLOCK_FRAMES);
+            device.pfnClose(&device);
+            printf("scene:      written to %s\n", szWavPath);
+        }
+    }
+    free(pScalar);
+    free(pSimd);
+
+    // ------------------------------------------------------------ throughput
+    const double blockBudgetNs = MIXER_BLOCK_FRAMES * 1e9 / MIXER_DEFAULT_RATE;
+    BOOL simd = FALSE;
+    double scalarNs = MeasureThroughput(TRUE, seconds, &simd);
+    double simdNs = MeasureThroughput(FALSE, seconds, &simd);
+
+    printf("throughput: 64 voices, %u s of audio\n", seconds);
+    printf("  scalar:   %9.0f ns/block  (%5.2f%% of one core)\n", scalarNs, 100.0 * scalarNs / blockBudgetNs);
+    printf("  %-8s  %9.0f ns/block  (%5.2f%% of one core, %.2fx)\n", simd ? "sse2:" : "scalar:", simdNs,
+           100.0 * simdNs / blockBudgetNs, simdNs > 0 ? scalarNs / simdNs : 0.0);
+
+    // ------------------------------------------------------------ contention
+    AudioMixerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.maxVoices = 64;
+    desc.commandCapacity = 4096;
+    AudioMixer *pMixer = MIXER_Create(&desc);
+    AudioDevice device;
+    AUDIODEVICE_InitNull(&device);
+
+    MIXER_StartThread(pMixer, &device, TRUE);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    DWORD submitted = 0;
+    MixerEvent event;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        // A fight: hundreds of effect requests per frame plus volume/pan updates
+        for (DWORD k = 0; k < 200; k++)
+        {
+            DWORD id = MIXER_Play(pMixer, &g_effects[(submitted + k) % EFFECT_COUNT], 0.3f, 0.0f,
+                                  MIXPRIORITY_EFFECT, 0, 0);
+            MIXER_SetPan(pMixer, id, 0.25f, 64);
+            submitted += 2;
+        }
+        while (MIXER_PollEvent(pMixer, &event))
+        {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(4));
+    }
+    MIXER_StopThread(pMixer);
+
+    AudioMixerStats stats;
+    MIXER_GetStats(pMixer, &stats);
+    printf("contention: %u commands submitted (%u rejected), %llu processed, %u stolen\n", submitted,
+           stats.commandsRejected, (unsigned long long)stats.commandsProcessed, stats.voicesStolen);
+    printf("  blocks:   %llu rendered, avg %.0f ns, worst %u ns (budget %.0f ns)\n",
+           (unsigned long long)stats.blocksRendered,
+           stats.blocksRendered ? (double)stats.renderNanosTotal / stats.blocksRendered : 0.0,
+           stats.renderNanosMax, blockBudgetNs);
+    MIXER_Destroy(pMixer);
+
+    for (DWORD i = 0; i < EFFECT_COUNT; i++)
+    {
+        free((void *)g_effects[i].pcm);
+    }
+    free((void *)g_music.pcm);
+    return identical ? 0 : 1;
+}
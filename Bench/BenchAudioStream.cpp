@@ -0,0 +1,391 @@
+/*
+ * BenchAudioStream.cpp - Streaming music/speech decoder benchmark
+ *
+ * The 14 act/menu tracks are stood in for by procedural WAV sources that
+ * synthesize their bytes on demand (random access, like an MPQ entry), so
+ * track length costs nothing but time.
+ *
+ *   1. Verification: streamed output is compared frame by frame with the
+ *      source - 44.1 kHz stereo (exact), a loop seam, 8-bit mono, and a
+ *      22.05 kHz mono speech line (every other output frame is exact).
+ *   2. No-sound/no-music: refused opens must not read a single byte.
+ *   3. Memory: manager budget vs. buffering every track whole.
+ *   4. Throughput: decode+resample speed as a multiple of real time.
+ *   5. Real time: mixer thread and stream worker running together; reports
+ *      underruns.
+ *
+ * Usage: bench_audiostream [realtime-seconds]
+ */
+
+#include "../Sound/AudioStream.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+typedef struct SynthTrack
+{
+    const char *szPath;
+    DWORD seconds;
+    DWORD sampleRate;
+    WORD channels;
+    WORD bits;
+} SynthTrack;
+
+// data\global\music\*.wav as D2Sound opens them
+static const SynthTrack g_tracks[] = {
+    {"act1\\caves.wav", 211, 22050, 2, 16},     {"act1\\crypt.wav", 187, 22050, 2, 16},
+    {"act1\\monastery.wav", 232, 22050, 2, 16}, {"act2\\desert.wav", 246, 22050, 2, 16},
+    {"act2\\harem.wav", 178, 22050, 2, 16},     {"act2\\sewer.wav", 205, 22050, 2, 16},
+    {"act2\\tombs.wav", 224, 22050, 2, 16},     {"act3\\kurast.wav", 251, 22050, 2, 16},
+    {"act3\\kurastsewer.wav", 196, 22050, 2, 16}, {"act3\\spider.wav", 214, 22050, 2, 16},
+    {"act4\\diablo.wav", 263, 22050, 2, 16},    {"act5\\icecaves.wav", 229, 22050, 2, 16},
+    {"act5\\xtemple.wav", 241, 22050, 2, 16},   {"common\\options.wav", 158, 22050, 2, 16},
+};
+#define TRACK_COUNT ((DWORD)(sizeof(g_tracks) / sizeof(g_tracks[0])))
+
+// =============================================================================
+// PROCEDURAL WAV SOURCE
+// =============================================================================
+
+typedef struct SynthSource
+{
+    SynthTrack track;
+    DWORD frames;
+    DWORD seed;
+    BYTE header[44];
+    uint64_t bytesRead;
+    DWORD closed;
+} SynthSource;
+
+static int16_t SynthSample(DWORD seed, DWORD frame, DWORD channel, WORD bits)
+{
+    DWORD h = D2_HashDword(seed ^ (frame * 2 + channel));
+    int v = (int)((frame * (37 + seed % 11)) & 0x3FFF) - 0x2000 + (int)(h & 0x3FF);
+    if (bits == 8)
+    {
+        return (int16_t)((v >> 8) * 256); // What the 8-bit file can represent
+    }
+    return (int16_t)v;
+}
+
+static BYTE SynthByte(const SynthSource *pSynth, uint64_t offset)
+{
+    if (offset < 44)
+    {
+        return pSynth->header[offset];
+    }
+
+    uint64_t pos = offset - 44;
+    DWORD bytesPerSample = pSynth->track.bits / 8;
+    DWORD sample = (DWORD)(pos / bytesPerSample);
+    int16_t value = SynthSample(pSynth->seed, sample / pSynth->track.channels, sample % pSynth->track.channels,
+                                pSynth->track.bits);
+
+    if (bytesPerSample == 1)
+    {
+        return (BYTE)((value >> 8) + 128);
+    }
+    return (pos & 1) ? (BYTE)((WORD)value >> 8) : (BYTE)value;
+}
+
+static BOOL __cdecl SynthRead(void *pContext, uint64_t offset, void *pBuffer, DWORD bytes, DWORD *pBytesRead)
+{
+    SynthSource *pSynth = (SynthSource *)pContext;
+    uint64_t total = 44 + (uint64_t)pSynth->frames * pSynth->track.channels * (pSynth->track.bits / 8);
+    BYTE *pOut = (BYTE *)pBuffer;
+
+    if (offset >= total)
+    {
+        *pBytesRead = 0;
+        return TRUE;
+    }
+    if (bytes > total - offset)
+    {
+        bytes = (DWORD)(total - offset);
+    }
+
+    for (DWORD i = 0; i < bytes; i++)
+    {
+        pOut[i] = SynthByte(pSynth, offset + i);
+    }
+    pSynth->bytesRead += bytes;
+    *pBytesRead = bytes;
+    return TRUE;
+}
+
+static void __cdecl SynthClose(void *pContext)
+{
+    ((SynthSource *)pContext)->closed++;
+}
+
+static void PutLE32(BYTE *p, DWORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static void InitSynth(SynthSource *pSynth, const SynthTrack *pTrack, DWORD frames, DWORD seed, StreamSource *pSource)
+{
+    memset(pSynth, 0, sizeof(SynthSource));
+    pSynth->track = *pTrack;
+    pSynth->frames = frames;
+    pSynth->seed = seed;
+
+    WORD blockAlign = (WORD)(pTrack->channels * pTrack->bits / 8);
+    DWORD dataBytes = frames * blockAlign;
+    BYTE *h = pSynth->header;
+    memcpy(h, "RIFF", 4);
+    PutLE32(h + 4, 36 + dataBytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    PutLE32(h + 16, 16);
+    h[20] = 1;
+    h[21] = 0;
+    h[22] = (BYTE)pTrack->channels;
+    h[23] = 0;
+    PutLE32(h + 24, pTrack->sampleRate);
+    PutLE32(h + 28, pTrack->sampleRate * blockAlign);
+    h[32] = (BYTE)blockAlign;
+    h[33] = 0;
+    h[34] = (BYTE)pTrack->bits;
+    h[35] = 0;
+    memcpy(h + 36, "data", 4);
+    PutLE32(h + 40, dataBytes);
+
+    pSource->pfnRead = SynthRead;
+    pSource->pfnClose = SynthClose;
+    pSource->pContext = pSynth;
+}
+
+// =============================================================================
+// VERIFICATION
+// =============================================================================
+
+static AudioStreamManager *CreateManual(void)
+{
+    AudioStreamManagerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.manualPump = TRUE;
+    return AUDIOSTREAM_CreateManager(&desc);
+}
+
+/*
+ * VerifyStream
+ * Pull `pullFrames` frames in mixer-sized blocks, pumping the manager in
+ * between, and compare against the source. `stride` is output frames per
+ * source frame (1 or 2); only output frames landing exactly on a source frame
+ * are compared.
+ */
+static BOOL VerifyStream(const char *szName, const SynthTrack *pTrack, DWORD sourceFrames, DWORD pullFrames, BOOL loop,
+                         DWORD stride)
+{
+    AudioStreamManager *pManager = CreateManual();
+    SynthSource synth;
+    StreamSource source;
+    InitSynth(&synth, pTrack, sourceFrames, 7, &source);
+
+    AudioStream *pStream = AUDIOSTREAM_Open(pManager, AUDIOSTREAM_SPEECH, &source, loop ? AUDIOSTREAM_LOOP : 0);
+    const MixerStream *pMixerStream = AUDIOSTREAM_GetMixerStream(pStream);
+    int16_t block[MIXER_BLOCK_FRAMES * 2];
+    DWORD mismatches = 0;
+    DWORD pulled = 0;
+
+    while (pulled < pullFrames)
+    {
+        AUDIOSTREAM_Update(pManager);
+        DWORD got = pMixerStream->pfnRead(pMixerStream->pContext, block, MIXER_BLOCK_FRAMES);
+        for (DWORD i = 0; i < got && pulled + i < pullFrames; i++)
+        {
+            DWORD out = pulled + i;
+            if (out % stride != 0)
+            {
+                continue;
+            }
+            DWORD frame = (out / stride) % sourceFrames;
+            for (DWORD c = 0; c < 2; c++)
+            {
+                DWORD sc = (pTrack->channels == 1) ? 0 : c;
+                if (block[i * 2 + c] != SynthSample(synth.seed, frame, sc, pTrack->bits))
+                {
+                    mismatches++;
+                }
+            }
+        }
+        pulled += got;
+        if (got < MIXER_BLOCK_FRAMES)
+        {
+            break;
+        }
+    }
+
+    AudioStreamStats stats;
+    AUDIOSTREAM_GetStats(pStream, &stats);
+    AUDIOSTREAM_Close(pManager, pStream);
+
+    // A one-shot must end at the last source frame (resampled: within one source frame)
+    BOOL lengthOk = loop || (pulled + 2 * stride > sourceFrames * stride && pulled <= sourceFrames * stride);
+    BOOL ok = mismatches == 0 && stats.underruns == 0 && lengthOk && synth.closed == 1;
+
+    printf("  %-22s %8u frames, %4u chunks, %u underruns -> %s\n", szName, pulled, stats.chunksRead,
+           stats.underruns, ok ? "ok" : "FAILED");
+    AUDIOSTREAM_DestroyManager(pManager);
+    return ok;
+}
+
+static BOOL VerifyDisabled(void)
+{
+    AudioStreamManagerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.manualPump = TRUE;
+    desc.noMusic = TRUE;
+    AudioStreamManager *pNoMusic = AUDIOSTREAM_CreateManager(&desc);
+    desc.noSound = TRUE;
+    AudioStreamManager *pNoSound = AUDIOSTREAM_CreateManager(&desc);
+
+    SynthSource music, speech, mute;
+    StreamSource source;
+    InitSynth(&music, &g_tracks[0], 22050, 1, &source);
+    AudioStream *pMusic = AUDIOSTREAM_Open(pNoMusic, AUDIOSTREAM_MUSIC, &source, AUDIOSTREAM_LOOP);
+    InitSynth(&speech, &g_tracks[0], 22050, 2, &source);
+    AudioStream *pSpeech = AUDIOSTREAM_Open(pNoMusic, AUDIOSTREAM_SPEECH, &source, 0);
+    InitSynth(&mute, &g_tracks[0], 22050, 3, &source);
+    AudioStream *pMute = AUDIOSTREAM_Open(pNoSound, AUDIOSTREAM_SPEECH, &source, 0);
+
+    AUDIOSTREAM_Update(pNoMusic);
+    AUDIOSTREAM_Update(pNoSound);
+
+    BOOL ok = !pMusic && music.bytesRead == 0 && music.closed == 1 && pSpeech && speech.bytesRead > 0 && !pMute &&
+              mute.bytesRead == 0 && mute.closed == 1;
+
+    printf("  -nm: music refused (%llu bytes read), speech streams; -ns: refused (%llu bytes read), %u bytes owned -> %s\n",
+           (unsigned long long)music.bytesRead, (unsigned long long)mute.bytesRead,
+           (DWORD)AUDIOSTREAM_GetMemoryBudget(pNoSound), ok ? "ok" : "FAILED");
+
+    AUDIOSTREAM_Close(pNoMusic, pSpeech);
+    AUDIOSTREAM_DestroyManager(pNoMusic);
+    AUDIOSTREAM_DestroyManager(pNoSound);
+    return ok;
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+    DWORD realtimeSeconds = (argc > 1) ? (DWORD)atoi(argv[1]) : 3;
+    BOOL ok = TRUE;
+
+    // ---------------------------------------------------------------- verify
+    static const SynthTrack stereo44 = {"verify", 0, 44100, 2, 16};
+    static const SynthTrack mono8 = {"verify", 0, 44100, 1, 8};
+    static const SynthTrack speech22 = {"verify", 0, 22050, 1, 16};
+
+    printf("verify:\n");
+    ok &= VerifyStream("44.1 kHz stereo", &stereo44, 44100 * 3 + 17, 44100 * 4, FALSE, 1);
+    ok &= VerifyStream("loop seam", &stereo44, 30011, 44100 * 5, TRUE, 1);
+    ok &= VerifyStream("44.1 kHz 8-bit mono", &mono8, 44100 * 2 + 5, 44100 * 3, FALSE, 1);
+    ok &= VerifyStream("22.05 kHz speech", &speech22, 22050 * 4 + 3, 44100 * 9, FALSE, 2);
+    ok &= VerifyDisabled();
+
+    // ---------------------------------------------------------------- memory
+    AudioStreamManager *pManager = CreateManual();
+    uint64_t wholeFile = 0;
+    uint64_t longest = 0;
+    for (DWORD t = 0; t < TRACK_COUNT; t++)
+    {
+        uint64_t bytes = (uint64_t)g_tracks[t].seconds * g_tracks[t].sampleRate * g_tracks[t].channels * 2;
+        wholeFile += bytes;
+        longest = (bytes > longest) ? bytes : longest;
+    }
+    printf("memory:     stream manager %u KB (music + speech) vs %.1f MB for the longest track buffered whole "
+           "(%.1f MB for all %u)\n",
+           (DWORD)(AUDIOSTREAM_GetMemoryBudget(pManager) / 1024), longest / 1048576.0, wholeFile / 1048576.0,
+           TRACK_COUNT);
+
+    // ------------------------------------------------------------ throughput
+    const DWORD decodeSeconds = 60;
+    int16_t block[MIXER_BLOCK_FRAMES * 2];
+    uint64_t framesOut = 0;
+    double sourceSeconds = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double synthSeconds = 0;
+
+    for (DWORD t = 0; t < TRACK_COUNT; t++)
+    {
+        SynthSource synth;
+        StreamSource source;
+        InitSynth(&synth, &g_tracks[t], g_tracks[t].sampleRate * decodeSeconds, t, &source);
+
+        AudioStream *pStream = AUDIOSTREAM_Open(pManager, AUDIOSTREAM_MUSIC, &source, 0);
+        const MixerStream *pMixerStream = AUDIOSTREAM_GetMixerStream(pStream);
+        for (;;)
+        {
+            AUDIOSTREAM_Update(pManager);
+            DWORD got = pMixerStream->pfnRead(pMixerStream->pContext, block, MIXER_BLOCK_FRAMES);
+            framesOut += got;
+            if (got < MIXER_BLOCK_FRAMES)
+            {
+                break;
+            }
+        }
+        AUDIOSTREAM_Close(pManager, pStream);
+        sourceSeconds += decodeSeconds;
+
+        // Procedural bytes are not free; time them alone and subtract
+        std::chrono::steady_clock::time_point synthStart = std::chrono::steady_clock::now();
+        BYTE scratch[16384];
+        DWORD got = 0;
+        for (uint64_t offset = 0; SynthRead(&synth, offset, scratch, sizeof(scratch), &got) && got; offset += got)
+        {
+        }
+        synthSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - synthStart).count();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double decodeOnly = elapsed - 2 * synthSeconds;
+    printf("throughput: %u tracks x %u s -> %llu frames in %.3f s decode+resample (%.0fx real time)\n", TRACK_COUNT,
+           decodeSeconds, (unsigned long long)framesOut, decodeOnly, decodeOnly > 0 ? sourceSeconds / decodeOnly : 0.0);
+    AUDIOSTREAM_DestroyManager(pManager);
+
+    // -------------------------------------------------------------- realtime
+    AudioStreamManagerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    pManager = AUDIOSTREAM_CreateManager(&desc);
+    AudioMixer *pMixer = MIXER_Create(NULL);
+    AudioDevice device;
+    AUDIODEVICE_InitNull(&device);
+
+    SynthSource music, speech;
+    StreamSource source;
+    InitSynth(&music, &g_tracks[0], g_tracks[0].sampleRate * g_tracks[0].seconds, 1, &source);
+    AudioStream *pMusic = AUDIOSTREAM_Open(pManager, AUDIOSTREAM_MUSIC, &source, AUDIOSTREAM_LOOP);
+    InitSynth(&speech, &speech22, 22050 * 2, 2, &source);
+    AudioStream *pSpeech = AUDIOSTREAM_Open(pManager, AUDIOSTREAM_SPEECH, &source, AUDIOSTREAM_LOOP);
+
+    MIXER_PlayStream(pMixer, AUDIOSTREAM_GetMixerStream(pMusic), 0.5f, 0.0f, MIXPRIORITY_CRITICAL, 4410);
+    MIXER_PlayStream(pMixer, AUDIOSTREAM_GetMixerStream(pSpeech), 0.8f, -0.3f, MIXPRIORITY_CRITICAL, 0);
+    MIXER_StartThread(pMixer, &device, TRUE);
+    std::this_thread::sleep_for(std::chrono::seconds(realtimeSeconds));
+    MIXER_StopAll(pMixer);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    MIXER_StopThread(pMixer);
+
+    AudioStreamStats musicStats, speechStats;
+    AUDIOSTREAM_GetStats(pMusic, &musicStats);
+    AUDIOSTREAM_GetStats(pSpeech, &speechStats);
+    printf("realtime:   %u s, music %llu frames (%u chunks), speech %llu frames (%u chunks), underruns %u/%u\n",
+           realtimeSeconds, (unsigned long long)musicStats.framesPlayed, musicStats.chunksRead,
+           (unsigned long long)speechStats.framesPlayed, speechStats.chunksRead, musicStats.underruns,
+           speechStats.underruns);
+
+    AUDIOSTREAM_Close(pManager, pMusic);
+    AUDIOSTREAM_Close(pManager, pSpeech);
+    MIXER_Destroy(pMixer);
+    AUDIOSTREAM_DestroyManager(pManager);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+/*
+ * BenchChatFanout.cpp - One crowded chat channel: per-member copies versus
+ * shared messages and gathered sends
+ *
+ * Fills one channel of a local RealmServer with a RealmSwarm and has some
+ * of the members talk, twice on fresh servers:
+ *   copy:   each line copied into every member's buffer and sent to each
+ *           member on its own, the way D2Multi hands chat out;
+ *   shared: each line encoded once; members' queues reference it and a
+ *           member's queued lines go out in one gathered send per loop run.
+ * The server's worker CPU time and send calls are taken over the talking
+ * only (from the first line to the last delivery), so logins do not count.
+ *
+ * Verification:
+ *   - both runs: every member receives every other talker's lines:
+ *     received == (sent - throttled) * (members - 1) == the server's count
+ *     of deliveries;
+ *   - the shared run makes fewer send calls than the copy run;
+ *   - flood control: 8 lines said back to back with a burst of 5 get 5
+ *     acknowledgements and 3 REALM_ERR_BUSY;
+ *   - history: a member joining afterwards gets the channel's last
+ *     historyLines lines, oldest first, right after its join reply.
+ *
+ * Usage: bench_chatfanout [members] [talkers] [lines]
+ */
+
+#include "../Realm/RealmServer.hpp"
+#include "../Realm/RealmSwarm.hpp"
+
+#include "../Net/McpClient.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define SERVER_THREADS 2
+#define SWARM_THREADS 2
+#define BENCH_CHAT_RATE 100 // High enough that the talkers are never throttled
+#define BENCH_CHAT_BURST 10
+#define CHECK_HISTORY_LINES 4
+#define CHECK_BURST 5
+#define CHECK_LINES 8
+#define SETTLE_TIMEOUT_MS 5000
+#define PHASE_TIMEOUT_MS 120000
+
+static RealmServer *StartServer(BOOL copyChat, DWORD rate, DWORD burst, DWORD historyLines)
+{
+    RealmServerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szAddress = "127.0.0.1";
+    desc.threads = SERVER_THREADS;
+    desc.chatRate = rate;
+    desc.chatBurst = burst;
+    desc.historyLines = historyLines;
+    desc.copyChat = copyChat;
+    return REALMSRV_Create(&desc);
+}
+
+// =============================================================================
+// FLOOD CONTROL AND HISTORY
+// =============================================================================
+
+typedef struct Reply
+{
+    BOOL done;
+    BYTE status;
+} Reply;
+
+static void __cdecl OnReply(void *pContext, const McpReply *pReply)
+{
+    Reply *pResult = (Reply *)pContext;
+    pResult->done = TRUE;
+    pResult->status = pReply->status;
+}
+
+static void __cdecl OnHistoryPush(void *pContext, const McpReply *pReply)
+{
+    std::vector<std::string> *pLines = (std::vector<std::string> *)pContext;
+    RealmReader reader;
+    RealmChatEvent event;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    if (pReply->command == REALM_CMD_CHATEVENT && REALM_GetChatEvent(&reader, &event) &&
+        event.type == REALM_CHAT_TALK)
+    {
+        pLines->push_back(event.szText);
+    }
+}
+
+// Pumps both clients until every reply is in, or until minLines have been pushed
+static BOOL Settle(McpClient **ppClients, Reply *pReplies, DWORD replyCount, const std::vector<std::string> *pLines,
+                   size_t minLines)
+{
+    for (DWORD waited = 0; waited < SETTLE_TIMEOUT_MS; waited++)
+    {
+        BOOL done = pLines->size() >= minLines;
+        for (DWORD i = 0; i < replyCount; i++)
+        {
+            done = done && pReplies[i].done;
+        }
+        if (done)
+        {
+            return TRUE;
+        }
+        MCP_Pump(ppClients[0], 1);
+        MCP_Pump(ppClients[1], 1);
+    }
+    return FALSE;
+}
+
+static BOOL CheckFloodAndHistory(void)
+{
+    RealmServer *pServer = StartServer(FALSE, 0, CHECK_BURST, CHECK_HISTORY_LINES);
+    if (!pServer)
+    {
+        return FALSE;
+    }
+    McpClientDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szHost = "127.0.0.1";
+    desc.port = REALMSRV_GetPort(pServer);
+    McpClient *pClients[2] = {MCP_Create(&desc), MCP_Create(&desc)};
+    std::vector<std::string> lines;
+    MCP_SetPushHandler(pClients[1], OnHistoryPush, &lines);
+    MCP_Connect(pClients[0]);
+    MCP_Connect(pClients[1]);
+
+    Reply replies[CHECK_LINES + 4];
+    memset(replies, 0, sizeof(replies));
+    MCP_Logon(pClients[0], 0, "talker", OnReply, &replies[0]);
+    MCP_CreateChar(pClients[0], 0, 0, "Talker", OnReply, &replies[1]);
+    MCP_CharLogon(pClients[0], "Talker", OnReply, &replies[2]);
+    MCP_JoinChannel(pClients[0], "history", OnReply, &replies[3]);
+    BOOL ok = Settle(pClients, replies, 4, &lines, 0);
+
+    // Back to back: the burst gets through, the rest is turned away
+    memset(replies, 0, sizeof(replies));
+    char szText[32];
+    for (DWORD i = 0; i < CHECK_LINES; i++)
+    {
+        snprintf(szText, sizeof(szText), "line %u", i);
+        MCP_Chat(pClients[0], szText, OnReply, &replies[i]);
+    }
+    ok = ok && Settle(pClients, replies, CHECK_LINES, &lines, 0);
+    DWORD accepted = 0;
+    DWORD busy = 0;
+    for (DWORD i = 0; i < CHECK_LINES; i++)
+    {
+        accepted += replies[i].status == REALM_OK;
+        busy += replies[i].status == REALM_ERR_BUSY;
+    }
+    BOOL floodOk = ok && accepted == CHECK_BURST && busy == CHECK_LINES - CHECK_BURST;
+    printf("flood control: %u lines back to back, burst %u -> %u said, %u busy: %s\n", CHECK_LINES, CHECK_BURST,
+           accepted, busy, floodOk ? "ok" : "FAILED");
+
+    // A late joiner gets the last lines said, oldest first
+    memset(replies, 0, sizeof(replies));
+    MCP_Logon(pClients[1], 0, "late", OnReply, &replies[0]);
+    MCP_CreateChar(pClients[1], 0, 0, "Late", OnReply, &replies[1]);
+    MCP_CharLogon(pClients[1], "Late", OnReply, &replies[2]);
+    MCP_JoinChannel(pClients[1], "history", OnReply, &replies[3]);
+    ok = Settle(pClients, replies, 4, &lines, CHECK_HISTORY_LINES);
+    BOOL historyOk = ok && lines.size() == CHECK_HISTORY_LINES;
+    for (DWORD i = 0; historyOk && i < CHECK_HISTORY_LINES; i++)
+    {
+        snprintf(szText, sizeof(szText), "line %u", CHECK_BURST - CHECK_HISTORY_LINES + i);
+        historyOk = lines[i] == szText;
+    }
+    printf("history: late joiner got %u of the last %u lines in order: %s\n", (DWORD)lines.size(),
+           CHECK_HISTORY_LINES, historyOk ? "ok" : "FAILED");
+
+    MCP_Destroy(pClients[0]);
+    MCP_Destroy(pClients[1]);
+    REALMSRV_Destroy(pServer);
+    return floodOk && historyOk;
+}
+
+// =============================================================================
+// FAN-OUT
+// =============================================================================
+
+typedef struct FanoutResult
+{
+    BOOL ok;
+    RealmSwarmStats swarm;
+    uint64_t deliveries;
+    uint64_t cpuUs;
+    uint64_t sendCalls;
+    uint64_t bytesSent;
+} FanoutResult;
+
+static void RunSwarm(const RealmSwarmDesc *pDesc, RealmSwarmStats *pStats, BOOL *pOk)
+{
+    *pOk = REALMSWARM_Run(pDesc, pStats);
+}
+
+static void Fanout(const char *szName, BOOL copyChat, DWORD members, DWORD talkers, DWORD lines,
+                   FanoutResult *pResult)
+{
+    memset(pResult, 0, sizeof(*pResult));
+    RealmServer *pServer = StartServer(copyChat, BENCH_CHAT_RATE, BENCH_CHAT_BURST, 0);
+    if (!pServer)
+    {
+        printf("%s: cannot start the realm\n", szName);
+        return;
+    }
+    RealmSwarmDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szHost = "127.0.0.1";
+    desc.port = REALMSRV_GetPort(pServer);
+    desc.szPrefix = "fo";
+    desc.clients = members;
+    desc.threads = SWARM_THREADS;
+    desc.channels = 1;
+    desc.chatLines = lines;
+    desc.talkers = talkers;
+    desc.lingerMs = 500;
+
+    BOOL swarmOk = FALSE;
+    std::thread swarm(RunSwarm, &desc, &pResult->swarm, &swarmOk);
+
+    // Talking starts with the first line and ends once every accepted line
+    // has reached every other member
+    RealmServerStats start, end;
+    uint64_t said = (uint64_t)talkers * lines;
+    DWORD waited = 0;
+    for (REALMSRV_GetStats(pServer, &start); start.chatLines + start.chatThrottled == 0 && waited < PHASE_TIMEOUT_MS;
+         waited++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REALMSRV_GetStats(pServer, &start);
+    }
+    for (REALMSRV_GetStats(pServer, &end);
+         (end.chatLines + end.chatThrottled < said || end.chatDeliveries < end.chatLines * (members - 1)) &&
+         waited < PHASE_TIMEOUT_MS;
+         waited++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        REALMSRV_GetStats(pServer, &end);
+    }
+    swarm.join();
+
+    RealmSwarmStats *pSwarm = &pResult->swarm;
+    pResult->deliveries = end.chatDeliveries;
+    pResult->cpuUs = end.cpuUs - start.cpuUs;
+    pResult->sendCalls = end.sendCalls - start.sendCalls;
+    pResult->bytesSent = end.bytesSent - start.bytesSent;
+    uint64_t expected = (pSwarm->chatSent - pSwarm->chatThrottled) * (members - 1);
+    pResult->ok = swarmOk && pSwarm->ready == members && pSwarm->chatSent == said && pSwarm->chatReceived == expected &&
+                  pResult->deliveries == expected;
+    REALMSRV_Destroy(pServer);
+
+    DWORD deliveries = pResult->deliveries ? (DWORD)pResult->deliveries : 1;
+    printf("%s: %llu lines (%llu throttled) -> %llu deliveries; latency p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+           szName, (unsigned long long)pSwarm->chatSent, (unsigned long long)pSwarm->chatThrottled,
+           (unsigned long long)pSwarm->chatReceived, pSwarm->chatP50Us / 1000.0, pSwarm->chatP99Us / 1000.0,
+           pSwarm->chatMaxUs / 1000.0);
+    printf("  server while talking: %.3f us CPU and %.4f send calls per delivery (%llu sends, %llu bytes): %s\n",
+           (double)pResult->cpuUs / deliveries, (double)pResult->sendCalls / deliveries,
+           (unsigned long long)pResult->sendCalls, (unsigned long long)pResult->bytesSent,
+           pResult->ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char **argv)
+{
+    DWORD members = (argc > 1) ? (DWORD)atoi(argv[1]) : 5000;
+    DWORD talkers = (argc > 2) ? (DWORD)atoi(argv[2]) : 50;
+    DWORD lines = (argc > 3) ? (DWORD)atoi(argv[3]) : 4;
+    if (members < 2 || talkers == 0 || talkers > members || lines == 0)
+    {
+        printf("usage: bench_chatfanout [members >= 2] [talkers <= members] [lines > 0]\n");
+        return 1;
+    }
+
+    NET_Startup();
+    BOOL checksOk = CheckFloodAndHistory();
+
+    printf("fan-out: %u members in one channel, %u talkers, %u lines each, %u server threads\n", members, talkers,
+           lines, SERVER_THREADS);
+    FanoutResult copy, shared;
+    Fanout("copy  ", TRUE, members, talkers, lines, &copy);
+    Fanout("shared", FALSE, members, talkers, lines, &shared);
+    NET_Cleanup();
+
+    BOOL fewerSends = shared.sendCalls < copy.sendCalls;
+    double cpuRatio = shared.cpuUs ? (double)copy.cpuUs / shared.cpuUs : 0.0;
+    printf("shared vs copy: %.2fx less server CPU, %.1fx fewer send calls\n", cpuRatio,
+           shared.sendCalls ? (double)copy.sendCalls / shared.sendCalls : 0.0);
+
+    BOOL ok = checksOk && copy.ok && shared.ok && fewerSends;
+    printf("verify: checks %s, copy %s, shared %s, fewer sends %s -> %s\n", checksOk ? "ok" : "FAILED",
+           copy.ok ? "ok" : "FAILED", shared.ok ? "ok" : "FAILED", fewerSends ? "ok" : "FAILED",
+           ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,607 @@
+/*
+ * BenchCollision.cpp - Missile sweeps and line of sight against room collision
+ *
+ * A 400x400 subtile level (10x10 rooms of 40x40): walls with doorways,
+ * pillars that stop both units and missiles, pools that stop units only. A
+ * projectile-spam fight runs in the middle: thousands of missiles moving 2-12
+ * subtiles a tick, each swept from its old to its new position; a missile
+ * that hits something respawns at a shooter. Doors open and close while the
+ * fight goes on. Separate passes time line-of-sight checks (monster target
+ * acquisition) and unit footprint tests.
+ *
+ *   rooms:  D2Common's layout - find the room holding each cell, test its
+ *           16-bit collision word, one Bresenham step at a time.
+ *   planes: COLMAP_SweepMissiles / COLMAP_LineOfSight / COLMAP_TestRect.
+ *
+ * Verification (untimed): every sweep, LOS and footprint result of the
+ * timed runs matches, including the exact cell hit; random lines of every
+ * length and direction, lines leaving the map and edits through
+ * SetCell/LoadRect are cross-checked cell for cell.
+ *
+ * Usage: bench_collision [missiles] [ticks]
+ */
+
+#include "../Common/CollisionMap.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define LEVEL_SIZE 400
+#define ROOM_SIZE 40
+#define ROOMS_PER_SIDE (LEVEL_SIZE / ROOM_SIZE)
+#define FIGHT_MIN 120
+#define FIGHT_MAX 280
+#define SHOOTERS 24
+#define DOORS_TOGGLED 8
+#define LOS_QUERIES 400000
+#define LOS_RANGE 40
+#define RECT_QUERIES 400000
+
+static DWORD g_rng = 0xC011;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static int RandomRange(int lo, int hi)
+{
+    return lo + (int)(NextRandom() % (DWORD)(hi - lo + 1));
+}
+
+// =============================================================================
+// ROOM BASELINE
+// =============================================================================
+
+typedef struct LegacyRoom
+{
+    int x;
+    int y;
+    int width;
+    int height;
+    BYTE reserved[0x40];
+    WORD *pCollision;
+} LegacyRoom;
+
+static LegacyRoom *g_rooms[ROOMS_PER_SIDE * ROOMS_PER_SIDE];
+
+static LegacyRoom *LegacyFindRoom(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= LEVEL_SIZE || y >= LEVEL_SIZE)
+    {
+        return NULL;
+    }
+    return g_rooms[(y / ROOM_SIZE) * ROOMS_PER_SIDE + x / ROOM_SIZE];
+}
+
+static WORD LegacyGetCell(int x, int y)
+{
+    LegacyRoom *pRoom = LegacyFindRoom(x, y);
+    if (!pRoom)
+    {
+        return 0xFFFF;
+    }
+    return pRoom->pCollision[(y - pRoom->y) * pRoom->width + (x - pRoom->x)];
+}
+
+static void LegacySetCell(int x, int y, WORD collision)
+{
+    LegacyRoom *pRoom = LegacyFindRoom(x, y);
+    pRoom->pCollision[(y - pRoom->y) * pRoom->width + (x - pRoom->x)] = collision;
+}
+
+// Incremental Bresenham, rounding half up; stops at the first cell matching the mask
+static BOOL LegacySweep(int x0, int y0, int x1, int y1, WORD mask, int *pHitX, int *pHitY)
+{
+    if (LegacyGetCell(x0, y0) == 0xFFFF || LegacyGetCell(x1, y1) == 0xFFFF)
+    {
+        *pHitX = x0;
+        *pHitY = y0;
+        return TRUE;
+    }
+
+    int dx = abs(x1 - x0), dy = abs(y1 - y0);
+    int sx = (x1 > x0) ? 1 : -1, sy = (y1 > y0) ? 1 : -1;
+    int major = (dx >= dy) ? dx : dy, minor = (dx >= dy) ? dy : dx;
+    int x = x0, y = y0, error = major;
+    for (int i = 0; i <= major; i++)
+    {
+        if (LegacyGetCell(x, y) & mask)
+        {
+            *pHitX = x;
+            *pHitY = y;
+            return TRUE;
+        }
+        error += 2 * minor;
+        BOOL minorStep = error >= 2 * major;
+        if (minorStep)
+        {
+            error -= 2 * major;
+        }
+        if (dx >= dy)
+        {
+            x += sx;
+            y += minorStep ? sy : 0;
+        }
+        else
+        {
+            y += sy;
+            x += minorStep ? sx : 0;
+        }
+    }
+    return FALSE;
+}
+
+static BOOL LegacyTestRect(int x, int y, int w, int h, WORD mask)
+{
+    for (int row = y; row < y + h; row++)
+    {
+        for (int col = x; col < x + w; col++)
+        {
+            if (LegacyGetCell(col, row) & mask)
+            {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+// =============================================================================
+// LEVEL
+// =============================================================================
+
+typedef struct Door
+{
+    int x, y, w, h;
+    BOOL closed;
+} Door;
+
+static std::vector<WORD> g_level;
+static std::vector<Door> g_doors;
+
+static void FillRect(int x0, int y0, int w, int h, WORD flags)
+{
+    for (int y = y0; y < y0 + h && y < LEVEL_SIZE; y++)
+    {
+        for (int x = x0; x < x0 + w && x < LEVEL_SIZE; x++)
+        {
+            g_level[y * LEVEL_SIZE + x] = flags;
+        }
+    }
+}
+
+static void BuildLevel(void)
+{
+    g_level.assign(LEVEL_SIZE * LEVEL_SIZE, 0);
+    for (int r = 1; r < ROOMS_PER_SIDE; r++)
+    {
+        FillRect(r * ROOM_SIZE - 1, 0, 2, LEVEL_SIZE, COLLIDE_WALL);
+        FillRect(0, r * ROOM_SIZE - 1, LEVEL_SIZE, 2, COLLIDE_WALL);
+    }
+    for (int r = 1; r < ROOMS_PER_SIDE; r++)
+    {
+        for (int s = 0; s < ROOMS_PER_SIDE; s++)
+        {
+            for (int vertical = 0; vertical < 2; vertical++)
+            {
+                int width = RandomRange(4, 12);
+                int offset = s * ROOM_SIZE + RandomRange(3, ROOM_SIZE - 4 - width);
+                Door door = {vertical ? r * ROOM_SIZE - 1 : offset, vertical ? offset : r * ROOM_SIZE - 1,
+                             vertical ? 2 : width, vertical ? width : 2, FALSE};
+                FillRect(door.x, door.y, door.w, door.h, 0);
+                g_doors.push_back(door);
+            }
+        }
+    }
+    for (int room = 0; room < ROOMS_PER_SIDE * ROOMS_PER_SIDE; room++)
+    {
+        int rx = (room % ROOMS_PER_SIDE) * ROOM_SIZE, ry = (room / ROOMS_PER_SIDE) * ROOM_SIZE;
+        for (int i = 0; i < 6; i++)
+        {
+            FillRect(rx + RandomRange(3, ROOM_SIZE - 8), ry + RandomRange(3, ROOM_SIZE - 8), RandomRange(1, 3),
+                     RandomRange(1, 3), COLLIDE_BLOCK_PLAYER | COLLIDE_BLOCK_MISSILE);
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            FillRect(rx + RandomRange(3, ROOM_SIZE - 10), ry + RandomRange(3, ROOM_SIZE - 10), RandomRange(3, 6),
+                     RandomRange(3, 6), COLLIDE_BLOCK_PLAYER);
+        }
+    }
+
+    for (int room = 0; room < ROOMS_PER_SIDE * ROOMS_PER_SIDE; room++)
+    {
+        LegacyRoom *pRoom = (LegacyRoom *)calloc(1, sizeof(LegacyRoom));
+        pRoom->x = (room % ROOMS_PER_SIDE) * ROOM_SIZE;
+        pRoom->y = (room / ROOMS_PER_SIDE) * ROOM_SIZE;
+        pRoom->width = ROOM_SIZE;
+        pRoom->height = ROOM_SIZE;
+        pRoom->pCollision = (WORD *)malloc(ROOM_SIZE * ROOM_SIZE * sizeof(WORD));
+        for (int y = 0; y < ROOM_SIZE; y++)
+        {
+            memcpy(&pRoom->pCollision[y * ROOM_SIZE], &g_level[(pRoom->y + y) * LEVEL_SIZE + pRoom->x],
+                   ROOM_SIZE * sizeof(WORD));
+        }
+        g_rooms[room] = pRoom;
+    }
+}
+
+static void FreeLevel(void)
+{
+    for (int room = 0; room < ROOMS_PER_SIDE * ROOMS_PER_SIDE; room++)
+    {
+        free(g_rooms[room]->pCollision);
+        free(g_rooms[room]);
+    }
+}
+
+// =============================================================================
+// FIGHT
+// =============================================================================
+
+typedef struct Missile
+{
+    int x, y;
+    int vx, vy;
+} Missile;
+
+typedef struct Shooter
+{
+    int x, y;
+} Shooter;
+
+static std::vector<Shooter> g_shooters;
+
+static void SpawnMissile(Missile *pMissile)
+{
+    const Shooter *pShooter = &g_shooters[NextRandom() % g_shooters.size()];
+    pMissile->x = pShooter->x;
+    pMissile->y = pShooter->y;
+    do
+    {
+        pMissile->vx = RandomRange(-12, 12);
+        pMissile->vy = RandomRange(-12, 12);
+    } while (abs(pMissile->vx) < 2 && abs(pMissile->vy) < 2);
+}
+
+static void ToggleDoor(Door *pDoor, CollisionMap *pMap)
+{
+    pDoor->closed = !pDoor->closed;
+    for (int y = pDoor->y; y < pDoor->y + pDoor->h; y++)
+    {
+        for (int x = pDoor->x; x < pDoor->x + pDoor->w; x++)
+        {
+            if (pMap)
+            {
+                COLMAP_SetCell(pMap, x, y, pDoor->closed ? COLLIDE_DOOR : 0);
+            }
+            else
+            {
+                LegacySetCell(x, y, pDoor->closed ? COLLIDE_DOOR : 0);
+            }
+        }
+    }
+}
+
+typedef struct FightResult
+{
+    double seconds;
+    uint64_t sweeps;
+    uint64_t hits;
+    std::vector<DWORD> log; // Per sweep: hit << 31 | y << 16 | x (hits only carry a cell)
+} FightResult;
+
+static DWORD LogEntry(BOOL hit, int x, int y)
+{
+    return hit ? (0x80000000u | ((DWORD)y << 16) | (DWORD)x) : 0;
+}
+
+// pMap NULL runs the room baseline
+static FightResult RunFight(CollisionMap *pMap, DWORD missileCount, DWORD ticks, DWORD seed)
+{
+    FightResult result;
+    result.seconds = 0;
+    result.sweeps = 0;
+    result.hits = 0;
+    result.log.reserve((size_t)missileCount * ticks);
+
+    g_rng = seed;
+    std::vector<Missile> missiles(missileCount);
+    for (DWORD i = 0; i < missileCount; i++)
+    {
+        SpawnMissile(&missiles[i]);
+    }
+    std::vector<CollisionSweep> sweeps(missileCount);
+    std::vector<CollisionHit> hits(missileCount);
+
+    for (DWORD tick = 0; tick < ticks; tick++)
+    {
+        if (tick % 10 == 0)
+        {
+            for (DWORD d = 0; d < DOORS_TOGGLED; d++)
+            {
+                ToggleDoor(&g_doors[(tick / 10 * DOORS_TOGGLED + d * 13) % g_doors.size()], pMap);
+            }
+        }
+
+        for (DWORD i = 0; i < missileCount; i++)
+        {
+            Missile *pMissile = &missiles[i];
+            int toX = pMissile->x + pMissile->vx, toY = pMissile->y + pMissile->vy;
+            sweeps[i].fromX = (WORD)pMissile->x;
+            sweeps[i].fromY = (WORD)pMissile->y;
+            sweeps[i].toX = (WORD)((toX < 0) ? 0xFFFF : toX);
+            sweeps[i].toY = (WORD)((toY < 0) ? 0xFFFF : toY);
+        }
+
+        // Only the collision work is timed; moving and respawning is the same in both runs
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (pMap)
+        {
+            result.hits += COLMAP_SweepMissiles(pMap, sweeps.data(), missileCount, hits.data());
+        }
+        else
+        {
+            for (DWORD i = 0; i < missileCount; i++)
+            {
+                int toX = (sweeps[i].toX == 0xFFFF) ? -1 : sweeps[i].toX;
+                int toY = (sweeps[i].toY == 0xFFFF) ? -1 : sweeps[i].toY;
+                int hitX, hitY;
+                hits[i].hit = LegacySweep(sweeps[i].fromX, sweeps[i].fromY, toX, toY, COLPLANE_DEFAULT_MISSILE,
+                                          &hitX, &hitY);
+                hits[i].x = (WORD)hitX;
+                hits[i].y = (WORD)hitY;
+                result.hits += hits[i].hit ? 1 : 0;
+            }
+        }
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (DWORD i = 0; i < missileCount; i++)
+        {
+            result.log.push_back(LogEntry(hits[i].hit, hits[i].x, hits[i].y));
+            if (hits[i].hit)
+            {
+                SpawnMissile(&missiles[i]);
+            }
+            else
+            {
+                missiles[i].x = sweeps[i].toX;
+                missiles[i].y = sweeps[i].toY;
+            }
+        }
+        result.sweeps += missileCount;
+    }
+
+    // Leave the doors as they started
+    for (size_t d = 0; d < g_doors.size(); d++)
+    {
+        if (g_doors[d].closed)
+        {
+            ToggleDoor(&g_doors[d], pMap);
+        }
+    }
+    return result;
+}
+
+// =============================================================================
+// LOS AND FOOTPRINTS
+// =============================================================================
+
+typedef struct Line
+{
+    WORD x0, y0, x1, y1;
+} Line;
+
+static std::vector<Line> MakeLines(DWORD count, int range)
+{
+    std::vector<Line> lines(count);
+    for (DWORD i = 0; i < count; i++)
+    {
+        int x0 = RandomRange(FIGHT_MIN, FIGHT_MAX), y0 = RandomRange(FIGHT_MIN, FIGHT_MAX);
+        lines[i].x0 = (WORD)x0;
+        lines[i].y0 = (WORD)y0;
+        lines[i].x1 = (WORD)(x0 + RandomRange(-range, range));
+        lines[i].y1 = (WORD)(y0 + RandomRange(-range, range));
+    }
+    return lines;
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+    DWORD missileCount = (argc > 1) ? (DWORD)atoi(argv[1]) : 4000;
+    DWORD ticks = (argc > 2) ? (DWORD)atoi(argv[2]) : 500;
+    if (missileCount < 1)
+    {
+        missileCount = 1;
+    }
+    if (ticks < 1)
+    {
+        ticks = 1;
+    }
+
+    BuildLevel();
+    for (DWORD i = 0; i < SHOOTERS; i++)
+    {
+        Shooter shooter;
+        do
+        {
+            shooter.x = RandomRange(FIGHT_MIN, FIGHT_MAX);
+            shooter.y = RandomRange(FIGHT_MIN, FIGHT_MAX);
+        } while (g_level[shooter.y * LEVEL_SIZE + shooter.x] & COLPLANE_DEFAULT_MISSILE);
+        g_shooters.push_back(shooter);
+    }
+
+    CollisionMapDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.width = LEVEL_SIZE;
+    desc.height = LEVEL_SIZE;
+    desc.pCollision = g_level.data();
+    CollisionMap *pMap = COLMAP_Create(&desc);
+    if (!pMap)
+    {
+        printf("COLMAP_Create failed\n");
+        return 1;
+    }
+
+    // --- Missile fight ---
+    FightResult legacyFight = RunFight(NULL, missileCount, ticks, 0xF1647);
+    FightResult planeFight = RunFight(pMap, missileCount, ticks, 0xF1647);
+    DWORD fightMismatches = (legacyFight.log.size() != planeFight.log.size()) ? 1 : 0;
+    for (size_t i = 0; !fightMismatches && i < legacyFight.log.size(); i++)
+    {
+        fightMismatches += (legacyFight.log[i] != planeFight.log[i]) ? 1 : 0;
+    }
+
+    // --- Line of sight ---
+    g_rng = 0x5165;
+    std::vector<Line> lines = MakeLines(LOS_QUERIES, LOS_RANGE);
+    std::vector<BYTE> legacyLos(LOS_QUERIES), planeLos(LOS_QUERIES);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < LOS_QUERIES; i++)
+    {
+        int hitX, hitY;
+        legacyLos[i] = !LegacySweep(lines[i].x0, lines[i].y0, lines[i].x1, lines[i].y1, COLPLANE_DEFAULT_SIGHT,
+                                    &hitX, &hitY);
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < LOS_QUERIES; i++)
+    {
+        planeLos[i] = (BYTE)COLMAP_LineOfSight(pMap, lines[i].x0, lines[i].y0, lines[i].x1, lines[i].y1);
+    }
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    DWORD losMismatches = 0, losClear = 0;
+    for (DWORD i = 0; i < LOS_QUERIES; i++)
+    {
+        losMismatches += (legacyLos[i] != planeLos[i]) ? 1 : 0;
+        losClear += planeLos[i];
+    }
+    double legacyLosSeconds = std::chrono::duration<double>(t1 - t0).count();
+    double planeLosSeconds = std::chrono::duration<double>(t2 - t1).count();
+
+    // --- Unit footprints (walk plane, 1x1 to 3x3) ---
+    std::vector<Line> rects(RECT_QUERIES);
+    for (DWORD i = 0; i < RECT_QUERIES; i++)
+    {
+        rects[i].x0 = (WORD)RandomRange(FIGHT_MIN, FIGHT_MAX);
+        rects[i].y0 = (WORD)RandomRange(FIGHT_MIN, FIGHT_MAX);
+        rects[i].x1 = (WORD)RandomRange(1, 3);
+        rects[i].y1 = rects[i].x1;
+    }
+    std::vector<BYTE> legacyRect(RECT_QUERIES), planeRect(RECT_QUERIES);
+    t0 = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < RECT_QUERIES; i++)
+    {
+        legacyRect[i] = (BYTE)LegacyTestRect(rects[i].x0, rects[i].y0, rects[i].x1, rects[i].y1,
+                                             COLPLANE_DEFAULT_WALK);
+    }
+    t1 = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < RECT_QUERIES; i++)
+    {
+        planeRect[i] = (BYTE)COLMAP_TestRect(pMap, COLPLANE_WALK, rects[i].x0, rects[i].y0, rects[i].x1, rects[i].y1);
+    }
+    t2 = std::chrono::steady_clock::now();
+    DWORD rectMismatches = 0;
+    for (DWORD i = 0; i < RECT_QUERIES; i++)
+    {
+        rectMismatches += (legacyRect[i] != planeRect[i]) ? 1 : 0;
+    }
+    double legacyRectSeconds = std::chrono::duration<double>(t1 - t0).count();
+    double planeRectSeconds = std::chrono::duration<double>(t2 - t1).count();
+
+    CollisionMapStats stats;
+    COLMAP_GetStats(pMap, &stats);
+
+    // --- Cross-check: every plane, lines of every length, lines off the map, edits ---
+    DWORD lineMismatches = 0, linesChecked = 0;
+    static const WORD s_masks[COLPLANE_COUNT] = {COLPLANE_DEFAULT_WALK, COLPLANE_DEFAULT_MISSILE,
+                                                 COLPLANE_DEFAULT_SIGHT};
+    for (DWORD round = 0; round < 3; round++)
+    {
+        if (round == 1)
+        {
+            // Scatter single-cell edits
+            for (DWORD i = 0; i < 2000; i++)
+            {
+                int x = RandomRange(0, LEVEL_SIZE - 1), y = RandomRange(0, LEVEL_SIZE - 1);
+                WORD collision = (NextRandom() & 1) ? COLLIDE_BLOCK_MISSILE : 0;
+                LegacySetCell(x, y, collision);
+                COLMAP_SetCell(pMap, x, y, collision);
+            }
+        }
+        else if (round == 2)
+        {
+            // Replace a room wholesale, as when a room is reloaded
+            std::vector<WORD> room(ROOM_SIZE * ROOM_SIZE);
+            for (size_t i = 0; i < room.size(); i++)
+            {
+                room[i] = (NextRandom() % 5 == 0) ? COLLIDE_WALL : 0;
+            }
+            LegacyRoom *pRoom = g_rooms[5 * ROOMS_PER_SIDE + 5];
+            memcpy(pRoom->pCollision, room.data(), room.size() * sizeof(WORD));
+            COLMAP_LoadRect(pMap, pRoom->x, pRoom->y, ROOM_SIZE, ROOM_SIZE, room.data());
+        }
+
+        for (DWORD i = 0; i < 20000; i++)
+        {
+            int range = (i % 4 == 0) ? 300 : (i % 4 == 1) ? 64 : 12;
+            int x0 = RandomRange(0, LEVEL_SIZE - 1), y0 = RandomRange(0, LEVEL_SIZE - 1);
+            int x1 = x0 + RandomRange(-range, range), y1 = y0 + RandomRange(-range, range);
+            if (i % 50 == 0)
+            {
+                x1 = LEVEL_SIZE + RandomRange(0, 5); // Leaves the map
+            }
+            x1 = (x1 < 0) ? 0 : x1;
+            y1 = (y1 < 0) ? 0 : y1;
+            DWORD plane = i % COLPLANE_COUNT;
+
+            int legacyX = 0, legacyY = 0;
+            DWORD planeX = 0, planeY = 0;
+            BOOL legacyHit = LegacySweep(x0, y0, x1, y1, s_masks[plane], &legacyX, &legacyY);
+            BOOL planeHit = COLMAP_Sweep(pMap, (CollisionPlane)plane, x0, y0, x1, y1, &planeX, &planeY);
+            if (legacyHit != planeHit || (legacyHit && ((DWORD)legacyX != planeX || (DWORD)legacyY != planeY)))
+            {
+                lineMismatches++;
+            }
+            if (COLMAP_GetCell(pMap, x0, y0) != LegacyGetCell(x0, y0))
+            {
+                lineMismatches++;
+            }
+            linesChecked++;
+        }
+    }
+
+    printf("fight:   %u missiles, %u ticks, %u doors toggled every 10 ticks\n", missileCount, ticks, DOORS_TOGGLED);
+    printf("  rooms:  %8.3f ms/tick, %.1f ns/sweep, %llu hits\n", legacyFight.seconds * 1e3 / ticks,
+           legacyFight.seconds * 1e9 / (double)legacyFight.sweeps, (unsigned long long)legacyFight.hits);
+    printf("  planes: %8.3f ms/tick, %.1f ns/sweep, %llu hits (%.2fx)\n", planeFight.seconds * 1e3 / ticks,
+           planeFight.seconds * 1e9 / (double)planeFight.sweeps, (unsigned long long)planeFight.hits,
+           legacyFight.seconds / planeFight.seconds);
+    printf("los:     %u lines up to %u subtiles, %u clear\n", LOS_QUERIES, LOS_RANGE, losClear);
+    printf("  rooms:  %8.1f ns/line\n", legacyLosSeconds * 1e9 / LOS_QUERIES);
+    printf("  planes: %8.1f ns/line (%.2fx)\n", planeLosSeconds * 1e9 / LOS_QUERIES, legacyLosSeconds / planeLosSeconds);
+    printf("rects:   %u footprints 1x1..3x3\n", RECT_QUERIES);
+    printf("  rooms:  %8.1f ns/test\n", legacyRectSeconds * 1e9 / RECT_QUERIES);
+    printf("  planes: %8.1f ns/test (%.2fx)\n", planeRectSeconds * 1e9 / RECT_QUERIES,
+           legacyRectSeconds / planeRectSeconds);
+    printf("stats:   %llu lines, %llu runs, %llu words, %llu edits\n", (unsigned long long)stats.lineTests,
+           (unsigned long long)stats.runTests, (unsigned long long)stats.wordTests, (unsigned long long)stats.edits);
+    printf("verify:  fight %s, los %u mismatches, rects %u mismatches -> %s\n",
+           fightMismatches ? "diverged" : "identical", losMismatches, rectMismatches,
+           (fightMismatches || losMismatches || rectMismatches) ? "FAILED" : "ok");
+    printf("verify:  %u random lines across planes, edits and map edges: %u mismatches -> %s\n", linesChecked,
+           lineMismatches, lineMismatches ? "FAILED" : "ok");
+
+    COLMAP_Destroy(pMap);
+    FreeLevel();
+    return (fightMismatches || losMismatches || rectMismatches || lineMismatches) ? 1 : 0;
+}
@@ -0,0 +1,454 @@
+/*
+ * BenchDataTables.cpp - Compiled D2Common table benchmark
+ *
+ * Synthetic excel sheets with the real row counts and a realistic number of
+ * unused columns (missiles, skills, monstats, levels, weapons) are:
+ *
+ *   1. parsed at startup, the way DATATBLS does today (text parse, link
+ *      resolution, index build; timed through the compiler front end),
+ *   2. compiled offline, written to disk, then cold-opened by mapping,
+ *
+ * and compared for startup time. Lookups by key are timed against a binary
+ * search over sorted key hashes (Fog's txt link tables). Every key, link and
+ * value is verified against the source text, and truncated/corrupted files
+ * must be rejected.
+ *
+ * Usage: bench_datatables [repeats]
+ */
+
+#include "../Common/DataTableCompiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define PAD_COLUMNS 80 // Sheet columns no native code reads
+
+typedef struct BenchTable
+{
+    const DataTableSchema *pSchema;
+    DWORD rows;
+    std::vector<std::vector<std::string> > cells; // [row][schema column]
+    std::vector<std::string> keys;
+    std::string text;
+} BenchTable;
+
+static const char *s_tableOrder[] = {"missiles", "skills", "monstats", "levels", "weapons"};
+static const DWORD s_rowCounts[] = {385, 357, 704, 150, 306};
+static BenchTable g_tables[5];
+
+static DWORD g_rng = 12345;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static BenchTable *FindBenchTable(const char *szName)
+{
+    for (DWORD t = 0; t < 5; t++)
+    {
+        if (strcmp(g_tables[t].pSchema->szName, szName) == 0)
+        {
+            return &g_tables[t];
+        }
+    }
+    return NULL;
+}
+
+static std::string MakeKey(const DataTableSchema *pSchema, DWORD row)
+{
+    char sz[64];
+    if (strcmp(pSchema->szName, "weapons") == 0)
+    {
+        // 3-char item codes, as in weapons.txt
+        sz[0] = (char)('a' + row / 676 % 26);
+        sz[1] = (char)('a' + row / 26 % 26);
+        sz[2] = (char)('a' + row % 26);
+        sz[3] = '\0';
+    }
+    else
+    {
+        snprintf(sz, sizeof(sz), "%s%u", pSchema->szName, row * 7 + 3);
+    }
+    return sz;
+}
+
+static std::string MakeValue(const DataColumnSchema *pColumn)
+{
+    static const char *s_codes[] = {"fire", "ltng", "cold", "pois", "mag", "ama", "sor", "nec", "h2h", "rng"};
+    char sz[32];
+
+    switch (pColumn->type)
+    {
+    case DTCOL_STRING:
+        snprintf(sz, sizeof(sz), "str%u", NextRandom() % 400);
+        return sz;
+    case DTCOL_CODE:
+        return (NextRandom() % 5 == 0) ? std::string() : std::string(s_codes[NextRandom() % 10]);
+    case DTCOL_LINK:
+    {
+        if (NextRandom() % 4 == 0)
+            return std::string();
+        BenchTable *pTarget = FindBenchTable(pColumn->szLinkTable);
+        return pTarget->keys[NextRandom() % pTarget->rows];
+    }
+    case DTCOL_U8:
+        snprintf(sz, sizeof(sz), "%u", NextRandom() % 256);
+        return sz;
+    case DTCOL_I8:
+        snprintf(sz, sizeof(sz), "%d", (int)(NextRandom() % 256) - 128);
+        return sz;
+    case DTCOL_U16:
+        snprintf(sz, sizeof(sz), "%u", NextRandom() % 65536);
+        return sz;
+    case DTCOL_I16:
+        snprintf(sz, sizeof(sz), "%d", (int)(NextRandom() % 65536) - 32768);
+        return sz;
+    default:
+        snprintf(sz, sizeof(sz), "%d", (int)(NextRandom() % 2000000) - 1000000);
+        return sz;
+    }
+}
+
+static void GenerateTables(void)
+{
+    // Keys first: links may point at any table
+    for (DWORD t = 0; t < 5; t++)
+    {
+        BenchTable *pTable = &g_tables[t];
+        pTable->pSchema = DATACOMPILER_FindSchema(s_tableOrder[t]);
+        pTable->rows = s_rowCounts[t];
+        for (DWORD r = 0; r < pTable->rows; r++)
+        {
+            pTable->keys.push_back(MakeKey(pTable->pSchema, r));
+        }
+    }
+
+    for (DWORD t = 0; t < 5; t++)
+    {
+        BenchTable *pTable = &g_tables[t];
+        const DataTableSchema *pSchema = pTable->pSchema;
+        std::string &text = pTable->text;
+        char sz[32];
+
+        // Header: schema columns interleaved with unused ones
+        for (DWORD c = 0; c < pSchema->columnCount + PAD_COLUMNS; c++)
+        {
+            if (c)
+                text += '\t';
+            if (c % 4 == 0 && c / 4 < pSchema->columnCount)
+            {
+                text += pSchema->pColumns[c / 4].szColumn;
+            }
+            else
+            {
+                snprintf(sz, sizeof(sz), "unused%u", c);
+                text += sz;
+            }
+        }
+        text += "\r\n";
+
+        for (DWORD r = 0; r < pTable->rows; r++)
+        {
+            if (r == pTable->rows / 2)
+            {
+                text += "Expansion\r\n";
+            }
+
+            std::vector<std::string> row(pSchema->columnCount);
+            for (DWORD c = 0; c < pSchema->columnCount; c++)
+            {
+                row[c] = (strcmp(pSchema->pColumns[c].szColumn, pSchema->szKeyColumn) == 0)
+                             ? pTable->keys[r]
+                             : MakeValue(&pSchema->pColumns[c]);
+            }
+
+            for (DWORD c = 0; c < pSchema->columnCount + PAD_COLUMNS; c++)
+            {
+                if (c)
+                    text += '\t';
+                if (c % 4 == 0 && c / 4 < pSchema->columnCount)
+                {
+                    text += row[c / 4];
+                }
+                else
+                {
+                    snprintf(sz, sizeof(sz), "%u", NextRandom() % 1000);
+                    text += sz;
+                }
+            }
+            text += "\r\n";
+            pTable->cells.push_back(row);
+        }
+    }
+}
+
+static DataCompiler *ParseAll(void)
+{
+    DataCompiler *pCompiler = DATACOMPILER_Create();
+    for (DWORD t = 0; t < 5; t++)
+    {
+        if (!DATACOMPILER_AddTable(pCompiler, g_tables[t].pSchema, g_tables[t].text.c_str(), g_tables[t].text.size()))
+        {
+            printf("parse failed: %s\n", DATACOMPILER_GetError(pCompiler));
+            exit(1);
+        }
+    }
+    return pCompiler;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// =============================================================================
+// VERIFICATION
+// =============================================================================
+
+static BOOL VerifyTable(const DataTable *pTable, const BenchTable *pSource)
+{
+    const DataTableSchema *pSchema = pSource->pSchema;
+    DWORD errors = 0;
+
+    if (DATATABLE_GetRecordCount(pTable) != pSource->rows)
+    {
+        return FALSE;
+    }
+
+    for (DWORD r = 0; r < pSource->rows; r++)
+    {
+        if (DATATABLE_FindRecord(pTable, pSource->keys[r].c_str()) != r)
+        {
+            errors++;
+        }
+
+        for (DWORD c = 0; c < pSchema->columnCount; c++)
+        {
+            const DataColumnSchema *pColumn = &pSchema->pColumns[c];
+            const std::string &text = pSource->cells[r][c];
+            int column = DATATABLE_FindColumn(pTable, pColumn->szColumn);
+            int32_t value = DATATABLE_GetInt(pTable, column, r);
+
+            if (pColumn->type == DTCOL_STRING)
+            {
+                errors += text != DATATABLE_GetCellString(pTable, column, r);
+            }
+            else if (pColumn->type == DTCOL_CODE)
+            {
+                errors += (DWORD)value != (text.empty() ? 0 : DATATABLE_PackCode(text.c_str()));
+            }
+            else if (pColumn->type == DTCOL_LINK)
+            {
+                DWORD t = 0;
+                while (strcmp(s_tableOrder[t], pColumn->szLinkTable) != 0)
+                    t++;
+                const BenchTable *pTarget = &g_tables[t];
+                errors += text.empty() ? (value != DATATABLE_NO_LINK)
+                                       : (value >= (int32_t)pTarget->rows || pTarget->keys[value] != text);
+            }
+            else
+            {
+                errors += value != atoi(text.c_str());
+            }
+        }
+    }
+
+    // Absent keys must miss
+    const char *szMissing[] = {"nosuchkey", "zzzz", "", "missiles1"};
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(szMissing); i++)
+    {
+        errors += DATATABLE_FindRecord(pTable, szMissing[i]) != DATATABLE_NO_RECORD;
+    }
+
+    return errors == 0;
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+typedef struct SortedKey
+{
+    DWORD hash;
+    DWORD record;
+} SortedKey;
+
+static bool SortedKeyLess(const SortedKey &a, const SortedKey &b)
+{
+    return a.hash < b.hash;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD repeats = (argc > 1) ? (DWORD)atoi(argv[1]) : 20;
+    BOOL ok = TRUE;
+
+    GenerateTables();
+    size_t textBytes = 0;
+    for (DWORD t = 0; t < 5; t++)
+    {
+        textBytes += g_tables[t].text.size();
+    }
+
+    // ------------------------------------------------------- parse at startup
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < repeats; i++)
+    {
+        DataCompiler *pCompiler = ParseAll();
+        for (DWORD t = 0; t < 5; t++)
+        {
+            BYTE *pBlob;
+            DWORD size;
+            DATACOMPILER_Compile(pCompiler, s_tableOrder[t], &pBlob, &size);
+            free(pBlob);
+        }
+        DATACOMPILER_Destroy(pCompiler);
+    }
+    double parseMs = Seconds(start) * 1000.0 / repeats;
+
+    // --------------------------------------------------------- compile + write
+    DataCompiler *pCompiler = ParseAll();
+    size_t compiledBytes = 0;
+    char szPaths[5][64];
+    for (DWORD t = 0; t < 5; t++)
+    {
+        snprintf(szPaths[t], sizeof(szPaths[t]), "bench_%s.d2t", s_tableOrder[t]);
+        if (!DATACOMPILER_WriteFile(pCompiler, s_tableOrder[t], szPaths[t]))
+        {
+            printf("compile failed: %s\n", DATACOMPILER_GetError(pCompiler));
+            return 1;
+        }
+    }
+
+    // ---------------------------------------------------------- mapped open
+    DataTable *pTables[5];
+    start = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < repeats; i++)
+    {
+        for (DWORD t = 0; t < 5; t++)
+        {
+            pTables[t] = DATATABLE_Open(szPaths[t], 0);
+        }
+        for (DWORD t = 0; t < 5 && i + 1 < repeats; t++)
+        {
+            DATATABLE_Close(pTables[t]);
+        }
+    }
+    double openMs = Seconds(start) * 1000.0 / repeats;
+
+    start = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < repeats; i++)
+    {
+        for (DWORD t = 0; t < 5; t++)
+        {
+            DATATABLE_Close(DATATABLE_Open(szPaths[t], DATATABLE_OPEN_VERIFY));
+        }
+    }
+    double verifyMs = Seconds(start) * 1000.0 / repeats;
+
+    for (DWORD t = 0; t < 5; t++)
+    {
+        if (!pTables[t])
+        {
+            printf("open failed: %s\n", szPaths[t]);
+            return 1;
+        }
+        compiledBytes += DATATABLE_GetHeader(pTables[t])->fileSize;
+    }
+
+    printf("tables:  5 sheets, %u records, %.0f KB of text -> %.0f KB compiled\n",
+           s_rowCounts[0] + s_rowCounts[1] + s_rowCounts[2] + s_rowCounts[3] + s_rowCounts[4], textBytes / 1024.0,
+           compiledBytes / 1024.0);
+    printf("startup: parse .txt %.3f ms | map .d2t %.4f ms (%.0fx) | map + checksum %.4f ms\n", parseMs, openMs,
+           openMs > 0 ? parseMs / openMs : 0.0, verifyMs);
+
+    // ---------------------------------------------------------------- verify
+    for (DWORD t = 0; t < 5; t++)
+    {
+        BOOL tableOk = VerifyTable(pTables[t], &g_tables[t]);
+        printf("verify:  %-9s %4u records, %2u columns, %3u hash slots -> %s\n", s_tableOrder[t],
+               DATATABLE_GetRecordCount(pTables[t]), DATATABLE_GetHeader(pTables[t])->columnCount,
+               DATATABLE_GetHeader(pTables[t])->hashSize, tableOk ? "ok" : "FAILED");
+        ok &= tableOk;
+    }
+
+    // Damaged files must be refused
+    BYTE *pBlob;
+    DWORD size;
+    DATACOMPILER_Compile(pCompiler, "monstats", &pBlob, &size);
+    DataTable *pTruncated = DATATABLE_OpenMemory(pBlob, size - 9, 0);
+    pBlob[size / 2] ^= 0x5A;
+    DataTable *pFlipped = DATATABLE_OpenMemory(pBlob, size, DATATABLE_OPEN_VERIFY);
+    BOOL damageOk = !pTruncated && !pFlipped;
+    printf("verify:  truncated and corrupted files rejected -> %s\n", damageOk ? "ok" : "FAILED");
+    ok &= damageOk;
+    DATATABLE_Close(pTruncated);
+    DATATABLE_Close(pFlipped);
+    free(pBlob);
+    DATACOMPILER_Destroy(pCompiler);
+
+    // --------------------------------------------------------------- lookups
+    const DataTable *pMonstats = pTables[2];
+    const BenchTable *pSource = &g_tables[2];
+    std::vector<SortedKey> sorted(pSource->rows);
+    for (DWORD r = 0; r < pSource->rows; r++)
+    {
+        sorted[r].hash = DATATABLE_HashKey(pSource->keys[r].c_str());
+        sorted[r].record = r;
+    }
+    std::sort(sorted.begin(), sorted.end(), SortedKeyLess);
+
+    const DWORD lookups = 2000000;
+    DWORD checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < lookups; i++)
+    {
+        checksum += DATATABLE_FindRecord(pMonstats, pSource->keys[(i * 2654435761u) % pSource->rows].c_str());
+    }
+    double perfectNs = Seconds(start) * 1e9 / lookups;
+
+    start = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < lookups; i++)
+    {
+        const char *szKey = pSource->keys[(i * 2654435761u) % pSource->rows].c_str();
+        SortedKey probe = {DATATABLE_HashKey(szKey), 0};
+        std::vector<SortedKey>::iterator it = std::lower_bound(sorted.begin(), sorted.end(), probe, SortedKeyLess);
+        checksum -= (it != sorted.end() && it->hash == probe.hash) ? it->record : DATATABLE_NO_RECORD;
+    }
+    double sortedNs = Seconds(start) * 1e9 / lookups;
+    ok &= checksum == 0;
+
+    printf("lookup:  monstats by Id: perfect hash %.1f ns, sorted-hash binary search %.1f ns (%.2fx)\n", perfectNs,
+           sortedNs, perfectNs > 0 ? sortedNs / perfectNs : 0.0);
+
+    // Column scan: one contiguous array, no record stride
+    int column = DATATABLE_FindColumn(pMonstats, "Level");
+    const BYTE *pLevels = (const BYTE *)DATATABLE_GetColumnData(pMonstats, column);
+    DWORD total = 0;
+    start = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < 10000; i++)
+    {
+        for (DWORD r = 0; r < pSource->rows; r++)
+        {
+            total += pLevels[r];
+        }
+    }
+    printf("scan:    monstats.Level column %.2f ns/record (sum %u)\n",
+           Seconds(start) * 1e9 / (10000.0 * pSource->rows), total);
+
+    for (DWORD t = 0; t < 5; t++)
+    {
+        DATATABLE_Close(pTables[t]);
+        remove(szPaths[t]);
+    }
+    return ok ? 0 : 1;
+}
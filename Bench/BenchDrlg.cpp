@@ -0,0 +1,333 @@
+/*
+ * BenchDrlg.cpp - Level generation for every act, per game vs shared service
+ *
+ * Builds all five acts (every level of the built-in table) for a run of
+ * game seeds. The DS1 presets are synthetic but sized like the real ones:
+ * 8x8 tile ground cells and maze rooms, full-size towns and boss maps, two
+ * wall and two floor layers, objects. Loading a preset copies it out of an
+ * in-memory "MPQ" the way SFileReadFile fills a fresh buffer.
+ *
+ *   per game: the game's behaviour - each game owns its presets, loads and
+ *             decodes every one it uses, generates level after level on
+ *             one thread and frees it all with the game.
+ *   service:  one PresetStore for the whole run and a DrlgService worker
+ *             pool; a few games are queued ahead (PrefetchAct for all acts)
+ *             while the current one is consumed through GetLevel.
+ *
+ * Every layout hash must match between the two, and again between two
+ * services with different worker counts (determinism).
+ *
+ * Usage: bench_drlg [seeds] [workers]
+ */
+
+#include "../Common/DrlgService.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define GAMES_AHEAD 4
+
+// =============================================================================
+// SYNTHETIC PRESETS
+// =============================================================================
+
+typedef struct PresetArchive
+{
+    std::vector<std::vector<BYTE>> files; // Indexed by preset id; empty = missing
+} PresetArchive;
+
+static DWORD g_rng = 0xD51;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static void PutDword(std::vector<BYTE> &out, DWORD value)
+{
+    out.push_back((BYTE)value);
+    out.push_back((BYTE)(value >> 8));
+    out.push_back((BYTE)(value >> 16));
+    out.push_back((BYTE)(value >> 24));
+}
+
+// Version 18 DS1: 2 wall layers, 2 floor layers, shadow, no tag layer
+static std::vector<BYTE> MakeDs1(DWORD width, DWORD height, DWORD act, DWORD objects)
+{
+    static const char *s_files[] = {"/d2/data/global/tiles/act1/outdoors/floor.tg1",
+                                    "/d2/data/global/tiles/act1/outdoors/cliffs.tg1"};
+    std::vector<BYTE> out;
+    PutDword(out, 18);
+    PutDword(out, width - 1);
+    PutDword(out, height - 1);
+    PutDword(out, act);
+    PutDword(out, 0); // Tag type
+    PutDword(out, 2);
+    for (DWORD i = 0; i < 2; i++)
+    {
+        out.insert(out.end(), s_files[i], s_files[i] + strlen(s_files[i]) + 1);
+    }
+    PutDword(out, 2); // Wall layers
+    PutDword(out, 2); // Floor layers
+
+    DWORD cells = width * height;
+    for (DWORD layer = 0; layer < 2 * 2 + 2 + 1; layer++)
+    {
+        for (DWORD i = 0; i < cells; i++)
+        {
+            // Mostly empty walls, every floor cell set (prop bytes + main index)
+            DWORD value = NextRandom();
+            PutDword(out, (layer < 4 && (value & 7)) ? 0 : value);
+        }
+    }
+
+    PutDword(out, objects);
+    for (DWORD i = 0; i < objects; i++)
+    {
+        PutDword(out, 1 + (NextRandom() & 1));
+        PutDword(out, NextRandom() % 600);
+        PutDword(out, NextRandom() % (width * 5));
+        PutDword(out, NextRandom() % (height * 5));
+        PutDword(out, 0);
+    }
+    // Groups / paths the decoder skips
+    PutDword(out, 0);
+    PutDword(out, 0);
+    return out;
+}
+
+static void BuildArchive(PresetArchive *pArchive, const DrlgLevelDef *pLevels, DWORD levelCount)
+{
+    pArchive->files.assign(DRLG_GetPresetLimit(pLevels, levelCount), std::vector<BYTE>());
+
+    for (DWORD i = 0; i < levelCount; i++)
+    {
+        const DrlgLevelDef *pLevel = &pLevels[i];
+        DWORD first = DRLG_PRESET_ID(pLevel->style, 0);
+        if (!pArchive->files[first].empty())
+        {
+            continue; // Style shared with an earlier level
+        }
+
+        if (pLevel->type == DRLGTYPE_PRESET)
+        {
+            pArchive->files[first] = MakeDs1(pLevel->sizeX, pLevel->sizeY, pLevel->act, 40);
+            continue;
+        }
+        for (DWORD j = 0; j < DRLG_STYLE_PRESETS; j++)
+        {
+            pArchive->files[first + j] = MakeDs1(DRLG_CELL_TILES, DRLG_CELL_TILES, pLevel->act, NextRandom() % 4);
+        }
+    }
+}
+
+// SFileReadFile into a new buffer
+static BOOL __cdecl ArchiveLoad(void *pContext, DWORD presetId, const void **ppData, size_t *pSize)
+{
+    PresetArchive *pArchive = (PresetArchive *)pContext;
+    if (presetId >= pArchive->files.size() || pArchive->files[presetId].empty())
+    {
+        return FALSE;
+    }
+    const std::vector<BYTE> &file = pArchive->files[presetId];
+    void *pCopy = malloc(file.size());
+    memcpy(pCopy, file.data(), file.size());
+    *ppData = pCopy;
+    *pSize = file.size();
+    return TRUE;
+}
+
+static void __cdecl ArchiveFree(void *pContext, const void *pData)
+{
+    (void)pContext;
+    free((void *)pData);
+}
+
+// =============================================================================
+// RUNS
+// =============================================================================
+
+typedef struct Totals
+{
+    uint64_t rooms;
+    uint64_t tiles;
+    uint64_t objects;
+    DWORD badLayouts; // Missing level, or entrance/exit rules broken
+} Totals;
+
+static void CheckLayout(const DrlgLayout *pLayout, Totals *pTotals)
+{
+    if (!pLayout)
+    {
+        pTotals->badLayouts++;
+        return;
+    }
+
+    DWORD entrances = 0, exits = 0;
+    for (DWORD i = 0; i < pLayout->roomCount; i++)
+    {
+        entrances += (pLayout->pRooms[i].flags & DRLGROOM_ENTRANCE) ? 1 : 0;
+        exits += (pLayout->pRooms[i].flags & DRLGROOM_EXIT) ? 1 : 0;
+    }
+    if (entrances != 1 || exits != (pLayout->type == DRLGTYPE_PRESET ? 0u : 1u))
+    {
+        pTotals->badLayouts++;
+    }
+    pTotals->rooms += pLayout->roomCount;
+    pTotals->tiles += (uint64_t)pLayout->width * pLayout->height;
+    pTotals->objects += pLayout->objectCount;
+}
+
+static double RunPerGame(PresetArchive *pArchive, const DrlgLevelDef *pLevels, DWORD levelCount, DWORD seeds,
+                         std::vector<uint64_t> &hashes, Totals *pTotals)
+{
+    PresetSource source = {ArchiveLoad, ArchiveFree, pArchive};
+    DWORD presetLimit = DRLG_GetPresetLimit(pLevels, levelCount);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (DWORD s = 0; s < seeds; s++)
+    {
+        // Presets live and die with the game
+        PresetStore *pStore = PRESETSTORE_Create(&source, presetLimit);
+        for (DWORD l = 0; l < levelCount; l++)
+        {
+            DrlgLayout *pLayout = DRLG_GenerateLevel(&pLevels[l], 1000 + s, pStore);
+            CheckLayout(pLayout, pTotals);
+            hashes[(size_t)s * levelCount + l] = pLayout ? pLayout->hash : 0;
+            DRLG_FreeLayout(pLayout);
+        }
+        PRESETSTORE_Destroy(pStore);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double RunService(PresetArchive *pArchive, const DrlgLevelDef *pLevels, DWORD levelCount, DWORD seeds,
+                         DWORD workers, std::vector<uint64_t> &hashes, double *pStallSeconds,
+                         DrlgServiceStats *pStats, PresetStoreStats *pStoreStats)
+{
+    PresetSource source = {ArchiveLoad, ArchiveFree, pArchive};
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PresetStore *pStore = PRESETSTORE_Create(&source, DRLG_GetPresetLimit(pLevels, levelCount));
+    DrlgServiceDesc desc = {pStore, pLevels, levelCount, workers};
+    DrlgService *pService = DRLGSERVICE_Create(&desc);
+
+    std::vector<DrlgGame *> games(seeds, (DrlgGame *)NULL);
+    for (DWORD s = 0; s < seeds + GAMES_AHEAD; s++)
+    {
+        // Queue a game a few seeds ahead of the one being consumed
+        if (s < seeds)
+        {
+            games[s] = DRLGSERVICE_OpenGame(pService, 1000 + s);
+            for (DWORD act = 0; act < DRLG_ACT_COUNT; act++)
+            {
+                DRLGSERVICE_PrefetchAct(pService, games[s], act);
+            }
+        }
+        if (s < GAMES_AHEAD)
+        {
+            continue;
+        }
+
+        // Time the game thread spends blocked in GetLevel
+        DWORD current = s - GAMES_AHEAD;
+        for (DWORD l = 0; l < levelCount; l++)
+        {
+            std::chrono::steady_clock::time_point get = std::chrono::steady_clock::now();
+            const DrlgLayout *pLayout = DRLGSERVICE_GetLevel(pService, games[current], pLevels[l].id);
+            *pStallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - get).count();
+            hashes[(size_t)current * levelCount + l] = pLayout ? pLayout->hash : 0;
+        }
+        DRLGSERVICE_CloseGame(pService, games[current]);
+    }
+
+    DRLGSERVICE_GetStats(pService, pStats);
+    PRESETSTORE_GetStats(pStore, pStoreStats);
+    DRLGSERVICE_Destroy(pService);
+    PRESETSTORE_Destroy(pStore);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static DWORD CountMismatches(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+    DWORD mismatches = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        mismatches += (a[i] != b[i] || !a[i]) ? 1 : 0;
+    }
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD seeds = (argc > 1) ? (DWORD)atoi(argv[1]) : 1000;
+    DWORD workers = (argc > 2) ? (DWORD)atoi(argv[2]) : std::thread::hardware_concurrency();
+    if (seeds < 1)
+    {
+        seeds = 1;
+    }
+    if (workers < 1)
+    {
+        workers = 1;
+    }
+
+    DWORD levelCount;
+    const DrlgLevelDef *pLevels = DRLG_GetDefaultLevels(&levelCount);
+    PresetArchive archive;
+    BuildArchive(&archive, pLevels, levelCount);
+
+    size_t archiveBytes = 0;
+    DWORD presetCount = 0;
+    for (size_t i = 0; i < archive.files.size(); i++)
+    {
+        archiveBytes += archive.files[i].size();
+        presetCount += archive.files[i].empty() ? 0 : 1;
+    }
+
+    std::vector<uint64_t> perGameHashes((size_t)seeds * levelCount), serviceHashes(perGameHashes.size()),
+        singleHashes(perGameHashes.size());
+    Totals totals;
+    memset(&totals, 0, sizeof(totals));
+    DrlgServiceStats stats, singleStats;
+    PresetStoreStats storeStats, singleStoreStats;
+
+    double perGameSeconds = RunPerGame(&archive, pLevels, levelCount, seeds, perGameHashes, &totals);
+    double serviceStall = 0, singleStall = 0;
+    double serviceSeconds = RunService(&archive, pLevels, levelCount, seeds, workers, serviceHashes, &serviceStall,
+                                       &stats, &storeStats);
+    double singleSeconds = RunService(&archive, pLevels, levelCount, seeds, 1, singleHashes, &singleStall,
+                                      &singleStats, &singleStoreStats);
+
+    DWORD serviceMismatches = CountMismatches(perGameHashes, serviceHashes);
+    DWORD workerMismatches = CountMismatches(serviceHashes, singleHashes);
+
+    printf("drlg:     %u seeds x %u levels (5 acts), %u presets (%.1f MB), %.1f rooms and %.0f tiles per game\n",
+           seeds, levelCount, presetCount, archiveBytes / 1048576.0, (double)totals.rooms / seeds,
+           (double)totals.tiles / seeds);
+    printf("  per game: %8.2f ms/game, all of it on the game thread (presets loaded + decoded per game)\n",
+           perGameSeconds * 1e3 / seeds);
+    printf("  service:  %8.2f ms/game (%.2fx), %6.2f ms blocked in GetLevel; %u workers, %u ahead / %u inline / %u "
+           "waits\n",
+           serviceSeconds * 1e3 / seeds, perGameSeconds / serviceSeconds, serviceStall * 1e3 / seeds, workers,
+           stats.builtAhead, stats.builtInline, stats.waits);
+    printf("  service:  %8.2f ms/game (%.2fx), %6.2f ms blocked in GetLevel; 1 worker\n", singleSeconds * 1e3 / seeds,
+           perGameSeconds / singleSeconds, singleStall * 1e3 / seeds);
+    printf("  presets:  %u decoded once for %u requests (%.1f MB resident)\n", storeStats.decoded,
+           storeStats.requests, storeStats.bytes / 1048576.0);
+    printf("verify:   per game vs service layouts: %u mismatches, %u bad layouts -> %s\n", serviceMismatches,
+           totals.badLayouts, (serviceMismatches || totals.badLayouts) ? "FAILED" : "ok");
+    printf("verify:   %u workers vs 1 worker: %u mismatches, %u failures -> %s\n", workers, workerMismatches,
+           stats.failures + singleStats.failures,
+           (workerMismatches || stats.failures || singleStats.failures) ? "FAILED" : "ok");
+
+    return (serviceMismatches || totals.badLayouts || workerMismatches || stats.failures || singleStats.failures)
+               ? 1
+               : 0;
+}
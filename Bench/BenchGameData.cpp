@@ -0,0 +1,718 @@
+/*
+ * BenchGameData.cpp - Static data per game vs one shared registry
+ *
+ * A synthetic data set sized like the real one: every table with a built-in
+ * schema compiled to .d2t, the three string tables, a palette and pl2
+ * transform set per act, and the DS1 presets of the built-in level table.
+ * Each game opens the data, decodes the presets of the act it plays and
+ * reads from everything.
+ *
+ *   per game: what a process per game does today - every game loads its
+ *             own copy of every file, opens its own tables and decodes its
+ *             own presets.
+ *   shared:   one GameData registry; every game acquires a view.
+ *
+ * Resident memory (Linux /proc/self/statm) and the bytes each mode holds
+ * are compared for the whole set of games; the games' checksums must match.
+ *
+ * Hot reload: reader threads run the games' refresh points while the main
+ * thread reloads the data repeatedly (and once with a failing load). Every
+ * view must be internally consistent (all items from one load), versions
+ * seen by a game never go backwards, every game ends on the last version,
+ * retired versions are freed once released, and the source frees every
+ * buffer it handed out.
+ *
+ * Usage: bench_gamedata [games] [reloads] [reader threads]
+ */
+
+#include "../Common/DataTableCompiler.hpp"
+#include "../Common/Drlg.hpp"
+#include "../Server/GameData.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#define TABLE_ROWS 400
+#define PL2_SIZE 443177 // Each act's pal.pl2: palette plus light/shift/blend transforms
+
+static DWORD g_rng = 0xDA7A;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+// =============================================================================
+// SYNTHETIC ARCHIVE
+// =============================================================================
+
+typedef struct ArchiveFile
+{
+    std::string name;
+    DWORD kind;
+    std::vector<BYTE> bytes;
+} ArchiveFile;
+
+typedef struct Archive
+{
+    std::vector<ArchiveFile> files;
+    std::vector<std::vector<BYTE>> presets; // Indexed by preset id; empty = missing
+    std::atomic<DWORD> generation;          // Stamped into every blob a load hands out
+    std::atomic<bool> failLoads;
+    std::atomic<DWORD> loads;
+    std::atomic<DWORD> frees;
+} Archive;
+
+static std::string MakeKey(const DataTableSchema *pSchema, DWORD row)
+{
+    char sz[64];
+    snprintf(sz, sizeof(sz), "%s%u", pSchema->szName, row);
+    if (pSchema->szKeyColumn)
+    {
+        for (DWORD c = 0; c < pSchema->columnCount; c++)
+        {
+            if (strcmp(pSchema->pColumns[c].szColumn, pSchema->szKeyColumn) == 0 &&
+                pSchema->pColumns[c].type == DTCOL_CODE)
+            {
+                // Up to 4-char codes
+                sz[0] = (char)('a' + row / 676 % 26);
+                sz[1] = (char)('a' + row / 26 % 26);
+                sz[2] = (char)('a' + row % 26);
+                sz[3] = '\0';
+            }
+        }
+    }
+    return sz;
+}
+
+static void AddTables(Archive *pArchive)
+{
+    DataCompiler *pCompiler = DATACOMPILER_Create();
+    std::vector<std::string> texts(DATACOMPILER_GetSchemaCount());
+
+    for (DWORD t = 0; t < DATACOMPILER_GetSchemaCount(); t++)
+    {
+        const DataTableSchema *pSchema = DATACOMPILER_GetSchema(t);
+        std::string &text = texts[t];
+        char sz[32];
+        for (DWORD c = 0; c < pSchema->columnCount; c++)
+        {
+            text += c ? "\t" : "";
+            text += pSchema->pColumns[c].szColumn;
+        }
+        text += "\r\n";
+        for (DWORD r = 0; r < TABLE_ROWS; r++)
+        {
+            for (DWORD c = 0; c < pSchema->columnCount; c++)
+            {
+                const DataColumnSchema *pColumn = &pSchema->pColumns[c];
+                text += c ? "\t" : "";
+                if (pSchema->szKeyColumn && strcmp(pColumn->szColumn, pSchema->szKeyColumn) == 0)
+                {
+                    text += MakeKey(pSchema, r);
+                }
+                else if (pColumn->type == DTCOL_LINK)
+                {
+                    text += MakeKey(DATACOMPILER_FindSchema(pColumn->szLinkTable), NextRandom() % TABLE_ROWS);
+                }
+                else if (pColumn->type == DTCOL_STRING || pColumn->type == DTCOL_CODE)
+                {
+                    snprintf(sz, sizeof(sz), "s%u", NextRandom() % 300);
+                    text += sz;
+                }
+                else
+                {
+                    snprintf(sz, sizeof(sz), "%u", NextRandom() % 100);
+                    text += sz;
+                }
+            }
+            text += "\r\n";
+        }
+    }
+
+    // Links resolve across the whole set, so parse everything before compiling
+    for (DWORD t = 0; t < DATACOMPILER_GetSchemaCount(); t++)
+    {
+        if (!DATACOMPILER_AddTable(pCompiler, DATACOMPILER_GetSchema(t), texts[t].c_str(), texts[t].size()))
+        {
+            printf("parse failed: %s\n", DATACOMPILER_GetError(pCompiler));
+            exit(1);
+        }
+    }
+    for (DWORD t = 0; t < DATACOMPILER_GetSchemaCount(); t++)
+    {
+        ArchiveFile file;
+        BYTE *pBlob;
+        DWORD size;
+        file.name = std::string("data/global/excel/") + DATACOMPILER_GetSchema(t)->szName + ".d2t";
+        file.kind = GAMEDATA_TABLE;
+        if (!DATACOMPILER_Compile(pCompiler, DATACOMPILER_GetSchema(t)->szName, &pBlob, &size))
+        {
+            printf("compile failed: %s\n", DATACOMPILER_GetError(pCompiler));
+            exit(1);
+        }
+        file.bytes.assign(pBlob, pBlob + size);
+        free(pBlob);
+        pArchive->files.push_back(file);
+    }
+    DATACOMPILER_Destroy(pCompiler);
+}
+
+static void AddBlob(Archive *pArchive, const char *szName, size_t size, BOOL text)
+{
+    ArchiveFile file;
+    file.name = szName;
+    file.kind = GAMEDATA_BLOB;
+    file.bytes.resize(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        file.bytes[i] = text ? (BYTE)('a' + NextRandom() % 27) : (BYTE)NextRandom();
+    }
+    pArchive->files.push_back(file);
+}
+
+static void PutDword(std::vector<BYTE> &out, DWORD value)
+{
+    out.push_back((BYTE)value);
+    out.push_back((BYTE)(value >> 8));
+    out.push_back((BYTE)(value >> 16));
+    out.push_back((BYTE)(value >> 24));
+}
+
+// Version 18 DS1: 2 wall layers, 2 floor layers, shadow, no tag layer, no file list
+static std::vector<BYTE> MakeDs1(DWORD width, DWORD height, DWORD act, DWORD objects)
+{
+    std::vector<BYTE> out;
+    PutDword(out, 18);
+    PutDword(out, width - 1);
+    PutDword(out, height - 1);
+    PutDword(out, act);
+    PutDword(out, 0); // Tag type
+    PutDword(out, 0); // Files
+    PutDword(out, 2); // Wall layers
+    PutDword(out, 2); // Floor layers
+    for (DWORD layer = 0; layer < 2 * 2 + 2 + 1; layer++)
+    {
+        for (DWORD i = 0; i < width * height; i++)
+        {
+            DWORD value = NextRandom();
+            PutDword(out, (layer < 4 && (value & 7)) ? 0 : value);
+        }
+    }
+    PutDword(out, objects);
+    for (DWORD i = 0; i < objects; i++)
+    {
+        PutDword(out, 1 + (NextRandom() & 1));
+        PutDword(out, NextRandom() % 600);
+        PutDword(out, NextRandom() % (width * 5));
+        PutDword(out, NextRandom() % (height * 5));
+        PutDword(out, 0);
+    }
+    PutDword(out, 0);
+    PutDword(out, 0);
+    return out;
+}
+
+static void BuildArchive(Archive *pArchive, const DrlgLevelDef *pLevels, DWORD levelCount)
+{
+    static const char *s_strings[] = {"string.tbl", "expansionstring.tbl", "patchstring.tbl"};
+    static const size_t s_stringSizes[] = {640 * 1024, 320 * 1024, 96 * 1024};
+    char sz[64];
+
+    AddTables(pArchive);
+    for (DWORD i = 0; i < 3; i++)
+    {
+        snprintf(sz, sizeof(sz), "data/local/lng/eng/%s", s_strings[i]);
+        AddBlob(pArchive, sz, s_stringSizes[i], TRUE);
+    }
+    for (DWORD act = 1; act <= 5; act++)
+    {
+        snprintf(sz, sizeof(sz), "data/global/palette/act%u/pal.dat", act);
+        AddBlob(pArchive, sz, 768, FALSE);
+        snprintf(sz, sizeof(sz), "data/global/palette/act%u/pal.pl2", act);
+        AddBlob(pArchive, sz, PL2_SIZE, FALSE);
+    }
+
+    pArchive->presets.assign(DRLG_GetPresetLimit(pLevels, levelCount), std::vector<BYTE>());
+    for (DWORD i = 0; i < levelCount; i++)
+    {
+        const DrlgLevelDef *pLevel = &pLevels[i];
+        DWORD first = DRLG_PRESET_ID(pLevel->style, 0);
+        if (!pArchive->presets[first].empty())
+        {
+            continue;
+        }
+        if (pLevel->type == DRLGTYPE_PRESET)
+        {
+            pArchive->presets[first] = MakeDs1(pLevel->sizeX, pLevel->sizeY, pLevel->act, 40);
+            continue;
+        }
+        for (DWORD j = 0; j < DRLG_STYLE_PRESETS; j++)
+        {
+            pArchive->presets[first + j] = MakeDs1(DRLG_CELL_TILES, DRLG_CELL_TILES, pLevel->act, NextRandom() % 4);
+        }
+    }
+
+    pArchive->generation.store(1);
+    pArchive->failLoads.store(false);
+    pArchive->loads.store(0);
+    pArchive->frees.store(0);
+}
+
+// SFileReadFile into a new buffer; blobs carry the archive generation in their first DWORD
+static BOOL __cdecl ArchiveLoad(void *pContext, const char *szName, const void **ppData, size_t *pSize)
+{
+    Archive *pArchive = (Archive *)pContext;
+    if (pArchive->failLoads.load() && strstr(szName, "pal.pl2"))
+    {
+        return FALSE;
+    }
+    for (size_t i = 0; i < pArchive->files.size(); i++)
+    {
+        const ArchiveFile *pFile = &pArchive->files[i];
+        if (pFile->name == szName)
+        {
+            BYTE *pCopy = (BYTE *)malloc(pFile->bytes.size());
+            memcpy(pCopy, pFile->bytes.data(), pFile->bytes.size());
+            if (pFile->kind == GAMEDATA_BLOB)
+            {
+                DWORD generation = pArchive->generation.load();
+                memcpy(pCopy, &generation, sizeof(generation));
+            }
+            pArchive->loads.fetch_add(1);
+            *ppData = pCopy;
+            *pSize = pFile->bytes.size();
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void __cdecl ArchiveFree(void *pContext, const void *pData)
+{
+    ((Archive *)pContext)->frees.fetch_add(1);
+    free((void *)pData);
+}
+
+static BOOL __cdecl PresetLoad(void *pContext, DWORD presetId, const void **ppData, size_t *pSize)
+{
+    Archive *pArchive = (Archive *)pContext;
+    if (presetId >= pArchive->presets.size() || pArchive->presets[presetId].empty())
+    {
+        return FALSE;
+    }
+    const std::vector<BYTE> &file = pArchive->presets[presetId];
+    void *pCopy = malloc(file.size());
+    memcpy(pCopy, file.data(), file.size());
+    *ppData = pCopy;
+    *pSize = file.size();
+    return TRUE;
+}
+
+static void __cdecl PresetFree(void *pContext, const void *pData)
+{
+    (void)pContext;
+    free((void *)pData);
+}
+
+// =============================================================================
+// GAMES
+// =============================================================================
+
+// A game's own copy of everything: today's per-process load
+typedef struct PrivateData
+{
+    std::vector<const void *> data;
+    std::vector<size_t> sizes;
+    std::vector<DataTable *> tables;
+    PresetStore *pPresets;
+} PrivateData;
+
+static size_t ResidentBytes(void)
+{
+#ifdef __linux__
+    FILE *pFile = fopen("/proc/self/statm", "r");
+    unsigned long pages = 0, resident = 0;
+    if (pFile)
+    {
+        if (fscanf(pFile, "%lu %lu", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(pFile);
+    }
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+static void LoadPrivate(Archive *pArchive, const DrlgLevelDef *pLevels, DWORD levelCount, PrivateData *pData)
+{
+    for (size_t i = 0; i < pArchive->files.size(); i++)
+    {
+        const void *pBytes = NULL;
+        size_t size = 0;
+        ArchiveLoad(pArchive, pArchive->files[i].name.c_str(), &pBytes, &size);
+        pData->data.push_back(pBytes);
+        pData->sizes.push_back(size);
+        pData->tables.push_back(pArchive->files[i].kind == GAMEDATA_TABLE ? DATATABLE_OpenMemory(pBytes, size, 0)
+                                                                          : NULL);
+    }
+    PresetSource source = {PresetLoad, PresetFree, pArchive};
+    pData->pPresets = PRESETSTORE_Create(&source, DRLG_GetPresetLimit(pLevels, levelCount));
+}
+
+static void FreePrivate(Archive *pArchive, PrivateData *pData)
+{
+    for (size_t i = 0; i < pData->data.size(); i++)
+    {
+        if (pData->tables[i])
+        {
+            DATATABLE_Close(pData->tables[i]);
+        }
+        ArchiveFree(pArchive, pData->data[i]);
+    }
+    PRESETSTORE_Destroy(pData->pPresets);
+}
+
+// Decodes the act's presets and reads from every item; same result in both modes
+static DWORD PlayGame(DWORD game, const DrlgLevelDef *pLevels, DWORD levelCount, PresetStore *pPresets,
+                      const std::vector<const DataTable *> &tables, const std::vector<const BYTE *> &blobs,
+                      const std::vector<size_t> &sizes)
+{
+    DWORD act = game % 5;
+    DWORD h = 0x811C9DC5u;
+    for (DWORD i = 0; i < levelCount; i++)
+    {
+        if (pLevels[i].act % 5 != act)
+        {
+            continue;
+        }
+        DWORD presets = pLevels[i].type == DRLGTYPE_PRESET ? 1 : DRLG_STYLE_PRESETS;
+        for (DWORD j = 0; j < presets; j++)
+        {
+            const Ds1Map *pMap = PRESETSTORE_Acquire(pPresets, DRLG_PRESET_ID(pLevels[i].style, j));
+            if (pMap)
+            {
+                h = D2_HashDword(h ^ pMap->width ^ (pMap->objectCount << 16) ^ pMap->pFloors[0][0]);
+            }
+        }
+    }
+    for (size_t t = 0; t < tables.size(); t++)
+    {
+        if (tables[t])
+        {
+            DWORD records = DATATABLE_GetRecordCount(tables[t]);
+            h = D2_HashDword(h ^ records ^ (DWORD)DATATABLE_GetInt(tables[t], 1, (game * 7) % records));
+        }
+    }
+    for (size_t b = 0; b < blobs.size(); b++)
+    {
+        // Skip the generation stamp
+        h = D2_HashDword(h ^ blobs[b][4 + (game * 4099) % (sizes[b] - 4)]);
+    }
+    return h;
+}
+
+static DWORD PlayShared(DWORD game, const DrlgLevelDef *pLevels, DWORD levelCount, const GameDataView *pView,
+                        DWORD itemCount)
+{
+    std::vector<const DataTable *> tables;
+    std::vector<const BYTE *> blobs;
+    std::vector<size_t> sizes;
+    for (DWORD i = 0; i < itemCount; i++)
+    {
+        size_t size;
+        const BYTE *pBytes = (const BYTE *)GAMEDATA_GetBlob(pView, i, &size);
+        tables.push_back(GAMEDATA_GetTable(pView, i));
+        if (!tables.back())
+        {
+            blobs.push_back(pBytes);
+            sizes.push_back(size);
+        }
+    }
+    return PlayGame(game, pLevels, levelCount, GAMEDATA_GetPresets(pView), tables, blobs, sizes);
+}
+
+static DWORD PlayPrivate(DWORD game, const DrlgLevelDef *pLevels, DWORD levelCount, const PrivateData *pData)
+{
+    std::vector<const DataTable *> tables;
+    std::vector<const BYTE *> blobs;
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < pData->data.size(); i++)
+    {
+        tables.push_back(pData->tables[i]);
+        if (!pData->tables[i])
+        {
+            blobs.push_back((const BYTE *)pData->data[i]);
+            sizes.push_back(pData->sizes[i]);
+        }
+    }
+    return PlayGame(game, pLevels, levelCount, pData->pPresets, tables, blobs, sizes);
+}
+
+// Every blob of a view must come from the same load
+static BOOL ViewConsistent(const GameDataView *pView, DWORD itemCount, DWORD *pGeneration)
+{
+    DWORD generation = 0;
+    for (DWORD i = 0; i < itemCount; i++)
+    {
+        if (GAMEDATA_GetTable(pView, i))
+        {
+            continue;
+        }
+        DWORD stamp;
+        memcpy(&stamp, GAMEDATA_GetBlob(pView, i, NULL), sizeof(stamp));
+        if (generation && stamp != generation)
+        {
+            return FALSE;
+        }
+        generation = stamp;
+    }
+    *pGeneration = generation;
+    return TRUE;
+}
+
+typedef struct ReaderGame
+{
+    const GameDataView *pView;
+    DWORD lastVersion;
+    DWORD refreshes;
+} ReaderGame;
+
+typedef struct ReaderResult
+{
+    DWORD inconsistent;
+    DWORD backwards;
+    std::atomic<uint64_t> passes;
+} ReaderResult;
+
+static void ReaderMain(GameData *pData, ReaderGame *pGames, DWORD count, DWORD itemCount,
+                       const std::atomic<bool> *pStop, ReaderResult *pResult)
+{
+    while (!pStop->load())
+    {
+        for (DWORD g = 0; g < count; g++)
+        {
+            ReaderGame *pGame = &pGames[g];
+            pGame->refreshes += GAMEDATA_Refresh(pData, &pGame->pView);
+            DWORD version = GAMEDATA_GetVersion(pGame->pView);
+            DWORD generation;
+            if (!ViewConsistent(pGame->pView, itemCount, &generation) || generation != version)
+            {
+                pResult->inconsistent++;
+            }
+            if (version < pGame->lastVersion)
+            {
+                pResult->backwards++;
+            }
+            pGame->lastVersion = version;
+        }
+        pResult->passes.fetch_add(1);
+        std::this_thread::yield();
+    }
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    DWORD gameCount = (argc > 1) ? (DWORD)atoi(argv[1]) : 200;
+    DWORD reloads = (argc > 2) ? (DWORD)atoi(argv[2]) : 20;
+    DWORD readerCount = (argc > 3) ? (DWORD)atoi(argv[3]) : 4;
+    BOOL ok = TRUE;
+
+    DWORD levelCount;
+    const DrlgLevelDef *pLevels = DRLG_GetDefaultLevels(&levelCount);
+    Archive archive;
+    BuildArchive(&archive, pLevels, levelCount);
+
+    std::vector<GameDataItem> items;
+    size_t setBytes = 0;
+    for (size_t i = 0; i < archive.files.size(); i++)
+    {
+        GameDataItem item = {archive.files[i].name.c_str(), archive.files[i].kind};
+        items.push_back(item);
+        setBytes += archive.files[i].bytes.size();
+    }
+    DWORD itemCount = (DWORD)items.size();
+
+    // ---- Shared (first, so freed per-game memory cannot flatter it)
+    size_t rssBefore = ResidentBytes();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    GameDataDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.pItems = items.data();
+    desc.itemCount = itemCount;
+    desc.source.pfnLoad = ArchiveLoad;
+    desc.source.pfnFree = ArchiveFree;
+    desc.source.pContext = &archive;
+    desc.presets.pfnLoad = PresetLoad;
+    desc.presets.pfnFree = PresetFree;
+    desc.presets.pContext = &archive;
+    desc.maxPresets = DRLG_GetPresetLimit(pLevels, levelCount);
+    desc.tableFlags = DATATABLE_OPEN_VERIFY;
+    GameData *pData = GAMEDATA_Create(&desc);
+    if (!pData)
+    {
+        printf("registry load failed\n");
+        return 1;
+    }
+
+    std::vector<const GameDataView *> views(gameCount);
+    std::vector<DWORD> sharedSums(gameCount);
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        views[g] = GAMEDATA_Acquire(pData);
+        sharedSums[g] = PlayShared(g, pLevels, levelCount, views[g], itemCount);
+    }
+    double sharedSeconds = Seconds(start);
+    size_t sharedRss = ResidentBytes() - rssBefore;
+    GameDataStats stats;
+    GAMEDATA_GetStats(pData, &stats);
+    size_t sharedBytes = stats.bytes;
+    ok &= stats.views == gameCount && stats.liveVersions == 1;
+
+    // ---- Hot reload while the games refresh
+    std::vector<ReaderGame> readerGames(gameCount);
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        readerGames[g].pView = views[g];
+        readerGames[g].lastVersion = 1;
+        readerGames[g].refreshes = 0;
+    }
+    std::atomic<bool> stop(false);
+    std::vector<ReaderResult> readerResults(readerCount);
+    std::vector<std::thread> readers;
+    DWORD perReader = (gameCount + readerCount - 1) / readerCount;
+    for (DWORD r = 0; r < readerCount; r++)
+    {
+        DWORD first = std::min(gameCount, r * perReader);
+        DWORD count = std::min(gameCount, first + perReader) - first;
+        readerResults[r].inconsistent = readerResults[r].backwards = 0;
+        readerResults[r].passes.store(0);
+        readers.push_back(std::thread(ReaderMain, pData, &readerGames[first], count, itemCount, &stop,
+                                      &readerResults[r]));
+    }
+
+    DWORD peakVersions = 1, lastVersion = 1, failedReloadAccepted = 0;
+    double reloadMax = 0, reloadTotal = 0;
+    for (DWORD i = 0; i < reloads; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (i == reloads / 2)
+        {
+            // A broken patch: the reload fails and the games stay where they are
+            archive.failLoads.store(true);
+            failedReloadAccepted += GAMEDATA_Reload(pData) != 0;
+            archive.failLoads.store(false);
+        }
+        archive.generation.store(lastVersion + 1);
+        std::chrono::steady_clock::time_point reloadStart = std::chrono::steady_clock::now();
+        DWORD version = GAMEDATA_Reload(pData);
+        double seconds = Seconds(reloadStart);
+        reloadMax = std::max(reloadMax, seconds);
+        reloadTotal += seconds;
+        ok &= version == lastVersion + 1;
+        lastVersion = version;
+
+        GAMEDATA_GetStats(pData, &stats);
+        peakVersions = std::max(peakVersions, stats.liveVersions);
+    }
+    // Every game passes a refresh point after the last reload
+    std::vector<uint64_t> passes(readerCount);
+    for (DWORD r = 0; r < readerCount; r++)
+    {
+        passes[r] = readerResults[r].passes.load();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stop.store(true);
+    for (DWORD r = 0; r < readerCount; r++)
+    {
+        readers[r].join();
+    }
+
+    DWORD inconsistent = 0, backwards = 0, stale = 0, mismatches = 0;
+    uint64_t refreshes = 0;
+    for (DWORD r = 0; r < readerCount; r++)
+    {
+        inconsistent += readerResults[r].inconsistent;
+        backwards += readerResults[r].backwards;
+        ok &= readerResults[r].passes.load() > passes[r];
+    }
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        stale += GAMEDATA_GetVersion(readerGames[g].pView) != lastVersion;
+        refreshes += readerGames[g].refreshes;
+        // Reloaded files are byte-identical apart from the stamp
+        mismatches += PlayShared(g, pLevels, levelCount, readerGames[g].pView, itemCount) != sharedSums[g];
+        GAMEDATA_Release(readerGames[g].pView);
+    }
+    GAMEDATA_GetStats(pData, &stats);
+    ok &= stats.views == 0 && stats.liveVersions == 1 && stats.reloads == reloads && stats.failedReloads == 1;
+    GAMEDATA_Destroy(pData);
+    DWORD leakedBuffers = archive.loads.load() - archive.frees.load();
+
+    // ---- Per game
+    rssBefore = ResidentBytes();
+    start = std::chrono::steady_clock::now();
+    std::vector<PrivateData> privates(gameCount);
+    size_t privateBytes = 0;
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        LoadPrivate(&archive, pLevels, levelCount, &privates[g]);
+        mismatches += PlayPrivate(g, pLevels, levelCount, &privates[g]) != sharedSums[g];
+        PresetStoreStats presetStats;
+        PRESETSTORE_GetStats(privates[g].pPresets, &presetStats);
+        privateBytes += setBytes + presetStats.bytes;
+    }
+    double privateSeconds = Seconds(start);
+    size_t privateRss = ResidentBytes() - rssBefore;
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        FreePrivate(&archive, &privates[g]);
+    }
+
+    printf("data set: %u items, %.1f MB files, %u preset ids\n", itemCount, setBytes / 1048576.0,
+           (DWORD)archive.presets.size());
+    printf("%u games:\n", gameCount);
+    printf("  per game: %8.1f MB held, %8.1f MB resident, %.3f s to start\n", privateBytes / 1048576.0,
+           privateRss / 1048576.0, privateSeconds);
+    printf("  shared:   %8.1f MB held, %8.1f MB resident, %.3f s to start (%.0fx less held)\n",
+           sharedBytes / 1048576.0, sharedRss / 1048576.0, sharedSeconds,
+           sharedBytes ? (double)privateBytes / sharedBytes : 0.0);
+    printf("reload:   %u reloads under %u reader threads, %.2f ms avg / %.2f ms max, peak %u live versions, "
+           "%llu refreshes\n",
+           reloads, readerCount, reloads ? reloadTotal * 1000.0 / reloads : 0.0, reloadMax * 1000.0, peakVersions,
+           (unsigned long long)refreshes);
+    printf("verify:   checksums %u mismatches, inconsistent views %u, versions backwards %u, stale games %u -> %s\n",
+           mismatches, inconsistent, backwards, stale,
+           (mismatches || inconsistent || backwards || stale) ? "FAILED" : "ok");
+    printf("verify:   failed reload accepted %u, source buffers leaked %u, registry counters %s -> %s\n",
+           failedReloadAccepted, leakedBuffers, ok ? "ok" : "MISMATCH",
+           (failedReloadAccepted || leakedBuffers || !ok) ? "FAILED" : "ok");
+    ok &= !mismatches && !inconsistent && !backwards && !stale && !failedReloadAccepted && !leakedBuffers;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,481 @@
+/*
+ * BenchGameHost.cpp - Hundreds of games in one process: GameHost vs a loop per game
+ *
+ *   loops: what D2ServerMain does, once per game: a dedicated thread that
+ *          sleeps to the next 40 ms frame and runs its game's tick. Client
+ *          input is generated inside the tick at the same mean rate.
+ *   host:  every game on one GameHost worker pool, fed by SimClients.
+ *
+ * Each game is a small simulation on D2Common parts: a UnitStore with
+ * monsters and one player unit per client, walk/cast packets moving them,
+ * wandering AI driven by the game's random stream, plus a fixed slab of
+ * synthetic per-tick work standing in for the rest of the game logic.
+ *
+ * Verification (host run): every client's packets reach its game exactly
+ * once and in order; no game ever runs two ticks at once; extra games are
+ * removed and re-added mid-run and posts to their old ids fail;
+ * and replaying each game's delivered packets single-threaded reproduces
+ * its final state exactly.
+ *
+ * Usage: bench_gamehost [games] [seconds] [clients per game] [workers] [work us]
+ */
+
+#include "../Common/Rng.hpp"
+#include "../Common/UnitStore.hpp"
+#include "../Server/GameHost.hpp"
+#include "../Server/SimClients.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define MONSTERS 128
+#define TICK_NS 40000000
+
+static DWORD g_workRounds;
+
+// =============================================================================
+// GAME
+// =============================================================================
+
+typedef struct SimGame
+{
+    DWORD index;
+    DWORD clients;
+    UnitStore *pUnits;
+    std::vector<UnitHandle> players;
+    std::vector<UnitHandle> monsters;
+    RngStream rng;
+    std::vector<DWORD> expectedSeq;
+    DWORD checksum;
+
+    // Verification
+    std::atomic<int> running;
+    DWORD overlaps;
+    DWORD seqErrors;
+    DWORD ticks;
+    std::vector<BYTE> log; // Per tick: DWORD count, then (DWORD size, bytes) per message
+} SimGame;
+
+static DWORD Mix(DWORD h, DWORD v)
+{
+    return D2_HashDword(h ^ v) + 0x9E3779B9u;
+}
+
+static void InitGame(SimGame *pGame, DWORD index, DWORD clients)
+{
+    UnitStoreDesc desc;
+    desc.capacity = MONSTERS + clients;
+    desc.coldSize = 0;
+    pGame->index = index;
+    pGame->clients = clients;
+    pGame->pUnits = UNITSTORE_Create(&desc);
+    pGame->players.clear();
+    pGame->monsters.clear();
+    RNG_InitGame(&pGame->rng, 0xD2000000u + index);
+    for (DWORD c = 0; c < clients; c++)
+    {
+        pGame->players.push_back(UNITSTORE_Spawn(pGame->pUnits, 0, 100.0f, 100.0f));
+    }
+    for (DWORD m = 0; m < MONSTERS; m++)
+    {
+        float x = (float)RNG_Range(&pGame->rng, 256);
+        float y = (float)RNG_Range(&pGame->rng, 256);
+        pGame->monsters.push_back(UNITSTORE_Spawn(pGame->pUnits, 1, x, y));
+    }
+    pGame->expectedSeq.assign(clients, 0);
+    pGame->checksum = 0;
+    pGame->running.store(0);
+    pGame->overlaps = pGame->seqErrors = pGame->ticks = 0;
+    pGame->log.clear();
+}
+
+static void FreeGame(SimGame *pGame)
+{
+    UNITSTORE_Destroy(pGame->pUnits);
+    pGame->pUnits = NULL;
+}
+
+static void ApplyPacket(SimGame *pGame, const BYTE *pData, DWORD size)
+{
+    if (size < sizeof(SimClientPacket))
+    {
+        pGame->seqErrors++;
+        return;
+    }
+    SimClientPacket packet;
+    memcpy(&packet, pData, sizeof(packet));
+    DWORD local = packet.clientId - pGame->index * pGame->clients;
+    if (local >= pGame->clients || packet.seq != pGame->expectedSeq[local])
+    {
+        pGame->seqErrors++;
+        return;
+    }
+    pGame->expectedSeq[local]++;
+
+    float x = packet.x / 16.0f;
+    float y = packet.y / 16.0f;
+    if (packet.opcode == SIMCLIENT_OP_WALK)
+    {
+        UNITSTORE_MoveTo(pGame->pUnits, pGame->players[local], x, y, 0.9f);
+    }
+    else if (packet.opcode == SIMCLIENT_OP_CAST)
+    {
+        // The target monster turns on the caster's spot
+        UNITSTORE_MoveTo(pGame->pUnits, pGame->monsters[packet.arg % MONSTERS], x, y, 0.6f);
+        pGame->checksum = Mix(pGame->checksum, packet.arg);
+    }
+    else
+    {
+        for (DWORD i = sizeof(SimClientPacket); i < size; i++)
+        {
+            pGame->checksum = Mix(pGame->checksum, pData[i]);
+        }
+    }
+}
+
+static void SimulateTick(SimGame *pGame, DWORD tick)
+{
+    // Wandering AI: an eighth of the monsters pick a new spot each tick
+    for (DWORD m = tick % 8; m < MONSTERS; m += 8)
+    {
+        float x = (float)RNG_Range(&pGame->rng, 256);
+        float y = (float)RNG_Range(&pGame->rng, 256);
+        UNITSTORE_MoveTo(pGame->pUnits, pGame->monsters[m], x, y, 0.4f);
+    }
+
+    UnitTickResult result;
+    UNITSTORE_Tick(pGame->pUnits, &result);
+    pGame->checksum = Mix(pGame->checksum, result.moved * 131 + result.arrived);
+
+    // Stand-in for the rest of the game's tick
+    DWORD h = pGame->checksum;
+    for (DWORD i = 0; i < g_workRounds; i++)
+    {
+        h = D2_HashDword(h + i);
+    }
+    pGame->checksum = Mix(pGame->checksum, h & 1);
+}
+
+static DWORD StateHash(SimGame *pGame)
+{
+    UnitHotArrays hot;
+    UNITSTORE_GetHot(pGame->pUnits, &hot);
+    DWORD h = pGame->checksum;
+    for (DWORD i = 0; i < hot.count; i++)
+    {
+        DWORD x, y;
+        memcpy(&x, &hot.x[i], sizeof(x));
+        memcpy(&y, &hot.y[i], sizeof(y));
+        h = Mix(Mix(h, x), y);
+    }
+    return h;
+}
+
+static void __cdecl HostTick(void *pContext, DWORD tick, const HostMessage *pMessages, DWORD count)
+{
+    SimGame *pGame = (SimGame *)pContext;
+    if (pGame->running.fetch_add(1) != 0)
+    {
+        pGame->overlaps++;
+    }
+    if (tick != pGame->ticks)
+    {
+        pGame->seqErrors++;
+    }
+
+    DWORD header = count;
+    pGame->log.insert(pGame->log.end(), (BYTE *)&header, (BYTE *)&header + sizeof(header));
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD size = pMessages[i].size;
+        pGame->log.insert(pGame->log.end(), (BYTE *)&size, (BYTE *)&size + sizeof(size));
+        pGame->log.insert(pGame->log.end(), pMessages[i].pData, pMessages[i].pData + size);
+        ApplyPacket(pGame, pMessages[i].pData, size);
+    }
+    SimulateTick(pGame, tick);
+    pGame->ticks++;
+    pGame->running.fetch_sub(1);
+}
+
+// Single-threaded replay of a game's log
+static DWORD Replay(const SimGame *pGame)
+{
+    SimGame replay;
+    InitGame(&replay, pGame->index, pGame->clients);
+    size_t pos = 0;
+    for (DWORD tick = 0; tick < pGame->ticks; tick++)
+    {
+        DWORD count;
+        memcpy(&count, &pGame->log[pos], sizeof(count));
+        pos += sizeof(count);
+        for (DWORD i = 0; i < count; i++)
+        {
+            DWORD size;
+            memcpy(&size, &pGame->log[pos], sizeof(size));
+            pos += sizeof(size);
+            ApplyPacket(&replay, &pGame->log[pos], size);
+            pos += size;
+        }
+        SimulateTick(&replay, tick);
+    }
+    DWORD hash = StateHash(&replay);
+    FreeGame(&replay);
+    return hash;
+}
+
+// =============================================================================
+// LOOP PER GAME BASELINE
+// =============================================================================
+
+typedef struct LoopStats
+{
+    uint64_t ticks;
+    uint64_t misses;
+    uint64_t skipped;
+    uint64_t cpuNs;
+    DWORD maxLatenessUs;
+} LoopStats;
+
+static int64_t NowNs(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void LoopMain(SimGame *pGame, double packetsPerTick, int64_t endNs, LoopStats *pStats)
+{
+    RngStream input;
+    RNG_Split(&pGame->rng, RNG_DOMAIN_THREAD, 0, &input);
+    double credit = 0;
+    int64_t release = NowNs();
+    BYTE buffer[sizeof(SimClientPacket)];
+
+    while (release < endNs)
+    {
+        std::this_thread::sleep_until(
+            std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::nanoseconds(release))));
+        int64_t start = NowNs();
+        pStats->maxLatenessUs = std::max(pStats->maxLatenessUs, (DWORD)((start - release) / 1000));
+
+        // Inline input at the same mean rate the host run gets from SimClients
+        for (credit += packetsPerTick; credit >= 1.0; credit -= 1.0)
+        {
+            SimClientPacket packet;
+            memset(&packet, 0, sizeof(packet));
+            DWORD local = RNG_Range(&input, pGame->clients);
+            packet.opcode = RNG_Range(&input, 4) ? SIMCLIENT_OP_WALK : SIMCLIENT_OP_CAST;
+            packet.clientId = pGame->index * pGame->clients + local;
+            packet.seq = pGame->expectedSeq[local];
+            packet.x = (WORD)RNG_Range(&input, 4096);
+            packet.y = (WORD)RNG_Range(&input, 4096);
+            packet.arg = RNG_Range(&input, 356);
+            memcpy(buffer, &packet, sizeof(packet));
+            ApplyPacket(pGame, buffer, sizeof(buffer));
+        }
+        SimulateTick(pGame, (DWORD)pStats->ticks);
+        int64_t end = NowNs();
+
+        pStats->ticks++;
+        pStats->cpuNs += (uint64_t)(end - start);
+        pStats->misses += end > release + TICK_NS;
+        release += TICK_NS;
+        if (end - release > 5 * (int64_t)TICK_NS)
+        {
+            int64_t periods = (end - release) / TICK_NS;
+            release += periods * TICK_NS;
+            pStats->skipped += (uint64_t)periods;
+        }
+    }
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+static void CalibrateWork(DWORD workUs)
+{
+    DWORD h = 1, rounds = 1000000;
+    int64_t start = NowNs();
+    for (DWORD i = 0; i < rounds; i++)
+    {
+        h = D2_HashDword(h + i);
+    }
+    double nsPerRound = (double)(NowNs() - start) / rounds;
+    g_workRounds = (DWORD)(workUs * 1000.0 / (nsPerRound > 0.1 ? nsPerRound : 0.1)) + (h & 1);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD gameCount = (argc > 1) ? (DWORD)atoi(argv[1]) : 200;
+    DWORD seconds = (argc > 2) ? (DWORD)atoi(argv[2]) : 4;
+    DWORD clients = (argc > 3) ? (DWORD)atoi(argv[3]) : 8;
+    DWORD workers = (argc > 4) ? (DWORD)atoi(argv[4]) : 0;
+    DWORD workUs = (argc > 5) ? (DWORD)atoi(argv[5]) : 40;
+    const DWORD actionsPerSecond = 4;
+    BOOL ok = TRUE;
+
+    CalibrateWork(workUs);
+    std::vector<SimGame> games(gameCount);
+
+    // ---- Loop per game
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        InitGame(&games[g], g, clients);
+    }
+    std::vector<LoopStats> loopStats(gameCount);
+    memset(loopStats.data(), 0, gameCount * sizeof(LoopStats));
+    std::vector<std::thread> loops;
+    int64_t endNs = NowNs() + (int64_t)seconds * 1000000000;
+    double packetsPerTick = (double)clients * actionsPerSecond / 25.0;
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        loops.push_back(std::thread(LoopMain, &games[g], packetsPerTick, endNs, &loopStats[g]));
+    }
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        loops[g].join();
+    }
+    LoopStats loopTotal;
+    memset(&loopTotal, 0, sizeof(loopTotal));
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        loopTotal.ticks += loopStats[g].ticks;
+        loopTotal.misses += loopStats[g].misses;
+        loopTotal.skipped += loopStats[g].skipped;
+        loopTotal.cpuNs += loopStats[g].cpuNs;
+        loopTotal.maxLatenessUs = std::max(loopTotal.maxLatenessUs, loopStats[g].maxLatenessUs);
+        FreeGame(&games[g]);
+    }
+
+    // ---- Host
+    GameHostDesc hostDesc;
+    memset(&hostDesc, 0, sizeof(hostDesc));
+    hostDesc.workerCount = workers;
+    GameHost *pHost = GAMEHOST_Create(&hostDesc);
+    int64_t hostStart = NowNs();
+    std::vector<HostedGameId> ids(gameCount);
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        InitGame(&games[g], g, clients);
+        HostedGameDesc gameDesc;
+        gameDesc.pfnTick = HostTick;
+        gameDesc.pGame = &games[g];
+        ids[g] = GAMEHOST_AddGame(pHost, &gameDesc);
+        ok &= ids[g] != GAMEHOST_INVALID_GAME;
+    }
+
+    SimClientsDesc clientDesc;
+    clientDesc.pHost = pHost;
+    clientDesc.pGames = ids.data();
+    clientDesc.gameCount = gameCount;
+    clientDesc.clientsPerGame = clients;
+    clientDesc.actionsPerSecond = actionsPerSecond;
+    clientDesc.seed = 0x5EED;
+    SimClients *pClients = SIMCLIENTS_Start(&clientDesc);
+
+    // Churn games without clients come and go halfway through: old ids must go dead
+    DWORD churnCount = (gameCount + 9) / 10;
+    std::vector<SimGame> churn(churnCount);
+    std::vector<HostedGameId> churnIds(churnCount);
+    for (DWORD c = 0; c < churnCount; c++)
+    {
+        InitGame(&churn[c], gameCount + c, 0);
+        HostedGameDesc gameDesc;
+        gameDesc.pfnTick = HostTick;
+        gameDesc.pGame = &churn[c];
+        churnIds[c] = GAMEHOST_AddGame(pHost, &gameDesc);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(seconds * 500));
+    DWORD staleAccepted = 0;
+    for (DWORD c = 0; c < churnCount; c++)
+    {
+        HostedGameId old = churnIds[c];
+        ok &= GAMEHOST_RemoveGame(pHost, old, NULL);
+        ok &= churn[c].overlaps == 0;
+        FreeGame(&churn[c]);
+        InitGame(&churn[c], gameCount + c, 0);
+        HostedGameDesc gameDesc;
+        gameDesc.pfnTick = HostTick;
+        gameDesc.pGame = &churn[c];
+        churnIds[c] = GAMEHOST_AddGame(pHost, &gameDesc);
+        staleAccepted += GAMEHOST_Post(pHost, old, 0, "x", 1);
+        staleAccepted += churnIds[c] == old;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(seconds * 500));
+
+    SimClientsStats clientStats;
+    SIMCLIENTS_Stop(pClients, &clientStats);
+    // Let the last packets drain
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    GameHostStats hostStats;
+    GAMEHOST_GetStats(pHost, &hostStats);
+    double hostSeconds = (NowNs() - hostStart) / 1e9;
+    HostedGameStats hostTotal;
+    memset(&hostTotal, 0, sizeof(hostTotal));
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        HostedGameStats stats;
+        ok &= GAMEHOST_RemoveGame(pHost, ids[g], &stats);
+        hostTotal.ticks += stats.ticks;
+        hostTotal.deadlineMisses += stats.deadlineMisses;
+        hostTotal.skipped += stats.skipped;
+        hostTotal.cpuNs += stats.cpuNs;
+        hostTotal.maxLatenessUs = std::max(hostTotal.maxLatenessUs, stats.maxLatenessUs);
+        hostTotal.maxTickNs = std::max(hostTotal.maxTickNs, stats.maxTickNs);
+    }
+    for (DWORD c = 0; c < churnCount; c++)
+    {
+        ok &= GAMEHOST_RemoveGame(pHost, churnIds[c], NULL);
+        ok &= churn[c].overlaps == 0 && churn[c].seqErrors == 0;
+        FreeGame(&churn[c]);
+    }
+    GAMEHOST_Destroy(pHost);
+
+    // ---- Verification
+    uint64_t delivered = 0;
+    DWORD overlaps = 0, seqErrors = 0, replayMismatches = 0;
+    for (DWORD g = 0; g < gameCount; g++)
+    {
+        SimGame *pGame = &games[g];
+        for (DWORD c = 0; c < clients; c++)
+        {
+            delivered += pGame->expectedSeq[c];
+        }
+        overlaps += pGame->overlaps;
+        seqErrors += pGame->seqErrors;
+        replayMismatches += Replay(pGame) != StateHash(pGame);
+        FreeGame(pGame);
+    }
+
+    double expectedTicks = (double)gameCount * seconds * 25.0;
+    printf("games:    %u x %u clients, %u s per mode, %.0f us synthetic work per tick\n", gameCount, clients, seconds,
+           (double)workUs);
+    printf("  loops:  %u threads, %llu ticks (%.1f%%), %llu missed deadlines, %llu skipped, worst lateness %.1f ms, "
+           "%.1f us/tick wall\n",
+           gameCount, (unsigned long long)loopTotal.ticks, 100.0 * loopTotal.ticks / expectedTicks,
+           (unsigned long long)loopTotal.misses, (unsigned long long)loopTotal.skipped,
+           loopTotal.maxLatenessUs / 1000.0, loopTotal.ticks ? loopTotal.cpuNs / 1000.0 / loopTotal.ticks : 0.0);
+    printf("  host:   %u workers + pacer, %llu ticks (%.1f%%), %llu missed deadlines, %llu skipped, worst lateness "
+           "%.1f ms, %.1f us/tick cpu, %llu steals\n",
+           hostStats.workers, (unsigned long long)hostTotal.ticks,
+           100.0 * hostTotal.ticks / (gameCount * hostSeconds * 25.0), (unsigned long long)hostTotal.deadlineMisses,
+           (unsigned long long)hostTotal.skipped, hostTotal.maxLatenessUs / 1000.0,
+           hostTotal.ticks ? hostTotal.cpuNs / 1000.0 / hostTotal.ticks : 0.0, (unsigned long long)hostStats.steals);
+    printf("  clients: %llu packets sent (%llu refused), %llu delivered\n", (unsigned long long)clientStats.sent,
+           (unsigned long long)clientStats.refused, (unsigned long long)delivered);
+    printf("verify:   delivery %s, sequence errors %u, overlapping ticks %u -> %s\n",
+           delivered == clientStats.sent ? "exact" : "MISMATCH", seqErrors, overlaps,
+           (delivered != clientStats.sent || seqErrors || overlaps) ? "FAILED" : "ok");
+    printf("verify:   %u games cycled, stale ids accepted %u, replay mismatches %u -> %s\n", churnCount, staleAccepted,
+           replayMismatches, (staleAccepted || replayMismatches) ? "FAILED" : "ok");
+    ok &= delivered == clientStats.sent && !seqErrors && !overlaps && !staleAccepted && !replayMismatches;
+    return ok ? 0 : 1;
+}
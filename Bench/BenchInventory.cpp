@@ -0,0 +1,397 @@
+/*
+ * BenchInventory.cpp - Auto-pickup and stash sorting, cell scan vs bitboards
+ *
+ * A pickup bot's session: a stream of drops in D2 item shapes is picked up
+ * into the body inventory (10x4), overflowing into a 10x10 stash and the
+ * cube (3x4). Every pickup first checks the item is not already held (GUID
+ * lookup) and the cursor hovers a few cells. The stash is re-sorted every 25
+ * pickups; when everything is full the bot sells 60% of its items by GUID
+ * and re-sorts.
+ *
+ *   cells:    D2Common's layout - a per-grid item pointer array plus the
+ *             inventory's linked item list. Fit tests scan cells,
+ *             auto-placement tries every position column by column, GUID
+ *             lookup and removal walk the list.
+ *   bitboard: InventoryGrid.
+ *
+ * Both replay the same script; every placement result and the final cell
+ * maps must be identical.
+ *
+ * Usage: bench_inventory [pickups]
+ */
+
+#include "../Common/InventoryGrid.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define GRID_BODY 0
+#define GRID_STASH 1
+#define GRID_CUBE 2
+#define GRID_COUNT 3
+#define MAX_ITEMS 1024
+
+static const BYTE s_gridWidth[GRID_COUNT] = {10, 10, 3};
+static const BYTE s_gridHeight[GRID_COUNT] = {4, 10, 4};
+
+// Rings/gems/potions, charms, wands, helms/gloves, shields, armor/bows, polearms
+static const BYTE s_shapes[][2] = {{1, 1}, {1, 1}, {1, 1}, {1, 2}, {1, 3}, {2, 2}, {2, 2}, {2, 3}, {2, 3}, {2, 4}};
+
+// =============================================================================
+// CELL-SCAN BASELINE
+// =============================================================================
+
+typedef struct LegacyItem
+{
+    DWORD id;
+    BYTE reserved[0x60]; // Rest of the item unit the walks drag through cache
+    BYTE grid, x, y, width, height;
+    struct LegacyItem *pNext;
+    BYTE tail[0x60];
+} LegacyItem;
+
+typedef struct LegacyInventory
+{
+    LegacyItem *cells[GRID_COUNT][10 * 10];
+    LegacyItem *pFirst;
+    DWORD count;
+} LegacyInventory;
+
+static BOOL LegacyCanPlace(const LegacyInventory *pInv, DWORD grid, int x, int y, DWORD w, DWORD h)
+{
+    if (x < 0 || y < 0 || x + (int)w > s_gridWidth[grid] || y + (int)h > s_gridHeight[grid])
+        return FALSE;
+    for (DWORD r = 0; r < h; r++)
+        for (DWORD c = 0; c < w; c++)
+            if (pInv->cells[grid][(y + r) * 10 + x + c])
+                return FALSE;
+    return TRUE;
+}
+
+static BOOL LegacyFindFree(const LegacyInventory *pInv, DWORD grid, DWORD w, DWORD h, int *pX, int *pY)
+{
+    for (int x = 0; x < s_gridWidth[grid]; x++)
+        for (int y = 0; y < s_gridHeight[grid]; y++)
+            if (LegacyCanPlace(pInv, grid, x, y, w, h))
+            {
+                *pX = x;
+                *pY = y;
+                return TRUE;
+            }
+    return FALSE;
+}
+
+static LegacyItem *LegacyFind(const LegacyInventory *pInv, DWORD id)
+{
+    for (LegacyItem *pItem = pInv->pFirst; pItem; pItem = pItem->pNext)
+        if (pItem->id == id)
+            return pItem;
+    return NULL;
+}
+
+static void LegacyMark(LegacyInventory *pInv, LegacyItem *pItem, LegacyItem *pOwner)
+{
+    for (DWORD r = 0; r < pItem->height; r++)
+        for (DWORD c = 0; c < pItem->width; c++)
+            pInv->cells[pItem->grid][(pItem->y + r) * 10 + pItem->x + c] = pOwner;
+}
+
+static BOOL LegacyAutoPlace(LegacyInventory *pInv, LegacyItem *pItem, DWORD grid, int *pX, int *pY)
+{
+    if (!LegacyFindFree(pInv, grid, pItem->width, pItem->height, pX, pY))
+        return FALSE;
+    pItem->grid = (BYTE)grid;
+    pItem->x = (BYTE)*pX;
+    pItem->y = (BYTE)*pY;
+    LegacyMark(pInv, pItem, pItem);
+    pItem->pNext = pInv->pFirst;
+    pInv->pFirst = pItem;
+    pInv->count++;
+    return TRUE;
+}
+
+static BOOL LegacyRemove(LegacyInventory *pInv, DWORD id)
+{
+    for (LegacyItem **ppLink = &pInv->pFirst; *ppLink; ppLink = &(*ppLink)->pNext)
+    {
+        LegacyItem *pItem = *ppLink;
+        if (pItem->id == id)
+        {
+            LegacyMark(pInv, pItem, NULL);
+            *ppLink = pItem->pNext;
+            free(pItem);
+            pInv->count--;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static bool LegacySortLess(const LegacyItem *a, const LegacyItem *b)
+{
+    int areaA = a->width * a->height, areaB = b->width * b->height;
+    if (areaA != areaB)
+        return areaA > areaB;
+    if (a->height != b->height)
+        return a->height > b->height;
+    return a->id < b->id;
+}
+
+static void LegacySort(LegacyInventory *pInv, DWORD grid)
+{
+    std::vector<LegacyItem *> items;
+    for (LegacyItem *pItem = pInv->pFirst; pItem; pItem = pItem->pNext)
+        if (pItem->grid == grid)
+            items.push_back(pItem);
+    std::sort(items.begin(), items.end(), LegacySortLess);
+
+    std::vector<WORD> saved;
+    for (size_t i = 0; i < items.size(); i++)
+        saved.push_back((WORD)(items[i]->x << 8 | items[i]->y));
+
+    memset(pInv->cells[grid], 0, sizeof(pInv->cells[grid]));
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        int x, y;
+        if (!LegacyFindFree(pInv, grid, items[i]->width, items[i]->height, &x, &y))
+        {
+            // Repack does not fit: put everything back
+            memset(pInv->cells[grid], 0, sizeof(pInv->cells[grid]));
+            for (size_t j = 0; j < items.size(); j++)
+            {
+                items[j]->x = (BYTE)(saved[j] >> 8);
+                items[j]->y = (BYTE)saved[j];
+                LegacyMark(pInv, items[j], items[j]);
+            }
+            return;
+        }
+        items[i]->x = (BYTE)x;
+        items[i]->y = (BYTE)y;
+        LegacyMark(pInv, items[i], items[i]);
+    }
+}
+
+// =============================================================================
+// SCRIPT
+// =============================================================================
+
+typedef struct ScriptStep
+{
+    BYTE shape;
+    DWORD hover[4]; // Random cells (grid, x, y packed by the consumer)
+    DWORD sellSeed;
+} ScriptStep;
+
+static std::vector<ScriptStep> g_script;
+
+static DWORD g_rng = 0x1A7E;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+// Placement outcome: grid << 16 | x << 8 | y, or 0xFFFFFFFF when nothing fits
+typedef std::vector<DWORD> Trace;
+
+static DWORD Pack(DWORD grid, int x, int y)
+{
+    return (grid << 16) | ((DWORD)x << 8) | (DWORD)y;
+}
+
+// Shared driver: the same decisions for both implementations
+template <typename Ops> static void RunScript(Ops &ops, Trace &trace, DWORD &hoverSink)
+{
+    std::vector<DWORD> live;
+    DWORD nextId = 1000;
+
+    for (size_t s = 0; s < g_script.size(); s++)
+    {
+        const ScriptStep &step = g_script[s];
+        DWORD id = nextId++;
+        DWORD w = s_shapes[step.shape][0], h = s_shapes[step.shape][1];
+
+        // Pickup handler: already held?
+        if (ops.Has(id))
+        {
+            trace.push_back(0xEEEEEEEE);
+            continue;
+        }
+
+        DWORD placed = 0xFFFFFFFF;
+        for (DWORD g = 0; g < GRID_COUNT && placed == 0xFFFFFFFF; g++)
+        {
+            int x, y;
+            if (ops.AutoPlace(id, g, w, h, &x, &y))
+                placed = Pack(g, x, y);
+        }
+        trace.push_back(placed);
+
+        if (placed != 0xFFFFFFFF)
+        {
+            live.push_back(id);
+        }
+        else
+        {
+            // Vendor run: sell 60% by GUID, then tidy up
+            DWORD seed = step.sellSeed;
+            DWORD sell = (DWORD)live.size() * 6 / 10;
+            for (DWORD n = 0; n < sell; n++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                DWORD pick = (seed >> 8) % live.size();
+                trace.push_back(ops.Remove(live[pick]) ? live[pick] : 0xDDDDDDDD);
+                live[pick] = live.back();
+                live.pop_back();
+            }
+            ops.Sort(GRID_STASH);
+            ops.Sort(GRID_BODY);
+        }
+
+        if (s % 25 == 24)
+        {
+            ops.Sort(GRID_STASH);
+        }
+
+        for (DWORD i = 0; i < 4; i++)
+        {
+            DWORD g = step.hover[i] % GRID_COUNT;
+            hoverSink += ops.ItemAt(g, (int)((step.hover[i] >> 8) % s_gridWidth[g]),
+                                    (int)((step.hover[i] >> 16) % s_gridHeight[g]));
+        }
+    }
+}
+
+struct LegacyOps
+{
+    LegacyInventory inv;
+
+    BOOL Has(DWORD id) { return LegacyFind(&inv, id) != NULL; }
+    BOOL AutoPlace(DWORD id, DWORD grid, DWORD w, DWORD h, int *pX, int *pY)
+    {
+        LegacyItem *pItem = (LegacyItem *)calloc(1, sizeof(LegacyItem));
+        pItem->id = id;
+        pItem->width = (BYTE)w;
+        pItem->height = (BYTE)h;
+        if (LegacyAutoPlace(&inv, pItem, grid, pX, pY))
+            return TRUE;
+        free(pItem);
+        return FALSE;
+    }
+    BOOL Remove(DWORD id) { return LegacyRemove(&inv, id); }
+    void Sort(DWORD grid) { LegacySort(&inv, grid); }
+    DWORD ItemAt(DWORD grid, int x, int y)
+    {
+        LegacyItem *pItem = inv.cells[grid][y * 10 + x];
+        return pItem ? pItem->id : 0;
+    }
+};
+
+struct BitboardOps
+{
+    Inventory *pInv;
+
+    BOOL Has(DWORD id) { return INVENTORY_FindItem(pInv, id) != NULL; }
+    BOOL AutoPlace(DWORD id, DWORD grid, DWORD w, DWORD h, int *pX, int *pY)
+    {
+        return INVENTORY_AutoPlace(pInv, id, grid, w, h, INVSCAN_COLUMNS, pX, pY);
+    }
+    BOOL Remove(DWORD id) { return INVENTORY_Remove(pInv, id); }
+    void Sort(DWORD grid) { INVENTORY_Sort(pInv, grid, INVSCAN_COLUMNS); }
+    DWORD ItemAt(DWORD grid, int x, int y) { return INVENTORY_GetItemAt(pInv, grid, x, y); }
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    DWORD pickups = (argc > 1) ? (DWORD)atoi(argv[1]) : 200000;
+    BOOL ok = TRUE;
+
+    g_script.resize(pickups);
+    for (DWORD i = 0; i < pickups; i++)
+    {
+        g_script[i].shape = (BYTE)(NextRandom() % D2_ARRAY_SIZE(s_shapes));
+        for (DWORD h = 0; h < 4; h++)
+            g_script[i].hover[h] = NextRandom();
+        g_script[i].sellSeed = NextRandom();
+    }
+
+    LegacyOps legacy;
+    memset(&legacy.inv, 0, sizeof(legacy.inv));
+    Trace legacyTrace;
+    DWORD legacyHover = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    RunScript(legacy, legacyTrace, legacyHover);
+    double legacySeconds = Seconds(start);
+
+    InventoryDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.gridCount = GRID_COUNT;
+    for (DWORD g = 0; g < GRID_COUNT; g++)
+    {
+        desc.width[g] = s_gridWidth[g];
+        desc.height[g] = s_gridHeight[g];
+    }
+    desc.maxItems = MAX_ITEMS;
+    BitboardOps bitboard;
+    bitboard.pInv = INVENTORY_Create(&desc);
+    Trace bitboardTrace;
+    DWORD bitboardHover = 0;
+    start = std::chrono::steady_clock::now();
+    RunScript(bitboard, bitboardTrace, bitboardHover);
+    double bitboardSeconds = Seconds(start);
+
+    // Final layouts cell by cell
+    DWORD cellMismatches = 0;
+    for (DWORD g = 0; g < GRID_COUNT; g++)
+    {
+        for (int y = 0; y < s_gridHeight[g]; y++)
+        {
+            for (int x = 0; x < s_gridWidth[g]; x++)
+            {
+                cellMismatches += legacy.ItemAt(g, x, y) != bitboard.ItemAt(g, x, y);
+            }
+        }
+    }
+
+    // Free-cell accounting and rejection of overlapping/out-of-bounds placements
+    DWORD freeCells = 0;
+    for (DWORD g = 0; g < GRID_COUNT; g++)
+        freeCells += INVENTORY_GetFreeCells(bitboard.pInv, g);
+    DWORD usedCells = 0;
+    for (LegacyItem *pItem = legacy.inv.pFirst; pItem; pItem = pItem->pNext)
+        usedCells += pItem->width * pItem->height;
+    BOOL boundsOk = !INVENTORY_Place(bitboard.pInv, 1, GRID_CUBE, 2, 0, 2, 1) &&
+                    !INVENTORY_Place(bitboard.pInv, 2, GRID_STASH, 0, 8, 1, 3) &&
+                    !INVENTORY_Place(bitboard.pInv, 3, GRID_BODY, -1, 0, 1, 1);
+
+    BOOL traceOk = legacyTrace == bitboardTrace && legacyHover == bitboardHover;
+    printf("session: %u pickups, %u trace events, %u items held at the end\n", pickups, (DWORD)legacyTrace.size(),
+           INVENTORY_GetItemCount(bitboard.pInv));
+    printf("  cells:    %7.1f ns/pickup\n", legacySeconds * 1e9 / pickups);
+    printf("  bitboard: %7.1f ns/pickup (%.1fx)\n", bitboardSeconds * 1e9 / pickups,
+           bitboardSeconds > 0 ? legacySeconds / bitboardSeconds : 0.0);
+    printf("verify:  placements, sales and hovers identical -> %s\n", traceOk ? "ok" : "FAILED");
+    printf("verify:  final layout %u cell mismatches, free cells %u of %u, bounds checks -> %s\n", cellMismatches,
+           freeCells, 40 + 100 + 12, (!cellMismatches && freeCells + usedCells == 152 && boundsOk) ? "ok" : "FAILED");
+    ok &= traceOk && !cellMismatches && freeCells + usedCells == 152 && boundsOk &&
+          INVENTORY_GetItemCount(bitboard.pInv) == legacy.inv.count;
+
+    while (legacy.inv.pFirst)
+    {
+        LegacyRemove(&legacy.inv, legacy.inv.pFirst->id);
+    }
+    INVENTORY_Destroy(bitboard.pInv);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1129 @@
+/*
+ * BenchItemCodec.cpp - Bit-at-a-time item parsing vs the buffered item codec
+ *
+ *   legacy: D2's approach. A bit reader that fetches one bit per step with a
+ *           bounds check per call, a heap Unit-sized block per item and a
+ *           heap node per stat, as D2Common does while loading a character.
+ *   codec:  D2S_Validate / D2S_Decode / D2S_Encode over ItemCodec, into
+ *           caller-provided item arrays.
+ *
+ * Load: stash-heavy 1.10 characters (full inventory, stash and cube,
+ * socketed gear with runes and jewels, sets, runewords, rares, ears,
+ * personalized items, a corpse, mercenary gear and an iron golem).
+ *
+ * Verification:
+ *   - every generated character decodes to exactly the items it was built
+ *     from, and re-encodes byte-identically;
+ *   - the legacy parser and the codec agree item for item and stat for stat;
+ *   - fuzzing (bit flips, byte overwrites, truncations and insertions, with
+ *     the size and checksum fixed up so the walk gets past the header) must
+ *     not crash, Validate must accept exactly what Decode accepts, and an
+ *     accepted file must re-encode to something that decodes to the same
+ *     items, agree with the legacy parser, and re-encode stably.
+ *
+ * Usage: bench_itemcodec [characters] [passes] [fuzz iterations]
+ */
+
+#include "../Common/CharacterCodec.hpp"
+
+#include <chrono>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define MAX_FILE (1 << 20)
+#define MAX_ITEMS 2048
+
+static DWORD g_rng = 0x1C0DEC5;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static DWORD Roll(DWORD n)
+{
+    return NextRandom() % n;
+}
+
+static DWORD MakeCode(const char *sz)
+{
+    return (DWORD)(BYTE)sz[0] | ((DWORD)(BYTE)sz[1] << 8) | ((DWORD)(BYTE)sz[2] << 16) | ((DWORD)(BYTE)sz[3] << 24);
+}
+
+// =============================================================================
+// TABLES
+// =============================================================================
+
+typedef struct BenchStat
+{
+    WORD id;
+    BYTE saveBits;
+    BYTE paramBits;
+    int saveAdd;
+    BYTE chained;
+    BYTE member; // Only stored after its chain head
+} BenchStat;
+
+// A slice of ItemStatCost's save columns
+static const BenchStat s_stats[] = {
+    {0, 8, 0, 32, 0, 0},   {1, 7, 0, 32, 0, 0},   {2, 7, 0, 32, 0, 0},   {3, 7, 0, 32, 0, 0},
+    {7, 9, 0, 32, 0, 0},   {9, 8, 0, 32, 0, 0},   {16, 9, 0, 0, 0, 0},   {17, 9, 0, 0, 1, 0},
+    {18, 9, 0, 0, 0, 1},   {19, 10, 0, 0, 0, 0},  {21, 6, 0, 0, 0, 0},   {22, 7, 0, 0, 0, 0},
+    {31, 11, 0, 10, 0, 0}, {39, 8, 0, 50, 0, 0},  {41, 8, 0, 50, 0, 0},  {43, 8, 0, 50, 0, 0},
+    {45, 8, 0, 50, 0, 0},  {48, 8, 0, 0, 1, 0},   {49, 9, 0, 0, 0, 1},   {50, 6, 0, 0, 1, 0},
+    {51, 10, 0, 0, 0, 1},  {52, 8, 0, 0, 1, 0},   {53, 9, 0, 0, 0, 1},   {54, 8, 0, 0, 2, 0},
+    {55, 9, 0, 0, 0, 1},   {56, 8, 0, 0, 0, 1},   {57, 10, 0, 0, 2, 0},  {58, 10, 0, 0, 0, 1},
+    {59, 9, 0, 0, 0, 1},   {60, 7, 0, 0, 0, 0},   {62, 7, 0, 0, 0, 0},   {79, 9, 0, 100, 0, 0},
+    {80, 8, 0, 100, 0, 0}, {83, 3, 3, 0, 0, 0},   {93, 7, 0, 20, 0, 0},  {96, 7, 0, 20, 0, 0},
+    {99, 7, 0, 20, 0, 0},  {105, 7, 0, 20, 0, 0}, {107, 3, 9, 0, 0, 0},  {127, 3, 0, 0, 0, 0},
+    {188, 3, 16, 0, 0, 0}, {194, 4, 0, 0, 0, 0},  {195, 7, 16, 0, 0, 0}, {198, 7, 16, 0, 0, 0},
+    {201, 7, 16, 0, 0, 0}, {214, 6, 0, 0, 0, 0},  {252, 6, 0, 0, 0, 0},  {253, 1, 0, 0, 0, 0},
+};
+
+typedef struct BenchCode
+{
+    const char *szCode;
+    DWORD itemClass;
+    BYTE kind;
+} BenchCode;
+
+#define KIND_GEAR 0
+#define KIND_SIMPLE 1   // Potions, gems, runes
+#define KIND_SOCKETABLE 2 // Runes and gems that go in sockets
+#define KIND_JEWEL 3
+
+static const BenchCode s_codes[] = {
+    {"hax ", ITEMCLASS_WEAPON, KIND_GEAR},
+    {"7cr ", ITEMCLASS_WEAPON, KIND_GEAR},
+    {"6lw ", ITEMCLASS_WEAPON, KIND_GEAR},
+    {"jav ", ITEMCLASS_WEAPON | ITEMCLASS_STACKABLE, KIND_GEAR},
+    {"cap ", ITEMCLASS_ARMOR, KIND_GEAR},
+    {"uap ", ITEMCLASS_ARMOR, KIND_GEAR},
+    {"xtp ", ITEMCLASS_ARMOR, KIND_GEAR},
+    {"uit ", ITEMCLASS_ARMOR, KIND_GEAR},
+    {"ulg ", ITEMCLASS_ARMOR, KIND_GEAR},
+    {"rin ", 0, KIND_GEAR},
+    {"amu ", 0, KIND_GEAR},
+    {"cm1 ", 0, KIND_GEAR},
+    {"tbk ", ITEMCLASS_TOME | ITEMCLASS_STACKABLE, KIND_GEAR},
+    {"key ", ITEMCLASS_STACKABLE, KIND_GEAR},
+    {"hp5 ", 0, KIND_SIMPLE},
+    {"rvl ", 0, KIND_SIMPLE},
+    {"r01 ", 0, KIND_SOCKETABLE},
+    {"r22 ", 0, KIND_SOCKETABLE},
+    {"r33 ", 0, KIND_SOCKETABLE},
+    {"gpw ", 0, KIND_SOCKETABLE},
+    {"skz ", 0, KIND_SOCKETABLE},
+    {"jew ", 0, KIND_JEWEL},
+};
+
+static DWORD s_codeValues[D2_ARRAY_SIZE(s_codes)];
+
+static DWORD __cdecl ItemClass(void *pContext, DWORD code)
+{
+    (void)pContext;
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(s_codes); i++)
+    {
+        if (s_codeValues[i] == code)
+        {
+            return s_codes[i].itemClass;
+        }
+    }
+    return ITEMCLASS_UNKNOWN;
+}
+
+static const BenchStat *FindStat(DWORD id)
+{
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(s_stats); i++)
+    {
+        if (s_stats[i].id == id)
+        {
+            return &s_stats[i];
+        }
+    }
+    return NULL;
+}
+
+// =============================================================================
+// GENERATOR
+// =============================================================================
+
+static void BlankItem(D2Item *pItem)
+{
+    memset(pItem, 0, sizeof(*pItem));
+    pItem->gfx = 0xFF;
+    pItem->autoAffix = 0xFFFF;
+    pItem->version = 101;
+}
+
+static DWORD PickCode(BYTE kind)
+{
+    for (;;)
+    {
+        DWORD i = Roll(D2_ARRAY_SIZE(s_codes));
+        if (s_codes[i].kind == kind)
+        {
+            return i;
+        }
+    }
+}
+
+static void RandomName(char *szName)
+{
+    DWORD length = 2 + Roll(ITEM_MAX_NAME - 2);
+    for (DWORD i = 0; i < length; i++)
+    {
+        szName[i] = (char)('a' + Roll(26));
+    }
+    szName[length] = 0;
+}
+
+static void AddStats(D2Item *pItem, BYTE list, DWORD count)
+{
+    for (DWORD n = 0; n < count; n++)
+    {
+        const BenchStat *pHead;
+        do
+        {
+            pHead = &s_stats[Roll(D2_ARRAY_SIZE(s_stats))];
+        } while (pHead->member);
+        if (pItem->statCount + pHead->chained + 1u > ITEM_MAX_STATS)
+        {
+            return;
+        }
+        for (DWORD k = 0; k <= pHead->chained; k++)
+        {
+            const BenchStat *pStat = FindStat(pHead->id + k);
+            ItemStat *pOut = &pItem->stats[pItem->statCount++];
+            pOut->id = pStat->id;
+            pOut->list = list;
+            pOut->param = pStat->paramBits ? Roll(1u << pStat->paramBits) : 0;
+            pOut->value = (int)Roll(1u << pStat->saveBits) - pStat->saveAdd;
+        }
+    }
+}
+
+static void MakeExtended(D2Item *pItem, DWORD codeIndex, BYTE quality)
+{
+    DWORD itemClass = s_codes[codeIndex].itemClass;
+    pItem->code = s_codeValues[codeIndex];
+    pItem->guid = NextRandom();
+    pItem->level = (BYTE)(1 + Roll(99));
+    pItem->quality = quality;
+    if (Roll(4) == 0)
+    {
+        pItem->gfx = (BYTE)Roll(8);
+    }
+    if (Roll(4) == 0)
+    {
+        pItem->autoAffix = (WORD)Roll(2048);
+    }
+
+    DWORD baseStats = 0;
+    switch (quality)
+    {
+    case ITEMQUAL_LOW:
+    case ITEMQUAL_SUPERIOR:
+        pItem->qualityData[0] = (WORD)Roll(8);
+        baseStats = quality == ITEMQUAL_SUPERIOR ? 2 : 0;
+        break;
+    case ITEMQUAL_MAGIC:
+        pItem->qualityData[0] = (WORD)Roll(2048);
+        pItem->qualityData[1] = (WORD)Roll(2048);
+        baseStats = 2 + Roll(3);
+        break;
+    case ITEMQUAL_SET:
+    case ITEMQUAL_UNIQUE:
+        pItem->qualityData[0] = (WORD)Roll(4096);
+        baseStats = 5 + Roll(8);
+        break;
+    case ITEMQUAL_RARE:
+    case ITEMQUAL_CRAFTED:
+        pItem->qualityData[0] = (WORD)Roll(256);
+        pItem->qualityData[1] = (WORD)Roll(256);
+        for (DWORD i = 0; i < 6; i++)
+        {
+            pItem->qualityData[2 + i] = (WORD)(Roll(3) ? 1 + Roll(2047) : 0);
+        }
+        baseStats = 4 + Roll(6);
+        break;
+    }
+
+    pItem->flags |= ITEMFLAG_IDENTIFIED | (Roll(10) == 0 ? ITEMFLAG_ETHEREAL : 0);
+    if (Roll(40) == 0)
+    {
+        pItem->flags |= ITEMFLAG_PERSONALIZED;
+        RandomName(pItem->szName);
+    }
+    if (itemClass & ITEMCLASS_TOME)
+    {
+        pItem->tome = (BYTE)Roll(32);
+    }
+    if (Roll(100) == 0)
+    {
+        pItem->hasRealmData = 1;
+        pItem->realmData[0] = NextRandom();
+        pItem->realmData[1] = NextRandom();
+        pItem->realmData[2] = NextRandom();
+    }
+    if (itemClass & ITEMCLASS_ARMOR)
+    {
+        pItem->defense = (WORD)Roll(2038);
+    }
+    if (itemClass & (ITEMCLASS_ARMOR | ITEMCLASS_WEAPON))
+    {
+        pItem->maxDurability = (BYTE)Roll(256);
+        pItem->durability = (WORD)(pItem->maxDurability ? Roll(pItem->maxDurability + 1u) : 0);
+    }
+    if (itemClass & ITEMCLASS_STACKABLE)
+    {
+        pItem->quantity = (WORD)Roll(512);
+    }
+    if (quality == ITEMQUAL_SET)
+    {
+        pItem->setMask = (BYTE)Roll(32);
+    }
+
+    AddStats(pItem, ITEM_LIST_BASE, baseStats);
+    for (DWORD bit = 0; bit < 5; bit++)
+    {
+        if (pItem->setMask & (1u << bit))
+        {
+            AddStats(pItem, (BYTE)(ITEM_LIST_SET + bit), 1 + Roll(3));
+        }
+    }
+}
+
+static void MakeChild(D2Item *pItem)
+{
+    BlankItem(pItem);
+    pItem->location = ITEM_LOCATION_SOCKETED;
+    pItem->x = (BYTE)Roll(16);
+    if (Roll(4) == 0)
+    {
+        MakeExtended(pItem, PickCode(KIND_JEWEL), Roll(2) ? ITEMQUAL_MAGIC : ITEMQUAL_RARE);
+        return;
+    }
+    pItem->flags = ITEMFLAG_IDENTIFIED | ITEMFLAG_SIMPLE;
+    pItem->code = s_codeValues[PickCode(KIND_SOCKETABLE)];
+}
+
+// Appends a top-level item and its socket contents; returns items added
+static DWORD MakeItem(D2Item *pItems, DWORD room)
+{
+    static const BYTE s_locations[] = {0, 1, 2, 4};
+    D2Item *pItem = &pItems[0];
+    BlankItem(pItem);
+    pItem->location = s_locations[Roll(D2_ARRAY_SIZE(s_locations))];
+    pItem->equipped = (BYTE)Roll(16);
+    pItem->x = (BYTE)Roll(16);
+    pItem->y = (BYTE)Roll(16);
+    pItem->page = (BYTE)Roll(8);
+
+    DWORD roll = Roll(100);
+    if (roll < 3)
+    {
+        pItem->flags = ITEMFLAG_IDENTIFIED | ITEMFLAG_EAR;
+        pItem->earClass = (BYTE)Roll(7);
+        pItem->earLevel = (BYTE)(1 + Roll(99));
+        RandomName(pItem->szName);
+        return 1;
+    }
+    if (roll < 20)
+    {
+        pItem->flags = ITEMFLAG_IDENTIFIED | ITEMFLAG_SIMPLE;
+        pItem->code = s_codeValues[PickCode(Roll(3) ? KIND_SIMPLE : KIND_SOCKETABLE)];
+        return 1;
+    }
+
+    static const BYTE s_qualities[] = {ITEMQUAL_LOW,   ITEMQUAL_NORMAL, ITEMQUAL_SUPERIOR, ITEMQUAL_MAGIC,
+                                       ITEMQUAL_MAGIC, ITEMQUAL_SET,    ITEMQUAL_RARE,     ITEMQUAL_RARE,
+                                       ITEMQUAL_UNIQUE, ITEMQUAL_UNIQUE, ITEMQUAL_CRAFTED};
+    BYTE quality = s_qualities[Roll(D2_ARRAY_SIZE(s_qualities))];
+    MakeExtended(pItem, PickCode(KIND_GEAR), quality);
+
+    DWORD added = 1;
+    DWORD itemClass = ItemClass(NULL, pItem->code);
+    if ((itemClass & (ITEMCLASS_ARMOR | ITEMCLASS_WEAPON)) && Roll(3) == 0)
+    {
+        pItem->flags |= ITEMFLAG_SOCKETED;
+        pItem->sockets = (BYTE)(1 + Roll(6));
+        DWORD filled = Roll(pItem->sockets + 1u);
+        if (filled > room - 1)
+        {
+            filled = room - 1;
+        }
+        if (quality == ITEMQUAL_NORMAL && filled == pItem->sockets && Roll(2))
+        {
+            pItem->flags |= ITEMFLAG_RUNEWORD;
+            pItem->runeword = (WORD)Roll(65536);
+            AddStats(pItem, ITEM_LIST_RUNEWORD, 3 + Roll(6));
+        }
+        pItem->socketsFilled = (BYTE)filled;
+        for (DWORD i = 0; i < filled; i++)
+        {
+            MakeChild(&pItems[added++]);
+        }
+    }
+    return added;
+}
+
+static DWORD MakeItemList(D2Item *pItems, DWORD topLevel, DWORD capacity)
+{
+    DWORD count = 0;
+    for (DWORD i = 0; i < topLevel && capacity - count >= 8; i++)
+    {
+        count += MakeItem(&pItems[count], capacity - count);
+    }
+    return count;
+}
+
+typedef struct Character
+{
+    D2Character chr;
+    std::vector<D2Item> items;
+    std::vector<D2Item> corpseItems;
+    std::vector<D2Item> mercItems;
+} Character;
+
+static void BindLists(Character *pChar, DWORD capacity)
+{
+    pChar->items.resize(capacity);
+    pChar->corpseItems.resize(capacity);
+    pChar->mercItems.resize(capacity);
+    pChar->chr.items.pItems = &pChar->items[0];
+    pChar->chr.items.capacity = capacity;
+    pChar->chr.corpseItems.pItems = &pChar->corpseItems[0];
+    pChar->chr.corpseItems.capacity = capacity;
+    pChar->chr.mercItems.pItems = &pChar->mercItems[0];
+    pChar->chr.mercItems.capacity = capacity;
+}
+
+static void MakeCharacter(Character *pChar)
+{
+    D2Character *pChr = &pChar->chr;
+    memset(pChr, 0, sizeof(*pChr));
+    BindLists(pChar, MAX_ITEMS);
+
+    for (DWORD i = 0; i < D2S_HEADER_SIZE; i++)
+    {
+        pChr->header[i] = (BYTE)NextRandom();
+    }
+    DWORD signature = D2S_SIGNATURE, version = D2S_VERSION, mercId = Roll(10) < 7 ? NextRandom() | 1 : 0;
+    memcpy(pChr->header, &signature, 4);
+    memcpy(pChr->header + 4, &version, 4);
+    memset(pChr->header + 20, 0, 16);
+    RandomName((char *)pChr->header + 20);
+    pChr->header[36] = (BYTE)((Roll(8) ? D2S_STATUS_EXPANSION : 0) | (Roll(2) << 2));
+    pChr->header[40] = (BYTE)Roll(7);
+    pChr->header[43] = (BYTE)(1 + Roll(99));
+    memcpy(pChr->header + 179, &mercId, 4);
+    BOOL expansion = (pChr->header[36] & D2S_STATUS_EXPANSION) != 0;
+
+    for (DWORD id = 0; id < D2S_ATTRIBUTES; id++)
+    {
+        if (id < 4 || id >= 6 || Roll(2))
+        {
+            static const BYTE s_bits[D2S_ATTRIBUTES] = {10, 10, 10, 10, 10, 8, 21, 21, 21, 21, 21, 21, 7, 32, 25, 25};
+            pChr->attributeMask |= 1u << id;
+            pChr->attributes[id] = s_bits[id] == 32 ? NextRandom() : Roll(1u << s_bits[id]);
+        }
+    }
+    for (DWORD i = 0; i < D2S_SKILLS; i++)
+    {
+        pChr->skills[i] = (BYTE)Roll(21);
+    }
+
+    // Inventory, belt, equipment, stash and cube: stash-heavy
+    pChr->items.count = MakeItemList(pChr->items.pItems, 80 + Roll(120), MAX_ITEMS);
+    if (Roll(4) == 0)
+    {
+        pChr->hasCorpse = 1;
+        for (DWORD i = 0; i < D2S_CORPSE_DATA; i++)
+        {
+            pChr->corpseData[i] = (BYTE)NextRandom();
+        }
+        pChr->corpseItems.count = MakeItemList(pChr->corpseItems.pItems, 5 + Roll(20), MAX_ITEMS);
+    }
+    if (expansion && mercId)
+    {
+        pChr->mercItems.count = MakeItemList(pChr->mercItems.pItems, Roll(6), MAX_ITEMS);
+    }
+    if (expansion && Roll(10) == 0)
+    {
+        D2Item golem[8];
+        pChr->hasGolem = 1;
+        do
+        {
+            MakeItem(golem, 1);
+        } while (golem[0].flags & (ITEMFLAG_EAR | ITEMFLAG_SIMPLE));
+        golem[0].location = 0;
+        pChr->golem = golem[0];
+    }
+}
+
+// =============================================================================
+// LEGACY BASELINE
+// =============================================================================
+
+typedef struct LegacyBits
+{
+    const BYTE *pData;
+    DWORD sizeBits;
+    DWORD pos;
+    BOOL bad;
+} LegacyBits;
+
+static DWORD LegacyRead(LegacyBits *pBits, DWORD bits)
+{
+    DWORD value = 0;
+    for (DWORD i = 0; i < bits; i++)
+    {
+        if (pBits->pos >= pBits->sizeBits)
+        {
+            pBits->bad = TRUE;
+            return 0;
+        }
+        value |= (DWORD)((pBits->pData[pBits->pos >> 3] >> (pBits->pos & 7)) & 1) << i;
+        pBits->pos++;
+    }
+    return value;
+}
+
+typedef struct LegacyStat
+{
+    WORD id;
+    BYTE list;
+    DWORD param;
+    int value;
+    struct LegacyStat *pNext;
+} LegacyStat;
+
+typedef struct LegacyItem
+{
+    D2Item body; // Scalars only; the stats live on the list
+    LegacyStat *pStats;
+    struct LegacyItem *pNext;
+} LegacyItem;
+
+typedef struct LegacyCharacter
+{
+    DWORD attributes[D2S_ATTRIBUTES];
+    LegacyItem *pFirst;
+    LegacyItem *pLast;
+    DWORD itemCount;
+} LegacyCharacter;
+
+static const BenchStat *s_statIndex[ITEM_STAT_IDS];
+
+static void LegacyName(LegacyBits *pBits, char *szName)
+{
+    for (DWORD i = 0; i < ITEM_MAX_NAME; i++)
+    {
+        szName[i] = (char)LegacyRead(pBits, 7);
+        if (!szName[i])
+        {
+            return;
+        }
+    }
+    pBits->bad = TRUE;
+}
+
+static BOOL LegacyStats(LegacyBits *pBits, LegacyItem *pItem, BYTE list)
+{
+    LegacyStat **ppTail = &pItem->pStats;
+    while (*ppTail)
+    {
+        ppTail = &(*ppTail)->pNext;
+    }
+    for (;;)
+    {
+        DWORD id = LegacyRead(pBits, 9);
+        if (pBits->bad)
+        {
+            return FALSE;
+        }
+        if (id == ITEM_STAT_END)
+        {
+            return TRUE;
+        }
+        const BenchStat *pHead = s_statIndex[id];
+        if (!pHead)
+        {
+            return FALSE;
+        }
+        for (DWORD k = 0; k <= pHead->chained; k++)
+        {
+            const BenchStat *pStat = s_statIndex[id + k];
+            if (!pStat)
+            {
+                return FALSE;
+            }
+            LegacyStat *pNode = (LegacyStat *)calloc(1, sizeof(LegacyStat));
+            pNode->id = (WORD)(id + k);
+            pNode->list = list;
+            pNode->param = pStat->paramBits ? LegacyRead(pBits, pStat->paramBits) : 0;
+            pNode->value = (int)LegacyRead(pBits, pStat->saveBits) - pStat->saveAdd;
+            *ppTail = pNode;
+            ppTail = &pNode->pNext;
+            pItem->body.statCount++;
+        }
+    }
+}
+
+static LegacyItem *LegacyParseItem(LegacyBits *pBits)
+{
+    LegacyItem *pItem = (LegacyItem *)calloc(1, sizeof(LegacyItem));
+    D2Item *p = &pItem->body;
+    p->gfx = 0xFF;
+    p->autoAffix = 0xFFFF;
+    if (LegacyRead(pBits, 16) != 0x4D4A)
+    {
+        pBits->bad = TRUE;
+        return pItem;
+    }
+    p->flags = LegacyRead(pBits, 32);
+    p->version = (WORD)LegacyRead(pBits, 10);
+    p->location = (BYTE)LegacyRead(pBits, 3);
+    p->equipped = (BYTE)LegacyRead(pBits, 4);
+    p->x = (BYTE)LegacyRead(pBits, 4);
+    p->y = (BYTE)LegacyRead(pBits, 4);
+    p->page = (BYTE)LegacyRead(pBits, 3);
+    if (p->flags & ITEMFLAG_EAR)
+    {
+        p->earClass = (BYTE)LegacyRead(pBits, 3);
+        p->earLevel = (BYTE)LegacyRead(pBits, 7);
+        LegacyName(pBits, p->szName);
+        pBits->pos = (pBits->pos + 7) & ~7u;
+        return pItem;
+    }
+    p->code = LegacyRead(pBits, 32);
+    p->socketsFilled = (BYTE)LegacyRead(pBits, (p->flags & ITEMFLAG_SIMPLE) ? 1 : 3);
+    if (p->flags & ITEMFLAG_SIMPLE)
+    {
+        pBits->pos = (pBits->pos + 7) & ~7u;
+        return pItem;
+    }
+    DWORD itemClass = ItemClass(NULL, p->code);
+    p->guid = LegacyRead(pBits, 32);
+    p->level = (BYTE)LegacyRead(pBits, 7);
+    p->quality = (BYTE)LegacyRead(pBits, 4);
+    if (LegacyRead(pBits, 1))
+    {
+        p->gfx = (BYTE)LegacyRead(pBits, 3);
+    }
+    if (LegacyRead(pBits, 1))
+    {
+        p->autoAffix = (WORD)LegacyRead(pBits, 11);
+    }
+    switch (p->quality)
+    {
+    case ITEMQUAL_LOW:
+    case ITEMQUAL_SUPERIOR:
+        p->qualityData[0] = (WORD)LegacyRead(pBits, 3);
+        break;
+    case ITEMQUAL_MAGIC:
+        p->qualityData[0] = (WORD)LegacyRead(pBits, 11);
+        p->qualityData[1] = (WORD)LegacyRead(pBits, 11);
+        break;
+    case ITEMQUAL_SET:
+    case ITEMQUAL_UNIQUE:
+        p->qualityData[0] = (WORD)LegacyRead(pBits, 12);
+        break;
+    case ITEMQUAL_RARE:
+    case ITEMQUAL_CRAFTED:
+        p->qualityData[0] = (WORD)LegacyRead(pBits, 8);
+        p->qualityData[1] = (WORD)LegacyRead(pBits, 8);
+        for (DWORD i = 0; i < 6; i++)
+        {
+            if (LegacyRead(pBits, 1))
+            {
+                p->qualityData[2 + i] = (WORD)LegacyRead(pBits, 11);
+            }
+        }
+        break;
+    }
+    if (p->flags & ITEMFLAG_RUNEWORD)
+    {
+        p->runeword = (WORD)LegacyRead(pBits, 16);
+    }
+    if (p->flags & ITEMFLAG_PERSONALIZED)
+    {
+        LegacyName(pBits, p->szName);
+    }
+    if (itemClass & ITEMCLASS_TOME)
+    {
+        p->tome = (BYTE)LegacyRead(pBits, 5);
+    }
+    p->hasRealmData = (BYTE)LegacyRead(pBits, 1);
+    if (p->hasRealmData)
+    {
+        for (DWORD i = 0; i < 3; i++)
+        {
+            p->realmData[i] = LegacyRead(pBits, 32);
+        }
+    }
+    if (itemClass & ITEMCLASS_ARMOR)
+    {
+        p->defense = (WORD)(LegacyRead(pBits, 11) - 10);
+    }
+    if (itemClass & (ITEMCLASS_ARMOR | ITEMCLASS_WEAPON))
+    {
+        p->maxDurability = (BYTE)LegacyRead(pBits, 8);
+        if (p->maxDurability)
+        {
+            p->durability = (WORD)LegacyRead(pBits, 9);
+        }
+    }
+    if (itemClass & ITEMCLASS_STACKABLE)
+    {
+        p->quantity = (WORD)LegacyRead(pBits, 9);
+    }
+    if (p->flags & ITEMFLAG_SOCKETED)
+    {
+        p->sockets = (BYTE)LegacyRead(pBits, 4);
+    }
+    if (p->quality == ITEMQUAL_SET)
+    {
+        p->setMask = (BYTE)LegacyRead(pBits, 5);
+    }
+    if (!LegacyStats(pBits, pItem, ITEM_LIST_BASE))
+    {
+        pBits->bad = TRUE;
+    }
+    for (DWORD bit = 0; bit < 5 && !pBits->bad; bit++)
+    {
+        if ((p->setMask & (1u << bit)) && !LegacyStats(pBits, pItem, (BYTE)(ITEM_LIST_SET + bit)))
+        {
+            pBits->bad = TRUE;
+        }
+    }
+    if (!pBits->bad && (p->flags & ITEMFLAG_RUNEWORD) && !LegacyStats(pBits, pItem, ITEM_LIST_RUNEWORD))
+    {
+        pBits->bad = TRUE;
+    }
+    pBits->pos = (pBits->pos + 7) & ~7u;
+    return pItem;
+}
+
+static void LegacyAppend(LegacyCharacter *pChar, LegacyItem *pItem)
+{
+    if (pChar->pLast)
+    {
+        pChar->pLast->pNext = pItem;
+    }
+    else
+    {
+        pChar->pFirst = pItem;
+    }
+    pChar->pLast = pItem;
+    pChar->itemCount++;
+}
+
+static BOOL LegacyParseList(LegacyBits *pBits, LegacyCharacter *pChar)
+{
+    if (LegacyRead(pBits, 16) != 0x4D4A)
+    {
+        return FALSE;
+    }
+    DWORD count = LegacyRead(pBits, 16);
+    for (DWORD i = 0; i < count && !pBits->bad; i++)
+    {
+        LegacyItem *pItem = LegacyParseItem(pBits);
+        LegacyAppend(pChar, pItem);
+        DWORD children = (pItem->body.flags & ITEMFLAG_EAR) ? 0 : pItem->body.socketsFilled;
+        for (DWORD k = 0; k < children && !pBits->bad; k++)
+        {
+            LegacyAppend(pChar, LegacyParseItem(pBits));
+        }
+    }
+    return !pBits->bad;
+}
+
+static void LegacyFree(LegacyCharacter *pChar)
+{
+    while (pChar->pFirst)
+    {
+        LegacyItem *pItem = pChar->pFirst;
+        pChar->pFirst = pItem->pNext;
+        while (pItem->pStats)
+        {
+            LegacyStat *pStat = pItem->pStats;
+            pItem->pStats = pStat->pNext;
+            free(pStat);
+        }
+        free(pItem);
+    }
+    pChar->pLast = NULL;
+    pChar->itemCount = 0;
+}
+
+static DWORD LegacyDword(const BYTE *p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static BOOL LegacyLoad(const BYTE *pData, DWORD size, LegacyCharacter *pChar)
+{
+    memset(pChar, 0, sizeof(*pChar));
+    if (size < D2S_HEADER_SIZE + 4 || D2S_Checksum(pData, size) != LegacyDword(pData + 12))
+    {
+        return FALSE;
+    }
+    static const BYTE s_bits[D2S_ATTRIBUTES] = {10, 10, 10, 10, 10, 8, 21, 21, 21, 21, 21, 21, 7, 32, 25, 25};
+    LegacyBits bits = {pData, size * 8, (D2S_HEADER_SIZE + 2) * 8, FALSE};
+    for (;;)
+    {
+        DWORD id = LegacyRead(&bits, 9);
+        if (bits.bad || id == 0x1FF)
+        {
+            break;
+        }
+        if (id >= D2S_ATTRIBUTES)
+        {
+            return FALSE;
+        }
+        pChar->attributes[id] = LegacyRead(&bits, s_bits[id]);
+    }
+    bits.pos = ((bits.pos + 7) & ~7u) + (2 + D2S_SKILLS) * 8;
+    if (!LegacyParseList(&bits, pChar))
+    {
+        return FALSE;
+    }
+    LegacyRead(&bits, 16);
+    if (LegacyRead(&bits, 16))
+    {
+        bits.pos += D2S_CORPSE_DATA * 8;
+        if (!LegacyParseList(&bits, pChar))
+        {
+            return FALSE;
+        }
+    }
+    if (pData[36] & D2S_STATUS_EXPANSION)
+    {
+        LegacyRead(&bits, 16);
+        if (LegacyDword(pData + 179) && !LegacyParseList(&bits, pChar))
+        {
+            return FALSE;
+        }
+        LegacyRead(&bits, 16);
+        if (LegacyRead(&bits, 8))
+        {
+            LegacyAppend(pChar, LegacyParseItem(&bits));
+        }
+    }
+    return !bits.bad;
+}
+
+// =============================================================================
+// VERIFICATION
+// =============================================================================
+
+static BOOL SameItem(const D2Item *pA, const D2Item *pB)
+{
+    return memcmp(pA, pB, offsetof(D2Item, stats)) == 0 &&
+           memcmp(pA->stats, pB->stats, pA->statCount * sizeof(ItemStat)) == 0;
+}
+
+static BOOL SameList(const D2ItemList *pA, const D2ItemList *pB)
+{
+    if (pA->count != pB->count)
+    {
+        return FALSE;
+    }
+    for (DWORD i = 0; i < pA->count; i++)
+    {
+        if (!SameItem(&pA->pItems[i], &pB->pItems[i]))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static BOOL SameCharacter(const D2Character *pA, const D2Character *pB)
+{
+    BOOL same = memcmp(pA->header + 16, pB->header + 16, D2S_HEADER_SIZE - 16) == 0 &&
+                pA->attributeMask == pB->attributeMask &&
+                memcmp(pA->skills, pB->skills, D2S_SKILLS) == 0 && SameList(&pA->items, &pB->items) &&
+                pA->hasCorpse == pB->hasCorpse && SameList(&pA->corpseItems, &pB->corpseItems) &&
+                SameList(&pA->mercItems, &pB->mercItems) && pA->hasGolem == pB->hasGolem &&
+                (!pA->hasGolem || SameItem(&pA->golem, &pB->golem));
+    for (DWORD id = 0; id < D2S_ATTRIBUTES; id++)
+    {
+        same &= !(pA->attributeMask & (1u << id)) || pA->attributes[id] == pB->attributes[id];
+    }
+    return same;
+}
+
+static BOOL MatchesLegacy(const D2Character *pChr, const LegacyCharacter *pLegacy)
+{
+    const LegacyItem *pItem = pLegacy->pFirst;
+    const D2ItemList *pLists[3] = {&pChr->items, &pChr->corpseItems, &pChr->mercItems};
+    DWORD total = pChr->hasGolem;
+    for (DWORD l = 0; l < 3; l++)
+    {
+        total += pLists[l]->count;
+        for (DWORD i = 0; i < pLists[l]->count; i++, pItem = pItem->pNext)
+        {
+            const D2Item *pCodec = &pLists[l]->pItems[i];
+            if (!pItem || memcmp(pCodec, &pItem->body, offsetof(D2Item, stats)) != 0)
+            {
+                return FALSE;
+            }
+            const LegacyStat *pStat = pItem->pStats;
+            for (DWORD s = 0; s < pCodec->statCount; s++, pStat = pStat->pNext)
+            {
+                const ItemStat *pOut = &pCodec->stats[s];
+                if (!pStat || pStat->id != pOut->id || pStat->list != pOut->list || pStat->param != pOut->param ||
+                    pStat->value != pOut->value)
+                {
+                    return FALSE;
+                }
+            }
+        }
+    }
+    if (pChr->hasGolem && (!pItem || memcmp(&pChr->golem, &pItem->body, offsetof(D2Item, stats)) != 0))
+    {
+        return FALSE;
+    }
+    return total == pLegacy->itemCount;
+}
+
+typedef struct FuzzResult
+{
+    DWORD accepted;
+    DWORD rejected;
+    DWORD disagreements; // Validate vs Decode
+    DWORD unstable;      // Re-encode / re-decode differs
+    DWORD legacyMismatches;
+} FuzzResult;
+
+static void FuzzOne(const ItemCodec *pCodec, std::vector<BYTE> &file, Character *pScratch, Character *pScratch2,
+                    std::vector<BYTE> &out, std::vector<BYTE> &out2, FuzzResult *pResult)
+{
+    DWORD size = (DWORD)file.size();
+    DWORD body = size - D2S_HEADER_SIZE;
+    switch (Roll(5))
+    {
+    case 0:
+    case 1:
+        for (DWORD n = 1 + Roll(4); n; n--)
+        {
+            DWORD bit = D2S_HEADER_SIZE * 8 + Roll(body * 8);
+            file[bit >> 3] ^= (BYTE)(1u << (bit & 7));
+        }
+        break;
+    case 2:
+        file[D2S_HEADER_SIZE + Roll(body)] = (BYTE)NextRandom();
+        break;
+    case 3:
+        file.resize(D2S_HEADER_SIZE + Roll(body));
+        break;
+    default:
+        file.insert(file.begin() + D2S_HEADER_SIZE + Roll(body), 1 + Roll(8), (BYTE)NextRandom());
+        break;
+    }
+    if (Roll(20) == 0)
+    {
+        // Now and then the header fields the walk depends on
+        BYTE *pField = &file[Roll(2) ? 36 : 179 + Roll(4)];
+        *pField ^= (BYTE)(1u << Roll(8));
+    }
+    size = (DWORD)file.size();
+    memcpy(&file[8], &size, 4);
+    DWORD sum = D2S_Checksum(&file[0], size);
+    memcpy(&file[12], &sum, 4);
+
+    DWORD validated = 0;
+    BOOL valid = D2S_Validate(pCodec, &file[0], size, &validated);
+    BOOL decoded = D2S_Decode(pCodec, &file[0], size, &pScratch->chr);
+    if (valid && !decoded && validated > MAX_ITEMS)
+    {
+        // Well-formed, but more items than the scratch lists hold
+        pResult->rejected++;
+        return;
+    }
+    if (valid != decoded)
+    {
+        pResult->disagreements++;
+        return;
+    }
+    if (!decoded)
+    {
+        pResult->rejected++;
+        return;
+    }
+    pResult->accepted++;
+    D2Character *pChr = &pScratch->chr;
+    pResult->disagreements += validated != pChr->items.count + pChr->corpseItems.count + pChr->mercItems.count +
+                                              pChr->hasGolem;
+
+    LegacyCharacter legacy;
+    pResult->legacyMismatches += !LegacyLoad(&file[0], size, &legacy) || !MatchesLegacy(pChr, &legacy);
+    LegacyFree(&legacy);
+
+    size_t bytes = 0, bytes2 = 0;
+    if (!D2S_Encode(pCodec, pChr, &out[0], out.size(), &bytes) ||
+        !D2S_Decode(pCodec, &out[0], bytes, &pScratch2->chr) || !SameCharacter(pChr, &pScratch2->chr) ||
+        !D2S_Encode(pCodec, &pScratch2->chr, &out2[0], out2.size(), &bytes2) || bytes != bytes2 ||
+        memcmp(&out[0], &out2[0], bytes) != 0)
+    {
+        pResult->unstable++;
+    }
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+static double Seconds(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char **argv)
+{
+    DWORD characters = (argc > 1) ? (DWORD)atoi(argv[1]) : 200;
+    DWORD passes = (argc > 2) ? (DWORD)atoi(argv[2]) : 5;
+    DWORD fuzzIterations = (argc > 3) ? (DWORD)atoi(argv[3]) : 20000;
+
+    static ItemStatLayout s_layouts[ITEM_STAT_IDS];
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(s_stats); i++)
+    {
+        const BenchStat *pStat = &s_stats[i];
+        s_layouts[pStat->id].saveBits = pStat->saveBits;
+        s_layouts[pStat->id].paramBits = pStat->paramBits;
+        s_layouts[pStat->id].saveAdd = pStat->saveAdd;
+        s_layouts[pStat->id].chained = pStat->chained;
+        s_statIndex[pStat->id] = pStat;
+    }
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(s_codes); i++)
+    {
+        s_codeValues[i] = MakeCode(s_codes[i].szCode);
+    }
+    ItemCodecDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.pStats = s_layouts;
+    desc.pfnItemClass = ItemClass;
+    ItemCodec *pCodec = ITEMCODEC_Create(&desc);
+
+    // Build the characters and check the round trip
+    std::vector<std::vector<BYTE> > files(characters);
+    std::vector<BYTE> out(MAX_FILE), out2(MAX_FILE);
+    Character *pSource = new Character;
+    Character *pDecoded = new Character;
+    Character *pDecoded2 = new Character;
+    BindLists(pDecoded, MAX_ITEMS);
+    BindLists(pDecoded2, MAX_ITEMS);
+    DWORD roundTripErrors = 0, legacyMismatches = 0;
+    uint64_t totalBytes = 0, totalItems = 0;
+    for (DWORD c = 0; c < characters; c++)
+    {
+        MakeCharacter(pSource);
+        size_t bytes = 0, bytes2 = 0;
+        if (!D2S_Encode(pCodec, &pSource->chr, &out[0], out.size(), &bytes))
+        {
+            roundTripErrors++;
+            continue;
+        }
+        files[c].assign(out.begin(), out.begin() + bytes);
+        totalBytes += bytes;
+
+        DWORD count = 0;
+        BOOL ok = D2S_Validate(pCodec, &files[c][0], bytes, &count) &&
+                  D2S_Decode(pCodec, &files[c][0], bytes, &pDecoded->chr) &&
+                  SameCharacter(&pSource->chr, &pDecoded->chr) &&
+                  D2S_Encode(pCodec, &pDecoded->chr, &out2[0], out2.size(), &bytes2) && bytes2 == bytes &&
+                  memcmp(&out2[0], &files[c][0], bytes) == 0;
+        roundTripErrors += !ok;
+        totalItems += count;
+
+        LegacyCharacter legacy;
+        legacyMismatches += !LegacyLoad(&files[c][0], (DWORD)bytes, &legacy) || !MatchesLegacy(&pDecoded->chr, &legacy);
+        LegacyFree(&legacy);
+    }
+
+    // Throughput
+    double legacySeconds = 0, validateSeconds = 0, decodeSeconds = 0, encodeSeconds = 0;
+    DWORD loadErrors = 0;
+    for (DWORD pass = 0; pass < passes; pass++)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for (DWORD c = 0; c < characters; c++)
+        {
+            LegacyCharacter legacy;
+            loadErrors += !LegacyLoad(&files[c][0], (DWORD)files[c].size(), &legacy);
+            LegacyFree(&legacy);
+        }
+        legacySeconds += Seconds(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        for (DWORD c = 0; c < characters; c++)
+        {
+            loadErrors += !D2S_Validate(pCodec, &files[c][0], files[c].size(), NULL);
+        }
+        validateSeconds += Seconds(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        for (DWORD c = 0; c < characters; c++)
+        {
+            loadErrors += !D2S_Decode(pCodec, &files[c][0], files[c].size(), &pDecoded->chr);
+        }
+        decodeSeconds += Seconds(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        for (DWORD c = 0; c < characters; c++)
+        {
+            loadErrors += !D2S_Decode(pCodec, &files[c][0], files[c].size(), &pDecoded->chr);
+            size_t bytes = 0;
+            std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+            loadErrors += !D2S_Encode(pCodec, &pDecoded->chr, &out[0], out.size(), &bytes);
+            encodeSeconds += Seconds(t1);
+        }
+    }
+
+    // Fuzz
+    FuzzResult fuzz;
+    memset(&fuzz, 0, sizeof(fuzz));
+    std::vector<BYTE> mutated;
+    for (DWORD i = 0; i < fuzzIterations && characters; i++)
+    {
+        mutated = files[Roll(characters)];
+        FuzzOne(pCodec, mutated, pDecoded, pDecoded2, out, out2, &fuzz);
+    }
+
+    double mb = (double)totalBytes * passes / (1024.0 * 1024.0);
+    double items = (double)totalItems * passes;
+    double loads = (double)characters * passes;
+    printf("characters: %u, %.1f KB and %.0f items each\n", characters, totalBytes / 1024.0 / characters,
+           (double)totalItems / characters);
+    printf("  legacy:   %7.1f MB/s %6.2f M items/s %8.1f us/char\n", mb / legacySeconds, items / legacySeconds / 1e6,
+           legacySeconds * 1e6 / loads);
+    printf("  validate: %7.1f MB/s %6.2f M items/s %8.1f us/char (%.1fx)\n", mb / validateSeconds,
+           items / validateSeconds / 1e6, validateSeconds * 1e6 / loads, legacySeconds / validateSeconds);
+    printf("  decode:   %7.1f MB/s %6.2f M items/s %8.1f us/char (%.1fx)\n", mb / decodeSeconds,
+           items / decodeSeconds / 1e6, decodeSeconds * 1e6 / loads, legacySeconds / decodeSeconds);
+    printf("  encode:   %7.1f MB/s %6.2f M items/s %8.1f us/char\n", mb / encodeSeconds, items / encodeSeconds / 1e6,
+           encodeSeconds * 1e6 / loads);
+    printf("verify:  round trip %u errors, legacy %u mismatches, load %u errors -> %s\n", roundTripErrors,
+           legacyMismatches, loadErrors, (roundTripErrors || legacyMismatches || loadErrors) ? "FAILED" : "ok");
+    printf("fuzz:    %u inputs, %u accepted, %u rejected; %u validate/decode disagreements, %u unstable, "
+           "%u legacy mismatches -> %s\n",
+           fuzzIterations, fuzz.accepted, fuzz.rejected, fuzz.disagreements, fuzz.unstable, fuzz.legacyMismatches,
+           (fuzz.disagreements || fuzz.unstable || fuzz.legacyMismatches) ? "FAILED" : "ok");
+    BOOL ok = !roundTripErrors && !legacyMismatches && !loadErrors && !fuzz.disagreements && !fuzz.unstable &&
+              !fuzz.legacyMismatches;
+
+    delete pSource;
+    delete pDecoded;
+    delete pDecoded2;
+    ITEMCODEC_Destroy(pCodec);
+    return ok ? 0 : 1;
+}
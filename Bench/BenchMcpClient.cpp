@@ -0,0 +1,970 @@
+/*
+ * BenchMcpClient.cpp - Serialized realm round trips vs the pipelined McpClient
+ *
+ * A stand-in realm server runs on its own thread and event loop on
+ * loopback. It holds every reply for a configurable round-trip time (plus
+ * a little per-command processing time, so pipelined replies come back out
+ * of order) and serves a 300-game list, well past D2MCPClient's 1024-byte
+ * buffer.
+ *
+ * Character select needs: logon, character list, character logon, game
+ * list, the details of every game shown, and the join.
+ *   serialized: D2MCPClient's pattern; each request waits for the previous
+ *               reply, so the screen costs one round trip per request.
+ *   pipelined:  the first four requests go out together on connect; the
+ *               details and the join go out together when the list arrives.
+ *
+ * Verification:
+ *   - every reply reaches the request that asked for it (game details and
+ *     join tokens are checked against the game ids), including replies
+ *     that overtook older requests and replies dribbled a few dozen bytes
+ *     at a time;
+ *   - a request the realm never answers times out without disturbing the
+ *     others; a cancelled request completes once and its late reply is
+ *     dropped; a dropped connection fails everything in flight; pushes
+ *     arrive;
+ *   - every request gets exactly one callback.
+ *
+ * Usage: bench_mcpclient [rttMs] [gamesShown] [iterations]
+ */
+
+#include "../Net/McpClient.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define REALM_GAMES 300
+#define CHARS_PER_ACCOUNT 8
+#define MAX_SHOWN 64
+#define GAME_ID_BASE 1000
+#define JOIN_PORT 4000
+
+static DWORD JoinToken(DWORD gameId)
+{
+    return gameId * 31 + 7;
+}
+
+// =============================================================================
+// STAND-IN REALM
+// =============================================================================
+
+typedef struct StandInGame
+{
+    DWORD id;
+    char szName[REALM_MAX_GAME_NAME];
+    char szDescription[32];
+    char szPassword[16];
+    BYTE players;
+    BYTE difficulty;
+} StandInGame;
+
+typedef struct StandInConn
+{
+    NetSocket s;
+    DWORD loopId;
+    DWORD interest;
+    NetBuffer in;
+    NetBuffer out;
+    BOOL loggedOn;
+    BOOL charSelected;
+    BOOL open;
+    DWORD generation; // Replies queued for an earlier connection in this slot are dropped
+} StandInConn;
+
+typedef struct DelayedFrame
+{
+    uint64_t dueMs;
+    DWORD conn;
+    DWORD generation;
+    std::vector<BYTE> frame;
+} DelayedFrame;
+
+struct StandIn;
+
+typedef struct ConnEvent
+{
+    StandIn *pServer;
+    DWORD conn;
+} ConnEvent;
+
+struct StandIn
+{
+    EventLoop *pLoop;
+    NetSocket listener;
+    WORD port;
+    std::atomic<DWORD> rttMs;
+    std::atomic<DWORD> chunkBytes; // 0 = send everything at once
+    std::vector<StandInConn> conns;
+    std::vector<ConnEvent> connEvents;
+    std::vector<DelayedFrame> delayed;
+    std::vector<StandInGame> games;
+    NetBuffer scratch;
+    std::atomic<bool> stop;
+    std::thread thread;
+};
+
+static DWORD ProcessingMs(BYTE command)
+{
+    switch (command)
+    {
+    case REALM_CMD_GAMELIST:
+        return 4;
+    case REALM_CMD_CHARLIST:
+        return 3;
+    case REALM_CMD_GAMEINFO:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void CloseConn(StandIn *pServer, DWORD index)
+{
+    StandInConn *pConn = &pServer->conns[index];
+    if (!pConn->open)
+    {
+        return;
+    }
+    EVLOOP_Remove(pServer->pLoop, pConn->loopId);
+    NET_Close(pConn->s);
+    NETBUF_Free(&pConn->in);
+    NETBUF_Free(&pConn->out);
+    pConn->open = FALSE;
+}
+
+static void FlushConn(StandIn *pServer, DWORD index)
+{
+    StandInConn *pConn = &pServer->conns[index];
+    DWORD chunk = pServer->chunkBytes.load();
+    while (pConn->open && NETBUF_Size(&pConn->out))
+    {
+        DWORD size = NETBUF_Size(&pConn->out);
+        if (chunk && size > chunk)
+        {
+            size = chunk;
+        }
+        int sent = NET_Send(pConn->s, NETBUF_Data(&pConn->out), size);
+        if (sent < 0)
+        {
+            CloseConn(pServer, index);
+            return;
+        }
+        if (sent == 0)
+        {
+            break;
+        }
+        NETBUF_Consume(&pConn->out, (DWORD)sent);
+        if (chunk)
+        {
+            break; // One dribble per server loop run, about a millisecond apart
+        }
+    }
+    DWORD interest = (NETBUF_Size(&pConn->out) && !chunk) ? (NET_READ | NET_WRITE) : NET_READ;
+    if (pConn->open && interest != pConn->interest)
+    {
+        EVLOOP_SetInterest(pServer->pLoop, pConn->loopId, interest);
+        pConn->interest = interest;
+    }
+}
+
+// Moves the frame just written to scratch onto the delay queue
+static void QueueScratch(StandIn *pServer, DWORD conn, BYTE command)
+{
+    DelayedFrame delayed;
+    delayed.dueMs = EVLOOP_NowMs() + pServer->rttMs.load() + ProcessingMs(command);
+    delayed.conn = conn;
+    delayed.generation = pServer->conns[conn].generation;
+    const BYTE *pFrame = NETBUF_Data(&pServer->scratch);
+    delayed.frame.assign(pFrame, pFrame + NETBUF_Size(&pServer->scratch));
+    NETBUF_Consume(&pServer->scratch, NETBUF_Size(&pServer->scratch));
+    pServer->delayed.push_back(delayed);
+}
+
+static StandInGame *FindGame(StandIn *pServer, const char *szName, DWORD id)
+{
+    for (size_t i = 0; i < pServer->games.size(); i++)
+    {
+        StandInGame *pGame = &pServer->games[i];
+        if ((szName && strcmp(pGame->szName, szName) == 0) || (!szName && pGame->id == id))
+        {
+            return pGame;
+        }
+    }
+    return NULL;
+}
+
+static void FillGameEntry(const StandInGame *pGame, RealmGameEntry *pEntry)
+{
+    pEntry->gameId = pGame->id;
+    pEntry->players = pGame->players;
+    pEntry->maxPlayers = REALM_MAX_GAME_PLAYERS;
+    pEntry->difficulty = pGame->difficulty;
+    pEntry->flags = pGame->szPassword[0] ? 1 : 0;
+    pEntry->szName = pGame->szName;
+    pEntry->szDescription = pGame->szDescription;
+}
+
+static void HandleRequest(StandIn *pServer, DWORD index, const RealmFrame *pFrame)
+{
+    StandInConn *pConn = &pServer->conns[index];
+    RealmReader reader;
+    REALM_InitReader(&reader, pFrame->pPayload, pFrame->payloadSize);
+    RealmWriter writer;
+    BYTE reply = REALM_REPLY(pFrame->command);
+    char szName[32];
+
+    switch (pFrame->command)
+    {
+    case REALM_CMD_LOGON:
+        REALM_GetDword(&reader);
+        pConn->loggedOn = REALM_GetString(&reader)[0] != 0;
+        REALM_BeginFrame(&writer, &pServer->scratch, reply, pConn->loggedOn ? REALM_OK : REALM_ERR_FAILED,
+                         pFrame->sequence);
+        break;
+
+    case REALM_CMD_CHARLIST:
+    {
+        DWORD count = std::min((DWORD)REALM_GetWord(&reader), (DWORD)CHARS_PER_ACCOUNT);
+        REALM_BeginFrame(&writer, &pServer->scratch, reply, pConn->loggedOn ? REALM_OK : REALM_ERR_NOT_LOGGED_ON,
+                         pFrame->sequence);
+        REALM_PutWord(&writer, (WORD)(pConn->loggedOn ? count : 0));
+        for (DWORD i = 0; pConn->loggedOn && i < count; i++)
+        {
+            sprintf(szName, "Char%u", i);
+            RealmCharEntry entry = {szName, (BYTE)(i % 7), (BYTE)(10 + i), REALM_CHAR_EXPANSION};
+            REALM_PutCharEntry(&writer, &entry);
+        }
+        break;
+    }
+
+    case REALM_CMD_CHARLOGON:
+    {
+        const char *szChar = REALM_GetString(&reader);
+        pConn->charSelected = pConn->loggedOn && strncmp(szChar, "Char", 4) == 0;
+        REALM_BeginFrame(&writer, &pServer->scratch, reply, pConn->charSelected ? REALM_OK : REALM_ERR_NOT_FOUND,
+                         pFrame->sequence);
+        break;
+    }
+
+    case REALM_CMD_GAMELIST:
+    {
+        const char *szFilter = REALM_GetString(&reader);
+        REALM_BeginFrame(&writer, &pServer->scratch, reply,
+                         pConn->charSelected ? REALM_OK : REALM_ERR_NOT_LOGGED_ON, pFrame->sequence);
+        WORD count = 0;
+        for (size_t i = 0; pConn->charSelected && i < pServer->games.size(); i++)
+        {
+            count += strstr(pServer->games[i].szName, szFilter) != NULL;
+        }
+        REALM_PutWord(&writer, count);
+        for (size_t i = 0; pConn->charSelected && i < pServer->games.size(); i++)
+        {
+            if (strstr(pServer->games[i].szName, szFilter))
+            {
+                RealmGameEntry entry;
+                FillGameEntry(&pServer->games[i], &entry);
+                REALM_PutGameEntry(&writer, &entry);
+            }
+        }
+        break;
+    }
+
+    case REALM_CMD_GAMEINFO:
+    {
+        StandInGame *pGame = FindGame(pServer, NULL, REALM_GetDword(&reader));
+        REALM_BeginFrame(&writer, &pServer->scratch, reply, pGame ? REALM_OK : REALM_ERR_NOT_FOUND, pFrame->sequence);
+        if (pGame)
+        {
+            RealmGameInfo info;
+            memset(&info, 0, sizeof(info));
+            info.gameId = pGame->id;
+            info.uptimeSeconds = 60 * pGame->id;
+            info.difficulty = pGame->difficulty;
+            info.playerCount = pGame->players;
+            char szPlayers[REALM_MAX_GAME_PLAYERS][16];
+            for (BYTE p = 0; p < info.playerCount; p++)
+            {
+                sprintf(szPlayers[p], "P%u_%u", pGame->id, p);
+                info.players[p].szName = szPlayers[p];
+                info.players[p].charClass = p;
+                info.players[p].level = (BYTE)(pGame->id % 99);
+            }
+            REALM_PutGameInfo(&writer, &info);
+        }
+        break;
+    }
+
+    case REALM_CMD_CREATEGAME:
+    {
+        BYTE difficulty = REALM_GetByte(&reader);
+        REALM_GetByte(&reader);
+        StandInGame game;
+        memset(&game, 0, sizeof(game));
+        strncpy(game.szName, REALM_GetString(&reader), sizeof(game.szName) - 1);
+        strncpy(game.szPassword, REALM_GetString(&reader), sizeof(game.szPassword) - 1);
+        BOOL exists = FindGame(pServer, game.szName, 0) != NULL;
+        REALM_BeginFrame(&writer, &pServer->scratch, reply, exists ? REALM_ERR_EXISTS : REALM_OK, pFrame->sequence);
+        if (!exists)
+        {
+            game.id = GAME_ID_BASE + (DWORD)pServer->games.size();
+            game.difficulty = difficulty;
+            game.players = 1;
+            strcpy(game.szDescription, "new");
+            pServer->games.push_back(game);
+            REALM_PutDword(&writer, game.id);
+        }
+        REALM_EndFrame(&writer);
+        QueueScratch(pServer, index, pFrame->command);
+        if (!exists)
+        {
+            // Tell everyone browsing games
+            for (DWORD c = 0; c < pServer->conns.size(); c++)
+            {
+                if (pServer->conns[c].open && pServer->conns[c].charSelected)
+                {
+                    RealmGameEntry entry;
+                    FillGameEntry(&pServer->games.back(), &entry);
+                    REALM_BeginFrame(&writer, &pServer->scratch, REALM_CMD_GAMEUPDATE, REALM_OK, 0);
+                    REALM_PutGameEntry(&writer, &entry);
+                    REALM_PutByte(&writer, 0);
+                    REALM_EndFrame(&writer);
+                    QueueScratch(pServer, c, REALM_CMD_GAMEUPDATE);
+                }
+            }
+        }
+        return;
+    }
+
+    case REALM_CMD_JOINGAME:
+    {
+        const char *szGame = REALM_GetString(&reader);
+        const char *szPassword = REALM_GetString(&reader);
+        if (strcmp(szGame, "blackhole") == 0)
+        {
+            return; // Never answered
+        }
+        if (strcmp(szGame, "hangup") == 0)
+        {
+            CloseConn(pServer, index);
+            return;
+        }
+        StandInGame *pGame = FindGame(pServer, szGame, 0);
+        BYTE status = !pGame ? REALM_ERR_NOT_FOUND
+                             : (strcmp(pGame->szPassword, szPassword) != 0 ? REALM_ERR_PASSWORD : REALM_OK);
+        REALM_BeginFrame(&writer, &pServer->scratch, reply, status, pFrame->sequence);
+        if (status == REALM_OK)
+        {
+            RealmJoinInfo info;
+            info.gameToken = JoinToken(pGame->id);
+            info.address = 0x0100007F; // 127.0.0.1
+            info.port = JOIN_PORT;
+            info.gameHash = pGame->id ^ 0xABCD;
+            REALM_PutJoinInfo(&writer, &info);
+        }
+        break;
+    }
+
+    default:
+        REALM_BeginFrame(&writer, &pServer->scratch, reply, REALM_ERR_BAD_REQUEST, pFrame->sequence);
+        break;
+    }
+    REALM_EndFrame(&writer);
+    QueueScratch(pServer, index, pFrame->command);
+}
+
+static void __cdecl OnConnEvent(void *pContext, DWORD events)
+{
+    ConnEvent *pEvent = (ConnEvent *)pContext;
+    StandIn *pServer = pEvent->pServer;
+    DWORD index = pEvent->conn;
+    StandInConn *pConn = &pServer->conns[index];
+
+    if (events & NET_WRITE)
+    {
+        FlushConn(pServer, index);
+    }
+    if (!pConn->open || !(events & (NET_READ | NET_HANGUP)))
+    {
+        return;
+    }
+    for (;;)
+    {
+        DWORD space;
+        BYTE *pSpace = NETBUF_Reserve(&pConn->in, 4096, &space);
+        int received = pSpace ? NET_Recv(pConn->s, pSpace, space) : -1;
+        if (received < 0)
+        {
+            CloseConn(pServer, index);
+            return;
+        }
+        if (received == 0)
+        {
+            break;
+        }
+        NETBUF_Commit(&pConn->in, (DWORD)received);
+    }
+    for (;;)
+    {
+        RealmFrame frame;
+        int size = REALM_ParseFrame(NETBUF_Data(&pConn->in), NETBUF_Size(&pConn->in), &frame);
+        if (size < 0)
+        {
+            CloseConn(pServer, index);
+            return;
+        }
+        if (size == 0)
+        {
+            break;
+        }
+        HandleRequest(pServer, index, &frame);
+        if (!pConn->open)
+        {
+            return;
+        }
+        NETBUF_Consume(&pConn->in, (DWORD)size);
+    }
+}
+
+static void __cdecl OnAccept(void *pContext, DWORD events)
+{
+    (void)events;
+    StandIn *pServer = (StandIn *)pContext;
+    for (;;)
+    {
+        NetSocket s = NET_Accept(pServer->listener, NULL);
+        if (s == NET_INVALID_SOCKET)
+        {
+            return;
+        }
+        DWORD index = 0;
+        while (index < pServer->conns.size() && pServer->conns[index].open)
+        {
+            index++;
+        }
+        if (index == pServer->conns.size())
+        {
+            NET_Close(s);
+            continue;
+        }
+        StandInConn *pConn = &pServer->conns[index];
+        DWORD generation = pConn->generation + 1;
+        memset(pConn, 0, sizeof(*pConn));
+        pConn->generation = generation;
+        pConn->s = s;
+        pConn->interest = NET_READ;
+        NETBUF_Init(&pConn->in, 4096, REALM_MAX_FRAME * 4);
+        NETBUF_Init(&pConn->out, 4096, 64 * 1024 * 1024);
+        pConn->loopId = EVLOOP_Add(pServer->pLoop, s, NET_READ, OnConnEvent, &pServer->connEvents[index]);
+        pConn->open = TRUE;
+    }
+}
+
+static void ServerThread(StandIn *pServer)
+{
+    while (!pServer->stop.load())
+    {
+        EVLOOP_Run(pServer->pLoop, 1);
+        uint64_t nowMs = EVLOOP_NowMs();
+        size_t kept = 0;
+        for (size_t i = 0; i < pServer->delayed.size(); i++)
+        {
+            DelayedFrame *pDelayed = &pServer->delayed[i];
+            if (pDelayed->dueMs > nowMs)
+            {
+                std::swap(pServer->delayed[kept++], *pDelayed);
+                continue;
+            }
+            StandInConn *pConn = &pServer->conns[pDelayed->conn];
+            if (pConn->open && pConn->generation == pDelayed->generation)
+            {
+                NETBUF_Append(&pConn->out, &pDelayed->frame[0], (DWORD)pDelayed->frame.size());
+                FlushConn(pServer, pDelayed->conn);
+            }
+        }
+        pServer->delayed.resize(kept);
+        if (pServer->chunkBytes.load())
+        {
+            for (DWORD c = 0; c < pServer->conns.size(); c++)
+            {
+                if (pServer->conns[c].open && NETBUF_Size(&pServer->conns[c].out))
+                {
+                    FlushConn(pServer, c);
+                }
+            }
+        }
+    }
+}
+
+static StandIn *StartStandIn(DWORD maxConns)
+{
+    StandIn *pServer = new StandIn;
+    pServer->pLoop = EVLOOP_Create(maxConns + 1);
+    pServer->listener = NET_Listen("127.0.0.1", 0, 64, &pServer->port);
+    pServer->rttMs = 0;
+    pServer->chunkBytes = 0;
+    pServer->conns.resize(maxConns);
+    pServer->connEvents.resize(maxConns);
+    for (DWORD i = 0; i < maxConns; i++)
+    {
+        pServer->conns[i].open = FALSE;
+        pServer->conns[i].generation = 0;
+        pServer->connEvents[i].pServer = pServer;
+        pServer->connEvents[i].conn = i;
+    }
+    for (DWORD g = 0; g < REALM_GAMES; g++)
+    {
+        StandInGame game;
+        memset(&game, 0, sizeof(game));
+        game.id = GAME_ID_BASE + g;
+        sprintf(game.szName, "baal-run-%u", g);
+        sprintf(game.szDescription, "lvl %u+ no noobs", 60 + g % 30);
+        game.players = (BYTE)(1 + g % REALM_MAX_GAME_PLAYERS);
+        game.difficulty = (BYTE)(g % 3);
+        pServer->games.push_back(game);
+    }
+    NETBUF_Init(&pServer->scratch, 4096, REALM_MAX_FRAME);
+    pServer->stop = false;
+    EVLOOP_Add(pServer->pLoop, pServer->listener, NET_READ, OnAccept, pServer);
+    pServer->thread = std::thread(ServerThread, pServer);
+    return pServer;
+}
+
+static void StopStandIn(StandIn *pServer)
+{
+    pServer->stop = true;
+    pServer->thread.join();
+    for (DWORD i = 0; i < pServer->conns.size(); i++)
+    {
+        CloseConn(pServer, i);
+    }
+    NET_Close(pServer->listener);
+    NETBUF_Free(&pServer->scratch);
+    EVLOOP_Destroy(pServer->pLoop);
+    delete pServer;
+}
+
+// =============================================================================
+// CHARACTER SELECT
+// =============================================================================
+
+struct Screen;
+
+typedef struct InfoTag
+{
+    Screen *pScreen;
+    DWORD gameId;
+} InfoTag;
+
+struct Screen
+{
+    McpClient *pClient;
+    BOOL pipelined;
+    DWORD shown; // Games whose details the screen shows
+    DWORD completed;
+    DWORD errors;
+    DWORD chars;
+    DWORD listed;
+    DWORD infos;
+    BOOL joined;
+    char szJoin[REALM_MAX_GAME_NAME];
+    DWORD joinId;
+    InfoTag tags[MAX_SHOWN];
+};
+
+static void __cdecl OnJoin(void *pContext, const McpReply *pReply)
+{
+    Screen *pScreen = (Screen *)pContext;
+    RealmReader reader;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    RealmJoinInfo info;
+    if (pReply->status != REALM_OK || !REALM_GetJoinInfo(&reader, &info) ||
+        info.gameToken != JoinToken(pScreen->joinId) || info.port != JOIN_PORT)
+    {
+        pScreen->errors++;
+    }
+    pScreen->joined = TRUE;
+    pScreen->completed++;
+}
+
+static void __cdecl OnGameInfo(void *pContext, const McpReply *pReply)
+{
+    InfoTag *pTag = (InfoTag *)pContext;
+    RealmReader reader;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    RealmGameInfo info;
+    if (pReply->status != REALM_OK || !REALM_GetGameInfo(&reader, &info) || info.gameId != pTag->gameId ||
+        info.playerCount != 1 + (pTag->gameId - GAME_ID_BASE) % REALM_MAX_GAME_PLAYERS)
+    {
+        pTag->pScreen->errors++;
+    }
+    pTag->pScreen->infos++;
+    pTag->pScreen->completed++;
+}
+
+static void RequestDetails(Screen *pScreen)
+{
+    for (DWORD i = 0; i < pScreen->listed; i++)
+    {
+        pScreen->errors += MCP_RequestGameInfo(pScreen->pClient, pScreen->tags[i].gameId, OnGameInfo,
+                                               &pScreen->tags[i]) == MCP_INVALID_REQUEST;
+    }
+    pScreen->errors += MCP_JoinGame(pScreen->pClient, pScreen->szJoin, "", OnJoin, pScreen) == MCP_INVALID_REQUEST;
+}
+
+static void __cdecl OnGameList(void *pContext, const McpReply *pReply)
+{
+    Screen *pScreen = (Screen *)pContext;
+    RealmReader reader;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    DWORD count = REALM_GetWord(&reader);
+    if (pReply->status != REALM_OK || count != REALM_GAMES)
+    {
+        pScreen->errors++;
+    }
+    for (DWORD i = 0; i < count; i++)
+    {
+        RealmGameEntry entry;
+        if (!REALM_GetGameEntry(&reader, &entry) || entry.gameId != GAME_ID_BASE + i)
+        {
+            pScreen->errors++;
+            break;
+        }
+        if (i < pScreen->shown)
+        {
+            pScreen->tags[i].pScreen = pScreen;
+            pScreen->tags[i].gameId = entry.gameId;
+            pScreen->listed = i + 1;
+        }
+        // The player picks a game in the middle of the list
+        if (i == pScreen->shown / 2)
+        {
+            strncpy(pScreen->szJoin, entry.szName, sizeof(pScreen->szJoin) - 1);
+            pScreen->joinId = entry.gameId;
+        }
+    }
+    pScreen->completed++;
+    if (pScreen->pipelined)
+    {
+        RequestDetails(pScreen);
+    }
+}
+
+static void __cdecl OnStatus(void *pContext, const McpReply *pReply)
+{
+    Screen *pScreen = (Screen *)pContext;
+    pScreen->errors += pReply->status != REALM_OK;
+    pScreen->completed++;
+}
+
+static void __cdecl OnCharList(void *pContext, const McpReply *pReply)
+{
+    Screen *pScreen = (Screen *)pContext;
+    RealmReader reader;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    pScreen->chars = REALM_GetWord(&reader);
+    for (DWORD i = 0; i < pScreen->chars; i++)
+    {
+        RealmCharEntry entry;
+        char szExpected[16];
+        sprintf(szExpected, "Char%u", i);
+        if (!REALM_GetCharEntry(&reader, &entry) || strcmp(entry.szName, szExpected) != 0)
+        {
+            pScreen->errors++;
+        }
+    }
+    pScreen->errors += pReply->status != REALM_OK || pScreen->chars != CHARS_PER_ACCOUNT;
+    pScreen->completed++;
+}
+
+static BOOL PumpUntil(McpClient *pClient, const DWORD *pCounter, DWORD target, DWORD timeoutMs)
+{
+    uint64_t endMs = EVLOOP_NowMs() + timeoutMs;
+    while (*pCounter < target)
+    {
+        if (EVLOOP_NowMs() > endMs)
+        {
+            return FALSE;
+        }
+        MCP_Pump(pClient, 5);
+    }
+    return TRUE;
+}
+
+// Milliseconds from entering character select to the join reply
+static double FillScreen(WORD port, BOOL pipelined, DWORD shown, McpStats *pStats, DWORD *pErrors)
+{
+    McpClientDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szHost = "127.0.0.1";
+    desc.port = port;
+    desc.timeoutMs = 5000;
+
+    static Screen screen;
+    memset(&screen, 0, sizeof(screen));
+    screen.pipelined = pipelined;
+    screen.shown = shown;
+
+    auto start = std::chrono::steady_clock::now();
+    McpClient *pClient = MCP_Create(&desc);
+    screen.pClient = pClient;
+    MCP_Connect(pClient);
+    if (pipelined)
+    {
+        MCP_Logon(pClient, 0x1234, "account", OnStatus, &screen);
+        MCP_RequestCharList(pClient, CHARS_PER_ACCOUNT, OnCharList, &screen);
+        MCP_CharLogon(pClient, "Char0", OnStatus, &screen);
+        MCP_RequestGameList(pClient, "", OnGameList, &screen);
+        PumpUntil(pClient, &screen.completed, 5 + shown, 10000);
+    }
+    else
+    {
+        DWORD step = 0;
+        MCP_Logon(pClient, 0x1234, "account", OnStatus, &screen);
+        PumpUntil(pClient, &screen.completed, ++step, 10000);
+        MCP_RequestCharList(pClient, CHARS_PER_ACCOUNT, OnCharList, &screen);
+        PumpUntil(pClient, &screen.completed, ++step, 10000);
+        MCP_CharLogon(pClient, "Char0", OnStatus, &screen);
+        PumpUntil(pClient, &screen.completed, ++step, 10000);
+        MCP_RequestGameList(pClient, "", OnGameList, &screen);
+        PumpUntil(pClient, &screen.completed, ++step, 10000);
+        for (DWORD i = 0; i < screen.listed; i++)
+        {
+            MCP_RequestGameInfo(pClient, screen.tags[i].gameId, OnGameInfo, &screen.tags[i]);
+            PumpUntil(pClient, &screen.completed, ++step, 10000);
+        }
+        MCP_JoinGame(pClient, screen.szJoin, "", OnJoin, &screen);
+        PumpUntil(pClient, &screen.completed, ++step, 10000);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    MCP_GetStats(pClient, pStats);
+    *pErrors += screen.errors + (screen.completed != 5 + shown) + (screen.chars != CHARS_PER_ACCOUNT) +
+                (screen.infos != shown) + !screen.joined;
+    MCP_Destroy(pClient);
+    return ms;
+}
+
+// =============================================================================
+// FAILURE PATHS
+// =============================================================================
+
+typedef struct Outcome
+{
+    DWORD calls;
+    BYTE status;
+} Outcome;
+
+static void __cdecl OnOutcome(void *pContext, const McpReply *pReply)
+{
+    Outcome *pOutcome = (Outcome *)pContext;
+    pOutcome->calls++;
+    pOutcome->status = pReply->status;
+}
+
+static void __cdecl OnPush(void *pContext, const McpReply *pReply)
+{
+    DWORD *pPushes = (DWORD *)pContext;
+    RealmReader reader;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    RealmGameEntry entry;
+    if (pReply->command == REALM_CMD_GAMEUPDATE && REALM_GetGameEntry(&reader, &entry) &&
+        strcmp(entry.szName, "fresh-game") == 0)
+    {
+        (*pPushes)++;
+    }
+}
+
+static BOOL CheckFailurePaths(WORD port)
+{
+    McpClientDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szHost = "127.0.0.1";
+    desc.port = port;
+    desc.timeoutMs = 300;
+    McpClient *pClient = MCP_Create(&desc);
+    DWORD pushes = 0;
+    MCP_SetPushHandler(pClient, OnPush, &pushes);
+    MCP_Connect(pClient);
+
+    Outcome logon = {0, 0}, charLogon = {0, 0}, lost = {0, 0}, after = {0, 0}, cancelled = {0, 0}, create = {0, 0};
+    MCP_Logon(pClient, 1, "account", OnOutcome, &logon);
+    MCP_CharLogon(pClient, "Char3", OnOutcome, &charLogon);
+    MCP_JoinGame(pClient, "blackhole", "", OnOutcome, &lost);
+    DWORD cancelId = MCP_RequestGameInfo(pClient, GAME_ID_BASE, OnOutcome, &cancelled);
+    MCP_Cancel(pClient, cancelId);
+    BOOL cancelTwice = MCP_Cancel(pClient, cancelId);
+    MCP_CreateGame(pClient, "fresh-game", "", 0, 8, OnOutcome, &create);
+    PumpUntil(pClient, &lost.calls, 1, 2000);
+    MCP_JoinGame(pClient, "baal-run-7", "", OnOutcome, &after);
+    PumpUntil(pClient, &after.calls, 1, 2000);
+    PumpUntil(pClient, &pushes, 1, 2000);
+    MCP_Pump(pClient, 50); // Room for the cancelled request's late reply
+
+    BOOL timeoutOk = lost.calls == 1 && lost.status == REALM_ERR_TIMEOUT && after.calls == 1 &&
+                     after.status == REALM_OK && logon.status == REALM_OK && charLogon.status == REALM_OK;
+    BOOL cancelOk = cancelled.calls == 1 && cancelled.status == REALM_ERR_CANCELLED && !cancelTwice;
+    BOOL pushOk = pushes == 1 && create.calls == 1 && create.status == REALM_OK;
+
+    // The realm drops the connection with requests in flight
+    Outcome inFlight[4], hangup = {0, 0};
+    memset(inFlight, 0, sizeof(inFlight));
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(inFlight); i++)
+    {
+        MCP_RequestGameList(pClient, "", OnOutcome, &inFlight[i]);
+    }
+    MCP_JoinGame(pClient, "hangup", "", OnOutcome, &hangup);
+    PumpUntil(pClient, &hangup.calls, 1, 2000);
+    BOOL dropOk = hangup.status == REALM_ERR_DISCONNECTED && MCP_GetState(pClient) == MCP_CLOSED;
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(inFlight); i++)
+    {
+        dropOk &= inFlight[i].calls == 1 && inFlight[i].status == REALM_ERR_DISCONNECTED;
+    }
+    dropOk &= MCP_RequestGameList(pClient, "", OnOutcome, &after) == MCP_INVALID_REQUEST;
+
+    // Reconnect and carry on
+    Outcome again = {0, 0};
+    MCP_Connect(pClient);
+    MCP_Logon(pClient, 1, "account", OnOutcome, &again);
+    PumpUntil(pClient, &again.calls, 1, 2000);
+    dropOk &= again.status == REALM_OK;
+
+    McpStats stats;
+    MCP_GetStats(pClient, &stats);
+    BOOL onceOk = stats.requests == stats.replies + stats.timeouts + stats.failed && stats.pending == 0;
+    MCP_Destroy(pClient);
+
+    printf("verify:  timeout %s, cancel %s, push %s, dropped connection %s, one callback per request %s -> %s\n",
+           timeoutOk ? "ok" : "FAILED", cancelOk ? "ok" : "FAILED", pushOk ? "ok" : "FAILED", dropOk ? "ok" : "FAILED",
+           onceOk ? "ok" : "FAILED", (timeoutOk && cancelOk && pushOk && dropOk && onceOk) ? "ok" : "FAILED");
+    return timeoutOk && cancelOk && pushOk && dropOk && onceOk;
+}
+
+// =============================================================================
+// THROUGHPUT
+// =============================================================================
+
+typedef struct Counter
+{
+    DWORD done;
+    DWORD errors;
+} Counter;
+
+static void __cdecl OnCounted(void *pContext, const McpReply *pReply)
+{
+    Counter *pCounter = (Counter *)pContext;
+    pCounter->done++;
+    pCounter->errors += pReply->status != REALM_OK;
+}
+
+// Requests per second through one connection, at most `window` in flight
+static double Throughput(WORD port, DWORD requests, DWORD window, McpStats *pStats)
+{
+    McpClientDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szHost = "127.0.0.1";
+    desc.port = port;
+    desc.maxPending = window;
+    McpClient *pClient = MCP_Create(&desc);
+    MCP_Connect(pClient);
+    Counter counter = {0, 0};
+    MCP_Logon(pClient, 1, "account", OnCounted, &counter);
+    MCP_CharLogon(pClient, "Char1", OnCounted, &counter);
+    PumpUntil(pClient, &counter.done, 2, 2000);
+
+    auto start = std::chrono::steady_clock::now();
+    DWORD issued = 0;
+    counter.done = 0;
+    while (counter.done < requests)
+    {
+        while (issued < requests && issued - counter.done < window)
+        {
+            if (MCP_RequestGameInfo(pClient, GAME_ID_BASE + issued % REALM_GAMES, OnCounted, &counter) ==
+                MCP_INVALID_REQUEST)
+            {
+                break;
+            }
+            issued++;
+        }
+        MCP_Pump(pClient, 5);
+        if (MCP_GetState(pClient) != MCP_CONNECTED)
+        {
+            break;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    MCP_GetStats(pClient, pStats);
+    pStats->failed += counter.errors;
+    MCP_Destroy(pClient);
+    return counter.done / seconds;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD rttMs = (argc > 1) ? (DWORD)atoi(argv[1]) : 40;
+    DWORD shown = (argc > 2) ? (DWORD)atoi(argv[2]) : 12;
+    DWORD iterations = (argc > 3) ? (DWORD)atoi(argv[3]) : 3;
+    shown = std::max(std::min(shown, (DWORD)MAX_SHOWN), (DWORD)1);
+    iterations = std::max(iterations, (DWORD)1);
+
+    NET_Startup();
+    StandIn *pServer = StartStandIn(16);
+    pServer->rttMs = rttMs;
+
+    DWORD errors = 0;
+    double serialMs = 0, pipeMs = 0;
+    McpStats serialStats, pipeStats;
+    for (DWORD i = 0; i < iterations; i++)
+    {
+        serialMs += FillScreen(pServer->port, FALSE, shown, &serialStats, &errors);
+        pipeMs += FillScreen(pServer->port, TRUE, shown, &pipeStats, &errors);
+    }
+    serialMs /= iterations;
+    pipeMs /= iterations;
+
+    // Replies dribbled in 61-byte pieces: frames arrive split across reads
+    pServer->chunkBytes = 61;
+    McpStats dribbleStats;
+    DWORD dribbleErrors = 0;
+    FillScreen(pServer->port, TRUE, shown, &dribbleStats, &dribbleErrors);
+    pServer->chunkBytes = 0;
+
+    pServer->rttMs = 50;
+    BOOL failuresOk = CheckFailurePaths(pServer->port);
+
+    pServer->rttMs = 0;
+    McpStats serialTput, pipeTput;
+    double serialRate = Throughput(pServer->port, 1000, 1, &serialTput);
+    double pipeRate = Throughput(pServer->port, 50000, 256, &pipeTput);
+    StopStandIn(pServer);
+    NET_Cleanup();
+
+    printf("character select: %u requests (logon, characters, character logon, game list, %u game details, join), "
+           "rtt %u ms, %u runs\n",
+           5 + shown, shown, rttMs, iterations);
+    printf("  serialized: %8.1f ms  (%llu send calls, max in flight %u)\n", serialMs,
+           (unsigned long long)serialStats.sendCalls, serialStats.maxInFlight);
+    printf("  pipelined:  %8.1f ms  (%llu send calls, max in flight %u, %llu replies out of order) %.1fx faster\n",
+           pipeMs, (unsigned long long)pipeStats.sendCalls, pipeStats.maxInFlight,
+           (unsigned long long)pipeStats.outOfOrder, pipeMs > 0 ? serialMs / pipeMs : 0.0);
+    printf("  game list:  %u games, receive buffer grew to %u bytes\n", REALM_GAMES, pipeStats.receiveCapacity);
+    printf("throughput, rtt 0, 1 ms server time: serialized %8.0f req/s, pipelined %8.0f req/s "
+           "(%.1f requests per send call)\n",
+           serialRate, pipeRate, pipeTput.sendCalls ? (double)pipeTput.requests / pipeTput.sendCalls : 0.0);
+
+    BOOL matchedOk = errors == 0 && pipeStats.outOfOrder > 0 && pipeStats.receiveCapacity > 1024;
+    BOOL dribbleOk = dribbleErrors == 0 && dribbleStats.receiveCalls > dribbleStats.replies;
+    BOOL throughputOk = serialTput.failed == 0 && pipeTput.failed == 0 && pipeTput.timeouts == 0;
+    printf("verify:  replies matched %s (%u errors), split frames %s (%llu reads for %llu replies), "
+           "throughput runs %s -> %s\n",
+           matchedOk ? "ok" : "FAILED", errors, dribbleOk ? "ok" : "FAILED",
+           (unsigned long long)dribbleStats.receiveCalls, (unsigned long long)dribbleStats.replies,
+           throughputOk ? "ok" : "FAILED", (matchedOk && dribbleOk && throughputOk) ? "ok" : "FAILED");
+
+    return (matchedOk && dribbleOk && throughputOk && failuresOk) ? 0 : 1;
+}
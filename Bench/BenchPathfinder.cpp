@@ -0,0 +1,587 @@
+/*
+ * BenchPathfinder.cpp - Hundreds of monsters chasing a player
+ *
+ * A 400x400 subtile dungeon (10x10 rooms of 40x40, walls with doorways,
+ * pillars and rubble inside the rooms). The player walks a long route,
+ * stopping now and then to fight; a pack of monsters chases them. Each
+ * monster re-paths every REPATH_TICKS (staggered) or when its path runs out
+ * and steps one cell per tick.
+ *
+ *   a*:   the game's approach - a fresh A* over the level collision for
+ *         every re-target.
+ *   hpa:  PATHFIND_FindPath (cluster graph + path cache).
+ *   flow: one flow field around the player, rebuilt when the player moves;
+ *         monsters inside it read their step, the rest use PATHFIND_FindPath.
+ *
+ * Verification (untimed): HPA* paths are walkable, corner-legal, end at the
+ * goal, cost what they claim and are never shorter than A*; flow field
+ * distances equal A* confined to the field; following the field reaches
+ * the goal; after a door closes no cached path walks through it.
+ *
+ * Usage: bench_pathfinder [monsters] [ticks]
+ */
+
+#include "../Common/Pathfinder.hpp"
+
+#include <chrono>
+#include <queue>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define LEVEL_SIZE 400
+#define ROOM_SIZE 40
+#define REPATH_TICKS 10
+#define FLOW_RADIUS 64
+#define ATTACK_RANGE 2
+#define VERIFY_PAIRS 400
+
+static const int s_dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const int s_dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+static std::vector<WORD> g_collision;
+
+static DWORD g_rng = 0xA57A;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static BOOL Walkable(int x, int y)
+{
+    return x >= 0 && y >= 0 && x < LEVEL_SIZE && y < LEVEL_SIZE &&
+           !(g_collision[y * LEVEL_SIZE + x] & COLLIDE_MONSTER_WALK);
+}
+
+static BOOL StepLegal(int x, int y, int dx, int dy)
+{
+    if (!Walkable(x + dx, y + dy))
+    {
+        return FALSE;
+    }
+    return !dx || !dy || (Walkable(x + dx, y) && Walkable(x, y + dy));
+}
+
+// =============================================================================
+// LEVEL
+// =============================================================================
+
+static void BlockRect(int x0, int y0, int w, int h, WORD flags)
+{
+    for (int y = y0; y < y0 + h && y < LEVEL_SIZE; y++)
+    {
+        for (int x = x0; x < x0 + w && x < LEVEL_SIZE; x++)
+        {
+            g_collision[y * LEVEL_SIZE + x] = flags;
+        }
+    }
+}
+
+typedef struct Door
+{
+    int x, y, w, h;
+} Door;
+
+static std::vector<Door> g_doors;
+
+static void BuildLevel(void)
+{
+    g_collision.assign(LEVEL_SIZE * LEVEL_SIZE, 0);
+
+    // Room walls two subtiles thick, one to three doorways per wall
+    for (int r = 1; r < LEVEL_SIZE / ROOM_SIZE; r++)
+    {
+        BlockRect(r * ROOM_SIZE - 1, 0, 2, LEVEL_SIZE, COLLIDE_WALL);
+        BlockRect(0, r * ROOM_SIZE - 1, LEVEL_SIZE, 2, COLLIDE_WALL);
+    }
+    for (int r = 1; r < LEVEL_SIZE / ROOM_SIZE; r++)
+    {
+        for (int s = 0; s < LEVEL_SIZE / ROOM_SIZE; s++)
+        {
+            for (int vertical = 0; vertical < 2; vertical++)
+            {
+                int doors = 1 + (int)(NextRandom() % 3);
+                for (int d = 0; d < doors; d++)
+                {
+                    int width = 3 + (int)(NextRandom() % 6);
+                    int offset = s * ROOM_SIZE + 3 + (int)(NextRandom() % (ROOM_SIZE - 6 - width));
+                    Door door;
+                    if (vertical)
+                    {
+                        door.x = r * ROOM_SIZE - 1;
+                        door.y = offset;
+                        door.w = 2;
+                        door.h = width;
+                    }
+                    else
+                    {
+                        door.x = offset;
+                        door.y = r * ROOM_SIZE - 1;
+                        door.w = width;
+                        door.h = 2;
+                    }
+                    BlockRect(door.x, door.y, door.w, door.h, 0);
+                    g_doors.push_back(door);
+                }
+            }
+        }
+    }
+
+    // Pillars and rubble
+    for (int room = 0; room < (LEVEL_SIZE / ROOM_SIZE) * (LEVEL_SIZE / ROOM_SIZE); room++)
+    {
+        int rx = (room % (LEVEL_SIZE / ROOM_SIZE)) * ROOM_SIZE, ry = (room / (LEVEL_SIZE / ROOM_SIZE)) * ROOM_SIZE;
+        for (int i = 0; i < 12; i++)
+        {
+            int w = 2 + (int)(NextRandom() % 5), h = 2 + (int)(NextRandom() % 5);
+            BlockRect(rx + 4 + (int)(NextRandom() % (ROOM_SIZE - 12)), ry + 4 + (int)(NextRandom() % (ROOM_SIZE - 12)),
+                      w, h, COLLIDE_BLOCK_PLAYER);
+        }
+    }
+}
+
+static void RandomWalkable(int *pX, int *pY, int cx, int cy, int radius)
+{
+    for (;;)
+    {
+        int x = cx - radius + (int)(NextRandom() % (DWORD)(radius * 2 + 1));
+        int y = cy - radius + (int)(NextRandom() % (DWORD)(radius * 2 + 1));
+        if (Walkable(x, y))
+        {
+            *pX = x;
+            *pY = y;
+            return;
+        }
+    }
+}
+
+// =============================================================================
+// FULL-LEVEL A* BASELINE
+// =============================================================================
+
+typedef struct LegacySearch
+{
+    std::vector<DWORD> g;
+    std::vector<BYTE> closed;
+    std::vector<int> parent;
+} LegacySearch;
+
+static DWORD Octile(int ax, int ay, int bx, int by)
+{
+    int dx = abs(ax - bx), dy = abs(ay - by);
+    return (dx > dy) ? dx * 10 + dy * 4 : dy * 10 + dx * 4;
+}
+
+/*
+ * A* with per-query state cleared over the whole level, the way a search
+ * over the room collision maps starts from nothing. Confined to [x0,x1) x
+ * [y0,y1). Writes cells goal -> start (start excluded) when pCells is set.
+ */
+static DWORD LegacyAStar(LegacySearch *pSearch, int sx, int sy, int gx, int gy, int x0, int y0, int x1, int y1,
+                         std::vector<int> *pCells)
+{
+    typedef std::pair<DWORD, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    pSearch->g.assign(LEVEL_SIZE * LEVEL_SIZE, PATH_UNREACHABLE);
+    pSearch->closed.assign(LEVEL_SIZE * LEVEL_SIZE, 0);
+    pSearch->parent.assign(LEVEL_SIZE * LEVEL_SIZE, -1);
+
+    int start = sy * LEVEL_SIZE + sx, goal = gy * LEVEL_SIZE + gx;
+    pSearch->g[start] = 0;
+    open.push(Entry(Octile(sx, sy, gx, gy), start));
+    while (!open.empty())
+    {
+        int cell = open.top().second;
+        open.pop();
+        if (pSearch->closed[cell])
+        {
+            continue;
+        }
+        pSearch->closed[cell] = 1;
+        if (cell == goal)
+        {
+            break;
+        }
+
+        int x = cell % LEVEL_SIZE, y = cell / LEVEL_SIZE;
+        for (int dir = 0; dir < 8; dir++)
+        {
+            int nx = x + s_dx[dir], ny = y + s_dy[dir];
+            if (nx < x0 || ny < y0 || nx >= x1 || ny >= y1 || !StepLegal(x, y, s_dx[dir], s_dy[dir]))
+            {
+                continue;
+            }
+            int next = ny * LEVEL_SIZE + nx;
+            DWORD ng = pSearch->g[cell] + ((dir & 1) ? 14 : 10);
+            if (ng < pSearch->g[next])
+            {
+                pSearch->g[next] = ng;
+                pSearch->parent[next] = cell;
+                open.push(Entry(ng + Octile(nx, ny, gx, gy), next));
+            }
+        }
+    }
+
+    if (pCells && pSearch->g[goal] != PATH_UNREACHABLE)
+    {
+        pCells->clear();
+        for (int cell = goal; cell != start; cell = pSearch->parent[cell])
+        {
+            pCells->push_back(cell);
+        }
+    }
+    return pSearch->g[goal];
+}
+
+// =============================================================================
+// SIMULATION
+// =============================================================================
+
+typedef enum Mode
+{
+    MODE_ASTAR,
+    MODE_HPA,
+    MODE_FLOW,
+} Mode;
+
+typedef struct Monster
+{
+    int x, y;
+    DWORD repathAt;
+    std::vector<int> steps; // A*: remaining cells, back = next
+    PathResult path;        // HPA: corners
+    DWORD nextPoint;
+} Monster;
+
+typedef struct SimResult
+{
+    double seconds;
+    DWORD repaths;
+    DWORD attacking; // Monster-ticks spent in range of the player
+    PathfinderStats stats;
+} SimResult;
+
+static std::vector<int> g_route; // Player cell per tick
+
+static void BuildRoute(Pathfinder *pPathfinder, DWORD ticks, int startX, int startY)
+{
+    int x = startX, y = startY;
+    g_route.clear();
+    while (g_route.size() < ticks)
+    {
+        // Walk to a random spot on the level, then fight for a while
+        int tx, ty;
+        RandomWalkable(&tx, &ty, LEVEL_SIZE / 2, LEVEL_SIZE / 2, LEVEL_SIZE / 2 - 2);
+        PathResult path;
+        if (!PATHFIND_FindPath(pPathfinder, x, y, tx, ty, COLLIDE_MONSTER_WALK, &path))
+        {
+            continue;
+        }
+        for (DWORD p = 0; p < path.pointCount && g_route.size() < ticks; p++)
+        {
+            while ((x != path.points[p].x || y != path.points[p].y) && g_route.size() < ticks)
+            {
+                x += (path.points[p].x > x) - (path.points[p].x < x);
+                y += (path.points[p].y > y) - (path.points[p].y < y);
+                g_route.push_back(y * LEVEL_SIZE + x);
+            }
+        }
+        for (DWORD fight = 0; fight < 40 && g_route.size() < ticks; fight++)
+        {
+            g_route.push_back(y * LEVEL_SIZE + x);
+        }
+    }
+}
+
+static SimResult Simulate(Mode mode, const std::vector<Monster> &spawn, DWORD ticks)
+{
+    PathfinderDesc desc = {LEVEL_SIZE, LEVEL_SIZE, g_collision.data(), 0, 0};
+    Pathfinder *pPathfinder = PATHFIND_Create(&desc);
+    FlowField *pField = PATHFIND_CreateFlowField(pPathfinder, FLOW_RADIUS);
+    LegacySearch search;
+    std::vector<Monster> monsters = spawn;
+    SimResult result;
+    memset(&result, 0, sizeof(result));
+
+    // Graph build is part of level load, not of the chase
+    PathResult warm;
+    PATHFIND_FindPath(pPathfinder, spawn[0].x, spawn[0].y, 2, 2, COLLIDE_MONSTER_WALK, &warm);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (DWORD tick = 0; tick < ticks; tick++)
+    {
+        int px = g_route[tick] % LEVEL_SIZE, py = g_route[tick] / LEVEL_SIZE;
+        if (mode == MODE_FLOW)
+        {
+            PATHFIND_UpdateFlowField(pPathfinder, pField, px, py, COLLIDE_MONSTER_WALK);
+        }
+
+        for (size_t m = 0; m < monsters.size(); m++)
+        {
+            Monster *pMonster = &monsters[m];
+            if (abs(pMonster->x - px) <= ATTACK_RANGE && abs(pMonster->y - py) <= ATTACK_RANGE)
+            {
+                result.attacking++;
+                continue;
+            }
+
+            DWORD nx, ny;
+            if (mode == MODE_FLOW && FLOWFIELD_GetStep(pField, pMonster->x, pMonster->y, &nx, &ny))
+            {
+                pMonster->x = (int)nx;
+                pMonster->y = (int)ny;
+                continue;
+            }
+
+            BOOL exhausted = (mode == MODE_ASTAR) ? pMonster->steps.empty()
+                                                  : pMonster->nextPoint >= pMonster->path.pointCount;
+            if (tick >= pMonster->repathAt || exhausted)
+            {
+                pMonster->repathAt = tick + REPATH_TICKS;
+                result.repaths++;
+                if (mode == MODE_ASTAR)
+                {
+                    if (LegacyAStar(&search, pMonster->x, pMonster->y, px, py, 0, 0, LEVEL_SIZE, LEVEL_SIZE,
+                                    &pMonster->steps) == PATH_UNREACHABLE)
+                    {
+                        pMonster->steps.clear();
+                    }
+                }
+                else
+                {
+                    pMonster->nextPoint = 0;
+                    if (!PATHFIND_FindPath(pPathfinder, pMonster->x, pMonster->y, px, py, COLLIDE_MONSTER_WALK,
+                                           &pMonster->path))
+                    {
+                        pMonster->path.pointCount = 0;
+                    }
+                }
+            }
+
+            if (mode == MODE_ASTAR)
+            {
+                if (!pMonster->steps.empty())
+                {
+                    pMonster->x = pMonster->steps.back() % LEVEL_SIZE;
+                    pMonster->y = pMonster->steps.back() / LEVEL_SIZE;
+                    pMonster->steps.pop_back();
+                }
+            }
+            else if (pMonster->nextPoint < pMonster->path.pointCount)
+            {
+                const PathPoint *pPoint = &pMonster->path.points[pMonster->nextPoint];
+                pMonster->x += (pPoint->x > pMonster->x) - (pPoint->x < pMonster->x);
+                pMonster->y += (pPoint->y > pMonster->y) - (pPoint->y < pMonster->y);
+                if (pMonster->x == pPoint->x && pMonster->y == pPoint->y)
+                {
+                    pMonster->nextPoint++;
+                }
+            }
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    PATHFIND_GetStats(pPathfinder, &result.stats);
+
+    PATHFIND_DestroyFlowField(pField);
+    PATHFIND_Destroy(pPathfinder);
+    return result;
+}
+
+// =============================================================================
+// VERIFICATION
+// =============================================================================
+
+// Walk the corners; returns the step cost or PATH_UNREACHABLE if any step is illegal
+static DWORD WalkPath(int x, int y, const PathResult *pPath, int gx, int gy)
+{
+    DWORD cost = 0;
+    for (DWORD p = 0; p < pPath->pointCount; p++)
+    {
+        int tx = pPath->points[p].x, ty = pPath->points[p].y;
+        int dx = (tx > x) - (tx < x), dy = (ty > y) - (ty < y);
+        if (abs(tx - x) && abs(ty - y) && abs(tx - x) != abs(ty - y))
+        {
+            return PATH_UNREACHABLE; // Corners must be joined by straight or diagonal runs
+        }
+        while (x != tx || y != ty)
+        {
+            if (!StepLegal(x, y, dx, dy))
+            {
+                return PATH_UNREACHABLE;
+            }
+            x += dx;
+            y += dy;
+            cost += (dx && dy) ? 14 : 10;
+        }
+    }
+    return (pPath->partial || (x == gx && y == gy)) ? cost : PATH_UNREACHABLE;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD monsterCount = (argc > 1) ? (DWORD)atoi(argv[1]) : 400;
+    DWORD ticks = (argc > 2) ? (DWORD)atoi(argv[2]) : 500;
+    if (monsterCount < 1)
+    {
+        monsterCount = 1;
+    }
+    if (ticks < 1)
+    {
+        ticks = 1;
+    }
+
+    BuildLevel();
+    PathfinderDesc desc = {LEVEL_SIZE, LEVEL_SIZE, g_collision.data(), 0, 0};
+    Pathfinder *pPathfinder = PATHFIND_Create(&desc);
+
+    int playerX, playerY;
+    RandomWalkable(&playerX, &playerY, LEVEL_SIZE / 2, LEVEL_SIZE / 2, 20);
+    BuildRoute(pPathfinder, ticks, playerX, playerY);
+
+    std::vector<Monster> spawn(monsterCount);
+    for (DWORD m = 0; m < monsterCount; m++)
+    {
+        RandomWalkable(&spawn[m].x, &spawn[m].y, playerX, playerY, 120);
+        spawn[m].repathAt = m % REPATH_TICKS;
+        spawn[m].path.pointCount = 0;
+        spawn[m].nextPoint = 0;
+    }
+
+    SimResult astar = Simulate(MODE_ASTAR, spawn, ticks);
+    SimResult hpa = Simulate(MODE_HPA, spawn, ticks);
+    SimResult flow = Simulate(MODE_FLOW, spawn, ticks);
+
+    // --- HPA* paths vs optimal A* ---
+    LegacySearch search;
+    DWORD invalid = 0, shorter = 0, unmatched = 0, compared = 0;
+    double ratioSum = 0, ratioMax = 1;
+    for (DWORD i = 0; i < VERIFY_PAIRS; i++)
+    {
+        int sx, sy, gx, gy;
+        RandomWalkable(&sx, &sy, LEVEL_SIZE / 2, LEVEL_SIZE / 2, LEVEL_SIZE / 2 - 1);
+        RandomWalkable(&gx, &gy, sx, sy, (i & 1) ? 30 : 150);
+        DWORD optimal = LegacyAStar(&search, sx, sy, gx, gy, 0, 0, LEVEL_SIZE, LEVEL_SIZE, NULL);
+        PathResult path;
+        BOOL found = PATHFIND_FindPath(pPathfinder, sx, sy, gx, gy, COLLIDE_MONSTER_WALK, &path);
+        if (found != (optimal != PATH_UNREACHABLE))
+        {
+            unmatched++;
+            continue;
+        }
+        if (!found || path.partial)
+        {
+            continue;
+        }
+        DWORD walked = WalkPath(sx, sy, &path, gx, gy);
+        invalid += (walked != path.cost) ? 1 : 0;
+        shorter += (path.cost < optimal) ? 1 : 0;
+        double ratio = optimal ? (double)path.cost / optimal : 1.0;
+        ratioSum += ratio;
+        ratioMax = (ratio > ratioMax) ? ratio : ratioMax;
+        compared++;
+    }
+
+    // --- Flow field vs confined A*, and following it ---
+    FlowField *pField = PATHFIND_CreateFlowField(pPathfinder, FLOW_RADIUS);
+    DWORD flowMismatches = 0, flowChecked = 0, flowStuck = 0;
+    for (DWORD goalIndex = 0; goalIndex < 4; goalIndex++)
+    {
+        int gx, gy;
+        RandomWalkable(&gx, &gy, LEVEL_SIZE / 2, LEVEL_SIZE / 2, 100);
+        PATHFIND_UpdateFlowField(pPathfinder, pField, gx, gy, COLLIDE_MONSTER_WALK);
+        int x0 = (gx > FLOW_RADIUS) ? gx - FLOW_RADIUS : 0, y0 = (gy > FLOW_RADIUS) ? gy - FLOW_RADIUS : 0;
+        int x1 = gx + FLOW_RADIUS + 1, y1 = gy + FLOW_RADIUS + 1;
+        for (DWORD i = 0; i < 40; i++)
+        {
+            int sx, sy;
+            RandomWalkable(&sx, &sy, gx, gy, FLOW_RADIUS - 1);
+            DWORD expected = LegacyAStar(&search, sx, sy, gx, gy, x0, y0, x1 < LEVEL_SIZE ? x1 : LEVEL_SIZE,
+                                         y1 < LEVEL_SIZE ? y1 : LEVEL_SIZE, NULL);
+            DWORD distance = FLOWFIELD_GetDistance(pField, sx, sy);
+            flowMismatches += (distance != expected) ? 1 : 0;
+            flowChecked++;
+
+            // Follow the field: every step legal, total equals the distance
+            DWORD walked = 0, x = sx, y = sy, nx, ny;
+            while (distance != PATH_UNREACHABLE && FLOWFIELD_GetStep(pField, x, y, &nx, &ny))
+            {
+                if (!StepLegal(x, y, (int)nx - (int)x, (int)ny - (int)y))
+                {
+                    break;
+                }
+                walked += (nx != x && ny != y) ? 14 : 10;
+                x = nx;
+                y = ny;
+            }
+            if (distance != PATH_UNREACHABLE && ((int)x != gx || (int)y != gy || walked != distance))
+            {
+                flowStuck++;
+            }
+        }
+    }
+
+    // --- Closing a door drops cached paths through it ---
+    DWORD doorViolations = 0, doorChecks = 0;
+    for (size_t d = 0; d < g_doors.size() && doorChecks < 8; d += 7)
+    {
+        const Door *pDoor = &g_doors[d];
+        int ax = pDoor->x + (pDoor->w == 2 ? -2 : pDoor->w / 2), ay = pDoor->y + (pDoor->h == 2 ? -2 : pDoor->h / 2);
+        int bx = pDoor->x + (pDoor->w == 2 ? 3 : pDoor->w / 2), by = pDoor->y + (pDoor->h == 2 ? 3 : pDoor->h / 2);
+        PathResult before, after;
+        if (!Walkable(ax, ay) || !Walkable(bx, by) ||
+            !PATHFIND_FindPath(pPathfinder, ax, ay, bx, by, COLLIDE_MONSTER_WALK, &before))
+        {
+            continue;
+        }
+        for (int y = pDoor->y; y < pDoor->y + pDoor->h; y++)
+        {
+            for (int x = pDoor->x; x < pDoor->x + pDoor->w; x++)
+            {
+                g_collision[y * LEVEL_SIZE + x] = COLLIDE_DOOR;
+                PATHFIND_SetCollision(pPathfinder, x, y, COLLIDE_DOOR);
+            }
+        }
+        if (PATHFIND_FindPath(pPathfinder, ax, ay, bx, by, COLLIDE_MONSTER_WALK, &after) &&
+            WalkPath(ax, ay, &after, bx, by) == PATH_UNREACHABLE)
+        {
+            doorViolations++;
+        }
+        doorChecks++;
+    }
+
+    PATHFIND_DestroyFlowField(pField);
+    PATHFIND_Destroy(pPathfinder);
+
+    printf("chase:   %u monsters, %u ticks, %u x %u subtiles, re-path every %u ticks\n", monsterCount, ticks,
+           LEVEL_SIZE, LEVEL_SIZE, REPATH_TICKS);
+    printf("  a*:    %8.3f ms/tick, %6u re-paths (%.1f us each), %u attack ticks\n", astar.seconds * 1e3 / ticks,
+           astar.repaths, astar.seconds * 1e6 / (astar.repaths ? astar.repaths : 1), astar.attacking);
+    printf("  hpa:   %8.3f ms/tick, %6u re-paths (%.2fx), %u attack ticks\n", hpa.seconds * 1e3 / ticks, hpa.repaths,
+           astar.seconds / hpa.seconds, hpa.attacking);
+    printf("  flow:  %8.3f ms/tick, %6u re-paths (%.2fx), %u attack ticks\n", flow.seconds * 1e3 / ticks,
+           flow.repaths, astar.seconds / flow.seconds, flow.attacking);
+    printf("  hpa:   %llu queries, %llu cache hits, %llu local, %llu abstract, %llu cells, %llu nodes expanded, "
+           "%u graph nodes\n",
+           (unsigned long long)hpa.stats.queries, (unsigned long long)hpa.stats.cacheHits,
+           (unsigned long long)hpa.stats.localSearches, (unsigned long long)hpa.stats.abstractSearches,
+           (unsigned long long)hpa.stats.cellsExpanded, (unsigned long long)hpa.stats.nodesExpanded,
+           hpa.stats.graphNodes);
+    printf("  flow:  %u field builds, %llu fallback queries, %llu cache hits\n", flow.stats.flowBuilds,
+           (unsigned long long)flow.stats.queries, (unsigned long long)flow.stats.cacheHits);
+    printf("verify:  hpa vs a* on %u pairs: cost %.3fx mean, %.3fx worst; %u invalid, %u shorter than optimal, "
+           "%u reachability mismatches -> %s\n",
+           compared, compared ? ratioSum / compared : 1.0, ratioMax, invalid, shorter, unmatched,
+           (invalid || shorter || unmatched) ? "FAILED" : "ok");
+    printf("verify:  flow field vs confined a*: %u of %u distances differ, %u walks off -> %s\n", flowMismatches,
+           flowChecked, flowStuck, (flowMismatches || flowStuck) ? "FAILED" : "ok");
+    printf("verify:  %u doors closed, %u paths still through them -> %s\n", doorChecks, doorViolations,
+           doorViolations ? "FAILED" : "ok");
+
+    return (invalid || shorter || unmatched || flowMismatches || flowStuck || doorViolations) ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * BenchRealm.cpp - Join storm and chat fan-out against the local realm
+ *
+ * Starts a RealmServer on loopback and points RealmSwarms at it:
+ *   join storm: every client connects at once, logs on, creates and
+ *               selects a character, joins one of 20 channels and a game
+ *               (creating one when its pick is full), which is the
+ *               peak-hour login spike;
+ *   fan-out:    a crowd in one channel talks; every line goes to every
+ *               other member.
+ *
+ * Verification:
+ *   - every client gets through the storm; the server counted one logon,
+ *     one character, one channel join and one game per client, and every
+ *     game and connection is gone once the swarm disconnects;
+ *   - in the fan-out, every member receives every other member's lines:
+ *     received == (lines - throttled) * (members - 1) == the server's
+ *     count of deliveries, where the lines stay inside flood control's
+ *     burst so none should be throttled;
+ *   - one scripted client sees the protocol's refusals: requests before
+ *     logon, a taken character name, chat outside a channel, a full game,
+ *     a wrong password; and sees a game's players in its details.
+ *
+ * Usage: bench_realm [stormClients] [chatClients] [chatLines]
+ */
+
+#include "../Realm/RealmServer.hpp"
+#include "../Realm/RealmSwarm.hpp"
+
+#include "../Net/McpClient.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define STORM_CHANNELS 20
+#define SERVER_THREADS 2
+#define SWARM_THREADS 2
+#define SETTLE_TIMEOUT_MS 5000
+
+// Waits until the server has seen every connection close
+static BOOL WaitIdle(RealmServer *pServer, RealmServerStats *pStats)
+{
+    for (DWORD waited = 0; waited < SETTLE_TIMEOUT_MS; waited++)
+    {
+        REALMSRV_GetStats(pServer, pStats);
+        if (pStats->connections == 0 && pStats->games == 0 && pStats->channels == 0)
+        {
+            return TRUE;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return FALSE;
+}
+
+// =============================================================================
+// PROTOCOL CHECKS
+// =============================================================================
+
+typedef struct Expect
+{
+    BYTE status;
+    BOOL done;
+    BOOL matched;
+    std::vector<BYTE> payload;
+} Expect;
+
+static void __cdecl OnExpect(void *pContext, const McpReply *pReply)
+{
+    Expect *pExpect = (Expect *)pContext;
+    pExpect->done = TRUE;
+    pExpect->matched = pReply->status == pExpect->status;
+    pExpect->payload.assign(pReply->pPayload, pReply->pPayload + pReply->payloadSize);
+}
+
+// Runs the client until every expectation has its reply
+static BOOL Settle(McpClient **ppClients, DWORD clientCount, std::vector<Expect *> &expects)
+{
+    for (DWORD waited = 0; waited < SETTLE_TIMEOUT_MS; waited++)
+    {
+        BOOL done = TRUE;
+        for (size_t i = 0; i < expects.size(); i++)
+        {
+            done = done && expects[i]->done;
+        }
+        if (done)
+        {
+            break;
+        }
+        for (DWORD c = 0; c < clientCount; c++)
+        {
+            MCP_Pump(ppClients[c], 1);
+        }
+    }
+    BOOL ok = TRUE;
+    for (size_t i = 0; i < expects.size(); i++)
+    {
+        if (!expects[i]->done || !expects[i]->matched)
+        {
+            printf("  protocol check %u: %s\n", (DWORD)i, expects[i]->done ? "wrong status" : "no reply");
+            ok = FALSE;
+        }
+    }
+    expects.clear();
+    return ok;
+}
+
+static Expect *Want(std::vector<Expect *> &expects, Expect *pExpect, BYTE status)
+{
+    pExpect->status = status;
+    pExpect->done = FALSE;
+    pExpect->matched = FALSE;
+    expects.push_back(pExpect);
+    return pExpect;
+}
+
+static BOOL CheckProtocol(WORD port)
+{
+    McpClientDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szHost = "127.0.0.1";
+    desc.port = port;
+    McpClient *pClients[2] = {MCP_Create(&desc), MCP_Create(&desc)};
+    MCP_Connect(pClients[0]);
+    MCP_Connect(pClients[1]);
+
+    std::vector<Expect *> expects;
+    Expect e[16];
+    BOOL ok = TRUE;
+
+    // Before logon, then the character the other client takes first
+    MCP_RequestCharList(pClients[0], 8, OnExpect, Want(expects, &e[0], REALM_ERR_NOT_LOGGED_ON));
+    MCP_Logon(pClients[0], 0, "chk0", OnExpect, Want(expects, &e[1], REALM_OK));
+    MCP_Logon(pClients[1], 0, "chk1", OnExpect, Want(expects, &e[2], REALM_OK));
+    MCP_CreateChar(pClients[1], 3, 0, "Taken", OnExpect, Want(expects, &e[3], REALM_OK));
+    ok &= Settle(pClients, 2, expects);
+    MCP_CreateChar(pClients[0], 1, 0, "Taken", OnExpect, Want(expects, &e[0], REALM_ERR_EXISTS));
+    MCP_CreateChar(pClients[0], 1, 0, "Mine", OnExpect, Want(expects, &e[1], REALM_OK));
+    MCP_Chat(pClients[0], "nobody hears", OnExpect, Want(expects, &e[2], REALM_ERR_NOT_LOGGED_ON));
+    MCP_CharLogon(pClients[0], "Taken", OnExpect, Want(expects, &e[3], REALM_ERR_NOT_FOUND));
+    MCP_CharLogon(pClients[0], "Mine", OnExpect, Want(expects, &e[4], REALM_OK));
+    MCP_CharLogon(pClients[1], "Taken", OnExpect, Want(expects, &e[5], REALM_OK));
+    MCP_Chat(pClients[0], "nobody hears", OnExpect, Want(expects, &e[6], REALM_ERR_NOT_FOUND));
+    MCP_CreateGame(pClients[0], "duel", "pw", 1, 1, OnExpect, Want(expects, &e[7], REALM_OK));
+    ok &= Settle(pClients, 2, expects);
+
+    MCP_JoinGame(pClients[1], "duel", "wrong", OnExpect, Want(expects, &e[0], REALM_ERR_PASSWORD));
+    MCP_JoinGame(pClients[1], "duel", "pw", OnExpect, Want(expects, &e[1], REALM_ERR_FULL));
+    MCP_JoinGame(pClients[1], "nowhere", "", OnExpect, Want(expects, &e[2], REALM_ERR_NOT_FOUND));
+    MCP_RequestGameList(pClients[1], "du", OnExpect, Want(expects, &e[3], REALM_OK));
+    ok &= Settle(pClients, 2, expects);
+
+    // The list shows the game; its details show its one player
+    RealmReader reader;
+    RealmGameEntry entry;
+    REALM_InitReader(&reader, e[3].payload.data(), (DWORD)e[3].payload.size());
+    BOOL listed = REALM_GetWord(&reader) == 1 && REALM_GetGameEntry(&reader, &entry) && entry.players == 1 &&
+                  entry.maxPlayers == 1 && (entry.flags & 1) && strcmp(entry.szName, "duel") == 0;
+    if (listed)
+    {
+        MCP_RequestGameInfo(pClients[1], entry.gameId, OnExpect, Want(expects, &e[0], REALM_OK));
+        ok &= Settle(pClients, 2, expects);
+        RealmGameInfo info;
+        REALM_InitReader(&reader, e[0].payload.data(), (DWORD)e[0].payload.size());
+        listed = REALM_GetGameInfo(&reader, &info) && info.playerCount == 1 &&
+                 strcmp(info.players[0].szName, "Mine") == 0 && info.players[0].charClass == 1;
+    }
+    if (!listed)
+    {
+        printf("  protocol check: game list or details wrong\n");
+        ok = FALSE;
+    }
+
+    MCP_Destroy(pClients[0]);
+    MCP_Destroy(pClients[1]);
+    return ok;
+}
+
+// =============================================================================
+// BENCH
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+    DWORD stormClients = (argc > 1) ? (DWORD)atoi(argv[1]) : 2000;
+    DWORD chatClients = (argc > 2) ? (DWORD)atoi(argv[2]) : 500;
+    DWORD chatLines = (argc > 3) ? (DWORD)atoi(argv[3]) : 4;
+
+    NET_Startup();
+    RealmServerDesc serverDesc;
+    memset(&serverDesc, 0, sizeof(serverDesc));
+    serverDesc.szAddress = "127.0.0.1";
+    serverDesc.threads = SERVER_THREADS;
+    RealmServer *pServer = REALMSRV_Create(&serverDesc);
+    if (!pServer)
+    {
+        printf("cannot start the realm\n");
+        return 1;
+    }
+    WORD port = REALMSRV_GetPort(pServer);
+
+    BOOL protocolOk = CheckProtocol(port);
+    RealmServerStats before, after;
+    BOOL idleOk = WaitIdle(pServer, &before);
+
+    // Join storm
+    RealmSwarmDesc swarm;
+    memset(&swarm, 0, sizeof(swarm));
+    swarm.szHost = "127.0.0.1";
+    swarm.port = port;
+    swarm.szPrefix = "js";
+    swarm.clients = stormClients;
+    swarm.threads = SWARM_THREADS;
+    swarm.channels = STORM_CHANNELS;
+    swarm.lingerMs = 100;
+    RealmSwarmStats storm;
+    BOOL stormOk = REALMSWARM_Run(&swarm, &storm);
+    idleOk &= WaitIdle(pServer, &after);
+    stormOk = stormOk && storm.ready == stormClients && after.logons - before.logons == stormClients &&
+              after.charsCreated - before.charsCreated == stormClients &&
+              after.channelJoins - before.channelJoins == stormClients &&
+              storm.gamesCreated + storm.gamesJoined == stormClients &&
+              after.gamesCreated - before.gamesCreated == storm.gamesCreated;
+
+    printf("join storm: %u clients at once into %u channels, %u server threads\n", stormClients, STORM_CHANNELS,
+           SERVER_THREADS);
+    printf("  all ready in %u ms (%.0f logins/s); login p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+           storm.loginPhaseMs, storm.loginPhaseMs ? stormClients * 1000.0 / storm.loginPhaseMs : 0.0,
+           storm.loginP50Us / 1000.0, storm.loginP99Us / 1000.0, storm.loginMaxUs / 1000.0);
+    printf("  %llu requests, %llu games created, %llu joined (%llu retried full), %llu join events\n",
+           (unsigned long long)storm.requests, (unsigned long long)storm.gamesCreated,
+           (unsigned long long)storm.gamesJoined, (unsigned long long)storm.fullRetries,
+           (unsigned long long)storm.joinEvents);
+
+    // Fan-out in one channel
+    before = after;
+    swarm.szPrefix = "fo";
+    swarm.clients = chatClients;
+    swarm.channels = 1;
+    swarm.chatLines = chatLines;
+    swarm.chatIntervalMs = 50;
+    swarm.lingerMs = 500;
+    RealmSwarmStats chat;
+    BOOL chatOk = REALMSWARM_Run(&swarm, &chat);
+    idleOk &= WaitIdle(pServer, &after);
+    uint64_t expected = (chat.chatSent - chat.chatThrottled) * (chatClients - 1);
+    uint64_t delivered = after.chatDeliveries - before.chatDeliveries;
+    chatOk = chatOk && chat.chatSent == (uint64_t)chatLines * chatClients && chat.chatReceived == expected &&
+             delivered == expected;
+
+    printf("fan-out: %u members in one channel, %u lines each, %u ms apart\n", chatClients, chatLines,
+           swarm.chatIntervalMs);
+    printf("  %llu lines -> %llu deliveries in %u ms (%.0f deliveries/s); latency p50 %.2f ms, p99 %.2f ms, "
+           "max %.2f ms\n",
+           (unsigned long long)chat.chatSent, (unsigned long long)chat.chatReceived, chat.chatPhaseMs,
+           chat.chatPhaseMs ? chat.chatReceived * 1000.0 / chat.chatPhaseMs : 0.0, chat.chatP50Us / 1000.0,
+           chat.chatP99Us / 1000.0, chat.chatMaxUs / 1000.0);
+    printf("  server: %llu batches posted, %llu bytes in %llu sends, %llu lines throttled, %llu slow readers "
+           "dropped\n",
+           (unsigned long long)(after.batchesPosted - before.batchesPosted),
+           (unsigned long long)(after.bytesSent - before.bytesSent),
+           (unsigned long long)(after.sendCalls - before.sendCalls), (unsigned long long)chat.chatThrottled,
+           (unsigned long long)after.slowDrops);
+
+    REALMSRV_Destroy(pServer);
+    NET_Cleanup();
+
+    printf("verify: protocol %s, storm %s (%u failed), fan-out %s (%llu of %llu received), cleanup %s -> %s\n",
+           protocolOk ? "ok" : "FAILED", stormOk ? "ok" : "FAILED", storm.failed, chatOk ? "ok" : "FAILED",
+           (unsigned long long)chat.chatReceived, (unsigned long long)expected, idleOk ? "ok" : "FAILED",
+           (protocolOk && stormOk && chatOk && idleOk) ? "ok" : "FAILED");
+    return (protocolOk && stormOk && chatOk && idleOk) ? 0 : 1;
+}
@@ -0,0 +1,465 @@
+/*
+ * BenchReplication.cpp - Per-unit update packets vs delta-compressed frames
+ *
+ * Eight players fight in one crowded area: a few hundred monsters chasing
+ * and hitting them, dying and respawning, missiles flying, objects standing
+ * around. The same world (same seed) is replicated to the eight clients:
+ *
+ *   packets: what the game sends today - every unit in range that changed
+ *            this tick costs a full update packet to every client that can
+ *            see it, plus assign/remove packets as units enter and leave.
+ *   frames:  one Replicator frame per client per tick at several per-client
+ *            budgets (the D2Net packet limit down to a 28.8k modem's share).
+ *
+ * Bytes and packets per client per tick are compared before D2Net's
+ * Huffman stage, which both go through. Every frame is applied by a
+ * ReplClient; after the world freezes and the frames drain, each client
+ * must hold exactly the units in its view with the server's state.
+ *
+ * Usage: bench_replication [ticks] [monsters]
+ */
+
+#include "../Server/Replication.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#define PLAYERS 8
+#define OBJECTS 40
+#define AREA 160  // Subtiles across the fight
+#define ORIGIN 2000
+#define VIEW_RADIUS 48
+#define LEGACY_UPDATE_BYTES 17 // opcode, type, guid, class, x, y, mode, life, dir, flags
+#define LEGACY_REMOVE_BYTES 6
+#define LEGACY_PACKET_OVERHEAD 2 // D2Net length header
+
+// Unit modes, after the monster mode table
+#define MODE_DEATH 0
+#define MODE_NEUTRAL 1
+#define MODE_WALK 2
+#define MODE_ATTACK 4
+#define MODE_DEAD 12
+
+// =============================================================================
+// WORLD
+// =============================================================================
+
+typedef struct WorldUnit
+{
+    ReplUnitState state;
+    int targetX;
+    int targetY;
+    DWORD timer; // Ticks left in the current action / life
+} WorldUnit;
+
+typedef struct World
+{
+    std::vector<WorldUnit> units; // Players first
+    DWORD nextGuid;
+    DWORD rng;
+    std::vector<DWORD> removed; // GUIDs removed this tick
+} World;
+
+static DWORD NextRandom(World *pWorld)
+{
+    pWorld->rng ^= pWorld->rng << 13;
+    pWorld->rng ^= pWorld->rng >> 17;
+    pWorld->rng ^= pWorld->rng << 5;
+    return pWorld->rng;
+}
+
+static WorldUnit MakeUnit(World *pWorld, BYTE type, WORD classId)
+{
+    WorldUnit unit;
+    memset(&unit, 0, sizeof(unit));
+    unit.state.guid = pWorld->nextGuid++;
+    unit.state.type = type;
+    unit.state.classId = classId;
+    unit.state.x = (WORD)(ORIGIN + NextRandom(pWorld) % AREA);
+    unit.state.y = (WORD)(ORIGIN + NextRandom(pWorld) % AREA);
+    unit.state.mode = MODE_NEUTRAL;
+    unit.state.life = 128;
+    unit.state.direction = (BYTE)(NextRandom(pWorld) % 64);
+    unit.targetX = unit.state.x;
+    unit.targetY = unit.state.y;
+    return unit;
+}
+
+static void InitWorld(World *pWorld, DWORD monsters)
+{
+    pWorld->units.clear();
+    pWorld->nextGuid = 1;
+    pWorld->rng = 0x5EEDu;
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        pWorld->units.push_back(MakeUnit(pWorld, REPL_UNIT_PLAYER, (WORD)(p % 7)));
+    }
+    for (DWORD m = 0; m < monsters; m++)
+    {
+        pWorld->units.push_back(MakeUnit(pWorld, REPL_UNIT_MONSTER, (WORD)(NextRandom(pWorld) % 700)));
+    }
+    for (DWORD o = 0; o < OBJECTS; o++)
+    {
+        pWorld->units.push_back(MakeUnit(pWorld, REPL_UNIT_OBJECT, (WORD)(NextRandom(pWorld) % 500)));
+    }
+}
+
+static void StepToward(WorldUnit *pUnit, DWORD speed)
+{
+    int dx = pUnit->targetX - (int)pUnit->state.x;
+    int dy = pUnit->targetY - (int)pUnit->state.y;
+    int sx = std::max(-(int)speed, std::min((int)speed, dx));
+    int sy = std::max(-(int)speed, std::min((int)speed, dy));
+    pUnit->state.x = (WORD)(pUnit->state.x + sx);
+    pUnit->state.y = (WORD)(pUnit->state.y + sy);
+    if (sx || sy)
+    {
+        // One of 8 headings, spread over the 64 directions
+        int heading = ((sy > 0) - (sy < 0) + 1) * 3 + ((sx > 0) - (sx < 0) + 1);
+        pUnit->state.direction = (BYTE)(heading * 7);
+    }
+}
+
+static void StepWorld(World *pWorld)
+{
+    pWorld->removed.clear();
+    size_t count = pWorld->units.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        WorldUnit *pUnit = &pWorld->units[i];
+        ReplUnitState *pState = &pUnit->state;
+
+        if (pState->type == REPL_UNIT_PLAYER)
+        {
+            if (pState->x == pUnit->targetX && pState->y == pUnit->targetY)
+            {
+                pUnit->targetX = ORIGIN + NextRandom(pWorld) % AREA;
+                pUnit->targetY = ORIGIN + NextRandom(pWorld) % AREA;
+            }
+            StepToward(pUnit, 2);
+            pState->mode = (NextRandom(pWorld) % 6 == 0) ? MODE_ATTACK : 3; // Run or cast
+        }
+        else if (pState->type == REPL_UNIT_MONSTER)
+        {
+            if (pState->mode == MODE_DEATH || pState->mode == MODE_DEAD)
+            {
+                pState->mode = MODE_DEAD;
+                if (--pUnit->timer == 0)
+                {
+                    pWorld->removed.push_back(pState->guid);
+                    *pUnit = MakeUnit(pWorld, REPL_UNIT_MONSTER, (WORD)(NextRandom(pWorld) % 700));
+                }
+                continue;
+            }
+            const WorldUnit *pPlayer = &pWorld->units[pState->guid % PLAYERS];
+            pUnit->targetX = pPlayer->state.x;
+            pUnit->targetY = pPlayer->state.y;
+            int dx = pUnit->targetX - (int)pState->x;
+            int dy = pUnit->targetY - (int)pState->y;
+            if (dx * dx + dy * dy <= 4)
+            {
+                pState->mode = MODE_ATTACK;
+            }
+            else if (NextRandom(pWorld) % 3)
+            {
+                pState->mode = MODE_WALK;
+                StepToward(pUnit, 1);
+            }
+            else
+            {
+                pState->mode = MODE_NEUTRAL;
+            }
+            // Hit by the players now and then
+            if (NextRandom(pWorld) % 10 == 0)
+            {
+                DWORD hit = 4 + NextRandom(pWorld) % 24;
+                pState->life = (BYTE)(pState->life > hit ? pState->life - hit : 0);
+                if (pState->life == 0)
+                {
+                    pState->mode = MODE_DEATH;
+                    pUnit->timer = 25;
+                }
+            }
+        }
+        else if (pState->type == REPL_UNIT_MISSILE)
+        {
+            StepToward(pUnit, 3);
+            if (--pUnit->timer == 0)
+            {
+                pWorld->removed.push_back(pState->guid);
+                pWorld->units[i] = pWorld->units.back();
+                pWorld->units.pop_back();
+                count--;
+                i--;
+            }
+        }
+        else if (NextRandom(pWorld) % 200 == 0)
+        {
+            pState->flags ^= 1; // Door / chest toggles
+        }
+    }
+
+    // Every player fires a missile now and then
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        if (NextRandom(pWorld) % 2)
+        {
+            continue;
+        }
+        WorldUnit missile = MakeUnit(pWorld, REPL_UNIT_MISSILE, (WORD)(NextRandom(pWorld) % 385));
+        missile.state.x = pWorld->units[p].state.x;
+        missile.state.y = pWorld->units[p].state.y;
+        missile.targetX = missile.state.x + (int)(NextRandom(pWorld) % 81) - 40;
+        missile.targetY = missile.state.y + (int)(NextRandom(pWorld) % 81) - 40;
+        missile.timer = 10 + NextRandom(pWorld) % 15;
+        pWorld->units.push_back(missile);
+    }
+}
+
+static BOOL InView(const ReplUnitState *pViewer, const ReplUnitState *pState, DWORD radius)
+{
+    int dx = (int)pState->x - (int)pViewer->x;
+    int dy = (int)pState->y - (int)pViewer->y;
+    return (DWORD)(dx * dx + dy * dy) <= radius * radius;
+}
+
+// =============================================================================
+// RUNS
+// =============================================================================
+
+typedef struct RunResult
+{
+    uint64_t bytes;
+    uint64_t packets;
+    DWORD maxTickBytes; // Per client
+    double buildUs;     // Per tick, all clients (frames only)
+    double applyUs;
+    ReplClientStats stats; // Summed over clients (maxWaitTicks: worst)
+    DWORD drainTicks;
+    DWORD mismatches;
+    DWORD applyErrors;
+} RunResult;
+
+static double Micros(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Today: a full packet per changed unit in range per client, assign on entry, remove on exit
+static void RunLegacy(DWORD ticks, DWORD monsters, RunResult *pResult)
+{
+    World world;
+    InitWorld(&world, monsters);
+    std::vector<std::unordered_set<DWORD> > visible(PLAYERS);
+    memset(pResult, 0, sizeof(*pResult));
+
+    for (DWORD tick = 0; tick < ticks; tick++)
+    {
+        std::unordered_map<DWORD, ReplUnitState> prior;
+        for (size_t i = 0; i < world.units.size(); i++)
+        {
+            prior[world.units[i].state.guid] = world.units[i].state;
+        }
+        StepWorld(&world);
+
+        for (DWORD p = 0; p < PLAYERS; p++)
+        {
+            const ReplUnitState *pViewer = &world.units[p].state;
+            DWORD tickBytes = 0;
+            std::unordered_set<DWORD> now;
+            for (size_t i = 0; i < world.units.size(); i++)
+            {
+                const ReplUnitState *pState = &world.units[i].state;
+                if (!InView(pViewer, pState, VIEW_RADIUS))
+                {
+                    continue;
+                }
+                now.insert(pState->guid);
+                BOOL entering = !visible[p].count(pState->guid);
+                // Anything the unit did this tick is a packet with all of its fields
+                std::unordered_map<DWORD, ReplUnitState>::const_iterator was = prior.find(pState->guid);
+                BOOL acting = was == prior.end() || memcmp(&was->second, pState, sizeof(*pState)) != 0;
+                if (entering || acting)
+                {
+                    tickBytes += LEGACY_UPDATE_BYTES + LEGACY_PACKET_OVERHEAD;
+                    pResult->packets++;
+                }
+            }
+            for (std::unordered_set<DWORD>::const_iterator it = visible[p].begin(); it != visible[p].end(); ++it)
+            {
+                if (!now.count(*it))
+                {
+                    tickBytes += LEGACY_REMOVE_BYTES + LEGACY_PACKET_OVERHEAD;
+                    pResult->packets++;
+                }
+            }
+            visible[p].swap(now);
+            pResult->bytes += tickBytes;
+            pResult->maxTickBytes = std::max(pResult->maxTickBytes, tickBytes);
+        }
+    }
+}
+
+static void SyncUnits(Replicator *pRepl, World *pWorld)
+{
+    for (size_t i = 0; i < pWorld->removed.size(); i++)
+    {
+        REPL_RemoveUnit(pRepl, pWorld->removed[i]);
+    }
+    for (size_t i = 0; i < pWorld->units.size(); i++)
+    {
+        REPL_SetUnit(pRepl, &pWorld->units[i].state);
+    }
+}
+
+static void RunFrames(DWORD ticks, DWORD monsters, DWORD budget, RunResult *pResult)
+{
+    World world;
+    InitWorld(&world, monsters);
+    memset(pResult, 0, sizeof(*pResult));
+
+    ReplDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.maxClients = PLAYERS;
+    desc.viewRadius = VIEW_RADIUS;
+    desc.bytesPerFrame = budget;
+    Replicator *pRepl = REPL_Create(&desc);
+    ReplClient *pClients[PLAYERS];
+    int ids[PLAYERS];
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        ids[p] = REPL_AddClient(pRepl, world.units[p].state.guid);
+        pClients[p] = REPL_CreateClient();
+    }
+    SyncUnits(pRepl, &world);
+
+    BYTE frame[REPL_MAX_FRAME];
+    double buildUs = 0, applyUs = 0;
+    DWORD quietTicks = 0;
+    // After the run, the world freezes and frames drain until every client is idle
+    for (DWORD tick = 0; tick < ticks + 500 && quietTicks < 2; tick++)
+    {
+        if (tick < ticks)
+        {
+            StepWorld(&world);
+            SyncUnits(pRepl, &world);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        DWORD sizes[PLAYERS];
+        BYTE frames[PLAYERS][REPL_MAX_FRAME];
+        for (DWORD p = 0; p < PLAYERS; p++)
+        {
+            sizes[p] = REPL_BuildFrame(pRepl, ids[p], frames[p], sizeof(frame));
+        }
+        double built = Micros(start);
+
+        start = std::chrono::steady_clock::now();
+        BOOL idle = TRUE;
+        for (DWORD p = 0; p < PLAYERS; p++)
+        {
+            pResult->applyErrors += !REPL_ApplyFrame(pClients[p], frames[p], sizes[p]);
+            idle &= sizes[p] == REPL_FRAME_HEADER + 1; // End marker only
+        }
+        double applied = Micros(start);
+
+        if (tick < ticks)
+        {
+            buildUs += built;
+            applyUs += applied;
+            for (DWORD p = 0; p < PLAYERS; p++)
+            {
+                pResult->bytes += sizes[p];
+                pResult->packets++;
+                pResult->maxTickBytes = std::max(pResult->maxTickBytes, sizes[p]);
+            }
+        }
+        else
+        {
+            pResult->drainTicks++;
+            quietTicks = idle ? quietTicks + 1 : 0;
+        }
+    }
+    pResult->buildUs = buildUs / ticks;
+    pResult->applyUs = applyUs / ticks;
+
+    // Every client holds exactly its view, with the server's state
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        const ReplUnitState *pViewer = &world.units[p].state;
+        DWORD expected = 0;
+        for (size_t i = 0; i < world.units.size(); i++)
+        {
+            const ReplUnitState *pState = &world.units[i].state;
+            ReplUnitState held;
+            BOOL has = REPL_FindClientUnit(pClients[p], pState->guid, &held);
+            if (InView(pViewer, pState, VIEW_RADIUS))
+            {
+                expected++;
+                pResult->mismatches += !has || memcmp(&held, pState, sizeof(held)) != 0;
+            }
+            else if (has)
+            {
+                // Allowed only inside the hysteresis band
+                expected++;
+                pResult->mismatches += InView(pViewer, pState, VIEW_RADIUS + 8) ? 0 : 1;
+            }
+        }
+        pResult->mismatches += REPL_GetClientUnitCount(pClients[p]) != expected;
+
+        ReplClientStats stats;
+        REPL_GetClientStats(pRepl, ids[p], &stats);
+        pResult->stats.creates += stats.creates;
+        pResult->stats.updates += stats.updates;
+        pResult->stats.removes += stats.removes;
+        pResult->stats.deferred += stats.deferred;
+        pResult->stats.maxWaitTicks = std::max(pResult->stats.maxWaitTicks, stats.maxWaitTicks);
+        pResult->stats.visible += stats.visible;
+        REPL_DestroyClient(pClients[p]);
+    }
+    REPL_Destroy(pRepl);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD ticks = (argc > 1) ? (DWORD)atoi(argv[1]) : 750;
+    DWORD monsters = (argc > 2) ? (DWORD)atoi(argv[2]) : 300;
+    static const DWORD s_budgets[] = {REPL_MAX_FRAME, 256, 144};
+    BOOL ok = TRUE;
+
+    RunResult legacy;
+    RunLegacy(ticks, monsters, &legacy);
+    double perClientTick = (double)ticks * PLAYERS;
+
+    printf("%u players, %u monsters, %u objects, missiles; %u ticks (%.0f s), view radius %u\n", PLAYERS, monsters,
+           OBJECTS, ticks, ticks / 25.0, VIEW_RADIUS);
+    printf("  %-14s %9s %9s %10s %8s %9s %11s %9s\n", "per client", "B/tick", "max B", "pkts/tick", "kbit/s",
+           "build us", "deferred", "max wait");
+    printf("  %-14s %9.1f %9u %10.1f %8.1f %9s %11s %9s\n", "packets", legacy.bytes / perClientTick,
+           legacy.maxTickBytes, legacy.packets / perClientTick, legacy.bytes / perClientTick * 25 * 8 / 1000.0, "-",
+           "-", "-");
+
+    for (DWORD b = 0; b < sizeof(s_budgets) / sizeof(s_budgets[0]); b++)
+    {
+        RunResult result;
+        char szLabel[32];
+        RunFrames(ticks, monsters, s_budgets[b], &result);
+        snprintf(szLabel, sizeof(szLabel), "frames %u B", s_budgets[b]);
+        printf("  %-14s %9.1f %9u %10.1f %8.1f %9.1f %11llu %6u tk\n", szLabel, result.bytes / perClientTick,
+               result.maxTickBytes, result.packets / perClientTick, result.bytes / perClientTick * 25 * 8 / 1000.0,
+               result.buildUs, (unsigned long long)result.stats.deferred, result.stats.maxWaitTicks);
+        printf("  %-14s creates %llu, updates %llu, removes %llu; apply %.1f us/tick; drained in %u ticks\n", "",
+               (unsigned long long)result.stats.creates, (unsigned long long)result.stats.updates,
+               (unsigned long long)result.stats.removes, result.applyUs, result.drainTicks);
+        printf("verify:   budget %u: %u state mismatches, %u rejected frames -> %s\n", s_budgets[b], result.mismatches,
+               result.applyErrors, (result.mismatches || result.applyErrors) ? "FAILED" : "ok");
+        ok &= !result.mismatches && !result.applyErrors && result.maxTickBytes <= s_budgets[b];
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,356 @@
+/*
+ * BenchRng.cpp - Splittable random streams vs the shared game SEED
+ *
+ * Throughput: the game's SEED roll (lo * 0x6AC690C5 + hi), RNG_Next one
+ * value at a time and RNG_NextBatch.
+ *
+ * Reproducibility: a wave of kills across several levels, every kill rolling
+ * a drop (item count, quality, base, affixes). With the shared SEED the
+ * drops depend on the order the kills are processed; with one stream per
+ * level / unit / drop they do not. The stream run is repeated in level
+ * order, in reverse with units shuffled, and spread over worker threads;
+ * all three must produce the same drops.
+ *
+ * Verification: batches equal repeated RNG_Next for every length and start
+ * offset, Peek/Seek and copied checkpoints replay exactly, and a chi-square
+ * test over one stream, over the first values of sibling streams and over
+ * RNG_Range stays within bounds.
+ *
+ * Usage: bench_rng [millions of values] [kills per level]
+ */
+
+#include "../Common/Rng.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#define LEVELS 16
+#define WORKERS 4
+#define BATCH 4096
+#define DROP_ROLLS 12
+#define CHI_SAMPLES 1048576
+#define CHI_LIMIT 400.0 // 255 degrees of freedom: mean 255, sd 22.6
+
+// =============================================================================
+// GAME SEED BASELINE
+// =============================================================================
+
+typedef struct LegacySeed
+{
+    DWORD lo;
+    DWORD hi;
+} LegacySeed;
+
+static DWORD LegacyRoll(LegacySeed *pSeed)
+{
+    uint64_t value = (uint64_t)pSeed->lo * 0x6AC690C5u + pSeed->hi;
+    pSeed->lo = (DWORD)value;
+    pSeed->hi = (DWORD)(value >> 32);
+    return pSeed->lo;
+}
+
+// =============================================================================
+// DROPS
+// =============================================================================
+
+typedef struct Drop
+{
+    DWORD rolls[DROP_ROLLS];
+} Drop;
+
+// Item count, then quality / base / affixes per item, as ranges of the roll
+static void RollDrop(RngStream *pStream, Drop *pDrop)
+{
+    DWORD items = RNG_Range(pStream, 4);
+    for (DWORD i = 0; i < DROP_ROLLS; i++)
+    {
+        pDrop->rolls[i] = (i / 3 <= items) ? RNG_Range(pStream, (i % 3 == 0) ? 1024 : (i % 3 == 1) ? 600 : 300) : 0;
+    }
+}
+
+static void LegacyRollDrop(LegacySeed *pSeed, Drop *pDrop)
+{
+    DWORD items = LegacyRoll(pSeed) % 4;
+    for (DWORD i = 0; i < DROP_ROLLS; i++)
+    {
+        pDrop->rolls[i] = (i / 3 <= items) ? LegacyRoll(pSeed) % ((i % 3 == 0) ? 1024 : (i % 3 == 1) ? 600 : 300) : 0;
+    }
+}
+
+typedef struct Kill
+{
+    DWORD level;
+    DWORD unit; // Unit GUID
+} Kill;
+
+// One level's kills from the level stream; drops land in their kill's slot
+static void RunLevel(const RngStream *pGame, DWORD level, const std::vector<Kill> &kills, std::vector<Drop> &drops)
+{
+    RngStream levelStream;
+    RNG_Split(pGame, RNG_DOMAIN_LEVEL, level, &levelStream);
+    for (size_t k = 0; k < kills.size(); k++)
+    {
+        if (kills[k].level != level)
+        {
+            continue;
+        }
+        RngStream unit, drop;
+        RNG_Split(&levelStream, RNG_DOMAIN_UNIT, kills[k].unit, &unit);
+        RNG_Split(&unit, RNG_DOMAIN_DROP, 0, &drop);
+        RollDrop(&drop, &drops[k]);
+    }
+}
+
+static uint64_t DigestDrops(const std::vector<Drop> &drops)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t k = 0; k < drops.size(); k++)
+    {
+        for (DWORD i = 0; i < DROP_ROLLS; i++)
+        {
+            hash = (hash ^ drops[k].rolls[i]) * 0x100000001B3ull;
+        }
+    }
+    return hash;
+}
+
+// =============================================================================
+// CHI-SQUARE
+// =============================================================================
+
+static double ChiSquare(const std::vector<DWORD> &counts, double expected)
+{
+    double chi = 0;
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        double d = counts[i] - expected;
+        chi += d * d / expected;
+    }
+    return chi;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD millions = (argc > 1) ? (DWORD)atoi(argv[1]) : 64;
+    DWORD killsPerLevel = (argc > 2) ? (DWORD)atoi(argv[2]) : 20000;
+    if (millions < 1)
+    {
+        millions = 1;
+    }
+    if (killsPerLevel < 1)
+    {
+        killsPerLevel = 1;
+    }
+    DWORD count = millions * 1000000;
+    const DWORD gameSeed = 0x1CEB00DA;
+
+    // --- Throughput ---
+    std::vector<DWORD> buffer(BATCH);
+    DWORD sink = 0;
+    LegacySeed legacy = {gameSeed, 666};
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (DWORD i = 0; i < count; i++)
+    {
+        sink ^= LegacyRoll(&legacy);
+    }
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    RngStream game;
+    RNG_InitGame(&game, gameSeed);
+    RngStream stream = game;
+    for (DWORD i = 0; i < count; i++)
+    {
+        sink ^= RNG_Next(&stream);
+    }
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    stream = game;
+    for (DWORD done = 0; done < count; done += BATCH)
+    {
+        DWORD n = std::min<DWORD>(BATCH, count - done);
+        RNG_NextBatch(&stream, buffer.data(), n);
+        for (DWORD i = 0; i < n; i++)
+        {
+            sink ^= buffer[i];
+        }
+    }
+    std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+    double legacySeconds = std::chrono::duration<double>(t1 - t0).count();
+    double nextSeconds = std::chrono::duration<double>(t2 - t1).count();
+    double batchSeconds = std::chrono::duration<double>(t3 - t2).count();
+
+    // --- Batch equals sequential, for every length and start offset ---
+    DWORD batchMismatches = 0;
+    for (DWORD offset = 0; offset < 9; offset++)
+    {
+        for (DWORD length = 0; length < 70; length++)
+        {
+            RngStream a = game, b = game;
+            RNG_Seek(&a, offset * 1000003u);
+            RNG_Seek(&b, offset * 1000003u);
+            RNG_NextBatch(&a, buffer.data(), length);
+            for (DWORD i = 0; i < length; i++)
+            {
+                batchMismatches += (buffer[i] != RNG_Next(&b)) ? 1 : 0;
+            }
+            batchMismatches += (a.counter != b.counter) ? 1 : 0;
+
+            RNG_RangeBatch(&a, 37, buffer.data(), length);
+            for (DWORD i = 0; i < length; i++)
+            {
+                batchMismatches += (buffer[i] != RNG_Range(&b, 37)) ? 1 : 0;
+            }
+        }
+    }
+
+    // --- Replay: checkpoints, Peek and Seek ---
+    DWORD replayMismatches = 0;
+    {
+        RngStream live = game;
+        for (DWORD i = 0; i < 12345; i++)
+        {
+            RNG_Next(&live);
+        }
+        RngStream checkpoint = live;
+        std::vector<DWORD> first(1000);
+        for (DWORD i = 0; i < 1000; i++)
+        {
+            first[i] = RNG_Next(&live);
+        }
+        RngStream seeked = game;
+        RNG_Seek(&seeked, 12345);
+        for (DWORD i = 0; i < 1000; i++)
+        {
+            replayMismatches += (RNG_Next(&checkpoint) != first[i]) ? 1 : 0;
+            replayMismatches += (RNG_Peek(&game, 12345 + i) != first[i]) ? 1 : 0;
+            replayMismatches += (RNG_Next(&seeked) != first[i]) ? 1 : 0;
+        }
+    }
+
+    // --- Drops: order and threads must not matter ---
+    std::vector<Kill> kills;
+    for (DWORD level = 0; level < LEVELS; level++)
+    {
+        for (DWORD k = 0; k < killsPerLevel; k++)
+        {
+            Kill kill = {level + 1, 0x1000 + level * 100000 + k};
+            kills.push_back(kill);
+        }
+    }
+    std::vector<Drop> inOrder(kills.size()), reversed(kills.size()), threaded(kills.size());
+
+    t0 = std::chrono::steady_clock::now();
+    for (DWORD level = 1; level <= LEVELS; level++)
+    {
+        RunLevel(&game, level, kills, inOrder);
+    }
+    t1 = std::chrono::steady_clock::now();
+
+    // Reverse level order and shuffle the kills within the list (drops follow their kill)
+    std::vector<size_t> order(kills.size());
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        order[k] = k;
+    }
+    LegacySeed shuffle = {0xD00D, 666};
+    for (size_t k = order.size(); k > 1; k--)
+    {
+        std::swap(order[k - 1], order[LegacyRoll(&shuffle) % k]);
+    }
+    std::vector<Kill> shuffled(kills.size());
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        shuffled[k] = kills[order[k]];
+    }
+    std::vector<Drop> shuffledDrops(kills.size());
+    for (DWORD level = LEVELS; level >= 1; level--)
+    {
+        RunLevel(&game, level, shuffled, shuffledDrops);
+    }
+    for (size_t k = 0; k < order.size(); k++)
+    {
+        reversed[order[k]] = shuffledDrops[k];
+    }
+
+    t2 = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (DWORD w = 0; w < WORKERS; w++)
+    {
+        workers.push_back(std::thread([&, w]() {
+            for (DWORD level = 1 + w; level <= LEVELS; level += WORKERS)
+            {
+                RunLevel(&game, level, kills, threaded);
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++)
+    {
+        workers[w].join();
+    }
+    t3 = std::chrono::steady_clock::now();
+
+    // The shared SEED, in level order and reversed
+    std::vector<Drop> legacyForward(kills.size()), legacyBackward(kills.size());
+    LegacySeed shared = {gameSeed, 666};
+    for (size_t k = 0; k < kills.size(); k++)
+    {
+        LegacyRollDrop(&shared, &legacyForward[k]);
+    }
+    shared.lo = gameSeed;
+    shared.hi = 666;
+    for (size_t k = kills.size(); k-- > 0;)
+    {
+        LegacyRollDrop(&shared, &legacyBackward[k]);
+    }
+
+    uint64_t inOrderDigest = DigestDrops(inOrder), reversedDigest = DigestDrops(reversed);
+    uint64_t threadedDigest = DigestDrops(threaded);
+    BOOL dropsStable = inOrderDigest == reversedDigest && inOrderDigest == threadedDigest;
+    BOOL legacyStable = DigestDrops(legacyForward) == DigestDrops(legacyBackward);
+
+    // --- Distribution ---
+    std::vector<DWORD> buckets(256, 0), siblings(256, 0), ranges(6, 0);
+    stream = game;
+    for (DWORD done = 0; done < CHI_SAMPLES; done += BATCH)
+    {
+        RNG_NextBatch(&stream, buffer.data(), BATCH);
+        for (DWORD i = 0; i < BATCH; i++)
+        {
+            buckets[buffer[i] >> 24]++;
+        }
+    }
+    for (DWORD i = 0; i < CHI_SAMPLES; i++)
+    {
+        RngStream child;
+        RNG_Split(&game, RNG_DOMAIN_UNIT, i, &child);
+        siblings[RNG_Next(&child) >> 24]++;
+        ranges[RNG_Range(&child, 6)]++;
+    }
+    double chiStream = ChiSquare(buckets, CHI_SAMPLES / 256.0);
+    double chiSiblings = ChiSquare(siblings, CHI_SAMPLES / 256.0);
+    double chiRange = ChiSquare(ranges, CHI_SAMPLES / 6.0); // 5 degrees of freedom
+    BOOL distributionOk = chiStream < CHI_LIMIT && chiSiblings < CHI_LIMIT && chiRange < 30.0;
+
+    printf("throughput: %u million values\n", millions);
+    printf("  game seed:   %6.2f ns/value\n", legacySeconds * 1e9 / count);
+    printf("  RNG_Next:    %6.2f ns/value\n", nextSeconds * 1e9 / count);
+    printf("  NextBatch:   %6.2f ns/value (%s)\n", batchSeconds * 1e9 / count, D2_SIMD_SSE2 ? "SSE2" : "scalar");
+    printf("drops:      %u levels x %u kills, %u rolls per drop\n", LEVELS, killsPerLevel, DROP_ROLLS);
+    printf("  streams:     %.2f ms in order, %.2f ms on %u threads; in order %016llx, reversed+shuffled %016llx, "
+           "threaded %016llx\n",
+           std::chrono::duration<double>(t1 - t0).count() * 1e3, std::chrono::duration<double>(t3 - t2).count() * 1e3,
+           WORKERS, (unsigned long long)inOrderDigest, (unsigned long long)reversedDigest,
+           (unsigned long long)threadedDigest);
+    printf("  game seed:   forward and reversed processing %s\n",
+           legacyStable ? "agree" : "give different drops (expected)");
+    printf("chi-square: stream %.1f, sibling streams %.1f (limit %.0f), range(6) %.1f (limit 30)\n", chiStream,
+           chiSiblings, CHI_LIMIT, chiRange);
+    printf("verify:     batch %u mismatches, replay %u mismatches, drops %s, distribution %s -> %s\n", batchMismatches,
+           replayMismatches, dropsStable ? "order-independent" : "ORDER-DEPENDENT", distributionOk ? "ok" : "skewed",
+           (batchMismatches || replayMismatches || !dropsStable || !distributionOk) ? "FAILED" : "ok");
+    printf("(sink %08x)\n", sink);
+
+    return (batchMismatches || replayMismatches || !dropsStable || !distributionOk) ? 1 : 0;
+}
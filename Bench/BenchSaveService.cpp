@@ -0,0 +1,556 @@
+/*
+ * BenchSaveService.cpp - Synchronous saves on the game thread vs SaveService
+ *
+ *   sync:  D2's approach. On an autosave or when a player leaves, the game
+ *          thread serializes the character and writes the .d2s over the old
+ *          file before the tick can continue.
+ *   async: SAVE_Capture on the game thread (dirty sections copied, clean ones
+ *          shared), encoding and durable writes on the service's I/O thread.
+ *
+ * Load: games of 8 players ticking at an accelerated rate. Players pick up
+ * gold and move items every few ticks, autosave often, and now and then
+ * leave (an immediate save) and rejoin.
+ *
+ * Verification:
+ *   - after SAVE_Flush every save on disk is byte-identical to encoding the
+ *     player's current state, and no temp file is left behind;
+ *   - autosaves coalesce (fewer writes than captures) and clean sections are
+ *     shared;
+ *   - SAVE_Destroy writes autosaves that were still waiting out their delay;
+ *   - a write that keeps failing is retried, then reported by SAVE_Flush,
+ *     and the previous save stays loadable; a stale temp file from a crash
+ *     does not affect loading.
+ *
+ * Usage: bench_savesvc [players] [ticks] [directory]
+ */
+
+#include "../Server/SaveService.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define BenchMkdir(szPath) _mkdir(szPath)
+#define BenchRmdir(szPath) _rmdir(szPath)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define BenchMkdir(szPath) mkdir(szPath, 0755)
+#define BenchRmdir(szPath) rmdir(szPath)
+#endif
+
+#define PLAYERS_PER_GAME 8
+#define MAX_ITEMS 1024
+#define MAX_FILE (1 << 20)
+#define TICK_US 2000        // Accelerated 25 Hz
+#define AUTOSAVE_TICKS 25   // Per player, staggered
+#define AUTOSAVE_DELAY_MS 100
+
+static DWORD g_rng = 0x5A7E5EED;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static DWORD Roll(DWORD n)
+{
+    return NextRandom() % n;
+}
+
+// =============================================================================
+// CHARACTERS
+// =============================================================================
+
+typedef struct BenchStat
+{
+    WORD id;
+    BYTE saveBits;
+    BYTE paramBits;
+    int saveAdd;
+} BenchStat;
+
+static const BenchStat s_stats[] = {
+    {0, 8, 0, 32},  {2, 7, 0, 32},   {7, 9, 0, 32},   {16, 9, 0, 0},   {19, 10, 0, 0},  {31, 11, 0, 10},
+    {39, 8, 0, 50}, {41, 8, 0, 50},  {43, 8, 0, 50},  {80, 8, 0, 100}, {93, 7, 0, 20},  {105, 7, 0, 20},
+    {107, 3, 9, 0}, {127, 3, 0, 0},  {188, 3, 16, 0}, {195, 7, 16, 0}, {252, 6, 0, 0},
+};
+
+static const char *s_codes[] = {"hax ", "uap ", "rin ", "hp5 "};
+static const DWORD s_classes[] = {ITEMCLASS_WEAPON, ITEMCLASS_ARMOR, 0, 0};
+
+static DWORD Code(DWORD i)
+{
+    const char *sz = s_codes[i];
+    return (DWORD)(BYTE)sz[0] | ((DWORD)(BYTE)sz[1] << 8) | ((DWORD)(BYTE)sz[2] << 16) | ((DWORD)(BYTE)sz[3] << 24);
+}
+
+static DWORD __cdecl ItemClass(void *pContext, DWORD code)
+{
+    (void)pContext;
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(s_codes); i++)
+    {
+        if (Code(i) == code)
+        {
+            return s_classes[i];
+        }
+    }
+    return ITEMCLASS_UNKNOWN;
+}
+
+static void MakeItem(D2Item *pItem)
+{
+    memset(pItem, 0, sizeof(*pItem));
+    pItem->gfx = 0xFF;
+    pItem->autoAffix = 0xFFFF;
+    pItem->version = 101;
+    pItem->location = (BYTE)Roll(3);
+    pItem->x = (BYTE)Roll(16);
+    pItem->y = (BYTE)Roll(16);
+    pItem->page = (BYTE)Roll(8);
+    DWORD code = Roll(D2_ARRAY_SIZE(s_codes));
+    pItem->code = Code(code);
+    if (code == 3)
+    {
+        pItem->flags = ITEMFLAG_IDENTIFIED | ITEMFLAG_SIMPLE;
+        return;
+    }
+    pItem->flags = ITEMFLAG_IDENTIFIED;
+    pItem->guid = NextRandom();
+    pItem->level = (BYTE)(1 + Roll(99));
+    pItem->quality = (BYTE)(ITEMQUAL_MAGIC + Roll(4));
+    pItem->qualityData[0] = (WORD)Roll(256);
+    pItem->qualityData[1] = (WORD)Roll(256);
+    if (s_classes[code] & ITEMCLASS_ARMOR)
+    {
+        pItem->defense = (WORD)Roll(500);
+    }
+    if (s_classes[code] & (ITEMCLASS_ARMOR | ITEMCLASS_WEAPON))
+    {
+        pItem->maxDurability = (BYTE)(1 + Roll(250));
+        pItem->durability = pItem->maxDurability;
+    }
+    if (pItem->quality == ITEMQUAL_SET)
+    {
+        pItem->setMask = 0;
+    }
+    for (DWORD n = 2 + Roll(8); n; n--)
+    {
+        const BenchStat *pStat = &s_stats[Roll(D2_ARRAY_SIZE(s_stats))];
+        ItemStat *pOut = &pItem->stats[pItem->statCount++];
+        pOut->id = pStat->id;
+        pOut->param = pStat->paramBits ? Roll(1u << pStat->paramBits) : 0;
+        pOut->value = (int)Roll(1u << pStat->saveBits) - pStat->saveAdd;
+    }
+}
+
+typedef struct Player
+{
+    char szName[SAVE_MAX_NAME];
+    D2Character chr;
+    std::vector<D2Item> items;
+    std::vector<D2Item> mercItems;
+    DWORD slot;
+    DWORD dirty; // Since the last async capture
+    BOOL away;
+    DWORD returnTick;
+} Player;
+
+static void MakePlayer(Player *pPlayer, DWORD index)
+{
+    sprintf(pPlayer->szName, "Player%04u", index);
+    D2Character *pChr = &pPlayer->chr;
+    memset(pChr, 0, sizeof(*pChr));
+    pPlayer->items.resize(MAX_ITEMS);
+    pPlayer->mercItems.resize(MAX_ITEMS);
+    pChr->items.pItems = &pPlayer->items[0];
+    pChr->items.capacity = MAX_ITEMS;
+    pChr->mercItems.pItems = &pPlayer->mercItems[0];
+    pChr->mercItems.capacity = MAX_ITEMS;
+
+    DWORD value = D2S_SIGNATURE;
+    memcpy(pChr->header, &value, 4);
+    value = D2S_VERSION;
+    memcpy(pChr->header + 4, &value, 4);
+    strcpy((char *)pChr->header + 20, pPlayer->szName);
+    pChr->header[36] = D2S_STATUS_EXPANSION;
+    pChr->header[40] = (BYTE)Roll(7);
+    pChr->header[43] = (BYTE)(1 + Roll(99));
+    value = 1 + Roll(1000);
+    memcpy(pChr->header + 179, &value, 4);
+    pChr->attributeMask = 0xFFFF;
+    for (DWORD id = 0; id < D2S_ATTRIBUTES; id++)
+    {
+        pChr->attributes[id] = Roll(100);
+    }
+    for (DWORD i = 0; i < D2S_SKILLS; i++)
+    {
+        pChr->skills[i] = (BYTE)Roll(21);
+    }
+    pChr->items.count = 100 + Roll(150);
+    for (DWORD i = 0; i < pChr->items.count; i++)
+    {
+        MakeItem(&pChr->items.pItems[i]);
+    }
+    pChr->mercItems.count = Roll(6);
+    for (DWORD i = 0; i < pChr->mercItems.count; i++)
+    {
+        MakeItem(&pChr->mercItems.pItems[i]);
+    }
+    pPlayer->dirty = SAVE_DIRTY_ALL;
+    pPlayer->away = FALSE;
+}
+
+// One tick of play: gold every few ticks, item moves now and then
+static void Play(Player *pPlayer)
+{
+    D2Character *pChr = &pPlayer->chr;
+    if (Roll(4) == 0)
+    {
+        pChr->attributes[14] = (pChr->attributes[14] + Roll(500)) & 0x1FFFFFF;
+        pPlayer->dirty |= SAVE_DIRTY_CORE;
+    }
+    if (Roll(30) == 0)
+    {
+        D2Item *pItem = &pChr->items.pItems[Roll(pChr->items.count)];
+        pItem->x = (BYTE)Roll(16);
+        pItem->y = (BYTE)Roll(16);
+        pPlayer->dirty |= SAVE_DIRTY_ITEMS;
+    }
+    if (Roll(200) == 0 && pChr->items.count < MAX_ITEMS)
+    {
+        MakeItem(&pChr->items.pItems[pChr->items.count++]);
+        pPlayer->dirty |= SAVE_DIRTY_ITEMS;
+    }
+    if (Roll(500) == 0)
+    {
+        pChr->mercItems.count = Roll(6);
+        for (DWORD i = 0; i < pChr->mercItems.count; i++)
+        {
+            MakeItem(&pChr->mercItems.pItems[i]);
+        }
+        pPlayer->dirty |= SAVE_DIRTY_MERC;
+    }
+}
+
+// =============================================================================
+// SYNC BASELINE
+// =============================================================================
+
+static BOOL SyncSave(const ItemCodec *pCodec, const char *szDirectory, const Player *pPlayer, BYTE *pBuffer)
+{
+    size_t size = 0;
+    if (!D2S_Encode(pCodec, &pPlayer->chr, pBuffer, MAX_FILE, &size))
+    {
+        return FALSE;
+    }
+    char szPath[512];
+    sprintf(szPath, "%s/%s.d2s", szDirectory, pPlayer->szName);
+    FILE *pFile = fopen(szPath, "wb");
+    BOOL ok = pFile && fwrite(pBuffer, 1, size, pFile) == size;
+    if (pFile && fclose(pFile) != 0)
+    {
+        ok = FALSE;
+    }
+    return ok;
+}
+
+// =============================================================================
+// SIMULATION
+// =============================================================================
+
+typedef struct RunResult
+{
+    uint64_t saves;
+    double saveSeconds; // On the game thread
+    double maxSaveUs;
+    double maxTickSaveUs; // Worst total save stall in one tick
+    DWORD errors;
+} RunResult;
+
+static void Simulate(std::vector<Player> &players, DWORD ticks, const ItemCodec *pCodec, SaveService *pService,
+                     const char *szDirectory, RunResult *pResult)
+{
+    std::vector<BYTE> buffer(MAX_FILE);
+    memset(pResult, 0, sizeof(*pResult));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (DWORD tick = 0; tick < ticks; tick++)
+    {
+        double tickSave = 0;
+        for (DWORD p = 0; p < players.size(); p++)
+        {
+            Player *pPlayer = &players[p];
+            if (pPlayer->away)
+            {
+                if (tick >= pPlayer->returnTick)
+                {
+                    pPlayer->away = FALSE;
+                    if (pService)
+                    {
+                        pPlayer->slot = SAVE_Open(pService, pPlayer->szName);
+                        pResult->errors += pPlayer->slot == SAVE_INVALID_SLOT;
+                        pPlayer->dirty = SAVE_DIRTY_ALL;
+                    }
+                }
+                continue;
+            }
+            Play(pPlayer);
+
+            BOOL leaving = Roll(2000) == 0;
+            if (!leaving && (tick + p) % AUTOSAVE_TICKS != 0)
+            {
+                continue;
+            }
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            if (pService)
+            {
+                pResult->errors += !SAVE_Capture(pService, pPlayer->slot, &pPlayer->chr, pPlayer->dirty,
+                                                 leaving ? SAVE_IMMEDIATE : SAVE_AUTOSAVE);
+                pPlayer->dirty = 0;
+                if (leaving)
+                {
+                    SAVE_Close(pService, pPlayer->slot);
+                }
+            }
+            else
+            {
+                pResult->errors += !SyncSave(pCodec, szDirectory, pPlayer, &buffer[0]);
+            }
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+            pResult->saves++;
+            pResult->saveSeconds += us / 1e6;
+            pResult->maxSaveUs = std::max(pResult->maxSaveUs, us);
+            tickSave += us;
+            if (leaving)
+            {
+                pPlayer->away = TRUE;
+                pPlayer->returnTick = tick + 5 + Roll(50);
+            }
+        }
+        pResult->maxTickSaveUs = std::max(pResult->maxTickSaveUs, tickSave);
+
+        // Pace the ticks so autosave delays span a realistic number of them
+        std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)(tick + 1) * TICK_US));
+    }
+}
+
+// Every player's save equals encoding its current state
+static DWORD CheckFiles(SaveService *pService, const ItemCodec *pCodec, std::vector<Player> &players)
+{
+    std::vector<BYTE> expected(MAX_FILE), actual(MAX_FILE);
+    DWORD mismatches = 0;
+    for (DWORD p = 0; p < players.size(); p++)
+    {
+        size_t expectedSize = 0, actualSize = 0;
+        BOOL ok = D2S_Encode(pCodec, &players[p].chr, &expected[0], MAX_FILE, &expectedSize) &&
+                  SAVE_Load(pService, players[p].szName, &actual[0], MAX_FILE, &actualSize) &&
+                  expectedSize == actualSize && memcmp(&expected[0], &actual[0], actualSize) == 0;
+        mismatches += !ok;
+    }
+    return mismatches;
+}
+
+static DWORD CountTempFiles(const char *szDirectory, std::vector<Player> &players)
+{
+    DWORD count = 0;
+    for (DWORD p = 0; p < players.size(); p++)
+    {
+        char szPath[512];
+        sprintf(szPath, "%s/%s.d2s.tmp", szDirectory, players[p].szName);
+        FILE *pFile = fopen(szPath, "rb");
+        if (pFile)
+        {
+            fclose(pFile);
+            count++;
+        }
+    }
+    return count;
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+    DWORD playerCount = (argc > 1) ? (DWORD)atoi(argv[1]) : 64;
+    DWORD ticks = (argc > 2) ? (DWORD)atoi(argv[2]) : 1500;
+    const char *szDirectory = (argc > 3) ? argv[3] : "bench_saves";
+    playerCount = std::max(playerCount, (DWORD)PLAYERS_PER_GAME);
+    BenchMkdir(szDirectory);
+
+    static ItemStatLayout s_layouts[ITEM_STAT_IDS];
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(s_stats); i++)
+    {
+        s_layouts[s_stats[i].id].saveBits = s_stats[i].saveBits;
+        s_layouts[s_stats[i].id].paramBits = s_stats[i].paramBits;
+        s_layouts[s_stats[i].id].saveAdd = s_stats[i].saveAdd;
+    }
+    ItemCodecDesc codecDesc;
+    memset(&codecDesc, 0, sizeof(codecDesc));
+    codecDesc.pStats = s_layouts;
+    codecDesc.pfnItemClass = ItemClass;
+    ItemCodec *pCodec = ITEMCODEC_Create(&codecDesc);
+
+    std::vector<Player> players(playerCount);
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        MakePlayer(&players[p], p);
+    }
+
+    // Sync baseline
+    DWORD rngStart = g_rng;
+    RunResult sync;
+    Simulate(players, ticks, pCodec, NULL, szDirectory, &sync);
+
+    // Async, from the same starting state and random sequence
+    g_rng = rngStart;
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        MakePlayer(&players[p], p);
+    }
+    g_rng = rngStart;
+    SaveServiceDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.pCodec = pCodec;
+    desc.szDirectory = szDirectory;
+    desc.maxItems = MAX_ITEMS;
+    desc.autosaveDelayMs = AUTOSAVE_DELAY_MS;
+    desc.retryDelayMs = 20;
+    SaveService *pService = SAVE_Create(&desc);
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        players[p].slot = SAVE_Open(pService, players[p].szName);
+    }
+    RunResult async;
+    Simulate(players, ticks, pCodec, pService, szDirectory, &async);
+
+    // Everyone still in the game saves on the way out
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        if (players[p].away)
+        {
+            players[p].slot = SAVE_Open(pService, players[p].szName);
+            players[p].away = FALSE;
+            players[p].dirty = SAVE_DIRTY_ALL;
+        }
+        async.errors += !SAVE_Capture(pService, players[p].slot, &players[p].chr, players[p].dirty, SAVE_IMMEDIATE);
+        players[p].dirty = 0;
+    }
+    BOOL flushed = SAVE_Flush(pService);
+    SaveStats stats;
+    SAVE_GetStats(pService, &stats);
+    DWORD mismatches = CheckFiles(pService, pCodec, players);
+    DWORD tempFiles = CountTempFiles(szDirectory, players);
+
+    // A write that keeps failing: a non-empty directory squats on the temp file's name
+    Player *pVictim = &players[0];
+    char szBlocker[512], szInside[600];
+    sprintf(szBlocker, "%s/%s.d2s.tmp", szDirectory, pVictim->szName);
+    sprintf(szInside, "%s/keep", szBlocker);
+    BenchMkdir(szBlocker);
+    FILE *pInside = fopen(szInside, "wb");
+    if (pInside)
+    {
+        fclose(pInside);
+    }
+    pVictim->chr.attributes[14] ^= 1;
+    SAVE_Capture(pService, pVictim->slot, &pVictim->chr, SAVE_DIRTY_CORE, SAVE_IMMEDIATE);
+    BOOL failureReported = !SAVE_Flush(pService);
+    remove(szInside);
+    BenchRmdir(szBlocker);
+    pVictim->chr.attributes[14] ^= 1;
+    DWORD keptOldSave = CheckFiles(pService, pCodec, players) == 0;
+    SaveStats failStats;
+    SAVE_GetStats(pService, &failStats);
+
+    // A torn temp file from a crash is ignored by loading and cleared on open
+    Player *pCrashed = &players[1];
+    sprintf(szBlocker, "%s/%s.d2s.tmp", szDirectory, pCrashed->szName);
+    FILE *pTorn = fopen(szBlocker, "wb");
+    if (pTorn)
+    {
+        fwrite("JM", 1, 2, pTorn);
+        fclose(pTorn);
+    }
+    BOOL tornIgnored = CheckFiles(pService, pCodec, players) == 0;
+    SAVE_Close(pService, pCrashed->slot);
+    pCrashed->slot = SAVE_Open(pService, pCrashed->szName);
+    tornIgnored &= CountTempFiles(szDirectory, players) == 0;
+
+    // Shutdown drains autosaves still waiting out their delay
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        SAVE_Close(pService, players[p].slot);
+    }
+    SAVE_Destroy(pService);
+    desc.autosaveDelayMs = 60000;
+    pService = SAVE_Create(&desc);
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        players[p].slot = SAVE_Open(pService, players[p].szName);
+        Play(&players[p]);
+        players[p].chr.attributes[14] ^= 2;
+        SAVE_Capture(pService, players[p].slot, &players[p].chr, SAVE_DIRTY_ALL, SAVE_AUTOSAVE);
+    }
+    SaveStats drainStats;
+    SAVE_GetStats(pService, &drainStats);
+    SAVE_Destroy(pService);
+    pService = SAVE_Create(&desc);
+    DWORD drainMismatches = CheckFiles(pService, pCodec, players);
+    SAVE_Destroy(pService);
+
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        char szPath[512];
+        sprintf(szPath, "%s/%s.d2s", szDirectory, players[p].szName);
+        remove(szPath);
+    }
+    BenchRmdir(szDirectory);
+
+    double fullBytes = 0;
+    for (DWORD p = 0; p < playerCount; p++)
+    {
+        fullBytes += offsetof(D2Character, items) + players[p].chr.items.count * (double)sizeof(D2Item);
+    }
+    fullBytes /= playerCount;
+
+    printf("players: %u in %u games, %u ticks, autosave every %u ticks\n", playerCount,
+           playerCount / PLAYERS_PER_GAME, ticks, AUTOSAVE_TICKS);
+    printf("  sync:  %8llu saves %8.1f us/save, worst %8.1f us, worst tick stall %8.1f us\n",
+           (unsigned long long)sync.saves, sync.saveSeconds * 1e6 / sync.saves, sync.maxSaveUs, sync.maxTickSaveUs);
+    printf("  async: %8llu saves %8.1f us/save, worst %8.1f us, worst tick stall %8.1f us (%.0fx less per save)\n",
+           (unsigned long long)async.saves, async.saveSeconds * 1e6 / async.saves, async.maxSaveUs,
+           async.maxTickSaveUs, async.saveSeconds > 0 ? sync.saveSeconds / async.saveSeconds : 0.0);
+    printf("  capture: %.0f bytes copied per capture vs %.0f for a full copy; %llu sections copied, %llu shared\n",
+           (double)stats.bytesCopied / stats.captures, fullBytes, (unsigned long long)stats.sectionsCopied,
+           (unsigned long long)stats.sectionsShared);
+    printf("  writes:  %llu for %llu captures (%llu coalesced), %.1f KB average\n", (unsigned long long)stats.written,
+           (unsigned long long)stats.captures, (unsigned long long)stats.coalesced,
+           stats.written ? stats.bytesWritten / 1024.0 / stats.written : 0.0);
+    printf("verify:  files vs state %u mismatches, %u temp files left, flush %s, errors %u/%u -> %s\n", mismatches,
+           tempFiles, flushed ? "ok" : "failed", sync.errors, async.errors,
+           (mismatches || tempFiles || !flushed || sync.errors || async.errors) ? "FAILED" : "ok");
+    printf("verify:  failing write: %llu retries, reported %s, old save kept %s; torn temp file ignored %s -> %s\n",
+           (unsigned long long)(failStats.retries - stats.retries), failureReported ? "yes" : "no",
+           keptOldSave ? "yes" : "no", tornIgnored ? "yes" : "no",
+           (failureReported && keptOldSave && tornIgnored) ? "ok" : "FAILED");
+    printf("verify:  shutdown drained %u pending autosaves, %u mismatches -> %s\n", drainStats.pending,
+           drainMismatches, (drainMismatches || drainStats.pending != playerCount) ? "FAILED" : "ok");
+
+    BOOL ok = !mismatches && !tempFiles && flushed && !sync.errors && !async.errors && failureReported &&
+              keptOldSave && tornIgnored && !drainMismatches && drainStats.pending == playerCount &&
+              stats.coalesced > 0 && stats.sectionsShared > 0;
+    ITEMCODEC_Destroy(pCodec);
+    return ok ? 0 : 1;
+}
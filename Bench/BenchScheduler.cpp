@@ -0,0 +1,408 @@
+/*
+ * BenchScheduler.cpp - Per-unit expiry scans vs the hierarchical timing wheel
+ *
+ *   scan:  D2's approach. Every unit keeps its curses, auras, regen,
+ *          shrine and delayed-event timers as nodes on its own list, and
+ *          every tick walks all units and all nodes to find the due ones.
+ *   wheel: Scheduler with per-type handlers, one TIMERS_Tick per tick.
+ *
+ * Busy phase: 100k pending timers with short curses and events, periodic
+ * regen and auras, long shrine timers, and per-tick churn of adds, cancels
+ * and reschedules. Idle phase: the short timers drain and only long timers
+ * (up to ~2 hours of game time, exercising the upper levels) stay pending,
+ * as in a game where nobody is fighting.
+ *
+ * Verification: every tick the timers fired (type, unit, id) must match the
+ * scan exactly, handlers must see them grouped by type, sampled remaining
+ * times must agree, stale handles must not resolve, and TIMERS_RunFrame must
+ * turn frame times into the right tick counts and bound catch-up.
+ *
+ * Usage: bench_scheduler [timers] [busy ticks] [idle ticks]
+ */
+
+#include "../Common/Scheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define UNITS 20000
+
+// =============================================================================
+// SCAN BASELINE
+// =============================================================================
+
+typedef struct LegacyTimer
+{
+    DWORD type;
+    DWORD id;
+    DWORD expire;
+    DWORD period;
+    BYTE reserved[0x18];
+    struct LegacyTimer *pPrev;
+    struct LegacyTimer *pNext;
+} LegacyTimer;
+
+typedef struct LegacyUnit
+{
+    DWORD unitId;
+    BYTE reserved[0x3C];
+    LegacyTimer *pTimers;
+} LegacyUnit;
+
+typedef struct Fired
+{
+    DWORD type;
+    DWORD unitId;
+    DWORD id;
+} Fired;
+
+static LegacyUnit g_units[UNITS];
+static DWORD g_now;
+
+static void LegacyUnlink(LegacyUnit *pUnit, LegacyTimer *pTimer)
+{
+    if (pTimer->pPrev)
+    {
+        pTimer->pPrev->pNext = pTimer->pNext;
+    }
+    else
+    {
+        pUnit->pTimers = pTimer->pNext;
+    }
+    if (pTimer->pNext)
+    {
+        pTimer->pNext->pPrev = pTimer->pPrev;
+    }
+}
+
+static void LegacyTick(std::vector<Fired> *pFired)
+{
+    g_now++;
+    for (DWORD u = 0; u < UNITS; u++)
+    {
+        LegacyUnit *pUnit = &g_units[u];
+        LegacyTimer *pTimer = pUnit->pTimers;
+        while (pTimer)
+        {
+            LegacyTimer *pNext = pTimer->pNext;
+            if (pTimer->expire == g_now)
+            {
+                Fired fired;
+                fired.type = pTimer->type;
+                fired.unitId = pUnit->unitId;
+                fired.id = pTimer->id;
+                pFired->push_back(fired);
+                if (pTimer->period)
+                {
+                    pTimer->expire = g_now + pTimer->period;
+                }
+                else
+                {
+                    LegacyUnlink(pUnit, pTimer);
+                    free(pTimer);
+                }
+            }
+            pTimer = pNext;
+        }
+    }
+}
+
+// =============================================================================
+// SIMULATION
+// =============================================================================
+
+typedef struct SimTimer
+{
+    LegacyTimer *pLegacy; // NULL once fired or cancelled
+    DWORD unit;
+    TimerHandle handle;
+    DWORD liveIndex;
+} SimTimer;
+
+static std::vector<SimTimer> g_timers; // Indexed by id
+static std::vector<DWORD> g_live;      // Ids of pending timers
+static std::vector<Fired> g_wheelFired;
+static DWORD g_handlerCalls;
+static DWORD g_groupErrors;
+static DWORD g_rng = 0x7133E12;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static void __cdecl CollectHandler(void *pContext, const SchedEvent *pEvents, DWORD count)
+{
+    DWORD type = (DWORD)(size_t)pContext;
+    g_handlerCalls++;
+    for (DWORD i = 0; i < count; i++)
+    {
+        Fired fired;
+        fired.type = pEvents[i].type;
+        fired.unitId = pEvents[i].unitId;
+        fired.id = pEvents[i].param;
+        g_groupErrors += pEvents[i].type != type;
+        g_wheelFired.push_back(fired);
+    }
+}
+
+static void LiveRemove(DWORD id)
+{
+    DWORD index = g_timers[id].liveIndex;
+    g_live[index] = g_live.back();
+    g_timers[g_live[index]].liveIndex = index;
+    g_live.pop_back();
+}
+
+static BOOL AddTimer(Scheduler *pSched, DWORD type, DWORD delay, DWORD period)
+{
+    DWORD id = (DWORD)g_timers.size();
+    DWORD unit = NextRandom() % UNITS;
+    LegacyTimer *pTimer = (LegacyTimer *)calloc(1, sizeof(LegacyTimer));
+    pTimer->type = type;
+    pTimer->id = id;
+    pTimer->expire = g_now + delay;
+    pTimer->period = period;
+    pTimer->pNext = g_units[unit].pTimers;
+    if (pTimer->pNext)
+    {
+        pTimer->pNext->pPrev = pTimer;
+    }
+    g_units[unit].pTimers = pTimer;
+
+    SimTimer sim;
+    sim.pLegacy = pTimer;
+    sim.unit = unit;
+    sim.handle = TIMERS_Add(pSched, type, delay, period, g_units[unit].unitId, id);
+    sim.liveIndex = (DWORD)g_live.size();
+    g_timers.push_back(sim);
+    g_live.push_back(id);
+    return sim.handle != TIMER_INVALID_HANDLE;
+}
+
+static void AddBusyTimer(Scheduler *pSched, BOOL *pOk)
+{
+    DWORD roll = NextRandom() % 100;
+    if (roll < 35)
+    {
+        *pOk &= AddTimer(pSched, TIMERS_TYPE_CURSE, 1 + NextRandom() % 500, 0);
+    }
+    else if (roll < 50)
+    {
+        *pOk &= AddTimer(pSched, TIMERS_TYPE_EVENT, 1 + NextRandom() % 50, 0);
+    }
+    else if (roll < 75)
+    {
+        *pOk &= AddTimer(pSched, TIMERS_TYPE_REGEN, 1 + NextRandom() % 25, 25);
+    }
+    else if (roll < 85)
+    {
+        *pOk &= AddTimer(pSched, TIMERS_TYPE_AURA, 1 + NextRandom() % 100, 100);
+    }
+    else
+    {
+        *pOk &= AddTimer(pSched, TIMERS_TYPE_SHRINE, 1500 + NextRandom() % 6000, 0);
+    }
+}
+
+static void CancelTimer(Scheduler *pSched, DWORD id, DWORD *pStale)
+{
+    SimTimer *pSim = &g_timers[id];
+    LegacyUnlink(&g_units[pSim->unit], pSim->pLegacy);
+    free(pSim->pLegacy);
+    pSim->pLegacy = NULL;
+    LiveRemove(id);
+    *pStale += !TIMERS_Cancel(pSched, pSim->handle);
+    *pStale += TIMERS_IsPending(pSched, pSim->handle) || TIMERS_Cancel(pSched, pSim->handle);
+}
+
+static void Churn(Scheduler *pSched, DWORD target, DWORD *pStale, DWORD *pMismatches)
+{
+    for (DWORD n = 0; n < target / 500 && !g_live.empty(); n++)
+    {
+        CancelTimer(pSched, g_live[NextRandom() % g_live.size()], pStale);
+    }
+    for (DWORD n = 0; n < target / 500 && !g_live.empty(); n++)
+    {
+        // Curse refreshed by a recast
+        SimTimer *pSim = &g_timers[g_live[NextRandom() % g_live.size()]];
+        DWORD delay = 1 + NextRandom() % 500;
+        pSim->pLegacy->expire = g_now + delay;
+        *pMismatches += !TIMERS_Reschedule(pSched, pSim->handle, delay);
+    }
+    for (DWORD n = 0; n < 64 && !g_live.empty(); n++)
+    {
+        SimTimer *pSim = &g_timers[g_live[NextRandom() % g_live.size()]];
+        *pMismatches += TIMERS_GetRemaining(pSched, pSim->handle) != pSim->pLegacy->expire - g_now;
+    }
+}
+
+static bool FiredLess(const Fired &a, const Fired &b)
+{
+    return a.id < b.id;
+}
+
+// Runs one tick on both sides; returns mismatching firings
+static DWORD RunTick(Scheduler *pSched, double *pScanSeconds, double *pWheelSeconds, uint64_t *pFired)
+{
+    std::vector<Fired> scanFired;
+    g_wheelFired.clear();
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    LegacyTick(&scanFired);
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    SchedTickResult result;
+    TIMERS_Tick(pSched, &result);
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+    *pScanSeconds += std::chrono::duration<double>(t1 - t0).count();
+    *pWheelSeconds += std::chrono::duration<double>(t2 - t1).count();
+
+    DWORD mismatches = result.tick != g_now || result.count != g_wheelFired.size();
+    for (DWORD i = 1; i < result.count; i++)
+    {
+        g_groupErrors += result.pEvents[i].type < result.pEvents[i - 1].type;
+    }
+    for (DWORD i = 0; i < result.count; i++)
+    {
+        if (!result.pEvents[i].periodic)
+        {
+            SimTimer *pSim = &g_timers[result.pEvents[i].param];
+            mismatches += TIMERS_IsPending(pSched, pSim->handle);
+            pSim->pLegacy = NULL;
+            LiveRemove(result.pEvents[i].param);
+        }
+    }
+
+    std::sort(scanFired.begin(), scanFired.end(), FiredLess);
+    std::sort(g_wheelFired.begin(), g_wheelFired.end(), FiredLess);
+    if (scanFired.size() != g_wheelFired.size())
+    {
+        return mismatches + 1;
+    }
+    for (size_t i = 0; i < scanFired.size(); i++)
+    {
+        mismatches += scanFired[i].id != g_wheelFired[i].id || scanFired[i].type != g_wheelFired[i].type ||
+                      scanFired[i].unitId != g_wheelFired[i].unitId;
+    }
+    *pFired += scanFired.size();
+    return mismatches;
+}
+
+// TIMERS_RunFrame: ~60 fps frames, then a 2 s stall
+static BOOL CheckRunFrame(void)
+{
+    SchedulerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.capacity = 16;
+    Scheduler *pSched = TIMERS_Create(&desc);
+    DWORD fired = 0;
+    TIMERS_Add(pSched, TIMERS_TYPE_REGEN, 25, 25, 0, 0);
+
+    DWORD ms = 0, ticks = 0;
+    for (DWORD frame = 0; frame < 3000; frame++)
+    {
+        DWORD elapsed = (frame % 3 == 2) ? 16 : 17;
+        ms += elapsed;
+        ticks += TIMERS_RunFrame(pSched, elapsed);
+    }
+    BOOL ok = ticks == ms / 40 && TIMERS_GetTick(pSched) == ticks;
+
+    SchedulerStats stats;
+    TIMERS_GetStats(pSched, &stats);
+    fired = (DWORD)stats.fired;
+    ok &= fired == ticks / 25;
+    ok &= TIMERS_RunFrame(pSched, 2000) == 10;
+    TIMERS_Destroy(pSched);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD target = (argc > 1) ? (DWORD)atoi(argv[1]) : 100000;
+    DWORD busyTicks = (argc > 2) ? (DWORD)atoi(argv[2]) : 2000;
+    DWORD idleTicks = (argc > 3) ? (DWORD)atoi(argv[3]) : 1000;
+    BOOL ok = TRUE;
+
+    SchedulerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.capacity = target + target / 4;
+    Scheduler *pSched = TIMERS_Create(&desc);
+    for (DWORD type = 0; type <= TIMERS_TYPE_EVENT; type++)
+    {
+        ok &= TIMERS_SetHandler(pSched, type, CollectHandler, (void *)(size_t)type);
+    }
+    for (DWORD u = 0; u < UNITS; u++)
+    {
+        g_units[u].unitId = NextRandom();
+    }
+
+    DWORD mismatches = 0, stale = 0;
+    double busyScan = 0, busyWheel = 0, idleScan = 0, idleWheel = 0;
+    uint64_t busyFired = 0, idleFired = 0;
+
+    for (DWORD tick = 0; tick < busyTicks; tick++)
+    {
+        while (g_live.size() < target)
+        {
+            AddBusyTimer(pSched, &ok);
+        }
+        Churn(pSched, target, &stale, &mismatches);
+        mismatches += RunTick(pSched, &busyScan, &busyWheel, &busyFired);
+    }
+
+    // Idle: drop everything short, refill with long timers only
+    while (!g_live.empty())
+    {
+        CancelTimer(pSched, g_live.back(), &stale);
+    }
+    while (g_live.size() < target)
+    {
+        DWORD type = (NextRandom() & 1) ? TIMERS_TYPE_SHRINE : TIMERS_TYPE_EVENT;
+        ok &= AddTimer(pSched, type, 1000 + NextRandom() % 180000, 0);
+    }
+    SchedulerStats before;
+    TIMERS_GetStats(pSched, &before);
+    for (DWORD tick = 0; tick < idleTicks; tick++)
+    {
+        mismatches += RunTick(pSched, &idleScan, &idleWheel, &idleFired);
+    }
+
+    SchedulerStats stats;
+    TIMERS_GetStats(pSched, &stats);
+    BOOL frameOk = CheckRunFrame();
+
+    printf("timers:  %u pending over %u units\n", stats.pending, UNITS);
+    printf("  busy:  %u ticks, %.1f fired per tick\n", busyTicks, (double)busyFired / busyTicks);
+    printf("    scan:  %8.1f us/tick\n", busyScan * 1e6 / busyTicks);
+    printf("    wheel: %8.1f us/tick (%.1fx)\n", busyWheel * 1e6 / busyTicks,
+           busyWheel > 0 ? busyScan / busyWheel : 0.0);
+    printf("  idle:  %u ticks, %.2f fired and %.1f cascaded per tick\n", idleTicks, (double)idleFired / idleTicks,
+           (double)(stats.cascaded - before.cascaded) / idleTicks);
+    printf("    scan:  %8.1f us/tick\n", idleScan * 1e6 / idleTicks);
+    printf("    wheel: %8.2f us/tick (%.0fx)\n", idleWheel * 1e6 / idleTicks,
+           idleWheel > 0 ? idleScan / idleWheel : 0.0);
+    printf("verify:  firings vs scan: %u mismatches, grouping %u errors, %u handler calls -> %s\n", mismatches,
+           g_groupErrors, g_handlerCalls, (mismatches || g_groupErrors) ? "FAILED" : "ok");
+    printf("verify:  stale handles %u resolved, RunFrame pacing %s -> %s\n", stale, frameOk ? "ok" : "wrong",
+           (stale || !frameOk) ? "FAILED" : "ok");
+    ok &= !mismatches && !g_groupErrors && !stale && frameOk && stats.pending == g_live.size();
+
+    for (DWORD u = 0; u < UNITS; u++)
+    {
+        while (g_units[u].pTimers)
+        {
+            LegacyTimer *pNext = g_units[u].pTimers->pNext;
+            free(g_units[u].pTimers);
+            g_units[u].pTimers = pNext;
+        }
+    }
+    TIMERS_Destroy(pSched);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,607 @@
+/*
+ * BenchSkillEngine.cpp - Per-object missile and effect updates vs SkillEngine
+ *
+ *   legacy: D2's layout. Every missile is a ~0xF4 byte record on one linked
+ *           list, updated through its type's handler pointer; every unit
+ *           keeps a linked list of skill nodes, and each tick walks all of
+ *           them to find the timed effects that just ran out.
+ *   engine: SKILLENG_Tick with per-type pools (SSE2) and the timing wheel,
+ *           plus a second engine forced scalar.
+ *
+ * All three get the same commands every tick: spawns keeping a few thousand
+ * missiles in the air across many missile types, random hits removing
+ * missiles, effects started, refreshed and removed (some outlasting the
+ * wheel), skill levels, cooldowns and unit deaths. Every tick the ended
+ * missiles (owner, reason, final position) and ended effects must match the
+ * legacy run exactly, the scalar engine must report the same events in the
+ * same order as the SIMD one, and CanActivateSkill / effect queries must
+ * agree. Live missile positions are compared in full every 50 ticks.
+ *
+ * Usage: bench_skillengine [missiles] [ticks] [units]
+ */
+
+#include "../Common/SkillEngine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define MISSILE_TYPES 48
+#define SKILLS 40
+#define FULL_CHECK_INTERVAL 50
+
+static MissileTypeDesc g_types[MISSILE_TYPES];
+
+// =============================================================================
+// LEGACY BASELINE
+// =============================================================================
+
+typedef struct LegacyMissile LegacyMissile;
+typedef BOOL (*LegacyMissileFn)(LegacyMissile *pMissile);
+
+struct LegacyMissile
+{
+    DWORD dwType;
+    DWORD dwClassId;
+    void *pMemPool;
+    DWORD dwOwner;
+    BYTE reserved[0x30];
+    float x;
+    float y;
+    float vx;
+    float vy;
+    BYTE reserved2[0x28];
+    float speed;
+    float rangeLeft;
+    int lifeLeft;
+    LegacyMissileFn pfnUpdate;
+    BYTE reserved3[0x40];
+    LegacyMissile *pPrev;
+    LegacyMissile *pNext;
+};
+
+// Same arithmetic as the engine; several copies so the calls stay indirect
+static BOOL LegacyUpdateBolt(LegacyMissile *pMissile)
+{
+    pMissile->x += pMissile->vx;
+    pMissile->y += pMissile->vy;
+    pMissile->rangeLeft -= pMissile->speed;
+    pMissile->lifeLeft -= 1;
+    return pMissile->rangeLeft <= 0.0f || pMissile->lifeLeft <= 0;
+}
+
+static BOOL LegacyUpdateShard(LegacyMissile *pMissile)
+{
+    pMissile->x += pMissile->vx;
+    pMissile->y += pMissile->vy;
+    pMissile->rangeLeft -= pMissile->speed;
+    pMissile->lifeLeft -= 1;
+    return pMissile->rangeLeft <= 0.0f || pMissile->lifeLeft <= 0;
+}
+
+static BOOL LegacyUpdateArrow(LegacyMissile *pMissile)
+{
+    pMissile->x += pMissile->vx;
+    pMissile->y += pMissile->vy;
+    pMissile->rangeLeft -= pMissile->speed;
+    pMissile->lifeLeft -= 1;
+    return pMissile->rangeLeft <= 0.0f || pMissile->lifeLeft <= 0;
+}
+
+static const LegacyMissileFn g_handlers[3] = {LegacyUpdateBolt, LegacyUpdateShard, LegacyUpdateArrow};
+
+typedef struct LegacySkill
+{
+    DWORD skillId;
+    DWORD level;
+    DWORD cooldownEnd;
+    DWORD effectEnd; // 0 = no effect
+    BYTE reserved[0x30];
+    struct LegacySkill *pNext;
+} LegacySkill;
+
+typedef struct LegacyUnit
+{
+    DWORD unitId;
+    LegacySkill *pSkills;
+} LegacyUnit;
+
+static LegacyMissile *g_missiles;
+static std::vector<LegacyUnit> g_units;
+static DWORD g_legacyTick;
+static uint64_t g_legacyScanned;
+
+typedef struct EndedMissile
+{
+    DWORD owner;
+    DWORD reason;
+    float x;
+    float y;
+} EndedMissile;
+
+static void LegacyUnlinkMissile(LegacyMissile *pMissile)
+{
+    if (pMissile->pPrev)
+    {
+        pMissile->pPrev->pNext = pMissile->pNext;
+    }
+    else
+    {
+        g_missiles = pMissile->pNext;
+    }
+    if (pMissile->pNext)
+    {
+        pMissile->pNext->pPrev = pMissile->pPrev;
+    }
+}
+
+static LegacySkill *LegacyFind(LegacyUnit *pUnit, DWORD skillId)
+{
+    for (LegacySkill *pSkill = pUnit->pSkills; pSkill; pSkill = pSkill->pNext)
+    {
+        if (pSkill->skillId == skillId)
+        {
+            return pSkill;
+        }
+    }
+    return NULL;
+}
+
+static LegacySkill *LegacyFindOrAdd(LegacyUnit *pUnit, DWORD skillId)
+{
+    LegacySkill *pSkill = LegacyFind(pUnit, skillId);
+    if (!pSkill)
+    {
+        pSkill = (LegacySkill *)calloc(1, sizeof(LegacySkill));
+        pSkill->skillId = skillId;
+        pSkill->cooldownEnd = g_legacyTick;
+        pSkill->pNext = pUnit->pSkills;
+        pUnit->pSkills = pSkill;
+    }
+    return pSkill;
+}
+
+static void LegacyDropIfEmpty(LegacyUnit *pUnit, LegacySkill *pSkill)
+{
+    if (pSkill->level || pSkill->effectEnd)
+    {
+        return;
+    }
+    LegacySkill **ppLink = &pUnit->pSkills;
+    while (*ppLink != pSkill)
+    {
+        ppLink = &(*ppLink)->pNext;
+    }
+    *ppLink = pSkill->pNext;
+    free(pSkill);
+}
+
+static void LegacyTick(std::vector<EndedMissile> *pMissileEnds, std::vector<EffectEvent> *pEffectEnds)
+{
+    LegacyMissile *pMissile = g_missiles;
+    while (pMissile)
+    {
+        LegacyMissile *pNext = pMissile->pNext;
+        if (pMissile->pfnUpdate(pMissile))
+        {
+            EndedMissile ended;
+            ended.owner = pMissile->dwOwner;
+            ended.reason = pMissile->rangeLeft <= 0.0f ? MISSILE_END_RANGE : MISSILE_END_LIFETIME;
+            ended.x = pMissile->x;
+            ended.y = pMissile->y;
+            pMissileEnds->push_back(ended);
+            LegacyUnlinkMissile(pMissile);
+            free(pMissile);
+        }
+        pMissile = pNext;
+    }
+
+    g_legacyTick++;
+    for (size_t u = 0; u < g_units.size(); u++)
+    {
+        LegacyUnit *pUnit = &g_units[u];
+        LegacySkill *pSkill = pUnit->pSkills;
+        while (pSkill)
+        {
+            LegacySkill *pNext = pSkill->pNext;
+            g_legacyScanned++;
+            if (pSkill->effectEnd == g_legacyTick)
+            {
+                EffectEvent ended;
+                ended.unitId = pUnit->unitId;
+                ended.skillId = pSkill->skillId;
+                pEffectEnds->push_back(ended);
+                pSkill->effectEnd = 0;
+                LegacyDropIfEmpty(pUnit, pSkill);
+            }
+            pSkill = pNext;
+        }
+    }
+}
+
+// =============================================================================
+// SIMULATION
+// =============================================================================
+
+typedef struct SimMissile
+{
+    LegacyMissile *pLegacy; // Freed by LegacyTick before the engine's events remove it here
+    DWORD owner;
+    MissileHandle simd;
+    MissileHandle scalar;
+} SimMissile;
+
+static std::vector<SimMissile> g_live;
+static std::vector<DWORD> g_liveIndex; // owner -> index in g_live
+static DWORD g_rng = 0x5EED5EED;
+static DWORD g_nextOwner;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static float RandomFloat(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(NextRandom() & 0xFFFFFF) / 16777216.0f;
+}
+
+static void LiveRemove(DWORD owner)
+{
+    DWORD index = g_liveIndex[owner];
+    g_live[index] = g_live.back();
+    g_liveIndex[g_live[index].owner] = index;
+    g_live.pop_back();
+}
+
+static BOOL Spawn(SkillEngine *pSimd, SkillEngine *pScalar)
+{
+    DWORD type = NextRandom() % MISSILE_TYPES;
+    DWORD owner = g_nextOwner++;
+    float x = RandomFloat(0.0f, 2000.0f);
+    float y = RandomFloat(0.0f, 2000.0f);
+    float tx = x + RandomFloat(-50.0f, 50.0f);
+    float ty = y + RandomFloat(-50.0f, 50.0f);
+
+    LegacyMissile *pMissile = (LegacyMissile *)calloc(1, sizeof(LegacyMissile));
+    float dx = tx - x;
+    float dy = ty - y;
+    float len = sqrtf(dx * dx + dy * dy);
+    float scale = len > 0.0f ? g_types[type].speed / len : 0.0f;
+    pMissile->dwType = type;
+    pMissile->dwOwner = owner;
+    pMissile->x = x;
+    pMissile->y = y;
+    pMissile->vx = dx * scale;
+    pMissile->vy = dy * scale;
+    pMissile->speed = g_types[type].speed;
+    pMissile->rangeLeft = g_types[type].range;
+    pMissile->lifeLeft = (int)g_types[type].lifetime;
+    pMissile->pfnUpdate = g_handlers[type % 3];
+    pMissile->pNext = g_missiles;
+    if (g_missiles)
+    {
+        g_missiles->pPrev = pMissile;
+    }
+    g_missiles = pMissile;
+
+    SimMissile sim;
+    sim.pLegacy = pMissile;
+    sim.owner = owner;
+    sim.simd = SKILLENG_SpawnMissile(pSimd, type, owner, x, y, tx, ty);
+    sim.scalar = SKILLENG_SpawnMissile(pScalar, type, owner, x, y, tx, ty);
+    g_liveIndex.push_back((DWORD)g_live.size());
+    g_live.push_back(sim);
+    return sim.simd != MISSILE_INVALID_HANDLE && sim.scalar != MISSILE_INVALID_HANDLE;
+}
+
+static void Hit(SkillEngine *pSimd, SkillEngine *pScalar, DWORD *pStaleResolved)
+{
+    SimMissile sim = g_live[NextRandom() % g_live.size()];
+    LegacyUnlinkMissile(sim.pLegacy);
+    LiveRemove(sim.owner);
+    free(sim.pLegacy);
+    SKILLENG_RemoveMissile(pSimd, sim.simd);
+    SKILLENG_RemoveMissile(pScalar, sim.scalar);
+    *pStaleResolved += SKILLENG_IsMissileAlive(pSimd, sim.simd) || SKILLENG_RemoveMissile(pScalar, sim.scalar);
+}
+
+// Same skill command to all three; returns mismatching query answers
+static DWORD SkillCommand(SkillEngine *pSimd, SkillEngine *pScalar, BOOL *pOk)
+{
+    LegacyUnit *pUnit = &g_units[NextRandom() % g_units.size()];
+    DWORD skillId = NextRandom() % SKILLS;
+    DWORD roll = NextRandom() % 100;
+    DWORD mismatches = 0;
+
+    if (roll < 50)
+    {
+        // Mostly short buffs and curses, some longer than the wheel
+        DWORD duration = (roll < 5) ? 600 + NextRandom() % 1500 : 1 + NextRandom() % 250;
+        LegacyFindOrAdd(pUnit, skillId)->effectEnd = g_legacyTick + duration;
+        *pOk &= SKILLENG_SetTimedEffect(pSimd, pUnit->unitId, skillId, duration);
+        *pOk &= SKILLENG_SetTimedEffect(pScalar, pUnit->unitId, skillId, duration);
+    }
+    else if (roll < 58)
+    {
+        LegacySkill *pSkill = LegacyFind(pUnit, skillId);
+        if (pSkill && pSkill->effectEnd)
+        {
+            pSkill->effectEnd = 0;
+            LegacyDropIfEmpty(pUnit, pSkill);
+        }
+        SKILLENG_SetTimedEffect(pSimd, pUnit->unitId, skillId, 0);
+        SKILLENG_SetTimedEffect(pScalar, pUnit->unitId, skillId, 0);
+    }
+    else if (roll < 75)
+    {
+        DWORD level = (NextRandom() % 4) ? 1 + NextRandom() % 20 : 0;
+        LegacySkill *pSkill = level ? LegacyFindOrAdd(pUnit, skillId) : LegacyFind(pUnit, skillId);
+        if (pSkill)
+        {
+            pSkill->level = level;
+            LegacyDropIfEmpty(pUnit, pSkill);
+        }
+        *pOk &= SKILLENG_SetSkillLevel(pSimd, pUnit->unitId, skillId, level);
+        *pOk &= SKILLENG_SetSkillLevel(pScalar, pUnit->unitId, skillId, level);
+    }
+    else if (roll < 85)
+    {
+        DWORD ticks = NextRandom() % 50;
+        LegacySkill *pSkill = LegacyFind(pUnit, skillId);
+        BOOL legacy = pSkill && pSkill->level;
+        if (legacy)
+        {
+            pSkill->cooldownEnd = g_legacyTick + ticks;
+        }
+        mismatches += SKILLENG_StartCooldown(pSimd, pUnit->unitId, skillId, ticks) != legacy;
+        mismatches += SKILLENG_StartCooldown(pScalar, pUnit->unitId, skillId, ticks) != legacy;
+    }
+    else if (roll < 99)
+    {
+        LegacySkill *pSkill = LegacyFind(pUnit, skillId);
+        BOOL canActivate = pSkill && pSkill->level && (int)(pSkill->cooldownEnd - g_legacyTick) <= 0;
+        DWORD remaining = (pSkill && pSkill->effectEnd) ? pSkill->effectEnd - g_legacyTick : 0;
+        DWORD level = pSkill ? pSkill->level : 0;
+        mismatches += SKILLENG_CanActivateSkill(pSimd, pUnit->unitId, skillId) != canActivate;
+        mismatches += SKILLENG_GetEffectRemaining(pSimd, pUnit->unitId, skillId) != remaining;
+        mismatches += SKILLENG_GetSkillLevel(pScalar, pUnit->unitId, skillId) != level;
+    }
+    else
+    {
+        // Death: the unit comes back under a new GUID
+        while (pUnit->pSkills)
+        {
+            LegacySkill *pNext = pUnit->pSkills->pNext;
+            free(pUnit->pSkills);
+            pUnit->pSkills = pNext;
+        }
+        SKILLENG_RemoveUnit(pSimd, pUnit->unitId);
+        SKILLENG_RemoveUnit(pScalar, pUnit->unitId);
+        pUnit->unitId = NextRandom();
+    }
+    return mismatches;
+}
+
+static BOOL SameEvents(const SkillTickResult *pA, const SkillTickResult *pB)
+{
+    return pA->missileEnds == pB->missileEnds && pA->effectEnds == pB->effectEnds &&
+           !memcmp(pA->pMissileEnds, pB->pMissileEnds, pA->missileEnds * sizeof(MissileEvent)) &&
+           !memcmp(pA->pEffectEnds, pB->pEffectEnds, pA->effectEnds * sizeof(EffectEvent));
+}
+
+static bool OwnerLess(const EndedMissile &a, const EndedMissile &b)
+{
+    return a.owner < b.owner;
+}
+
+static bool EffectLess(const EffectEvent &a, const EffectEvent &b)
+{
+    return a.unitId != b.unitId ? a.unitId < b.unitId : a.skillId < b.skillId;
+}
+
+static DWORD CompareEvents(const SkillTickResult *pResult, std::vector<EndedMissile> *pMissileEnds,
+                           std::vector<EffectEvent> *pEffectEnds)
+{
+    std::vector<EndedMissile> missiles;
+    for (DWORD i = 0; i < pResult->missileEnds; i++)
+    {
+        EndedMissile ended;
+        ended.owner = pResult->pMissileEnds[i].owner;
+        ended.reason = pResult->pMissileEnds[i].reason;
+        ended.x = pResult->pMissileEnds[i].x;
+        ended.y = pResult->pMissileEnds[i].y;
+        missiles.push_back(ended);
+    }
+    std::vector<EffectEvent> effects(pResult->pEffectEnds, pResult->pEffectEnds + pResult->effectEnds);
+    std::sort(missiles.begin(), missiles.end(), OwnerLess);
+    std::sort(pMissileEnds->begin(), pMissileEnds->end(), OwnerLess);
+    std::sort(effects.begin(), effects.end(), EffectLess);
+    std::sort(pEffectEnds->begin(), pEffectEnds->end(), EffectLess);
+
+    DWORD mismatches = 0;
+    if (missiles.size() != pMissileEnds->size() || effects.size() != pEffectEnds->size())
+    {
+        return 1;
+    }
+    for (size_t i = 0; i < missiles.size(); i++)
+    {
+        const EndedMissile &a = missiles[i];
+        const EndedMissile &b = (*pMissileEnds)[i];
+        mismatches += a.owner != b.owner || a.reason != b.reason || a.x != b.x || a.y != b.y;
+    }
+    for (size_t i = 0; i < effects.size(); i++)
+    {
+        mismatches += effects[i].unitId != (*pEffectEnds)[i].unitId || effects[i].skillId != (*pEffectEnds)[i].skillId;
+    }
+    return mismatches;
+}
+
+static DWORD CompareLive(SkillEngine *pEngine)
+{
+    DWORD mismatches = 0, seen = 0;
+    for (DWORD t = 0; t < MISSILE_TYPES; t++)
+    {
+        MissilePoolView view;
+        SKILLENG_GetMissilePool(pEngine, t, &view);
+        for (DWORD i = 0; i < view.count; i++)
+        {
+            const LegacyMissile *pMissile = g_live[g_liveIndex[view.owner[i]]].pLegacy;
+            mismatches += pMissile->dwType != t || pMissile->x != view.x[i] || pMissile->y != view.y[i] ||
+                          pMissile->rangeLeft != view.rangeLeft[i] || pMissile->lifeLeft != view.lifeLeft[i];
+        }
+        seen += view.count;
+    }
+    return mismatches + (seen != g_live.size());
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    DWORD target = (argc > 1) ? (DWORD)atoi(argv[1]) : 8000;
+    DWORD ticks = (argc > 2) ? (DWORD)atoi(argv[2]) : 1000;
+    DWORD unitCount = (argc > 3) ? (DWORD)atoi(argv[3]) : 2000;
+    BOOL ok = TRUE;
+
+    // Speeds 0.25-2 subtiles/tick; some types range-limited, some lifetime-limited, some both
+    for (DWORD t = 0; t < MISSILE_TYPES; t++)
+    {
+        g_types[t].speed = 0.25f * (float)(1 + t % 8);
+        g_types[t].range = (t % 3 != 1) ? 10.0f + (float)(t * 7 % 60) : 0.0f;
+        g_types[t].lifetime = (t % 3 != 0) ? 20 + t * 13 % 100 : 0;
+    }
+
+    SkillEngineDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.missileTypes = MISSILE_TYPES;
+    desc.missileCapacity = target * 2;
+    desc.entryCapacity = unitCount * SKILLS;
+    SkillEngine *pSimd = SKILLENG_Create(&desc);
+    desc.forceScalar = TRUE;
+    SkillEngine *pScalar = SKILLENG_Create(&desc);
+
+    for (DWORD t = 0; t < MISSILE_TYPES; t++)
+    {
+        // The legacy records use the engine's stand-ins for unlimited
+        MissileTypeDesc typeDesc = g_types[t];
+        ok &= SKILLENG_SetMissileType(pSimd, t, &typeDesc);
+        ok &= SKILLENG_SetMissileType(pScalar, t, &typeDesc);
+        g_types[t].range = typeDesc.range > 0.0f ? typeDesc.range : FLT_MAX;
+        g_types[t].lifetime = typeDesc.lifetime ? typeDesc.lifetime : INT_MAX;
+    }
+
+    g_units.resize(unitCount);
+    for (DWORD u = 0; u < unitCount; u++)
+    {
+        g_units[u].unitId = NextRandom();
+        g_units[u].pSkills = NULL;
+    }
+
+    double legacySeconds = 0, simdSeconds = 0, scalarSeconds = 0;
+    DWORD eventMismatches = 0, orderMismatches = 0, queryMismatches = 0, liveMismatches = 0, staleResolved = 0;
+    uint64_t missileTicks = 0, missileEnds = 0, effectEnds = 0;
+    std::vector<EndedMissile> legacyMissileEnds;
+    std::vector<EffectEvent> legacyEffectEnds;
+
+    for (DWORD tick = 0; tick < ticks; tick++)
+    {
+        while (g_live.size() < target)
+        {
+            ok &= Spawn(pSimd, pScalar);
+        }
+        for (DWORD n = 0; n < target / 100; n++)
+        {
+            Hit(pSimd, pScalar, &staleResolved);
+        }
+        for (DWORD n = 0; n < unitCount / 4; n++)
+        {
+            queryMismatches += SkillCommand(pSimd, pScalar, &ok);
+        }
+
+        legacyMissileEnds.clear();
+        legacyEffectEnds.clear();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        LegacyTick(&legacyMissileEnds, &legacyEffectEnds);
+        legacySeconds += Seconds(start);
+
+        SkillTickResult simd, scalar;
+        start = std::chrono::steady_clock::now();
+        SKILLENG_Tick(pSimd, &simd);
+        simdSeconds += Seconds(start);
+
+        start = std::chrono::steady_clock::now();
+        SKILLENG_Tick(pScalar, &scalar);
+        scalarSeconds += Seconds(start);
+
+        missileTicks += simd.missilesMoved;
+        missileEnds += simd.missileEnds;
+        effectEnds += simd.effectEnds;
+        orderMismatches += !SameEvents(&simd, &scalar);
+        eventMismatches += CompareEvents(&simd, &legacyMissileEnds, &legacyEffectEnds);
+        for (DWORD i = 0; i < simd.missileEnds; i++)
+        {
+            staleResolved += SKILLENG_IsMissileAlive(pSimd, simd.pMissileEnds[i].handle);
+            LiveRemove(simd.pMissileEnds[i].owner);
+        }
+
+        if ((tick + 1) % FULL_CHECK_INTERVAL == 0)
+        {
+            liveMismatches += CompareLive(pSimd) + CompareLive(pScalar);
+        }
+    }
+
+    SkillEngineStats stats;
+    SKILLENG_GetStats(pSimd, &stats);
+    double legacyUs = legacySeconds * 1e6 / ticks;
+    double simdUs = simdSeconds * 1e6 / ticks;
+    double scalarUs = scalarSeconds * 1e6 / ticks;
+    printf("missiles: %.0f in flight over %u types, %u ticks, %.1f ended per tick\n", (double)missileTicks / ticks,
+           MISSILE_TYPES, ticks, (double)missileEnds / ticks);
+    printf("effects:  %u units, %u active, %.1f ended per tick\n", unitCount, stats.effects,
+           (double)effectEnds / ticks);
+    printf("  legacy: %8.1f us/tick (handler per missile, %.0f skill nodes scanned per tick)\n", legacyUs,
+           (double)g_legacyScanned / ticks);
+    printf("  scalar: %8.1f us/tick (%.2fx)\n", scalarUs, scalarUs > 0 ? legacyUs / scalarUs : 0.0);
+    printf("  engine: %8.1f us/tick (%.2fx, %s, %.1f wheel entries visited per tick)\n", simdUs,
+           simdUs > 0 ? legacyUs / simdUs : 0.0, D2_SIMD_SSE2 ? "SSE2" : "scalar",
+           (double)stats.wheelVisits / ticks);
+    printf("verify:   events vs legacy: %u mismatches, scalar vs SIMD: %u ticks differ -> %s\n", eventMismatches,
+           orderMismatches, (eventMismatches || orderMismatches) ? "FAILED" : "ok");
+    printf("verify:   queries %u mismatches, live state %u mismatches, stale handles %u resolved -> %s\n",
+           queryMismatches, liveMismatches, staleResolved,
+           (queryMismatches || liveMismatches || staleResolved) ? "FAILED" : "ok");
+    ok &= !eventMismatches && !orderMismatches && !queryMismatches && !liveMismatches && !staleResolved;
+    ok &= stats.missiles == g_live.size();
+
+    while (g_missiles)
+    {
+        LegacyMissile *pNext = g_missiles->pNext;
+        free(g_missiles);
+        g_missiles = pNext;
+    }
+    for (size_t u = 0; u < g_units.size(); u++)
+    {
+        while (g_units[u].pSkills)
+        {
+            LegacySkill *pNext = g_units[u].pSkills->pNext;
+            free(g_units[u].pSkills);
+            g_units[u].pSkills = pNext;
+        }
+    }
+    SKILLENG_Destroy(pSimd);
+    SKILLENG_Destroy(pScalar);
+    return ok ? 0 : 1;
+}
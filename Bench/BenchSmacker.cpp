@@ -0,0 +1,1412 @@
+/*
+ * BenchSmacker.cpp - Smacker decoding and cinematic playback frame rate
+ *
+ * The cinematics themselves are not redistributable, so the bench encodes
+ * its own: a 640x480 SMK4 file at 24 frames a second that exercises every
+ * part of the format - full blocks in all three SMK4 modes (a plasma, and
+ * pixel-doubled areas), two-colour blocks (stripes), solid and skipped
+ * blocks (boxes moving over a still background), palette records using
+ * all three commands, and two Huffman-DPCM audio tracks (16-bit stereo
+ * and 8-bit mono).
+ *
+ *   1. Verification:
+ *      - every frame's picture, palette and audio decode to exactly what
+ *        was encoded;
+ *      - scalar and SSE2 kernels give identical output;
+ *      - played at its own size the picture is the palette lookup of the
+ *        source, pixel for pixel;
+ *      - single-threaded scalar playback and threaded SSE2 playback give
+ *        identical frames at several output sizes and depths;
+ *      - the audio tracks come out of the player's mixer streams sample
+ *        for sample;
+ *      - truncated files and frame tables that run past the end of the
+ *        file are refused at open; a big tree with no room left for its
+ *        unused escapes and randomly corrupted copies (bit flips and
+ *        overwritten runs, over the tables and over the frames) decode
+ *        and play without faulting.
+ *   2. Frame rate: the whole file played as fast as it converts, at the
+ *      menu resolution and at 720p/1080p, on one thread (as SmackW32
+ *      does it) and threaded, scalar and SSE2.
+ *
+ * Usage: bench_smacker [plays per measurement] [corrupted copies]
+ */
+
+#include "../Video/SmackPlayer.hpp"
+#include "../Video/VideoKernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <queue>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define VIDEO_WIDTH 640
+#define VIDEO_HEIGHT 480
+#define VIDEO_FRAMES 120
+#define VIDEO_FPS 24
+#define AUDIO_RATE 22050
+#define PALETTE_EVERY 4 // Frames between palette records
+
+#define TREE_MMAP 0
+#define TREE_MCLR 1
+#define TREE_FULL 2
+#define TREE_TYPE 3
+#define TREE_COUNT 4
+
+static const WORD s_blockRuns[64] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+    17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+    33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48,
+    49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 128, 256, 512, 1024, 2048,
+};
+
+// =============================================================================
+// CONTENT
+// =============================================================================
+
+static BYTE g_sine[256];
+static BYTE g_basePalette[256][3]; // 6-bit components
+static std::vector<int16_t> g_music;  // Track 0, interleaved stereo
+static std::vector<BYTE> g_speech;    // Track 1, 8-bit mono
+
+static void InitContent()
+{
+    for (DWORD i = 0; i < 256; i++)
+    {
+        g_sine[i] = (BYTE)(84.0 + 84.0 * sin(i * 6.283185307 / 256.0));
+    }
+    for (DWORD i = 0; i < 256; i++)
+    {
+        DWORD h = D2_HashDword(i * 7919u);
+        g_basePalette[i][0] = (BYTE)((i < 128) ? (g_sine[(i * 2) & 255] >> 2) : (h & 63));
+        g_basePalette[i][1] = (BYTE)((i < 128) ? (g_sine[(i * 2 + 85) & 255] >> 2) : ((h >> 8) & 63));
+        g_basePalette[i][2] = (BYTE)((i < 128) ? (g_sine[(i * 2 + 170) & 255] >> 2) : ((h >> 16) & 63));
+    }
+
+    DWORD frames = (DWORD)((uint64_t)VIDEO_FRAMES * AUDIO_RATE / VIDEO_FPS);
+    g_music.resize((size_t)frames * 2);
+    g_speech.resize(frames);
+    for (DWORD n = 0; n < frames; n++)
+    {
+        double t = (double)n / AUDIO_RATE;
+        for (DWORD c = 0; c < 2; c++)
+        {
+            double v = 9000.0 * sin(6.283185307 * (220.0 + 110.0 * c) * t) +
+                       3000.0 * sin(6.283185307 * 1375.0 * t * (1.0 + t / 8.0));
+            g_music[n * 2 + c] = (int16_t)((int)v + (int)(D2_HashDword(n * 2 + c) & 511) - 256);
+        }
+        g_speech[n] = (BYTE)(128 + (int)(60.0 * sin(6.283185307 * 330.0 * t)) + (int)(D2_HashDword(~n) & 15) - 8);
+    }
+}
+
+static DWORD AudioStart(DWORD frame)
+{
+    return (DWORD)((uint64_t)frame * AUDIO_RATE / VIDEO_FPS);
+}
+
+// Entries 0-127 rotate by one with every palette record; 128-255 never change
+static void FramePalette(DWORD frame, BYTE (*pPalette)[3])
+{
+    DWORD rotation = frame / PALETTE_EVERY;
+    for (DWORD i = 0; i < 256; i++)
+    {
+        DWORD from = (i < 128) ? (i + rotation) % 128 : i;
+        memcpy(pPalette[i], g_basePalette[from], 3);
+    }
+}
+
+/*
+ * FramePicture
+ *   top left:     plasma over palette entries 0-127 (full blocks)
+ *   top right:    two-colour stripes (mono blocks)
+ *   bottom left:  tiles under moving boxes (solid and skipped blocks; the
+ *                 box moving 2 pixels a frame also makes mono blocks)
+ *   bottom right: an animated picture at half resolution both ways (full
+ *                 mode 1) and half height (full mode 2)
+ */
+static void FramePicture(DWORD frame, BYTE *pOut)
+{
+    for (DWORD y = 0; y < VIDEO_HEIGHT; y++)
+    {
+        BYTE *pRow = pOut + (size_t)y * VIDEO_WIDTH;
+        for (DWORD x = 0; x < VIDEO_WIDTH; x++)
+        {
+            BYTE v;
+            if (y < 240 && x < 320)
+            {
+                DWORD sum = g_sine[(x * 2 + frame * 3) & 255] + g_sine[(y * 3 + 256 - (frame * 2 & 255)) & 255] +
+                            g_sine[(x + y + frame * 5) & 255];
+                v = (BYTE)((sum >> 2) & 127);
+            }
+            else if (y < 240)
+            {
+                DWORD bx = x / 4;
+                DWORD by = y / 4;
+                BOOL on = ((x + 2 * y + frame) >> 1) & 1;
+                v = on ? (BYTE)(144 + ((bx * 3 + by + frame / 8) & 15)) : (BYTE)(128 + ((bx + by) & 15));
+            }
+            else if (x < 320)
+            {
+                v = (BYTE)(160 + (((x / 16) * 7 + (y / 16) * 3) & 15));
+                for (DWORD box = 0; box < 3; box++)
+                {
+                    DWORD speed = (box == 2) ? 2 : 4 * (box + 1);
+                    DWORD bx = (frame * speed + box * 90) % (320 - 32);
+                    DWORD by = 252 + box * 72;
+                    if (x >= bx && x < bx + 32 && y >= by && y < by + 24)
+                    {
+                        v = (BYTE)(176 + box);
+                    }
+                }
+            }
+            else if (y < 360)
+            {
+                DWORD sx = x / 2;
+                DWORD sy = y / 2;
+                v = (BYTE)(192 + (((sx * 5 + sy * 11 + frame * 3) ^ (sx * sy)) & 31));
+            }
+            else
+            {
+                DWORD sy = y / 2;
+                v = (BYTE)(224 + (((x * 3 + sy * 7 + frame) ^ (x >> 2)) & 31));
+            }
+            pRow[x] = v;
+        }
+    }
+}
+
+// =============================================================================
+// ENCODER
+// =============================================================================
+
+typedef struct BitWriter
+{
+    std::vector<BYTE> bytes;
+    uint64_t cache;
+    DWORD count;
+} BitWriter;
+
+static void InitWriter(BitWriter *pWriter)
+{
+    pWriter->bytes.clear();
+    pWriter->cache = 0;
+    pWriter->count = 0;
+}
+
+// bits <= 32, LSB first
+static void PutBits(BitWriter *pWriter, DWORD value, DWORD bits)
+{
+    pWriter->cache |= (uint64_t)value << pWriter->count;
+    pWriter->count += bits;
+    while (pWriter->count >= 8)
+    {
+        pWriter->bytes.push_back((BYTE)pWriter->cache);
+        pWriter->cache >>= 8;
+        pWriter->count -= 8;
+    }
+}
+
+static void FlushBits(BitWriter *pWriter)
+{
+    if (pWriter->count > 0)
+    {
+        PutBits(pWriter, 0, 8 - pWriter->count);
+    }
+}
+
+typedef struct HuffNode
+{
+    int left; // -1 = leaf
+    int right;
+    DWORD value;
+} HuffNode;
+
+typedef struct HuffCode
+{
+    uint64_t bits; // Path from the root, first branch in bit 0
+    DWORD length;
+} HuffCode;
+
+typedef struct Huffman
+{
+    std::vector<HuffNode> nodes;
+    int root;
+    std::vector<HuffCode> codes; // By value
+} Huffman;
+
+static void AssignCodes(Huffman *pHuff, int node, uint64_t bits, DWORD length)
+{
+    const HuffNode *pNode = &pHuff->nodes[node];
+    if (pNode->left < 0)
+    {
+        pHuff->codes[pNode->value].bits = bits;
+        pHuff->codes[pNode->value].length = length;
+        return;
+    }
+    AssignCodes(pHuff, pNode->left, bits, length + 1);
+    AssignCodes(pHuff, pNode->right, bits | (1ull << length), length + 1);
+}
+
+// A tree over every value with a non-zero count; a lone value gets an empty code
+static void BuildHuffman(Huffman *pHuff, const uint64_t *pCounts, DWORD values)
+{
+    typedef std::pair<uint64_t, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    pHuff->nodes.clear();
+    pHuff->codes.assign(values, HuffCode());
+    for (DWORD v = 0; v < values; v++)
+    {
+        if (pCounts[v])
+        {
+            HuffNode leaf = {-1, -1, v};
+            queue.push(Entry(pCounts[v], (int)pHuff->nodes.size()));
+            pHuff->nodes.push_back(leaf);
+        }
+    }
+    if (pHuff->nodes.empty())
+    {
+        HuffNode leaf = {-1, -1, 0};
+        pHuff->nodes.push_back(leaf);
+    }
+
+    while (queue.size() > 1)
+    {
+        Entry a = queue.top();
+        queue.pop();
+        Entry b = queue.top();
+        queue.pop();
+        HuffNode node = {a.second, b.second, 0};
+        queue.push(Entry(a.first + b.first, (int)pHuff->nodes.size()));
+        pHuff->nodes.push_back(node);
+    }
+    pHuff->root = (int)pHuff->nodes.size() - 1;
+    AssignCodes(pHuff, pHuff->root, 0, 0);
+}
+
+static void PutCode(BitWriter *pWriter, const Huffman *pHuff, DWORD value)
+{
+    HuffCode code = pHuff->codes[value];
+    while (code.length > 32)
+    {
+        PutBits(pWriter, (DWORD)code.bits, 32);
+        code.bits >>= 32;
+        code.length -= 32;
+    }
+    PutBits(pWriter, (DWORD)code.bits, code.length);
+}
+
+static void PutByteTree(BitWriter *pWriter, const Huffman *pHuff, int node)
+{
+    const HuffNode *pNode = &pHuff->nodes[node];
+    if (pNode->left < 0)
+    {
+        PutBits(pWriter, 0, 1);
+        PutBits(pWriter, pNode->value, 8);
+        return;
+    }
+    PutBits(pWriter, 1, 1);
+    PutByteTree(pWriter, pHuff, pNode->left);
+    PutByteTree(pWriter, pHuff, pNode->right);
+}
+
+// One video tree: value counts and, once built, its codes
+typedef struct TreeEncoder
+{
+    std::vector<uint64_t> literals; // Counts by value
+    uint64_t escapeUses[3];
+    DWORD escapes[3];
+    DWORD recent[3];
+    BOOL used;
+    Huffman big;
+    Huffman low;
+    Huffman high;
+} TreeEncoder;
+
+typedef struct VideoEncoder
+{
+    TreeEncoder trees[TREE_COUNT];
+    BitWriter *pWriter; // NULL while counting
+} VideoEncoder;
+
+// A recent value is sent as its escape leaf, otherwise the value's own leaf
+static void PutValue(VideoEncoder *pEncoder, DWORD tree, DWORD value)
+{
+    TreeEncoder *pTree = &pEncoder->trees[tree];
+    int recent = -1;
+    for (int i = 2; i >= 0; i--)
+    {
+        if (value == pTree->recent[i])
+        {
+            recent = i;
+        }
+    }
+
+    if (!pEncoder->pWriter)
+    {
+        pTree->used = TRUE;
+        if (recent >= 0)
+        {
+            pTree->escapeUses[recent]++;
+        }
+        else
+        {
+            pTree->literals[value]++;
+        }
+    }
+    else
+    {
+        PutCode(pEncoder->pWriter, &pTree->big, (recent >= 0) ? pTree->escapes[recent] : value);
+    }
+
+    if (value != pTree->recent[0])
+    {
+        pTree->recent[2] = pTree->recent[1];
+        pTree->recent[1] = pTree->recent[0];
+        pTree->recent[0] = value;
+    }
+}
+
+static void PutRawBits(VideoEncoder *pEncoder, DWORD value, DWORD bits)
+{
+    if (pEncoder->pWriter)
+    {
+        PutBits(pEncoder->pWriter, value, bits);
+    }
+}
+
+#define KIND_MONO 0
+#define KIND_FULL 1
+#define KIND_SKIP 2
+#define KIND_FILL 3
+
+// Block kind as a TYPE value without the run: type | mode << 2 (full) | colour << 8 (fill)
+static DWORD ClassifyBlock(const BYTE *pPrev, const BYTE *pCur, DWORD block)
+{
+    DWORD columns = VIDEO_WIDTH / 4;
+    size_t origin = (size_t)(block / columns) * 4 * VIDEO_WIDTH + (block % columns) * 4;
+    BYTE p[4][4];
+    BOOL same = TRUE;
+
+    for (DWORD r = 0; r < 4; r++)
+    {
+        memcpy(p[r], pCur + origin + r * VIDEO_WIDTH, 4);
+        same = same && memcmp(p[r], pPrev + origin + r * VIDEO_WIDTH, 4) == 0;
+    }
+    if (same)
+    {
+        return KIND_SKIP;
+    }
+
+    BYTE first = p[0][0];
+    int second = -1;
+    BOOL two = TRUE;
+    for (DWORD i = 0; i < 16 && two; i++)
+    {
+        BYTE v = p[i / 4][i % 4];
+        if (v != first && second < 0)
+        {
+            second = v;
+        }
+        two = v == first || v == second;
+    }
+    if (second < 0)
+    {
+        return KIND_FILL | ((DWORD)first << 8);
+    }
+    if (two)
+    {
+        return KIND_MONO;
+    }
+
+    BOOL rowsDoubled = memcmp(p[0], p[1], 4) == 0 && memcmp(p[2], p[3], 4) == 0;
+    BOOL pixelsDoubled = p[0][0] == p[0][1] && p[0][2] == p[0][3] && p[2][0] == p[2][1] && p[2][2] == p[2][3];
+    if (rowsDoubled && pixelsDoubled)
+    {
+        return KIND_FULL | (1 << 2);
+    }
+    return KIND_FULL | ((rowsDoubled ? 2 : 0) << 2);
+}
+
+static void PutBlock(VideoEncoder *pEncoder, const BYTE *pCur, DWORD block, DWORD kind)
+{
+    DWORD columns = VIDEO_WIDTH / 4;
+    const BYTE *p = pCur + (size_t)(block / columns) * 4 * VIDEO_WIDTH + (block % columns) * 4;
+    const DWORD w = VIDEO_WIDTH;
+
+    if ((kind & 3) == KIND_MONO)
+    {
+        BYTE low = p[0];
+        BYTE high = low;
+        DWORD map = 0;
+        for (DWORD i = 0; i < 16; i++)
+        {
+            BYTE v = p[(i / 4) * w + i % 4];
+            if (v != low)
+            {
+                high = v;
+                map |= 1u << i;
+            }
+        }
+        PutValue(pEncoder, TREE_MCLR, low | ((DWORD)high << 8));
+        PutValue(pEncoder, TREE_MMAP, map);
+        return;
+    }
+
+    DWORD mode = (kind >> 2) & 3;
+    if (mode == 0)
+    {
+        for (DWORD r = 0; r < 4; r++)
+        {
+            PutValue(pEncoder, TREE_FULL, p[r * w + 2] | (p[r * w + 3] << 8));
+            PutValue(pEncoder, TREE_FULL, p[r * w] | (p[r * w + 1] << 8));
+        }
+    }
+    else if (mode == 1)
+    {
+        PutValue(pEncoder, TREE_FULL, p[0] | (p[2] << 8));
+        PutValue(pEncoder, TREE_FULL, p[2 * w] | (p[2 * w + 2] << 8));
+    }
+    else
+    {
+        for (DWORD r = 0; r < 4; r += 2)
+        {
+            PutValue(pEncoder, TREE_FULL, p[r * w + 2] | (p[r * w + 3] << 8));
+            PutValue(pEncoder, TREE_FULL, p[r * w] | (p[r * w + 1] << 8));
+        }
+    }
+}
+
+// Counts (pWriter NULL) or writes one frame's block stream
+static void EncodeVideo(VideoEncoder *pEncoder, const BYTE *pPrev, const BYTE *pCur)
+{
+    DWORD blocks = (VIDEO_WIDTH / 4) * (VIDEO_HEIGHT / 4);
+    std::vector<DWORD> kinds(blocks);
+
+    for (DWORD t = 0; t < TREE_COUNT; t++)
+    {
+        memset(pEncoder->trees[t].recent, 0, sizeof(pEncoder->trees[t].recent));
+    }
+    for (DWORD b = 0; b < blocks; b++)
+    {
+        kinds[b] = ClassifyBlock(pPrev, pCur, b);
+    }
+
+    DWORD block = 0;
+    while (block < blocks)
+    {
+        DWORD kind = kinds[block];
+        DWORD run = 1;
+        while (block + run < blocks && kinds[block + run] == kind)
+        {
+            run++;
+        }
+
+        // Longest run length the table has that fits
+        DWORD index = 63;
+        while (s_blockRuns[index] > run)
+        {
+            index--;
+        }
+        run = s_blockRuns[index];
+
+        DWORD type = (kind & 3) | (index << 2) | ((kind & 3) == KIND_FILL ? (kind & 0xFF00) : 0);
+        PutValue(pEncoder, TREE_TYPE, type);
+        if ((kind & 3) == KIND_FULL)
+        {
+            DWORD mode = (kind >> 2) & 3;
+            if (mode == 1)
+            {
+                PutRawBits(pEncoder, 1, 1);
+            }
+            else
+            {
+                PutRawBits(pEncoder, mode == 2 ? 2 : 0, 2);
+            }
+        }
+        if ((kind & 3) == KIND_MONO || (kind & 3) == KIND_FULL)
+        {
+            for (DWORD i = 0; i < run; i++)
+            {
+                PutBlock(pEncoder, pCur, block + i, kind);
+            }
+        }
+        block += run;
+    }
+}
+
+static void BuildVideoTree(TreeEncoder *pTree)
+{
+    // Escapes: three values that never occur as literals
+    DWORD found = 0;
+    for (DWORD v = 0xFFFF; found < 3; v--)
+    {
+        if (!pTree->literals[v])
+        {
+            pTree->escapes[found++] = v;
+        }
+    }
+
+    std::vector<uint64_t> counts(pTree->literals);
+    for (DWORD i = 0; i < 3; i++)
+    {
+        counts[pTree->escapes[i]] = pTree->escapeUses[i] + 1;
+    }
+    BuildHuffman(&pTree->big, &counts[0], 0x10000);
+
+    uint64_t lows[256] = {0};
+    uint64_t highs[256] = {0};
+    for (size_t i = 0; i < pTree->big.nodes.size(); i++)
+    {
+        if (pTree->big.nodes[i].left < 0)
+        {
+            lows[pTree->big.nodes[i].value & 0xFF]++;
+            highs[pTree->big.nodes[i].value >> 8]++;
+        }
+    }
+    BuildHuffman(&pTree->low, lows, 256);
+    BuildHuffman(&pTree->high, highs, 256);
+}
+
+static void PutBigTree(BitWriter *pWriter, const TreeEncoder *pTree, int node)
+{
+    const HuffNode *pNode = &pTree->big.nodes[node];
+    if (pNode->left < 0)
+    {
+        PutBits(pWriter, 0, 1);
+        PutCode(pWriter, &pTree->low, pNode->value & 0xFF);
+        PutCode(pWriter, &pTree->high, pNode->value >> 8);
+        return;
+    }
+    PutBits(pWriter, 1, 1);
+    PutBigTree(pWriter, pTree, pNode->left);
+    PutBigTree(pWriter, pTree, pNode->right);
+}
+
+static void PutVideoTree(BitWriter *pWriter, const TreeEncoder *pTree)
+{
+    if (!pTree->used)
+    {
+        PutBits(pWriter, 0, 1);
+        return;
+    }
+
+    PutBits(pWriter, 1, 1);
+    PutBits(pWriter, 1, 1);
+    PutByteTree(pWriter, &pTree->low, pTree->low.root);
+    PutBits(pWriter, 0, 1);
+    PutBits(pWriter, 1, 1);
+    PutByteTree(pWriter, &pTree->high, pTree->high.root);
+    PutBits(pWriter, 0, 1);
+    for (DWORD i = 0; i < 3; i++)
+    {
+        PutBits(pWriter, pTree->escapes[i], 16);
+    }
+    PutBigTree(pWriter, pTree, pTree->big.root);
+    PutBits(pWriter, 0, 1);
+}
+
+static void PutLE32(std::vector<BYTE> *pOut, DWORD value)
+{
+    for (DWORD i = 0; i < 4; i++)
+    {
+        pOut->push_back((BYTE)(value >> (i * 8)));
+    }
+}
+
+/*
+ * PutAudioChunk
+ * Huffman DPCM: per-chunk byte trees for the deltas (one per channel, two
+ * for 16-bit), the first sample of each channel as is, then the deltas.
+ */
+static void PutAudioChunk(std::vector<BYTE> *pOut, const DWORD *pRaw, DWORD samples, DWORD stereo, DWORD wide)
+{
+    DWORD channels = stereo + 1;
+    DWORD treeCount = 1u << (wide + stereo);
+    DWORD mask = wide ? 0xFFFF : 0xFF;
+    std::vector<uint64_t> counts((size_t)treeCount * 256);
+    Huffman trees[4];
+
+    for (DWORD i = channels; i < samples; i++)
+    {
+        DWORD c = i & stereo;
+        DWORD delta = (pRaw[i] - pRaw[i - channels]) & mask;
+        if (wide)
+        {
+            counts[(2 * c) * 256 + (delta & 0xFF)]++;
+            counts[(2 * c + 1) * 256 + (delta >> 8)]++;
+        }
+        else
+        {
+            counts[c * 256 + delta]++;
+        }
+    }
+
+    BitWriter writer;
+    InitWriter(&writer);
+    PutBits(&writer, 1, 1);
+    PutBits(&writer, stereo, 1);
+    PutBits(&writer, wide, 1);
+    for (DWORD t = 0; t < treeCount; t++)
+    {
+        BuildHuffman(&trees[t], &counts[(size_t)t * 256], 256);
+        PutBits(&writer, 0, 1);
+        PutByteTree(&writer, &trees[t], trees[t].root);
+        PutBits(&writer, 0, 1);
+    }
+    for (int c = (int)stereo; c >= 0; c--)
+    {
+        DWORD first = pRaw[c];
+        PutBits(&writer, wide ? (((first & 0xFF) << 8) | (first >> 8)) : first, wide ? 16 : 8);
+    }
+    for (DWORD i = channels; i < samples; i++)
+    {
+        DWORD c = i & stereo;
+        DWORD delta = (pRaw[i] - pRaw[i - channels]) & mask;
+        if (wide)
+        {
+            PutCode(&writer, &trees[2 * c], delta & 0xFF);
+            PutCode(&writer, &trees[2 * c + 1], delta >> 8);
+        }
+        else
+        {
+            PutCode(&writer, &trees[c], delta);
+        }
+    }
+    FlushBits(&writer);
+
+    PutLE32(pOut, 8 + (DWORD)writer.bytes.size());
+    PutLE32(pOut, samples * (wide ? 2 : 1));
+    pOut->insert(pOut->end(), writer.bytes.begin(), writer.bytes.end());
+}
+
+/*
+ * PutPalette
+ * Frame 0 sends all 256 entries; later records rotate entries 0-127 by
+ * one, using copies from the previous palette, one new entry and a skip.
+ */
+static void PutPalette(std::vector<BYTE> *pOut, DWORD frame)
+{
+    std::vector<BYTE> record;
+    BYTE palette[256][3];
+    FramePalette(frame, palette);
+
+    if (frame == 0)
+    {
+        for (DWORD i = 0; i < 256; i++)
+        {
+            record.insert(record.end(), palette[i], palette[i] + 3);
+        }
+    }
+    else
+    {
+        BYTE commands[] = {0x40 | 63, 1, 0x40 | 62, 65, palette[127][0], palette[127][1], palette[127][2], 0x80 | 127};
+        record.insert(record.end(), commands, commands + sizeof(commands));
+    }
+
+    DWORD size = (1 + (DWORD)record.size() + 3) & ~3u;
+    record.resize(size - 1, 0);
+    pOut->push_back((BYTE)(size / 4));
+    pOut->insert(pOut->end(), record.begin(), record.end());
+}
+
+static void EncodeFile(std::vector<BYTE> *pFile)
+{
+    VideoEncoder encoder;
+    std::vector<BYTE> previous((size_t)VIDEO_WIDTH * VIDEO_HEIGHT, 0);
+    std::vector<BYTE> current(previous.size());
+
+    for (DWORD t = 0; t < TREE_COUNT; t++)
+    {
+        encoder.trees[t].literals.assign(0x10000, 0);
+        memset(encoder.trees[t].escapeUses, 0, sizeof(encoder.trees[t].escapeUses));
+        encoder.trees[t].used = FALSE;
+    }
+
+    // Pass 1: value counts for the trees
+    encoder.pWriter = NULL;
+    for (DWORD f = 0; f < VIDEO_FRAMES; f++)
+    {
+        FramePicture(f, &current[0]);
+        EncodeVideo(&encoder, &previous[0], &current[0]);
+        previous.swap(current);
+    }
+
+    BitWriter treeBits;
+    InitWriter(&treeBits);
+    DWORD treeSizes[TREE_COUNT];
+    for (DWORD t = 0; t < TREE_COUNT; t++)
+    {
+        if (encoder.trees[t].used)
+        {
+            BuildVideoTree(&encoder.trees[t]);
+        }
+        treeSizes[t] = encoder.trees[t].used ? (DWORD)encoder.trees[t].big.nodes.size() * 4 : 0;
+        PutVideoTree(&treeBits, &encoder.trees[t]);
+    }
+    FlushBits(&treeBits);
+
+    // Pass 2: frames
+    std::vector<std::vector<BYTE>> frames(VIDEO_FRAMES);
+    std::vector<BYTE> types(VIDEO_FRAMES);
+    DWORD largestChunk[2] = {0, 0};
+    BitWriter videoBits;
+    encoder.pWriter = &videoBits;
+    std::fill(previous.begin(), previous.end(), 0);
+
+    for (DWORD f = 0; f < VIDEO_FRAMES; f++)
+    {
+        std::vector<BYTE> *pFrame = &frames[f];
+        types[f] = 0x06; // Both audio tracks
+        if (f % PALETTE_EVERY == 0)
+        {
+            types[f] |= 0x01;
+            PutPalette(pFrame, f);
+        }
+
+        DWORD start = AudioStart(f);
+        DWORD count = AudioStart(f + 1) - start;
+        std::vector<DWORD> raw((size_t)count * 2);
+        for (DWORD i = 0; i < count * 2; i++)
+        {
+            raw[i] = (WORD)g_music[(size_t)start * 2 + i];
+        }
+        size_t before = pFrame->size();
+        PutAudioChunk(pFrame, &raw[0], count * 2, 1, 1);
+        largestChunk[0] = std::max(largestChunk[0], (DWORD)(pFrame->size() - before));
+
+        for (DWORD i = 0; i < count; i++)
+        {
+            raw[i] = g_speech[start + i];
+        }
+        before = pFrame->size();
+        PutAudioChunk(pFrame, &raw[0], count, 0, 0);
+        largestChunk[1] = std::max(largestChunk[1], (DWORD)(pFrame->size() - before));
+
+        FramePicture(f, &current[0]);
+        InitWriter(&videoBits);
+        EncodeVideo(&encoder, &previous[0], &current[0]);
+        FlushBits(&videoBits);
+        pFrame->insert(pFrame->end(), videoBits.bytes.begin(), videoBits.bytes.end());
+        pFrame->resize((pFrame->size() + 3) & ~(size_t)3, 0);
+        previous.swap(current);
+    }
+
+    // Header
+    std::vector<BYTE> *pOut = pFile;
+    pOut->clear();
+    const char *szSignature = "SMK4";
+    pOut->insert(pOut->end(), szSignature, szSignature + 4);
+    PutLE32(pOut, VIDEO_WIDTH);
+    PutLE32(pOut, VIDEO_HEIGHT);
+    PutLE32(pOut, VIDEO_FRAMES);
+    PutLE32(pOut, (DWORD)-(int32_t)(100000 / VIDEO_FPS)); // Units of 10 us
+    PutLE32(pOut, 0);
+    for (DWORD i = 0; i < SMACKER_MAX_TRACKS; i++)
+    {
+        PutLE32(pOut, (i < 2) ? largestChunk[i] : 0);
+    }
+    PutLE32(pOut, (DWORD)treeBits.bytes.size());
+    for (DWORD t = 0; t < TREE_COUNT; t++)
+    {
+        PutLE32(pOut, treeSizes[t]);
+    }
+    PutLE32(pOut, AUDIO_RATE | (0xF0u << 24)); // Packed, present, 16-bit, stereo
+    PutLE32(pOut, AUDIO_RATE | (0xC0u << 24)); // Packed, present
+    for (DWORD i = 2; i < SMACKER_MAX_TRACKS; i++)
+    {
+        PutLE32(pOut, 0);
+    }
+    PutLE32(pOut, 0);
+
+    for (DWORD f = 0; f < VIDEO_FRAMES; f++)
+    {
+        PutLE32(pOut, (DWORD)frames[f].size() | (f == 0 ? 1 : 0));
+    }
+    pOut->insert(pOut->end(), types.begin(), types.end());
+    pOut->insert(pOut->end(), treeBits.bytes.begin(), treeBits.bytes.end());
+    for (DWORD f = 0; f < VIDEO_FRAMES; f++)
+    {
+        pOut->insert(pOut->end(), frames[f].begin(), frames[f].end());
+    }
+}
+
+// =============================================================================
+// VERIFICATION
+// =============================================================================
+
+static BYTE Expand6(BYTE v)
+{
+    return (BYTE)((v * 255 + 31) / 63);
+}
+
+static BOOL CheckCodec(const std::vector<BYTE> &file)
+{
+    StreamSource source;
+    AUDIOSTREAM_OpenMemorySource(&source, &file[0], file.size());
+    SmackerFile *pFile = SMACKER_Open(&source);
+    if (!pFile)
+    {
+        printf("codec:      open FAILED\n");
+        return FALSE;
+    }
+
+    SmackerInfo info;
+    SMACKER_GetInfo(pFile, &info);
+    BOOL ok = info.version == 4 && info.width == VIDEO_WIDTH && info.height == VIDEO_HEIGHT &&
+              info.frames == VIDEO_FRAMES && info.tracks[0].channels == 2 && info.tracks[0].bits == 16 &&
+              info.tracks[1].channels == 1 && info.tracks[1].bits == 8 && info.tracks[2].sampleRate == 0;
+
+    std::vector<BYTE> picture((size_t)VIDEO_WIDTH * VIDEO_HEIGHT, 0);
+    std::vector<BYTE> expected(picture.size());
+    std::vector<int16_t> pcm(8192);
+    BYTE palette[SMACKER_PALETTE_BYTES] = {0};
+    BYTE framePalette[256][3];
+    SmackerPacket packet;
+    SMACKER_InitPacket(&packet);
+    DWORD badFrames = 0;
+    DWORD badAudio = 0;
+    uint64_t decodeUs = 0;
+
+    for (DWORD f = 0; ok && f < VIDEO_FRAMES; f++)
+    {
+        if (!SMACKER_ReadPacket(pFile, f, &packet))
+        {
+            ok = FALSE;
+            break;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        BOOL decoded = SMACKER_DecodeVideo(pFile, &packet, &picture[0], VIDEO_WIDTH, palette);
+        decodeUs += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+        FramePicture(f, &expected[0]);
+        FramePalette(f, framePalette);
+        BOOL paletteOk = TRUE;
+        for (DWORD i = 0; i < SMACKER_PALETTE_BYTES; i++)
+        {
+            paletteOk = paletteOk && palette[i] == Expand6(framePalette[i / 3][i % 3]);
+        }
+        if (!decoded || !paletteOk || picture != expected)
+        {
+            badFrames++;
+        }
+
+        DWORD start0 = AudioStart(f);
+        DWORD count = AudioStart(f + 1) - start0;
+        int got = SMACKER_DecodeAudio(pFile, 0, &packet, &pcm[0], (DWORD)pcm.size());
+        BOOL audioOk = got == (int)count * 2 && SMACKER_AudioSamples(pFile, 0, &packet) == count * 2 &&
+                       memcmp(&pcm[0], &g_music[(size_t)start0 * 2], (size_t)count * 4) == 0;
+        got = SMACKER_DecodeAudio(pFile, 1, &packet, &pcm[0], (DWORD)pcm.size());
+        audioOk = audioOk && got == (int)count;
+        for (DWORD i = 0; audioOk && i < count; i++)
+        {
+            audioOk = pcm[i] == (int16_t)(((int)g_speech[start0 + i] - 128) * 256);
+        }
+        if (!audioOk)
+        {
+            badAudio++;
+        }
+    }
+
+    ok = ok && badFrames == 0 && badAudio == 0;
+    printf("codec:      %u frames, %u KB, %u bad pictures/palettes, %u bad audio chunks, %.2f ms/frame video decode "
+           "-> %s\n",
+           info.frames, (DWORD)(file.size() / 1024), badFrames, badAudio, decodeUs / 1000.0 / VIDEO_FRAMES,
+           ok ? "ok" : "FAILED");
+    SMACKER_FreePacket(&packet);
+    SMACKER_Close(pFile);
+    return ok;
+}
+
+static BOOL CheckKernels()
+{
+#if D2_SIMD_SSE2
+    VideoKernels scalar, simd;
+    VIDEOKERNELS_Select(&scalar, TRUE);
+    VIDEOKERNELS_Select(&simd, FALSE);
+
+    const DWORD width = 1037;
+    std::vector<DWORD> row(width + 1), a(2048), b(2048), outScalar(2048), outSimd(2048);
+    std::vector<WORD> packScalar(2048), packSimd(2048);
+    std::vector<VideoTap> taps(2048);
+    BOOL ok = TRUE;
+
+    for (DWORD i = 0; i <= width; i++)
+    {
+        row[i] = D2_HashDword(i);
+    }
+    for (DWORD i = 0; i < 2048; i++)
+    {
+        a[i] = D2_HashDword(i + 5000);
+        b[i] = D2_HashDword(i + 9000);
+    }
+
+    const DWORD outWidths[] = {1, 3, 640, 800, 1281, 1920};
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(outWidths); i++)
+    {
+        DWORD out = outWidths[i];
+        VIDEOKERNELS_BuildTaps(&taps[0], out, width, TRUE);
+        scalar.pfnScaleSmooth(&outScalar[0], &row[0], &taps[0], out);
+        simd.pfnScaleSmooth(&outSimd[0], &row[0], &taps[0], out);
+        ok = ok && memcmp(&outScalar[0], &outSimd[0], out * sizeof(DWORD)) == 0;
+
+        for (DWORD weight = 0; weight <= 256; weight += 37)
+        {
+            scalar.pfnBlend(&outScalar[0], &a[0], &b[0], weight, out);
+            simd.pfnBlend(&outSimd[0], &a[0], &b[0], weight, out);
+            ok = ok && memcmp(&outScalar[0], &outSimd[0], out * sizeof(DWORD)) == 0;
+        }
+        scalar.pfnPack565(&packScalar[0], &a[0], out);
+        simd.pfnPack565(&packSimd[0], &a[0], out);
+        ok = ok && memcmp(&packScalar[0], &packSimd[0], out * sizeof(WORD)) == 0;
+    }
+
+    printf("kernels:    scale, blend and RGB565 pack, scalar vs SSE2 -> %s\n", ok ? "identical" : "DIFFERENT");
+    return ok;
+#else
+    printf("kernels:    no SSE2 in this build, scalar only\n");
+    return TRUE;
+#endif
+}
+
+typedef struct PlayConfig
+{
+    DWORD width;
+    DWORD height;
+    DWORD bits;
+    SmackPlayerFilter filter;
+    BOOL stretch;
+    BOOL synchronous;
+    BOOL forceScalar;
+} PlayConfig;
+
+static SmackPlayer *OpenPlayer(const std::vector<BYTE> &file, const PlayConfig *pConfig, DWORD mixerRate)
+{
+    StreamSource source;
+    AUDIOSTREAM_OpenMemorySource(&source, &file[0], file.size());
+
+    SmackPlayerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.pSource = &source;
+    desc.outputWidth = pConfig->width;
+    desc.outputHeight = pConfig->height;
+    desc.outputBits = pConfig->bits;
+    desc.filter = pConfig->filter;
+    desc.stretch = pConfig->stretch;
+    desc.synchronous = pConfig->synchronous;
+    desc.forceScalar = pConfig->forceScalar;
+    desc.mixerRate = mixerRate;
+    desc.audioRingFrames = 1 << 18; // The whole file, so the checks can pull it after playing
+    return SMKPLAYER_Create(&desc);
+}
+
+static uint64_t HashBytes(const BYTE *p, size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Hash of every frame played, or an empty list when playback failed
+static std::vector<uint64_t> PlayHashes(const std::vector<BYTE> &file, const PlayConfig *pConfig)
+{
+    std::vector<uint64_t> hashes;
+    SmackPlayer *pPlayer = OpenPlayer(file, pConfig, 0);
+    if (!pPlayer)
+    {
+        return hashes;
+    }
+
+    DWORD pitch = pConfig->width * pConfig->bits / 8 + 12; // Pitch wider than a row, as surfaces have
+    std::vector<BYTE> surface((size_t)pitch * pConfig->height, 0xCD);
+    while (SMKPLAYER_NextFrame(pPlayer, &surface[0], pitch))
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (DWORD y = 0; y < pConfig->height; y++)
+        {
+            hash = HashBytes(&surface[(size_t)y * pitch], pConfig->width * pConfig->bits / 8, hash);
+        }
+        hashes.push_back(hash);
+    }
+    SMKPLAYER_Destroy(pPlayer);
+    return hashes;
+}
+
+static BOOL CheckIdentity(const std::vector<BYTE> &file)
+{
+    PlayConfig configs[2] = {
+        {VIDEO_WIDTH, VIDEO_HEIGHT, 32, SMKPLAYER_FILTER_SMOOTH, TRUE, TRUE, TRUE},
+        {VIDEO_WIDTH, VIDEO_HEIGHT, 32, SMKPLAYER_FILTER_SMOOTH, TRUE, FALSE, FALSE},
+    };
+    std::vector<BYTE> picture((size_t)VIDEO_WIDTH * VIDEO_HEIGHT);
+    std::vector<DWORD> surface(picture.size()), expected(picture.size());
+    BYTE palette[256][3];
+    BOOL ok = TRUE;
+
+    for (DWORD c = 0; c < 2; c++)
+    {
+        SmackPlayer *pPlayer = OpenPlayer(file, &configs[c], 0);
+        DWORD frames = 0;
+        while (pPlayer && SMKPLAYER_NextFrame(pPlayer, &surface[0], VIDEO_WIDTH * 4))
+        {
+            FramePicture(frames, &picture[0]);
+            FramePalette(frames, palette);
+            for (size_t i = 0; i < picture.size(); i++)
+            {
+                const BYTE *pRgb = palette[picture[i]];
+                expected[i] = ((DWORD)Expand6(pRgb[0]) << 16) | ((DWORD)Expand6(pRgb[1]) << 8) | Expand6(pRgb[2]);
+            }
+            ok = ok && surface == expected;
+            frames++;
+        }
+        ok = ok && pPlayer && frames == VIDEO_FRAMES;
+        SMKPLAYER_Destroy(pPlayer);
+    }
+
+    printf("identity:   640x480 output is the palette lookup of every frame, 1 thread and threaded -> %s\n",
+           ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static BOOL CheckThreadedOutput(const std::vector<BYTE> &file)
+{
+    PlayConfig modes[] = {
+        {800, 600, 32, SMKPLAYER_FILTER_SMOOTH, TRUE, FALSE, FALSE},
+        {1280, 720, 16, SMKPLAYER_FILTER_SMOOTH, FALSE, FALSE, FALSE},
+        {1920, 1080, 32, SMKPLAYER_FILTER_NEAREST, FALSE, FALSE, FALSE},
+        {333, 201, 16, SMKPLAYER_FILTER_SMOOTH, FALSE, FALSE, FALSE},
+    };
+    BOOL ok = TRUE;
+
+    for (DWORD m = 0; m < D2_ARRAY_SIZE(modes); m++)
+    {
+        PlayConfig baseline = modes[m];
+        baseline.synchronous = TRUE;
+        baseline.forceScalar = TRUE;
+        std::vector<uint64_t> expected = PlayHashes(file, &baseline);
+        std::vector<uint64_t> threaded = PlayHashes(file, &modes[m]);
+        BOOL same = expected.size() == VIDEO_FRAMES && threaded == expected;
+        printf("threaded:   %4ux%-4u %2u-bit %-7s %-9s 1 thread scalar vs threaded SIMD -> %s\n", modes[m].width,
+               modes[m].height, modes[m].bits, modes[m].filter == SMKPLAYER_FILTER_SMOOTH ? "smooth" : "nearest",
+               modes[m].stretch ? "stretched" : "letterbox", same ? "identical" : "DIFFERENT");
+        ok = ok && same;
+    }
+    return ok;
+}
+
+static BOOL CheckMixerStreams(const std::vector<BYTE> &file)
+{
+    PlayConfig config = {800, 600, 32, SMKPLAYER_FILTER_SMOOTH, TRUE, FALSE, FALSE};
+    SmackPlayer *pPlayer = OpenPlayer(file, &config, AUDIO_RATE);
+    if (!pPlayer)
+    {
+        return FALSE;
+    }
+
+    std::vector<BYTE> surface((size_t)800 * 600 * 4);
+    while (SMKPLAYER_NextFrame(pPlayer, &surface[0], 800 * 4))
+    {
+    }
+
+    DWORD frames = (DWORD)g_speech.size();
+    std::vector<int16_t> pulled((size_t)frames * 2 + MIXER_BLOCK_FRAMES * 2);
+    BOOL ok = SMKPLAYER_GetMixerStream(pPlayer, 2) == NULL;
+
+    for (DWORD track = 0; track < 2; track++)
+    {
+        const MixerStream *pStream = SMKPLAYER_GetMixerStream(pPlayer, track);
+        DWORD got = 0;
+        while (pStream && got < frames)
+        {
+            DWORD want = std::min<DWORD>(MIXER_BLOCK_FRAMES, frames - got);
+            got += pStream->pfnRead(pStream->pContext, &pulled[(size_t)got * 2], want);
+        }
+        // The stream ends after the last frame's audio
+        ok = ok && pStream && got == frames && pStream->pfnRead(pStream->pContext, &pulled[0], 16) == 0;
+
+        for (DWORD i = 0; ok && i < frames; i++)
+        {
+            int16_t left = (track == 0) ? g_music[i * 2] : (int16_t)(((int)g_speech[i] - 128) * 256);
+            int16_t right = (track == 0) ? g_music[i * 2 + 1] : left;
+            ok = pulled[i * 2] == left && pulled[i * 2 + 1] == right;
+        }
+    }
+
+    SmackPlayerStats stats;
+    SMKPLAYER_GetStats(pPlayer, &stats);
+    ok = ok && stats.audioFramesDropped == 0 && stats.audioFramesQueued == (uint64_t)frames * 2;
+    printf("audio:      2 tracks through mixer streams at %u Hz, %llu frames queued, %llu dropped -> %s\n", AUDIO_RATE,
+           (unsigned long long)stats.audioFramesQueued, (unsigned long long)stats.audioFramesDropped,
+           ok ? "ok" : "FAILED");
+    SMKPLAYER_Destroy(pPlayer);
+    return ok;
+}
+
+// Opens a possibly damaged file and decodes every frame; FALSE when it is refused at open
+static BOOL DecodeDamaged(const std::vector<BYTE> &file, DWORD *pBadFrames)
+{
+    StreamSource source;
+    AUDIOSTREAM_OpenMemorySource(&source, &file[0], file.size());
+    SmackerFile *pFile = SMACKER_Open(&source);
+    *pBadFrames = 0;
+    if (!pFile)
+    {
+        return FALSE;
+    }
+
+    SmackerInfo info;
+    SMACKER_GetInfo(pFile, &info);
+    std::vector<BYTE> picture((size_t)info.width * info.height, 0);
+    std::vector<int16_t> pcm(1 << 16);
+    BYTE palette[SMACKER_PALETTE_BYTES] = {0};
+    SmackerPacket packet;
+    SMACKER_InitPacket(&packet);
+
+    for (DWORD f = 0; f < info.frames; f++)
+    {
+        if (!SMACKER_ReadPacket(pFile, f, &packet))
+        {
+            (*pBadFrames)++;
+            continue;
+        }
+        BOOL good = SMACKER_DecodeVideo(pFile, &packet, &picture[0], info.width, palette);
+        for (DWORD track = 0; track < SMACKER_MAX_TRACKS; track++)
+        {
+            good = SMACKER_DecodeAudio(pFile, track, &packet, &pcm[0], (DWORD)pcm.size()) >= 0 && good;
+        }
+        *pBadFrames += good ? 0 : 1;
+    }
+
+    SMACKER_FreePacket(&packet);
+    SMACKER_Close(pFile);
+    return TRUE;
+}
+
+// SMK2, 16x16, one frame; the MMAP tree is a single leaf matching no escape, in a tree size of 0
+static void BuildCrowdedTree(std::vector<BYTE> *pOut)
+{
+    BitWriter trees;
+    InitWriter(&trees);
+    PutBits(&trees, 1, 1); // Present
+    PutBits(&trees, 0, 1); // No low byte tree
+    PutBits(&trees, 0, 1); // No high byte tree
+    for (DWORD i = 0; i < 3; i++)
+    {
+        PutBits(&trees, 0xFFFF, 16);
+    }
+    PutBits(&trees, 0, 1); // Leaf 0
+    PutBits(&trees, 0, 1);
+    PutBits(&trees, 0, 3); // MCLR, FULL and TYPE absent
+    FlushBits(&trees);
+
+    pOut->clear();
+    const char *szSignature = "SMK2";
+    pOut->insert(pOut->end(), szSignature, szSignature + 4);
+    PutLE32(pOut, 16);
+    PutLE32(pOut, 16);
+    PutLE32(pOut, 1);
+    PutLE32(pOut, 100);
+    for (DWORD i = 0; i < 1 + SMACKER_MAX_TRACKS; i++)
+    {
+        PutLE32(pOut, 0);
+    }
+    PutLE32(pOut, (DWORD)trees.bytes.size());
+    for (DWORD i = 0; i < TREE_COUNT + SMACKER_MAX_TRACKS + 1; i++)
+    {
+        PutLE32(pOut, 0);
+    }
+    PutLE32(pOut, 64);
+    pOut->push_back(0);
+    pOut->insert(pOut->end(), trees.bytes.begin(), trees.bytes.end());
+    pOut->resize(pOut->size() + 64, 0xA5);
+}
+
+static BOOL CheckDamagedFiles(const std::vector<BYTE> &file, DWORD copies)
+{
+    const DWORD frameTable = 104;
+    DWORD treesSize = (DWORD)file[52] | ((DWORD)file[53] << 8) | ((DWORD)file[54] << 16) | ((DWORD)file[55] << 24);
+    DWORD tablesEnd = frameTable + VIDEO_FRAMES * 5 + treesSize;
+    DWORD badFrames = 0;
+    BOOL ok = TRUE;
+
+    // Truncated anywhere before the end of the last frame
+    const size_t cuts[] = {1, 60, frameTable, frameTable + 300, tablesEnd - treesSize / 2, file.size() / 2,
+                           file.size() - 1};
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(cuts); i++)
+    {
+        std::vector<BYTE> truncated(file.begin(), file.begin() + cuts[i]);
+        ok = !DecodeDamaged(truncated, &badFrames) && ok;
+    }
+
+    // Frame sizes that wrap a 32-bit capacity test, or run past the end
+    std::vector<BYTE> oversized(file);
+    memset(&oversized[frameTable + 4], 0xFF, 4);
+    ok = !DecodeDamaged(oversized, &badFrames) && ok;
+    oversized = file;
+    oversized[frameTable + 60 * 4 + 2] ^= 0x10;
+    ok = !DecodeDamaged(oversized, &badFrames) && ok;
+    printf("damaged:    %u truncated copies and 2 bad frame tables refused at open -> %s\n",
+           (DWORD)D2_ARRAY_SIZE(cuts), ok ? "ok" : "FAILED");
+
+    std::vector<BYTE> crowded;
+    BuildCrowdedTree(&crowded);
+    BOOL crowdedOk = DecodeDamaged(crowded, &badFrames);
+    printf("damaged:    big tree filling its size field with all escapes unused -> %s\n",
+           crowdedOk ? "decoded" : "FAILED");
+
+    // Corrupted copies: a few bit flips or an overwritten run, over the tables or anywhere
+    DWORD opened = 0;
+    DWORD corruptFrames = 0;
+    DWORD played = 0;
+    std::vector<BYTE> surface((size_t)320 * 240 * 4);
+    for (DWORD copy = 0; copy < copies; copy++)
+    {
+        std::vector<BYTE> damaged(file);
+        DWORD hash = D2_HashDword(copy * 2654435761u + 17);
+        DWORD span = (copy & 1) ? tablesEnd : (DWORD)damaged.size();
+        if (copy % 3 == 2)
+        {
+            DWORD start = hash % span;
+            DWORD length = std::min<DWORD>(1 + (hash >> 20), (DWORD)damaged.size() - start);
+            for (DWORD i = 0; i < length; i++)
+            {
+                damaged[start + i] = (BYTE)D2_HashDword(hash + i);
+            }
+        }
+        else
+        {
+            for (DWORD i = 0; i <= hash % 16; i++)
+            {
+                DWORD pick = D2_HashDword(hash + i);
+                damaged[pick % span] ^= (BYTE)(1u << (pick >> 29));
+            }
+        }
+
+        if (DecodeDamaged(damaged, &badFrames))
+        {
+            opened++;
+            corruptFrames += badFrames;
+        }
+        if (copy % 4 == 0)
+        {
+            PlayConfig config = {320, 240, 32, SMKPLAYER_FILTER_SMOOTH, FALSE, TRUE, FALSE};
+            SmackPlayer *pPlayer = OpenPlayer(damaged, &config, 0);
+            while (pPlayer && SMKPLAYER_NextFrame(pPlayer, &surface[0], 320 * 4))
+            {
+            }
+            played += pPlayer ? 1 : 0;
+            SMKPLAYER_Destroy(pPlayer);
+        }
+    }
+    printf("damaged:    %u corrupted copies, %u opened (%u bad frames), %u played through -> ok\n", copies, opened,
+           corruptFrames, played);
+    return ok && crowdedOk;
+}
+
+// =============================================================================
+// FRAME RATE
+// =============================================================================
+
+// Frames per second converting flat out, best of `plays`
+static double MeasureFps(const std::vector<BYTE> &file, const PlayConfig *pConfig, DWORD plays,
+                         SmackPlayerStats *pStats)
+{
+    DWORD pitch = pConfig->width * pConfig->bits / 8;
+    std::vector<BYTE> surface((size_t)pitch * pConfig->height);
+    double best = 0.0;
+
+    for (DWORD play = 0; play < plays; play++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        SmackPlayer *pPlayer = OpenPlayer(file, pConfig, 0);
+        DWORD frames = 0;
+        while (pPlayer && SMKPLAYER_NextFrame(pPlayer, &surface[0], pitch))
+        {
+            frames++;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (pPlayer)
+        {
+            SMKPLAYER_GetStats(pPlayer, pStats);
+        }
+        SMKPLAYER_Destroy(pPlayer);
+        best = std::max(best, frames / seconds);
+    }
+    return best;
+}
+
+static void RunFrameRates(const std::vector<BYTE> &file, DWORD plays)
+{
+    const DWORD sizes[][2] = {{800, 600}, {1280, 720}, {1920, 1080}};
+    const struct
+    {
+        const char *szName;
+        BOOL synchronous;
+        BOOL forceScalar;
+    } modes[] = {
+        {"1 thread, scalar", TRUE, TRUE},
+        {"1 thread, SIMD", TRUE, FALSE},
+        {"threaded, scalar", FALSE, TRUE},
+        {"threaded, SIMD", FALSE, FALSE},
+    };
+
+    printf("frame rate: 640x480 source at %u fps, 32-bit output, smooth, letterboxed, %u hardware threads, "
+           "best of %u\n",
+           VIDEO_FPS, std::thread::hardware_concurrency(), plays);
+    for (DWORD s = 0; s < D2_ARRAY_SIZE(sizes); s++)
+    {
+        double baseline = 0.0;
+        for (DWORD m = 0; m < D2_ARRAY_SIZE(modes); m++)
+        {
+            PlayConfig config = {sizes[s][0], sizes[s][1], 32, SMKPLAYER_FILTER_SMOOTH, FALSE, modes[m].synchronous,
+                                 modes[m].forceScalar};
+            SmackPlayerStats stats;
+            memset(&stats, 0, sizeof(stats));
+            double fps = MeasureFps(file, &config, plays, &stats);
+            if (m == 0)
+            {
+                baseline = fps;
+            }
+            printf("  %4ux%-4u %-17s %7.1f fps  %6.2f ms/frame  %5.1fx real time  %5.2fx vs 1 thread scalar  "
+                   "(%u threads)\n",
+                   sizes[s][0], sizes[s][1], modes[m].szName, fps, 1000.0 / fps, fps / VIDEO_FPS, fps / baseline,
+                   stats.threads + 1);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    DWORD plays = (argc > 1) ? (DWORD)atoi(argv[1]) : 3;
+    DWORD copies = (argc > 2) ? (DWORD)atoi(argv[2]) : 64;
+    if (plays == 0)
+    {
+        printf("usage: bench_smacker [plays per measurement] [corrupted copies]\n");
+        return 1;
+    }
+
+    InitContent();
+    std::vector<BYTE> file;
+    EncodeFile(&file);
+
+    BOOL ok = CheckCodec(file);
+    ok = CheckKernels() && ok;
+    ok = CheckIdentity(file) && ok;
+    ok = CheckThreadedOutput(file) && ok;
+    ok = CheckMixerStreams(file) && ok;
+    ok = CheckDamagedFiles(file, copies) && ok;
+
+    RunFrameRates(file, plays);
+
+    printf("verify: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/*
+ * BenchSoundScheduler.cpp - Effect scheduler stress benchmark
+ *
+ * A big fight at 25 ticks per second: hundreds of monsters around the player
+ * fire hit/attack effects drawn from a small set of sound ids, thousands of
+ * events per second. Each tick's audio (1764 frames at 44.1 kHz) is rendered
+ * offline on the same thread.
+ *
+ *   direct:    every event gets its own pan/attenuation and MIXER_Play, as
+ *              D2Sound does; the mixer's own stealing is the only limit.
+ *   scheduled: events go through SCHED_Queue/SCHED_Flush (dedup, distance
+ *              cull, voice cap, stealing).
+ *
+ * Reports game-thread and mixer cost per tick, voices and triage counters,
+ * and checks that the scheduler never exceeds its voice cap.
+ *
+ * Usage: bench_soundsched [events-per-second] [seconds]
+ */
+
+#include "../Sound/SoundScheduler.hpp"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TICKS_PER_SECOND 25
+#define MONSTER_COUNT 300
+#define SOUND_COUNT 40
+#define FIGHT_RADIUS 60.0f
+#define AUDIBLE_RADIUS 40.0f
+
+static AudioSample g_sounds[SOUND_COUNT];
+
+typedef struct Monster
+{
+    float x, y;
+    DWORD soundId;
+} Monster;
+
+static Monster g_monsters[MONSTER_COUNT];
+
+static void BuildSounds(void)
+{
+    for (DWORD s = 0; s < SOUND_COUNT; s++)
+    {
+        DWORD frames = 22050 / 4 + s * 331; // 0.25 - 0.85 s, 22 kHz mono like D2 effects
+        int16_t *pcm = (int16_t *)malloc(frames * sizeof(int16_t));
+        for (DWORD i = 0; i < frames; i++)
+        {
+            float t = (float)i / 22050.0f;
+            pcm[i] = (int16_t)(sinf(6.2831853f * (150.0f + s * 23.0f) * t) * expf(-4.0f * t) * 9000.0f);
+        }
+        g_sounds[s].pcm = pcm;
+        g_sounds[s].frames = frames;
+        g_sounds[s].sampleRate = 22050;
+        g_sounds[s].channels = 1;
+    }
+}
+
+static DWORD g_rng = 0x9E3779B9;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static float RandomUnit(void)
+{
+    return (float)(NextRandom() & 0xFFFFFF) / 16777216.0f;
+}
+
+static void PlaceMonsters(void)
+{
+    for (DWORD m = 0; m < MONSTER_COUNT; m++)
+    {
+        float angle = RandomUnit() * 6.2831853f;
+        float dist = sqrtf(RandomUnit()) * FIGHT_RADIUS;
+        g_monsters[m].x = cosf(angle) * dist;
+        g_monsters[m].y = sinf(angle) * dist;
+        // Monster types share sounds: a few ids dominate, as in a pack
+        g_monsters[m].soundId = (m % 4 == 0) ? (m % SOUND_COUNT) : (m % 6);
+    }
+}
+
+typedef struct RunResult
+{
+    double gameNsPerTick;
+    double mixNsPerTick;
+    DWORD peakVoices;
+    DWORD maxScheduled; // Highest scheduler activeVoices seen after a flush
+    uint64_t events;
+    AudioMixerStats mixer;
+    SoundSchedulerStats sched;
+} RunResult;
+
+static void Run(BOOL scheduled, DWORD eventsPerSecond, DWORD seconds, RunResult *pResult)
+{
+    memset(pResult, 0, sizeof(RunResult));
+    g_rng = 0x9E3779B9;
+
+    AudioMixerDesc mixerDesc;
+    memset(&mixerDesc, 0, sizeof(mixerDesc));
+    mixerDesc.maxVoices = scheduled ? 64 : MIXER_MAX_VOICES;
+    mixerDesc.commandCapacity = 4096;
+    AudioMixer *pMixer = MIXER_Create(&mixerDesc);
+
+    SoundSchedulerDesc schedDesc;
+    memset(&schedDesc, 0, sizeof(schedDesc));
+    schedDesc.audibleRadius = AUDIBLE_RADIUS;
+    SoundScheduler *pScheduler = scheduled ? SCHED_Create(pMixer, &schedDesc) : NULL;
+
+    DWORD ticks = seconds * TICKS_PER_SECOND;
+    DWORD eventsPerTick = eventsPerSecond / TICKS_PER_SECOND;
+    DWORD framesPerTick = MIXER_DEFAULT_RATE / TICKS_PER_SECOND;
+    DWORD framesOwed = 0;
+    int16_t block[MIXER_BLOCK_FRAMES * 2];
+    MixerEvent event;
+    double gameNs = 0, mixNs = 0;
+
+    for (DWORD t = 0; t < ticks; t++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (DWORD e = 0; e < eventsPerTick; e++)
+        {
+            const Monster *pMonster = &g_monsters[NextRandom() % MONSTER_COUNT];
+            const AudioSample *pSample = &g_sounds[pMonster->soundId];
+
+            if (scheduled)
+            {
+                SCHED_Queue(pScheduler, pMonster->soundId, pSample, pMonster->x, pMonster->y, 0.8f, MIXPRIORITY_EFFECT,
+                            0);
+            }
+            else
+            {
+                // D2Sound: positional bias per queued effect, then straight to the device
+                float dist = sqrtf(pMonster->x * pMonster->x + pMonster->y * pMonster->y);
+                if (dist < AUDIBLE_RADIUS)
+                {
+                    float volume = 0.8f * (1.0f - dist / AUDIBLE_RADIUS);
+                    MIXER_Play(pMixer, pSample, volume, pMonster->x / AUDIBLE_RADIUS, MIXPRIORITY_EFFECT, 0, 0);
+                }
+            }
+        }
+        pResult->events += eventsPerTick;
+
+        if (scheduled)
+        {
+            // Player's own skill sound and a UI click: global, must always play
+            if (t % 10 == 0)
+            {
+                SCHED_Queue(pScheduler, 1000, &g_sounds[SOUND_COUNT - 1], 0, 0, 0.6f, MIXPRIORITY_CRITICAL,
+                            SOUNDEVT_GLOBAL);
+            }
+            SCHED_Flush(pScheduler);
+            SoundSchedulerStats stats;
+            SCHED_GetStats(pScheduler, &stats);
+            if (stats.activeVoices > pResult->maxScheduled)
+            {
+                pResult->maxScheduled = stats.activeVoices;
+            }
+        }
+        else
+        {
+            while (MIXER_PollEvent(pMixer, &event))
+            {
+            }
+        }
+        std::chrono::steady_clock::time_point mid = std::chrono::steady_clock::now();
+
+        framesOwed += framesPerTick;
+        while (framesOwed >= MIXER_BLOCK_FRAMES)
+        {
+            MIXER_RenderBlock(pMixer, block);
+            framesOwed -= MIXER_BLOCK_FRAMES;
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        gameNs += std::chrono::duration<double, std::nano>(mid - start).count();
+        mixNs += std::chrono::duration<double, std::nano>(end - mid).count();
+    }
+
+    pResult->gameNsPerTick = gameNs / ticks;
+    pResult->mixNsPerTick = mixNs / ticks;
+    MIXER_GetStats(pMixer, &pResult->mixer);
+    pResult->peakVoices = pResult->mixer.peakVoices;
+    if (pScheduler)
+    {
+        SCHED_GetStats(pScheduler, &pResult->sched);
+    }
+
+    SCHED_Destroy(pScheduler);
+    MIXER_Destroy(pMixer);
+}
+
+int main(int argc, char **argv)
+{
+    DWORD eventsPerSecond = (argc > 1) ? (DWORD)atoi(argv[1]) : 5000;
+    DWORD seconds = (argc > 2) ? (DWORD)atoi(argv[2]) : 20;
+
+    BuildSounds();
+    PlaceMonsters();
+
+    RunResult direct, scheduled;
+    Run(FALSE, eventsPerSecond, seconds, &direct);
+    Run(TRUE, eventsPerSecond, seconds, &scheduled);
+
+    const double tickBudgetNs = 1e9 / TICKS_PER_SECOND;
+    printf("fight: %u monsters, %u sound ids, %u events/s for %u s (%llu events)\n", MONSTER_COUNT, SOUND_COUNT,
+           eventsPerSecond, seconds, (unsigned long long)direct.events);
+    printf("  direct:    game %7.0f ns/tick, mix %9.0f ns/tick (%5.2f%% of tick), peak %3u voices, %u stolen by mixer\n",
+           direct.gameNsPerTick, direct.mixNsPerTick, 100.0 * direct.mixNsPerTick / tickBudgetNs, direct.peakVoices,
+           direct.mixer.voicesStolen);
+    printf("  scheduled: game %7.0f ns/tick, mix %9.0f ns/tick (%5.2f%% of tick), peak %3u voices, %.2fx mix speedup\n",
+           scheduled.gameNsPerTick, scheduled.mixNsPerTick, 100.0 * scheduled.mixNsPerTick / tickBudgetNs,
+           scheduled.peakVoices, scheduled.mixNsPerTick > 0 ? direct.mixNsPerTick / scheduled.mixNsPerTick : 0.0);
+
+    const SoundSchedulerStats *pStats = &scheduled.sched;
+    printf("  triage:    %llu queued, %llu merged, %llu out of range, %llu over budget, %llu played, %llu stolen\n",
+           (unsigned long long)pStats->queued, (unsigned long long)pStats->merged,
+           (unsigned long long)pStats->culledDistance, (unsigned long long)pStats->culledBudget,
+           (unsigned long long)pStats->played, (unsigned long long)pStats->stolen);
+
+    BOOL capOk = scheduled.maxScheduled <= 24;
+    printf("  voice cap: max %u scheduled voices (cap 24) -> %s\n", scheduled.maxScheduled, capOk ? "ok" : "EXCEEDED");
+
+    for (DWORD s = 0; s < SOUND_COUNT; s++)
+    {
+        free((void *)g_sounds[s].pcm);
+    }
+    return capOk ? 0 : 1;
+}
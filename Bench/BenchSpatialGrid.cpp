@@ -0,0 +1,405 @@
+/*
+ * BenchSpatialGrid.cpp - Spatial index benchmark for crowded AoE fights
+ *
+ * A 400x400 subtile level (10x10 rooms of 40x40) with a packed fight in the
+ * middle: thousands of monsters, thousands of missiles, and a set of
+ * Blizzard/Blessed Hammer area queries every tick. Each tick every unit
+ * moves, some missiles expire and respawn, every missile runs a collision
+ * query and the AoE set runs radius queries.
+ *
+ *   rooms: D2Common's layout. Units are scattered heap objects linked into
+ *          per-room lists; positions are read through unit -> path; queries
+ *          walk every room overlapping the query box
+ *          (ProcessUnitsInBoundingBox + CalculateUnitDistance).
+ *   grid:  SPATIALGRID_Move per unit and one SPATIALGRID_QueryRadiusBatch.
+ *
+ * Every query result is checked against the room walk, and the SIMD and
+ * scalar filters must produce identical output.
+ *
+ * Usage: bench_spatialgrid [monsters] [missiles] [ticks]
+ */
+
+#include "../Common/SpatialGrid.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define LEVEL_SIZE 400
+#define ROOM_SIZE 40
+#define ROOMS_PER_SIDE (LEVEL_SIZE / ROOM_SIZE)
+#define FIGHT_MIN 140.0f
+#define FIGHT_MAX 260.0f
+#define AOE_QUERIES 96
+#define COLLIDE_RADIUS 1.5f
+
+// =============================================================================
+// ROOM-LIST BASELINE
+// =============================================================================
+
+typedef struct LegacyPath
+{
+    BYTE reserved[0x20];
+    float x;
+    float y;
+    BYTE tail[0x38];
+} LegacyPath;
+
+typedef struct LegacyUnit
+{
+    DWORD type;
+    DWORD id;
+    BYTE reserved[0x24];
+    LegacyPath *pPath;
+    BYTE reserved2[0x90];
+    int room;
+    struct LegacyUnit *pRoomNext;
+    BYTE tail[0x30];
+} LegacyUnit;
+
+static LegacyUnit *g_roomLists[ROOMS_PER_SIDE * ROOMS_PER_SIDE];
+
+static int RoomOf(float x, float y)
+{
+    int rx = std::min(std::max((int)(x / ROOM_SIZE), 0), ROOMS_PER_SIDE - 1);
+    int ry = std::min(std::max((int)(y / ROOM_SIZE), 0), ROOMS_PER_SIDE - 1);
+    return ry * ROOMS_PER_SIDE + rx;
+}
+
+static void RoomLink(LegacyUnit *pUnit, int room)
+{
+    pUnit->room = room;
+    pUnit->pRoomNext = g_roomLists[room];
+    g_roomLists[room] = pUnit;
+}
+
+static void RoomUnlink(LegacyUnit *pUnit)
+{
+    LegacyUnit **ppLink = &g_roomLists[pUnit->room];
+    while (*ppLink != pUnit)
+    {
+        ppLink = &(*ppLink)->pRoomNext;
+    }
+    *ppLink = pUnit->pRoomNext;
+}
+
+static void LegacyMove(LegacyUnit *pUnit, float x, float y)
+{
+    pUnit->pPath->x = x;
+    pUnit->pPath->y = y;
+    int room = RoomOf(x, y);
+    if (room != pUnit->room)
+    {
+        RoomUnlink(pUnit);
+        RoomLink(pUnit, room);
+    }
+}
+
+static DWORD LegacyQueryRadius(float x, float y, float radius, DWORD typeMask, DWORD *pOut, DWORD maxOut)
+{
+    int rx0 = std::max((int)((x - radius) / ROOM_SIZE), 0);
+    int rx1 = std::min((int)((x + radius) / ROOM_SIZE), ROOMS_PER_SIDE - 1);
+    int ry0 = std::max((int)((y - radius) / ROOM_SIZE), 0);
+    int ry1 = std::min((int)((y + radius) / ROOM_SIZE), ROOMS_PER_SIDE - 1);
+    float r2 = radius * radius;
+    DWORD total = 0;
+
+    for (int ry = ry0; ry <= ry1; ry++)
+    {
+        for (int rx = rx0; rx <= rx1; rx++)
+        {
+            for (LegacyUnit *pUnit = g_roomLists[ry * ROOMS_PER_SIDE + rx]; pUnit; pUnit = pUnit->pRoomNext)
+            {
+                float dx = pUnit->pPath->x - x;
+                float dy = pUnit->pPath->y - y;
+                float d2 = dx * dx + dy * dy;
+                if (d2 <= r2 && (pUnit->type & typeMask))
+                {
+                    if (total < maxOut)
+                        pOut[total] = pUnit->id;
+                    total++;
+                }
+            }
+        }
+    }
+    return total;
+}
+
+// =============================================================================
+// SIMULATION
+// =============================================================================
+
+typedef struct SimUnit
+{
+    float x, y;
+    float vx, vy;
+    DWORD type;
+    DWORD handle;       // SIMD grid
+    DWORD scalarHandle; // Scalar grid
+    LegacyUnit *pLegacy;
+} SimUnit;
+
+static std::vector<SimUnit> g_units;
+static DWORD g_rng = 0xC0FFEE;
+
+static float RandomFloat(float lo, float hi)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return lo + (hi - lo) * (float)(g_rng & 0xFFFFFF) / 16777216.0f;
+}
+
+static void SpawnMissile(SimUnit *pUnit)
+{
+    pUnit->x = RandomFloat(FIGHT_MIN, FIGHT_MAX);
+    pUnit->y = RandomFloat(FIGHT_MIN, FIGHT_MAX);
+    float angle = RandomFloat(0.0f, 6.2831853f);
+    float speed = RandomFloat(0.5f, 1.5f);
+    pUnit->vx = cosf(angle) * speed;
+    pUnit->vy = sinf(angle) * speed;
+}
+
+static void StepUnit(SimUnit *pUnit)
+{
+    pUnit->x += pUnit->vx;
+    pUnit->y += pUnit->vy;
+    if (pUnit->x < FIGHT_MIN - 40.0f || pUnit->x > FIGHT_MAX + 40.0f)
+        pUnit->vx = -pUnit->vx;
+    if (pUnit->y < FIGHT_MIN - 40.0f || pUnit->y > FIGHT_MAX + 40.0f)
+        pUnit->vy = -pUnit->vy;
+    if (pUnit->type == SPATIAL_TYPE_MONSTER)
+    {
+        pUnit->vx += RandomFloat(-0.05f, 0.05f);
+        pUnit->vy += RandomFloat(-0.05f, 0.05f);
+        pUnit->vx = std::min(std::max(pUnit->vx, -0.4f), 0.4f);
+        pUnit->vy = std::min(std::max(pUnit->vy, -0.4f), 0.4f);
+    }
+}
+
+// One tick of queries: a collision probe per missile plus the AoE set
+static void BuildQueries(std::vector<SpatialQuery> &queries)
+{
+    queries.clear();
+    for (size_t i = 0; i < g_units.size(); i++)
+    {
+        if (g_units[i].type == SPATIAL_TYPE_MISSILE)
+        {
+            SpatialQuery q = {g_units[i].x, g_units[i].y, COLLIDE_RADIUS, SPATIAL_TYPE_MONSTER | SPATIAL_TYPE_PLAYER};
+            queries.push_back(q);
+        }
+    }
+    for (DWORD i = 0; i < AOE_QUERIES; i++)
+    {
+        // Blizzard shards (radius ~3) and hammer/nova style bursts (radius ~6)
+        SpatialQuery q = {RandomFloat(FIGHT_MIN, FIGHT_MAX), RandomFloat(FIGHT_MIN, FIGHT_MAX),
+                          (i & 1) ? 3.0f : 6.0f, SPATIAL_TYPE_MONSTER};
+        queries.push_back(q);
+    }
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    DWORD monsters = (argc > 1) ? (DWORD)atoi(argv[1]) : 3000;
+    DWORD missiles = (argc > 2) ? (DWORD)atoi(argv[2]) : 3000;
+    DWORD ticks = (argc > 3) ? (DWORD)atoi(argv[3]) : 100;
+    DWORD unitCount = monsters + missiles;
+    BOOL ok = TRUE;
+
+    SpatialGridDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.width = LEVEL_SIZE;
+    desc.height = LEVEL_SIZE;
+    desc.capacity = unitCount;
+    SpatialGrid *pGrid = SPATIALGRID_Create(&desc);
+    desc.forceScalar = TRUE;
+    SpatialGrid *pScalar = SPATIALGRID_Create(&desc);
+
+    // Legacy units are allocated interleaved with other allocations, in a shuffled order
+    std::vector<void *> noise;
+    std::vector<DWORD> order(unitCount);
+    for (DWORD i = 0; i < unitCount; i++)
+        order[i] = i;
+    for (DWORD i = unitCount - 1; i > 0; i--)
+        std::swap(order[i], order[(DWORD)RandomFloat(0.0f, (float)(i + 1)) % (i + 1)]);
+
+    g_units.resize(unitCount);
+    for (DWORD n = 0; n < unitCount; n++)
+    {
+        DWORD i = order[n];
+        SimUnit *pUnit = &g_units[i];
+        pUnit->type = (i < monsters) ? SPATIAL_TYPE_MONSTER : SPATIAL_TYPE_MISSILE;
+        if (i == 0)
+            pUnit->type = SPATIAL_TYPE_PLAYER;
+        SpawnMissile(pUnit);
+        if (pUnit->type != SPATIAL_TYPE_MISSILE)
+        {
+            pUnit->vx *= 0.2f;
+            pUnit->vy *= 0.2f;
+        }
+
+        pUnit->pLegacy = (LegacyUnit *)calloc(1, sizeof(LegacyUnit));
+        noise.push_back(malloc(64 + (n % 7) * 48));
+        pUnit->pLegacy->pPath = (LegacyPath *)calloc(1, sizeof(LegacyPath));
+        noise.push_back(malloc(96));
+        pUnit->pLegacy->type = pUnit->type;
+        pUnit->pLegacy->id = i;
+        pUnit->pLegacy->pPath->x = pUnit->x;
+        pUnit->pLegacy->pPath->y = pUnit->y;
+        RoomLink(pUnit->pLegacy, RoomOf(pUnit->x, pUnit->y));
+
+        pUnit->handle = SPATIALGRID_Insert(pGrid, i, pUnit->type, pUnit->x, pUnit->y);
+        pUnit->scalarHandle = SPATIALGRID_Insert(pScalar, i, pUnit->type, pUnit->x, pUnit->y);
+    }
+
+    std::vector<SpatialQuery> queries;
+    std::vector<DWORD> results(1 << 20), scalarResults(1 << 20), legacyResults(4096), sortedGrid;
+    std::vector<DWORD> offsets, counts, scalarOffsets, scalarCounts;
+    double legacyMove = 0, legacyQuery = 0, gridMove = 0, gridQuery = 0, scalarQuery = 0;
+    uint64_t totalQueries = 0, totalHits = 0, mismatches = 0;
+
+    for (DWORD tick = 0; tick < ticks; tick++)
+    {
+        // Movement, with 5% of missiles expiring and respawning elsewhere
+        for (DWORD i = 0; i < unitCount; i++)
+        {
+            SimUnit *pUnit = &g_units[i];
+            if (pUnit->type == SPATIAL_TYPE_MISSILE && RandomFloat(0.0f, 1.0f) < 0.05f)
+            {
+                SpawnMissile(pUnit);
+                SPATIALGRID_Remove(pGrid, pUnit->handle);
+                SPATIALGRID_Remove(pScalar, pUnit->scalarHandle);
+                pUnit->handle = SPATIALGRID_Insert(pGrid, i, pUnit->type, pUnit->x, pUnit->y);
+                pUnit->scalarHandle = SPATIALGRID_Insert(pScalar, i, pUnit->type, pUnit->x, pUnit->y);
+                LegacyMove(pUnit->pLegacy, pUnit->x, pUnit->y);
+                ok &= pUnit->handle != SPATIAL_INVALID_HANDLE;
+            }
+            else
+            {
+                StepUnit(pUnit);
+            }
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (DWORD i = 0; i < unitCount; i++)
+        {
+            LegacyMove(g_units[i].pLegacy, g_units[i].x, g_units[i].y);
+        }
+        legacyMove += Seconds(start);
+
+        start = std::chrono::steady_clock::now();
+        for (DWORD i = 0; i < unitCount; i++)
+        {
+            SPATIALGRID_Move(pGrid, g_units[i].handle, g_units[i].x, g_units[i].y);
+        }
+        gridMove += Seconds(start);
+
+        for (DWORD i = 0; i < unitCount; i++)
+        {
+            SPATIALGRID_Move(pScalar, g_units[i].scalarHandle, g_units[i].x, g_units[i].y);
+        }
+
+        BuildQueries(queries);
+        DWORD queryCount = (DWORD)queries.size();
+        offsets.resize(queryCount);
+        counts.resize(queryCount);
+        scalarOffsets.resize(queryCount);
+        scalarCounts.resize(queryCount);
+
+        start = std::chrono::steady_clock::now();
+        DWORD legacyHits = 0;
+        for (DWORD q = 0; q < queryCount; q++)
+        {
+            legacyHits += LegacyQueryRadius(queries[q].x, queries[q].y, queries[q].radius, queries[q].typeMask,
+                                            &legacyResults[0], (DWORD)legacyResults.size());
+        }
+        legacyQuery += Seconds(start);
+
+        start = std::chrono::steady_clock::now();
+        BOOL overflow;
+        DWORD gridHits = SPATIALGRID_QueryRadiusBatch(pGrid, &queries[0], queryCount, &results[0],
+                                                      (DWORD)results.size(), &offsets[0], &counts[0], &overflow);
+        gridQuery += Seconds(start);
+
+        totalQueries += queryCount;
+        totalHits += gridHits;
+        ok &= !overflow && gridHits == legacyHits;
+
+        // Verification (untimed): scalar path identical, room walk identical as a set
+        start = std::chrono::steady_clock::now();
+        SPATIALGRID_QueryRadiusBatch(pScalar, &queries[0], queryCount, &scalarResults[0],
+                                     (DWORD)scalarResults.size(), &scalarOffsets[0], &scalarCounts[0], NULL);
+        scalarQuery += Seconds(start);
+        for (DWORD q = 0; q < queryCount; q++)
+        {
+            DWORD n = LegacyQueryRadius(queries[q].x, queries[q].y, queries[q].radius, queries[q].typeMask,
+                                        &legacyResults[0], (DWORD)legacyResults.size());
+            sortedGrid.assign(results.begin() + offsets[q], results.begin() + offsets[q] + counts[q]);
+            std::vector<DWORD> sortedScalar(scalarResults.begin() + scalarOffsets[q],
+                                            scalarResults.begin() + scalarOffsets[q] + scalarCounts[q]);
+            std::sort(sortedGrid.begin(), sortedGrid.end());
+            std::sort(sortedScalar.begin(), sortedScalar.end());
+            std::sort(legacyResults.begin(), legacyResults.begin() + n);
+            if (n != counts[q] || sortedGrid != sortedScalar ||
+                !std::equal(sortedGrid.begin(), sortedGrid.end(), legacyResults.begin()))
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    // Box queries against a brute-force scan of the live positions
+    DWORD boxErrors = 0;
+    for (DWORD i = 0; i < 200; i++)
+    {
+        float x0 = RandomFloat(-20.0f, LEVEL_SIZE), y0 = RandomFloat(-20.0f, LEVEL_SIZE);
+        float x1 = x0 + RandomFloat(0.0f, 30.0f), y1 = y0 + RandomFloat(0.0f, 30.0f);
+        DWORD n = SPATIALGRID_QueryBox(pGrid, x0, y0, x1, y1, SPATIAL_TYPE_ALL, &results[0], (DWORD)results.size());
+        DWORD expected = 0;
+        for (DWORD u = 0; u < unitCount; u++)
+        {
+            expected += g_units[u].x >= x0 && g_units[u].x <= x1 && g_units[u].y >= y0 && g_units[u].y <= y1;
+        }
+        boxErrors += n != expected;
+    }
+
+    SpatialGridStats stats;
+    SPATIALGRID_GetStats(pGrid, &stats);
+
+    printf("fight:   %u monsters, %u missiles, %u ticks, %.0f queries/tick, %.1f hits/query\n", monsters, missiles,
+           ticks, (double)totalQueries / ticks, totalQueries ? (double)totalHits / totalQueries : 0.0);
+    printf("  rooms: move %7.1f us/tick, query %8.1f us/tick, total %8.1f us/tick\n", legacyMove * 1e6 / ticks,
+           legacyQuery * 1e6 / ticks, (legacyMove + legacyQuery) * 1e6 / ticks);
+    printf("  grid:  move %7.1f us/tick, query %8.1f us/tick, total %8.1f us/tick (%.2fx, %s filter)\n",
+           gridMove * 1e6 / ticks, gridQuery * 1e6 / ticks, (gridMove + gridQuery) * 1e6 / ticks,
+           (gridMove + gridQuery) > 0 ? (legacyMove + legacyQuery) / (gridMove + gridQuery) : 0.0,
+           SPATIALGRID_IsSimd(pGrid) ? "SSE2" : "scalar");
+    printf("  grid:  scalar filter query %8.1f us/tick\n", scalarQuery * 1e6 / ticks);
+    printf("  grid:  %.1f cells and %.1f candidates per query, %llu cell changes\n",
+           (double)stats.cellsVisited / stats.queries, (double)stats.candidates / stats.queries,
+           (unsigned long long)stats.cellChanges);
+    printf("verify:  radius queries vs room walk and scalar filter: %llu mismatches -> %s\n",
+           (unsigned long long)mismatches, mismatches ? "FAILED" : "ok");
+    printf("verify:  box queries vs brute force: %u mismatches -> %s\n", boxErrors, boxErrors ? "FAILED" : "ok");
+    ok &= !mismatches && !boxErrors && stats.entries == unitCount;
+
+    SPATIALGRID_Destroy(pGrid);
+    SPATIALGRID_Destroy(pScalar);
+    for (size_t i = 0; i < g_units.size(); i++)
+    {
+        free(g_units[i].pLegacy->pPath);
+        free(g_units[i].pLegacy);
+    }
+    for (size_t i = 0; i < noise.size(); i++)
+        free(noise[i]);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,452 @@
+/*
+ * BenchStatEngine.cpp - Gear swaps and aura toggles in an 8-player party
+ *
+ * Eight characters, each with a base layer, a synergy layer, a dozen
+ * equipped items of ~8 properties and the party's aura layers. Events:
+ *
+ *   aura toggle: a paladin switches auras; every party member loses one
+ *                aura layer and gains another.
+ *   gear swap:   one player swaps weapons (two item layers out, two in).
+ *
+ * After each event combat code reads a handful of derived stats from every
+ * affected player.
+ *
+ *   rebuild:     ApplyStatModifiersToUnit's approach - merge every layer
+ *                into the unit's sorted (id, value) stat list and re-derive
+ *                everything, per change; reads binary-search the list.
+ *   incremental: StatEngine layers with dirty propagation.
+ *
+ * The rebuild uses hand-written D2 formulas, independent of the engine's
+ * rule tables, and is the oracle: every stat of every affected player must
+ * match after every event. A cyclic schema must be rejected.
+ *
+ * Usage: bench_statengine [events]
+ */
+
+#include "../Common/StatEngine.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define PLAYERS 8
+#define ITEMS_PER_PLAYER 12
+#define MODS_PER_ITEM 8
+#define AURA_COUNT 6
+#define SWAP_SETS 2
+
+typedef std::vector<StatMod> ModList;
+
+// Source ids: 0 base, 1 synergies, 100+ auras, 1000+ items
+#define SOURCE_SYNERGY 1
+#define SOURCE_AURA(a) (100 + (a))
+
+static const WORD s_itemStats[] = {
+    STAT_STRENGTH, STAT_DEXTERITY, STAT_VITALITY, STAT_ENERGY, STAT_MAXHP, STAT_MAXMANA,
+    STAT_ITEM_ARMOR_PERCENT, STAT_ITEM_MAXDAMAGE_PERCENT, STAT_ITEM_MINDAMAGE_PERCENT, STAT_TOHIT, STAT_MINDAMAGE,
+    STAT_MAXDAMAGE, STAT_ARMORCLASS, STAT_FIRERESIST, STAT_LIGHTRESIST, STAT_COLDRESIST, STAT_POISONRESIST,
+    STAT_ITEM_MAXHP_PERCENT, STAT_ITEM_MAXMANA_PERCENT, STAT_ITEM_TOHIT_PERCENT, STAT_ITEM_ARMOR_PERLEVEL,
+    STAT_ITEM_HP_PERLEVEL, STAT_ITEM_MANA_PERLEVEL, STAT_ITEM_MAXDAMAGE_PERLEVEL,
+    // Properties no derived stat reads (crushing blow, fcr, mf, ...)
+    136, 105, 80, 93, 99, 60, 62, 74, 138, 150};
+
+static const WORD s_readStats[] = {STAT_MAXHP, STAT_MAXDAMAGE, STAT_MINDAMAGE, STAT_TOHIT, STAT_ARMORCLASS,
+                                   STAT_FIRERESIST};
+
+// =============================================================================
+// FULL REBUILD (ORACLE)
+// =============================================================================
+
+typedef struct LegacyLayer
+{
+    DWORD sourceId;
+    ModList mods;
+} LegacyLayer;
+
+typedef struct Player
+{
+    StatUnit *pUnit;
+    std::vector<LegacyLayer> layers;
+    // D2 stat list: (id, value) pairs sorted by id, binary-searched
+    WORD statIds[STAT_COUNT_D2];
+    int32_t statValues[STAT_COUNT_D2];
+    DWORD statCount;
+    ModList weaponSets[SWAP_SETS][2];
+    DWORD activeSet;
+} Player;
+
+static Player g_players[PLAYERS];
+
+static int64_t PerStat(int32_t value, int32_t scale)
+{
+    return (int64_t)value * scale / 256;
+}
+
+static int64_t PerLevel(int32_t value, int32_t level, int32_t scale)
+{
+    return (int64_t)value * level * scale / 256;
+}
+
+static int32_t Percent(int64_t base, int64_t percent)
+{
+    int64_t value = base + base * percent / 100;
+    return (int32_t)(value > INT32_MAX ? INT32_MAX : (value < INT32_MIN ? INT32_MIN : value));
+}
+
+static DWORD LegacyFind(const Player *pPlayer, WORD stat)
+{
+    DWORD lo = 0, hi = pPlayer->statCount;
+    while (lo < hi)
+    {
+        DWORD mid = (lo + hi) / 2;
+        if (pPlayer->statIds[mid] < stat)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int32_t LegacyGet(const Player *pPlayer, WORD stat)
+{
+    DWORD i = LegacyFind(pPlayer, stat);
+    return (i < pPlayer->statCount && pPlayer->statIds[i] == stat) ? pPlayer->statValues[i] : 0;
+}
+
+static int32_t *LegacySlot(Player *pPlayer, WORD stat)
+{
+    DWORD i = LegacyFind(pPlayer, stat);
+    if (i == pPlayer->statCount || pPlayer->statIds[i] != stat)
+    {
+        memmove(&pPlayer->statIds[i + 1], &pPlayer->statIds[i], (pPlayer->statCount - i) * sizeof(WORD));
+        memmove(&pPlayer->statValues[i + 1], &pPlayer->statValues[i], (pPlayer->statCount - i) * sizeof(int32_t));
+        pPlayer->statIds[i] = stat;
+        pPlayer->statValues[i] = 0;
+        pPlayer->statCount++;
+    }
+    return &pPlayer->statValues[i];
+}
+
+static void LegacyRebuild(Player *pPlayer)
+{
+    pPlayer->statCount = 0;
+    for (size_t l = 0; l < pPlayer->layers.size(); l++)
+    {
+        const ModList &mods = pPlayer->layers[l].mods;
+        for (size_t m = 0; m < mods.size(); m++)
+        {
+            *LegacySlot(pPlayer, mods[m].stat) += mods[m].value;
+        }
+    }
+
+    // Derived stats, inputs first
+    Player *p = pPlayer;
+    int32_t level = LegacyGet(p, STAT_LEVEL);
+    int32_t strength = LegacyGet(p, STAT_STRENGTH);
+    int32_t dexterity = LegacyGet(p, STAT_DEXTERITY);
+    int32_t vitality = LegacyGet(p, STAT_VITALITY);
+    *LegacySlot(p, STAT_ITEM_MAXDAMAGE_PERCENT) =
+        Percent(LegacyGet(p, STAT_ITEM_MAXDAMAGE_PERCENT) + PerStat(strength, 256), 0);
+    *LegacySlot(p, STAT_ITEM_MINDAMAGE_PERCENT) =
+        Percent(LegacyGet(p, STAT_ITEM_MINDAMAGE_PERCENT) + PerStat(strength, 256), 0);
+    *LegacySlot(p, STAT_MAXHP) = Percent(LegacyGet(p, STAT_MAXHP) + PerStat(vitality, 512) + PerStat(level, 512) +
+                                             PerLevel(LegacyGet(p, STAT_ITEM_HP_PERLEVEL), level, 32),
+                                         LegacyGet(p, STAT_ITEM_MAXHP_PERCENT));
+    *LegacySlot(p, STAT_MAXSTAMINA) = Percent(LegacyGet(p, STAT_MAXSTAMINA) + PerStat(vitality, 256), 0);
+    *LegacySlot(p, STAT_MAXMANA) =
+        Percent(LegacyGet(p, STAT_MAXMANA) + PerStat(LegacyGet(p, STAT_ENERGY), 384) +
+                    PerLevel(LegacyGet(p, STAT_ITEM_MANA_PERLEVEL), level, 32),
+                LegacyGet(p, STAT_ITEM_MAXMANA_PERCENT));
+    *LegacySlot(p, STAT_TOHIT) =
+        Percent(LegacyGet(p, STAT_TOHIT) + PerStat(dexterity, 1280), LegacyGet(p, STAT_ITEM_TOHIT_PERCENT));
+    *LegacySlot(p, STAT_ARMORCLASS) = Percent(LegacyGet(p, STAT_ARMORCLASS) + PerStat(dexterity, 64) +
+                                                  PerLevel(LegacyGet(p, STAT_ITEM_ARMOR_PERLEVEL), level, 32),
+                                              LegacyGet(p, STAT_ITEM_ARMOR_PERCENT));
+    *LegacySlot(p, STAT_MAXDAMAGE) =
+        Percent(LegacyGet(p, STAT_MAXDAMAGE) + PerLevel(LegacyGet(p, STAT_ITEM_MAXDAMAGE_PERLEVEL), level, 32),
+                LegacyGet(p, STAT_ITEM_MAXDAMAGE_PERCENT));
+    *LegacySlot(p, STAT_MINDAMAGE) = Percent(LegacyGet(p, STAT_MINDAMAGE), LegacyGet(p, STAT_ITEM_MINDAMAGE_PERCENT));
+}
+
+static void LegacySetLayer(Player *pPlayer, DWORD sourceId, const ModList *pMods)
+{
+    for (size_t l = 0; l < pPlayer->layers.size(); l++)
+    {
+        if (pPlayer->layers[l].sourceId == sourceId)
+        {
+            if (pMods)
+                pPlayer->layers[l].mods = *pMods;
+            else
+                pPlayer->layers.erase(pPlayer->layers.begin() + l);
+            return;
+        }
+    }
+    if (pMods)
+    {
+        LegacyLayer layer = {sourceId, *pMods};
+        pPlayer->layers.push_back(layer);
+    }
+}
+
+// =============================================================================
+// SETUP
+// =============================================================================
+
+static DWORD g_rng = 0x5EED;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static ModList RandomItem(void)
+{
+    ModList mods;
+    for (DWORD m = 0; m < MODS_PER_ITEM; m++)
+    {
+        StatMod mod = {s_itemStats[NextRandom() % D2_ARRAY_SIZE(s_itemStats)], (int32_t)(NextRandom() % 40) + 1};
+        mods.push_back(mod);
+    }
+    return mods;
+}
+
+static ModList g_auras[AURA_COUNT];
+
+static void BuildAuras(void)
+{
+    // Might, Fanaticism, Holy Freeze, Defiance, Battle Orders-like, Concentration
+    StatMod might[] = {{STAT_ITEM_MAXDAMAGE_PERCENT, 150}, {STAT_ITEM_MINDAMAGE_PERCENT, 150}};
+    StatMod fanat[] = {{STAT_ITEM_MAXDAMAGE_PERCENT, 180}, {STAT_ITEM_TOHIT_PERCENT, 90}, {105, 30}};
+    StatMod freeze[] = {{STAT_COLDRESIST, 40}, {STAT_MINDAMAGE, 30}, {STAT_MAXDAMAGE, 60}};
+    StatMod defiance[] = {{STAT_ITEM_ARMOR_PERCENT, 200}};
+    StatMod orders[] = {{STAT_ITEM_MAXHP_PERCENT, 80}, {STAT_ITEM_MAXMANA_PERCENT, 80}};
+    StatMod conc[] = {{STAT_ITEM_MAXDAMAGE_PERCENT, 120}, {STAT_ITEM_MINDAMAGE_PERCENT, 120}, {136, 20}};
+    g_auras[0].assign(might, might + D2_ARRAY_SIZE(might));
+    g_auras[1].assign(fanat, fanat + D2_ARRAY_SIZE(fanat));
+    g_auras[2].assign(freeze, freeze + D2_ARRAY_SIZE(freeze));
+    g_auras[3].assign(defiance, defiance + D2_ARRAY_SIZE(defiance));
+    g_auras[4].assign(orders, orders + D2_ARRAY_SIZE(orders));
+    g_auras[5].assign(conc, conc + D2_ARRAY_SIZE(conc));
+}
+
+static void SetLayer(Player *pPlayer, DWORD sourceId, const ModList *pMods)
+{
+    LegacySetLayer(pPlayer, sourceId, pMods);
+    if (pMods)
+        STATENGINE_AddLayer(pPlayer->pUnit, sourceId, &(*pMods)[0], (DWORD)pMods->size());
+    else
+        STATENGINE_RemoveLayer(pPlayer->pUnit, sourceId);
+}
+
+static DWORD CompareAll(Player *pPlayer)
+{
+    const int32_t *pFinal = STATENGINE_GetAll(pPlayer->pUnit);
+    for (WORD stat = 0; stat < STAT_COUNT_D2; stat++)
+    {
+        if (pFinal[stat] != LegacyGet(pPlayer, stat))
+            return 1;
+    }
+    return 0;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// =============================================================================
+// MAIN
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+    DWORD events = (argc > 1) ? (DWORD)atoi(argv[1]) : 20000;
+    BOOL ok = TRUE;
+
+    // A cycle (vitality <- maxhp <- vitality) must be refused
+    StatRule cyclic[] = {{STATOP_PER_STAT, STAT_MAXHP, STAT_VITALITY, 0, 256},
+                         {STATOP_PER_STAT, STAT_VITALITY, STAT_MAXHP, 0, 256}};
+    StatSchema *pCyclic = STATSCHEMA_Create(STAT_COUNT_D2, cyclic, 2);
+    BOOL cyclicRejected = pCyclic == NULL;
+    STATSCHEMA_Destroy(pCyclic);
+
+    StatSchema *pSchema = STATSCHEMA_CreateDefault();
+    if (!pSchema)
+    {
+        printf("default schema rejected\n");
+        return 1;
+    }
+
+    BuildAuras();
+    DWORD activeAura = 0;
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        Player *pPlayer = &g_players[p];
+        pPlayer->pUnit = STATENGINE_CreateUnit(pSchema);
+
+        StatMod base[] = {{STAT_STRENGTH, 100 + (int32_t)(NextRandom() % 100)},
+                          {STAT_DEXTERITY, 60 + (int32_t)(NextRandom() % 100)},
+                          {STAT_VITALITY, 200 + (int32_t)(NextRandom() % 200)},
+                          {STAT_ENERGY, 15 + (int32_t)(NextRandom() % 50)},
+                          {STAT_LEVEL, 85 + (int32_t)(NextRandom() % 14)}};
+        ModList baseMods(base, base + D2_ARRAY_SIZE(base));
+        LegacySetLayer(pPlayer, 0, &baseMods);
+        for (DWORD i = 0; i < D2_ARRAY_SIZE(base); i++)
+        {
+            STATENGINE_SetBase(pPlayer->pUnit, base[i].stat, base[i].value);
+        }
+
+        ModList synergy = RandomItem();
+        SetLayer(pPlayer, SOURCE_SYNERGY, &synergy);
+        for (DWORD i = 0; i < ITEMS_PER_PLAYER; i++)
+        {
+            ModList item = RandomItem();
+            SetLayer(pPlayer, 1000 + p * 100 + i, &item);
+        }
+        for (DWORD s = 0; s < SWAP_SETS; s++)
+        {
+            pPlayer->weaponSets[s][0] = RandomItem();
+            pPlayer->weaponSets[s][1] = RandomItem();
+        }
+        SetLayer(pPlayer, 1000 + p * 100 + 90, &pPlayer->weaponSets[0][0]);
+        SetLayer(pPlayer, 1000 + p * 100 + 91, &pPlayer->weaponSets[0][1]);
+        SetLayer(pPlayer, SOURCE_AURA(activeAura), &g_auras[activeAura]);
+        SetLayer(pPlayer, SOURCE_AURA(4), &g_auras[4]);
+        LegacyRebuild(pPlayer);
+        ok &= !CompareAll(pPlayer);
+    }
+
+    double rebuildSeconds = 0, incrementalSeconds = 0;
+    DWORD mismatches = 0, auraToggles = 0, gearSwaps = 0;
+    int64_t rebuildSink = 0, incrementalSink = 0;
+
+    for (DWORD e = 0; e < events; e++)
+    {
+        Player *pTargets[PLAYERS];
+        DWORD targetCount = 0;
+        DWORD fromSource = 0, toSource = 0;
+        const ModList *pTo = NULL;
+        const ModList *pSwap[2] = {NULL, NULL};
+        DWORD swapIds[2] = {0, 0};
+
+        if (NextRandom() % 10 < 7)
+        {
+            // Aura toggle on the whole party (aura 4 stays up)
+            DWORD next = NextRandom() % AURA_COUNT;
+            if (next == 4 || next == activeAura)
+                next = (activeAura + 1) % 4;
+            fromSource = SOURCE_AURA(activeAura);
+            toSource = SOURCE_AURA(next);
+            pTo = &g_auras[next];
+            activeAura = next;
+            for (DWORD p = 0; p < PLAYERS; p++)
+                pTargets[targetCount++] = &g_players[p];
+            auraToggles++;
+        }
+        else
+        {
+            DWORD p = NextRandom() % PLAYERS;
+            Player *pPlayer = &g_players[p];
+            pPlayer->activeSet ^= 1;
+            swapIds[0] = 1000 + p * 100 + 90;
+            swapIds[1] = 1000 + p * 100 + 91;
+            pSwap[0] = &pPlayer->weaponSets[pPlayer->activeSet][0];
+            pSwap[1] = &pPlayer->weaponSets[pPlayer->activeSet][1];
+            pTargets[targetCount++] = pPlayer;
+            gearSwaps++;
+        }
+
+        // Full rebuild per change
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (DWORD t = 0; t < targetCount; t++)
+        {
+            Player *pPlayer = pTargets[t];
+            if (pTo)
+            {
+                LegacySetLayer(pPlayer, fromSource, NULL);
+                LegacyRebuild(pPlayer);
+                LegacySetLayer(pPlayer, toSource, pTo);
+                LegacyRebuild(pPlayer);
+            }
+            else
+            {
+                for (DWORD w = 0; w < 2; w++)
+                {
+                    LegacySetLayer(pPlayer, swapIds[w], pSwap[w]);
+                    LegacyRebuild(pPlayer);
+                }
+            }
+            for (DWORD r = 0; r < D2_ARRAY_SIZE(s_readStats); r++)
+                rebuildSink += LegacyGet(pPlayer, s_readStats[r]);
+        }
+        rebuildSeconds += Seconds(start);
+
+        // Incremental
+        start = std::chrono::steady_clock::now();
+        for (DWORD t = 0; t < targetCount; t++)
+        {
+            StatUnit *pUnit = pTargets[t]->pUnit;
+            if (pTo)
+            {
+                STATENGINE_RemoveLayer(pUnit, fromSource);
+                STATENGINE_AddLayer(pUnit, toSource, &(*pTo)[0], (DWORD)pTo->size());
+            }
+            else
+            {
+                for (DWORD w = 0; w < 2; w++)
+                    STATENGINE_AddLayer(pUnit, swapIds[w], &(*pSwap[w])[0], (DWORD)pSwap[w]->size());
+            }
+            for (DWORD r = 0; r < D2_ARRAY_SIZE(s_readStats); r++)
+                incrementalSink += STATENGINE_Get(pUnit, s_readStats[r]);
+        }
+        incrementalSeconds += Seconds(start);
+
+        for (DWORD t = 0; t < targetCount; t++)
+        {
+            mismatches += CompareAll(pTargets[t]);
+        }
+    }
+
+    // A full rebuild of the engine's own layers must land on the same values
+    DWORD rebuildMismatches = 0;
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        STATENGINE_RebuildAll(g_players[p].pUnit);
+        rebuildMismatches += CompareAll(&g_players[p]);
+    }
+
+    StatEngineStats stats = {0, 0, 0};
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        StatEngineStats unitStats;
+        STATENGINE_GetStats(g_players[p].pUnit, &unitStats);
+        stats.layerChanges += unitStats.layerChanges;
+        stats.derivations += unitStats.derivations;
+        stats.unchanged += unitStats.unchanged;
+    }
+
+    printf("party:   %u players, %u layers each, %u events (%u aura toggles, %u weapon swaps)\n", PLAYERS,
+           STATENGINE_GetLayerCount(g_players[0].pUnit), events, auraToggles, gearSwaps);
+    printf("  rebuild:     %8.2f us/event\n", rebuildSeconds * 1e6 / events);
+    printf("  incremental: %8.2f us/event (%.1fx), %.1f derivations per layer change, %.0f%% stopped early\n",
+           incrementalSeconds * 1e6 / events, incrementalSeconds > 0 ? rebuildSeconds / incrementalSeconds : 0.0,
+           stats.layerChanges ? (double)stats.derivations / stats.layerChanges : 0.0,
+           stats.derivations ? 100.0 * stats.unchanged / stats.derivations : 0.0);
+    printf("verify:  all %u stats vs rebuild after every event: %u mismatches -> %s\n", STAT_COUNT_D2, mismatches,
+           mismatches ? "FAILED" : "ok");
+    printf("verify:  RebuildAll matches incremental: %u mismatches, cyclic schema %s -> %s\n", rebuildMismatches,
+           cyclicRejected ? "rejected" : "accepted", (!rebuildMismatches && cyclicRejected) ? "ok" : "FAILED");
+    ok &= !mismatches && !rebuildMismatches && cyclicRejected && rebuildSink == incrementalSink;
+
+    for (DWORD p = 0; p < PLAYERS; p++)
+    {
+        STATENGINE_DestroyUnit(g_players[p].pUnit);
+    }
+    STATSCHEMA_Destroy(pSchema);
+    return ok ? 0 : 1;
+}
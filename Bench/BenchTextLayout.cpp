@@ -0,0 +1,360 @@
+/*
+ * BenchTextLayout.cpp - Tooltip/inventory-heavy UI frame benchmark
+ *
+ * Draws a frame of inventory labels, item tooltips (composed text with color
+ * codes and word wrap) and menu strings, two ways:
+ *   1. uncached - shape every string every frame (what D2Win does today)
+ *   2. cached   - TextLayoutCache lookup + batched blit
+ * Both paths render into their own surface; the surfaces are compared at the
+ * end so a layout bug shows up as a mismatch rather than a fast number.
+ *
+ * A last check fills a small atlas in the middle of a batch: the flush must
+ * refuse the stale batch, and the refilled batch must draw exactly what
+ * per-string drawing into a roomy atlas does.
+ *
+ * Usage: bench_textlayout [frames]
+ */
+
+#include "../Win/TextLayout.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCREEN_W 800
+#define SCREEN_H 600
+#define STRING_COUNT 512
+#define TOOLTIP_COUNT 12
+#define LABEL_COUNT 60
+
+static const BYTE kLineHeights[3] = {10, 14, 16};
+
+static D2UNICHAR g_strings[STRING_COUNT][48];
+static D2UNICHAR g_tooltips[TOOLTIP_COUNT][512];
+static BYTE g_glyphPixels[32 * 32];
+static BYTE g_colorRemaps[TEXT_COLOR_COUNT][256];
+
+// Synthetic DC6 font: deterministic widths and patterns per character
+static BOOL __cdecl GetGlyph(void *pUserData, DWORD fontId, D2UNICHAR ch, GlyphBitmap *pOut)
+{
+    (void)pUserData;
+
+    BYTE height = (BYTE)(kLineHeights[fontId] - 2);
+    pOut->advance = (BYTE)(4 + (ch * 7 + fontId) % 6);
+
+    if (ch == ' ')
+    {
+        pOut->pixels = NULL;
+        pOut->width = 0;
+        pOut->height = 0;
+        return TRUE;
+    }
+
+    pOut->width = (BYTE)(pOut->advance - 1);
+    pOut->height = height;
+    pOut->pitch = 32;
+    pOut->offsetY = 1;
+    for (DWORD y = 0; y < height; y++)
+    {
+        for (DWORD x = 0; x < pOut->width; x++)
+        {
+            g_glyphPixels[y * 32 + x] = (BYTE)(((x + y + ch) % 3) ? 0 : 1 + (ch % 200));
+        }
+    }
+    pOut->pixels = g_glyphPixels;
+    return TRUE;
+}
+
+static const D2UNICHAR *__cdecl GetString(void *pUserData, DWORD stringId)
+{
+    (void)pUserData;
+    return g_strings[stringId % STRING_COUNT];
+}
+
+static void AsciiToUnicode(D2UNICHAR *pOut, const char *pIn)
+{
+    while (*pIn)
+    {
+        *pOut++ = (BYTE)*pIn++;
+    }
+    *pOut = 0;
+}
+
+static void BuildTestData(void)
+{
+    static const char *kWords[] = {"Sword", "of", "the", "Gods", "Shako", "Grand", "Charm", "Rune",
+                                   "Defense", "Durability", "Enhanced", "Damage", "Resist", "All", "Fire", "Cold"};
+    char buffer[512];
+
+    for (DWORD i = 0; i < STRING_COUNT; i++)
+    {
+        sprintf(buffer, "%s %s %u", kWords[i % 16], kWords[(i * 7) % 16], i);
+        AsciiToUnicode(g_strings[i], buffer);
+    }
+
+    for (DWORD t = 0; t < TOOLTIP_COUNT; t++)
+    {
+        int n = sprintf(buffer, "\xFF" "c4Unique %s %u\n\xFF" "c0Defense: %u\n", kWords[t % 16], t, 100 + t);
+        for (DWORD line = 0; line < 8; line++)
+        {
+            n += sprintf(buffer + n, "\xFF" "c3+%u%% %s %s %s to %s\n", 10 + line * t, kWords[line], kWords[(line + t) % 16],
+                         kWords[(line * 3) % 16], kWords[(line + 5) % 16]);
+        }
+        sprintf(buffer + n, "\xFF" "c1Requirements not met - this is a long line that has to wrap");
+        AsciiToUnicode(g_tooltips[t], buffer);
+    }
+
+    for (DWORD c = 0; c < TEXT_COLOR_COUNT; c++)
+    {
+        for (DWORD i = 0; i < 256; i++)
+        {
+            g_colorRemaps[c][i] = (BYTE)(i ? (16 + c * 16 + (i & 15)) : 0);
+        }
+    }
+}
+
+typedef struct DrawItem
+{
+    BOOL isTooltip;
+    DWORD id;
+    DWORD fontId;
+    DWORD maxWidth;
+    int x;
+    int y;
+} DrawItem;
+
+static DWORD BuildFrame(DrawItem *pItems, DWORD frame)
+{
+    DWORD count = 0;
+
+    // Inventory labels: fixed slots, string ids rotate slowly
+    for (DWORD i = 0; i < LABEL_COUNT; i++)
+    {
+        DrawItem *pItem = &pItems[count++];
+        pItem->isTooltip = FALSE;
+        pItem->id = (i * 13 + frame / 120) % STRING_COUNT;
+        pItem->fontId = 0;
+        pItem->maxWidth = 0;
+        pItem->x = (int)(420 + (i % 4) * 95);
+        pItem->y = (int)(40 + (i / 4) * 24);
+    }
+
+    // Tooltips: the stash/inventory hover case, several on screen (compare)
+    for (DWORD t = 0; t < 4; t++)
+    {
+        DrawItem *pItem = &pItems[count++];
+        pItem->isTooltip = TRUE;
+        pItem->id = (t + frame / 30) % TOOLTIP_COUNT;
+        pItem->fontId = 1;
+        pItem->maxWidth = 260;
+        pItem->x = (int)(10 + t * 100);
+        pItem->y = (int)(60 + t * 40);
+    }
+
+    // Menu/HUD strings in the large font
+    for (DWORD m = 0; m < 6; m++)
+    {
+        DrawItem *pItem = &pItems[count++];
+        pItem->isTooltip = FALSE;
+        pItem->id = 400 + m;
+        pItem->fontId = 2;
+        pItem->maxWidth = 0;
+        pItem->x = 20;
+        pItem->y = (int)(400 + m * 30);
+    }
+
+    return count;
+}
+
+/*
+ * CheckAtlasOverflow
+ * A 64x24 atlas holds the warm-up glyphs, or the three lines' glyphs, but
+ * not both: the third line's lookup resets it while the first two lines are
+ * already batched.
+ */
+static BOOL CheckAtlasOverflow(void)
+{
+    static const char *kWarmUp = "ABCDEFGHIJKLMNOP";
+    static const char *kLines[3] = {"abcdefgh", "ijklmnop", "qrstuvwx"};
+    GlyphAtlas small, roomy;
+    TextLayoutCache cache;
+    TextBatch batch;
+    TextLayout scratch;
+    TextSurface surfaces[2];
+    D2UNICHAR text[32];
+
+    memset(&scratch, 0, sizeof(scratch));
+    if (!GLYPHATLAS_Init(&small, 64, 24, GetGlyph, NULL) || !GLYPHATLAS_Init(&roomy, 512, 512, GetGlyph, NULL) ||
+        !TEXTLAYOUT_InitCache(&cache, &small, 64, GetString, NULL) || !TEXTLAYOUT_InitBatch(&batch, 0))
+    {
+        return FALSE;
+    }
+    GLYPHATLAS_RegisterFont(&small, 0, kLineHeights[0]);
+    GLYPHATLAS_RegisterFont(&roomy, 0, kLineHeights[0]);
+    for (int s = 0; s < 2; s++)
+    {
+        surfaces[s].width = 128;
+        surfaces[s].height = 64;
+        surfaces[s].pitch = 128;
+        surfaces[s].pixels = (BYTE *)calloc(128 * 64, 1);
+    }
+
+    AsciiToUnicode(text, kWarmUp);
+    TEXTLAYOUT_GetText(&cache, text, 0, 0);
+    DWORD resets = small.resets;
+
+    BOOL refused = FALSE;
+    BOOL drawn = FALSE;
+    for (DWORD attempt = 0; !drawn && attempt < 2; attempt++)
+    {
+        for (DWORD l = 0; l < 3; l++)
+        {
+            AsciiToUnicode(text, kLines[l]);
+            TEXTLAYOUT_AddToBatch(&batch, TEXTLAYOUT_GetText(&cache, text, 0, 0), 4, (int)(4 + l * 12), 0);
+        }
+        drawn = TEXTLAYOUT_FlushBatch(&batch, &small, &surfaces[0], g_colorRemaps);
+        refused = refused || !drawn;
+    }
+
+    // Reference: each line on its own, into an atlas that never fills
+    for (DWORD l = 0; l < 3; l++)
+    {
+        AsciiToUnicode(text, kLines[l]);
+        TEXTLAYOUT_Build(&roomy, text, 0, 0, &scratch);
+        TEXTLAYOUT_AddToBatch(&batch, &scratch, 4, (int)(4 + l * 12), 0);
+        TEXTLAYOUT_FlushBatch(&batch, &roomy, &surfaces[1], g_colorRemaps);
+    }
+
+    BOOL match = memcmp(surfaces[0].pixels, surfaces[1].pixels, 128 * 64) == 0;
+    BOOL ok = small.resets > resets && refused && drawn && match;
+    printf("atlas overflow:    %s, refilled batch %s -> %s\n",
+           refused ? "stale batch refused" : "stale batch NOT detected", match ? "identical" : "MISMATCH",
+           ok ? "ok" : "FAILED");
+
+    TEXTLAYOUT_Free(&scratch);
+    TEXTLAYOUT_FreeBatch(&batch);
+    TEXTLAYOUT_FreeCache(&cache);
+    GLYPHATLAS_Free(&small);
+    GLYPHATLAS_Free(&roomy);
+    free(surfaces[0].pixels);
+    free(surfaces[1].pixels);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    DWORD frames = (argc > 1) ? (DWORD)atoi(argv[1]) : 2000;
+    DrawItem items[LABEL_COUNT + 16];
+    GlyphAtlas atlas;
+    TextLayoutCache cache;
+    TextBatch batch;
+    TextLayout scratch;
+    TextSurface surfaces[2];
+
+    BuildTestData();
+    memset(&scratch, 0, sizeof(scratch));
+
+    if (!GLYPHATLAS_Init(&atlas, 512, 512, GetGlyph, NULL) ||
+        !TEXTLAYOUT_InitCache(&cache, &atlas, 1024, GetString, NULL) ||
+        !TEXTLAYOUT_InitBatch(&batch, 4096))
+    {
+        printf("initialization failed\n");
+        return 1;
+    }
+    for (DWORD f = 0; f < 3; f++)
+    {
+        GLYPHATLAS_RegisterFont(&atlas, f, kLineHeights[f]);
+    }
+
+    for (int s = 0; s < 2; s++)
+    {
+        surfaces[s].width = SCREEN_W;
+        surfaces[s].height = SCREEN_H;
+        surfaces[s].pitch = SCREEN_W;
+        surfaces[s].pixels = (BYTE *)calloc(SCREEN_W * SCREEN_H, 1);
+    }
+
+    DWORD glyphsDrawn = 0;
+    double elapsed[2] = {0, 0};
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+        TextSurface *pSurface = &surfaces[mode];
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (DWORD frame = 0; frame < frames; frame++)
+        {
+            memset(pSurface->pixels, 0, SCREEN_W * SCREEN_H);
+            DWORD count = BuildFrame(items, frame);
+
+            // A string table edit every 100 frames (e.g. a changed HUD label)
+            if (mode == 1 && frame % 100 == 99)
+            {
+                TEXTLAYOUT_InvalidateString(&cache, 402);
+            }
+
+            // A batch the atlas was reset under is refused; fill it again
+            BOOL drawn = FALSE;
+            for (DWORD attempt = 0; !drawn && attempt < 2; attempt++)
+            {
+                for (DWORD i = 0; i < count; i++)
+                {
+                    const DrawItem *pItem = &items[i];
+                    const D2UNICHAR *pText = pItem->isTooltip ? g_tooltips[pItem->id] : g_strings[pItem->id];
+                    const TextLayout *pLayout;
+
+                    if (mode == 0)
+                    {
+                        TEXTLAYOUT_Build(&atlas, pText, pItem->fontId, pItem->maxWidth, &scratch);
+                        pLayout = &scratch;
+                    }
+                    else if (pItem->isTooltip)
+                    {
+                        pLayout = TEXTLAYOUT_GetText(&cache, pText, pItem->fontId, pItem->maxWidth);
+                    }
+                    else
+                    {
+                        pLayout = TEXTLAYOUT_GetString(&cache, pItem->id, pItem->fontId, pItem->maxWidth);
+                    }
+
+                    if (mode == 1 && frame == 0 && attempt == 0)
+                    {
+                        glyphsDrawn += pLayout ? pLayout->quadCount : 0;
+                    }
+                    TEXTLAYOUT_AddToBatch(&batch, pLayout, pItem->x, pItem->y, 0);
+
+                    // The uncached path blits per string, as D2Win does
+                    if (mode == 0)
+                    {
+                        TEXTLAYOUT_FlushBatch(&batch, &atlas, pSurface, g_colorRemaps);
+                    }
+                }
+
+                drawn = TEXTLAYOUT_FlushBatch(&batch, &atlas, pSurface, g_colorRemaps);
+            }
+        }
+
+        elapsed[mode] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    BOOL match = memcmp(surfaces[0].pixels, surfaces[1].pixels, SCREEN_W * SCREEN_H) == 0;
+
+    printf("frames:            %u (%u glyph quads per frame)\n", frames, glyphsDrawn);
+    printf("uncached:          %8.3f us/frame\n", elapsed[0] * 1e6 / frames);
+    printf("cached + batched:  %8.3f us/frame  (%.2fx)\n", elapsed[1] * 1e6 / frames,
+           elapsed[1] > 0 ? elapsed[0] / elapsed[1] : 0.0);
+    printf("cache: %u hits, %u misses, %u rebuilds, %u evictions; atlas %u glyphs, %u resets\n",
+           cache.stats.hits, cache.stats.misses, cache.stats.rebuilds, cache.stats.evictions,
+           atlas.glyphsPacked, atlas.resets);
+    printf("output:            %s\n", match ? "identical" : "MISMATCH");
+    match = CheckAtlasOverflow() && match;
+
+    TEXTLAYOUT_Free(&scratch);
+    TEXTLAYOUT_FreeBatch(&batch);
+    TEXTLAYOUT_FreeCache(&cache);
+    GLYPHATLAS_Free(&atlas);
+    free(surfaces[0].pixels);
+    free(surfaces[1].pixels);
+    return match ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+/*
+ * BenchUnitStore.cpp - Per-tick unit update, AoS unit records vs UnitStore
+ *
+ *   aos:  D2Common's layout. ~0xF4 byte Unit records and separate
+ *         DynamicPath blocks allocated in spawn order between other heap
+ *         traffic, reached by walking the game's 6x128 unit hash lists.
+ *   soa:  UnitStore hot arrays, one dense pass for movement and one for
+ *         animation (UNITSTORE_Tick).
+ *
+ * Both receive the same commands every tick (new move targets, animation
+ * changes, and a small despawn/respawn churn) and run the same arithmetic,
+ * so after every tick each unit's position, frame and flags must match
+ * exactly. Stale handles must stop resolving after despawn.
+ *
+ * Usage: bench_unitstore [units] [ticks]
+ */
+
+#include "../Common/UnitStore.hpp"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define UNIT_TYPES 6
+#define HASH_BUCKETS 128
+
+// =============================================================================
+// AOS BASELINE
+// =============================================================================
+
+typedef struct LegacyPath
+{
+    BYTE reserved[0x30];
+    float x;
+    float y;
+    float targetX;
+    float targetY;
+    float speed;
+    BYTE tail[0x3C];
+} LegacyPath;
+
+typedef struct LegacyUnit
+{
+    DWORD dwType;
+    DWORD dwClassId;
+    void *pMemPool;
+    DWORD dwUnitId;
+    DWORD dwAnimMode;
+    BYTE reserved[0x28];
+    LegacyPath *pPath;
+    BYTE reserved2[0x24];
+    DWORD dwFrame;
+    DWORD dwFrameRate;
+    DWORD dwFrameLength;
+    BYTE reserved3[0x50];
+    DWORD dwFlags;
+    BYTE reserved4[0x1C];
+    struct LegacyUnit *pHashNext;
+    BYTE tail[0x10];
+} LegacyUnit;
+
+static LegacyUnit *g_unitHash[UNIT_TYPES][HASH_BUCKETS];
+
+static void LegacyTick(void)
+{
+    for (DWORD t = 0; t < UNIT_TYPES; t++)
+    {
+        for (DWORD b = 0; b < HASH_BUCKETS; b++)
+        {
+            for (LegacyUnit *pUnit = g_unitHash[t][b]; pUnit; pUnit = pUnit->pHashNext)
+            {
+                DWORD f = pUnit->dwFlags & ~(UNITFLAG_ARRIVED | UNITFLAG_ANIM_DONE);
+                if (f & UNITFLAG_MOVING)
+                {
+                    LegacyPath *pPath = pUnit->pPath;
+                    float dx = pPath->targetX - pPath->x;
+                    float dy = pPath->targetY - pPath->y;
+                    float dist2 = dx * dx + dy * dy;
+                    float step = pPath->speed;
+                    if (dist2 <= step * step)
+                    {
+                        pPath->x = pPath->targetX;
+                        pPath->y = pPath->targetY;
+                        f = (f & ~UNITFLAG_MOVING) | UNITFLAG_ARRIVED;
+                    }
+                    else
+                    {
+                        float scale = step / sqrtf(dist2);
+                        pPath->x += dx * scale;
+                        pPath->y += dy * scale;
+                    }
+                }
+
+                if (f & UNITFLAG_ANIMATING)
+                {
+                    DWORD frame = pUnit->dwFrame + pUnit->dwFrameRate;
+                    if (frame >= pUnit->dwFrameLength)
+                    {
+                        if ((f & UNITFLAG_ANIM_LOOP) && pUnit->dwFrameLength)
+                        {
+                            frame %= pUnit->dwFrameLength;
+                        }
+                        else
+                        {
+                            frame = pUnit->dwFrameLength ? pUnit->dwFrameLength - 0x100 : 0;
+                            f = (f & ~UNITFLAG_ANIMATING) | UNITFLAG_ANIM_DONE;
+                        }
+                    }
+                    pUnit->dwFrame = frame;
+                }
+                pUnit->dwFlags = f;
+            }
+        }
+    }
+}
+
+static void LegacyLink(LegacyUnit *pUnit)
+{
+    LegacyUnit **ppBucket = &g_unitHash[pUnit->dwType][pUnit->dwUnitId % HASH_BUCKETS];
+    pUnit->pHashNext = *ppBucket;
+    *ppBucket = pUnit;
+}
+
+static void LegacyUnlink(LegacyUnit *pUnit)
+{
+    LegacyUnit **ppLink = &g_unitHash[pUnit->dwType][pUnit->dwUnitId % HASH_BUCKETS];
+    while (*ppLink != pUnit)
+    {
+        ppLink = &(*ppLink)->pHashNext;
+    }
+    *ppLink = pUnit->pHashNext;
+}
+
+// =============================================================================
+// SIMULATION
+// =============================================================================
+
+typedef struct SimUnit
+{
+    LegacyUnit *pLegacy;
+    UnitHandle handle;
+} SimUnit;
+
+static std::vector<SimUnit> g_units;
+static std::vector<void *> g_noise;
+static DWORD g_rng = 0xBADC0DE;
+static DWORD g_nextUnitId = 1;
+
+static DWORD NextRandom(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static float RandomFloat(float lo, float hi)
+{
+    return lo + (hi - lo) * (float)(NextRandom() & 0xFFFFFF) / 16777216.0f;
+}
+
+static BOOL SpawnUnit(UnitStore *pStore, SimUnit *pSim)
+{
+    BYTE type = (BYTE)(NextRandom() % UNIT_TYPES);
+    float x = RandomFloat(0.0f, 1000.0f);
+    float y = RandomFloat(0.0f, 1000.0f);
+
+    LegacyUnit *pUnit = (LegacyUnit *)calloc(1, sizeof(LegacyUnit));
+    g_noise.push_back(malloc(32 + NextRandom() % 256));
+    pUnit->pPath = (LegacyPath *)calloc(1, sizeof(LegacyPath));
+    g_noise.push_back(malloc(32 + NextRandom() % 256));
+    pUnit->dwType = type;
+    pUnit->dwUnitId = g_nextUnitId++;
+    pUnit->pPath->x = pUnit->pPath->targetX = x;
+    pUnit->pPath->y = pUnit->pPath->targetY = y;
+    LegacyLink(pUnit);
+
+    pSim->pLegacy = pUnit;
+    pSim->handle = UNITSTORE_Spawn(pStore, type, x, y);
+    return pSim->handle != UNIT_INVALID_HANDLE;
+}
+
+static void DespawnUnit(UnitStore *pStore, SimUnit *pSim)
+{
+    LegacyUnlink(pSim->pLegacy);
+    free(pSim->pLegacy->pPath);
+    free(pSim->pLegacy);
+    UNITSTORE_Despawn(pStore, pSim->handle);
+}
+
+// Same command to both layouts
+static void IssueCommands(UnitStore *pStore, DWORD unitCount)
+{
+    for (DWORD n = 0; n < unitCount / 20; n++)
+    {
+        SimUnit *pSim = &g_units[NextRandom() % unitCount];
+        LegacyUnit *pUnit = pSim->pLegacy;
+
+        if (NextRandom() & 1)
+        {
+            float tx = pUnit->pPath->x + RandomFloat(-30.0f, 30.0f);
+            float ty = pUnit->pPath->y + RandomFloat(-30.0f, 30.0f);
+            float speed = RandomFloat(0.2f, 1.2f);
+            pUnit->pPath->targetX = tx;
+            pUnit->pPath->targetY = ty;
+            pUnit->pPath->speed = speed;
+            pUnit->dwFlags = (pUnit->dwFlags & ~UNITFLAG_ARRIVED) | UNITFLAG_MOVING;
+            UNITSTORE_MoveTo(pStore, pSim->handle, tx, ty, speed);
+        }
+        else
+        {
+            BYTE mode = (BYTE)(NextRandom() % 16);
+            DWORD frames = 8 + NextRandom() % 16;
+            DWORD rate = 64 + NextRandom() % 256;
+            BOOL loop = (NextRandom() % 3) != 0;
+            pUnit->dwAnimMode = mode;
+            pUnit->dwFrame = 0;
+            pUnit->dwFrameRate = rate;
+            pUnit->dwFrameLength = frames << 8;
+            pUnit->dwFlags = (pUnit->dwFlags & ~(UNITFLAG_ANIM_LOOP | UNITFLAG_ANIM_DONE)) | UNITFLAG_ANIMATING |
+                             (loop ? UNITFLAG_ANIM_LOOP : 0);
+            UNITSTORE_SetAnimation(pStore, pSim->handle, mode, frames, rate, loop);
+        }
+    }
+}
+
+static DWORD CompareStates(UnitStore *pStore)
+{
+    UnitHotArrays hot;
+    UNITSTORE_GetHot(pStore, &hot);
+    DWORD mismatches = 0;
+
+    for (size_t i = 0; i < g_units.size(); i++)
+    {
+        const LegacyUnit *pUnit = g_units[i].pLegacy;
+        DWORD d = UNITSTORE_GetIndex(pStore, g_units[i].handle);
+        if (d == UNIT_INVALID_INDEX || hot.x[d] != pUnit->pPath->x || hot.y[d] != pUnit->pPath->y ||
+            hot.animFrame[d] != pUnit->dwFrame || hot.flags[d] != pUnit->dwFlags || hot.type[d] != pUnit->dwType ||
+            hot.mode[d] != pUnit->dwAnimMode)
+        {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    DWORD unitCount = (argc > 1) ? (DWORD)atoi(argv[1]) : 20000;
+    DWORD ticks = (argc > 2) ? (DWORD)atoi(argv[2]) : 250;
+    BOOL ok = TRUE;
+
+    UnitStoreDesc desc;
+    desc.capacity = unitCount;
+    desc.coldSize = 0xC0; // Everything the hot arrays do not carry
+    UnitStore *pStore = UNITSTORE_Create(&desc);
+
+    g_units.resize(unitCount);
+    for (DWORD i = 0; i < unitCount; i++)
+    {
+        ok &= SpawnUnit(pStore, &g_units[i]);
+    }
+
+    double aosSeconds = 0, soaSeconds = 0;
+    DWORD mismatches = 0, staleResolved = 0;
+    uint64_t moved = 0, animated = 0;
+
+    for (DWORD tick = 0; tick < ticks; tick++)
+    {
+        IssueCommands(pStore, unitCount);
+
+        // Churn: 0.5% of units die and are replaced
+        for (DWORD n = 0; n < unitCount / 200; n++)
+        {
+            SimUnit *pSim = &g_units[NextRandom() % unitCount];
+            UnitHandle stale = pSim->handle;
+            DespawnUnit(pStore, pSim);
+            ok &= SpawnUnit(pStore, pSim);
+            staleResolved += UNITSTORE_IsAlive(pStore, stale) || UNITSTORE_GetCold(pStore, stale) != NULL;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        LegacyTick();
+        aosSeconds += Seconds(start);
+
+        UnitTickResult result;
+        start = std::chrono::steady_clock::now();
+        UNITSTORE_Tick(pStore, &result);
+        soaSeconds += Seconds(start);
+
+        moved += result.moved;
+        animated += result.animated;
+        mismatches += CompareStates(pStore);
+    }
+
+    double aosNs = aosSeconds * 1e9 / ((double)ticks * unitCount);
+    double soaNs = soaSeconds * 1e9 / ((double)ticks * unitCount);
+    printf("units:   %u live, %u ticks, %.0f moving and %.0f animating per tick\n", UNITSTORE_GetCount(pStore), ticks,
+           (double)moved / ticks, (double)animated / ticks);
+    printf("  aos:   %7.2f ns/unit, %8.1f us/tick (hash lists, Unit + DynamicPath records)\n", aosNs,
+           aosSeconds * 1e6 / ticks);
+    printf("  soa:   %7.2f ns/unit, %8.1f us/tick (%.2fx)\n", soaNs, soaSeconds * 1e6 / ticks,
+           soaNs > 0 ? aosNs / soaNs : 0.0);
+    printf("verify:  per-tick state vs AoS: %u mismatches -> %s\n", mismatches, mismatches ? "FAILED" : "ok");
+    printf("verify:  stale handles after despawn: %u resolved -> %s\n", staleResolved,
+           staleResolved ? "FAILED" : "ok");
+    ok &= !mismatches && !staleResolved && UNITSTORE_GetCount(pStore) == unitCount;
+
+    for (DWORD i = 0; i < unitCount; i++)
+    {
+        DespawnUnit(pStore, &g_units[i]);
+    }
+    ok &= UNITSTORE_GetCount(pStore) == 0;
+    UNITSTORE_Destroy(pStore);
+    for (size_t i = 0; i < g_noise.size(); i++)
+    {
+        free(g_noise[i]);
+    }
+    return ok ? 0 : 1;
+}
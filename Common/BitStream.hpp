@@ -0,0 +1,200 @@
+/*
+ * BitStream.hpp - D2Common 64-bit buffered bit reader/writer
+ *
+ * D2's item and character formats are LSB-first bit streams: a field of n
+ * bits starts at the lowest unused bit of the current byte. Fog's bit
+ * buffer reads them one field at a time with a byte fetch and shift per
+ * bit group, and a bounds check per call.
+ *
+ * The reader keeps up to 64 bits in a register and refills with a single
+ * unaligned 8-byte load while at least 8 bytes remain (byte at a time near
+ * the end), so a read is a shift and a mask. Reading past the end returns
+ * zeros and sets overrun; callers check it once per record instead of per
+ * field. The writer mirrors it: fields go into the register and whole bytes
+ * are stored as it fills; writing past capacity sets overflow.
+ *
+ * Fields are at most 32 bits. Both are plain structs on the stack with no
+ * allocation; all functions are inline.
+ */
+
+#ifndef BITSTREAM_HPP
+#define BITSTREAM_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#include <string.h>
+
+typedef struct BitReader
+{
+    const BYTE *pData;
+    size_t size;    // Bytes
+    size_t next;    // Next byte to load into the buffer
+    uint64_t buffer; // Unread bits, LSB first
+    DWORD count;    // Valid bits in buffer
+    BOOL overrun;
+} BitReader;
+
+typedef struct BitWriter
+{
+    BYTE *pData;
+    size_t capacity; // Bytes
+    size_t next;     // Next byte to store
+    uint64_t buffer;
+    DWORD count;
+    BOOL overflow;
+} BitWriter;
+
+// =============================================================================
+// READER
+// =============================================================================
+
+static inline void BITREADER_Init(BitReader *pReader, const void *pData, size_t size)
+{
+    pReader->pData = (const BYTE *)pData;
+    pReader->size = size;
+    pReader->next = 0;
+    pReader->buffer = 0;
+    pReader->count = 0;
+    pReader->overrun = FALSE;
+}
+
+static inline void BITREADER_Refill(BitReader *pReader)
+{
+    if (pReader->size - pReader->next >= 8)
+    {
+        // Little-endian load; take as many whole bytes as fit above count
+        uint64_t word;
+        memcpy(&word, pReader->pData + pReader->next, 8);
+        pReader->buffer |= word << pReader->count;
+        pReader->next += (63 - pReader->count) >> 3;
+        pReader->count |= 56;
+        return;
+    }
+    while (pReader->count <= 56 && pReader->next < pReader->size)
+    {
+        pReader->buffer |= (uint64_t)pReader->pData[pReader->next++] << pReader->count;
+        pReader->count += 8;
+    }
+}
+
+// bits in [1, 32]
+static inline DWORD BITREADER_Read(BitReader *pReader, DWORD bits)
+{
+    if (pReader->count < bits)
+    {
+        BITREADER_Refill(pReader);
+        if (pReader->count < bits)
+        {
+            pReader->overrun = TRUE;
+            pReader->buffer = 0;
+            pReader->count = 0;
+            pReader->next = pReader->size;
+            return 0;
+        }
+    }
+    DWORD value = (DWORD)(pReader->buffer & ((1ull << bits) - 1));
+    pReader->buffer >>= bits;
+    pReader->count -= bits;
+    return value;
+}
+
+// Bits consumed so far
+static inline size_t BITREADER_Tell(const BitReader *pReader)
+{
+    return pReader->next * 8 - pReader->count;
+}
+
+// Skip to the next byte boundary
+static inline void BITREADER_Align(BitReader *pReader)
+{
+    DWORD skip = pReader->count & 7;
+    pReader->buffer >>= skip;
+    pReader->count -= skip;
+}
+
+// Restart at a bit position
+static inline void BITREADER_Seek(BitReader *pReader, size_t bit)
+{
+    pReader->buffer = 0;
+    pReader->count = 0;
+    if (bit > pReader->size * 8)
+    {
+        pReader->next = pReader->size;
+        pReader->overrun = TRUE;
+        return;
+    }
+    pReader->next = bit >> 3;
+    if (bit & 7)
+    {
+        BITREADER_Read(pReader, (DWORD)(bit & 7));
+    }
+}
+
+// =============================================================================
+// WRITER
+// =============================================================================
+
+static inline void BITWRITER_Init(BitWriter *pWriter, void *pData, size_t capacity)
+{
+    pWriter->pData = (BYTE *)pData;
+    pWriter->capacity = capacity;
+    pWriter->next = 0;
+    pWriter->buffer = 0;
+    pWriter->count = 0;
+    pWriter->overflow = FALSE;
+}
+
+static inline void BITWRITER_Flush(BitWriter *pWriter)
+{
+    while (pWriter->count >= 8)
+    {
+        if (pWriter->next >= pWriter->capacity)
+        {
+            pWriter->overflow = TRUE;
+            pWriter->count = 0;
+            pWriter->buffer = 0;
+            return;
+        }
+        pWriter->pData[pWriter->next++] = (BYTE)pWriter->buffer;
+        pWriter->buffer >>= 8;
+        pWriter->count -= 8;
+    }
+}
+
+// bits in [1, 32]; value bits above it are ignored
+static inline void BITWRITER_Write(BitWriter *pWriter, DWORD value, DWORD bits)
+{
+    if (pWriter->count + bits > 64)
+    {
+        BITWRITER_Flush(pWriter);
+    }
+    pWriter->buffer |= (uint64_t)(value & (DWORD)((1ull << bits) - 1)) << pWriter->count;
+    pWriter->count += bits;
+}
+
+static inline size_t BITWRITER_Tell(const BitWriter *pWriter)
+{
+    return pWriter->next * 8 + pWriter->count;
+}
+
+// Pad with zero bits to the next byte boundary
+static inline void BITWRITER_Align(BitWriter *pWriter)
+{
+    pWriter->count = (pWriter->count + 7) & ~7u;
+}
+
+// Stores everything written (ending on a byte boundary); FALSE on overflow
+static inline BOOL BITWRITER_Finish(BitWriter *pWriter)
+{
+    BITWRITER_Align(pWriter);
+    BITWRITER_Flush(pWriter);
+    return !pWriter->overflow;
+}
+
+// Bytes stored by Finish
+static inline size_t BITWRITER_Size(const BitWriter *pWriter)
+{
+    return pWriter->next;
+}
+
+#endif // BITSTREAM_HPP
@@ -0,0 +1,378 @@
+/*
+ * CharacterCodec.cpp - D2Common .d2s character codec
+ *
+ * See CharacterCodec.hpp for the file layout. Validate and Decode share one
+ * walk over the sections; the item lists go through ItemCodec.
+ */
+
+#include "CharacterCodec.hpp"
+
+#include "BitStream.hpp"
+
+#include <string.h>
+
+#define OFFSET_SIGNATURE 0
+#define OFFSET_VERSION 4
+#define OFFSET_FILESIZE 8
+#define OFFSET_CHECKSUM 12
+#define OFFSET_NAME 20
+#define OFFSET_STATUS 36
+#define OFFSET_CLASS 40
+#define OFFSET_LEVEL 43
+#define OFFSET_MERC_ID 179
+
+#define ATTRIBUTE_END 0x1FF
+
+// Save widths of the "gf" attributes (ItemStatCost CSvBits)
+static const BYTE s_attributeBits[D2S_ATTRIBUTES] = {
+    10, 10, 10, 10, 10, 8, // strength, energy, dexterity, vitality, statpts, newskills
+    21, 21, 21, 21, 21, 21, // hitpoints, maxhp, mana, maxmana, stamina, maxstamina
+    7,  32, 25, 25,         // level, experience, gold, goldbank
+};
+
+static inline DWORD ReadDword(const BYTE *p)
+{
+    DWORD value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline void WriteDword(BYTE *p, DWORD value)
+{
+    memcpy(p, &value, sizeof(value));
+}
+
+DWORD __cdecl D2S_Checksum(const BYTE *pData, size_t size)
+{
+    DWORD sum = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        BYTE b = (i >= OFFSET_CHECKSUM && i < OFFSET_CHECKSUM + 4) ? 0 : pData[i];
+        sum = ((sum << 1) | (sum >> 31)) + b;
+    }
+    return sum;
+}
+
+// =============================================================================
+// WALK (DECODE / VALIDATE)
+// =============================================================================
+
+typedef struct Cursor
+{
+    const BYTE *pData;
+    size_t size;
+    size_t pos;
+} Cursor;
+
+static inline BOOL TakeMagic(Cursor *pCursor, char a, char b)
+{
+    if (pCursor->size - pCursor->pos < 2 || pCursor->pData[pCursor->pos] != (BYTE)a ||
+        pCursor->pData[pCursor->pos + 1] != (BYTE)b)
+    {
+        return FALSE;
+    }
+    pCursor->pos += 2;
+    return TRUE;
+}
+
+static BOOL WalkItemList(const ItemCodec *pCodec, Cursor *pCursor, D2ItemList *pList, DWORD *pItemCount)
+{
+    const BYTE *p = pCursor->pData + pCursor->pos;
+    size_t left = pCursor->size - pCursor->pos;
+    DWORD count = 0;
+    size_t bytes = 0;
+    BOOL ok = pList ? ITEMCODEC_DecodeList(pCodec, p, left, pList->pItems, pList->capacity, &count, &bytes)
+                    : ITEMCODEC_ValidateList(pCodec, p, left, &count, &bytes);
+    if (!ok)
+    {
+        return FALSE;
+    }
+    if (pList)
+    {
+        pList->count = count;
+    }
+    *pItemCount += count;
+    pCursor->pos += bytes;
+    return TRUE;
+}
+
+static BOOL WalkAttributes(Cursor *pCursor, D2Character *pChar)
+{
+    if (!TakeMagic(pCursor, 'g', 'f'))
+    {
+        return FALSE;
+    }
+    BitReader reader;
+    BITREADER_Init(&reader, pCursor->pData + pCursor->pos, pCursor->size - pCursor->pos);
+    DWORD seen = 0;
+    for (;;)
+    {
+        DWORD id = BITREADER_Read(&reader, 9);
+        if (reader.overrun)
+        {
+            return FALSE;
+        }
+        if (id == ATTRIBUTE_END)
+        {
+            break;
+        }
+        if (id >= D2S_ATTRIBUTES || (seen & (1u << id)))
+        {
+            return FALSE;
+        }
+        seen |= 1u << id;
+        DWORD value = BITREADER_Read(&reader, s_attributeBits[id]);
+        if (pChar)
+        {
+            pChar->attributes[id] = value;
+        }
+    }
+    BITREADER_Align(&reader);
+    if (pChar)
+    {
+        pChar->attributeMask = seen;
+    }
+    pCursor->pos += BITREADER_Tell(&reader) >> 3;
+    return TRUE;
+}
+
+static BOOL WalkCharacter(const ItemCodec *pCodec, const BYTE *pData, size_t size, D2Character *pChar,
+                          DWORD *pItemCount)
+{
+    if (size < D2S_HEADER_SIZE || ReadDword(pData + OFFSET_SIGNATURE) != D2S_SIGNATURE ||
+        ReadDword(pData + OFFSET_VERSION) != D2S_VERSION || ReadDword(pData + OFFSET_FILESIZE) != size ||
+        ReadDword(pData + OFFSET_CHECKSUM) != D2S_Checksum(pData, size))
+    {
+        return FALSE;
+    }
+
+    BYTE status = pData[OFFSET_STATUS];
+    DWORD mercId = ReadDword(pData + OFFSET_MERC_ID);
+    if (pChar)
+    {
+        memcpy(pChar->header, pData, D2S_HEADER_SIZE);
+        memcpy(pChar->szName, pData + OFFSET_NAME, sizeof(pChar->szName));
+        pChar->szName[sizeof(pChar->szName) - 1] = 0;
+        pChar->status = status;
+        pChar->charClass = pData[OFFSET_CLASS];
+        pChar->level = pData[OFFSET_LEVEL];
+        pChar->mercId = mercId;
+        pChar->hasCorpse = 0;
+        pChar->hasGolem = 0;
+        pChar->items.count = 0;
+        pChar->corpseItems.count = 0;
+        pChar->mercItems.count = 0;
+        memset(pChar->attributes, 0, sizeof(pChar->attributes));
+    }
+
+    Cursor cursor = {pData, size, D2S_HEADER_SIZE};
+    if (!WalkAttributes(&cursor, pChar) || !TakeMagic(&cursor, 'i', 'f') || size - cursor.pos < D2S_SKILLS)
+    {
+        return FALSE;
+    }
+    if (pChar)
+    {
+        memcpy(pChar->skills, pData + cursor.pos, D2S_SKILLS);
+    }
+    cursor.pos += D2S_SKILLS;
+
+    DWORD itemCount = 0;
+    if (!WalkItemList(pCodec, &cursor, pChar ? &pChar->items : NULL, &itemCount))
+    {
+        return FALSE;
+    }
+
+    // Corpse: a "JM" header whose count is 0 or 1
+    if (!TakeMagic(&cursor, 'J', 'M') || size - cursor.pos < 2)
+    {
+        return FALSE;
+    }
+    DWORD corpses = pData[cursor.pos] | (pData[cursor.pos + 1] << 8);
+    cursor.pos += 2;
+    if (corpses > 1)
+    {
+        return FALSE;
+    }
+    if (corpses)
+    {
+        if (size - cursor.pos < D2S_CORPSE_DATA)
+        {
+            return FALSE;
+        }
+        if (pChar)
+        {
+            pChar->hasCorpse = 1;
+            memcpy(pChar->corpseData, pData + cursor.pos, D2S_CORPSE_DATA);
+        }
+        cursor.pos += D2S_CORPSE_DATA;
+        if (!WalkItemList(pCodec, &cursor, pChar ? &pChar->corpseItems : NULL, &itemCount))
+        {
+            return FALSE;
+        }
+    }
+
+    if (status & D2S_STATUS_EXPANSION)
+    {
+        if (!TakeMagic(&cursor, 'j', 'f'))
+        {
+            return FALSE;
+        }
+        if (mercId && !WalkItemList(pCodec, &cursor, pChar ? &pChar->mercItems : NULL, &itemCount))
+        {
+            return FALSE;
+        }
+        if (!TakeMagic(&cursor, 'k', 'f') || cursor.pos >= size)
+        {
+            return FALSE;
+        }
+        BYTE hasGolem = pData[cursor.pos++];
+        if (hasGolem > 1)
+        {
+            return FALSE;
+        }
+        if (hasGolem)
+        {
+            size_t bytes = 0;
+            BOOL ok = pChar ? ITEMCODEC_Decode(pCodec, pData + cursor.pos, size - cursor.pos, &pChar->golem, &bytes)
+                            : ITEMCODEC_Validate(pCodec, pData + cursor.pos, size - cursor.pos, &bytes);
+            if (!ok)
+            {
+                return FALSE;
+            }
+            cursor.pos += bytes;
+            itemCount++;
+            if (pChar)
+            {
+                pChar->hasGolem = 1;
+            }
+        }
+    }
+
+    if (cursor.pos != size)
+    {
+        return FALSE;
+    }
+    if (pItemCount)
+    {
+        *pItemCount = itemCount;
+    }
+    return TRUE;
+}
+
+// =============================================================================
+// ENCODE
+// =============================================================================
+
+static BOOL PutBytes(BYTE *pOut, size_t capacity, size_t *pPos, const void *pSrc, size_t bytes)
+{
+    if (capacity - *pPos < bytes)
+    {
+        return FALSE;
+    }
+    memcpy(pOut + *pPos, pSrc, bytes);
+    *pPos += bytes;
+    return TRUE;
+}
+
+static BOOL PutItemList(const ItemCodec *pCodec, const D2ItemList *pList, BYTE *pOut, size_t capacity, size_t *pPos)
+{
+    size_t bytes = 0;
+    if (!ITEMCODEC_EncodeList(pCodec, pList->pItems, pList->count, pOut + *pPos, capacity - *pPos, &bytes))
+    {
+        return FALSE;
+    }
+    *pPos += bytes;
+    return TRUE;
+}
+
+BOOL __cdecl D2S_Encode(const ItemCodec *pCodec, const D2Character *pChar, BYTE *pOut, size_t capacity,
+                        size_t *pBytes)
+{
+    size_t pos = 0;
+    if (!PutBytes(pOut, capacity, &pos, pChar->header, D2S_HEADER_SIZE) || !PutBytes(pOut, capacity, &pos, "gf", 2))
+    {
+        return FALSE;
+    }
+
+    BitWriter writer;
+    BITWRITER_Init(&writer, pOut + pos, capacity - pos);
+    for (DWORD id = 0; id < D2S_ATTRIBUTES; id++)
+    {
+        if (pChar->attributeMask & (1u << id))
+        {
+            BITWRITER_Write(&writer, id, 9);
+            BITWRITER_Write(&writer, pChar->attributes[id], s_attributeBits[id]);
+        }
+    }
+    BITWRITER_Write(&writer, ATTRIBUTE_END, 9);
+    if (!BITWRITER_Finish(&writer))
+    {
+        return FALSE;
+    }
+    pos += BITWRITER_Size(&writer);
+
+    if (!PutBytes(pOut, capacity, &pos, "if", 2) || !PutBytes(pOut, capacity, &pos, pChar->skills, D2S_SKILLS) ||
+        !PutItemList(pCodec, &pChar->items, pOut, capacity, &pos))
+    {
+        return FALSE;
+    }
+
+    BYTE corpse[4] = {'J', 'M', (BYTE)(pChar->hasCorpse ? 1 : 0), 0};
+    if (!PutBytes(pOut, capacity, &pos, corpse, sizeof(corpse)))
+    {
+        return FALSE;
+    }
+    if (pChar->hasCorpse && (!PutBytes(pOut, capacity, &pos, pChar->corpseData, D2S_CORPSE_DATA) ||
+                             !PutItemList(pCodec, &pChar->corpseItems, pOut, capacity, &pos)))
+    {
+        return FALSE;
+    }
+
+    if (pChar->header[OFFSET_STATUS] & D2S_STATUS_EXPANSION)
+    {
+        if (!PutBytes(pOut, capacity, &pos, "jf", 2))
+        {
+            return FALSE;
+        }
+        if (ReadDword(pChar->header + OFFSET_MERC_ID) && !PutItemList(pCodec, &pChar->mercItems, pOut, capacity, &pos))
+        {
+            return FALSE;
+        }
+        BYTE golem[3] = {'k', 'f', (BYTE)(pChar->hasGolem ? 1 : 0)};
+        if (!PutBytes(pOut, capacity, &pos, golem, sizeof(golem)))
+        {
+            return FALSE;
+        }
+        if (pChar->hasGolem)
+        {
+            size_t bytes = 0;
+            if (!ITEMCODEC_Encode(pCodec, &pChar->golem, pOut + pos, capacity - pos, &bytes))
+            {
+                return FALSE;
+            }
+            pos += bytes;
+        }
+    }
+
+    WriteDword(pOut + OFFSET_FILESIZE, (DWORD)pos);
+    WriteDword(pOut + OFFSET_CHECKSUM, D2S_Checksum(pOut, pos));
+    if (pBytes)
+    {
+        *pBytes = pos;
+    }
+    return TRUE;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+BOOL __cdecl D2S_Validate(const ItemCodec *pCodec, const BYTE *pData, size_t size, DWORD *pItemCount)
+{
+    return WalkCharacter(pCodec, pData, size, NULL, pItemCount);
+}
+
+BOOL __cdecl D2S_Decode(const ItemCodec *pCodec, const BYTE *pData, size_t size, D2Character *pChar)
+{
+    return WalkCharacter(pCodec, pData, size, pChar, NULL);
+}
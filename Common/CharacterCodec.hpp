@@ -0,0 +1,77 @@
+/*
+ * CharacterCodec.hpp - D2Common .d2s character codec
+ *
+ * A 1.10+ character file is a fixed 765-byte header (identity, quests,
+ * waypoints, NPC state) followed by bit-packed sections:
+ *   "gf" (id:9 value:width)* 0x1FF    attributes, padded to a byte
+ *   "if" 30 bytes                     skill levels
+ *   "JM" list                         player items (ItemCodec.hpp)
+ *   "JM" count:16 [12 bytes, "JM" list]  corpse
+ *   expansion only:
+ *   "jf" ["JM" list if hired]         mercenary items
+ *   "kf" has:8 [item]                 iron golem
+ * The header carries the file size at 8 and a checksum at 12: a rotate-left
+ * by one and add over every byte, with the checksum field read as zero.
+ *
+ * Validate checks the signature, size, checksum and every section in place.
+ * Decode fills a D2Character whose item lists point at caller-provided
+ * arrays, Encode writes it back (with a fresh size and checksum); neither
+ * allocates. Both take the ItemCodec that knows the stat and item tables.
+ */
+
+#ifndef CHARACTERCODEC_HPP
+#define CHARACTERCODEC_HPP
+
+#include "ItemCodec.hpp"
+
+#define D2S_HEADER_SIZE 765
+#define D2S_SIGNATURE 0xAA55AA55
+#define D2S_VERSION 96 // 1.10+
+#define D2S_ATTRIBUTES 16
+#define D2S_SKILLS 30
+#define D2S_CORPSE_DATA 12
+
+#define D2S_STATUS_EXPANSION 0x20
+
+// Caller-owned item storage; count is set by Decode
+typedef struct D2ItemList
+{
+    D2Item *pItems;
+    DWORD capacity;
+    DWORD count;
+} D2ItemList;
+
+typedef struct D2Character
+{
+    // Written back verbatim apart from the size and checksum; the fields below
+    // it are copies for the caller
+    BYTE header[D2S_HEADER_SIZE];
+    char szName[16];
+    BYTE status; // D2S_STATUS_*
+    BYTE charClass;
+    BYTE level;
+    DWORD mercId; // 0 = no mercenary hired
+
+    DWORD attributeMask; // Bit per attribute present in "gf"
+    DWORD attributes[D2S_ATTRIBUTES];
+    BYTE skills[D2S_SKILLS];
+
+    D2ItemList items;
+    BYTE hasCorpse;
+    BYTE corpseData[D2S_CORPSE_DATA];
+    D2ItemList corpseItems;
+    D2ItemList mercItems;
+    BYTE hasGolem;
+    D2Item golem;
+} D2Character;
+
+// Rotate-and-add over pData with bytes 12-15 taken as zero
+DWORD __cdecl D2S_Checksum(const BYTE *pData, size_t size);
+
+// *pItemCount receives every item in every list (optional)
+BOOL __cdecl D2S_Validate(const ItemCodec *pCodec, const BYTE *pData, size_t size, DWORD *pItemCount);
+BOOL __cdecl D2S_Decode(const ItemCodec *pCodec, const BYTE *pData, size_t size, D2Character *pChar);
+BOOL __cdecl D2S_Encode(const ItemCodec *pCodec, const D2Character *pChar, BYTE *pOut, size_t capacity,
+                        size_t *pBytes);
+
+#endif // CHARACTERCODEC_HPP
@@ -0,0 +1,343 @@
+/*
+ * CollisionMap.cpp - D2Common packed collision planes for line tests
+ *
+ * See CollisionMap.hpp for the layout. Line cells follow
+ *
+ *   shallow (dx >= dy): cell i = (x0 + sx*i, y0 + sy*floor((2*dy*i + dx) / (2*dx)))
+ *   steep:              cell j = (x0 + sx*floor((2*dx*j + dy) / (2*dy)), y0 + sy*j)
+ *
+ * which is the usual incremental Bresenham rounding half up. Row k of a
+ * shallow line holds the cells i in [RunStart(k), RunStart(k + 1) - 1].
+ */
+
+#include "CollisionMap.hpp"
+
+#include <stdlib.h>
+
+#define NO_HIT 0xFFFFFFFF
+
+struct CollisionMap
+{
+    DWORD width;
+    DWORD height;
+    DWORD rowWords; // 64-bit words per row-major row
+    DWORD colWords; // Per column-major column
+    WORD planeMasks[COLPLANE_COUNT];
+    WORD *pCells;
+    uint64_t *pRows[COLPLANE_COUNT]; // height * rowWords
+    uint64_t *pCols[COLPLANE_COUNT]; // width * colWords
+    CollisionMapStats stats;
+};
+
+static const WORD s_defaultMasks[COLPLANE_COUNT] = {
+    COLPLANE_DEFAULT_WALK,
+    COLPLANE_DEFAULT_MISSILE,
+    COLPLANE_DEFAULT_SIGHT,
+};
+
+static void WriteCell(CollisionMap *pMap, DWORD x, DWORD y, WORD collision)
+{
+    pMap->pCells[y * pMap->width + x] = collision;
+    for (DWORD plane = 0; plane < COLPLANE_COUNT; plane++)
+    {
+        uint64_t *pRow = &pMap->pRows[plane][y * pMap->rowWords + (x >> 6)];
+        uint64_t *pCol = &pMap->pCols[plane][x * pMap->colWords + (y >> 6)];
+        if (collision & pMap->planeMasks[plane])
+        {
+            *pRow |= 1ULL << (x & 63);
+            *pCol |= 1ULL << (y & 63);
+        }
+        else
+        {
+            *pRow &= ~(1ULL << (x & 63));
+            *pCol &= ~(1ULL << (y & 63));
+        }
+    }
+}
+
+// =============================================================================
+// MAP
+// =============================================================================
+
+CollisionMap *__cdecl COLMAP_Create(const CollisionMapDesc *pDesc)
+{
+    if (!pDesc || !pDesc->width || !pDesc->height || pDesc->width > 0xFFFF || pDesc->height > 0xFFFF)
+    {
+        return NULL;
+    }
+
+    CollisionMap *pMap = (CollisionMap *)calloc(1, sizeof(CollisionMap));
+    if (!pMap)
+    {
+        return NULL;
+    }
+    pMap->width = pDesc->width;
+    pMap->height = pDesc->height;
+    pMap->rowWords = (pDesc->width + 63) / 64;
+    pMap->colWords = (pDesc->height + 63) / 64;
+    pMap->pCells = (WORD *)calloc((size_t)pDesc->width * pDesc->height, sizeof(WORD));
+    BOOL ok = pMap->pCells != NULL;
+    for (DWORD plane = 0; plane < COLPLANE_COUNT; plane++)
+    {
+        pMap->planeMasks[plane] = pDesc->planeMasks[plane] ? pDesc->planeMasks[plane] : s_defaultMasks[plane];
+        pMap->pRows[plane] = (uint64_t *)calloc((size_t)pMap->height * pMap->rowWords, sizeof(uint64_t));
+        pMap->pCols[plane] = (uint64_t *)calloc((size_t)pMap->width * pMap->colWords, sizeof(uint64_t));
+        ok = ok && pMap->pRows[plane] && pMap->pCols[plane];
+    }
+    if (!ok)
+    {
+        COLMAP_Destroy(pMap);
+        return NULL;
+    }
+
+    if (pDesc->pCollision)
+    {
+        for (DWORD y = 0; y < pMap->height; y++)
+        {
+            for (DWORD x = 0; x < pMap->width; x++)
+            {
+                WriteCell(pMap, x, y, pDesc->pCollision[y * pMap->width + x]);
+            }
+        }
+    }
+    return pMap;
+}
+
+void __cdecl COLMAP_Destroy(CollisionMap *pMap)
+{
+    if (!pMap)
+    {
+        return;
+    }
+    for (DWORD plane = 0; plane < COLPLANE_COUNT; plane++)
+    {
+        free(pMap->pRows[plane]);
+        free(pMap->pCols[plane]);
+    }
+    free(pMap->pCells);
+    free(pMap);
+}
+
+WORD __cdecl COLMAP_GetCell(const CollisionMap *pMap, DWORD x, DWORD y)
+{
+    if (x >= pMap->width || y >= pMap->height)
+    {
+        return 0xFFFF;
+    }
+    return pMap->pCells[y * pMap->width + x];
+}
+
+void __cdecl COLMAP_SetCell(CollisionMap *pMap, DWORD x, DWORD y, WORD collision)
+{
+    if (x >= pMap->width || y >= pMap->height)
+    {
+        return;
+    }
+    WriteCell(pMap, x, y, collision);
+    pMap->stats.edits++;
+}
+
+void __cdecl COLMAP_LoadRect(CollisionMap *pMap, DWORD x, DWORD y, DWORD w, DWORD h, const WORD *pCollision)
+{
+    for (DWORD row = 0; row < h && y + row < pMap->height; row++)
+    {
+        for (DWORD col = 0; col < w && x + col < pMap->width; col++)
+        {
+            WriteCell(pMap, x + col, y + row, pCollision[row * w + col]);
+            pMap->stats.edits++;
+        }
+    }
+}
+
+// =============================================================================
+// RUNS
+// =============================================================================
+
+/*
+ * First blocked bit in [a, b] of a packed row or column: lowest index, or
+ * highest when reverse (the line travels toward lower coordinates).
+ */
+static DWORD FindInRun(CollisionMap *pMap, const uint64_t *pWords, DWORD a, DWORD b, BOOL reverse)
+{
+    DWORD first = a >> 6, last = b >> 6;
+    uint64_t firstMask = ~0ULL << (a & 63), lastMask = ~0ULL >> (63 - (b & 63));
+
+    pMap->stats.runTests++;
+    for (DWORD i = 0; i <= last - first; i++)
+    {
+        DWORD w = reverse ? last - i : first + i;
+        uint64_t bits = pWords[w];
+        if (w == first)
+        {
+            bits &= firstMask;
+        }
+        if (w == last)
+        {
+            bits &= lastMask;
+        }
+        pMap->stats.wordTests++;
+        if (bits)
+        {
+            return (w << 6) + (reverse ? D2_Msb64(bits) : D2_Ctz64(bits));
+        }
+    }
+    return NO_HIT;
+}
+
+/*
+ * Walk the line one row (shallow) or column (steep) run at a time and stop
+ * at the first blocked cell in travel order. Run k + 1 starts at major index
+ * floor(N / 2m) with N = 2Mk + M + 2m - 1 (M = major, m = minor span); N
+ * grows by 2M per run, so the quotient is stepped instead of divided.
+ */
+static BOOL SweepLine(CollisionMap *pMap, DWORD plane, DWORD x0, DWORD y0, DWORD x1, DWORD y1, DWORD *pHitX,
+                      DWORD *pHitY)
+{
+    pMap->stats.lineTests++;
+    if (x0 >= pMap->width || y0 >= pMap->height || x1 >= pMap->width || y1 >= pMap->height)
+    {
+        *pHitX = x0;
+        *pHitY = y0;
+        return TRUE;
+    }
+
+    DWORD dx = (x1 > x0) ? x1 - x0 : x0 - x1, dy = (y1 > y0) ? y1 - y0 : y0 - y1;
+    BOOL shallow = dx >= dy;
+
+    // Map the line onto major/minor axes; the runs lie along the major axis
+    DWORD major = shallow ? dx : dy, minor = shallow ? dy : dx;
+    DWORD major0 = shallow ? x0 : y0, minor0 = shallow ? y0 : x0;
+    BOOL majorBack = shallow ? (x1 < x0) : (y1 < y0);
+    BOOL minorBack = shallow ? (y1 < y0) : (x1 < x0);
+    DWORD lineWords = shallow ? pMap->rowWords : pMap->colWords;
+    const uint64_t *pLine = (shallow ? pMap->pRows[plane] : pMap->pCols[plane]) + (size_t)minor0 * lineWords;
+
+    // One division per line: 2M / 2m = M / m, and floor((M + 2m - 1) / 2m) = 1 + floor((M - 1) / m) / 2
+    DWORD twoMinor = 2 * minor, stepQuot = 0, stepRem = 0, next = 0, rem = 0;
+    if (minor)
+    {
+        stepQuot = major / minor;
+        stepRem = 2 * (major % minor);
+        next = 1 + (stepRem ? stepQuot : stepQuot - 1) / 2;
+        rem = major + twoMinor - 1 - next * twoMinor;
+    }
+
+    DWORD start = 0, runs = 0, hit = NO_HIT;
+    for (DWORD k = 0; k <= minor; k++)
+    {
+        DWORD end = (k == minor) ? major : next - 1;
+        DWORD a = majorBack ? major0 - end : major0 + start;
+        DWORD b = majorBack ? major0 - start : major0 + end;
+
+        if ((a ^ b) < 64)
+        {
+            // One word, the common case for anything but long straight lines
+            uint64_t bits = pLine[a >> 6] & (~0ULL << (a & 63)) & (~0ULL >> (63 - (b & 63)));
+            runs++;
+            if (bits)
+            {
+                hit = (a & ~63u) + (majorBack ? D2_Msb64(bits) : D2_Ctz64(bits));
+            }
+        }
+        else
+        {
+            hit = FindInRun(pMap, pLine, a, b, majorBack);
+        }
+        if (hit != NO_HIT)
+        {
+            DWORD line = minorBack ? minor0 - k : minor0 + k;
+            *pHitX = shallow ? hit : line;
+            *pHitY = shallow ? line : hit;
+            break;
+        }
+
+        start = end + 1;
+        next += stepQuot;
+        rem += stepRem;
+        if (rem >= twoMinor)
+        {
+            rem -= twoMinor;
+            next++;
+        }
+        pLine = minorBack ? pLine - lineWords : pLine + lineWords;
+    }
+    pMap->stats.runTests += runs;
+    pMap->stats.wordTests += runs;
+    return hit != NO_HIT;
+}
+
+// =============================================================================
+// QUERIES
+// =============================================================================
+
+BOOL __cdecl COLMAP_TestCell(const CollisionMap *pMap, CollisionPlane plane, DWORD x, DWORD y)
+{
+    if (x >= pMap->width || y >= pMap->height)
+    {
+        return TRUE;
+    }
+    return (pMap->pRows[plane][y * pMap->rowWords + (x >> 6)] >> (x & 63)) & 1;
+}
+
+BOOL __cdecl COLMAP_TestRect(CollisionMap *pMap, CollisionPlane plane, DWORD x, DWORD y, DWORD w, DWORD h)
+{
+    if (!w || !h || x >= pMap->width || y >= pMap->height || w > pMap->width - x || h > pMap->height - y)
+    {
+        return TRUE;
+    }
+    for (DWORD row = y; row < y + h; row++)
+    {
+        if (FindInRun(pMap, pMap->pRows[plane] + (size_t)row * pMap->rowWords, x, x + w - 1, FALSE) != NO_HIT)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+BOOL __cdecl COLMAP_LineOfSight(CollisionMap *pMap, DWORD x0, DWORD y0, DWORD x1, DWORD y1)
+{
+    DWORD hitX, hitY;
+    return !SweepLine(pMap, COLPLANE_SIGHT, x0, y0, x1, y1, &hitX, &hitY);
+}
+
+BOOL __cdecl COLMAP_Sweep(CollisionMap *pMap, CollisionPlane plane, DWORD x0, DWORD y0, DWORD x1, DWORD y1,
+                          DWORD *pHitX, DWORD *pHitY)
+{
+    DWORD hitX, hitY;
+    if (!SweepLine(pMap, plane, x0, y0, x1, y1, &hitX, &hitY))
+    {
+        return FALSE;
+    }
+    if (pHitX)
+    {
+        *pHitX = hitX;
+    }
+    if (pHitY)
+    {
+        *pHitY = hitY;
+    }
+    return TRUE;
+}
+
+DWORD __cdecl COLMAP_SweepMissiles(CollisionMap *pMap, const CollisionSweep *pSweeps, DWORD count,
+                                   CollisionHit *pHits)
+{
+    DWORD hits = 0;
+    for (DWORD i = 0; i < count; i++)
+    {
+        const CollisionSweep *pSweep = &pSweeps[i];
+        DWORD hitX = 0, hitY = 0;
+        pHits[i].hit = SweepLine(pMap, COLPLANE_MISSILE, pSweep->fromX, pSweep->fromY, pSweep->toX, pSweep->toY,
+                                 &hitX, &hitY);
+        pHits[i].x = (WORD)hitX;
+        pHits[i].y = (WORD)hitY;
+        hits += pHits[i].hit ? 1 : 0;
+    }
+    return hits;
+}
+
+void __cdecl COLMAP_GetStats(const CollisionMap *pMap, CollisionMapStats *pStats)
+{
+    *pStats = pMap->stats;
+}
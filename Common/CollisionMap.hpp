@@ -0,0 +1,107 @@
+/*
+ * CollisionMap.hpp - D2Common packed collision planes for line tests
+ *
+ * Rooms keep one 16-bit collision word per subtile, and line-of-sight and
+ * missile movement walk a Bresenham line one cell at a time: find the room,
+ * index its map, test the mask, step. Every missile does that every tick,
+ * so projectile-heavy skills (Strafe, Multishot, Fissure) scale the tick
+ * with the projectile count times the distance flown.
+ *
+ * The collision map keeps the 16-bit words for exact queries and, for each
+ * plane (walk, missile, sight), one bit per subtile packed into 64-bit
+ * words - row-major and column-major. A Bresenham line covers a contiguous
+ * run of cells on each row (shallow lines) or column (steep lines), so a
+ * line is tested one run at a time: build the run's mask, AND it with the
+ * plane word, and for sweeps pick the first blocked cell with a bit scan.
+ * A 40-cell missile step becomes a handful of word tests.
+ *
+ * Lines include both end cells and follow one fixed Bresenham rounding, so
+ * A -> B and B -> A may differ by a cell at ties. A line with an end outside
+ * the map is blocked at its start. Game thread only; one map per level.
+ */
+
+#ifndef COLLISIONMAP_HPP
+#define COLLISIONMAP_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+// D2 collision bits (subset)
+#define COLLIDE_BLOCK_PLAYER 0x0001
+#define COLLIDE_BLOCK_MISSILE 0x0004
+#define COLLIDE_WALL 0x0008
+#define COLLIDE_DOOR 0x0400
+#define COLLIDE_MONSTER_WALK (COLLIDE_BLOCK_PLAYER | COLLIDE_WALL | COLLIDE_DOOR)
+
+typedef enum CollisionPlane
+{
+    COLPLANE_WALK = 0,
+    COLPLANE_MISSILE,
+    COLPLANE_SIGHT,
+    COLPLANE_COUNT,
+} CollisionPlane;
+
+// Collision bits that set each plane's bit, used when a mask is left at 0
+#define COLPLANE_DEFAULT_WALK COLLIDE_MONSTER_WALK
+#define COLPLANE_DEFAULT_MISSILE (COLLIDE_BLOCK_MISSILE | COLLIDE_WALL | COLLIDE_DOOR)
+#define COLPLANE_DEFAULT_SIGHT (COLLIDE_WALL | COLLIDE_DOOR)
+
+typedef struct CollisionMapDesc
+{
+    DWORD width; // Subtiles
+    DWORD height;
+    const WORD *pCollision;          // width * height, copied; NULL = all clear
+    WORD planeMasks[COLPLANE_COUNT]; // 0 = default
+} CollisionMapDesc;
+
+// One missile's movement this tick
+typedef struct CollisionSweep
+{
+    WORD fromX;
+    WORD fromY;
+    WORD toX;
+    WORD toY;
+} CollisionSweep;
+
+typedef struct CollisionHit
+{
+    BOOL hit;
+    WORD x; // First blocked cell when hit
+    WORD y;
+} CollisionHit;
+
+typedef struct CollisionMapStats
+{
+    uint64_t lineTests; // LOS checks and sweeps
+    uint64_t runTests;  // Row/column runs tested
+    uint64_t wordTests; // 64-bit plane words tested
+    uint64_t edits;     // Cells changed by SetCell/LoadRect
+} CollisionMapStats;
+
+typedef struct CollisionMap CollisionMap;
+
+CollisionMap *__cdecl COLMAP_Create(const CollisionMapDesc *pDesc);
+void __cdecl COLMAP_Destroy(CollisionMap *pMap);
+
+// 0xFFFF outside the map
+WORD __cdecl COLMAP_GetCell(const CollisionMap *pMap, DWORD x, DWORD y);
+void __cdecl COLMAP_SetCell(CollisionMap *pMap, DWORD x, DWORD y, WORD collision);
+// Copy a w x h block (a room being added or replaced), clipped to the map
+void __cdecl COLMAP_LoadRect(CollisionMap *pMap, DWORD x, DWORD y, DWORD w, DWORD h, const WORD *pCollision);
+
+// TRUE if the cell / any cell of the rect is blocked on the plane
+BOOL __cdecl COLMAP_TestCell(const CollisionMap *pMap, CollisionPlane plane, DWORD x, DWORD y);
+BOOL __cdecl COLMAP_TestRect(CollisionMap *pMap, CollisionPlane plane, DWORD x, DWORD y, DWORD w, DWORD h);
+
+// TRUE if no cell of the line from (x0, y0) to (x1, y1) blocks sight
+BOOL __cdecl COLMAP_LineOfSight(CollisionMap *pMap, DWORD x0, DWORD y0, DWORD x1, DWORD y1);
+
+// First blocked cell of the line on the plane; FALSE if the line is clear
+BOOL __cdecl COLMAP_Sweep(CollisionMap *pMap, CollisionPlane plane, DWORD x0, DWORD y0, DWORD x1, DWORD y1,
+                          DWORD *pHitX, DWORD *pHitY);
+// Every missile of a tick on the missile plane; returns the number that hit
+DWORD __cdecl COLMAP_SweepMissiles(CollisionMap *pMap, const CollisionSweep *pSweeps, DWORD count,
+                                   CollisionHit *pHits);
+
+void __cdecl COLMAP_GetStats(const CollisionMap *pMap, CollisionMapStats *pStats);
+
+#endif // COLLISIONMAP_HPP
@@ -0,0 +1,421 @@
+/*
+ * DataTable.cpp - D2Common compiled data tables (read-only runtime)
+ *
+ * Nothing in this file parses text; see DataTableCompiler.cpp for that.
+ */
+
+#include "DataTable.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct DataTable
+{
+    const BYTE *pBase;
+    size_t size;
+    BOOL mapped;
+#ifdef _WIN32
+    HANDLE hFile;
+    HANDLE hMapping;
+#endif
+
+    const DataTableHeader *pHeader;
+    const DataTableColumn *pColumns;
+    const DWORD *pStringOffsets;
+    const char *pStringData;
+    const DWORD *pHashSeeds;
+    const DWORD *pHashSlots;
+};
+
+// =============================================================================
+// HASHING (shared with the compiler)
+// =============================================================================
+
+DWORD __cdecl DATATABLE_PackCode(const char *szCode)
+{
+    DWORD code = 0;
+    BOOL ended = FALSE;
+
+    for (DWORD i = 0; i < 4; i++)
+    {
+        if (!ended && !szCode[i])
+        {
+            ended = TRUE;
+        }
+        BYTE c = ended ? ' ' : (BYTE)szCode[i];
+        code |= (DWORD)c << (i * 8);
+    }
+    return code;
+}
+
+DWORD __cdecl DATATABLE_HashKey(const char *szKey)
+{
+    DWORD hash = 2166136261u;
+    while (*szKey)
+    {
+        hash = (hash ^ (BYTE)*szKey++) * 16777619u;
+    }
+    return hash;
+}
+
+DWORD __cdecl DATATABLE_HashBucket(DWORD key, DWORD buckets)
+{
+    return D2_HashDword(key) % buckets;
+}
+
+DWORD __cdecl DATATABLE_HashSlot(DWORD key, DWORD seed, DWORD mask)
+{
+    return D2_HashDword(key ^ (seed * 0x9E3779B9u + 0x7F4A7C15u)) & mask;
+}
+
+DWORD __cdecl DATATABLE_Checksum(const BYTE *pData, size_t size)
+{
+    DWORD hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ pData[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// =============================================================================
+// OPEN / CLOSE
+// =============================================================================
+
+static BYTE ColumnWidth(BYTE type)
+{
+    switch (type)
+    {
+    case DTCOL_U8:
+    case DTCOL_I8:
+        return 1;
+    case DTCOL_U16:
+    case DTCOL_I16:
+    case DTCOL_LINK:
+        return 2;
+    case DTCOL_U32:
+    case DTCOL_I32:
+    case DTCOL_CODE:
+    case DTCOL_STRING:
+        return 4;
+    }
+    return 0;
+}
+
+static BOOL InRange(uint64_t offset, uint64_t bytes, uint64_t size)
+{
+    return offset <= size && bytes <= size - offset;
+}
+
+/*
+ * BindTable
+ * Validate the header and every section bound, then resolve the section
+ * pointers. Cost is proportional to the column count, not the record count.
+ */
+static BOOL BindTable(DataTable *pTable, DWORD flags)
+{
+    const DataTableHeader *pHeader = (const DataTableHeader *)pTable->pBase;
+    uint64_t size = pTable->size;
+
+    if (size < sizeof(DataTableHeader) || pHeader->magic != DATATABLE_MAGIC ||
+        pHeader->version != DATATABLE_VERSION || pHeader->headerSize != sizeof(DataTableHeader) ||
+        pHeader->fileSize > size)
+    {
+        return FALSE;
+    }
+    size = pHeader->fileSize;
+
+    if (!InRange(pHeader->columnsOffset, (uint64_t)pHeader->columnCount * sizeof(DataTableColumn), size))
+    {
+        return FALSE;
+    }
+
+    const DataTableColumn *pColumns = (const DataTableColumn *)(pTable->pBase + pHeader->columnsOffset);
+    for (DWORD c = 0; c < pHeader->columnCount; c++)
+    {
+        if (pColumns[c].width == 0 || pColumns[c].width != ColumnWidth(pColumns[c].type) ||
+            !InRange(pColumns[c].dataOffset, (uint64_t)pHeader->recordCount * pColumns[c].width, size))
+        {
+            return FALSE;
+        }
+    }
+
+    uint64_t stringTable = (uint64_t)pHeader->stringCount * sizeof(DWORD);
+    if (!InRange(pHeader->stringsOffset, stringTable + pHeader->stringBytes, size))
+    {
+        return FALSE;
+    }
+    const char *pStringData = (const char *)(pTable->pBase + pHeader->stringsOffset + stringTable);
+    if (pHeader->stringBytes && pStringData[pHeader->stringBytes - 1] != '\0')
+    {
+        return FALSE; // Guarantees every in-range offset yields a terminated string
+    }
+
+    if (pHeader->keyColumn != DATATABLE_NO_RECORD)
+    {
+        if (pHeader->keyColumn >= pHeader->columnCount || pHeader->hashBuckets == 0 || pHeader->hashSize == 0 ||
+            (pHeader->hashSize & (pHeader->hashSize - 1)) != 0 ||
+            (pColumns[pHeader->keyColumn].type != DTCOL_CODE && pColumns[pHeader->keyColumn].type != DTCOL_STRING) ||
+            !InRange(pHeader->hashOffset, ((uint64_t)pHeader->hashBuckets + pHeader->hashSize) * sizeof(DWORD), size))
+        {
+            return FALSE;
+        }
+    }
+
+    if ((flags & DATATABLE_OPEN_VERIFY) &&
+        DATATABLE_Checksum(pTable->pBase + pHeader->headerSize, (size_t)(size - pHeader->headerSize)) !=
+            pHeader->checksum)
+    {
+        return FALSE;
+    }
+
+    pTable->pHeader = pHeader;
+    pTable->pColumns = pColumns;
+    pTable->pStringOffsets = (const DWORD *)(pTable->pBase + pHeader->stringsOffset);
+    pTable->pStringData = pStringData;
+    if (pHeader->keyColumn != DATATABLE_NO_RECORD)
+    {
+        pTable->pHashSeeds = (const DWORD *)(pTable->pBase + pHeader->hashOffset);
+        pTable->pHashSlots = pTable->pHashSeeds + pHeader->hashBuckets;
+    }
+    return TRUE;
+}
+
+DataTable *__cdecl DATATABLE_OpenMemory(const void *pData, size_t size, DWORD flags)
+{
+    DataTable *pTable = (DataTable *)calloc(1, sizeof(DataTable));
+    if (!pTable)
+    {
+        return NULL;
+    }
+
+    pTable->pBase = (const BYTE *)pData;
+    pTable->size = size;
+    if (!pData || !BindTable(pTable, flags))
+    {
+        free(pTable);
+        return NULL;
+    }
+    return pTable;
+}
+
+DataTable *__cdecl DATATABLE_Open(const char *szPath, DWORD flags)
+{
+    DataTable *pTable = (DataTable *)calloc(1, sizeof(DataTable));
+    if (!pTable)
+    {
+        return NULL;
+    }
+    pTable->mapped = TRUE;
+
+#ifdef _WIN32
+    pTable->hFile = CreateFileA(szPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (pTable->hFile == INVALID_HANDLE_VALUE)
+    {
+        free(pTable);
+        return NULL;
+    }
+    pTable->size = GetFileSize(pTable->hFile, NULL);
+    pTable->hMapping = CreateFileMappingA(pTable->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (pTable->hMapping)
+    {
+        pTable->pBase = (const BYTE *)MapViewOfFile(pTable->hMapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    int fd = open(szPath, O_RDONLY);
+    if (fd < 0)
+    {
+        free(pTable);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *pView = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pView != MAP_FAILED)
+        {
+            pTable->pBase = (const BYTE *)pView;
+            pTable->size = (size_t)st.st_size;
+        }
+    }
+    close(fd); // The mapping keeps the file alive
+#endif
+
+    if (!pTable->pBase || !BindTable(pTable, flags))
+    {
+        DATATABLE_Close(pTable);
+        return NULL;
+    }
+    return pTable;
+}
+
+void __cdecl DATATABLE_Close(DataTable *pTable)
+{
+    if (!pTable)
+    {
+        return;
+    }
+
+    if (pTable->mapped)
+    {
+#ifdef _WIN32
+        if (pTable->pBase)
+            UnmapViewOfFile(pTable->pBase);
+        if (pTable->hMapping)
+            CloseHandle(pTable->hMapping);
+        if (pTable->hFile != INVALID_HANDLE_VALUE)
+            CloseHandle(pTable->hFile);
+#else
+        if (pTable->pBase)
+            munmap((void *)pTable->pBase, pTable->size);
+#endif
+    }
+    free(pTable);
+}
+
+// =============================================================================
+// ACCESS
+// =============================================================================
+
+const DataTableHeader *__cdecl DATATABLE_GetHeader(const DataTable *pTable)
+{
+    return pTable->pHeader;
+}
+
+DWORD __cdecl DATATABLE_GetRecordCount(const DataTable *pTable)
+{
+    return pTable->pHeader->recordCount;
+}
+
+int __cdecl DATATABLE_FindColumn(const DataTable *pTable, const char *szName)
+{
+    for (DWORD c = 0; c < pTable->pHeader->columnCount; c++)
+    {
+        if (strncmp(pTable->pColumns[c].szName, szName, DATATABLE_NAME_LENGTH) == 0)
+        {
+            return (int)c;
+        }
+    }
+    return -1;
+}
+
+const DataTableColumn *__cdecl DATATABLE_GetColumnInfo(const DataTable *pTable, int column)
+{
+    if (column < 0 || (DWORD)column >= pTable->pHeader->columnCount)
+    {
+        return NULL;
+    }
+    return &pTable->pColumns[column];
+}
+
+const void *__cdecl DATATABLE_GetColumnData(const DataTable *pTable, int column)
+{
+    const DataTableColumn *pColumn = DATATABLE_GetColumnInfo(pTable, column);
+    return pColumn ? pTable->pBase + pColumn->dataOffset : NULL;
+}
+
+int32_t __cdecl DATATABLE_GetInt(const DataTable *pTable, int column, DWORD record)
+{
+    const DataTableColumn *pColumn = DATATABLE_GetColumnInfo(pTable, column);
+    if (!pColumn || record >= pTable->pHeader->recordCount)
+    {
+        return 0;
+    }
+
+    const BYTE *p = pTable->pBase + pColumn->dataOffset + (size_t)record * pColumn->width;
+    switch (pColumn->type)
+    {
+    case DTCOL_U8:
+        return *p;
+    case DTCOL_I8:
+        return (int8_t)*p;
+    case DTCOL_U16:
+    case DTCOL_LINK:
+        return *(const uint16_t *)p;
+    case DTCOL_I16:
+        return *(const int16_t *)p;
+    default:
+        return *(const int32_t *)p;
+    }
+}
+
+const char *__cdecl DATATABLE_GetString(const DataTable *pTable, DWORD stringIndex)
+{
+    if (stringIndex >= pTable->pHeader->stringCount)
+    {
+        return "";
+    }
+
+    DWORD offset = pTable->pStringOffsets[stringIndex];
+    if (offset >= pTable->pHeader->stringBytes)
+    {
+        return "";
+    }
+    return pTable->pStringData + offset;
+}
+
+const char *__cdecl DATATABLE_GetCellString(const DataTable *pTable, int column, DWORD record)
+{
+    const DataTableColumn *pColumn = DATATABLE_GetColumnInfo(pTable, column);
+    if (!pColumn || pColumn->type != DTCOL_STRING)
+    {
+        return "";
+    }
+    return DATATABLE_GetString(pTable, (DWORD)DATATABLE_GetInt(pTable, column, record));
+}
+
+// =============================================================================
+// PERFECT-HASH LOOKUP
+// =============================================================================
+
+static DWORD ProbeHash(const DataTable *pTable, DWORD key)
+{
+    const DataTableHeader *pHeader = pTable->pHeader;
+    DWORD seed = pTable->pHashSeeds[DATATABLE_HashBucket(key, pHeader->hashBuckets)];
+    DWORD record = pTable->pHashSlots[DATATABLE_HashSlot(key, seed, pHeader->hashSize - 1)];
+    return (record < pHeader->recordCount) ? record : DATATABLE_NO_RECORD;
+}
+
+DWORD __cdecl DATATABLE_FindCode(const DataTable *pTable, DWORD code)
+{
+    const DataTableHeader *pHeader = pTable->pHeader;
+    if (pHeader->keyColumn == DATATABLE_NO_RECORD || pTable->pColumns[pHeader->keyColumn].type != DTCOL_CODE)
+    {
+        return DATATABLE_NO_RECORD;
+    }
+
+    DWORD record = ProbeHash(pTable, code);
+    if (record == DATATABLE_NO_RECORD || (DWORD)DATATABLE_GetInt(pTable, (int)pHeader->keyColumn, record) != code)
+    {
+        return DATATABLE_NO_RECORD;
+    }
+    return record;
+}
+
+DWORD __cdecl DATATABLE_FindRecord(const DataTable *pTable, const char *szKey)
+{
+    const DataTableHeader *pHeader = pTable->pHeader;
+    if (pHeader->keyColumn == DATATABLE_NO_RECORD)
+    {
+        return DATATABLE_NO_RECORD;
+    }
+    if (pTable->pColumns[pHeader->keyColumn].type == DTCOL_CODE)
+    {
+        return (strlen(szKey) <= 4) ? DATATABLE_FindCode(pTable, DATATABLE_PackCode(szKey)) : DATATABLE_NO_RECORD;
+    }
+
+    DWORD record = ProbeHash(pTable, DATATABLE_HashKey(szKey));
+    if (record == DATATABLE_NO_RECORD ||
+        strcmp(DATATABLE_GetCellString(pTable, (int)pHeader->keyColumn, record), szKey) != 0)
+    {
+        return DATATABLE_NO_RECORD;
+    }
+    return record;
+}
@@ -0,0 +1,129 @@
+/*
+ * DataTable.hpp - D2Common compiled data tables (read-only runtime)
+ *
+ * D2Common's DATATBLS code parses every excel .txt/.bin at startup into
+ * pointer-linked records hung off GlobalDataTables. Compiled tables (.d2t)
+ * move all of that offline (see DataTableCompiler.hpp); at startup a table is
+ * mapped read-only and used in place:
+ *
+ *   - Column-oriented: each column is one contiguous fixed-width array, so a
+ *     scan of one field (e.g. monster level) touches only that field.
+ *   - Strings are pooled; string cells hold an index into the pool.
+ *   - References to other tables (skills.srvmissile -> missiles) are already
+ *     row indices.
+ *   - Lookup by code uses a perfect hash stored in the file: two probes, one
+ *     key compare, no collisions to walk.
+ *
+ * Opening validates the header and section bounds (O(columns)); there is no
+ * parsing and no per-record work. All integers are little-endian, matching
+ * every supported target.
+ *
+ * File layout (all sections 8-byte aligned):
+ *   DataTableHeader
+ *   DataTableColumn[columnCount]
+ *   column data        recordCount * width each
+ *   DWORD stringOffsets[stringCount] + NUL-terminated string data
+ *   DWORD hashSeeds[hashBuckets] + DWORD hashSlots[hashSize]
+ */
+
+#ifndef DATATABLE_HPP
+#define DATATABLE_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#include <stddef.h>
+
+#define DATATABLE_MAGIC 0x42543244 // 'D2TB'
+#define DATATABLE_VERSION 1
+
+#define DATATABLE_NAME_LENGTH 24
+#define DATATABLE_NO_RECORD 0xFFFFFFFF
+#define DATATABLE_NO_LINK 0xFFFF
+#define DATATABLE_NO_STRING 0xFFFFFFFF
+
+// Open flags
+#define DATATABLE_OPEN_VERIFY 0x0001 // Also verify the payload checksum (one linear pass)
+
+typedef enum DataColumnType
+{
+    DTCOL_U8 = 1,
+    DTCOL_U16,
+    DTCOL_U32,
+    DTCOL_I8,
+    DTCOL_I16,
+    DTCOL_I32,
+    DTCOL_CODE,   // Up to 4 chars packed little-endian, space padded ('hax ')
+    DTCOL_STRING, // DWORD string pool index (DATATABLE_NO_STRING if empty)
+    DTCOL_LINK,   // WORD row index in another table (DATATABLE_NO_LINK if empty)
+} DataColumnType;
+
+#pragma pack(push, 1)
+typedef struct DataTableHeader
+{
+    DWORD magic;
+    WORD version;
+    WORD headerSize;
+    char szName[DATATABLE_NAME_LENGTH];
+    DWORD recordCount;
+    DWORD columnCount;
+    DWORD keyColumn; // Column indexed by the perfect hash, or DATATABLE_NO_RECORD
+    DWORD stringCount;
+    DWORD hashBuckets;
+    DWORD hashSize; // Power of two
+    DWORD columnsOffset;
+    DWORD stringsOffset; // stringOffsets[], followed by the string bytes
+    DWORD stringBytes;
+    DWORD hashOffset; // hashSeeds[], followed by hashSlots[]
+    DWORD fileSize;
+    DWORD checksum; // FNV-1a of bytes [headerSize, fileSize)
+} DataTableHeader;
+
+typedef struct DataTableColumn
+{
+    char szName[DATATABLE_NAME_LENGTH];
+    char szLinkTable[DATATABLE_NAME_LENGTH]; // DTCOL_LINK target
+    BYTE type;
+    BYTE width;
+    WORD reserved;
+    DWORD dataOffset;
+} DataTableColumn;
+#pragma pack(pop)
+
+typedef struct DataTable DataTable;
+
+// Map a compiled table file read-only. NULL if missing or malformed.
+DataTable *__cdecl DATATABLE_Open(const char *szPath, DWORD flags);
+
+// Use a compiled table already in memory (e.g. read from an MPQ); not copied
+DataTable *__cdecl DATATABLE_OpenMemory(const void *pData, size_t size, DWORD flags);
+void __cdecl DATATABLE_Close(DataTable *pTable);
+
+const DataTableHeader *__cdecl DATATABLE_GetHeader(const DataTable *pTable);
+DWORD __cdecl DATATABLE_GetRecordCount(const DataTable *pTable);
+
+// Resolve a column once at init and keep the index; -1 if absent
+int __cdecl DATATABLE_FindColumn(const DataTable *pTable, const char *szName);
+const DataTableColumn *__cdecl DATATABLE_GetColumnInfo(const DataTable *pTable, int column);
+
+// Raw column array (recordCount * width bytes) for tight loops
+const void *__cdecl DATATABLE_GetColumnData(const DataTable *pTable, int column);
+
+// Any integer-like cell widened to int32 (CODE/STRING/LINK return their raw value)
+int32_t __cdecl DATATABLE_GetInt(const DataTable *pTable, int column, DWORD record);
+
+// String pool entry; "" for DATATABLE_NO_STRING or out of range
+const char *__cdecl DATATABLE_GetString(const DataTable *pTable, DWORD stringIndex);
+const char *__cdecl DATATABLE_GetCellString(const DataTable *pTable, int column, DWORD record);
+
+// Perfect-hash lookup on the key column; DATATABLE_NO_RECORD if absent
+DWORD __cdecl DATATABLE_FindRecord(const DataTable *pTable, const char *szKey);
+DWORD __cdecl DATATABLE_FindCode(const DataTable *pTable, DWORD code);
+
+// Shared by the compiler and the runtime so both agree on keys
+DWORD __cdecl DATATABLE_PackCode(const char *szCode);
+DWORD __cdecl DATATABLE_HashKey(const char *szKey);
+DWORD __cdecl DATATABLE_HashBucket(DWORD key, DWORD buckets);
+DWORD __cdecl DATATABLE_HashSlot(DWORD key, DWORD seed, DWORD mask);
+DWORD __cdecl DATATABLE_Checksum(const BYTE *pData, size_t size);
+
+#endif // DATATABLE_HPP
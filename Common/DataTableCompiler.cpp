@@ -0,0 +1,608 @@
+/*
+ * DataTableCompiler.cpp - Offline compiler for D2Common excel tables
+ *
+ * Offline tool code: favours clarity over speed and uses the standard
+ * containers freely. Nothing here is linked into the game runtime.
+ */
+
+#include "DataTableCompiler.hpp"
+
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Perfect hash: ~4 keys per bucket, load factor <= 0.8
+#define PHASH_KEYS_PER_BUCKET 4
+#define PHASH_MAX_SEED 0x100000
+
+typedef struct CompilerTable
+{
+    const DataTableSchema *pSchema;
+    DWORD recordCount;
+    std::vector<std::string> cells; // recordCount * columnCount, schema column order
+    std::unordered_map<std::string, DWORD> keyIndex;
+} CompilerTable;
+
+struct DataCompiler
+{
+    std::vector<CompilerTable *> tables;
+    char szError[256];
+    char szWarning[256];
+    DWORD warnings;
+};
+
+static void SetError(DataCompiler *pCompiler, const char *szFormat, ...)
+{
+    va_list args;
+    va_start(args, szFormat);
+    vsnprintf(pCompiler->szError, sizeof(pCompiler->szError), szFormat, args);
+    va_end(args);
+}
+
+static void Warn(DataCompiler *pCompiler, const char *szFormat, ...)
+{
+    va_list args;
+    va_start(args, szFormat);
+    vsnprintf(pCompiler->szWarning, sizeof(pCompiler->szWarning), szFormat, args);
+    va_end(args);
+    pCompiler->warnings++;
+}
+
+DataCompiler *__cdecl DATACOMPILER_Create(void)
+{
+    DataCompiler *pCompiler = new DataCompiler();
+    pCompiler->szError[0] = '\0';
+    pCompiler->szWarning[0] = '\0';
+    pCompiler->warnings = 0;
+    return pCompiler;
+}
+
+void __cdecl DATACOMPILER_Destroy(DataCompiler *pCompiler)
+{
+    if (!pCompiler)
+    {
+        return;
+    }
+    for (size_t i = 0; i < pCompiler->tables.size(); i++)
+    {
+        delete pCompiler->tables[i];
+    }
+    delete pCompiler;
+}
+
+const char *__cdecl DATACOMPILER_GetError(const DataCompiler *pCompiler)
+{
+    return pCompiler->szError;
+}
+
+DWORD __cdecl DATACOMPILER_GetWarningCount(const DataCompiler *pCompiler)
+{
+    return pCompiler->warnings;
+}
+
+const char *__cdecl DATACOMPILER_GetLastWarning(const DataCompiler *pCompiler)
+{
+    return pCompiler->szWarning;
+}
+
+static CompilerTable *FindTable(DataCompiler *pCompiler, const char *szName)
+{
+    for (size_t i = 0; i < pCompiler->tables.size(); i++)
+    {
+        if (strcmp(pCompiler->tables[i]->pSchema->szName, szName) == 0)
+        {
+            return pCompiler->tables[i];
+        }
+    }
+    return NULL;
+}
+
+// =============================================================================
+// PARSING
+// =============================================================================
+
+static void SplitLine(const char *pLine, size_t length, std::vector<std::string> *pFields)
+{
+    pFields->clear();
+    size_t start = 0;
+
+    if (length && pLine[length - 1] == '\r')
+    {
+        length--;
+    }
+    for (size_t i = 0; i <= length; i++)
+    {
+        if (i == length || pLine[i] == '\t')
+        {
+            pFields->push_back(std::string(pLine + start, i - start));
+            start = i + 1;
+        }
+    }
+}
+
+BOOL __cdecl DATACOMPILER_AddTable(DataCompiler *pCompiler, const DataTableSchema *pSchema, const char *pText,
+                                   size_t length)
+{
+    if (!pSchema || strlen(pSchema->szName) >= DATATABLE_NAME_LENGTH || FindTable(pCompiler, pSchema->szName))
+    {
+        SetError(pCompiler, "invalid or duplicate table schema");
+        return FALSE;
+    }
+
+    DWORD columnCount = pSchema->columnCount;
+    std::vector<int> sourceIndex(columnCount, -1); // Schema column -> .txt field
+    std::vector<std::string> fields;
+    int keyColumn = -1;
+    BOOL haveHeader = FALSE;
+
+    CompilerTable *pTable = new CompilerTable();
+    pTable->pSchema = pSchema;
+    pTable->recordCount = 0;
+
+    for (DWORD c = 0; c < columnCount; c++)
+    {
+        if (pSchema->szKeyColumn && strcmp(pSchema->pColumns[c].szColumn, pSchema->szKeyColumn) == 0)
+        {
+            keyColumn = (int)c;
+        }
+    }
+
+    size_t pos = 0;
+    while (pos < length)
+    {
+        const char *pLine = pText + pos;
+        const char *pEnd = (const char *)memchr(pLine, '\n', length - pos);
+        size_t lineLength = pEnd ? (size_t)(pEnd - pLine) : length - pos;
+        pos += lineLength + 1;
+
+        SplitLine(pLine, lineLength, &fields);
+        if (fields.size() == 1 && fields[0].empty())
+        {
+            continue;
+        }
+
+        if (!haveHeader)
+        {
+            for (DWORD c = 0; c < columnCount; c++)
+            {
+                for (size_t f = 0; f < fields.size(); f++)
+                {
+                    if (fields[f] == pSchema->pColumns[c].szColumn)
+                    {
+                        sourceIndex[c] = (int)f;
+                        break;
+                    }
+                }
+                if (sourceIndex[c] < 0)
+                {
+                    Warn(pCompiler, "%s: column '%s' missing, compiled as empty", pSchema->szName,
+                         pSchema->pColumns[c].szColumn);
+                }
+            }
+            haveHeader = TRUE;
+            continue;
+        }
+
+        // D2 marker row separating classic and expansion records
+        if (fields[0] == "Expansion")
+        {
+            continue;
+        }
+
+        for (DWORD c = 0; c < columnCount; c++)
+        {
+            int f = sourceIndex[c];
+            pTable->cells.push_back((f >= 0 && (size_t)f < fields.size()) ? fields[f] : std::string());
+        }
+
+        if (keyColumn >= 0)
+        {
+            const std::string &key = pTable->cells[(size_t)pTable->recordCount * columnCount + keyColumn];
+            if (!key.empty() && !pTable->keyIndex.insert(std::make_pair(key, pTable->recordCount)).second)
+            {
+                Warn(pCompiler, "%s: duplicate key '%s', first row wins", pSchema->szName, key.c_str());
+            }
+        }
+        pTable->recordCount++;
+    }
+
+    if (!haveHeader || pTable->recordCount >= DATATABLE_NO_LINK)
+    {
+        SetError(pCompiler, "%s: missing header or too many records", pSchema->szName);
+        delete pTable;
+        return FALSE;
+    }
+
+    pCompiler->tables.push_back(pTable);
+    return TRUE;
+}
+
+// =============================================================================
+// COMPILATION
+// =============================================================================
+
+static BYTE TypeWidth(BYTE type)
+{
+    switch (type)
+    {
+    case DTCOL_U8:
+    case DTCOL_I8:
+        return 1;
+    case DTCOL_U16:
+    case DTCOL_I16:
+    case DTCOL_LINK:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+static BOOL ParseInt(const std::string &text, BYTE type, int64_t *pValue)
+{
+    if (text.empty())
+    {
+        *pValue = 0;
+        return TRUE;
+    }
+
+    char *pEnd = NULL;
+    long long value = strtoll(text.c_str(), &pEnd, 10);
+    if (*pEnd != '\0')
+    {
+        return FALSE;
+    }
+
+    int64_t lo, hi;
+    switch (type)
+    {
+    case DTCOL_U8:
+        lo = 0, hi = 0xFF;
+        break;
+    case DTCOL_I8:
+        lo = -128, hi = 127;
+        break;
+    case DTCOL_U16:
+        lo = 0, hi = 0xFFFF;
+        break;
+    case DTCOL_I16:
+        lo = -32768, hi = 32767;
+        break;
+    case DTCOL_U32:
+        lo = 0, hi = 0xFFFFFFFFll;
+        break;
+    default:
+        lo = -2147483647ll - 1, hi = 2147483647ll;
+        break;
+    }
+    *pValue = value;
+    return value >= lo && value <= hi;
+}
+
+/*
+ * BuildPerfectHash
+ * Hash-and-displace: keys are grouped into buckets, and buckets (largest
+ * first) search for a seed that sends all their keys to free slots. Lookup is
+ * then seed = seeds[bucket(key)], record = slots[slot(key, seed)].
+ */
+static BOOL BuildPerfectHash(const std::vector<DWORD> &keys, const std::vector<DWORD> &records,
+                             std::vector<DWORD> *pSeeds, std::vector<DWORD> *pSlots)
+{
+    DWORD n = (DWORD)keys.size();
+    DWORD buckets = n / PHASH_KEYS_PER_BUCKET + 1;
+    DWORD size = D2_NextPow2(n + n / 4 + 1);
+
+    for (DWORD attempt = 0; attempt < 4; attempt++, size *= 2)
+    {
+        std::vector<std::vector<DWORD> > members(buckets);
+        for (DWORD i = 0; i < n; i++)
+        {
+            members[DATATABLE_HashBucket(keys[i], buckets)].push_back(i);
+        }
+
+        std::vector<DWORD> order(buckets);
+        for (DWORD b = 0; b < buckets; b++)
+        {
+            order[b] = b;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [&members](DWORD a, DWORD b) { return members[a].size() > members[b].size(); });
+
+        pSeeds->assign(buckets, 0);
+        pSlots->assign(size, DATATABLE_NO_RECORD);
+        std::vector<DWORD> placed;
+        BOOL ok = TRUE;
+
+        for (DWORD o = 0; o < buckets && ok; o++)
+        {
+            const std::vector<DWORD> &bucket = members[order[o]];
+            if (bucket.empty())
+            {
+                break;
+            }
+
+            ok = FALSE;
+            for (DWORD seed = 0; seed < PHASH_MAX_SEED && !ok; seed++)
+            {
+                placed.clear();
+                ok = TRUE;
+                for (size_t k = 0; k < bucket.size() && ok; k++)
+                {
+                    DWORD slot = DATATABLE_HashSlot(keys[bucket[k]], seed, size - 1);
+                    ok = (*pSlots)[slot] == DATATABLE_NO_RECORD &&
+                         std::find(placed.begin(), placed.end(), slot) == placed.end();
+                    placed.push_back(slot);
+                }
+                if (ok)
+                {
+                    for (size_t k = 0; k < bucket.size(); k++)
+                    {
+                        (*pSlots)[placed[k]] = records[bucket[k]];
+                    }
+                    (*pSeeds)[order[o]] = seed;
+                }
+            }
+        }
+
+        if (ok)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static DWORD Align8(DWORD offset)
+{
+    return (offset + 7) & ~7u;
+}
+
+BOOL __cdecl DATACOMPILER_Compile(DataCompiler *pCompiler, const char *szTable, BYTE **ppBlob, DWORD *pSize)
+{
+    CompilerTable *pTable = FindTable(pCompiler, szTable);
+    if (!pTable)
+    {
+        SetError(pCompiler, "%s: table not added", szTable);
+        return FALSE;
+    }
+
+    const DataTableSchema *pSchema = pTable->pSchema;
+    DWORD columnCount = pSchema->columnCount;
+    DWORD records = pTable->recordCount;
+    std::vector<std::vector<BYTE> > columnData(columnCount);
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, DWORD> stringIndex;
+    DWORD stringBytes = 0;
+    DWORD keyColumn = DATATABLE_NO_RECORD;
+
+    for (DWORD c = 0; c < columnCount; c++)
+    {
+        const DataColumnSchema *pColumn = &pSchema->pColumns[c];
+        BYTE width = TypeWidth(pColumn->type);
+        CompilerTable *pLinkTable = NULL;
+
+        if (strlen(pColumn->szColumn) >= DATATABLE_NAME_LENGTH)
+        {
+            SetError(pCompiler, "%s: column name '%s' too long", szTable, pColumn->szColumn);
+            return FALSE;
+        }
+        if (pColumn->type == DTCOL_LINK)
+        {
+            pLinkTable = pColumn->szLinkTable ? FindTable(pCompiler, pColumn->szLinkTable) : NULL;
+            if (!pLinkTable)
+            {
+                SetError(pCompiler, "%s.%s: link target '%s' not added", szTable, pColumn->szColumn,
+                         pColumn->szLinkTable ? pColumn->szLinkTable : "(none)");
+                return FALSE;
+            }
+        }
+        if (pSchema->szKeyColumn && strcmp(pColumn->szColumn, pSchema->szKeyColumn) == 0)
+        {
+            if (pColumn->type != DTCOL_STRING && pColumn->type != DTCOL_CODE)
+            {
+                SetError(pCompiler, "%s: key column must be a string or code", szTable);
+                return FALSE;
+            }
+            keyColumn = c;
+        }
+
+        columnData[c].resize((size_t)records * width);
+        for (DWORD r = 0; r < records; r++)
+        {
+            const std::string &text = pTable->cells[(size_t)r * columnCount + c];
+            BYTE *pCell = &columnData[c][(size_t)r * width];
+            DWORD value = 0;
+
+            if (pColumn->type == DTCOL_STRING)
+            {
+                value = DATATABLE_NO_STRING;
+                if (!text.empty())
+                {
+                    std::unordered_map<std::string, DWORD>::iterator it = stringIndex.find(text);
+                    if (it == stringIndex.end())
+                    {
+                        it = stringIndex.insert(std::make_pair(text, (DWORD)strings.size())).first;
+                        strings.push_back(text);
+                        stringBytes += (DWORD)text.size() + 1;
+                    }
+                    value = it->second;
+                }
+            }
+            else if (pColumn->type == DTCOL_CODE)
+            {
+                if (text.size() > 4)
+                {
+                    SetError(pCompiler, "%s.%s row %u: code '%s' longer than 4 chars", szTable, pColumn->szColumn, r,
+                             text.c_str());
+                    return FALSE;
+                }
+                value = text.empty() ? 0 : DATATABLE_PackCode(text.c_str());
+            }
+            else if (pColumn->type == DTCOL_LINK)
+            {
+                value = DATATABLE_NO_LINK;
+                if (!text.empty())
+                {
+                    std::unordered_map<std::string, DWORD>::iterator it = pLinkTable->keyIndex.find(text);
+                    if (it != pLinkTable->keyIndex.end())
+                        value = it->second;
+                    else
+                        Warn(pCompiler, "%s.%s row %u: '%s' not found in %s", szTable, pColumn->szColumn, r,
+                             text.c_str(), pColumn->szLinkTable);
+                }
+            }
+            else
+            {
+                int64_t parsed;
+                if (!ParseInt(text, pColumn->type, &parsed))
+                {
+                    SetError(pCompiler, "%s.%s row %u: '%s' is not a valid value", szTable, pColumn->szColumn, r,
+                             text.c_str());
+                    return FALSE;
+                }
+                value = (DWORD)parsed;
+            }
+
+            // Little-endian store of the low `width` bytes
+            for (BYTE b = 0; b < width; b++)
+            {
+                pCell[b] = (BYTE)(value >> (b * 8));
+            }
+        }
+    }
+
+    // Perfect hash over the key column
+    std::vector<DWORD> seeds, slots;
+    if (keyColumn != DATATABLE_NO_RECORD)
+    {
+        std::vector<DWORD> keys, keyRecords;
+        std::unordered_map<DWORD, DWORD> seen;
+        BOOL isCode = pSchema->pColumns[keyColumn].type == DTCOL_CODE;
+
+        for (std::unordered_map<std::string, DWORD>::iterator it = pTable->keyIndex.begin();
+             it != pTable->keyIndex.end(); ++it)
+        {
+            DWORD key = isCode ? DATATABLE_PackCode(it->first.c_str()) : DATATABLE_HashKey(it->first.c_str());
+            if (!seen.insert(std::make_pair(key, it->second)).second)
+            {
+                SetError(pCompiler, "%s: key '%s' collides with another key", szTable, it->first.c_str());
+                return FALSE;
+            }
+            keys.push_back(key);
+            keyRecords.push_back(it->second);
+        }
+        if (!BuildPerfectHash(keys, keyRecords, &seeds, &slots))
+        {
+            SetError(pCompiler, "%s: perfect hash construction failed", szTable);
+            return FALSE;
+        }
+    }
+
+    // Layout
+    DataTableHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DATATABLE_MAGIC;
+    header.version = DATATABLE_VERSION;
+    header.headerSize = sizeof(DataTableHeader);
+    strcpy(header.szName, pSchema->szName);
+    header.recordCount = records;
+    header.columnCount = columnCount;
+    header.keyColumn = keyColumn;
+    header.stringCount = (DWORD)strings.size();
+    header.stringBytes = stringBytes;
+    header.hashBuckets = (DWORD)seeds.size();
+    header.hashSize = (DWORD)slots.size();
+
+    DWORD offset = Align8(sizeof(DataTableHeader));
+    header.columnsOffset = offset;
+    offset = Align8(offset + columnCount * sizeof(DataTableColumn));
+
+    std::vector<DataTableColumn> columns(columnCount);
+    for (DWORD c = 0; c < columnCount; c++)
+    {
+        memset(&columns[c], 0, sizeof(DataTableColumn));
+        strcpy(columns[c].szName, pSchema->pColumns[c].szColumn);
+        if (pSchema->pColumns[c].szLinkTable)
+        {
+            strncpy(columns[c].szLinkTable, pSchema->pColumns[c].szLinkTable, DATATABLE_NAME_LENGTH - 1);
+        }
+        columns[c].type = pSchema->pColumns[c].type;
+        columns[c].width = TypeWidth(columns[c].type);
+        columns[c].dataOffset = offset;
+        offset = Align8(offset + (DWORD)columnData[c].size());
+    }
+
+    header.stringsOffset = offset;
+    offset = Align8(offset + header.stringCount * sizeof(DWORD) + stringBytes);
+    header.hashOffset = offset;
+    offset += (header.hashBuckets + header.hashSize) * sizeof(DWORD);
+    header.fileSize = offset;
+
+    BYTE *pBlob = (BYTE *)calloc(1, offset);
+    if (!pBlob)
+    {
+        SetError(pCompiler, "%s: out of memory", szTable);
+        return FALSE;
+    }
+
+    memcpy(pBlob + header.columnsOffset, columns.data(), columnCount * sizeof(DataTableColumn));
+    for (DWORD c = 0; c < columnCount; c++)
+    {
+        if (!columnData[c].empty())
+        {
+            memcpy(pBlob + columns[c].dataOffset, columnData[c].data(), columnData[c].size());
+        }
+    }
+
+    DWORD *pStringOffsets = (DWORD *)(pBlob + header.stringsOffset);
+    char *pStringData = (char *)(pStringOffsets + header.stringCount);
+    DWORD stringOffset = 0;
+    for (size_t s = 0; s < strings.size(); s++)
+    {
+        pStringOffsets[s] = stringOffset;
+        memcpy(pStringData + stringOffset, strings[s].c_str(), strings[s].size() + 1);
+        stringOffset += (DWORD)strings[s].size() + 1;
+    }
+
+    if (!seeds.empty())
+    {
+        memcpy(pBlob + header.hashOffset, seeds.data(), seeds.size() * sizeof(DWORD));
+        memcpy(pBlob + header.hashOffset + seeds.size() * sizeof(DWORD), slots.data(), slots.size() * sizeof(DWORD));
+    }
+
+    header.checksum = DATATABLE_Checksum(pBlob + header.headerSize, offset - header.headerSize);
+    memcpy(pBlob, &header, sizeof(header));
+
+    *ppBlob = pBlob;
+    *pSize = offset;
+    return TRUE;
+}
+
+BOOL __cdecl DATACOMPILER_WriteFile(DataCompiler *pCompiler, const char *szTable, const char *szPath)
+{
+    BYTE *pBlob = NULL;
+    DWORD size = 0;
+
+    if (!DATACOMPILER_Compile(pCompiler, szTable, &pBlob, &size))
+    {
+        return FALSE;
+    }
+
+    FILE *pFile = fopen(szPath, "wb");
+    BOOL ok = pFile && fwrite(pBlob, 1, size, pFile) == size;
+    if (pFile && fclose(pFile) != 0)
+    {
+        ok = FALSE;
+    }
+    free(pBlob);
+
+    if (!ok)
+    {
+        SetError(pCompiler, "%s: cannot write %s", szTable, szPath);
+    }
+    return ok;
+}
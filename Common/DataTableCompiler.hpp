@@ -0,0 +1,60 @@
+/*
+ * DataTableCompiler.hpp - Offline compiler for D2Common excel tables
+ *
+ * Turns tab-delimited excel .txt files into the compiled .d2t format read by
+ * DataTable.hpp. Only the game build tools link this; the runtime never
+ * parses text.
+ *
+ * Usage:
+ *   1. DATACOMPILER_AddTable for every table (links are resolved across the
+ *      whole set, so add link targets too).
+ *   2. DATACOMPILER_Compile / DATACOMPILER_WriteFile per table.
+ *
+ * Rows follow D2's rules: the first line is the header, blank lines and the
+ * "Expansion" marker rows are skipped and do not take a record index.
+ */
+
+#ifndef DATATABLECOMPILER_HPP
+#define DATATABLECOMPILER_HPP
+
+#include "DataTable.hpp"
+
+typedef struct DataColumnSchema
+{
+    const char *szColumn;    // Header text in the .txt
+    BYTE type;               // DataColumnType
+    const char *szLinkTable; // DTCOL_LINK: table whose key column the cell names
+} DataColumnSchema;
+
+typedef struct DataTableSchema
+{
+    const char *szName;      // "missiles", "skills", ...
+    const char *szKeyColumn; // Perfect-hashed column (DTCOL_STRING or DTCOL_CODE), may be NULL
+    const DataColumnSchema *pColumns;
+    DWORD columnCount;
+} DataTableSchema;
+
+typedef struct DataCompiler DataCompiler;
+
+DataCompiler *__cdecl DATACOMPILER_Create(void);
+void __cdecl DATACOMPILER_Destroy(DataCompiler *pCompiler);
+
+// Parse one table. Columns missing from the .txt compile as zero/empty with a warning.
+BOOL __cdecl DATACOMPILER_AddTable(DataCompiler *pCompiler, const DataTableSchema *pSchema, const char *pText,
+                                   size_t length);
+
+// Compile to a malloc'd blob (release with free)
+BOOL __cdecl DATACOMPILER_Compile(DataCompiler *pCompiler, const char *szTable, BYTE **ppBlob, DWORD *pSize);
+BOOL __cdecl DATACOMPILER_WriteFile(DataCompiler *pCompiler, const char *szTable, const char *szPath);
+
+// Last error, and warnings (missing columns, unresolved links) since creation
+const char *__cdecl DATACOMPILER_GetError(const DataCompiler *pCompiler);
+DWORD __cdecl DATACOMPILER_GetWarningCount(const DataCompiler *pCompiler);
+const char *__cdecl DATACOMPILER_GetLastWarning(const DataCompiler *pCompiler);
+
+// Built-in schemas for the tables the native subsystems read (DataTableSchemas.cpp)
+const DataTableSchema *__cdecl DATACOMPILER_FindSchema(const char *szName);
+DWORD __cdecl DATACOMPILER_GetSchemaCount(void);
+const DataTableSchema *__cdecl DATACOMPILER_GetSchema(DWORD index);
+
+#endif // DATATABLECOMPILER_HPP
@@ -0,0 +1,149 @@
+/*
+ * DataTableSchemas.cpp - Built-in schemas for compiled D2Common tables
+ *
+ * Column names are the excel headers. Only columns the native subsystems
+ * read are compiled; everything else in the sheet is ignored.
+ */
+
+#include "DataTableCompiler.hpp"
+
+#include <string.h>
+
+static const DataColumnSchema s_missilesColumns[] = {
+    {"Missile", DTCOL_STRING, NULL},
+    {"Id", DTCOL_U16, NULL},
+    {"Vel", DTCOL_I16, NULL},
+    {"MaxVel", DTCOL_I16, NULL},
+    {"Accel", DTCOL_I16, NULL},
+    {"Range", DTCOL_U16, NULL},
+    {"LevRange", DTCOL_U16, NULL},
+    {"Light", DTCOL_U8, NULL},
+    {"Size", DTCOL_U8, NULL},
+    {"CollideType", DTCOL_U8, NULL},
+    {"MinDamage", DTCOL_I32, NULL},
+    {"MaxDamage", DTCOL_I32, NULL},
+    {"EType", DTCOL_CODE, NULL},
+    {"EMin", DTCOL_I32, NULL},
+    {"EMax", DTCOL_I32, NULL},
+    {"ExplosionMissile", DTCOL_LINK, "missiles"},
+    {"SubMissile1", DTCOL_LINK, "missiles"},
+};
+
+static const DataColumnSchema s_skillsColumns[] = {
+    {"skill", DTCOL_STRING, NULL},
+    {"Id", DTCOL_U16, NULL},
+    {"charclass", DTCOL_CODE, NULL},
+    {"reqlevel", DTCOL_U8, NULL},
+    {"maxlvl", DTCOL_U8, NULL},
+    {"reqskill1", DTCOL_LINK, "skills"},
+    {"reqskill2", DTCOL_LINK, "skills"},
+    {"reqskill3", DTCOL_LINK, "skills"},
+    {"mana", DTCOL_U16, NULL},
+    {"lvlmana", DTCOL_I16, NULL},
+    {"range", DTCOL_CODE, NULL},
+    {"aura", DTCOL_U8, NULL},
+    {"srvmissile", DTCOL_LINK, "missiles"},
+    {"srvmissilea", DTCOL_LINK, "missiles"},
+    {"cltmissile", DTCOL_LINK, "missiles"},
+    {"EType", DTCOL_CODE, NULL},
+    {"EMin", DTCOL_I32, NULL},
+    {"EMax", DTCOL_I32, NULL},
+};
+
+static const DataColumnSchema s_monstatsColumns[] = {
+    {"Id", DTCOL_STRING, NULL},
+    {"hcIdx", DTCOL_U16, NULL},
+    {"BaseId", DTCOL_LINK, "monstats"},
+    {"NextInClass", DTCOL_LINK, "monstats"},
+    {"NameStr", DTCOL_STRING, NULL},
+    {"MonType", DTCOL_STRING, NULL},
+    {"AI", DTCOL_STRING, NULL},
+    {"Level", DTCOL_U8, NULL},
+    {"Level(N)", DTCOL_U8, NULL},
+    {"Level(H)", DTCOL_U8, NULL},
+    {"Velocity", DTCOL_U8, NULL},
+    {"Run", DTCOL_U8, NULL},
+    {"MinHP", DTCOL_I32, NULL},
+    {"MaxHP", DTCOL_I32, NULL},
+    {"AC", DTCOL_I32, NULL},
+    {"Exp", DTCOL_I32, NULL},
+    {"A1MinD", DTCOL_I32, NULL},
+    {"A1MaxD", DTCOL_I32, NULL},
+    {"ResFi", DTCOL_I16, NULL},
+    {"ResLi", DTCOL_I16, NULL},
+    {"ResCo", DTCOL_I16, NULL},
+    {"ResPo", DTCOL_I16, NULL},
+    {"Skill1", DTCOL_LINK, "skills"},
+    {"Skill2", DTCOL_LINK, "skills"},
+    {"MissA1", DTCOL_LINK, "missiles"},
+    {"boss", DTCOL_U8, NULL},
+};
+
+static const DataColumnSchema s_levelsColumns[] = {
+    {"Name", DTCOL_STRING, NULL},
+    {"Id", DTCOL_U16, NULL},
+    {"Act", DTCOL_U8, NULL},
+    {"Rain", DTCOL_U8, NULL},
+    {"SizeX", DTCOL_U16, NULL},
+    {"SizeY", DTCOL_U16, NULL},
+    {"Waypoint", DTCOL_U8, NULL},
+    {"MonLvl1", DTCOL_U8, NULL},
+    {"MonLvl2", DTCOL_U8, NULL},
+    {"MonLvl3", DTCOL_U8, NULL},
+    {"LevelName", DTCOL_STRING, NULL},
+    {"mon1", DTCOL_LINK, "monstats"},
+    {"mon2", DTCOL_LINK, "monstats"},
+    {"mon3", DTCOL_LINK, "monstats"},
+    {"mon4", DTCOL_LINK, "monstats"},
+};
+
+static const DataColumnSchema s_weaponsColumns[] = {
+    {"name", DTCOL_STRING, NULL},
+    {"type", DTCOL_CODE, NULL},
+    {"code", DTCOL_CODE, NULL},
+    {"level", DTCOL_U8, NULL},
+    {"levelreq", DTCOL_U8, NULL},
+    {"mindam", DTCOL_U8, NULL},
+    {"maxdam", DTCOL_U8, NULL},
+    {"speed", DTCOL_I8, NULL},
+    {"reqstr", DTCOL_U16, NULL},
+    {"reqdex", DTCOL_U16, NULL},
+    {"durability", DTCOL_U8, NULL},
+    {"cost", DTCOL_I32, NULL},
+    {"gemsockets", DTCOL_U8, NULL},
+    {"invwidth", DTCOL_U8, NULL},
+    {"invheight", DTCOL_U8, NULL},
+    {"normcode", DTCOL_CODE, NULL},
+    {"ubercode", DTCOL_CODE, NULL},
+    {"ultracode", DTCOL_CODE, NULL},
+};
+
+static const DataTableSchema s_schemas[] = {
+    {"missiles", "Missile", s_missilesColumns, D2_ARRAY_SIZE(s_missilesColumns)},
+    {"skills", "skill", s_skillsColumns, D2_ARRAY_SIZE(s_skillsColumns)},
+    {"monstats", "Id", s_monstatsColumns, D2_ARRAY_SIZE(s_monstatsColumns)},
+    {"levels", "Name", s_levelsColumns, D2_ARRAY_SIZE(s_levelsColumns)},
+    {"weapons", "code", s_weaponsColumns, D2_ARRAY_SIZE(s_weaponsColumns)},
+};
+
+const DataTableSchema *__cdecl DATACOMPILER_FindSchema(const char *szName)
+{
+    for (DWORD i = 0; i < D2_ARRAY_SIZE(s_schemas); i++)
+    {
+        if (strcmp(s_schemas[i].szName, szName) == 0)
+        {
+            return &s_schemas[i];
+        }
+    }
+    return NULL;
+}
+
+DWORD __cdecl DATACOMPILER_GetSchemaCount(void)
+{
+    return D2_ARRAY_SIZE(s_schemas);
+}
+
+const DataTableSchema *__cdecl DATACOMPILER_GetSchema(DWORD index)
+{
+    return (index < D2_ARRAY_SIZE(s_schemas)) ? &s_schemas[index] : NULL;
+}
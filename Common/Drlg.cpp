@@ -0,0 +1,702 @@
+/*
+ * Drlg.cpp - D2Common level layout generation
+ *
+ * See Drlg.hpp for the level types and the seeding rule.
+ */
+
+#include "Drlg.hpp"
+#include "Rng.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define DRLG_SUBTILES_PER_TILE 5
+#define DRLG_MAZE_MAX_GRID 32
+
+// Preset levels are split into rooms of this many tiles, like the game's
+// DrlgRoom bounds for DS1 maps
+#define DRLG_PRESET_ROOM_TILES DRLG_CELL_TILES
+
+// =============================================================================
+// LEVEL TABLE
+// =============================================================================
+
+// Styles (preset blocks). Towns and fixed maps own a style each.
+enum
+{
+    STYLE_ROGUE_CAMP,
+    STYLE_A1_WILD,
+    STYLE_A1_CAVE,
+    STYLE_A1_CRYPT,
+    STYLE_FORGOTTEN_TOWER,
+    STYLE_MONASTERY_GATE,
+    STYLE_OUTER_CLOISTER,
+    STYLE_A1_JAIL,
+    STYLE_INNER_CLOISTER,
+    STYLE_CATHEDRAL,
+    STYLE_A1_CATACOMBS,
+    STYLE_ANDARIEL_LAIR,
+    STYLE_TRISTRAM,
+    STYLE_COW_LEVEL,
+    STYLE_LUT_GHOLEIN,
+    STYLE_A2_DESERT,
+    STYLE_A2_SEWERS,
+    STYLE_A2_TOMB,
+    STYLE_HAREM1,
+    STYLE_HAREM2,
+    STYLE_A2_LAIR,
+    STYLE_DURIEL_LAIR,
+    STYLE_ARCANE_SANCTUARY,
+    STYLE_KURAST_DOCKS,
+    STYLE_A3_JUNGLE,
+    STYLE_A3_DUNGEON,
+    STYLE_A3_KURAST,
+    STYLE_TRAVINCAL,
+    STYLE_A3_SEWERS,
+    STYLE_A3_TEMPLE,
+    STYLE_A3_MEPHISTO,
+    STYLE_DURANCE3,
+    STYLE_PANDEMONIUM,
+    STYLE_A4_MESA,
+    STYLE_CHAOS_SANCTUARY,
+    STYLE_HARROGATH,
+    STYLE_A5_SIEGE,
+    STYLE_A5_ICE,
+    STYLE_ARREAT_SUMMIT,
+    STYLE_NIHLATHAK_TEMPLE,
+    STYLE_A5_TEMPLE,
+    STYLE_A5_PIT,
+    STYLE_A5_BAAL,
+    STYLE_THRONE,
+    STYLE_WORLDSTONE_CHAMBER,
+};
+
+#define M DRLGTYPE_MAZE
+#define P DRLGTYPE_PRESET
+#define O DRLGTYPE_OUTDOOR
+
+// id, act, type, style, sizeX, sizeY, rooms, adjacent
+static const DrlgLevelDef s_defaultLevels[] = {
+    // Act 1
+    {1, 0, P, STYLE_ROGUE_CAMP, 64, 48, 0, {2}},
+    {2, 0, O, STYLE_A1_WILD, 10, 8, 3, {1, 3, 8}},
+    {3, 0, O, STYLE_A1_WILD, 10, 10, 4, {2, 4, 9, 17}},
+    {4, 0, O, STYLE_A1_WILD, 12, 10, 4, {3, 5, 10, 38}},
+    {5, 0, O, STYLE_A1_WILD, 10, 12, 4, {4, 6}},
+    {6, 0, O, STYLE_A1_WILD, 12, 10, 4, {5, 7, 11, 20}},
+    {7, 0, O, STYLE_A1_WILD, 12, 10, 4, {6, 12, 26}},
+    {8, 0, M, STYLE_A1_CAVE, 12, 12, 18, {2}},
+    {9, 0, M, STYLE_A1_CAVE, 12, 12, 16, {3, 13}},
+    {10, 0, M, STYLE_A1_CAVE, 14, 14, 22, {4, 14}},
+    {11, 0, M, STYLE_A1_CAVE, 12, 12, 16, {6, 15}},
+    {12, 0, M, STYLE_A1_CAVE, 12, 12, 14, {7, 16}},
+    {13, 0, M, STYLE_A1_CAVE, 10, 10, 12, {9}},
+    {14, 0, M, STYLE_A1_CAVE, 12, 12, 16, {10}},
+    {15, 0, M, STYLE_A1_CAVE, 10, 10, 12, {11}},
+    {16, 0, M, STYLE_A1_CAVE, 10, 10, 10, {12}},
+    {17, 0, O, STYLE_A1_WILD, 6, 8, 2, {3, 18, 19}},
+    {18, 0, M, STYLE_A1_CRYPT, 10, 10, 14, {17}},
+    {19, 0, M, STYLE_A1_CRYPT, 10, 10, 14, {17}},
+    {20, 0, P, STYLE_FORGOTTEN_TOWER, 24, 24, 0, {6, 21}},
+    {21, 0, M, STYLE_A1_CRYPT, 8, 8, 10, {20, 22}},
+    {22, 0, M, STYLE_A1_CRYPT, 8, 8, 10, {21, 23}},
+    {23, 0, M, STYLE_A1_CRYPT, 8, 8, 10, {22, 24}},
+    {24, 0, M, STYLE_A1_CRYPT, 8, 8, 10, {23, 25}},
+    {25, 0, M, STYLE_A1_CRYPT, 8, 8, 10, {24}},
+    {26, 0, P, STYLE_MONASTERY_GATE, 40, 32, 0, {7, 27}},
+    {27, 0, P, STYLE_OUTER_CLOISTER, 48, 40, 0, {26, 28}},
+    {28, 0, M, STYLE_A1_JAIL, 14, 14, 24, {27, 29}},
+    {29, 0, M, STYLE_A1_JAIL, 14, 14, 22, {28, 30}},
+    {30, 0, M, STYLE_A1_JAIL, 14, 14, 22, {29, 31}},
+    {31, 0, M, STYLE_A1_JAIL, 14, 14, 22, {30, 32}},
+    {32, 0, P, STYLE_INNER_CLOISTER, 40, 40, 0, {31, 33}},
+    {33, 0, P, STYLE_CATHEDRAL, 40, 48, 0, {32, 34}},
+    {34, 0, M, STYLE_A1_CATACOMBS, 14, 14, 24, {33, 35}},
+    {35, 0, M, STYLE_A1_CATACOMBS, 14, 14, 24, {34, 36}},
+    {36, 0, M, STYLE_A1_CATACOMBS, 14, 14, 24, {35, 37}},
+    {37, 0, P, STYLE_ANDARIEL_LAIR, 32, 32, 0, {36}},
+    {38, 0, P, STYLE_TRISTRAM, 64, 64, 0, {4}},
+    {39, 0, O, STYLE_COW_LEVEL, 12, 12, 4, {1}},
+
+    // Act 2
+    {40, 1, P, STYLE_LUT_GHOLEIN, 72, 64, 0, {41, 47, 50}},
+    {41, 1, O, STYLE_A2_DESERT, 12, 10, 4, {40, 42, 55}},
+    {42, 1, O, STYLE_A2_DESERT, 12, 12, 4, {41, 43, 56}},
+    {43, 1, O, STYLE_A2_DESERT, 12, 12, 4, {42, 44, 62}},
+    {44, 1, O, STYLE_A2_DESERT, 12, 12, 4, {43, 45, 46, 65}},
+    {45, 1, O, STYLE_A2_DESERT, 10, 8, 2, {44, 58}},
+    {46, 1, O, STYLE_A2_DESERT, 12, 12, 7, {44, 66, 67, 74}},
+    {47, 1, M, STYLE_A2_SEWERS, 16, 16, 26, {40, 48}},
+    {48, 1, M, STYLE_A2_SEWERS, 16, 16, 26, {47, 49}},
+    {49, 1, M, STYLE_A2_SEWERS, 16, 16, 26, {48}},
+    {50, 1, P, STYLE_HAREM1, 32, 32, 0, {40, 51}},
+    {51, 1, P, STYLE_HAREM2, 40, 40, 0, {50, 52}},
+    {52, 1, M, STYLE_A2_SEWERS, 12, 12, 18, {51, 53}},
+    {53, 1, M, STYLE_A2_SEWERS, 12, 12, 18, {52, 54}},
+    {54, 1, M, STYLE_A2_SEWERS, 12, 12, 18, {53, 74}},
+    {55, 1, M, STYLE_A2_TOMB, 12, 12, 18, {41, 59}},
+    {56, 1, M, STYLE_A2_TOMB, 12, 12, 18, {42, 57}},
+    {57, 1, M, STYLE_A2_TOMB, 12, 12, 18, {56, 60}},
+    {58, 1, M, STYLE_A2_TOMB, 12, 12, 16, {45, 61}},
+    {59, 1, M, STYLE_A2_TOMB, 10, 10, 14, {55}},
+    {60, 1, M, STYLE_A2_TOMB, 10, 10, 14, {57}},
+    {61, 1, M, STYLE_A2_TOMB, 10, 10, 14, {58}},
+    {62, 1, M, STYLE_A2_LAIR, 14, 14, 20, {43, 63}},
+    {63, 1, M, STYLE_A2_LAIR, 14, 14, 20, {62, 64}},
+    {64, 1, M, STYLE_A2_LAIR, 14, 14, 20, {63}},
+    {65, 1, M, STYLE_A2_LAIR, 14, 14, 24, {44}},
+    {66, 1, M, STYLE_A2_TOMB, 12, 12, 18, {46, 73}},
+    {67, 1, M, STYLE_A2_TOMB, 12, 12, 18, {46}},
+    {68, 1, M, STYLE_A2_TOMB, 12, 12, 18, {46}},
+    {69, 1, M, STYLE_A2_TOMB, 12, 12, 18, {46}},
+    {70, 1, M, STYLE_A2_TOMB, 12, 12, 18, {46}},
+    {71, 1, M, STYLE_A2_TOMB, 12, 12, 18, {46}},
+    {72, 1, M, STYLE_A2_TOMB, 12, 12, 18, {46}},
+    {73, 1, P, STYLE_DURIEL_LAIR, 16, 16, 0, {66}},
+    {74, 1, P, STYLE_ARCANE_SANCTUARY, 64, 64, 0, {54, 46}},
+
+    // Act 3
+    {75, 2, P, STYLE_KURAST_DOCKS, 64, 48, 0, {76}},
+    {76, 2, O, STYLE_A3_JUNGLE, 12, 12, 4, {75, 77, 84, 85}},
+    {77, 2, O, STYLE_A3_JUNGLE, 12, 12, 4, {76, 78}},
+    {78, 2, O, STYLE_A3_JUNGLE, 12, 12, 4, {77, 79, 86, 88}},
+    {79, 2, O, STYLE_A3_KURAST, 12, 10, 5, {78, 80}},
+    {80, 2, O, STYLE_A3_KURAST, 12, 10, 5, {79, 81, 92, 94}},
+    {81, 2, O, STYLE_A3_KURAST, 12, 10, 5, {80, 82, 93, 96}},
+    {82, 2, O, STYLE_A3_KURAST, 8, 10, 2, {81, 83, 98}},
+    {83, 2, P, STYLE_TRAVINCAL, 48, 48, 0, {82, 100}},
+    {84, 2, M, STYLE_A3_DUNGEON, 12, 12, 16, {76}},
+    {85, 2, M, STYLE_A3_DUNGEON, 14, 14, 20, {76}},
+    {86, 2, M, STYLE_A3_DUNGEON, 10, 10, 12, {78, 87}},
+    {87, 2, M, STYLE_A3_DUNGEON, 10, 10, 12, {86, 90}},
+    {88, 2, M, STYLE_A3_DUNGEON, 14, 14, 20, {78, 89}},
+    {89, 2, M, STYLE_A3_DUNGEON, 14, 14, 20, {88, 91}},
+    {90, 2, M, STYLE_A3_DUNGEON, 10, 10, 10, {87}},
+    {91, 2, M, STYLE_A3_DUNGEON, 10, 10, 14, {89}},
+    {92, 2, M, STYLE_A3_SEWERS, 14, 14, 20, {80, 93}},
+    {93, 2, M, STYLE_A3_SEWERS, 14, 14, 20, {92, 81}},
+    {94, 2, P, STYLE_A3_TEMPLE, 24, 24, 0, {80}},
+    {95, 2, P, STYLE_A3_TEMPLE, 24, 24, 0, {80}},
+    {96, 2, P, STYLE_A3_TEMPLE, 24, 24, 0, {81}},
+    {97, 2, P, STYLE_A3_TEMPLE, 24, 24, 0, {81}},
+    {98, 2, P, STYLE_A3_TEMPLE, 24, 24, 0, {82}},
+    {99, 2, P, STYLE_A3_TEMPLE, 24, 24, 0, {82}},
+    {100, 2, M, STYLE_A3_MEPHISTO, 16, 16, 26, {83, 101}},
+    {101, 2, M, STYLE_A3_MEPHISTO, 16, 16, 26, {100, 102}},
+    {102, 2, P, STYLE_DURANCE3, 40, 40, 0, {101, 103}},
+
+    // Act 4
+    {103, 3, P, STYLE_PANDEMONIUM, 40, 40, 0, {104}},
+    {104, 3, O, STYLE_A4_MESA, 12, 12, 4, {103, 105}},
+    {105, 3, O, STYLE_A4_MESA, 12, 12, 4, {104, 106}},
+    {106, 3, O, STYLE_A4_MESA, 12, 12, 4, {105, 107}},
+    {107, 3, O, STYLE_A4_MESA, 12, 14, 4, {106, 108}},
+    {108, 3, P, STYLE_CHAOS_SANCTUARY, 64, 64, 0, {107}},
+
+    // Act 5
+    {109, 4, P, STYLE_HARROGATH, 64, 64, 0, {110, 121}},
+    {110, 4, O, STYLE_A5_SIEGE, 14, 8, 4, {109, 111}},
+    {111, 4, O, STYLE_A5_SIEGE, 12, 12, 4, {110, 112, 125}},
+    {112, 4, O, STYLE_A5_SIEGE, 12, 12, 4, {111, 113, 126}},
+    {113, 4, M, STYLE_A5_ICE, 14, 14, 22, {112, 114, 115}},
+    {114, 4, M, STYLE_A5_ICE, 12, 12, 18, {113}},
+    {115, 4, M, STYLE_A5_ICE, 14, 14, 22, {113, 116, 117}},
+    {116, 4, M, STYLE_A5_ICE, 10, 10, 14, {115}},
+    {117, 4, O, STYLE_A5_SIEGE, 12, 12, 4, {115, 118, 127}},
+    {118, 4, M, STYLE_A5_ICE, 12, 12, 18, {117, 119, 120}},
+    {119, 4, M, STYLE_A5_ICE, 10, 10, 14, {118}},
+    {120, 4, P, STYLE_ARREAT_SUMMIT, 48, 48, 0, {118, 128}},
+    {121, 4, P, STYLE_NIHLATHAK_TEMPLE, 32, 32, 0, {109, 122}},
+    {122, 4, M, STYLE_A5_TEMPLE, 14, 14, 20, {121, 123}},
+    {123, 4, M, STYLE_A5_TEMPLE, 14, 14, 20, {122, 124}},
+    {124, 4, M, STYLE_A5_TEMPLE, 14, 14, 20, {123}},
+    {125, 4, M, STYLE_A5_PIT, 12, 12, 16, {111}},
+    {126, 4, M, STYLE_A5_PIT, 12, 12, 16, {112}},
+    {127, 4, M, STYLE_A5_PIT, 12, 12, 16, {117}},
+    {128, 4, M, STYLE_A5_BAAL, 16, 16, 26, {120, 129}},
+    {129, 4, M, STYLE_A5_BAAL, 16, 16, 26, {128, 130}},
+    {130, 4, M, STYLE_A5_BAAL, 16, 16, 26, {129, 131}},
+    {131, 4, P, STYLE_THRONE, 48, 48, 0, {130, 132}},
+    {132, 4, P, STYLE_WORLDSTONE_CHAMBER, 32, 32, 0, {131}},
+};
+
+#undef M
+#undef P
+#undef O
+
+const DrlgLevelDef *__cdecl DRLG_GetDefaultLevels(DWORD *pCount)
+{
+    *pCount = D2_ARRAY_SIZE(s_defaultLevels);
+    return s_defaultLevels;
+}
+
+DWORD __cdecl DRLG_GetPresetLimit(const DrlgLevelDef *pLevels, DWORD levelCount)
+{
+    DWORD limit = 0;
+    for (DWORD i = 0; i < levelCount; i++)
+    {
+        DWORD end = DRLG_PRESET_ID(pLevels[i].style + 1, 0);
+        if (end > limit)
+        {
+            limit = end;
+        }
+    }
+    return limit;
+}
+
+// =============================================================================
+// SEEDS
+// =============================================================================
+
+// SEED_RollRandomNumber: 64-bit multiply-with-carry, low half is the roll
+typedef struct DrlgSeed
+{
+    DWORD lo;
+    DWORD hi;
+} DrlgSeed;
+
+static DWORD RollSeed(DrlgSeed *pSeed)
+{
+    uint64_t value = (uint64_t)pSeed->lo * 0x6AC690C5u + pSeed->hi;
+    pSeed->lo = (DWORD)value;
+    pSeed->hi = (DWORD)(value >> 32);
+    return pSeed->lo;
+}
+
+static DWORD RollRange(DrlgSeed *pSeed, DWORD range)
+{
+    return range ? RollSeed(pSeed) % range : 0;
+}
+
+DWORD __cdecl DRLG_GetLevelSeed(DWORD gameSeed, DWORD levelId)
+{
+    RngStream game, level, drlg;
+    RNG_InitGame(&game, gameSeed);
+    RNG_Split(&game, RNG_DOMAIN_LEVEL, levelId, &level);
+    RNG_Split(&level, RNG_DOMAIN_DRLG, 0, &drlg);
+    return RNG_Next(&drlg);
+}
+
+// =============================================================================
+// BUILDER
+// =============================================================================
+
+typedef struct DrlgBuilder
+{
+    const DrlgLevelDef *pLevel;
+    PresetStore *pStore;
+    DrlgSeed seed;
+    DWORD width;
+    DWORD height;
+    std::vector<DrlgRoom> rooms;
+    std::vector<DWORD> floor;
+    std::vector<DWORD> wall;
+    std::vector<Ds1Object> objects;
+} DrlgBuilder;
+
+static void ResizeLevel(DrlgBuilder *pBuilder, DWORD width, DWORD height)
+{
+    pBuilder->width = width;
+    pBuilder->height = height;
+    pBuilder->floor.assign((size_t)width * height, 0);
+    pBuilder->wall.assign((size_t)width * height, 0);
+}
+
+// Copy a preset's first floor and wall layers and its objects into the level
+static BOOL BlitPreset(DrlgBuilder *pBuilder, DWORD presetId, DWORD x, DWORD y, DWORD width, DWORD height)
+{
+    const Ds1Map *pMap = PRESETSTORE_Acquire(pBuilder->pStore, presetId);
+    if (!pMap)
+    {
+        return FALSE;
+    }
+
+    DWORD copyW = (pMap->width < width) ? pMap->width : width;
+    DWORD copyH = (pMap->height < height) ? pMap->height : height;
+    for (DWORD row = 0; row < copyH; row++)
+    {
+        size_t dst = (size_t)(y + row) * pBuilder->width + x;
+        memcpy(&pBuilder->floor[dst], pMap->pFloors[0] + (size_t)row * pMap->width, copyW * sizeof(DWORD));
+        memcpy(&pBuilder->wall[dst], pMap->pWalls[0] + (size_t)row * pMap->width, copyW * sizeof(DWORD));
+    }
+
+    for (DWORD i = 0; i < pMap->objectCount; i++)
+    {
+        Ds1Object object = pMap->pObjects[i];
+        if (object.x >= copyW * DRLG_SUBTILES_PER_TILE || object.y >= copyH * DRLG_SUBTILES_PER_TILE)
+        {
+            continue;
+        }
+        object.x += x * DRLG_SUBTILES_PER_TILE;
+        object.y += y * DRLG_SUBTILES_PER_TILE;
+        pBuilder->objects.push_back(object);
+    }
+    return TRUE;
+}
+
+static void AddRoom(DrlgBuilder *pBuilder, DWORD x, DWORD y, DWORD width, DWORD height, DWORD presetId, BYTE flags,
+                    BYTE doors)
+{
+    DrlgRoom room;
+    room.x = (WORD)x;
+    room.y = (WORD)y;
+    room.width = (BYTE)width;
+    room.height = (BYTE)height;
+    room.flags = flags;
+    room.doors = doors;
+    room.presetId = (WORD)presetId;
+    pBuilder->rooms.push_back(room);
+}
+
+// =============================================================================
+// PRESET LEVELS
+// =============================================================================
+
+static BOOL BuildPreset(DrlgBuilder *pBuilder)
+{
+    DWORD presetId = DRLG_PRESET_ID(pBuilder->pLevel->style, 0);
+    const Ds1Map *pMap = PRESETSTORE_Acquire(pBuilder->pStore, presetId);
+    if (!pMap)
+    {
+        return FALSE;
+    }
+
+    ResizeLevel(pBuilder, pMap->width, pMap->height);
+    BlitPreset(pBuilder, presetId, 0, 0, pMap->width, pMap->height);
+
+    for (DWORD y = 0; y < pMap->height; y += DRLG_PRESET_ROOM_TILES)
+    {
+        for (DWORD x = 0; x < pMap->width; x += DRLG_PRESET_ROOM_TILES)
+        {
+            DWORD w = pMap->width - x, h = pMap->height - y;
+            AddRoom(pBuilder, x, y, (w < DRLG_PRESET_ROOM_TILES) ? w : DRLG_PRESET_ROOM_TILES,
+                    (h < DRLG_PRESET_ROOM_TILES) ? h : DRLG_PRESET_ROOM_TILES, presetId, 0, 0);
+        }
+    }
+    pBuilder->rooms[0].flags |= DRLGROOM_ENTRANCE;
+    return TRUE;
+}
+
+// =============================================================================
+// OUTDOOR LEVELS
+// =============================================================================
+
+static BOOL BuildOutdoor(DrlgBuilder *pBuilder)
+{
+    const DrlgLevelDef *pLevel = pBuilder->pLevel;
+    DWORD cellsX = pLevel->sizeX, cellsY = pLevel->sizeY;
+    if (cellsX < 3 || cellsY < 3)
+    {
+        return FALSE;
+    }
+
+    std::vector<BYTE> cellFlags((size_t)cellsX * cellsY, 0);
+    std::vector<WORD> cellPreset((size_t)cellsX * cellsY, 0);
+
+    // Border ring: one variant pair per edge (top, right, bottom, left)
+    for (DWORD cy = 0; cy < cellsY; cy++)
+    {
+        for (DWORD cx = 0; cx < cellsX; cx++)
+        {
+            DWORD cell = cy * cellsX + cx;
+            DWORD edge;
+            if (cy == 0)
+                edge = 0;
+            else if (cx == cellsX - 1)
+                edge = 1;
+            else if (cy == cellsY - 1)
+                edge = 2;
+            else if (cx == 0)
+                edge = 3;
+            else
+            {
+                cellPreset[cell] = (WORD)(DRLG_OUTDOOR_GROUND + RollRange(&pBuilder->seed, DRLG_OUTDOOR_GROUND_COUNT));
+                continue;
+            }
+            cellFlags[cell] = DRLGROOM_BORDER;
+            cellPreset[cell] = (WORD)(DRLG_OUTDOOR_BORDER + edge * 2 + RollRange(&pBuilder->seed, 2));
+        }
+    }
+
+    // Path from the west exit to the east exit, wandering toward the goal row
+    DWORD y = 1 + RollRange(&pBuilder->seed, cellsY - 2);
+    DWORD goalY = 1 + RollRange(&pBuilder->seed, cellsY - 2);
+    DWORD x = 0;
+    cellFlags[y * cellsX] |= DRLGROOM_ENTRANCE;
+    while (x < cellsX - 1)
+    {
+        if (y != goalY && RollRange(&pBuilder->seed, 3) == 0)
+        {
+            y = (y < goalY) ? y + 1 : y - 1;
+        }
+        else
+        {
+            x++;
+        }
+        DWORD cell = y * cellsX + x;
+        cellFlags[cell] |= DRLGROOM_PATH;
+        if (!(cellFlags[cell] & DRLGROOM_BORDER))
+        {
+            cellPreset[cell] = (WORD)(DRLG_OUTDOOR_PATH + RollRange(&pBuilder->seed, DRLG_OUTDOOR_PATH_COUNT));
+        }
+    }
+    cellFlags[y * cellsX + x] |= DRLGROOM_EXIT;
+
+    // Specials (waypoint, shrines, ...) on free ground
+    for (DWORD i = 0; i < pLevel->rooms; i++)
+    {
+        for (DWORD attempt = 0; attempt < 16; attempt++)
+        {
+            DWORD cx = 1 + RollRange(&pBuilder->seed, cellsX - 2);
+            DWORD cy = 1 + RollRange(&pBuilder->seed, cellsY - 2);
+            DWORD cell = cy * cellsX + cx;
+            if (!cellFlags[cell])
+            {
+                cellFlags[cell] = DRLGROOM_SPECIAL;
+                cellPreset[cell] = (WORD)(DRLG_OUTDOOR_SPECIAL + i % DRLG_OUTDOOR_SPECIAL_COUNT);
+                break;
+            }
+        }
+    }
+
+    ResizeLevel(pBuilder, cellsX * DRLG_CELL_TILES, cellsY * DRLG_CELL_TILES);
+    for (DWORD cy = 0; cy < cellsY; cy++)
+    {
+        for (DWORD cx = 0; cx < cellsX; cx++)
+        {
+            DWORD cell = cy * cellsX + cx;
+            DWORD presetId = DRLG_PRESET_ID(pLevel->style, cellPreset[cell]);
+            if (!BlitPreset(pBuilder, presetId, cx * DRLG_CELL_TILES, cy * DRLG_CELL_TILES, DRLG_CELL_TILES,
+                            DRLG_CELL_TILES))
+            {
+                return FALSE;
+            }
+            AddRoom(pBuilder, cx * DRLG_CELL_TILES, cy * DRLG_CELL_TILES, DRLG_CELL_TILES, DRLG_CELL_TILES, presetId,
+                    cellFlags[cell], 0);
+        }
+    }
+    return TRUE;
+}
+
+// =============================================================================
+// MAZE LEVELS
+// =============================================================================
+
+static const int s_dirX[4] = {0, 1, 0, -1}; // N, E, S, W
+static const int s_dirY[4] = {-1, 0, 1, 0};
+
+static BOOL BuildMaze(DrlgBuilder *pBuilder)
+{
+    const DrlgLevelDef *pLevel = pBuilder->pLevel;
+    DWORD gridX = pLevel->sizeX, gridY = pLevel->sizeY;
+    if (!gridX || !gridY || gridX > DRLG_MAZE_MAX_GRID || gridY > DRLG_MAZE_MAX_GRID || !pLevel->rooms)
+    {
+        return FALSE;
+    }
+
+    short grid[DRLG_MAZE_MAX_GRID * DRLG_MAZE_MAX_GRID];
+    BYTE roomX[DRLG_MAZE_MAX_GRID * DRLG_MAZE_MAX_GRID], roomY[DRLG_MAZE_MAX_GRID * DRLG_MAZE_MAX_GRID];
+    BYTE doors[DRLG_MAZE_MAX_GRID * DRLG_MAZE_MAX_GRID];
+    for (DWORD i = 0; i < gridX * gridY; i++)
+    {
+        grid[i] = -1;
+    }
+
+    // Grow from the entrance room: pick a room and a side, add a room there if free
+    DWORD count = 1;
+    roomX[0] = (BYTE)(gridX / 2);
+    roomY[0] = (BYTE)(gridY / 2);
+    doors[0] = 0;
+    grid[roomY[0] * gridX + roomX[0]] = 0;
+    for (DWORD attempt = 0; count < pLevel->rooms && attempt < pLevel->rooms * 64u; attempt++)
+    {
+        DWORD from = RollRange(&pBuilder->seed, count);
+        DWORD dir = RollRange(&pBuilder->seed, 4);
+        int nx = roomX[from] + s_dirX[dir], ny = roomY[from] + s_dirY[dir];
+        if (nx < 0 || ny < 0 || nx >= (int)gridX || ny >= (int)gridY || grid[ny * gridX + nx] >= 0)
+        {
+            continue;
+        }
+        roomX[count] = (BYTE)nx;
+        roomY[count] = (BYTE)ny;
+        doors[count] = (BYTE)(1 << ((dir + 2) & 3));
+        doors[from] |= (BYTE)(1 << dir);
+        grid[ny * gridX + nx] = (short)count;
+        count++;
+    }
+
+    // Exit: the room farthest from the entrance through doors
+    short distance[DRLG_MAZE_MAX_GRID * DRLG_MAZE_MAX_GRID];
+    short queue[DRLG_MAZE_MAX_GRID * DRLG_MAZE_MAX_GRID];
+    DWORD head = 0, tail = 0, exitRoom = 0;
+    for (DWORD i = 0; i < count; i++)
+    {
+        distance[i] = -1;
+    }
+    distance[0] = 0;
+    queue[tail++] = 0;
+    while (head < tail)
+    {
+        DWORD room = (DWORD)queue[head++];
+        if (distance[room] > distance[exitRoom])
+        {
+            exitRoom = room;
+        }
+        for (DWORD dir = 0; dir < 4; dir++)
+        {
+            if (!(doors[room] & (1 << dir)))
+            {
+                continue;
+            }
+            DWORD next = (DWORD)grid[(roomY[room] + s_dirY[dir]) * (int)gridX + roomX[room] + s_dirX[dir]];
+            if (distance[next] < 0)
+            {
+                distance[next] = (short)(distance[room] + 1);
+                queue[tail++] = (short)next;
+            }
+        }
+    }
+
+    // Level bounds: the rooms' bounding box
+    DWORD minX = gridX, minY = gridY, maxX = 0, maxY = 0;
+    for (DWORD i = 0; i < count; i++)
+    {
+        minX = (roomX[i] < minX) ? roomX[i] : minX;
+        minY = (roomY[i] < minY) ? roomY[i] : minY;
+        maxX = (roomX[i] > maxX) ? roomX[i] : maxX;
+        maxY = (roomY[i] > maxY) ? roomY[i] : maxY;
+    }
+    ResizeLevel(pBuilder, (maxX - minX + 1) * DRLG_CELL_TILES, (maxY - minY + 1) * DRLG_CELL_TILES);
+
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD presetId = DRLG_PRESET_ID(pLevel->style, doors[i] * 2 + RollRange(&pBuilder->seed, 2));
+        DWORD x = (roomX[i] - minX) * DRLG_CELL_TILES, y = (roomY[i] - minY) * DRLG_CELL_TILES;
+        if (!BlitPreset(pBuilder, presetId, x, y, DRLG_CELL_TILES, DRLG_CELL_TILES))
+        {
+            return FALSE;
+        }
+        BYTE flags = (i == 0) ? DRLGROOM_ENTRANCE : 0;
+        if (i == exitRoom && i != 0)
+        {
+            flags |= DRLGROOM_EXIT;
+        }
+        AddRoom(pBuilder, x, y, DRLG_CELL_TILES, DRLG_CELL_TILES, presetId, flags, doors[i]);
+    }
+    return TRUE;
+}
+
+// =============================================================================
+// LAYOUT
+// =============================================================================
+
+static uint64_t HashBytes(uint64_t hash, const void *pData, size_t size)
+{
+    const BYTE *p = (const BYTE *)pData;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ p[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static uint64_t HashCells(uint64_t hash, const DWORD *pCells, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        hash = (hash ^ pCells[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+DrlgLayout *__cdecl DRLG_GenerateLevel(const DrlgLevelDef *pLevel, DWORD gameSeed, PresetStore *pStore)
+{
+    DrlgBuilder builder;
+    builder.pLevel = pLevel;
+    builder.pStore = pStore;
+    builder.seed.lo = DRLG_GetLevelSeed(gameSeed, pLevel->id);
+    builder.seed.hi = 666; // SEED_InitSeed default high word
+    builder.width = 0;
+    builder.height = 0;
+
+    BOOL ok = FALSE;
+    switch (pLevel->type)
+    {
+    case DRLGTYPE_MAZE:
+        ok = BuildMaze(&builder);
+        break;
+    case DRLGTYPE_PRESET:
+        ok = BuildPreset(&builder);
+        break;
+    case DRLGTYPE_OUTDOOR:
+        ok = BuildOutdoor(&builder);
+        break;
+    }
+    if (!ok)
+    {
+        return NULL;
+    }
+
+    // One block: layout, floor, wall, objects, rooms (the DWORD arrays first, so they stay aligned
+    // whatever the room count)
+    size_t cells = (size_t)builder.width * builder.height;
+    size_t roomBytes = builder.rooms.size() * sizeof(DrlgRoom);
+    size_t cellBytes = cells * sizeof(DWORD);
+    size_t objectBytes = builder.objects.size() * sizeof(Ds1Object);
+    DrlgLayout *pLayout = (DrlgLayout *)malloc(sizeof(DrlgLayout) + roomBytes + cellBytes * 2 + objectBytes);
+    if (!pLayout)
+    {
+        return NULL;
+    }
+
+    DWORD *pFloor = (DWORD *)(pLayout + 1);
+    DWORD *pWall = pFloor + cells;
+    Ds1Object *pObjects = (Ds1Object *)(pWall + cells);
+    DrlgRoom *pRooms = (DrlgRoom *)(pObjects + builder.objects.size());
+    memcpy(pRooms, builder.rooms.data(), roomBytes);
+    memcpy(pFloor, builder.floor.data(), cellBytes);
+    memcpy(pWall, builder.wall.data(), cellBytes);
+    if (objectBytes)
+    {
+        memcpy(pObjects, builder.objects.data(), objectBytes);
+    }
+
+    pLayout->levelId = pLevel->id;
+    pLayout->act = pLevel->act;
+    pLayout->type = pLevel->type;
+    pLayout->seed = DRLG_GetLevelSeed(gameSeed, pLevel->id);
+    pLayout->width = builder.width;
+    pLayout->height = builder.height;
+    pLayout->roomCount = (DWORD)builder.rooms.size();
+    pLayout->pRooms = pRooms;
+    pLayout->pFloor = pFloor;
+    pLayout->pWall = pWall;
+    pLayout->objectCount = (DWORD)builder.objects.size();
+    pLayout->pObjects = pObjects;
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = HashBytes(hash, &pLayout->width, sizeof(DWORD) * 2);
+    for (DWORD i = 0; i < pLayout->roomCount; i++)
+    {
+        const DrlgRoom *pRoom = &pRooms[i];
+        DWORD packed[3] = {(DWORD)pRoom->x | ((DWORD)pRoom->y << 16),
+                           (DWORD)pRoom->width | ((DWORD)pRoom->height << 8) | ((DWORD)pRoom->flags << 16) |
+                               ((DWORD)pRoom->doors << 24),
+                           pRoom->presetId};
+        hash = HashCells(hash, packed, 3);
+    }
+    hash = HashCells(hash, pFloor, cells);
+    hash = HashCells(hash, pWall, cells);
+    for (DWORD i = 0; i < pLayout->objectCount; i++)
+    {
+        hash = HashCells(hash, &pObjects[i].type, 5);
+    }
+    pLayout->hash = hash;
+    return pLayout;
+}
+
+void __cdecl DRLG_FreeLayout(DrlgLayout *pLayout)
+{
+    free(pLayout);
+}
@@ -0,0 +1,115 @@
+/*
+ * Drlg.hpp - D2Common level layout generation
+ *
+ * The three DRLG level types (Levels.txt DrlgType):
+ *   maze    - DRLG\Maze.cpp: rooms grown outward from the entrance room on a
+ *             grid, each room filled by the preset matching its door mask.
+ *   preset  - DRLG\Preset.c: one fixed DS1 (towns, boss lairs).
+ *   outdoor - DRLG\Outdoors.cpp: a grid of ground tiles with border tiles
+ *             around the edge, a path carved between the level's exits and
+ *             special presets (waypoint, shrines) dropped on the ground.
+ *
+ * DRLG_GenerateLevel builds one level into a self-contained DrlgLayout:
+ * room list plus the level's floor and wall cells copied from the presets.
+ * It only reads shared state (the level table and the PresetStore), so any
+ * number of levels can be generated on any threads at once.
+ *
+ * Determinism: the game rolls each level's seed from the act seed in the
+ * order levels happen to be built, which ties a layout to the order players
+ * walk in. Here a level's seed is derived from the game seed and level id
+ * alone (its RNG_DOMAIN_LEVEL stream), so the layout is the same whether
+ * the level is built on entry, ahead of time or on another thread.
+ */
+
+#ifndef DRLG_HPP
+#define DRLG_HPP
+
+#include "PresetStore.hpp"
+
+#define DRLG_MAX_ADJACENT 4
+#define DRLG_ACT_COUNT 5
+
+// Outdoor ground cells and maze rooms are square blocks of this many tiles
+#define DRLG_CELL_TILES 8
+
+// Each style owns a block of preset ids in the store
+#define DRLG_STYLE_PRESETS 32
+#define DRLG_PRESET_ID(style, index) ((style) * DRLG_STYLE_PRESETS + (index))
+
+// Style preset layout, outdoor: ground variants, border variants, specials, path
+#define DRLG_OUTDOOR_GROUND 0
+#define DRLG_OUTDOOR_GROUND_COUNT 16
+#define DRLG_OUTDOOR_BORDER 16
+#define DRLG_OUTDOOR_BORDER_COUNT 8
+#define DRLG_OUTDOOR_SPECIAL 24
+#define DRLG_OUTDOOR_SPECIAL_COUNT 4
+#define DRLG_OUTDOOR_PATH 28
+#define DRLG_OUTDOOR_PATH_COUNT 4
+// Maze: two variants per door mask (N=1, E=2, S=4, W=8); preset: index 0
+
+typedef enum DrlgType
+{
+    DRLGTYPE_MAZE = 1,
+    DRLGTYPE_PRESET = 2,
+    DRLGTYPE_OUTDOOR = 3,
+} DrlgType;
+
+typedef struct DrlgLevelDef
+{
+    WORD id; // Levels.txt row
+    BYTE act;
+    BYTE type;  // DrlgType
+    WORD style; // Preset block (tileset)
+    WORD sizeX; // Outdoor: cells; maze: grid bound in rooms; preset: tiles
+    WORD sizeY;
+    WORD rooms;    // Maze room count; outdoor special presets
+    WORD adjacent[DRLG_MAX_ADJACENT]; // Level ids, 0 = none
+} DrlgLevelDef;
+
+// Room flags
+#define DRLGROOM_ENTRANCE 0x01
+#define DRLGROOM_EXIT 0x02
+#define DRLGROOM_SPECIAL 0x04
+#define DRLGROOM_PATH 0x08
+#define DRLGROOM_BORDER 0x10
+
+typedef struct DrlgRoom
+{
+    WORD x; // Tiles
+    WORD y;
+    BYTE width;
+    BYTE height;
+    BYTE flags;
+    BYTE doors; // Maze door mask
+    WORD presetId;
+} DrlgRoom;
+
+typedef struct DrlgLayout
+{
+    WORD levelId;
+    BYTE act;
+    BYTE type;
+    DWORD seed; // Level seed
+    DWORD width; // Tiles
+    DWORD height;
+    DWORD roomCount;
+    const DrlgRoom *pRooms;
+    const DWORD *pFloor; // width * height, row-major
+    const DWORD *pWall;
+    DWORD objectCount; // Preset objects (monsters, npcs, objects) in level tiles
+    const Ds1Object *pObjects;
+    uint64_t hash; // Over rooms and cells; identical for identical layouts
+} DrlgLayout;
+
+// Built-in level table (acts 1-5); sorted by id
+const DrlgLevelDef *__cdecl DRLG_GetDefaultLevels(DWORD *pCount);
+// Highest preset id the table references, plus one
+DWORD __cdecl DRLG_GetPresetLimit(const DrlgLevelDef *pLevels, DWORD levelCount);
+
+DWORD __cdecl DRLG_GetLevelSeed(DWORD gameSeed, DWORD levelId);
+
+// NULL if a preset the level needs cannot be loaded
+DrlgLayout *__cdecl DRLG_GenerateLevel(const DrlgLevelDef *pLevel, DWORD gameSeed, PresetStore *pStore);
+void __cdecl DRLG_FreeLayout(DrlgLayout *pLayout);
+
+#endif // DRLG_HPP
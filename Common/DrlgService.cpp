@@ -0,0 +1,337 @@
+/*
+ * DrlgService.cpp - D2Common background level generation
+ *
+ * See DrlgService.hpp for the scheduling rules.
+ */
+
+#include "DrlgService.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define NO_LEVEL 0xFFFF
+
+// Level slot state, guarded by the service mutex
+enum
+{
+    LEVEL_EMPTY = 0,
+    LEVEL_QUEUED,  // In the job queue, not started
+    LEVEL_RUNNING, // Being built (worker or inline)
+    LEVEL_READY,
+    LEVEL_FAILED,
+};
+
+typedef struct DrlgLevelSlot
+{
+    BYTE state;
+    DrlgLayout *pLayout;
+} DrlgLevelSlot;
+
+struct DrlgGame
+{
+    DWORD seed;
+    DWORD running; // Slots in LEVEL_RUNNING
+    DrlgLevelSlot *pSlots;
+};
+
+typedef struct DrlgJob
+{
+    DrlgGame *pGame;
+    DWORD level; // Index into the level table
+} DrlgJob;
+
+struct DrlgService
+{
+    PresetStore *pStore;
+    const DrlgLevelDef *pLevels;
+    DWORD levelCount;
+    std::vector<WORD> levelIndex; // Level id -> table index
+
+    std::mutex mutex;
+    std::condition_variable workReady; // Jobs queued or stopping
+    std::condition_variable levelDone; // A slot left LEVEL_RUNNING
+    std::deque<DrlgJob> jobs;
+    std::vector<std::thread> workers;
+    BOOL stopping;
+    DrlgServiceStats stats;
+};
+
+static DWORD FindLevel(const DrlgService *pService, DWORD levelId)
+{
+    if (levelId >= pService->levelIndex.size())
+    {
+        return NO_LEVEL;
+    }
+    return pService->levelIndex[levelId];
+}
+
+// Build outside the lock, then publish. Caller has set the slot to LEVEL_RUNNING.
+static void BuildSlot(DrlgService *pService, DrlgGame *pGame, DWORD level, std::unique_lock<std::mutex> &lock)
+{
+    lock.unlock();
+    DrlgLayout *pLayout = DRLG_GenerateLevel(&pService->pLevels[level], pGame->seed, pService->pStore);
+    lock.lock();
+
+    DrlgLevelSlot *pSlot = &pGame->pSlots[level];
+    pSlot->pLayout = pLayout;
+    pSlot->state = pLayout ? LEVEL_READY : LEVEL_FAILED;
+    pGame->running--;
+    if (pLayout)
+    {
+        pService->stats.built++;
+    }
+    else
+    {
+        pService->stats.failures++;
+    }
+    pService->levelDone.notify_all();
+}
+
+static void WorkerMain(DrlgService *pService)
+{
+    std::unique_lock<std::mutex> lock(pService->mutex);
+
+    while (!pService->stopping)
+    {
+        if (pService->jobs.empty())
+        {
+            pService->workReady.wait(lock);
+            continue;
+        }
+
+        DrlgJob job = pService->jobs.front();
+        pService->jobs.pop_front();
+
+        // Already claimed by a GetLevel on another thread
+        DrlgLevelSlot *pSlot = &job.pGame->pSlots[job.level];
+        if (pSlot->state != LEVEL_QUEUED)
+        {
+            continue;
+        }
+        pSlot->state = LEVEL_RUNNING;
+        job.pGame->running++;
+        pService->stats.builtAhead++;
+        BuildSlot(pService, job.pGame, job.level, lock);
+    }
+}
+
+// =============================================================================
+// SERVICE
+// =============================================================================
+
+DrlgService *__cdecl DRLGSERVICE_Create(const DrlgServiceDesc *pDesc)
+{
+    if (!pDesc || !pDesc->pStore)
+    {
+        return NULL;
+    }
+
+    DrlgService *pService = new DrlgService();
+    pService->pStore = pDesc->pStore;
+    pService->pLevels = pDesc->pLevels;
+    pService->levelCount = pDesc->levelCount;
+    if (!pService->pLevels)
+    {
+        pService->pLevels = DRLG_GetDefaultLevels(&pService->levelCount);
+    }
+    pService->stopping = FALSE;
+    memset(&pService->stats, 0, sizeof(pService->stats));
+
+    for (DWORD i = 0; i < pService->levelCount; i++)
+    {
+        DWORD id = pService->pLevels[i].id;
+        if (id >= pService->levelIndex.size())
+        {
+            pService->levelIndex.resize(id + 1, NO_LEVEL);
+        }
+        pService->levelIndex[id] = (WORD)i;
+    }
+
+    DWORD workerCount = pDesc->workerCount;
+    if (workerCount > DRLGSERVICE_MAX_WORKERS)
+    {
+        workerCount = DRLGSERVICE_MAX_WORKERS;
+    }
+    for (DWORD i = 0; i < workerCount; i++)
+    {
+        pService->workers.push_back(std::thread(WorkerMain, pService));
+    }
+    return pService;
+}
+
+void __cdecl DRLGSERVICE_Destroy(DrlgService *pService)
+{
+    if (!pService)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pService->mutex);
+        pService->stopping = TRUE;
+    }
+    pService->workReady.notify_all();
+    for (size_t i = 0; i < pService->workers.size(); i++)
+    {
+        pService->workers[i].join();
+    }
+    delete pService;
+}
+
+// =============================================================================
+// GAMES
+// =============================================================================
+
+DrlgGame *__cdecl DRLGSERVICE_OpenGame(DrlgService *pService, DWORD seed)
+{
+    DrlgGame *pGame = (DrlgGame *)calloc(1, sizeof(DrlgGame));
+    if (!pGame)
+    {
+        return NULL;
+    }
+    pGame->seed = seed;
+    pGame->pSlots = (DrlgLevelSlot *)calloc(pService->levelCount, sizeof(DrlgLevelSlot));
+    if (!pGame->pSlots)
+    {
+        free(pGame);
+        return NULL;
+    }
+    return pGame;
+}
+
+void __cdecl DRLGSERVICE_CloseGame(DrlgService *pService, DrlgGame *pGame)
+{
+    if (!pGame)
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(pService->mutex);
+        pService->jobs.erase(std::remove_if(pService->jobs.begin(), pService->jobs.end(),
+                                            [pGame](const DrlgJob &job) { return job.pGame == pGame; }),
+                             pService->jobs.end());
+        while (pGame->running)
+        {
+            pService->levelDone.wait(lock);
+        }
+    }
+
+    for (DWORD i = 0; i < pService->levelCount; i++)
+    {
+        DRLG_FreeLayout(pGame->pSlots[i].pLayout);
+    }
+    free(pGame->pSlots);
+    free(pGame);
+}
+
+static void QueueLevel(DrlgService *pService, DrlgGame *pGame, DWORD level)
+{
+    DrlgLevelSlot *pSlot = &pGame->pSlots[level];
+    if (pSlot->state == LEVEL_EMPTY)
+    {
+        pSlot->state = LEVEL_QUEUED;
+        DrlgJob job = {pGame, level};
+        pService->jobs.push_back(job);
+    }
+}
+
+void __cdecl DRLGSERVICE_Prefetch(DrlgService *pService, DrlgGame *pGame, DWORD levelId, BOOL withAdjacent)
+{
+    DWORD level = FindLevel(pService, levelId);
+    if (level == NO_LEVEL || pService->workers.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pService->mutex);
+        QueueLevel(pService, pGame, level);
+        for (DWORD i = 0; withAdjacent && i < DRLG_MAX_ADJACENT; i++)
+        {
+            DWORD neighbour = FindLevel(pService, pService->pLevels[level].adjacent[i]);
+            if (neighbour != NO_LEVEL)
+            {
+                QueueLevel(pService, pGame, neighbour);
+            }
+        }
+    }
+    pService->workReady.notify_all();
+}
+
+void __cdecl DRLGSERVICE_PrefetchAct(DrlgService *pService, DrlgGame *pGame, DWORD act)
+{
+    if (pService->workers.empty())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pService->mutex);
+        for (DWORD i = 0; i < pService->levelCount; i++)
+        {
+            if (pService->pLevels[i].act == act)
+            {
+                QueueLevel(pService, pGame, i);
+            }
+        }
+    }
+    pService->workReady.notify_all();
+}
+
+const DrlgLayout *__cdecl DRLGSERVICE_GetLevel(DrlgService *pService, DrlgGame *pGame, DWORD levelId)
+{
+    DWORD level = FindLevel(pService, levelId);
+    if (level == NO_LEVEL)
+    {
+        return NULL;
+    }
+
+    std::unique_lock<std::mutex> lock(pService->mutex);
+    DrlgLevelSlot *pSlot = &pGame->pSlots[level];
+
+    switch (pSlot->state)
+    {
+    case LEVEL_READY:
+        pService->stats.readyHits++;
+        break;
+
+    case LEVEL_RUNNING:
+        pService->stats.waits++;
+        while (pSlot->state == LEVEL_RUNNING)
+        {
+            pService->levelDone.wait(lock);
+        }
+        break;
+
+    case LEVEL_EMPTY:
+    case LEVEL_QUEUED:
+        // A queued job finds the slot taken and is skipped
+        pSlot->state = LEVEL_RUNNING;
+        pGame->running++;
+        pService->stats.builtInline++;
+        BuildSlot(pService, pGame, level, lock);
+        break;
+    }
+
+    return pSlot->pLayout;
+}
+
+const DrlgLayout *__cdecl DRLGSERVICE_EnterLevel(DrlgService *pService, DrlgGame *pGame, DWORD levelId)
+{
+    const DrlgLayout *pLayout = DRLGSERVICE_GetLevel(pService, pGame, levelId);
+    DRLGSERVICE_Prefetch(pService, pGame, levelId, TRUE);
+    return pLayout;
+}
+
+void __cdecl DRLGSERVICE_GetStats(DrlgService *pService, DrlgServiceStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(pService->mutex);
+    *pStats = pService->stats;
+}
@@ -0,0 +1,72 @@
+/*
+ * DrlgService.hpp - D2Common background level generation
+ *
+ * The game builds a level's DRLG the moment the first player enters it (and
+ * the town when the game is created), on the game thread, reading and
+ * decoding every DS1 preset it needs along the way. Game creation and area
+ * transitions stall on it.
+ *
+ * The service generates layouts ahead of time on a worker pool:
+ *   - presets come from a PresetStore shared by every game, so each DS1 is
+ *     decoded once per process instead of once per game;
+ *   - when a player enters a level, its neighbours (Levels.txt Vis/Warp
+ *     links) are queued so they are ready before anyone walks over;
+ *   - asking for a level that is still queued builds it on the calling
+ *     thread instead of waiting behind other work; one that a worker is
+ *     already building is waited for.
+ *
+ * Layouts depend only on (game seed, level id) - see Drlg.hpp - so the
+ * result never depends on which thread built it or in what order.
+ *
+ * Threading: every call may be made from any thread. Layouts stay valid,
+ * read-only, until their game is closed.
+ */
+
+#ifndef DRLGSERVICE_HPP
+#define DRLGSERVICE_HPP
+
+#include "Drlg.hpp"
+
+#define DRLGSERVICE_MAX_WORKERS 16
+
+typedef struct DrlgServiceDesc
+{
+    PresetStore *pStore;         // Shared preset cache, not owned
+    const DrlgLevelDef *pLevels; // NULL = DRLG_GetDefaultLevels
+    DWORD levelCount;
+    DWORD workerCount; // 0 = no pool: levels are built inside GetLevel
+} DrlgServiceDesc;
+
+typedef struct DrlgServiceStats
+{
+    DWORD built;       // Layouts generated
+    DWORD builtAhead;  // ... by a worker before anyone asked
+    DWORD builtInline; // ... by the thread calling GetLevel
+    DWORD readyHits;   // GetLevel found the layout already built
+    DWORD waits;       // GetLevel had to wait for a worker
+    DWORD failures;
+} DrlgServiceStats;
+
+typedef struct DrlgService DrlgService;
+typedef struct DrlgGame DrlgGame;
+
+DrlgService *__cdecl DRLGSERVICE_Create(const DrlgServiceDesc *pDesc);
+// Every game must be closed first
+void __cdecl DRLGSERVICE_Destroy(DrlgService *pService);
+
+DrlgGame *__cdecl DRLGSERVICE_OpenGame(DrlgService *pService, DWORD seed);
+// Drops queued work for the game, waits for levels being built, frees its layouts
+void __cdecl DRLGSERVICE_CloseGame(DrlgService *pService, DrlgGame *pGame);
+
+// Queue a level (and its neighbours) for the workers; no-op without a pool
+void __cdecl DRLGSERVICE_Prefetch(DrlgService *pService, DrlgGame *pGame, DWORD levelId, BOOL withAdjacent);
+void __cdecl DRLGSERVICE_PrefetchAct(DrlgService *pService, DrlgGame *pGame, DWORD act);
+
+// The level's layout, built now if needed. NULL for unknown levels or missing presets.
+const DrlgLayout *__cdecl DRLGSERVICE_GetLevel(DrlgService *pService, DrlgGame *pGame, DWORD levelId);
+// Level transition: GetLevel, then queue the neighbours
+const DrlgLayout *__cdecl DRLGSERVICE_EnterLevel(DrlgService *pService, DrlgGame *pGame, DWORD levelId);
+
+void __cdecl DRLGSERVICE_GetStats(DrlgService *pService, DrlgServiceStats *pStats);
+
+#endif // DRLGSERVICE_HPP
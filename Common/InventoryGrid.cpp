@@ -0,0 +1,466 @@
+/*
+ * InventoryGrid.cpp - D2Common bitboard inventory grids
+ *
+ * See InventoryGrid.hpp. Row r of a grid lives in bits (r & 3) * 16 .. +15
+ * of words[r >> 2]; a fifth all-ones word lets four-row windows starting at
+ * row 15 read past the end without a branch.
+ */
+
+#include "InventoryGrid.hpp"
+
+#include "../Shared/HashIndex.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_MAX_ITEMS 256
+#define GRID_WORDS 5
+#define LANE_ONES 0x0001000100010001ull // Bit 0 of each 16-bit row lane
+
+typedef struct GridBoard
+{
+    BYTE width;
+    BYTE height;
+    uint64_t words[GRID_WORDS]; // Set bit = occupied (or outside the grid)
+    WORD owner[INV_MAX_WIDTH * INV_MAX_HEIGHT]; // Item slot + 1, 0 = empty
+} GridBoard;
+
+struct Inventory
+{
+    DWORD gridCount;
+    GridBoard grids[INV_MAX_GRIDS];
+
+    InventoryItem *items;
+    DWORD *nextFree;
+    DWORD freeHead;
+    DWORD maxItems;
+    DWORD itemCount;
+
+    HashIndex index; // GUID -> slot
+
+    // INVENTORY_Sort scratch: packed sort keys and the pre-sort layout
+    uint64_t *sortKeys;
+    DWORD *savedSlots;
+    InventoryItem *savedItems;
+};
+
+// =============================================================================
+// BITBOARD HELPERS
+// =============================================================================
+
+// Rows y .. y+3 as four 16-bit lanes
+static inline uint64_t Rows4(const uint64_t *pWords, DWORD y)
+{
+    DWORD shift = (y & 3) * 16;
+    DWORD j = y >> 2;
+    uint64_t v = pWords[j] >> shift;
+    if (shift)
+    {
+        v |= pWords[j + 1] << (64 - shift);
+    }
+    return v;
+}
+
+// Lane pattern for h rows (1..4)
+static inline uint64_t LaneRepeat(DWORD rows)
+{
+    return LANE_ONES >> (16 * (4 - rows));
+}
+
+static inline uint64_t RowMask(DWORD x, DWORD width)
+{
+    return (((uint64_t)1 << width) - 1) << x;
+}
+
+static void ResetBoard(GridBoard *pBoard)
+{
+    for (DWORD j = 0; j < GRID_WORDS; j++)
+    {
+        pBoard->words[j] = ~0ull;
+    }
+    for (DWORD r = 0; r < pBoard->height; r++)
+    {
+        pBoard->words[r >> 2] &= ~(RowMask(0, pBoard->width) << ((r & 3) * 16));
+    }
+    memset(pBoard->owner, 0, sizeof(pBoard->owner));
+}
+
+static void MarkCells(GridBoard *pBoard, const InventoryItem *pItem, WORD owner)
+{
+    uint64_t mask = RowMask(pItem->x, pItem->width);
+    for (DWORD r = pItem->y; r < (DWORD)pItem->y + pItem->height; r++)
+    {
+        if (owner)
+            pBoard->words[r >> 2] |= mask << ((r & 3) * 16);
+        else
+            pBoard->words[r >> 2] &= ~(mask << ((r & 3) * 16));
+
+        for (DWORD c = pItem->x; c < (DWORD)pItem->x + pItem->width; c++)
+        {
+            pBoard->owner[r * INV_MAX_WIDTH + c] = owner;
+        }
+    }
+}
+
+static BOOL BoardFits(const GridBoard *pBoard, int x, int y, DWORD width, DWORD height)
+{
+    if (x < 0 || y < 0 || !width || !height || (DWORD)x + width > pBoard->width ||
+        (DWORD)y + height > pBoard->height)
+    {
+        return FALSE;
+    }
+
+    uint64_t row = RowMask((DWORD)x, width);
+    for (DWORD r = 0; r < height; r += 4)
+    {
+        DWORD rows = (height - r < 4) ? height - r : 4;
+        if (Rows4(pBoard->words, (DWORD)y + r) & (row * LaneRepeat(rows)))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Word j of the multi-word board shifted down by bits (a multiple of 16)
+static inline uint64_t ShiftWords(const uint64_t *pWords, DWORD j, DWORD bits)
+{
+    j += bits / 64;
+    bits %= 64;
+    uint64_t v = pWords[j] >> bits;
+    if (bits)
+    {
+        v |= pWords[j + 1] << (64 - bits);
+    }
+    return v;
+}
+
+static BOOL BoardFindFree(const GridBoard *pBoard, DWORD width, DWORD height, InventoryScan scan, int *pX, int *pY)
+{
+    if (!width || !height || width > pBoard->width || height > pBoard->height)
+    {
+        return FALSE;
+    }
+
+    // Horizontal: bit x of a row set when cells x .. x+width-1 are free.
+    // Rows past the grid are all-occupied; the extra words stay zero.
+    uint64_t open[GRID_WORDS];
+    uint64_t runs[GRID_WORDS + 4];
+    memset(runs, 0, sizeof(runs));
+    for (DWORD j = 0; j < GRID_WORDS; j++)
+    {
+        open[j] = ~pBoard->words[j];
+    }
+
+    uint64_t valid = RowMask(0, pBoard->width - width + 1) * LANE_ONES;
+    for (DWORD j = 0; j < GRID_WORDS; j++)
+    {
+        uint64_t run = open[j];
+        for (DWORD k = 1; k < width; k++)
+        {
+            run &= open[j] >> k;
+        }
+        runs[j] = run & valid;
+    }
+
+    // Vertical: AND with the rows below
+    uint64_t fit[4];
+    for (DWORD j = 0; j < 4; j++)
+    {
+        uint64_t v = runs[j];
+        for (DWORD i = 1; i < height && v; i++)
+        {
+            v &= ShiftWords(runs, j, 16 * i);
+        }
+        fit[j] = v;
+    }
+
+    if (scan == INVSCAN_ROWS)
+    {
+        for (DWORD j = 0; j < 4; j++)
+        {
+            if (fit[j])
+            {
+                DWORD bit = D2_Ctz64(fit[j]);
+                *pX = (int)(bit & 15);
+                *pY = (int)(j * 4 + bit / 16);
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+
+    // Leftmost column with any fit, then the topmost row in it
+    uint64_t columns = fit[0] | fit[1] | fit[2] | fit[3];
+    columns |= columns >> 32;
+    columns |= columns >> 16;
+    columns &= 0xFFFF;
+    if (!columns)
+    {
+        return FALSE;
+    }
+
+    DWORD x = D2_Ctz64(columns);
+    for (DWORD j = 0; j < 4; j++)
+    {
+        uint64_t lanes = (fit[j] >> x) & LANE_ONES;
+        if (lanes)
+        {
+            *pX = (int)x;
+            *pY = (int)(j * 4 + D2_Ctz64(lanes) / 16);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// =============================================================================
+// PUBLIC
+// =============================================================================
+
+Inventory *__cdecl INVENTORY_Create(const InventoryDesc *pDesc)
+{
+    if (!pDesc || !pDesc->gridCount || pDesc->gridCount > INV_MAX_GRIDS)
+    {
+        return NULL;
+    }
+    for (DWORD g = 0; g < pDesc->gridCount; g++)
+    {
+        if (!pDesc->width[g] || pDesc->width[g] > INV_MAX_WIDTH || !pDesc->height[g] ||
+            pDesc->height[g] > INV_MAX_HEIGHT)
+        {
+            return NULL;
+        }
+    }
+
+    Inventory *pInventory = (Inventory *)calloc(1, sizeof(Inventory));
+    if (!pInventory)
+    {
+        return NULL;
+    }
+
+    pInventory->gridCount = pDesc->gridCount;
+    pInventory->maxItems = pDesc->maxItems ? pDesc->maxItems : DEFAULT_MAX_ITEMS;
+    if (pInventory->maxItems > 0xFFFE)
+    {
+        pInventory->maxItems = 0xFFFE; // Owner map stores slot + 1 in a WORD
+    }
+
+    pInventory->items = (InventoryItem *)calloc(pInventory->maxItems, sizeof(InventoryItem));
+    pInventory->nextFree = (DWORD *)malloc(pInventory->maxItems * sizeof(DWORD));
+    pInventory->sortKeys = (uint64_t *)malloc(pInventory->maxItems * sizeof(uint64_t));
+    pInventory->savedSlots = (DWORD *)malloc(pInventory->maxItems * sizeof(DWORD));
+    pInventory->savedItems = (InventoryItem *)malloc(pInventory->maxItems * sizeof(InventoryItem));
+    if (!pInventory->items || !pInventory->nextFree || !HASHINDEX_Init(&pInventory->index, pInventory->maxItems) ||
+        !pInventory->sortKeys || !pInventory->savedSlots || !pInventory->savedItems)
+    {
+        INVENTORY_Destroy(pInventory);
+        return NULL;
+    }
+
+    for (DWORD i = 0; i < pInventory->maxItems; i++)
+    {
+        pInventory->nextFree[i] = i + 1;
+    }
+    for (DWORD g = 0; g < pDesc->gridCount; g++)
+    {
+        pInventory->grids[g].width = pDesc->width[g];
+        pInventory->grids[g].height = pDesc->height[g];
+        ResetBoard(&pInventory->grids[g]);
+    }
+    return pInventory;
+}
+
+void __cdecl INVENTORY_Destroy(Inventory *pInventory)
+{
+    if (!pInventory)
+    {
+        return;
+    }
+    free(pInventory->items);
+    free(pInventory->nextFree);
+    HASHINDEX_Free(&pInventory->index);
+    free(pInventory->sortKeys);
+    free(pInventory->savedSlots);
+    free(pInventory->savedItems);
+    free(pInventory);
+}
+
+BOOL __cdecl INVENTORY_CanPlace(const Inventory *pInventory, DWORD grid, int x, int y, DWORD width, DWORD height)
+{
+    return grid < pInventory->gridCount && BoardFits(&pInventory->grids[grid], x, y, width, height);
+}
+
+BOOL __cdecl INVENTORY_FindFreeSpace(const Inventory *pInventory, DWORD grid, DWORD width, DWORD height,
+                                     InventoryScan scan, int *pX, int *pY)
+{
+    return grid < pInventory->gridCount && BoardFindFree(&pInventory->grids[grid], width, height, scan, pX, pY);
+}
+
+BOOL __cdecl INVENTORY_Place(Inventory *pInventory, DWORD id, DWORD grid, int x, int y, DWORD width, DWORD height)
+{
+    if (id == INV_NO_ITEM || pInventory->freeHead >= pInventory->maxItems ||
+        !INVENTORY_CanPlace(pInventory, grid, x, y, width, height) ||
+        HASHINDEX_Find(&pInventory->index, id) != HASHINDEX_NONE)
+    {
+        return FALSE;
+    }
+
+    DWORD slot = pInventory->freeHead;
+    pInventory->freeHead = pInventory->nextFree[slot];
+
+    InventoryItem *pItem = &pInventory->items[slot];
+    pItem->id = id;
+    pItem->grid = (BYTE)grid;
+    pItem->x = (BYTE)x;
+    pItem->y = (BYTE)y;
+    pItem->width = (BYTE)width;
+    pItem->height = (BYTE)height;
+
+    MarkCells(&pInventory->grids[grid], pItem, (WORD)(slot + 1));
+    HASHINDEX_Insert(&pInventory->index, id, slot);
+    pInventory->itemCount++;
+    return TRUE;
+}
+
+BOOL __cdecl INVENTORY_AutoPlace(Inventory *pInventory, DWORD id, DWORD grid, DWORD width, DWORD height,
+                                 InventoryScan scan, int *pX, int *pY)
+{
+    int x, y;
+    if (!INVENTORY_FindFreeSpace(pInventory, grid, width, height, scan, &x, &y) ||
+        !INVENTORY_Place(pInventory, id, grid, x, y, width, height))
+    {
+        return FALSE;
+    }
+
+    if (pX)
+        *pX = x;
+    if (pY)
+        *pY = y;
+    return TRUE;
+}
+
+BOOL __cdecl INVENTORY_Remove(Inventory *pInventory, DWORD id)
+{
+    DWORD i = (id == INV_NO_ITEM) ? HASHINDEX_NONE : HASHINDEX_Find(&pInventory->index, id);
+    if (i == HASHINDEX_NONE)
+    {
+        return FALSE;
+    }
+
+    DWORD slot = pInventory->index.pValues[i];
+    InventoryItem *pItem = &pInventory->items[slot];
+    MarkCells(&pInventory->grids[pItem->grid], pItem, 0);
+    HASHINDEX_Erase(&pInventory->index, i);
+
+    pItem->id = INV_NO_ITEM;
+    pInventory->nextFree[slot] = pInventory->freeHead;
+    pInventory->freeHead = slot;
+    pInventory->itemCount--;
+    return TRUE;
+}
+
+const InventoryItem *__cdecl INVENTORY_FindItem(const Inventory *pInventory, DWORD id)
+{
+    DWORD i = (id == INV_NO_ITEM) ? HASHINDEX_NONE : HASHINDEX_Find(&pInventory->index, id);
+    return (i == HASHINDEX_NONE) ? NULL : &pInventory->items[pInventory->index.pValues[i]];
+}
+
+DWORD __cdecl INVENTORY_GetItemAt(const Inventory *pInventory, DWORD grid, int x, int y)
+{
+    if (grid >= pInventory->gridCount || x < 0 || y < 0 || x >= pInventory->grids[grid].width ||
+        y >= pInventory->grids[grid].height)
+    {
+        return INV_NO_ITEM;
+    }
+
+    WORD owner = pInventory->grids[grid].owner[y * INV_MAX_WIDTH + x];
+    return owner ? pInventory->items[owner - 1].id : INV_NO_ITEM;
+}
+
+DWORD __cdecl INVENTORY_GetItemCount(const Inventory *pInventory)
+{
+    return pInventory->itemCount;
+}
+
+DWORD __cdecl INVENTORY_GetFreeCells(const Inventory *pInventory, DWORD grid)
+{
+    if (grid >= pInventory->gridCount)
+    {
+        return 0;
+    }
+
+    DWORD count = 0;
+    for (DWORD j = 0; j < GRID_WORDS; j++)
+    {
+        for (uint64_t v = ~pInventory->grids[grid].words[j]; v; v &= v - 1)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Ascending key order = area descending, height descending, id ascending
+static uint64_t SortKey(const InventoryItem *pItem, DWORD slot)
+{
+    uint64_t area = 255 - (DWORD)pItem->width * pItem->height;
+    uint64_t height = 255 - pItem->height;
+    return (area << 56) | (height << 48) | ((uint64_t)pItem->id << 16) | slot;
+}
+
+static int CompareKeys(const void *pA, const void *pB)
+{
+    uint64_t a = *(const uint64_t *)pA;
+    uint64_t b = *(const uint64_t *)pB;
+    return (a > b) - (a < b);
+}
+
+BOOL __cdecl INVENTORY_Sort(Inventory *pInventory, DWORD grid, InventoryScan scan)
+{
+    if (grid >= pInventory->gridCount)
+    {
+        return FALSE;
+    }
+
+    GridBoard *pBoard = &pInventory->grids[grid];
+    DWORD count = 0;
+    for (DWORD slot = 0; slot < pInventory->maxItems; slot++)
+    {
+        const InventoryItem *pItem = &pInventory->items[slot];
+        if (pItem->id != INV_NO_ITEM && pItem->grid == grid)
+        {
+            pInventory->savedItems[count] = *pItem;
+            pInventory->savedSlots[count] = slot;
+            pInventory->sortKeys[count++] = SortKey(pItem, slot);
+        }
+    }
+    qsort(pInventory->sortKeys, count, sizeof(uint64_t), CompareKeys);
+
+    ResetBoard(pBoard);
+    BOOL ok = TRUE;
+    for (DWORD i = 0; i < count && ok; i++)
+    {
+        DWORD slot = (DWORD)(pInventory->sortKeys[i] & 0xFFFF);
+        InventoryItem *pItem = &pInventory->items[slot];
+        int x, y;
+        ok = BoardFindFree(pBoard, pItem->width, pItem->height, scan, &x, &y);
+        if (ok)
+        {
+            pItem->x = (BYTE)x;
+            pItem->y = (BYTE)y;
+            MarkCells(pBoard, pItem, (WORD)(slot + 1));
+        }
+    }
+
+    if (!ok)
+    {
+        ResetBoard(pBoard);
+        for (DWORD i = 0; i < count; i++)
+        {
+            pInventory->items[pInventory->savedSlots[i]] = pInventory->savedItems[i];
+            MarkCells(pBoard, &pInventory->savedItems[i], (WORD)(pInventory->savedSlots[i] + 1));
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,95 @@
+/*
+ * InventoryGrid.hpp - D2Common bitboard inventory grids
+ *
+ * CanPlaceItemInInventory, PlaceItemInInventory and FindItemInInventory
+ * work on a 10x10 cell array plus the unit's linked item list: every fit
+ * test scans the item's cells, auto-placement tries every position, and a
+ * lookup by GUID walks the list.
+ *
+ * Here each grid's occupancy is a bitboard: 16-bit rows, four rows per
+ * 64-bit word. Cells outside the grid are permanently set, so bounds never
+ * need a separate check in the inner loops.
+ *
+ *   fit test   - one shifted 64-bit AND for items up to four rows tall.
+ *   first fit  - horizontal runs via shift-AND over whole words, vertical
+ *                runs via AND of row-shifted words, then the first set bit
+ *                in the requested scan order (count-trailing-zeros).
+ *   lookup     - GUID hash index; cell -> item via an owner map.
+ *
+ * Scan orders match the game: pickups fill column by column (top to bottom,
+ * then left to right); INVSCAN_ROWS is provided for row-major callers.
+ * One inventory per unit; not thread safe.
+ */
+
+#ifndef INVENTORYGRID_HPP
+#define INVENTORYGRID_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#define INV_MAX_GRIDS 8
+#define INV_MAX_WIDTH 16
+#define INV_MAX_HEIGHT 16
+
+#define INV_NO_ITEM 0
+
+// Standard grid sizes (LoD)
+#define INV_GRID_BODY_WIDTH 10
+#define INV_GRID_BODY_HEIGHT 4
+#define INV_GRID_STASH_WIDTH 6
+#define INV_GRID_STASH_HEIGHT 8
+#define INV_GRID_CUBE_WIDTH 3
+#define INV_GRID_CUBE_HEIGHT 4
+
+typedef enum InventoryScan
+{
+    INVSCAN_COLUMNS = 0, // x outer, y inner: the game's auto-placement order
+    INVSCAN_ROWS = 1,    // y outer, x inner
+} InventoryScan;
+
+typedef struct InventoryDesc
+{
+    DWORD gridCount;
+    BYTE width[INV_MAX_GRIDS];  // At most INV_MAX_WIDTH
+    BYTE height[INV_MAX_GRIDS]; // At most INV_MAX_HEIGHT
+    DWORD maxItems;             // Items across all grids (0 = 256)
+} InventoryDesc;
+
+typedef struct InventoryItem
+{
+    DWORD id; // Item GUID, never INV_NO_ITEM
+    BYTE grid;
+    BYTE x;
+    BYTE y;
+    BYTE width;
+    BYTE height;
+} InventoryItem;
+
+typedef struct Inventory Inventory;
+
+Inventory *__cdecl INVENTORY_Create(const InventoryDesc *pDesc);
+void __cdecl INVENTORY_Destroy(Inventory *pInventory);
+
+BOOL __cdecl INVENTORY_CanPlace(const Inventory *pInventory, DWORD grid, int x, int y, DWORD width, DWORD height);
+BOOL __cdecl INVENTORY_FindFreeSpace(const Inventory *pInventory, DWORD grid, DWORD width, DWORD height,
+                                     InventoryScan scan, int *pX, int *pY);
+
+// Fails if the id is already present, the item does not fit or the inventory is full
+BOOL __cdecl INVENTORY_Place(Inventory *pInventory, DWORD id, DWORD grid, int x, int y, DWORD width, DWORD height);
+// FindFreeSpace + Place; position returned through pX/pY (may be NULL)
+BOOL __cdecl INVENTORY_AutoPlace(Inventory *pInventory, DWORD id, DWORD grid, DWORD width, DWORD height,
+                                 InventoryScan scan, int *pX, int *pY);
+BOOL __cdecl INVENTORY_Remove(Inventory *pInventory, DWORD id);
+
+const InventoryItem *__cdecl INVENTORY_FindItem(const Inventory *pInventory, DWORD id);
+DWORD __cdecl INVENTORY_GetItemAt(const Inventory *pInventory, DWORD grid, int x, int y);
+DWORD __cdecl INVENTORY_GetItemCount(const Inventory *pInventory);
+DWORD __cdecl INVENTORY_GetFreeCells(const Inventory *pInventory, DWORD grid);
+
+/*
+ * Stash sort: repack a grid with the largest items first (area, then
+ * height, then id), each at its first fit. If the repacked layout would not
+ * hold every item the grid is left unchanged and FALSE is returned.
+ */
+BOOL __cdecl INVENTORY_Sort(Inventory *pInventory, DWORD grid, InventoryScan scan);
+
+#endif // INVENTORYGRID_HPP
@@ -0,0 +1,699 @@
+/*
+ * ItemCodec.cpp - D2Common bit-level item codec
+ *
+ * See ItemCodec.hpp for the record layout. Decode and Validate share one
+ * walk; Validate passes no item, so the fixed-width fields land in a D2Item
+ * on the stack and names and stats are checked but not stored.
+ */
+
+#include "ItemCodec.hpp"
+
+#include "BitStream.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+#define ITEM_MAGIC 0x4D4A // "JM"
+#define LIST_MAGIC 0x4D4A
+#define MAX_QUALITY ITEMQUAL_CRAFTED
+#define RARE_AFFIXES 6
+#define REALM_DWORDS 3
+#define DEFENSE_ADD 10
+
+// =============================================================================
+// LAYOUT TABLES
+// =============================================================================
+
+// One fixed-width field of the record, stored at an offset into D2Item
+typedef struct ItemField
+{
+    BYTE bits;
+    BYTE size; // Of the D2Item member: 1, 2 or 4
+    WORD offset;
+} ItemField;
+
+#define FIELD(bits, member) {bits, (BYTE)sizeof(((D2Item *)0)->member), (WORD)offsetof(D2Item, member)}
+
+static const ItemField s_headerFields[] = {
+    FIELD(32, flags), FIELD(10, version), FIELD(3, location), FIELD(4, equipped),
+    FIELD(4, x),      FIELD(4, y),        FIELD(3, page),
+};
+
+static const ItemField s_earFields[] = {FIELD(3, earClass), FIELD(7, earLevel)};
+
+static const ItemField s_extendedFields[] = {FIELD(32, guid), FIELD(7, level), FIELD(4, quality)};
+
+static const ItemField s_lowHighFields[] = {FIELD(3, qualityData[0])};
+static const ItemField s_magicFields[] = {FIELD(11, qualityData[0]), FIELD(11, qualityData[1])};
+static const ItemField s_setUniqueFields[] = {FIELD(12, qualityData[0])};
+static const ItemField s_rareFields[] = {FIELD(8, qualityData[0]), FIELD(8, qualityData[1])};
+
+typedef struct QualityBlock
+{
+    const ItemField *pFields;
+    DWORD count;
+    BOOL rareAffixes; // Followed by six optional 11-bit affixes
+} QualityBlock;
+
+static const QualityBlock s_qualityBlocks[MAX_QUALITY + 1] = {
+    {NULL, 0, FALSE},
+    {s_lowHighFields, 1, FALSE},   // Low
+    {NULL, 0, FALSE},              // Normal
+    {s_lowHighFields, 1, FALSE},   // Superior
+    {s_magicFields, 2, FALSE},     // Magic
+    {s_setUniqueFields, 1, FALSE}, // Set
+    {s_rareFields, 2, TRUE},       // Rare
+    {s_setUniqueFields, 1, FALSE}, // Unique
+    {s_rareFields, 2, TRUE},       // Crafted
+};
+
+struct ItemCodec
+{
+    ItemStatLayout stats[ITEM_STAT_IDS];
+    DWORD(__cdecl *pfnItemClass)(void *pContext, DWORD code);
+    void *pContext;
+};
+
+static inline void StoreField(D2Item *pItem, const ItemField *pField, DWORD value)
+{
+    BYTE *p = (BYTE *)pItem + pField->offset;
+    if (pField->size == 1)
+    {
+        *p = (BYTE)value;
+    }
+    else if (pField->size == 2)
+    {
+        WORD w = (WORD)value;
+        memcpy(p, &w, sizeof(w));
+    }
+    else
+    {
+        memcpy(p, &value, sizeof(value));
+    }
+}
+
+static inline DWORD LoadField(const D2Item *pItem, const ItemField *pField)
+{
+    const BYTE *p = (const BYTE *)pItem + pField->offset;
+    if (pField->size == 1)
+    {
+        return *p;
+    }
+    if (pField->size == 2)
+    {
+        WORD w;
+        memcpy(&w, p, sizeof(w));
+        return w;
+    }
+    DWORD d;
+    memcpy(&d, p, sizeof(d));
+    return d;
+}
+
+static inline void ReadFields(BitReader *pReader, const ItemField *pFields, DWORD count, D2Item *pItem)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD value = BITREADER_Read(pReader, pFields[i].bits);
+        if (pItem)
+        {
+            StoreField(pItem, &pFields[i], value);
+        }
+    }
+}
+
+static inline void WriteFields(BitWriter *pWriter, const ItemField *pFields, DWORD count, const D2Item *pItem)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        BITWRITER_Write(pWriter, LoadField(pItem, &pFields[i]), pFields[i].bits);
+    }
+}
+
+// =============================================================================
+// WALK (DECODE / VALIDATE)
+// =============================================================================
+
+static BOOL ReadName(BitReader *pReader, char *szName)
+{
+    for (DWORD i = 0; i < ITEM_MAX_NAME; i++)
+    {
+        char c = (char)BITREADER_Read(pReader, 7);
+        if (szName)
+        {
+            szName[i] = c;
+        }
+        if (c == 0)
+        {
+            return !pReader->overrun;
+        }
+    }
+    return FALSE; // Unterminated
+}
+
+static BOOL ReadStatList(const ItemCodec *pCodec, BitReader *pReader, BYTE list, D2Item *pItem, DWORD *pStatCount)
+{
+    for (;;)
+    {
+        DWORD id = BITREADER_Read(pReader, 9);
+        if (pReader->overrun)
+        {
+            return FALSE;
+        }
+        if (id == ITEM_STAT_END)
+        {
+            return TRUE;
+        }
+
+        DWORD chain = pCodec->stats[id].chained;
+        for (DWORD k = 0; k <= chain; k++, id++)
+        {
+            if (id >= ITEM_STAT_IDS || pCodec->stats[id].saveBits == 0 || *pStatCount >= ITEM_MAX_STATS)
+            {
+                return FALSE;
+            }
+            const ItemStatLayout *pLayout = &pCodec->stats[id];
+            DWORD param = pLayout->paramBits ? BITREADER_Read(pReader, pLayout->paramBits) : 0;
+            DWORD raw = BITREADER_Read(pReader, pLayout->saveBits);
+            if (pItem)
+            {
+                ItemStat *pStat = &pItem->stats[*pStatCount];
+                pStat->id = (WORD)id;
+                pStat->list = list;
+                pStat->reserved = 0;
+                pStat->param = param;
+                pStat->value = (int)raw - pLayout->saveAdd;
+            }
+            (*pStatCount)++;
+        }
+    }
+}
+
+// What a list walk needs to know about an item
+typedef struct ItemShape
+{
+    DWORD location;
+    DWORD socketsFilled; // Children that follow it
+} ItemShape;
+
+// Fixed-width fields always land in a D2Item (the caller's, or one on the stack when validating) since they steer
+// the walk; names and stats are only stored when decoding.
+static BOOL WalkItem(const ItemCodec *pCodec, BitReader *pReader, D2Item *pItem, ItemShape *pShape)
+{
+    D2Item local;
+    D2Item *pFields = pItem ? pItem : &local;
+    memset(pFields, 0, offsetof(D2Item, stats));
+    pFields->gfx = 0xFF;
+    pFields->autoAffix = 0xFFFF;
+
+    if (BITREADER_Read(pReader, 16) != ITEM_MAGIC)
+    {
+        return FALSE;
+    }
+    ReadFields(pReader, s_headerFields, D2_ARRAY_SIZE(s_headerFields), pFields);
+    DWORD flags = pFields->flags;
+    pShape->location = pFields->location;
+    pShape->socketsFilled = 0;
+
+    if (flags & ITEMFLAG_EAR)
+    {
+        ReadFields(pReader, s_earFields, D2_ARRAY_SIZE(s_earFields), pFields);
+        if (!ReadName(pReader, pItem ? pItem->szName : NULL))
+        {
+            return FALSE;
+        }
+        BITREADER_Align(pReader);
+        return !pReader->overrun;
+    }
+
+    DWORD code = BITREADER_Read(pReader, 32);
+    DWORD itemClass = pCodec->pfnItemClass(pCodec->pContext, code);
+    if (itemClass & ITEMCLASS_UNKNOWN)
+    {
+        return FALSE;
+    }
+    DWORD socketsFilled = BITREADER_Read(pReader, (flags & ITEMFLAG_SIMPLE) ? 1 : 3);
+    pFields->code = code;
+    pFields->socketsFilled = (BYTE)socketsFilled;
+    pShape->socketsFilled = socketsFilled;
+    if (flags & ITEMFLAG_SIMPLE)
+    {
+        BITREADER_Align(pReader);
+        return !pReader->overrun;
+    }
+
+    ReadFields(pReader, s_extendedFields, D2_ARRAY_SIZE(s_extendedFields), pFields);
+    DWORD quality = pFields->quality;
+    if (quality == 0 || quality > MAX_QUALITY)
+    {
+        return FALSE;
+    }
+
+    if (BITREADER_Read(pReader, 1))
+    {
+        pFields->gfx = (BYTE)BITREADER_Read(pReader, 3);
+    }
+    if (BITREADER_Read(pReader, 1))
+    {
+        pFields->autoAffix = (WORD)BITREADER_Read(pReader, 11);
+    }
+
+    const QualityBlock *pBlock = &s_qualityBlocks[quality];
+    ReadFields(pReader, pBlock->pFields, pBlock->count, pFields);
+    if (pBlock->rareAffixes)
+    {
+        for (DWORD i = 0; i < RARE_AFFIXES; i++)
+        {
+            pFields->qualityData[2 + i] = (WORD)(BITREADER_Read(pReader, 1) ? BITREADER_Read(pReader, 11) : 0);
+        }
+    }
+
+    if (flags & ITEMFLAG_RUNEWORD)
+    {
+        pFields->runeword = (WORD)BITREADER_Read(pReader, 16);
+    }
+    if ((flags & ITEMFLAG_PERSONALIZED) && !ReadName(pReader, pItem ? pItem->szName : NULL))
+    {
+        return FALSE;
+    }
+    if (itemClass & ITEMCLASS_TOME)
+    {
+        pFields->tome = (BYTE)BITREADER_Read(pReader, 5);
+    }
+    pFields->hasRealmData = (BYTE)BITREADER_Read(pReader, 1);
+    if (pFields->hasRealmData)
+    {
+        for (DWORD i = 0; i < REALM_DWORDS; i++)
+        {
+            pFields->realmData[i] = BITREADER_Read(pReader, 32);
+        }
+    }
+
+    if (itemClass & ITEMCLASS_ARMOR)
+    {
+        DWORD defense = BITREADER_Read(pReader, 11);
+        if (defense < DEFENSE_ADD)
+        {
+            return FALSE;
+        }
+        pFields->defense = (WORD)(defense - DEFENSE_ADD);
+    }
+    if (itemClass & (ITEMCLASS_ARMOR | ITEMCLASS_WEAPON))
+    {
+        pFields->maxDurability = (BYTE)BITREADER_Read(pReader, 8);
+        pFields->durability = (WORD)(pFields->maxDurability ? BITREADER_Read(pReader, 9) : 0);
+        if (pFields->durability > pFields->maxDurability)
+        {
+            return FALSE;
+        }
+    }
+    if (itemClass & ITEMCLASS_STACKABLE)
+    {
+        pFields->quantity = (WORD)BITREADER_Read(pReader, 9);
+    }
+    if (flags & ITEMFLAG_SOCKETED)
+    {
+        pFields->sockets = (BYTE)BITREADER_Read(pReader, 4);
+    }
+    if (socketsFilled > pFields->sockets)
+    {
+        return FALSE;
+    }
+    DWORD setMask = 0;
+    if (quality == ITEMQUAL_SET)
+    {
+        setMask = BITREADER_Read(pReader, 5);
+        pFields->setMask = (BYTE)setMask;
+    }
+
+    DWORD statCount = 0;
+    if (!ReadStatList(pCodec, pReader, ITEM_LIST_BASE, pItem, &statCount))
+    {
+        return FALSE;
+    }
+    for (DWORD bit = 0; bit < 5; bit++)
+    {
+        if ((setMask & (1u << bit)) && !ReadStatList(pCodec, pReader, (BYTE)(ITEM_LIST_SET + bit), pItem, &statCount))
+        {
+            return FALSE;
+        }
+    }
+    if ((flags & ITEMFLAG_RUNEWORD) && !ReadStatList(pCodec, pReader, ITEM_LIST_RUNEWORD, pItem, &statCount))
+    {
+        return FALSE;
+    }
+    pFields->statCount = (BYTE)statCount;
+
+    BITREADER_Align(pReader);
+    return !pReader->overrun;
+}
+
+// =============================================================================
+// ENCODE
+// =============================================================================
+
+static void WriteName(BitWriter *pWriter, const char *szName)
+{
+    for (DWORD i = 0; i < ITEM_MAX_NAME - 1 && szName[i]; i++)
+    {
+        BITWRITER_Write(pWriter, (BYTE)szName[i], 7);
+    }
+    BITWRITER_Write(pWriter, 0, 7);
+}
+
+static BOOL WriteStatList(const ItemCodec *pCodec, BitWriter *pWriter, const D2Item *pItem, BYTE list)
+{
+    for (DWORD s = 0; s < pItem->statCount;)
+    {
+        const ItemStat *pStat = &pItem->stats[s];
+        if (pStat->list != list)
+        {
+            s++;
+            continue;
+        }
+        if (pStat->id >= ITEM_STAT_IDS || pCodec->stats[pStat->id].saveBits == 0)
+        {
+            return FALSE;
+        }
+
+        // A chained group is the first stat's id followed by every member's param and value
+        DWORD chain = pCodec->stats[pStat->id].chained;
+        if (s + chain >= pItem->statCount)
+        {
+            return FALSE;
+        }
+        BITWRITER_Write(pWriter, pStat->id, 9);
+        for (DWORD k = 0; k <= chain; k++)
+        {
+            const ItemStat *pMember = &pItem->stats[s + k];
+            if (pMember->id != pStat->id + k || pMember->list != list || pCodec->stats[pMember->id].saveBits == 0)
+            {
+                return FALSE;
+            }
+            const ItemStatLayout *pLayout = &pCodec->stats[pMember->id];
+            if (pLayout->paramBits)
+            {
+                BITWRITER_Write(pWriter, pMember->param, pLayout->paramBits);
+            }
+            BITWRITER_Write(pWriter, (DWORD)(pMember->value + pLayout->saveAdd), pLayout->saveBits);
+        }
+        s += chain + 1;
+    }
+    BITWRITER_Write(pWriter, ITEM_STAT_END, 9);
+    return TRUE;
+}
+
+static BOOL WriteItem(const ItemCodec *pCodec, BitWriter *pWriter, const D2Item *pItem)
+{
+    BITWRITER_Write(pWriter, ITEM_MAGIC, 16);
+    WriteFields(pWriter, s_headerFields, D2_ARRAY_SIZE(s_headerFields), pItem);
+
+    if (pItem->flags & ITEMFLAG_EAR)
+    {
+        WriteFields(pWriter, s_earFields, D2_ARRAY_SIZE(s_earFields), pItem);
+        WriteName(pWriter, pItem->szName);
+        BITWRITER_Align(pWriter);
+        return TRUE;
+    }
+
+    DWORD itemClass = pCodec->pfnItemClass(pCodec->pContext, pItem->code);
+    if (itemClass & ITEMCLASS_UNKNOWN)
+    {
+        return FALSE;
+    }
+    BITWRITER_Write(pWriter, pItem->code, 32);
+    BITWRITER_Write(pWriter, pItem->socketsFilled, (pItem->flags & ITEMFLAG_SIMPLE) ? 1 : 3);
+    if (pItem->flags & ITEMFLAG_SIMPLE)
+    {
+        BITWRITER_Align(pWriter);
+        return TRUE;
+    }
+
+    if (pItem->quality == 0 || pItem->quality > MAX_QUALITY)
+    {
+        return FALSE;
+    }
+    WriteFields(pWriter, s_extendedFields, D2_ARRAY_SIZE(s_extendedFields), pItem);
+    BITWRITER_Write(pWriter, pItem->gfx != 0xFF, 1);
+    if (pItem->gfx != 0xFF)
+    {
+        BITWRITER_Write(pWriter, pItem->gfx, 3);
+    }
+    BITWRITER_Write(pWriter, pItem->autoAffix != 0xFFFF, 1);
+    if (pItem->autoAffix != 0xFFFF)
+    {
+        BITWRITER_Write(pWriter, pItem->autoAffix, 11);
+    }
+
+    const QualityBlock *pBlock = &s_qualityBlocks[pItem->quality];
+    WriteFields(pWriter, pBlock->pFields, pBlock->count, pItem);
+    if (pBlock->rareAffixes)
+    {
+        for (DWORD i = 0; i < RARE_AFFIXES; i++)
+        {
+            WORD affix = pItem->qualityData[2 + i];
+            BITWRITER_Write(pWriter, affix != 0, 1);
+            if (affix)
+            {
+                BITWRITER_Write(pWriter, affix, 11);
+            }
+        }
+    }
+
+    if (pItem->flags & ITEMFLAG_RUNEWORD)
+    {
+        BITWRITER_Write(pWriter, pItem->runeword, 16);
+    }
+    if (pItem->flags & ITEMFLAG_PERSONALIZED)
+    {
+        WriteName(pWriter, pItem->szName);
+    }
+    if (itemClass & ITEMCLASS_TOME)
+    {
+        BITWRITER_Write(pWriter, pItem->tome, 5);
+    }
+    BITWRITER_Write(pWriter, pItem->hasRealmData, 1);
+    if (pItem->hasRealmData)
+    {
+        for (DWORD i = 0; i < REALM_DWORDS; i++)
+        {
+            BITWRITER_Write(pWriter, pItem->realmData[i], 32);
+        }
+    }
+
+    if (itemClass & ITEMCLASS_ARMOR)
+    {
+        BITWRITER_Write(pWriter, pItem->defense + DEFENSE_ADD, 11);
+    }
+    if (itemClass & (ITEMCLASS_ARMOR | ITEMCLASS_WEAPON))
+    {
+        BITWRITER_Write(pWriter, pItem->maxDurability, 8);
+        if (pItem->maxDurability)
+        {
+            BITWRITER_Write(pWriter, pItem->durability, 9);
+        }
+    }
+    if (itemClass & ITEMCLASS_STACKABLE)
+    {
+        BITWRITER_Write(pWriter, pItem->quantity, 9);
+    }
+    if (pItem->flags & ITEMFLAG_SOCKETED)
+    {
+        BITWRITER_Write(pWriter, pItem->sockets, 4);
+    }
+    if (pItem->quality == ITEMQUAL_SET)
+    {
+        BITWRITER_Write(pWriter, pItem->setMask, 5);
+    }
+
+    if (!WriteStatList(pCodec, pWriter, pItem, ITEM_LIST_BASE))
+    {
+        return FALSE;
+    }
+    for (DWORD bit = 0; bit < 5; bit++)
+    {
+        if ((pItem->quality == ITEMQUAL_SET && (pItem->setMask & (1u << bit))) &&
+            !WriteStatList(pCodec, pWriter, pItem, (BYTE)(ITEM_LIST_SET + bit)))
+        {
+            return FALSE;
+        }
+    }
+    if ((pItem->flags & ITEMFLAG_RUNEWORD) && !WriteStatList(pCodec, pWriter, pItem, ITEM_LIST_RUNEWORD))
+    {
+        return FALSE;
+    }
+    BITWRITER_Align(pWriter);
+    return TRUE;
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+ItemCodec *__cdecl ITEMCODEC_Create(const ItemCodecDesc *pDesc)
+{
+    if (!pDesc || !pDesc->pStats || !pDesc->pfnItemClass)
+    {
+        return NULL;
+    }
+    ItemCodec *pCodec = new ItemCodec;
+    memcpy(pCodec->stats, pDesc->pStats, sizeof(pCodec->stats));
+    pCodec->pfnItemClass = pDesc->pfnItemClass;
+    pCodec->pContext = pDesc->pContext;
+    return pCodec;
+}
+
+void __cdecl ITEMCODEC_Destroy(ItemCodec *pCodec)
+{
+    delete pCodec;
+}
+
+BOOL __cdecl ITEMCODEC_Validate(const ItemCodec *pCodec, const BYTE *pData, size_t size, size_t *pBytes)
+{
+    BitReader reader;
+    ItemShape shape;
+    BITREADER_Init(&reader, pData, size);
+    if (!WalkItem(pCodec, &reader, NULL, &shape))
+    {
+        return FALSE;
+    }
+    if (pBytes)
+    {
+        *pBytes = BITREADER_Tell(&reader) >> 3;
+    }
+    return TRUE;
+}
+
+BOOL __cdecl ITEMCODEC_Decode(const ItemCodec *pCodec, const BYTE *pData, size_t size, D2Item *pItem,
+                              size_t *pBytes)
+{
+    BitReader reader;
+    ItemShape shape;
+    BITREADER_Init(&reader, pData, size);
+    if (!WalkItem(pCodec, &reader, pItem, &shape))
+    {
+        return FALSE;
+    }
+    if (pBytes)
+    {
+        *pBytes = BITREADER_Tell(&reader) >> 3;
+    }
+    return TRUE;
+}
+
+BOOL __cdecl ITEMCODEC_Encode(const ItemCodec *pCodec, const D2Item *pItem, BYTE *pOut, size_t capacity,
+                              size_t *pBytes)
+{
+    BitWriter writer;
+    BITWRITER_Init(&writer, pOut, capacity);
+    if (!WriteItem(pCodec, &writer, pItem) || !BITWRITER_Finish(&writer))
+    {
+        return FALSE;
+    }
+    if (pBytes)
+    {
+        *pBytes = BITWRITER_Size(&writer);
+    }
+    return TRUE;
+}
+
+// Shared by ValidateList and DecodeList (decode FALSE: nothing is stored)
+static BOOL WalkList(const ItemCodec *pCodec, const BYTE *pData, size_t size, BOOL decode, D2Item *pItems,
+                     DWORD maxItems, DWORD *pCount, size_t *pBytes)
+{
+    BitReader reader;
+    BITREADER_Init(&reader, pData, size);
+    if (BITREADER_Read(&reader, 16) != LIST_MAGIC)
+    {
+        return FALSE;
+    }
+    DWORD topLevel = BITREADER_Read(&reader, 16);
+    if (reader.overrun)
+    {
+        return FALSE;
+    }
+
+    DWORD count = 0;
+    for (DWORD i = 0; i < topLevel; i++)
+    {
+        // The parent, then the items in its sockets
+        DWORD pending = 1;
+        for (DWORD k = 0; k < pending; k++, count++)
+        {
+            if (decode && count >= maxItems)
+            {
+                return FALSE;
+            }
+            ItemShape shape;
+            if (!WalkItem(pCodec, &reader, decode ? &pItems[count] : NULL, &shape))
+            {
+                return FALSE;
+            }
+            if ((k == 0) == (shape.location == ITEM_LOCATION_SOCKETED))
+            {
+                return FALSE;
+            }
+            if (k == 0)
+            {
+                pending += shape.socketsFilled;
+            }
+        }
+    }
+
+    if (pCount)
+    {
+        *pCount = count;
+    }
+    if (pBytes)
+    {
+        *pBytes = BITREADER_Tell(&reader) >> 3;
+    }
+    return TRUE;
+}
+
+BOOL __cdecl ITEMCODEC_ValidateList(const ItemCodec *pCodec, const BYTE *pData, size_t size, DWORD *pCount,
+                                    size_t *pBytes)
+{
+    return WalkList(pCodec, pData, size, FALSE, NULL, 0, pCount, pBytes);
+}
+
+BOOL __cdecl ITEMCODEC_DecodeList(const ItemCodec *pCodec, const BYTE *pData, size_t size, D2Item *pItems,
+                                  DWORD maxItems, DWORD *pCount, size_t *pBytes)
+{
+    return WalkList(pCodec, pData, size, TRUE, pItems, maxItems, pCount, pBytes);
+}
+
+BOOL __cdecl ITEMCODEC_EncodeList(const ItemCodec *pCodec, const D2Item *pItems, DWORD count, BYTE *pOut,
+                                  size_t capacity, size_t *pBytes)
+{
+    DWORD topLevel = 0;
+    for (DWORD i = 0; i < count; i++)
+    {
+        topLevel += pItems[i].location != ITEM_LOCATION_SOCKETED;
+    }
+    if (topLevel > 0xFFFF)
+    {
+        return FALSE;
+    }
+
+    BitWriter writer;
+    BITWRITER_Init(&writer, pOut, capacity);
+    BITWRITER_Write(&writer, LIST_MAGIC, 16);
+    BITWRITER_Write(&writer, topLevel, 16);
+    for (DWORD i = 0; i < count; i++)
+    {
+        if (!WriteItem(pCodec, &writer, &pItems[i]))
+        {
+            return FALSE;
+        }
+    }
+    if (!BITWRITER_Finish(&writer))
+    {
+        return FALSE;
+    }
+    if (pBytes)
+    {
+        *pBytes = BITWRITER_Size(&writer);
+    }
+    return TRUE;
+}
@@ -0,0 +1,168 @@
+/*
+ * ItemCodec.hpp - D2Common bit-level item codec
+ *
+ * Items travel as LSB-first bit records, in .d2s saves and in item packets
+ * alike. D2Common walks a record one field at a time through Fog's bit
+ * buffer and builds a heap Unit for every item (and its sockets) before it
+ * can check anything, so a character with full stash and inventory pays
+ * hundreds of allocations and field calls on every join.
+ *
+ * The codec reads and writes the 1.10+ record with a 64-bit buffered
+ * bit stream (BitStream.hpp) and never allocates:
+ *   - the layout is declared as const field tables (header, quality
+ *     blocks) and the per-stat widths come from ItemStatCost's save
+ *     columns, handed in once as an ItemStatLayout table;
+ *   - Validate walks a record or a whole "JM" list in place and checks it
+ *     without materializing anything;
+ *   - Decode fills caller-provided D2Item structs, Encode writes them back
+ *     byte-identically; the List variants do a whole inventory (top-level
+ *     items each followed by the items in their sockets) in one call.
+ *
+ * Item record (1.10+):
+ *   "JM":16 flags:32 version:10 location:3 equipped:4 x:4 y:4 page:3
+ *   ear:    class:3 level:7 name:7-bit chars up to a 0
+ *   else:   code:32 (4 chars) filled sockets:1 (simple) or :3
+ *   extended (not simple):
+ *     guid:32 ilvl:7 quality:4 [1 gfx:3] [1 autoaffix:11] quality block
+ *     [runeword:16] [personalized name] [tome:5] realm:1 [96]
+ *     [defense:11] [maxdur:8 [curdur:9]] [quantity:9] [sockets:4] [setmask:5]
+ *     property lists: (stat:9 [param] value)* 0x1FF - base, one per set
+ *     mask bit, one for the runeword
+ *   padded to a byte.
+ * Which of defense/durability/quantity/tome apply is decided by the item
+ * code's class (armor.txt / weapons.txt / misc.txt), looked up through a
+ * callback.
+ */
+
+#ifndef ITEMCODEC_HPP
+#define ITEMCODEC_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#define ITEM_MAX_STATS 64
+#define ITEM_MAX_NAME 16 // Personalized / ear names, NUL included
+#define ITEM_STAT_IDS 511
+#define ITEM_STAT_END 0x1FF
+
+// Record flags
+#define ITEMFLAG_IDENTIFIED 0x00000010
+#define ITEMFLAG_SOCKETED 0x00000800
+#define ITEMFLAG_EAR 0x00010000
+#define ITEMFLAG_SIMPLE 0x00200000
+#define ITEMFLAG_ETHEREAL 0x00400000
+#define ITEMFLAG_PERSONALIZED 0x01000000
+#define ITEMFLAG_RUNEWORD 0x04000000
+
+#define ITEM_LOCATION_SOCKETED 6
+
+typedef enum ItemQuality
+{
+    ITEMQUAL_LOW = 1,
+    ITEMQUAL_NORMAL,
+    ITEMQUAL_SUPERIOR,
+    ITEMQUAL_MAGIC,
+    ITEMQUAL_SET,
+    ITEMQUAL_RARE,
+    ITEMQUAL_UNIQUE,
+    ITEMQUAL_CRAFTED,
+} ItemQuality;
+
+// Item code classes (from the item tables)
+#define ITEMCLASS_ARMOR 0x01
+#define ITEMCLASS_WEAPON 0x02
+#define ITEMCLASS_STACKABLE 0x04
+#define ITEMCLASS_TOME 0x08
+#define ITEMCLASS_UNKNOWN 0x80 // Not in any table: the record is rejected
+
+// Stat list a property belongs to
+#define ITEM_LIST_BASE 0
+#define ITEM_LIST_SET 1 // 1-5: set bonus lists, by set mask bit
+#define ITEM_LIST_RUNEWORD 6
+
+// ItemStatCost save columns for one stat
+typedef struct ItemStatLayout
+{
+    BYTE saveBits; // 0 = the stat cannot be saved
+    BYTE paramBits;
+    WORD reserved;
+    int saveAdd;
+    BYTE chained; // Following stats stored without their own id (min/max damage, ...)
+} ItemStatLayout;
+
+typedef struct ItemStat
+{
+    WORD id;
+    BYTE list; // ITEM_LIST_*
+    BYTE reserved;
+    DWORD param;
+    int value;
+} ItemStat;
+
+typedef struct D2Item
+{
+    DWORD flags;
+    WORD version;
+    BYTE location;
+    BYTE equipped;
+    BYTE x;
+    BYTE y;
+    BYTE page;
+    BYTE socketsFilled; // Items following this one in a list
+
+    // Ear
+    BYTE earClass;
+    BYTE earLevel;
+    char szName[ITEM_MAX_NAME]; // Ear or personalized name
+
+    DWORD code; // 4 chars, little-endian ('hax ')
+    DWORD guid;
+    BYTE level;
+    BYTE quality;
+    BYTE gfx;      // 0xFF = none
+    BYTE tome;
+    WORD autoAffix; // 0xFFFF = none
+    WORD qualityData[8]; // Low/high: [0]; magic: prefix, suffix; set/unique: id; rare: 2 names + 6 affixes (0 = none)
+    WORD runeword;
+    BYTE hasRealmData;
+    BYTE sockets;
+    DWORD realmData[3];
+    WORD defense;
+    BYTE maxDurability;
+    BYTE setMask;
+    WORD durability;
+    WORD quantity;
+
+    BYTE statCount;
+    ItemStat stats[ITEM_MAX_STATS]; // Grouped by list, in record order
+} D2Item;
+
+typedef struct ItemCodecDesc
+{
+    const ItemStatLayout *pStats; // ITEM_STAT_IDS entries, indexed by stat id; copied
+    DWORD(__cdecl *pfnItemClass)(void *pContext, DWORD code); // ITEMCLASS_* bits for an item code
+    void *pContext;
+} ItemCodecDesc;
+
+typedef struct ItemCodec ItemCodec;
+
+ItemCodec *__cdecl ITEMCODEC_Create(const ItemCodecDesc *pDesc);
+void __cdecl ITEMCODEC_Destroy(ItemCodec *pCodec);
+
+// One record at pData; *pBytes receives its size. Validate materializes nothing.
+BOOL __cdecl ITEMCODEC_Validate(const ItemCodec *pCodec, const BYTE *pData, size_t size, size_t *pBytes);
+BOOL __cdecl ITEMCODEC_Decode(const ItemCodec *pCodec, const BYTE *pData, size_t size, D2Item *pItem,
+                              size_t *pBytes);
+BOOL __cdecl ITEMCODEC_Encode(const ItemCodec *pCodec, const D2Item *pItem, BYTE *pOut, size_t capacity,
+                              size_t *pBytes);
+
+// "JM" count:16 then the items, each followed by the items in its sockets
+// (location ITEM_LOCATION_SOCKETED, and only there). *pCount receives every
+// item, socketed ones included.
+BOOL __cdecl ITEMCODEC_ValidateList(const ItemCodec *pCodec, const BYTE *pData, size_t size, DWORD *pCount,
+                                    size_t *pBytes);
+BOOL __cdecl ITEMCODEC_DecodeList(const ItemCodec *pCodec, const BYTE *pData, size_t size, D2Item *pItems,
+                                  DWORD maxItems, DWORD *pCount, size_t *pBytes);
+BOOL __cdecl ITEMCODEC_EncodeList(const ItemCodec *pCodec, const D2Item *pItems, DWORD count, BYTE *pOut,
+                                  size_t capacity, size_t *pBytes);
+
+#endif // ITEMCODEC_HPP
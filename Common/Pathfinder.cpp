@@ -0,0 +1,1023 @@
+/*
+ * Pathfinder.cpp - D2Common hierarchical pathfinding for monster AI
+ *
+ * See Pathfinder.hpp for the search modes and movement rules.
+ */
+
+#include "Pathfinder.hpp"
+
+#include "../Shared/HashIndex.hpp"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define NO_NODE 0xFFFFFFFF
+#define NO_ENTRY 0xFFFFFFFF
+#define NO_DIR 0xFF
+#define START_PARENT 0xFFFFFFFE
+
+// Cluster openings at least this wide get a node at each end instead of one in the middle
+#define LONG_OPENING 6
+
+#define FLOW_BUCKETS 16 // > PATH_COST_DIAGONAL, so one lap never wraps onto itself
+
+// E, SE, S, SW, W, NW, N, NE: odd directions are diagonal, (d + 4) & 7 is the reverse
+static const int s_dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const int s_dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+typedef struct Rect
+{
+    DWORD x0, y0, x1, y1; // Exclusive x1/y1
+} Rect;
+
+typedef struct GraphEdge
+{
+    DWORD to;
+    DWORD cost;
+} GraphEdge;
+
+typedef struct RawEdge
+{
+    DWORD from;
+    DWORD to;
+    DWORD cost;
+} RawEdge;
+
+// Cluster graph for one collision mask. Edges and cluster membership are CSR arrays.
+typedef struct AbstractGraph
+{
+    WORD mask;
+    std::vector<DWORD> nodeCell;
+    std::vector<DWORD> nodeCluster;
+    std::vector<DWORD> edgeFirst; // nodeCount + 1
+    std::vector<GraphEdge> edges;
+    std::vector<DWORD> clusterFirst; // clusterCount + 1
+    std::vector<DWORD> clusterNodes;
+
+    // Search scratch; index nodeCount is the goal
+    std::vector<DWORD> g;
+    std::vector<DWORD> parent;
+    std::vector<DWORD> stamp;
+    DWORD searchStamp;
+} AbstractGraph;
+
+typedef struct PathCacheEntry
+{
+    DWORD hash;
+    DWORD start;
+    DWORD goal;
+    WORD mask;
+    DWORD prev; // LRU links, most recent at the head
+    DWORD next;
+    PathResult result;
+} PathCacheEntry;
+
+struct Pathfinder
+{
+    DWORD width;
+    DWORD height;
+    DWORD clusterSize;
+    DWORD clustersX;
+    DWORD clustersY;
+    WORD *pCollision;
+    DWORD epoch; // Bumped by every collision edit
+
+    // Cell search scratch
+    DWORD *pG;
+    DWORD *pStamp;
+    BYTE *pFrom; // Direction of the step into the cell
+    DWORD searchStamp;
+    std::vector<uint64_t> heap; // f << 32 | cell, min-heap
+    std::vector<DWORD> path;    // Cells of the current result, start excluded
+    std::vector<DWORD> trace;
+
+    AbstractGraph *pGraphs[PATH_MAX_MASKS];
+    DWORD nextGraph; // Replacement slot once every mask slot is used
+
+    // Goal side of the last abstract search; a pack chasing one target shares it
+    DWORD goalCell;
+    WORD goalMask;
+    DWORD goalBuilds; // stats.graphBuilds when computed
+    std::vector<GraphEdge> goalEdges;
+
+    PathCacheEntry *pEntries;
+    HashIndex slots; // Key hash -> entry index
+    DWORD cacheCapacity;
+    DWORD cacheCount;
+    DWORD lruHead;
+    DWORD lruTail;
+
+    PathfinderStats stats;
+};
+
+struct FlowField
+{
+    DWORD radius;
+    DWORD side;
+    BOOL valid;
+    DWORD goalX;
+    DWORD goalY;
+    WORD mask;
+    DWORD epoch;
+    Rect rect;
+    DWORD *pDist;
+    BYTE *pDir; // Step toward the goal
+    std::vector<DWORD> buckets[FLOW_BUCKETS];
+};
+
+// =============================================================================
+// CELLS
+// =============================================================================
+
+static inline BOOL Walkable(const Pathfinder *pPathfinder, int x, int y, WORD mask)
+{
+    return x >= 0 && y >= 0 && x < (int)pPathfinder->width && y < (int)pPathfinder->height &&
+           !(pPathfinder->pCollision[(DWORD)y * pPathfinder->width + x] & mask);
+}
+
+// Step from (x, y) in direction dir, staying inside the rect and not cutting corners
+static inline BOOL CanStep(const Pathfinder *pPathfinder, int x, int y, DWORD dir, WORD mask, const Rect *pRect)
+{
+    int nx = x + s_dx[dir], ny = y + s_dy[dir];
+    if (nx < (int)pRect->x0 || ny < (int)pRect->y0 || nx >= (int)pRect->x1 || ny >= (int)pRect->y1)
+    {
+        return FALSE;
+    }
+    if (!Walkable(pPathfinder, nx, ny, mask))
+    {
+        return FALSE;
+    }
+    return !(dir & 1) || (Walkable(pPathfinder, nx, y, mask) && Walkable(pPathfinder, x, ny, mask));
+}
+
+static inline DWORD Octile(DWORD ax, DWORD ay, DWORD bx, DWORD by)
+{
+    DWORD dx = (ax > bx) ? ax - bx : bx - ax;
+    DWORD dy = (ay > by) ? ay - by : by - ay;
+    return (dx > dy) ? dx * PATH_COST_STRAIGHT + dy * (PATH_COST_DIAGONAL - PATH_COST_STRAIGHT)
+                     : dy * PATH_COST_STRAIGHT + dx * (PATH_COST_DIAGONAL - PATH_COST_STRAIGHT);
+}
+
+static DWORD ClusterOf(const Pathfinder *pPathfinder, DWORD cell)
+{
+    DWORD x = cell % pPathfinder->width, y = cell / pPathfinder->width;
+    return (y / pPathfinder->clusterSize) * pPathfinder->clustersX + x / pPathfinder->clusterSize;
+}
+
+static Rect ClusterRect(const Pathfinder *pPathfinder, DWORD cluster)
+{
+    Rect rect;
+    rect.x0 = (cluster % pPathfinder->clustersX) * pPathfinder->clusterSize;
+    rect.y0 = (cluster / pPathfinder->clustersX) * pPathfinder->clusterSize;
+    rect.x1 = std::min(rect.x0 + pPathfinder->clusterSize, pPathfinder->width);
+    rect.y1 = std::min(rect.y0 + pPathfinder->clusterSize, pPathfinder->height);
+    return rect;
+}
+
+static void HeapPush(std::vector<uint64_t> &heap, DWORD f, DWORD id)
+{
+    heap.push_back(((uint64_t)f << 32) | id);
+    std::push_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+}
+
+static uint64_t HeapPop(std::vector<uint64_t> &heap)
+{
+    std::pop_heap(heap.begin(), heap.end(), std::greater<uint64_t>());
+    uint64_t key = heap.back();
+    heap.pop_back();
+    return key;
+}
+
+/*
+ * A* from start to goal inside the rect, or Dijkstra over the whole rect
+ * when goal is NO_NODE. Results stay in pG/pStamp/pFrom until the next
+ * search.
+ */
+static BOOL CellSearch(Pathfinder *pPathfinder, DWORD start, DWORD goal, const Rect *pRect, WORD mask)
+{
+    if (++pPathfinder->searchStamp == 0)
+    {
+        memset(pPathfinder->pStamp, 0, (size_t)pPathfinder->width * pPathfinder->height * sizeof(DWORD));
+        pPathfinder->searchStamp = 1;
+    }
+    DWORD stamp = pPathfinder->searchStamp;
+    DWORD width = pPathfinder->width;
+    DWORD goalX = (goal != NO_NODE) ? goal % width : 0, goalY = (goal != NO_NODE) ? goal / width : 0;
+    std::vector<uint64_t> &heap = pPathfinder->heap;
+
+    heap.clear();
+    pPathfinder->pG[start] = 0;
+    pPathfinder->pStamp[start] = stamp;
+    pPathfinder->pFrom[start] = NO_DIR;
+    HeapPush(heap, (goal != NO_NODE) ? Octile(start % width, start / width, goalX, goalY) : 0, start);
+
+    while (!heap.empty())
+    {
+        uint64_t key = HeapPop(heap);
+        DWORD cell = (DWORD)key;
+        DWORD x = cell % width, y = cell / width;
+        DWORD g = pPathfinder->pG[cell];
+        DWORD h = (goal != NO_NODE) ? Octile(x, y, goalX, goalY) : 0;
+        if ((DWORD)(key >> 32) != g + h)
+        {
+            continue; // Superseded by a cheaper push
+        }
+        pPathfinder->stats.cellsExpanded++;
+        if (cell == goal)
+        {
+            return TRUE;
+        }
+
+        for (DWORD dir = 0; dir < 8; dir++)
+        {
+            if (!CanStep(pPathfinder, (int)x, (int)y, dir, mask, pRect))
+            {
+                continue;
+            }
+            DWORD next = cell + s_dy[dir] * (int)width + s_dx[dir];
+            DWORD ng = g + ((dir & 1) ? PATH_COST_DIAGONAL : PATH_COST_STRAIGHT);
+            if (pPathfinder->pStamp[next] != stamp || ng < pPathfinder->pG[next])
+            {
+                pPathfinder->pStamp[next] = stamp;
+                pPathfinder->pG[next] = ng;
+                pPathfinder->pFrom[next] = (BYTE)dir;
+                DWORD nh = (goal != NO_NODE) ? Octile(next % width, next / width, goalX, goalY) : 0;
+                HeapPush(heap, ng + nh, next);
+            }
+        }
+    }
+    return goal == NO_NODE;
+}
+
+static BOOL Reached(const Pathfinder *pPathfinder, DWORD cell)
+{
+    return pPathfinder->pStamp[cell] == pPathfinder->searchStamp;
+}
+
+// Append the last search's path start -> goal (start excluded) to pPathfinder->path
+static void AppendTrace(Pathfinder *pPathfinder, DWORD start, DWORD goal)
+{
+    std::vector<DWORD> &trace = pPathfinder->trace;
+    trace.clear();
+    for (DWORD cell = goal; cell != start;)
+    {
+        trace.push_back(cell);
+        DWORD dir = pPathfinder->pFrom[cell];
+        cell = cell - s_dy[dir] * (int)pPathfinder->width - s_dx[dir];
+    }
+    pPathfinder->path.insert(pPathfinder->path.end(), trace.rbegin(), trace.rend());
+}
+
+// =============================================================================
+// ABSTRACT GRAPH
+// =============================================================================
+
+static DWORD AddNode(AbstractGraph *pGraph, std::vector<DWORD> &nodeAt, const Pathfinder *pPathfinder, DWORD cell)
+{
+    if (nodeAt[cell] == NO_NODE)
+    {
+        nodeAt[cell] = (DWORD)pGraph->nodeCell.size();
+        pGraph->nodeCell.push_back(cell);
+        pGraph->nodeCluster.push_back(ClusterOf(pPathfinder, cell));
+    }
+    return nodeAt[cell];
+}
+
+static void AddTransition(AbstractGraph *pGraph, std::vector<DWORD> &nodeAt, std::vector<RawEdge> &raw,
+                          const Pathfinder *pPathfinder, DWORD cellA, DWORD cellB)
+{
+    DWORD a = AddNode(pGraph, nodeAt, pPathfinder, cellA);
+    DWORD b = AddNode(pGraph, nodeAt, pPathfinder, cellB);
+    RawEdge ab = {a, b, PATH_COST_STRAIGHT}, ba = {b, a, PATH_COST_STRAIGHT};
+    raw.push_back(ab);
+    raw.push_back(ba);
+}
+
+/*
+ * Walk one shared border between two clusters. Cell i on side A is
+ * firstA + i * along and faces firstA + i * along + across on side B.
+ */
+static void ScanBorder(AbstractGraph *pGraph, std::vector<DWORD> &nodeAt, std::vector<RawEdge> &raw,
+                       const Pathfinder *pPathfinder, DWORD firstA, DWORD along, DWORD across, DWORD length)
+{
+    DWORD runStart = 0;
+    BOOL inRun = FALSE;
+    for (DWORD i = 0; i <= length; i++)
+    {
+        BOOL open = FALSE;
+        if (i < length)
+        {
+            DWORD cell = firstA + i * along;
+            open = !(pPathfinder->pCollision[cell] & pGraph->mask) &&
+                   !(pPathfinder->pCollision[cell + across] & pGraph->mask);
+        }
+        if (open && !inRun)
+        {
+            runStart = i;
+            inRun = TRUE;
+        }
+        else if (!open && inRun)
+        {
+            DWORD runEnd = i - 1;
+            if (runEnd - runStart + 1 >= LONG_OPENING)
+            {
+                AddTransition(pGraph, nodeAt, raw, pPathfinder, firstA + runStart * along,
+                              firstA + runStart * along + across);
+                AddTransition(pGraph, nodeAt, raw, pPathfinder, firstA + runEnd * along,
+                              firstA + runEnd * along + across);
+            }
+            else
+            {
+                DWORD mid = (runStart + runEnd) / 2;
+                AddTransition(pGraph, nodeAt, raw, pPathfinder, firstA + mid * along, firstA + mid * along + across);
+            }
+            inRun = FALSE;
+        }
+    }
+}
+
+static bool RawEdgeLess(const RawEdge &a, const RawEdge &b)
+{
+    return a.from != b.from ? a.from < b.from : a.to < b.to;
+}
+
+static AbstractGraph *BuildGraph(Pathfinder *pPathfinder, WORD mask)
+{
+    AbstractGraph *pGraph = new AbstractGraph();
+    pGraph->mask = mask;
+    pGraph->searchStamp = 0;
+
+    DWORD width = pPathfinder->width, cs = pPathfinder->clusterSize;
+    DWORD clusterCount = pPathfinder->clustersX * pPathfinder->clustersY;
+    std::vector<DWORD> nodeAt((size_t)width * pPathfinder->height, NO_NODE);
+    std::vector<RawEdge> raw;
+
+    // Openings across each vertical and horizontal cluster border
+    for (DWORD cy = 0; cy < pPathfinder->clustersY; cy++)
+    {
+        DWORD y0 = cy * cs, rows = std::min(cs, pPathfinder->height - y0);
+        for (DWORD cx = 0; cx + 1 < pPathfinder->clustersX; cx++)
+        {
+            DWORD x = (cx + 1) * cs - 1;
+            ScanBorder(pGraph, nodeAt, raw, pPathfinder, y0 * width + x, width, 1, rows);
+        }
+    }
+    for (DWORD cy = 0; cy + 1 < pPathfinder->clustersY; cy++)
+    {
+        DWORD y = (cy + 1) * cs - 1;
+        for (DWORD cx = 0; cx < pPathfinder->clustersX; cx++)
+        {
+            DWORD x0 = cx * cs, columns = std::min(cs, width - x0);
+            ScanBorder(pGraph, nodeAt, raw, pPathfinder, y * width + x0, 1, width, columns);
+        }
+    }
+
+    // Cluster -> nodes
+    DWORD nodeCount = (DWORD)pGraph->nodeCell.size();
+    pGraph->clusterFirst.assign(clusterCount + 1, 0);
+    for (DWORD n = 0; n < nodeCount; n++)
+    {
+        pGraph->clusterFirst[pGraph->nodeCluster[n] + 1]++;
+    }
+    for (DWORD c = 0; c < clusterCount; c++)
+    {
+        pGraph->clusterFirst[c + 1] += pGraph->clusterFirst[c];
+    }
+    pGraph->clusterNodes.resize(nodeCount);
+    std::vector<DWORD> fill(pGraph->clusterFirst.begin(), pGraph->clusterFirst.end() - 1);
+    for (DWORD n = 0; n < nodeCount; n++)
+    {
+        pGraph->clusterNodes[fill[pGraph->nodeCluster[n]]++] = n;
+    }
+
+    // Intra-cluster costs: one Dijkstra per node, confined to its cluster
+    for (DWORD c = 0; c < clusterCount; c++)
+    {
+        Rect rect = ClusterRect(pPathfinder, c);
+        for (DWORD i = pGraph->clusterFirst[c]; i < pGraph->clusterFirst[c + 1]; i++)
+        {
+            DWORD from = pGraph->clusterNodes[i];
+            CellSearch(pPathfinder, pGraph->nodeCell[from], NO_NODE, &rect, mask);
+            for (DWORD j = pGraph->clusterFirst[c]; j < pGraph->clusterFirst[c + 1]; j++)
+            {
+                DWORD to = pGraph->clusterNodes[j];
+                DWORD cell = pGraph->nodeCell[to];
+                if (to != from && Reached(pPathfinder, cell))
+                {
+                    RawEdge edge = {from, to, pPathfinder->pG[cell]};
+                    raw.push_back(edge);
+                }
+            }
+        }
+    }
+
+    std::sort(raw.begin(), raw.end(), RawEdgeLess);
+    pGraph->edgeFirst.assign(nodeCount + 1, 0);
+    pGraph->edges.resize(raw.size());
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+        pGraph->edgeFirst[raw[i].from + 1]++;
+        pGraph->edges[i].to = raw[i].to;
+        pGraph->edges[i].cost = raw[i].cost;
+    }
+    for (DWORD n = 0; n < nodeCount; n++)
+    {
+        pGraph->edgeFirst[n + 1] += pGraph->edgeFirst[n];
+    }
+
+    pGraph->g.assign(nodeCount + 1, 0);
+    pGraph->parent.assign(nodeCount + 1, NO_NODE);
+    pGraph->stamp.assign(nodeCount + 1, 0);
+
+    pPathfinder->stats.graphBuilds++;
+    pPathfinder->stats.graphNodes += nodeCount;
+    return pGraph;
+}
+
+static void FreeGraphs(Pathfinder *pPathfinder)
+{
+    for (DWORD i = 0; i < PATH_MAX_MASKS; i++)
+    {
+        delete pPathfinder->pGraphs[i];
+        pPathfinder->pGraphs[i] = NULL;
+    }
+    pPathfinder->nextGraph = 0;
+    pPathfinder->stats.graphNodes = 0;
+}
+
+static AbstractGraph *GetGraph(Pathfinder *pPathfinder, WORD mask)
+{
+    for (DWORD i = 0; i < PATH_MAX_MASKS; i++)
+    {
+        if (pPathfinder->pGraphs[i] && pPathfinder->pGraphs[i]->mask == mask)
+        {
+            return pPathfinder->pGraphs[i];
+        }
+    }
+
+    DWORD slot = pPathfinder->nextGraph;
+    pPathfinder->nextGraph = (slot + 1) % PATH_MAX_MASKS;
+    if (pPathfinder->pGraphs[slot])
+    {
+        pPathfinder->stats.graphNodes -= (DWORD)pPathfinder->pGraphs[slot]->nodeCell.size();
+        delete pPathfinder->pGraphs[slot];
+    }
+    pPathfinder->pGraphs[slot] = BuildGraph(pPathfinder, mask);
+    return pPathfinder->pGraphs[slot];
+}
+
+/*
+ * Connect start and goal to their clusters' nodes, search the graph, then
+ * refine each hop with a cell search inside one cluster.
+ */
+static BOOL AbstractSearch(Pathfinder *pPathfinder, AbstractGraph *pGraph, DWORD start, DWORD goal, WORD mask)
+{
+    DWORD width = pPathfinder->width;
+    DWORD startCluster = ClusterOf(pPathfinder, start), goalCluster = ClusterOf(pPathfinder, goal);
+    Rect startRect = ClusterRect(pPathfinder, startCluster), goalRect = ClusterRect(pPathfinder, goalCluster);
+    DWORD goalX = goal % width, goalY = goal / width;
+    DWORD goalIndex = (DWORD)pGraph->nodeCell.size();
+    std::vector<uint64_t> &heap = pPathfinder->heap;
+
+    // Goal side first: its costs are kept in a small list while the start side reuses the scratch
+    std::vector<GraphEdge> &goalEdges = pPathfinder->goalEdges;
+    if (pPathfinder->goalCell != goal || pPathfinder->goalMask != mask ||
+        pPathfinder->goalBuilds != pPathfinder->stats.graphBuilds)
+    {
+        goalEdges.clear();
+        CellSearch(pPathfinder, goal, NO_NODE, &goalRect, mask);
+        for (DWORD i = pGraph->clusterFirst[goalCluster]; i < pGraph->clusterFirst[goalCluster + 1]; i++)
+        {
+            DWORD node = pGraph->clusterNodes[i];
+            if (Reached(pPathfinder, pGraph->nodeCell[node]))
+            {
+                GraphEdge edge = {node, pPathfinder->pG[pGraph->nodeCell[node]]};
+                goalEdges.push_back(edge);
+            }
+        }
+        pPathfinder->goalCell = goal;
+        pPathfinder->goalMask = mask;
+        pPathfinder->goalBuilds = pPathfinder->stats.graphBuilds;
+    }
+    if (goalEdges.empty())
+    {
+        return FALSE;
+    }
+
+    if (++pGraph->searchStamp == 0)
+    {
+        std::fill(pGraph->stamp.begin(), pGraph->stamp.end(), 0);
+        pGraph->searchStamp = 1;
+    }
+    DWORD stamp = pGraph->searchStamp;
+    heap.clear();
+
+    CellSearch(pPathfinder, start, NO_NODE, &startRect, mask);
+    for (DWORD i = pGraph->clusterFirst[startCluster]; i < pGraph->clusterFirst[startCluster + 1]; i++)
+    {
+        DWORD node = pGraph->clusterNodes[i];
+        DWORD cell = pGraph->nodeCell[node];
+        if (Reached(pPathfinder, cell))
+        {
+            pGraph->g[node] = pPathfinder->pG[cell];
+            pGraph->parent[node] = START_PARENT;
+            pGraph->stamp[node] = stamp;
+            HeapPush(heap, pGraph->g[node] + Octile(cell % width, cell / width, goalX, goalY), node);
+        }
+    }
+
+    BOOL found = FALSE;
+    while (!heap.empty())
+    {
+        uint64_t key = HeapPop(heap);
+        DWORD node = (DWORD)key;
+        DWORD g = pGraph->g[node];
+        if (node == goalIndex)
+        {
+            found = TRUE;
+            break;
+        }
+        DWORD cell = pGraph->nodeCell[node];
+        if ((DWORD)(key >> 32) != g + Octile(cell % width, cell / width, goalX, goalY))
+        {
+            continue;
+        }
+        pPathfinder->stats.nodesExpanded++;
+
+        for (DWORD e = pGraph->edgeFirst[node]; e < pGraph->edgeFirst[node + 1]; e++)
+        {
+            const GraphEdge *pEdge = &pGraph->edges[e];
+            DWORD ng = g + pEdge->cost;
+            if (pGraph->stamp[pEdge->to] != stamp || ng < pGraph->g[pEdge->to])
+            {
+                DWORD next = pGraph->nodeCell[pEdge->to];
+                pGraph->stamp[pEdge->to] = stamp;
+                pGraph->g[pEdge->to] = ng;
+                pGraph->parent[pEdge->to] = node;
+                HeapPush(heap, ng + Octile(next % width, next / width, goalX, goalY), pEdge->to);
+            }
+        }
+        if (pGraph->nodeCluster[node] == goalCluster)
+        {
+            for (size_t i = 0; i < goalEdges.size(); i++)
+            {
+                DWORD ng = g + goalEdges[i].cost;
+                if (goalEdges[i].to == node && (pGraph->stamp[goalIndex] != stamp || ng < pGraph->g[goalIndex]))
+                {
+                    pGraph->stamp[goalIndex] = stamp;
+                    pGraph->g[goalIndex] = ng;
+                    pGraph->parent[goalIndex] = node;
+                    HeapPush(heap, ng, goalIndex);
+                }
+            }
+        }
+    }
+    if (!found)
+    {
+        return FALSE;
+    }
+
+    // Hops back to front, then refine front to back
+    std::vector<DWORD> hops;
+    for (DWORD node = pGraph->parent[goalIndex]; node != START_PARENT; node = pGraph->parent[node])
+    {
+        hops.push_back(pGraph->nodeCell[node]);
+    }
+    DWORD current = start;
+    for (size_t i = hops.size() + 1; i-- > 0;)
+    {
+        DWORD target = i ? hops[i - 1] : goal;
+        if (target == current)
+        {
+            continue;
+        }
+        DWORD cluster = ClusterOf(pPathfinder, current);
+        if (cluster != ClusterOf(pPathfinder, target))
+        {
+            pPathfinder->path.push_back(target); // Border crossing: adjacent cells
+        }
+        else
+        {
+            Rect rect = ClusterRect(pPathfinder, cluster);
+            CellSearch(pPathfinder, current, target, &rect, mask);
+            AppendTrace(pPathfinder, current, target);
+        }
+        current = target;
+    }
+    return TRUE;
+}
+
+// =============================================================================
+// PATH CACHE
+// =============================================================================
+
+static DWORD CacheHash(DWORD start, DWORD goal, WORD mask)
+{
+    return D2_HashDword(start ^ D2_HashDword(goal ^ ((DWORD)mask << 21)));
+}
+
+static void CacheFlush(Pathfinder *pPathfinder)
+{
+    if (pPathfinder->slots.pValues)
+    {
+        HASHINDEX_Clear(&pPathfinder->slots);
+    }
+    pPathfinder->cacheCount = 0;
+    pPathfinder->lruHead = NO_ENTRY;
+    pPathfinder->lruTail = NO_ENTRY;
+}
+
+static void LruUnlink(Pathfinder *pPathfinder, DWORD index)
+{
+    PathCacheEntry *pEntry = &pPathfinder->pEntries[index];
+    if (pEntry->prev != NO_ENTRY)
+        pPathfinder->pEntries[pEntry->prev].next = pEntry->next;
+    else
+        pPathfinder->lruHead = pEntry->next;
+    if (pEntry->next != NO_ENTRY)
+        pPathfinder->pEntries[pEntry->next].prev = pEntry->prev;
+    else
+        pPathfinder->lruTail = pEntry->prev;
+}
+
+static void LruPushFront(Pathfinder *pPathfinder, DWORD index)
+{
+    PathCacheEntry *pEntry = &pPathfinder->pEntries[index];
+    pEntry->prev = NO_ENTRY;
+    pEntry->next = pPathfinder->lruHead;
+    if (pPathfinder->lruHead != NO_ENTRY)
+        pPathfinder->pEntries[pPathfinder->lruHead].prev = index;
+    else
+        pPathfinder->lruTail = index;
+    pPathfinder->lruHead = index;
+}
+
+static DWORD CacheFindSlot(const Pathfinder *pPathfinder, DWORD hash, DWORD start, DWORD goal, WORD mask)
+{
+    const HashIndex *pSlots = &pPathfinder->slots;
+    for (DWORD slot = HASHINDEX_Find(pSlots, hash); slot != HASHINDEX_NONE; slot = HASHINDEX_Next(pSlots, hash, slot))
+    {
+        const PathCacheEntry *pEntry = &pPathfinder->pEntries[pSlots->pValues[slot]];
+        if (pEntry->start == start && pEntry->goal == goal && pEntry->mask == mask)
+        {
+            return slot;
+        }
+    }
+    return NO_ENTRY;
+}
+
+static void CacheInsert(Pathfinder *pPathfinder, DWORD start, DWORD goal, WORD mask, const PathResult *pResult)
+{
+    if (!pPathfinder->cacheCapacity)
+    {
+        return;
+    }
+
+    DWORD index;
+    if (pPathfinder->cacheCount < pPathfinder->cacheCapacity)
+    {
+        index = pPathfinder->cacheCount++;
+    }
+    else
+    {
+        index = pPathfinder->lruTail;
+        const PathCacheEntry *pOld = &pPathfinder->pEntries[index];
+        DWORD slot = CacheFindSlot(pPathfinder, pOld->hash, pOld->start, pOld->goal, pOld->mask);
+        HASHINDEX_Erase(&pPathfinder->slots, slot);
+        LruUnlink(pPathfinder, index);
+    }
+
+    PathCacheEntry *pEntry = &pPathfinder->pEntries[index];
+    pEntry->hash = CacheHash(start, goal, mask);
+    pEntry->start = start;
+    pEntry->goal = goal;
+    pEntry->mask = mask;
+    pEntry->result = *pResult;
+    LruPushFront(pPathfinder, index);
+    HASHINDEX_Insert(&pPathfinder->slots, pEntry->hash, index);
+}
+
+// =============================================================================
+// PATHFINDER
+// =============================================================================
+
+Pathfinder *__cdecl PATHFIND_Create(const PathfinderDesc *pDesc)
+{
+    if (!pDesc || !pDesc->width || !pDesc->height || pDesc->width > 0xFFFF || pDesc->height > 0xFFFF ||
+        !pDesc->pCollision)
+    {
+        return NULL;
+    }
+
+    Pathfinder *pPathfinder = new Pathfinder();
+    size_t cells = (size_t)pDesc->width * pDesc->height;
+    pPathfinder->width = pDesc->width;
+    pPathfinder->height = pDesc->height;
+    pPathfinder->clusterSize = pDesc->clusterSize ? pDesc->clusterSize : 40;
+    pPathfinder->clustersX = (pDesc->width + pPathfinder->clusterSize - 1) / pPathfinder->clusterSize;
+    pPathfinder->clustersY = (pDesc->height + pPathfinder->clusterSize - 1) / pPathfinder->clusterSize;
+    pPathfinder->epoch = 0;
+    pPathfinder->searchStamp = 0;
+    pPathfinder->nextGraph = 0;
+    pPathfinder->goalCell = NO_NODE;
+    memset(pPathfinder->pGraphs, 0, sizeof(pPathfinder->pGraphs));
+    memset(&pPathfinder->stats, 0, sizeof(pPathfinder->stats));
+
+    pPathfinder->pCollision = (WORD *)malloc(cells * sizeof(WORD));
+    pPathfinder->pG = (DWORD *)malloc(cells * sizeof(DWORD));
+    pPathfinder->pStamp = (DWORD *)calloc(cells, sizeof(DWORD));
+    pPathfinder->pFrom = (BYTE *)malloc(cells);
+
+    pPathfinder->cacheCapacity = pDesc->cacheEntries ? pDesc->cacheEntries : 1024;
+    pPathfinder->pEntries = (PathCacheEntry *)malloc(pPathfinder->cacheCapacity * sizeof(PathCacheEntry));
+
+    if (!pPathfinder->pCollision || !pPathfinder->pG || !pPathfinder->pStamp || !pPathfinder->pFrom ||
+        !pPathfinder->pEntries || !HASHINDEX_Init(&pPathfinder->slots, pPathfinder->cacheCapacity))
+    {
+        PATHFIND_Destroy(pPathfinder);
+        return NULL;
+    }
+    memcpy(pPathfinder->pCollision, pDesc->pCollision, cells * sizeof(WORD));
+    CacheFlush(pPathfinder);
+    return pPathfinder;
+}
+
+void __cdecl PATHFIND_Destroy(Pathfinder *pPathfinder)
+{
+    if (!pPathfinder)
+    {
+        return;
+    }
+    FreeGraphs(pPathfinder);
+    free(pPathfinder->pCollision);
+    free(pPathfinder->pG);
+    free(pPathfinder->pStamp);
+    free(pPathfinder->pFrom);
+    free(pPathfinder->pEntries);
+    HASHINDEX_Free(&pPathfinder->slots);
+    delete pPathfinder;
+}
+
+WORD __cdecl PATHFIND_GetCollision(const Pathfinder *pPathfinder, DWORD x, DWORD y)
+{
+    if (x >= pPathfinder->width || y >= pPathfinder->height)
+    {
+        return 0xFFFF;
+    }
+    return pPathfinder->pCollision[y * pPathfinder->width + x];
+}
+
+void __cdecl PATHFIND_SetCollision(Pathfinder *pPathfinder, DWORD x, DWORD y, WORD collision)
+{
+    if (x >= pPathfinder->width || y >= pPathfinder->height ||
+        pPathfinder->pCollision[y * pPathfinder->width + x] == collision)
+    {
+        return;
+    }
+    pPathfinder->pCollision[y * pPathfinder->width + x] = collision;
+    pPathfinder->epoch++;
+    pPathfinder->goalCell = NO_NODE;
+    FreeGraphs(pPathfinder);
+    CacheFlush(pPathfinder);
+}
+
+// Collapse the cell path into corner points
+static void BuildResult(const Pathfinder *pPathfinder, DWORD start, PathResult *pResult)
+{
+    const std::vector<DWORD> &path = pPathfinder->path;
+    DWORD width = pPathfinder->width;
+    int prevX = (int)(start % width), prevY = (int)(start / width);
+
+    pResult->cost = 0;
+    pResult->pointCount = 0;
+    pResult->partial = FALSE;
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        int x = (int)(path[i] % width), y = (int)(path[i] / width);
+        pResult->cost += (x != prevX && y != prevY) ? PATH_COST_DIAGONAL : PATH_COST_STRAIGHT;
+
+        BOOL corner = (i + 1 == path.size());
+        if (!corner)
+        {
+            int nx = (int)(path[i + 1] % width), ny = (int)(path[i + 1] / width);
+            corner = (nx - x != x - prevX) || (ny - y != y - prevY);
+        }
+        if (corner)
+        {
+            if (pResult->pointCount < PATH_MAX_POINTS)
+            {
+                pResult->points[pResult->pointCount].x = (WORD)x;
+                pResult->points[pResult->pointCount].y = (WORD)y;
+                pResult->pointCount++;
+            }
+            else
+            {
+                pResult->partial = TRUE;
+            }
+        }
+        prevX = x;
+        prevY = y;
+    }
+}
+
+BOOL __cdecl PATHFIND_FindPath(Pathfinder *pPathfinder, DWORD startX, DWORD startY, DWORD goalX, DWORD goalY,
+                               WORD mask, PathResult *pResult)
+{
+    pPathfinder->stats.queries++;
+    if (!Walkable(pPathfinder, (int)startX, (int)startY, mask) || !Walkable(pPathfinder, (int)goalX, (int)goalY, mask))
+    {
+        return FALSE;
+    }
+
+    DWORD start = startY * pPathfinder->width + startX, goal = goalY * pPathfinder->width + goalX;
+    if (start == goal)
+    {
+        pResult->cost = 0;
+        pResult->pointCount = 0;
+        pResult->partial = FALSE;
+        return TRUE;
+    }
+
+    DWORD hash = CacheHash(start, goal, mask);
+    DWORD slot = CacheFindSlot(pPathfinder, hash, start, goal, mask);
+    if (slot != NO_ENTRY)
+    {
+        DWORD index = pPathfinder->slots.pValues[slot];
+        *pResult = pPathfinder->pEntries[index].result;
+        LruUnlink(pPathfinder, index);
+        LruPushFront(pPathfinder, index);
+        pPathfinder->stats.cacheHits++;
+        return TRUE;
+    }
+
+    // Same cluster: a confined search usually suffices; otherwise the path leaves the cluster
+    pPathfinder->path.clear();
+    BOOL found = FALSE;
+    DWORD cluster = ClusterOf(pPathfinder, start);
+    if (cluster == ClusterOf(pPathfinder, goal))
+    {
+        Rect rect = ClusterRect(pPathfinder, cluster);
+        if (CellSearch(pPathfinder, start, goal, &rect, mask))
+        {
+            AppendTrace(pPathfinder, start, goal);
+            pPathfinder->stats.localSearches++;
+            found = TRUE;
+        }
+    }
+    if (!found)
+    {
+        pPathfinder->stats.abstractSearches++;
+        found = AbstractSearch(pPathfinder, GetGraph(pPathfinder, mask), start, goal, mask);
+    }
+    if (!found)
+    {
+        return FALSE;
+    }
+
+    BuildResult(pPathfinder, start, pResult);
+    CacheInsert(pPathfinder, start, goal, mask, pResult);
+    return TRUE;
+}
+
+// =============================================================================
+// FLOW FIELDS
+// =============================================================================
+
+FlowField *__cdecl PATHFIND_CreateFlowField(Pathfinder *pPathfinder, DWORD radius)
+{
+    (void)pPathfinder;
+    if (!radius || radius > 0x7FFF)
+    {
+        return NULL;
+    }
+
+    FlowField *pField = new FlowField();
+    pField->radius = radius;
+    pField->side = radius * 2 + 1;
+    pField->valid = FALSE;
+    pField->pDist = (DWORD *)malloc((size_t)pField->side * pField->side * sizeof(DWORD));
+    pField->pDir = (BYTE *)malloc((size_t)pField->side * pField->side);
+    if (!pField->pDist || !pField->pDir)
+    {
+        PATHFIND_DestroyFlowField(pField);
+        return NULL;
+    }
+    return pField;
+}
+
+void __cdecl PATHFIND_DestroyFlowField(FlowField *pField)
+{
+    if (!pField)
+    {
+        return;
+    }
+    free(pField->pDist);
+    free(pField->pDir);
+    delete pField;
+}
+
+BOOL __cdecl PATHFIND_UpdateFlowField(Pathfinder *pPathfinder, FlowField *pField, DWORD goalX, DWORD goalY,
+                                      WORD mask)
+{
+    if (pField->valid && pField->goalX == goalX && pField->goalY == goalY && pField->mask == mask &&
+        pField->epoch == pPathfinder->epoch)
+    {
+        return FALSE;
+    }
+
+    pField->valid = TRUE;
+    pField->goalX = goalX;
+    pField->goalY = goalY;
+    pField->mask = mask;
+    pField->epoch = pPathfinder->epoch;
+    pField->rect.x0 = (goalX > pField->radius) ? goalX - pField->radius : 0;
+    pField->rect.y0 = (goalY > pField->radius) ? goalY - pField->radius : 0;
+    pField->rect.x1 = std::min(goalX + pField->radius + 1, pPathfinder->width);
+    pField->rect.y1 = std::min(goalY + pField->radius + 1, pPathfinder->height);
+    memset(pField->pDist, 0xFF, (size_t)pField->side * pField->side * sizeof(DWORD));
+    memset(pField->pDir, NO_DIR, (size_t)pField->side * pField->side);
+    pPathfinder->stats.flowBuilds++;
+
+    if (!Walkable(pPathfinder, (int)goalX, (int)goalY, mask))
+    {
+        return TRUE;
+    }
+
+    // Dial's algorithm: edge costs are 10 or 14, so a ring of buckets replaces the heap
+    const Rect *pRect = &pField->rect;
+    DWORD side = pField->side;
+    for (DWORD i = 0; i < FLOW_BUCKETS; i++)
+    {
+        pField->buckets[i].clear();
+    }
+    pField->pDist[(goalY - pRect->y0) * side + (goalX - pRect->x0)] = 0;
+    pField->buckets[0].push_back((goalY << 16) | goalX);
+    DWORD pending = 1;
+
+    for (DWORD distance = 0; pending; distance++)
+    {
+        std::vector<DWORD> &bucket = pField->buckets[distance % FLOW_BUCKETS];
+        for (size_t i = 0; i < bucket.size(); i++)
+        {
+            DWORD x = bucket[i] & 0xFFFF, y = bucket[i] >> 16;
+            pending--;
+            if (pField->pDist[(y - pRect->y0) * side + (x - pRect->x0)] != distance)
+            {
+                continue;
+            }
+            for (DWORD dir = 0; dir < 8; dir++)
+            {
+                if (!CanStep(pPathfinder, (int)x, (int)y, dir, mask, pRect))
+                {
+                    continue;
+                }
+                DWORD nx = x + s_dx[dir], ny = y + s_dy[dir];
+                DWORD local = (ny - pRect->y0) * side + (nx - pRect->x0);
+                DWORD nd = distance + ((dir & 1) ? PATH_COST_DIAGONAL : PATH_COST_STRAIGHT);
+                if (nd < pField->pDist[local])
+                {
+                    pField->pDist[local] = nd;
+                    pField->pDir[local] = (BYTE)((dir + 4) & 7);
+                    pField->buckets[nd % FLOW_BUCKETS].push_back((ny << 16) | nx);
+                    pending++;
+                }
+            }
+        }
+        bucket.clear();
+    }
+    return TRUE;
+}
+
+BOOL __cdecl FLOWFIELD_GetStep(const FlowField *pField, DWORD x, DWORD y, DWORD *pNextX, DWORD *pNextY)
+{
+    const Rect *pRect = &pField->rect;
+    if (!pField->valid || x < pRect->x0 || y < pRect->y0 || x >= pRect->x1 || y >= pRect->y1)
+    {
+        return FALSE;
+    }
+    BYTE dir = pField->pDir[(y - pRect->y0) * pField->side + (x - pRect->x0)];
+    if (dir == NO_DIR)
+    {
+        return FALSE;
+    }
+    *pNextX = x + s_dx[dir];
+    *pNextY = y + s_dy[dir];
+    return TRUE;
+}
+
+DWORD __cdecl FLOWFIELD_GetDistance(const FlowField *pField, DWORD x, DWORD y)
+{
+    const Rect *pRect = &pField->rect;
+    if (!pField->valid || x < pRect->x0 || y < pRect->y0 || x >= pRect->x1 || y >= pRect->y1)
+    {
+        return PATH_UNREACHABLE;
+    }
+    return pField->pDist[(y - pRect->y0) * pField->side + (x - pRect->x0)];
+}
+
+void __cdecl PATHFIND_GetStats(const Pathfinder *pPathfinder, PathfinderStats *pStats)
+{
+    *pStats = pPathfinder->stats;
+}
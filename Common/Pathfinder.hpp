@@ -0,0 +1,120 @@
+/*
+ * Pathfinder.hpp - D2Common hierarchical pathfinding for monster AI
+ *
+ * Every time a monster re-targets, the game runs an A*-style search from
+ * scratch over the room collision maps (the cells ApplyUnitCollisionToRoom
+ * maintains). In a dense area hundreds of monsters repeat nearly the same
+ * long search against the same player every few frames.
+ *
+ * This pathfinder works on one level-sized collision map in subtiles:
+ *
+ *   HPA*       - the map is cut into clusters (one room, 40x40 subtiles, by
+ *                default). Openings between neighbouring clusters become
+ *                graph nodes; costs between nodes of the same cluster are
+ *                precomputed. A query searches that small graph, then
+ *                refines each hop with an A* confined to one cluster. Paths
+ *                are near-optimal, not exact.
+ *   flow field - one reverse Dijkstra from a goal over a square around it
+ *                gives every cell its next step toward the goal, so any
+ *                number of monsters chasing the same target read their move
+ *                with one lookup. Distances are exact.
+ *   path cache - recent results keyed by (start cell, goal cell, collision
+ *                mask), evicted least-recently-used. Monsters that are stuck
+ *                or waiting re-ask the same question constantly.
+ *
+ * Movement is 8-way, 10 per straight step and 14 per diagonal, and a
+ * diagonal step may not cut a blocked corner. A cell is walkable for a mask
+ * when (collision & mask) == 0. Abstract graphs are built lazily per mask
+ * (walkers and flyers use different masks); PATHFIND_SetCollision discards
+ * them and the path cache, so edits are meant for doors and rare changes.
+ *
+ * Game thread only; flow fields are owned by the caller.
+ */
+
+#ifndef PATHFINDER_HPP
+#define PATHFINDER_HPP
+
+#include "../Shared/D2Shared.hpp"
+#include "CollisionMap.hpp"
+
+#define PATH_COST_STRAIGHT 10
+#define PATH_COST_DIAGONAL 14
+#define PATH_UNREACHABLE 0xFFFFFFFF
+
+// Same capacity as D2's DynamicPath point list
+#define PATH_MAX_POINTS 78
+#define PATH_MAX_MASKS 4
+
+typedef struct PathPoint
+{
+    WORD x;
+    WORD y;
+} PathPoint;
+
+/*
+ * Corner points from the start (excluded) to the goal (included): each
+ * segment is a straight or diagonal run, so callers step toward the next
+ * point one cell at a time. partial is set when the path needed more than
+ * PATH_MAX_POINTS corners; the points lead toward the goal and the caller
+ * re-paths from the last one.
+ */
+typedef struct PathResult
+{
+    DWORD cost;
+    DWORD pointCount;
+    BOOL partial;
+    PathPoint points[PATH_MAX_POINTS];
+} PathResult;
+
+typedef struct PathfinderDesc
+{
+    DWORD width; // Subtiles
+    DWORD height;
+    const WORD *pCollision; // width * height, copied
+    DWORD clusterSize;      // 0 = 40 (one room)
+    DWORD cacheEntries;     // 0 = 1024
+} PathfinderDesc;
+
+typedef struct PathfinderStats
+{
+    uint64_t queries;
+    uint64_t cacheHits;
+    uint64_t localSearches;    // Start and goal in one cluster, solved directly
+    uint64_t abstractSearches; // Went through the cluster graph
+    uint64_t cellsExpanded;    // Cell searches (local, connect, refine)
+    uint64_t nodesExpanded;    // Abstract graph searches
+    DWORD graphBuilds;
+    DWORD graphNodes; // Current total across masks
+    DWORD flowBuilds;
+} PathfinderStats;
+
+typedef struct Pathfinder Pathfinder;
+typedef struct FlowField FlowField;
+
+Pathfinder *__cdecl PATHFIND_Create(const PathfinderDesc *pDesc);
+void __cdecl PATHFIND_Destroy(Pathfinder *pPathfinder);
+
+WORD __cdecl PATHFIND_GetCollision(const Pathfinder *pPathfinder, DWORD x, DWORD y);
+// Doors, destructibles: drops every abstract graph and cached path
+void __cdecl PATHFIND_SetCollision(Pathfinder *pPathfinder, DWORD x, DWORD y, WORD collision);
+
+// FALSE if either end is blocked or out of bounds, or no path exists
+BOOL __cdecl PATHFIND_FindPath(Pathfinder *pPathfinder, DWORD startX, DWORD startY, DWORD goalX, DWORD goalY,
+                               WORD mask, PathResult *pResult);
+
+/*
+ * Flow fields cover the square of the given radius around their goal.
+ * Update rebuilds only when the goal cell, mask or collision changed and
+ * returns TRUE when it did.
+ */
+FlowField *__cdecl PATHFIND_CreateFlowField(Pathfinder *pPathfinder, DWORD radius);
+void __cdecl PATHFIND_DestroyFlowField(FlowField *pField);
+BOOL __cdecl PATHFIND_UpdateFlowField(Pathfinder *pPathfinder, FlowField *pField, DWORD goalX, DWORD goalY,
+                                      WORD mask);
+// Next cell toward the goal; FALSE at the goal, outside the field or when cut off
+BOOL __cdecl FLOWFIELD_GetStep(const FlowField *pField, DWORD x, DWORD y, DWORD *pNextX, DWORD *pNextY);
+DWORD __cdecl FLOWFIELD_GetDistance(const FlowField *pField, DWORD x, DWORD y);
+
+void __cdecl PATHFIND_GetStats(const Pathfinder *pPathfinder, PathfinderStats *pStats);
+
+#endif // PATHFINDER_HPP
@@ -0,0 +1,324 @@
+/*
+ * PresetStore.cpp - D2Common decoded DS1 preset cache
+ *
+ * See PresetStore.hpp for the sharing model.
+ */
+
+#include "PresetStore.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+
+#define DS1_MAX_VERSION 18
+#define DS1_MAX_SIDE 1024
+#define DS1_MAX_OBJECTS 65536
+
+typedef struct PresetEntry
+{
+    std::once_flag once;
+    const Ds1Map *pMap; // Written once inside call_once
+} PresetEntry;
+
+struct PresetStore
+{
+    PresetSource source;
+    DWORD maxPresets;
+    PresetEntry *pEntries;
+
+    std::atomic<DWORD> decoded;
+    std::atomic<DWORD> failed;
+    std::atomic<DWORD> requests;
+    std::atomic<size_t> bytes;
+};
+
+// =============================================================================
+// DS1 DECODE
+// =============================================================================
+
+typedef struct Ds1Reader
+{
+    const BYTE *pData;
+    size_t size;
+    size_t pos;
+} Ds1Reader;
+
+static BOOL ReadDword(Ds1Reader *pReader, DWORD *pValue)
+{
+    if (pReader->size - pReader->pos < 4)
+    {
+        return FALSE;
+    }
+    const BYTE *p = pReader->pData + pReader->pos;
+    *pValue = (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+    pReader->pos += 4;
+    return TRUE;
+}
+
+static BOOL Skip(Ds1Reader *pReader, size_t bytes)
+{
+    if (pReader->size - pReader->pos < bytes)
+    {
+        return FALSE;
+    }
+    pReader->pos += bytes;
+    return TRUE;
+}
+
+static BOOL SkipString(Ds1Reader *pReader)
+{
+    const void *pEnd = memchr(pReader->pData + pReader->pos, 0, pReader->size - pReader->pos);
+    if (!pEnd)
+    {
+        return FALSE;
+    }
+    pReader->pos = (const BYTE *)pEnd - pReader->pData + 1;
+    return TRUE;
+}
+
+static void ReadLayer(Ds1Reader *pReader, DWORD *pCells, DWORD cellCount)
+{
+    for (DWORD i = 0; i < cellCount; i++)
+    {
+        ReadDword(pReader, &pCells[i]);
+    }
+}
+
+Ds1Map *__cdecl PRESETSTORE_DecodeDs1(const void *pData, size_t size)
+{
+    Ds1Reader reader = {(const BYTE *)pData, size, 0};
+    DWORD version, width, height, act = 0, tagType = 0;
+
+    if (!pData || !ReadDword(&reader, &version) || !ReadDword(&reader, &width) || !ReadDword(&reader, &height))
+    {
+        return NULL;
+    }
+    width++;
+    height++;
+    if (version < 3 || version > DS1_MAX_VERSION || width > DS1_MAX_SIDE || height > DS1_MAX_SIDE)
+    {
+        return NULL;
+    }
+    if (version >= 8 && !ReadDword(&reader, &act))
+    {
+        return NULL;
+    }
+    if (version >= 10 && !ReadDword(&reader, &tagType))
+    {
+        return NULL;
+    }
+
+    // Tileset file names: the DRLG resolves tiles through the level's DT1 set
+    DWORD fileCount;
+    if (!ReadDword(&reader, &fileCount))
+    {
+        return NULL;
+    }
+    for (DWORD i = 0; i < fileCount; i++)
+    {
+        if (!SkipString(&reader))
+        {
+            return NULL;
+        }
+    }
+    if (version >= 9 && version <= 13 && !Skip(&reader, 8))
+    {
+        return NULL;
+    }
+
+    DWORD wallLayers = 1, floorLayers = 1;
+    if (version >= 4 && !ReadDword(&reader, &wallLayers))
+    {
+        return NULL;
+    }
+    if (version >= 16 && !ReadDword(&reader, &floorLayers))
+    {
+        return NULL;
+    }
+    if (wallLayers < 1 || wallLayers > PRESET_MAX_WALL_LAYERS || floorLayers < 1 ||
+        floorLayers > PRESET_MAX_FLOOR_LAYERS)
+    {
+        return NULL;
+    }
+
+    // Layers in the file include shadow (and tag), which are not kept
+    DWORD cells = width * height;
+    DWORD fileLayers = 5;
+    if (version >= 4)
+    {
+        fileLayers = wallLayers * 2 + floorLayers + 1 + ((tagType == 1 || tagType == 2) ? 1 : 0);
+    }
+    size_t layerStart = reader.pos;
+    DWORD objectCount = 0;
+    if (!Skip(&reader, (size_t)fileLayers * cells * 4))
+    {
+        return NULL;
+    }
+    if (reader.pos < reader.size && (!ReadDword(&reader, &objectCount) || objectCount > DS1_MAX_OBJECTS))
+    {
+        return NULL;
+    }
+    size_t objectStart = reader.pos;
+
+    // One block: header, wall + orientation + floor layers, then objects
+    size_t layerBytes = (size_t)(wallLayers * 2 + floorLayers) * cells * sizeof(DWORD);
+    Ds1Map *pMap = (Ds1Map *)calloc(1, sizeof(Ds1Map) + layerBytes + objectCount * sizeof(Ds1Object));
+    if (!pMap)
+    {
+        return NULL;
+    }
+    pMap->version = version;
+    pMap->width = width;
+    pMap->height = height;
+    pMap->act = act;
+    pMap->wallLayers = wallLayers;
+    pMap->floorLayers = floorLayers;
+
+    DWORD *pCells = (DWORD *)(pMap + 1);
+    DWORD *pWalls[PRESET_MAX_WALL_LAYERS], *pOrientations[PRESET_MAX_WALL_LAYERS], *pFloors[PRESET_MAX_FLOOR_LAYERS];
+    for (DWORD i = 0; i < wallLayers; i++)
+    {
+        pWalls[i] = pCells + (size_t)(i * 2) * cells;
+        pOrientations[i] = pCells + (size_t)(i * 2 + 1) * cells;
+        pMap->pWalls[i] = pWalls[i];
+        pMap->pOrientations[i] = pOrientations[i];
+    }
+    for (DWORD i = 0; i < floorLayers; i++)
+    {
+        pFloors[i] = pCells + (size_t)(wallLayers * 2 + i) * cells;
+        pMap->pFloors[i] = pFloors[i];
+    }
+
+    // Sizes were checked above, so the layer reads cannot run short
+    reader.pos = layerStart;
+    if (version < 4)
+    {
+        // Fixed order: wall, floor, orientation, tag, shadow
+        ReadLayer(&reader, pWalls[0], cells);
+        ReadLayer(&reader, pFloors[0], cells);
+        ReadLayer(&reader, pOrientations[0], cells);
+    }
+    else
+    {
+        for (DWORD i = 0; i < wallLayers; i++)
+        {
+            ReadLayer(&reader, pWalls[i], cells);
+            ReadLayer(&reader, pOrientations[i], cells);
+        }
+        for (DWORD i = 0; i < floorLayers; i++)
+        {
+            ReadLayer(&reader, pFloors[i], cells);
+        }
+    }
+
+    reader.pos = objectStart;
+    Ds1Object *pObjects = (Ds1Object *)((BYTE *)pCells + layerBytes);
+    for (DWORD i = 0; i < objectCount; i++)
+    {
+        Ds1Object *pObject = &pObjects[i];
+        if (!ReadDword(&reader, &pObject->type) || !ReadDword(&reader, &pObject->id) ||
+            !ReadDword(&reader, &pObject->x) || !ReadDword(&reader, &pObject->y) ||
+            (version > 5 && !ReadDword(&reader, &pObject->flags)))
+        {
+            free(pMap);
+            return NULL;
+        }
+    }
+    pMap->objectCount = objectCount;
+    pMap->pObjects = objectCount ? pObjects : NULL;
+
+    return pMap;
+}
+
+void __cdecl PRESETSTORE_FreeMap(Ds1Map *pMap)
+{
+    free(pMap);
+}
+
+// =============================================================================
+// STORE
+// =============================================================================
+
+PresetStore *__cdecl PRESETSTORE_Create(const PresetSource *pSource, DWORD maxPresets)
+{
+    if (!pSource || !pSource->pfnLoad || !maxPresets)
+    {
+        return NULL;
+    }
+
+    PresetStore *pStore = new PresetStore();
+    pStore->source = *pSource;
+    pStore->maxPresets = maxPresets;
+    pStore->pEntries = new PresetEntry[maxPresets]();
+    pStore->decoded = 0;
+    pStore->failed = 0;
+    pStore->requests = 0;
+    pStore->bytes = 0;
+    return pStore;
+}
+
+void __cdecl PRESETSTORE_Destroy(PresetStore *pStore)
+{
+    if (!pStore)
+    {
+        return;
+    }
+    for (DWORD i = 0; i < pStore->maxPresets; i++)
+    {
+        PRESETSTORE_FreeMap((Ds1Map *)pStore->pEntries[i].pMap);
+    }
+    delete[] pStore->pEntries;
+    delete pStore;
+}
+
+static void LoadEntry(PresetStore *pStore, DWORD presetId)
+{
+    const void *pData = NULL;
+    size_t size = 0;
+    Ds1Map *pMap = NULL;
+
+    if (pStore->source.pfnLoad(pStore->source.pContext, presetId, &pData, &size))
+    {
+        pMap = PRESETSTORE_DecodeDs1(pData, size);
+        if (pStore->source.pfnFree)
+        {
+            pStore->source.pfnFree(pStore->source.pContext, pData);
+        }
+    }
+
+    if (pMap)
+    {
+        size_t cells = (size_t)pMap->width * pMap->height;
+        pStore->bytes += sizeof(Ds1Map) + (pMap->wallLayers * 2 + pMap->floorLayers) * cells * sizeof(DWORD) +
+                         pMap->objectCount * sizeof(Ds1Object);
+        pStore->decoded++;
+    }
+    else
+    {
+        pStore->failed++;
+    }
+    pStore->pEntries[presetId].pMap = pMap;
+}
+
+const Ds1Map *__cdecl PRESETSTORE_Acquire(PresetStore *pStore, DWORD presetId)
+{
+    if (presetId >= pStore->maxPresets)
+    {
+        return NULL;
+    }
+    pStore->requests.fetch_add(1, std::memory_order_relaxed);
+
+    // call_once publishes pMap to every caller that returns from it
+    PresetEntry *pEntry = &pStore->pEntries[presetId];
+    std::call_once(pEntry->once, LoadEntry, pStore, presetId);
+    return pEntry->pMap;
+}
+
+void __cdecl PRESETSTORE_GetStats(const PresetStore *pStore, PresetStoreStats *pStats)
+{
+    pStats->decoded = pStore->decoded.load();
+    pStats->failed = pStore->failed.load();
+    pStats->requests = pStore->requests.load();
+    pStats->bytes = pStore->bytes.load();
+}
@@ -0,0 +1,88 @@
+/*
+ * PresetStore.hpp - D2Common decoded DS1 preset cache
+ *
+ * DRLG\Preset.c loads a preset's DS1 from the MPQ and decodes it into the
+ * act's DrlgMap every time a level that uses it is built, and frees it with
+ * the act. Every game re-reads and re-decodes the same few hundred files.
+ *
+ * The store decodes each preset once, on first use, into an immutable
+ * Ds1Map that any number of games and DRLG workers read concurrently. It
+ * lives for the process (or as long as the owning server host), not for a
+ * game. Decoding of different presets can run in parallel; a preset
+ * requested by two threads at once is decoded by one of them while the
+ * other waits.
+ *
+ * DS1 versions 3 to 18 are read: header, wall/orientation/floor layers and
+ * the object list. Shadow, tag, group and path data are skipped.
+ */
+
+#ifndef PRESETSTORE_HPP
+#define PRESETSTORE_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#define PRESET_MAX_WALL_LAYERS 4
+#define PRESET_MAX_FLOOR_LAYERS 2
+
+typedef struct Ds1Object
+{
+    DWORD type; // 1 = monster/npc, 2 = object
+    DWORD id;
+    DWORD x; // Subtiles
+    DWORD y;
+    DWORD flags;
+} Ds1Object;
+
+// Decoded preset. Layers are width * height cells, row-major.
+typedef struct Ds1Map
+{
+    DWORD version;
+    DWORD width; // Tiles
+    DWORD height;
+    DWORD act; // 0-based
+    DWORD wallLayers;
+    DWORD floorLayers;
+    const DWORD *pWalls[PRESET_MAX_WALL_LAYERS];
+    const DWORD *pOrientations[PRESET_MAX_WALL_LAYERS];
+    const DWORD *pFloors[PRESET_MAX_FLOOR_LAYERS];
+    DWORD objectCount;
+    const Ds1Object *pObjects;
+} Ds1Map;
+
+/*
+ * Supplies the raw DS1 for a preset id (in the game: the LvlPrest.txt File
+ * entry read through Storm). The buffer is only read until pfnFree, which
+ * may be NULL when the bytes are owned elsewhere. May be called on any
+ * thread, concurrently for different ids.
+ */
+typedef struct PresetSource
+{
+    BOOL(__cdecl *pfnLoad)(void *pContext, DWORD presetId, const void **ppData, size_t *pSize);
+    void(__cdecl *pfnFree)(void *pContext, const void *pData); // May be NULL
+    void *pContext;
+} PresetSource;
+
+typedef struct PresetStoreStats
+{
+    DWORD decoded;  // Presets decoded (once each)
+    DWORD failed;   // Load or decode failures (also cached)
+    DWORD requests; // PRESETSTORE_Acquire calls
+    size_t bytes;   // Decoded data held
+} PresetStoreStats;
+
+typedef struct PresetStore PresetStore;
+
+// maxPresets bounds the preset ids the store accepts
+PresetStore *__cdecl PRESETSTORE_Create(const PresetSource *pSource, DWORD maxPresets);
+void __cdecl PRESETSTORE_Destroy(PresetStore *pStore);
+
+// Decoded preset, or NULL if it could not be loaded. Valid until Destroy.
+const Ds1Map *__cdecl PRESETSTORE_Acquire(PresetStore *pStore, DWORD presetId);
+
+void __cdecl PRESETSTORE_GetStats(const PresetStore *pStore, PresetStoreStats *pStats);
+
+// Decode one DS1 image; free the result with PRESETSTORE_FreeMap
+Ds1Map *__cdecl PRESETSTORE_DecodeDs1(const void *pData, size_t size);
+void __cdecl PRESETSTORE_FreeMap(Ds1Map *pMap);
+
+#endif // PRESETSTORE_HPP
@@ -0,0 +1,136 @@
+/*
+ * Rng.cpp - D2Common splittable per-game random streams
+ *
+ * Value n of a stream is
+ *
+ *     Hash(Hash(key + n * 0x9E3779B9) ^ salt)
+ *
+ * with Hash = D2_HashDword. The Weyl step visits every 32-bit value before
+ * repeating and Hash is a bijection, so a stream never repeats within 2^32
+ * draws; the second round with the salt decorrelates streams whose keys
+ * happen to sit on the same Weyl sequence. Split keys come from a 64-bit
+ * mix of the parent key, salt, domain and index.
+ */
+
+#include "Rng.hpp"
+
+#define RNG_WEYL 0x9E3779B9u
+
+static inline DWORD StreamValue(DWORD key, DWORD salt, DWORD n)
+{
+    return D2_HashDword(D2_HashDword(key + n * RNG_WEYL) ^ salt);
+}
+
+// SplitMix64 finaliser
+static inline uint64_t Mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+void __cdecl RNG_InitGame(RngStream *pStream, DWORD gameSeed)
+{
+    uint64_t key = Mix64(((uint64_t)gameSeed << 32) ^ 0x5EEDD2D2u);
+    pStream->key = (DWORD)key;
+    pStream->salt = (DWORD)(key >> 32);
+    pStream->counter = 0;
+}
+
+void __cdecl RNG_Split(const RngStream *pParent, DWORD domain, DWORD index, RngStream *pChild)
+{
+    uint64_t parent = ((uint64_t)pParent->salt << 32) | pParent->key;
+    uint64_t key = Mix64(parent ^ Mix64(((uint64_t)domain << 32) | index));
+    pChild->key = (DWORD)key;
+    pChild->salt = (DWORD)(key >> 32);
+    pChild->counter = 0;
+}
+
+DWORD __cdecl RNG_Next(RngStream *pStream)
+{
+    return StreamValue(pStream->key, pStream->salt, pStream->counter++);
+}
+
+DWORD __cdecl RNG_Range(RngStream *pStream, DWORD range)
+{
+    return (DWORD)(((uint64_t)RNG_Next(pStream) * range) >> 32);
+}
+
+DWORD __cdecl RNG_Peek(const RngStream *pStream, DWORD n)
+{
+    return StreamValue(pStream->key, pStream->salt, n);
+}
+
+void __cdecl RNG_Seek(RngStream *pStream, DWORD counter)
+{
+    pStream->counter = counter;
+}
+
+// =============================================================================
+// BATCH
+// =============================================================================
+
+#if D2_SIMD_SSE2
+// Low 32 bits of a 32x32 multiply per lane (pmulld is SSE4.1)
+static inline __m128i MulLo32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// D2_HashDword on four lanes
+static inline __m128i Hash4(__m128i x, __m128i m1, __m128i m2)
+{
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = MulLo32(x, m1);
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = MulLo32(x, m2);
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    return x;
+}
+#endif
+
+void __cdecl RNG_NextBatch(RngStream *pStream, DWORD *pOut, DWORD count)
+{
+    DWORD i = 0;
+#if D2_SIMD_SSE2
+    const __m128i m1 = _mm_set1_epi32((int)0x7FEB352Du);
+    const __m128i m2 = _mm_set1_epi32((int)0x846CA68Bu);
+    const __m128i salt = _mm_set1_epi32((int)pStream->salt);
+    const __m128i step = _mm_set1_epi32((int)(8 * RNG_WEYL));
+    DWORD base = pStream->key + pStream->counter * RNG_WEYL;
+    __m128i weylA = _mm_setr_epi32((int)base, (int)(base + RNG_WEYL), (int)(base + 2 * RNG_WEYL),
+                                   (int)(base + 3 * RNG_WEYL));
+    __m128i weylB = _mm_add_epi32(weylA, _mm_set1_epi32((int)(4 * RNG_WEYL)));
+
+    // Two independent vectors per pass hide the multiply latency
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i a = Hash4(_mm_xor_si128(Hash4(weylA, m1, m2), salt), m1, m2);
+        __m128i b = Hash4(_mm_xor_si128(Hash4(weylB, m1, m2), salt), m1, m2);
+        _mm_storeu_si128((__m128i *)(pOut + i), a);
+        _mm_storeu_si128((__m128i *)(pOut + i + 4), b);
+        weylA = _mm_add_epi32(weylA, step);
+        weylB = _mm_add_epi32(weylB, step);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        pOut[i] = StreamValue(pStream->key, pStream->salt, pStream->counter + i);
+    }
+    pStream->counter += count;
+}
+
+void __cdecl RNG_RangeBatch(RngStream *pStream, DWORD range, DWORD *pOut, DWORD count)
+{
+    RNG_NextBatch(pStream, pOut, count);
+    for (DWORD i = 0; i < count; i++)
+    {
+        pOut[i] = (DWORD)(((uint64_t)pOut[i] * range) >> 32);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Rng.hpp - D2Common splittable per-game random streams
+ *
+ * The game keeps one SEED per game (plus copies in units and rooms) and
+ * rolls it with SEED_RollRandomNumber: lo * 0x6AC690C5 + hi. Drops, DRLG
+ * and AI all draw from generators whose position depends on everything
+ * rolled before, so two systems can only run in the order the game happens
+ * to run them, and a replay diverges the moment anything rolls in a
+ * different order.
+ *
+ * Streams here are counter based: value n of a stream is a fixed hash of
+ * the stream key and n. A child stream's key is derived from the parent
+ * key, a domain and an index alone (RNG_Split does not advance the parent),
+ * so "level 8", "unit 1234 of level 8" or "drop 3 of unit 1234" name the
+ * same numbers whatever else has rolled and on whichever thread:
+ *
+ *     RNG_InitGame(&game, seed);
+ *     RNG_Split(&game, RNG_DOMAIN_LEVEL, levelId, &level);
+ *     RNG_Split(&level, RNG_DOMAIN_UNIT, unitGuid, &unit);
+ *     RNG_Split(&unit, RNG_DOMAIN_DROP, dropIndex, &drop);
+ *
+ * A stream is a plain 12-byte value: copy it to checkpoint, copy it back
+ * (or RNG_Seek) to replay. RNG_NextBatch fills an array four values at a
+ * time with SSE2 and produces exactly what repeated RNG_Next would.
+ *
+ * Streams are not shared between threads; split one per thread instead.
+ */
+
+#ifndef RNG_HPP
+#define RNG_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+// Split domains; any DWORD works, these keep the common ones apart
+#define RNG_DOMAIN_LEVEL 1
+#define RNG_DOMAIN_UNIT 2
+#define RNG_DOMAIN_DROP 3
+#define RNG_DOMAIN_AI 4
+#define RNG_DOMAIN_DRLG 5
+#define RNG_DOMAIN_THREAD 6
+
+typedef struct RngStream
+{
+    DWORD key;
+    DWORD salt;
+    DWORD counter; // Values drawn so far
+} RngStream;
+
+void __cdecl RNG_InitGame(RngStream *pStream, DWORD gameSeed);
+void __cdecl RNG_Split(const RngStream *pParent, DWORD domain, DWORD index, RngStream *pChild);
+
+DWORD __cdecl RNG_Next(RngStream *pStream);
+// Uniform in [0, range) by multiply-shift; 0 when range is 0
+DWORD __cdecl RNG_Range(RngStream *pStream, DWORD range);
+// Value n of the stream without moving it
+DWORD __cdecl RNG_Peek(const RngStream *pStream, DWORD n);
+void __cdecl RNG_Seek(RngStream *pStream, DWORD counter);
+
+// count values, identical to count calls of RNG_Next
+void __cdecl RNG_NextBatch(RngStream *pStream, DWORD *pOut, DWORD count);
+void __cdecl RNG_RangeBatch(RngStream *pStream, DWORD range, DWORD *pOut, DWORD count);
+
+#endif // RNG_HPP
@@ -0,0 +1,417 @@
+/*
+ * Scheduler.cpp - D2Common per-game timer scheduler
+ *
+ * See Scheduler.hpp. Timers live in a fixed pool and are linked into wheel
+ * slots by pool index (doubly linked, so cancel is an unlink). A timer at
+ * level n sits in slot (expire >> 8n) & 255; level 0 only ever holds timers
+ * due within 256 ticks, so every timer in the current level 0 slot fires
+ * without a comparison.
+ */
+
+#include "Scheduler.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CAPACITY 65536
+#define DEFAULT_MS_PER_TICK 40
+#define DEFAULT_MAX_CATCH_UP 10
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 8
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+
+#define INDEX_MASK (TIMER_MAX_CAPACITY - 1)
+// Generations wrap below the all-ones value so no handle equals TIMER_INVALID_HANDLE
+#define GENERATION_LIMIT ((0xFFFFFFFFu >> TIMER_HANDLE_INDEX_BITS) - 1)
+
+#define NONE 0xFFFFFFFF
+
+typedef struct TypeHandler
+{
+    SchedHandlerFn pfnHandler;
+    void *pContext;
+} TypeHandler;
+
+struct Scheduler
+{
+    DWORD now;
+    DWORD capacity;
+    DWORD msPerTick;
+    DWORD maxCatchUp;
+    DWORD msPending; // Frame time not yet turned into ticks
+    DWORD pending;
+
+    // Timer pool
+    DWORD *expire;
+    DWORD *period;
+    DWORD *unitId;
+    DWORD *param;
+    BYTE *type;
+    DWORD *slot; // Wheel slot, NONE while free or firing
+    DWORD *prev;
+    DWORD *next; // Next in slot, or next free
+    DWORD *generation;
+    DWORD freeHead;
+
+    DWORD heads[WHEEL_LEVELS * WHEEL_SIZE];
+    TypeHandler handlers[TIMERS_MAX_TYPES];
+
+    SchedEvent *fired; // This tick, in slot order
+    SchedEvent *events; // This tick, grouped by type
+
+    uint64_t added;
+    uint64_t cancelled;
+    uint64_t firedTotal;
+    uint64_t cascaded;
+};
+
+// =============================================================================
+// LIFETIME
+// =============================================================================
+
+Scheduler *__cdecl TIMERS_Create(const SchedulerDesc *pDesc)
+{
+    Scheduler *pSched = (Scheduler *)calloc(1, sizeof(Scheduler));
+    if (!pSched)
+    {
+        return NULL;
+    }
+
+    DWORD capacity = (pDesc && pDesc->capacity) ? pDesc->capacity : DEFAULT_CAPACITY;
+    if (capacity > TIMER_MAX_CAPACITY)
+    {
+        capacity = TIMER_MAX_CAPACITY;
+    }
+    pSched->capacity = capacity;
+    pSched->msPerTick = (pDesc && pDesc->msPerTick) ? pDesc->msPerTick : DEFAULT_MS_PER_TICK;
+    pSched->maxCatchUp = (pDesc && pDesc->maxCatchUp) ? pDesc->maxCatchUp : DEFAULT_MAX_CATCH_UP;
+
+    pSched->expire = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pSched->period = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pSched->unitId = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pSched->param = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pSched->type = (BYTE *)malloc(capacity);
+    pSched->slot = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pSched->prev = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pSched->next = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pSched->generation = (DWORD *)calloc(capacity, sizeof(DWORD));
+    pSched->fired = (SchedEvent *)malloc(capacity * sizeof(SchedEvent));
+    pSched->events = (SchedEvent *)malloc(capacity * sizeof(SchedEvent));
+
+    if (!pSched->expire || !pSched->period || !pSched->unitId || !pSched->param || !pSched->type ||
+        !pSched->slot || !pSched->prev || !pSched->next || !pSched->generation || !pSched->fired ||
+        !pSched->events)
+    {
+        TIMERS_Destroy(pSched);
+        return NULL;
+    }
+
+    for (DWORD i = 0; i < capacity; i++)
+    {
+        pSched->slot[i] = NONE;
+        pSched->next[i] = i + 1;
+    }
+    for (DWORD i = 0; i < WHEEL_LEVELS * WHEEL_SIZE; i++)
+    {
+        pSched->heads[i] = NONE;
+    }
+    return pSched;
+}
+
+void __cdecl TIMERS_Destroy(Scheduler *pSched)
+{
+    if (!pSched)
+    {
+        return;
+    }
+
+    free(pSched->expire);
+    free(pSched->period);
+    free(pSched->unitId);
+    free(pSched->param);
+    free(pSched->type);
+    free(pSched->slot);
+    free(pSched->prev);
+    free(pSched->next);
+    free(pSched->generation);
+    free(pSched->fired);
+    free(pSched->events);
+    free(pSched);
+}
+
+DWORD __cdecl TIMERS_GetTick(const Scheduler *pSched)
+{
+    return pSched->now;
+}
+
+BOOL __cdecl TIMERS_SetHandler(Scheduler *pSched, DWORD type, SchedHandlerFn pfnHandler, void *pContext)
+{
+    if (type >= TIMERS_MAX_TYPES)
+    {
+        return FALSE;
+    }
+    pSched->handlers[type].pfnHandler = pfnHandler;
+    pSched->handlers[type].pContext = pContext;
+    return TRUE;
+}
+
+// =============================================================================
+// WHEEL
+// =============================================================================
+
+static void Link(Scheduler *pSched, DWORD t)
+{
+    DWORD delta = pSched->expire[t] - pSched->now;
+    DWORD level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1u << (WHEEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+
+    DWORD slot = level * WHEEL_SIZE + ((pSched->expire[t] >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    DWORD head = pSched->heads[slot];
+    pSched->slot[t] = slot;
+    pSched->prev[t] = NONE;
+    pSched->next[t] = head;
+    if (head != NONE)
+    {
+        pSched->prev[head] = t;
+    }
+    pSched->heads[slot] = t;
+}
+
+static void Unlink(Scheduler *pSched, DWORD t)
+{
+    DWORD prev = pSched->prev[t];
+    DWORD next = pSched->next[t];
+    if (prev != NONE)
+    {
+        pSched->next[prev] = next;
+    }
+    else
+    {
+        pSched->heads[pSched->slot[t]] = next;
+    }
+    if (next != NONE)
+    {
+        pSched->prev[next] = prev;
+    }
+    pSched->slot[t] = NONE;
+}
+
+static void Release(Scheduler *pSched, DWORD t)
+{
+    DWORD generation = pSched->generation[t] + 1;
+    pSched->generation[t] = generation > GENERATION_LIMIT ? 0 : generation;
+    pSched->slot[t] = NONE;
+    pSched->next[t] = pSched->freeHead;
+    pSched->freeHead = t;
+    pSched->pending--;
+}
+
+static inline DWORD ClampDelay(DWORD delay)
+{
+    if (!delay)
+    {
+        return 1;
+    }
+    return delay > TIMERS_MAX_DELAY ? TIMERS_MAX_DELAY : delay;
+}
+
+// Re-files every timer of one slot relative to the current tick
+static void Cascade(Scheduler *pSched, DWORD level)
+{
+    DWORD slot = level * WHEEL_SIZE + ((pSched->now >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    DWORD t = pSched->heads[slot];
+    pSched->heads[slot] = NONE;
+    while (t != NONE)
+    {
+        DWORD next = pSched->next[t];
+        Link(pSched, t);
+        pSched->cascaded++;
+        t = next;
+    }
+}
+
+// =============================================================================
+// TIMERS
+// =============================================================================
+
+static inline DWORD Resolve(const Scheduler *pSched, TimerHandle handle)
+{
+    DWORD t = handle & INDEX_MASK;
+    if (handle == TIMER_INVALID_HANDLE || t >= pSched->capacity ||
+        pSched->generation[t] != (handle >> TIMER_HANDLE_INDEX_BITS) || pSched->slot[t] == NONE)
+    {
+        return NONE;
+    }
+    return t;
+}
+
+TimerHandle __cdecl TIMERS_Add(Scheduler *pSched, DWORD type, DWORD delay, DWORD period, DWORD unitId,
+                               DWORD param)
+{
+    DWORD t = pSched->freeHead;
+    if (type >= TIMERS_MAX_TYPES || t >= pSched->capacity)
+    {
+        return TIMER_INVALID_HANDLE;
+    }
+    pSched->freeHead = pSched->next[t];
+    pSched->pending++;
+    pSched->added++;
+
+    pSched->expire[t] = pSched->now + ClampDelay(delay);
+    pSched->period[t] = period ? ClampDelay(period) : 0;
+    pSched->unitId[t] = unitId;
+    pSched->param[t] = param;
+    pSched->type[t] = (BYTE)type;
+    Link(pSched, t);
+    return (pSched->generation[t] << TIMER_HANDLE_INDEX_BITS) | t;
+}
+
+BOOL __cdecl TIMERS_Cancel(Scheduler *pSched, TimerHandle handle)
+{
+    DWORD t = Resolve(pSched, handle);
+    if (t == NONE)
+    {
+        return FALSE;
+    }
+    Unlink(pSched, t);
+    Release(pSched, t);
+    pSched->cancelled++;
+    return TRUE;
+}
+
+BOOL __cdecl TIMERS_Reschedule(Scheduler *pSched, TimerHandle handle, DWORD delay)
+{
+    DWORD t = Resolve(pSched, handle);
+    if (t == NONE)
+    {
+        return FALSE;
+    }
+    Unlink(pSched, t);
+    pSched->expire[t] = pSched->now + ClampDelay(delay);
+    Link(pSched, t);
+    return TRUE;
+}
+
+BOOL __cdecl TIMERS_IsPending(const Scheduler *pSched, TimerHandle handle)
+{
+    return Resolve(pSched, handle) != NONE;
+}
+
+DWORD __cdecl TIMERS_GetRemaining(const Scheduler *pSched, TimerHandle handle)
+{
+    DWORD t = Resolve(pSched, handle);
+    return t == NONE ? 0 : pSched->expire[t] - pSched->now;
+}
+
+// =============================================================================
+// TICK
+// =============================================================================
+
+void __cdecl TIMERS_Tick(Scheduler *pSched, SchedTickResult *pResult)
+{
+    DWORD now = ++pSched->now;
+
+    // Each wrapping level pulls the next level's current slot down
+    for (DWORD level = 1; level < WHEEL_LEVELS; level++)
+    {
+        if ((now >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK)
+        {
+            break;
+        }
+        Cascade(pSched, level);
+    }
+
+    // Everything in the level 0 slot is due now; re-arm or free before dispatch
+    DWORD count = 0;
+    DWORD typeCount[TIMERS_MAX_TYPES];
+    memset(typeCount, 0, sizeof(typeCount));
+
+    DWORD t = pSched->heads[now & WHEEL_MASK];
+    pSched->heads[now & WHEEL_MASK] = NONE;
+    while (t != NONE)
+    {
+        DWORD next = pSched->next[t];
+        SchedEvent *pEvent = &pSched->fired[count++];
+        pEvent->handle = (pSched->generation[t] << TIMER_HANDLE_INDEX_BITS) | t;
+        pEvent->unitId = pSched->unitId[t];
+        pEvent->param = pSched->param[t];
+        pEvent->type = pSched->type[t];
+        pEvent->periodic = pSched->period[t] != 0;
+        typeCount[pSched->type[t]]++;
+
+        if (pSched->period[t])
+        {
+            pSched->expire[t] = now + pSched->period[t];
+            Link(pSched, t);
+        }
+        else
+        {
+            Release(pSched, t);
+        }
+        t = next;
+    }
+    pSched->firedTotal += count;
+
+    // Group by type, keeping slot order within a type
+    DWORD typeStart[TIMERS_MAX_TYPES];
+    DWORD offset = 0;
+    for (DWORD type = 0; type < TIMERS_MAX_TYPES; type++)
+    {
+        typeStart[type] = offset;
+        offset += typeCount[type];
+    }
+    DWORD fill[TIMERS_MAX_TYPES];
+    memcpy(fill, typeStart, sizeof(fill));
+    for (DWORD i = 0; i < count; i++)
+    {
+        pSched->events[fill[pSched->fired[i].type]++] = pSched->fired[i];
+    }
+
+    for (DWORD type = 0; type < TIMERS_MAX_TYPES; type++)
+    {
+        const TypeHandler *pHandler = &pSched->handlers[type];
+        if (typeCount[type] && pHandler->pfnHandler)
+        {
+            pHandler->pfnHandler(pHandler->pContext, pSched->events + typeStart[type], typeCount[type]);
+        }
+    }
+
+    if (pResult)
+    {
+        pResult->tick = now;
+        pResult->pEvents = pSched->events;
+        pResult->count = count;
+    }
+}
+
+DWORD __cdecl TIMERS_RunFrame(Scheduler *pSched, DWORD elapsedMs)
+{
+    DWORD total = pSched->msPending + elapsedMs;
+    DWORD ticks = total / pSched->msPerTick;
+    pSched->msPending = total - ticks * pSched->msPerTick;
+
+    // After a stall, run a bounded burst and drop the rest instead of spiralling
+    if (ticks > pSched->maxCatchUp)
+    {
+        ticks = pSched->maxCatchUp;
+    }
+    for (DWORD i = 0; i < ticks; i++)
+    {
+        TIMERS_Tick(pSched, NULL);
+    }
+    return ticks;
+}
+
+void __cdecl TIMERS_GetStats(const Scheduler *pSched, SchedulerStats *pStats)
+{
+    pStats->pending = pSched->pending;
+    pStats->added = pSched->added;
+    pStats->cancelled = pSched->cancelled;
+    pStats->fired = pSched->firedTotal;
+    pStats->cascaded = pSched->cascaded;
+}
@@ -0,0 +1,119 @@
+/*
+ * Scheduler.hpp - D2Common per-game timer scheduler
+ *
+ * Curse and aura durations, monster regeneration, shrine refresh and the
+ * game's delayed events are all kept as expiry ticks on the units that own
+ * them, and each subsystem finds the ones that are due by walking every
+ * unit every tick. In a quiet game almost nothing expires, yet the walks
+ * still cost the same as in a busy one.
+ *
+ * The scheduler is a hierarchical timing wheel: four levels of 256 slots,
+ * level n covering delays up to 256^(n+1) ticks. A timer goes into the
+ * slot of its expiry tick at the coarsest level it needs; each time a level
+ * wraps, the next level's current slot is redistributed one level down.
+ * Insert, cancel and reschedule are O(1), and a tick touches only the
+ * timers that fire or cascade. Delays are capped at TIMERS_MAX_DELAY ticks
+ * (about five years of game time).
+ *
+ * Firing is batched per tick: the timers due on a tick are grouped by type
+ * and each type's handler is called once with all of them, so e.g. every
+ * regen tick of a frame is applied in one pass. Periodic timers are re-armed
+ * before the handlers run. Handlers may add, cancel and reschedule timers.
+ *
+ * The in-game state drives it once per frame with TIMERS_RunFrame, which
+ * turns wall-clock milliseconds into game ticks (25 per second by default)
+ * and bounds catch-up after a stall. Game thread only; one scheduler per
+ * game. Timed skill effects stay on SkillEngine's own wheel, which keeps
+ * them next to the skill entries they belong to.
+ */
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef DWORD TimerHandle;
+
+#define TIMER_INVALID_HANDLE 0xFFFFFFFF
+
+// Handle layout: low TIMER_HANDLE_INDEX_BITS = slot, the rest = generation
+#define TIMER_HANDLE_INDEX_BITS 20
+#define TIMER_MAX_CAPACITY (1u << TIMER_HANDLE_INDEX_BITS)
+
+// Timer types; handlers are registered per type
+#define TIMERS_TYPE_CURSE 0
+#define TIMERS_TYPE_AURA 1
+#define TIMERS_TYPE_REGEN 2
+#define TIMERS_TYPE_SHRINE 3
+#define TIMERS_TYPE_EVENT 4 // Delayed game events
+#define TIMERS_TYPE_USER 8  // First type free for callers
+#define TIMERS_MAX_TYPES 32
+
+// Longer delays are clamped; keeps a top-level slot from aliasing the current one
+#define TIMERS_MAX_DELAY 0xFF000000u
+
+typedef struct SchedulerDesc
+{
+    DWORD capacity;   // Maximum pending timers (0 = 65536), at most TIMER_MAX_CAPACITY
+    DWORD msPerTick;  // Game tick length for TIMERS_RunFrame (0 = 40, D2's 25 fps)
+    DWORD maxCatchUp; // Most ticks one frame may run; the rest of a stall is dropped (0 = 10)
+} SchedulerDesc;
+
+typedef struct SchedEvent
+{
+    TimerHandle handle; // Stale for one-shot timers, still valid for periodic ones
+    DWORD unitId;
+    DWORD param;
+    WORD type;
+    WORD periodic;
+} SchedEvent;
+
+// Called once per type per tick with every timer of that type that fired
+typedef void(__cdecl *SchedHandlerFn)(void *pContext, const SchedEvent *pEvents, DWORD count);
+
+typedef struct SchedTickResult
+{
+    DWORD tick;
+    const SchedEvent *pEvents; // Grouped by type, valid until the next tick
+    DWORD count;
+} SchedTickResult;
+
+typedef struct SchedulerStats
+{
+    DWORD pending;
+    uint64_t added;
+    uint64_t cancelled;
+    uint64_t fired;
+    uint64_t cascaded; // Timers moved down a level
+} SchedulerStats;
+
+typedef struct Scheduler Scheduler;
+
+Scheduler *__cdecl TIMERS_Create(const SchedulerDesc *pDesc);
+void __cdecl TIMERS_Destroy(Scheduler *pSched);
+DWORD __cdecl TIMERS_GetTick(const Scheduler *pSched);
+
+BOOL __cdecl TIMERS_SetHandler(Scheduler *pSched, DWORD type, SchedHandlerFn pfnHandler, void *pContext);
+
+/*
+ * Fires delay ticks from now (0 is treated as 1), then every period ticks
+ * if period is nonzero. TIMER_INVALID_HANDLE when full or type is out of
+ * range.
+ */
+TimerHandle __cdecl TIMERS_Add(Scheduler *pSched, DWORD type, DWORD delay, DWORD period, DWORD unitId,
+                               DWORD param);
+BOOL __cdecl TIMERS_Cancel(Scheduler *pSched, TimerHandle handle);
+// Moves the next firing to delay ticks from now (refreshing a curse)
+BOOL __cdecl TIMERS_Reschedule(Scheduler *pSched, TimerHandle handle, DWORD delay);
+BOOL __cdecl TIMERS_IsPending(const Scheduler *pSched, TimerHandle handle);
+// Ticks until the next firing, 0 for stale handles
+DWORD __cdecl TIMERS_GetRemaining(const Scheduler *pSched, TimerHandle handle);
+
+// Advance one tick, firing and dispatching its timers; pResult may be NULL
+void __cdecl TIMERS_Tick(Scheduler *pSched, SchedTickResult *pResult);
+// Per-frame entry point: runs the ticks elapsedMs covers, returns how many
+DWORD __cdecl TIMERS_RunFrame(Scheduler *pSched, DWORD elapsedMs);
+
+void __cdecl TIMERS_GetStats(const Scheduler *pSched, SchedulerStats *pStats);
+
+#endif // SCHEDULER_HPP
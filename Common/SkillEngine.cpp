@@ -0,0 +1,779 @@
+/*
+ * SkillEngine.cpp - D2Common batched skill and missile engine
+ *
+ * See SkillEngine.hpp. Missile slots own the generation and point at
+ * (type, dense index); pools are padded to a multiple of four so the SIMD
+ * pass never needs a tail. Skill entries live in a fixed pool chained per
+ * unit; the unit table only maps a GUID to its chain head, so the hash
+ * index can move its slots freely while the timing wheel links entries by
+ * pool index.
+ */
+
+#include "SkillEngine.hpp"
+
+#include "../Shared/HashIndex.hpp"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_MISSILE_TYPES 512
+#define DEFAULT_MISSILE_CAPACITY 16384
+#define DEFAULT_ENTRY_CAPACITY 65536
+#define DEFAULT_WHEEL_SLOTS 512
+#define POOL_MIN_CAPACITY 16
+
+#define INDEX_MASK (MISSILE_MAX_CAPACITY - 1)
+// Generations wrap below the all-ones value so no handle equals MISSILE_INVALID_HANDLE
+#define GENERATION_LIMIT ((0xFFFFFFFFu >> MISSILE_HANDLE_INDEX_BITS) - 1)
+
+#define NONE 0xFFFFFFFF
+
+// Entry flags
+#define ENTRY_SKILL 0x01
+#define ENTRY_EFFECT 0x02
+
+typedef struct MissilePool
+{
+    DWORD count;
+    DWORD capacity; // Multiple of four
+    float speed;
+    float range; // FLT_MAX when unlimited
+    int lifetime; // INT_MAX when unlimited
+    BOOL defined;
+
+    float *x;
+    float *y;
+    float *vx;
+    float *vy;
+    float *rangeLeft;
+    int *lifeLeft;
+    DWORD *owner;
+    MissileHandle *handles;
+} MissilePool;
+
+struct SkillEngine
+{
+    DWORD tick;
+    BOOL simd;
+
+    // Missiles
+    DWORD missileTypes;
+    DWORD missileCapacity;
+    DWORD missileCount;
+    MissilePool *pools;
+    DWORD *generation;
+    WORD *slotType;
+    DWORD *slotDense; // NONE when free
+    DWORD *nextFree;
+    DWORD freeHead;
+    DWORD *expired; // Scratch dense indices for one pool
+    MissileEvent *missileEvents;
+
+    // Skill entries
+    DWORD entryCapacity;
+    DWORD entryCount;
+    DWORD *entUnit;
+    DWORD *entSkill;
+    DWORD *entLevel;
+    DWORD *entCooldownEnd;
+    DWORD *entExpire;
+    DWORD *entNext; // Next in unit chain, or next free
+    DWORD *entWheelPrev;
+    DWORD *entWheelNext;
+    BYTE *entFlags;
+    DWORD entryFree;
+    EffectEvent *effectEvents;
+
+    HashIndex units; // GUID -> chain head
+
+    DWORD *wheel;
+    DWORD wheelMask;
+    DWORD effectCount;
+
+    uint64_t wheelVisits;
+    uint64_t effectsFired;
+    uint64_t missilesEnded;
+};
+
+// =============================================================================
+// LIFETIME
+// =============================================================================
+
+SkillEngine *__cdecl SKILLENG_Create(const SkillEngineDesc *pDesc)
+{
+    SkillEngine *pEngine = (SkillEngine *)calloc(1, sizeof(SkillEngine));
+    if (!pEngine)
+    {
+        return NULL;
+    }
+
+    DWORD types = (pDesc && pDesc->missileTypes) ? pDesc->missileTypes : DEFAULT_MISSILE_TYPES;
+    DWORD capacity = (pDesc && pDesc->missileCapacity) ? pDesc->missileCapacity : DEFAULT_MISSILE_CAPACITY;
+    DWORD entries = (pDesc && pDesc->entryCapacity) ? pDesc->entryCapacity : DEFAULT_ENTRY_CAPACITY;
+    DWORD slots = D2_NextPow2((pDesc && pDesc->wheelSlots) ? pDesc->wheelSlots : DEFAULT_WHEEL_SLOTS);
+    if (types > 0x10000)
+    {
+        types = 0x10000;
+    }
+    if (capacity > MISSILE_MAX_CAPACITY)
+    {
+        capacity = MISSILE_MAX_CAPACITY;
+    }
+
+    pEngine->simd = D2_SIMD_SSE2 && !(pDesc && pDesc->forceScalar);
+    pEngine->missileTypes = types;
+    pEngine->missileCapacity = capacity;
+    pEngine->entryCapacity = entries;
+    pEngine->wheelMask = slots - 1;
+
+    pEngine->pools = (MissilePool *)calloc(types, sizeof(MissilePool));
+    pEngine->generation = (DWORD *)calloc(capacity, sizeof(DWORD));
+    pEngine->slotType = (WORD *)malloc(capacity * sizeof(WORD));
+    pEngine->slotDense = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pEngine->nextFree = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pEngine->expired = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pEngine->missileEvents = (MissileEvent *)malloc(capacity * sizeof(MissileEvent));
+    pEngine->entUnit = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entSkill = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entLevel = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entCooldownEnd = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entExpire = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entNext = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entWheelPrev = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entWheelNext = (DWORD *)malloc(entries * sizeof(DWORD));
+    pEngine->entFlags = (BYTE *)malloc(entries);
+    pEngine->effectEvents = (EffectEvent *)malloc(entries * sizeof(EffectEvent));
+    pEngine->wheel = (DWORD *)malloc(slots * sizeof(DWORD));
+
+    if (!pEngine->pools || !pEngine->generation || !pEngine->slotType || !pEngine->slotDense ||
+        !pEngine->nextFree || !pEngine->expired || !pEngine->missileEvents || !pEngine->entUnit ||
+        !pEngine->entSkill || !pEngine->entLevel || !pEngine->entCooldownEnd || !pEngine->entExpire ||
+        !pEngine->entNext || !pEngine->entWheelPrev || !pEngine->entWheelNext || !pEngine->entFlags ||
+        !pEngine->effectEvents || !pEngine->wheel || !HASHINDEX_Init(&pEngine->units, entries))
+    {
+        SKILLENG_Destroy(pEngine);
+        return NULL;
+    }
+
+    for (DWORD i = 0; i < capacity; i++)
+    {
+        pEngine->slotDense[i] = NONE;
+        pEngine->nextFree[i] = i + 1;
+    }
+    for (DWORD i = 0; i < entries; i++)
+    {
+        pEngine->entNext[i] = i + 1;
+    }
+    for (DWORD i = 0; i < slots; i++)
+    {
+        pEngine->wheel[i] = NONE;
+    }
+    return pEngine;
+}
+
+void __cdecl SKILLENG_Destroy(SkillEngine *pEngine)
+{
+    if (!pEngine)
+    {
+        return;
+    }
+
+    if (pEngine->pools)
+    {
+        for (DWORD t = 0; t < pEngine->missileTypes; t++)
+        {
+            MissilePool *pPool = &pEngine->pools[t];
+            free(pPool->x);
+            free(pPool->y);
+            free(pPool->vx);
+            free(pPool->vy);
+            free(pPool->rangeLeft);
+            free(pPool->lifeLeft);
+            free(pPool->owner);
+            free(pPool->handles);
+        }
+    }
+    free(pEngine->pools);
+    free(pEngine->generation);
+    free(pEngine->slotType);
+    free(pEngine->slotDense);
+    free(pEngine->nextFree);
+    free(pEngine->expired);
+    free(pEngine->missileEvents);
+    free(pEngine->entUnit);
+    free(pEngine->entSkill);
+    free(pEngine->entLevel);
+    free(pEngine->entCooldownEnd);
+    free(pEngine->entExpire);
+    free(pEngine->entNext);
+    free(pEngine->entWheelPrev);
+    free(pEngine->entWheelNext);
+    free(pEngine->entFlags);
+    free(pEngine->effectEvents);
+    HASHINDEX_Free(&pEngine->units);
+    free(pEngine->wheel);
+    free(pEngine);
+}
+
+DWORD __cdecl SKILLENG_GetTick(const SkillEngine *pEngine)
+{
+    return pEngine->tick;
+}
+
+// =============================================================================
+// MISSILES
+// =============================================================================
+
+BOOL __cdecl SKILLENG_SetMissileType(SkillEngine *pEngine, DWORD type, const MissileTypeDesc *pDesc)
+{
+    if (type >= pEngine->missileTypes || !pDesc || pDesc->speed < 0.0f || pDesc->range < 0.0f)
+    {
+        return FALSE;
+    }
+
+    // Live missiles keep the range and lifetime they were spawned with
+    MissilePool *pPool = &pEngine->pools[type];
+    pPool->speed = pDesc->speed;
+    pPool->range = pDesc->range > 0.0f ? pDesc->range : FLT_MAX;
+    pPool->lifetime = (pDesc->lifetime && pDesc->lifetime < (DWORD)INT_MAX) ? (int)pDesc->lifetime : INT_MAX;
+    pPool->defined = TRUE;
+    return TRUE;
+}
+
+static BOOL GrowPool(MissilePool *pPool)
+{
+    DWORD capacity = pPool->capacity ? pPool->capacity * 2 : POOL_MIN_CAPACITY;
+    void *p;
+
+    // Arrays that did grow are kept on failure; capacity only moves when all did
+#define GROW_ARRAY(field, type)                                                                                  \
+    p = realloc(pPool->field, capacity * sizeof(type));                                                          \
+    if (!p)                                                                                                      \
+    {                                                                                                            \
+        return FALSE;                                                                                            \
+    }                                                                                                            \
+    pPool->field = (type *)p;
+
+    GROW_ARRAY(x, float)
+    GROW_ARRAY(y, float)
+    GROW_ARRAY(vx, float)
+    GROW_ARRAY(vy, float)
+    GROW_ARRAY(rangeLeft, float)
+    GROW_ARRAY(lifeLeft, int)
+    GROW_ARRAY(owner, DWORD)
+    GROW_ARRAY(handles, MissileHandle)
+#undef GROW_ARRAY
+
+    pPool->capacity = capacity;
+    return TRUE;
+}
+
+static inline DWORD ResolveSlot(const SkillEngine *pEngine, MissileHandle handle)
+{
+    DWORD slot = handle & INDEX_MASK;
+    if (handle == MISSILE_INVALID_HANDLE || slot >= pEngine->missileCapacity ||
+        pEngine->generation[slot] != (handle >> MISSILE_HANDLE_INDEX_BITS) || pEngine->slotDense[slot] == NONE)
+    {
+        return NONE;
+    }
+    return slot;
+}
+
+MissileHandle __cdecl SKILLENG_SpawnMissile(SkillEngine *pEngine, DWORD type, DWORD owner, float x, float y,
+                                            float targetX, float targetY)
+{
+    DWORD slot = pEngine->freeHead;
+    if (type >= pEngine->missileTypes || !pEngine->pools[type].defined || slot >= pEngine->missileCapacity)
+    {
+        return MISSILE_INVALID_HANDLE;
+    }
+
+    MissilePool *pPool = &pEngine->pools[type];
+    if (pPool->count == pPool->capacity && !GrowPool(pPool))
+    {
+        return MISSILE_INVALID_HANDLE;
+    }
+
+    float dx = targetX - x;
+    float dy = targetY - y;
+    float len = sqrtf(dx * dx + dy * dy);
+    float scale = len > 0.0f ? pPool->speed / len : 0.0f;
+
+    MissileHandle handle = (pEngine->generation[slot] << MISSILE_HANDLE_INDEX_BITS) | slot;
+    DWORD dense = pPool->count++;
+    pPool->x[dense] = x;
+    pPool->y[dense] = y;
+    pPool->vx[dense] = dx * scale;
+    pPool->vy[dense] = dy * scale;
+    pPool->rangeLeft[dense] = pPool->range;
+    pPool->lifeLeft[dense] = pPool->lifetime;
+    pPool->owner[dense] = owner;
+    pPool->handles[dense] = handle;
+
+    pEngine->freeHead = pEngine->nextFree[slot];
+    pEngine->slotType[slot] = (WORD)type;
+    pEngine->slotDense[slot] = dense;
+    pEngine->missileCount++;
+    return handle;
+}
+
+static void RemoveDense(SkillEngine *pEngine, MissilePool *pPool, DWORD dense)
+{
+    DWORD slot = pPool->handles[dense] & INDEX_MASK;
+    DWORD last = --pPool->count;
+    if (dense != last)
+    {
+        pPool->x[dense] = pPool->x[last];
+        pPool->y[dense] = pPool->y[last];
+        pPool->vx[dense] = pPool->vx[last];
+        pPool->vy[dense] = pPool->vy[last];
+        pPool->rangeLeft[dense] = pPool->rangeLeft[last];
+        pPool->lifeLeft[dense] = pPool->lifeLeft[last];
+        pPool->owner[dense] = pPool->owner[last];
+        pPool->handles[dense] = pPool->handles[last];
+        pEngine->slotDense[pPool->handles[dense] & INDEX_MASK] = dense;
+    }
+
+    DWORD generation = pEngine->generation[slot] + 1;
+    pEngine->generation[slot] = generation > GENERATION_LIMIT ? 0 : generation;
+    pEngine->slotDense[slot] = NONE;
+    pEngine->nextFree[slot] = pEngine->freeHead;
+    pEngine->freeHead = slot;
+    pEngine->missileCount--;
+}
+
+BOOL __cdecl SKILLENG_RemoveMissile(SkillEngine *pEngine, MissileHandle handle)
+{
+    DWORD slot = ResolveSlot(pEngine, handle);
+    if (slot == NONE)
+    {
+        return FALSE;
+    }
+    RemoveDense(pEngine, &pEngine->pools[pEngine->slotType[slot]], pEngine->slotDense[slot]);
+    return TRUE;
+}
+
+BOOL __cdecl SKILLENG_IsMissileAlive(const SkillEngine *pEngine, MissileHandle handle)
+{
+    return ResolveSlot(pEngine, handle) != NONE;
+}
+
+BOOL __cdecl SKILLENG_GetMissilePool(SkillEngine *pEngine, DWORD type, MissilePoolView *pView)
+{
+    if (type >= pEngine->missileTypes)
+    {
+        return FALSE;
+    }
+
+    MissilePool *pPool = &pEngine->pools[type];
+    pView->count = pPool->count;
+    pView->x = pPool->x;
+    pView->y = pPool->y;
+    pView->vx = pPool->vx;
+    pView->vy = pPool->vy;
+    pView->rangeLeft = pPool->rangeLeft;
+    pView->lifeLeft = pPool->lifeLeft;
+    pView->owner = pPool->owner;
+    pView->handles = pPool->handles;
+    return TRUE;
+}
+
+// Moves every missile of the pool and lists the ones that ended, ascending
+static DWORD AdvancePoolScalar(MissilePool *pPool, DWORD *pExpired)
+{
+    DWORD expired = 0;
+    float speed = pPool->speed;
+    for (DWORD i = 0; i < pPool->count; i++)
+    {
+        pPool->x[i] += pPool->vx[i];
+        pPool->y[i] += pPool->vy[i];
+        pPool->rangeLeft[i] -= speed;
+        pPool->lifeLeft[i] -= 1;
+        if (pPool->rangeLeft[i] <= 0.0f || pPool->lifeLeft[i] <= 0)
+        {
+            pExpired[expired++] = i;
+        }
+    }
+    return expired;
+}
+
+#if D2_SIMD_SSE2
+// Lanes past count are padding: updated, never reported
+static DWORD AdvancePoolSse2(MissilePool *pPool, DWORD *pExpired)
+{
+    DWORD expired = 0;
+    const __m128 speed = _mm_set1_ps(pPool->speed);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i one = _mm_set1_epi32(1);
+
+    for (DWORD i = 0; i < pPool->count; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_loadu_ps(pPool->x + i), _mm_loadu_ps(pPool->vx + i));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(pPool->y + i), _mm_loadu_ps(pPool->vy + i));
+        __m128 range = _mm_sub_ps(_mm_loadu_ps(pPool->rangeLeft + i), speed);
+        __m128i life = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pPool->lifeLeft + i)), one);
+        _mm_storeu_ps(pPool->x + i, x);
+        _mm_storeu_ps(pPool->y + i, y);
+        _mm_storeu_ps(pPool->rangeLeft + i, range);
+        _mm_storeu_si128((__m128i *)(pPool->lifeLeft + i), life);
+
+        __m128i alive = _mm_cmpgt_epi32(life, _mm_setzero_si128());
+        int bits = _mm_movemask_ps(_mm_cmple_ps(range, zero)) | (~_mm_movemask_ps(_mm_castsi128_ps(alive)) & 0xF);
+        DWORD remaining = pPool->count - i;
+        if (remaining < 4)
+        {
+            bits &= (1 << remaining) - 1;
+        }
+        for (DWORD lane = i; bits; lane++, bits >>= 1)
+        {
+            if (bits & 1)
+            {
+                pExpired[expired++] = lane;
+            }
+        }
+    }
+    return expired;
+}
+#endif
+
+static DWORD AdvanceMissiles(SkillEngine *pEngine, DWORD *pMoved)
+{
+    DWORD events = 0;
+    DWORD moved = 0;
+    for (DWORD t = 0; t < pEngine->missileTypes; t++)
+    {
+        MissilePool *pPool = &pEngine->pools[t];
+        if (!pPool->count)
+        {
+            continue;
+        }
+        moved += pPool->count;
+
+        DWORD expired;
+#if D2_SIMD_SSE2
+        if (pEngine->simd)
+        {
+            expired = AdvancePoolSse2(pPool, pEngine->expired);
+        }
+        else
+#endif
+        {
+            expired = AdvancePoolScalar(pPool, pEngine->expired);
+        }
+
+        // Descending, so each swap-remove pulls in a missile that is still alive
+        while (expired)
+        {
+            DWORD dense = pEngine->expired[--expired];
+            MissileEvent *pEvent = &pEngine->missileEvents[events++];
+            pEvent->handle = pPool->handles[dense];
+            pEvent->owner = pPool->owner[dense];
+            pEvent->type = (WORD)t;
+            pEvent->reason = pPool->rangeLeft[dense] <= 0.0f ? MISSILE_END_RANGE : MISSILE_END_LIFETIME;
+            pEvent->x = pPool->x[dense];
+            pEvent->y = pPool->y[dense];
+            RemoveDense(pEngine, pPool, dense);
+        }
+    }
+    *pMoved = moved;
+    return events;
+}
+
+// =============================================================================
+// UNIT TABLE
+// =============================================================================
+
+static DWORD FindEntry(const SkillEngine *pEngine, DWORD unitId, DWORD skillId)
+{
+    DWORD slot = HASHINDEX_Find(&pEngine->units, unitId);
+    if (slot == NONE)
+    {
+        return NONE;
+    }
+    for (DWORD e = pEngine->units.pValues[slot]; e != NONE; e = pEngine->entNext[e])
+    {
+        if (pEngine->entSkill[e] == skillId)
+        {
+            return e;
+        }
+    }
+    return NONE;
+}
+
+static DWORD FindOrAddEntry(SkillEngine *pEngine, DWORD unitId, DWORD skillId)
+{
+    DWORD slot = HASHINDEX_Find(&pEngine->units, unitId);
+    DWORD head = slot != NONE ? pEngine->units.pValues[slot] : NONE;
+    for (DWORD e = head; e != NONE; e = pEngine->entNext[e])
+    {
+        if (pEngine->entSkill[e] == skillId)
+        {
+            return e;
+        }
+    }
+
+    DWORD e = pEngine->entryFree;
+    if (e >= pEngine->entryCapacity)
+    {
+        return NONE;
+    }
+    pEngine->entryFree = pEngine->entNext[e];
+    pEngine->entryCount++;
+
+    pEngine->entUnit[e] = unitId;
+    pEngine->entSkill[e] = skillId;
+    pEngine->entLevel[e] = 0;
+    pEngine->entCooldownEnd[e] = pEngine->tick;
+    pEngine->entFlags[e] = 0;
+    pEngine->entNext[e] = head;
+    if (slot == NONE)
+    {
+        HASHINDEX_Insert(&pEngine->units, unitId, e);
+    }
+    else
+    {
+        pEngine->units.pValues[slot] = e;
+    }
+    return e;
+}
+
+// Frees an entry with no skill and no effect left
+static void ReleaseEntry(SkillEngine *pEngine, DWORD e)
+{
+    DWORD slot = HASHINDEX_Find(&pEngine->units, pEngine->entUnit[e]);
+    DWORD *pLink = &pEngine->units.pValues[slot];
+    while (*pLink != e)
+    {
+        pLink = &pEngine->entNext[*pLink];
+    }
+    *pLink = pEngine->entNext[e];
+    if (pEngine->units.pValues[slot] == NONE)
+    {
+        HASHINDEX_Erase(&pEngine->units, slot);
+    }
+
+    pEngine->entNext[e] = pEngine->entryFree;
+    pEngine->entryFree = e;
+    pEngine->entryCount--;
+}
+
+// =============================================================================
+// TIMING WHEEL
+// =============================================================================
+
+static void WheelInsert(SkillEngine *pEngine, DWORD e)
+{
+    DWORD *pHead = &pEngine->wheel[pEngine->entExpire[e] & pEngine->wheelMask];
+    pEngine->entWheelPrev[e] = NONE;
+    pEngine->entWheelNext[e] = *pHead;
+    if (*pHead != NONE)
+    {
+        pEngine->entWheelPrev[*pHead] = e;
+    }
+    *pHead = e;
+    pEngine->effectCount++;
+}
+
+static void WheelUnlink(SkillEngine *pEngine, DWORD e)
+{
+    DWORD prev = pEngine->entWheelPrev[e];
+    DWORD next = pEngine->entWheelNext[e];
+    if (prev != NONE)
+    {
+        pEngine->entWheelNext[prev] = next;
+    }
+    else
+    {
+        pEngine->wheel[pEngine->entExpire[e] & pEngine->wheelMask] = next;
+    }
+    if (next != NONE)
+    {
+        pEngine->entWheelPrev[next] = prev;
+    }
+    pEngine->effectCount--;
+}
+
+static DWORD FireEffects(SkillEngine *pEngine)
+{
+    DWORD events = 0;
+    DWORD now = pEngine->tick;
+    DWORD e = pEngine->wheel[now & pEngine->wheelMask];
+    while (e != NONE)
+    {
+        DWORD next = pEngine->entWheelNext[e];
+        pEngine->wheelVisits++;
+        if (pEngine->entExpire[e] == now)
+        {
+            WheelUnlink(pEngine, e);
+            pEngine->entFlags[e] &= ~ENTRY_EFFECT;
+            EffectEvent *pEvent = &pEngine->effectEvents[events++];
+            pEvent->unitId = pEngine->entUnit[e];
+            pEvent->skillId = pEngine->entSkill[e];
+            if (!pEngine->entFlags[e])
+            {
+                ReleaseEntry(pEngine, e);
+            }
+        }
+        e = next;
+    }
+    pEngine->effectsFired += events;
+    return events;
+}
+
+// =============================================================================
+// SKILLS AND EFFECTS
+// =============================================================================
+
+BOOL __cdecl SKILLENG_SetSkillLevel(SkillEngine *pEngine, DWORD unitId, DWORD skillId, DWORD level)
+{
+    if (!level)
+    {
+        DWORD e = FindEntry(pEngine, unitId, skillId);
+        if (e != NONE)
+        {
+            pEngine->entLevel[e] = 0;
+            pEngine->entFlags[e] &= ~ENTRY_SKILL;
+            if (!pEngine->entFlags[e])
+            {
+                ReleaseEntry(pEngine, e);
+            }
+        }
+        return TRUE;
+    }
+
+    DWORD e = FindOrAddEntry(pEngine, unitId, skillId);
+    if (e == NONE)
+    {
+        return FALSE;
+    }
+    pEngine->entLevel[e] = level;
+    pEngine->entFlags[e] |= ENTRY_SKILL;
+    return TRUE;
+}
+
+DWORD __cdecl SKILLENG_GetSkillLevel(const SkillEngine *pEngine, DWORD unitId, DWORD skillId)
+{
+    DWORD e = FindEntry(pEngine, unitId, skillId);
+    return e == NONE ? 0 : pEngine->entLevel[e];
+}
+
+BOOL __cdecl SKILLENG_StartCooldown(SkillEngine *pEngine, DWORD unitId, DWORD skillId, DWORD ticks)
+{
+    DWORD e = FindEntry(pEngine, unitId, skillId);
+    if (e == NONE || !(pEngine->entFlags[e] & ENTRY_SKILL))
+    {
+        return FALSE;
+    }
+    pEngine->entCooldownEnd[e] = pEngine->tick + ticks;
+    return TRUE;
+}
+
+BOOL __cdecl SKILLENG_CanActivateSkill(const SkillEngine *pEngine, DWORD unitId, DWORD skillId)
+{
+    DWORD e = FindEntry(pEngine, unitId, skillId);
+    return e != NONE && pEngine->entLevel[e] && (int)(pEngine->entCooldownEnd[e] - pEngine->tick) <= 0;
+}
+
+BOOL __cdecl SKILLENG_SetTimedEffect(SkillEngine *pEngine, DWORD unitId, DWORD skillId, DWORD duration)
+{
+    if (!duration)
+    {
+        DWORD e = FindEntry(pEngine, unitId, skillId);
+        if (e != NONE && (pEngine->entFlags[e] & ENTRY_EFFECT))
+        {
+            WheelUnlink(pEngine, e);
+            pEngine->entFlags[e] &= ~ENTRY_EFFECT;
+            if (!pEngine->entFlags[e])
+            {
+                ReleaseEntry(pEngine, e);
+            }
+        }
+        return TRUE;
+    }
+
+    DWORD e = FindOrAddEntry(pEngine, unitId, skillId);
+    if (e == NONE)
+    {
+        return FALSE;
+    }
+    if (pEngine->entFlags[e] & ENTRY_EFFECT)
+    {
+        WheelUnlink(pEngine, e);
+    }
+    pEngine->entExpire[e] = pEngine->tick + duration;
+    pEngine->entFlags[e] |= ENTRY_EFFECT;
+    WheelInsert(pEngine, e);
+    return TRUE;
+}
+
+DWORD __cdecl SKILLENG_GetEffectRemaining(const SkillEngine *pEngine, DWORD unitId, DWORD skillId)
+{
+    DWORD e = FindEntry(pEngine, unitId, skillId);
+    if (e == NONE || !(pEngine->entFlags[e] & ENTRY_EFFECT))
+    {
+        return 0;
+    }
+    return pEngine->entExpire[e] - pEngine->tick;
+}
+
+void __cdecl SKILLENG_RemoveUnit(SkillEngine *pEngine, DWORD unitId)
+{
+    DWORD slot = HASHINDEX_Find(&pEngine->units, unitId);
+    if (slot == NONE)
+    {
+        return;
+    }
+
+    DWORD e = pEngine->units.pValues[slot];
+    while (e != NONE)
+    {
+        DWORD next = pEngine->entNext[e];
+        if (pEngine->entFlags[e] & ENTRY_EFFECT)
+        {
+            WheelUnlink(pEngine, e);
+        }
+        pEngine->entNext[e] = pEngine->entryFree;
+        pEngine->entryFree = e;
+        pEngine->entryCount--;
+        e = next;
+    }
+    HASHINDEX_Erase(&pEngine->units, slot);
+}
+
+// =============================================================================
+// TICK
+// =============================================================================
+
+void __cdecl SKILLENG_Tick(SkillEngine *pEngine, SkillTickResult *pResult)
+{
+    DWORD moved;
+    DWORD missileEnds = AdvanceMissiles(pEngine, &moved);
+    pEngine->missilesEnded += missileEnds;
+
+    pEngine->tick++;
+    DWORD effectEnds = FireEffects(pEngine);
+
+    if (pResult)
+    {
+        pResult->tick = pEngine->tick;
+        pResult->missilesMoved = moved;
+        pResult->pMissileEnds = pEngine->missileEvents;
+        pResult->missileEnds = missileEnds;
+        pResult->pEffectEnds = pEngine->effectEvents;
+        pResult->effectEnds = effectEnds;
+    }
+}
+
+void __cdecl SKILLENG_GetStats(const SkillEngine *pEngine, SkillEngineStats *pStats)
+{
+    pStats->missiles = pEngine->missileCount;
+    pStats->entries = pEngine->entryCount;
+    pStats->units = pEngine->units.count;
+    pStats->effects = pEngine->effectCount;
+    pStats->wheelVisits = pEngine->wheelVisits;
+    pStats->effectsFired = pEngine->effectsFired;
+    pStats->missilesEnded = pEngine->missilesEnded;
+}
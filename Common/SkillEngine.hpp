@@ -0,0 +1,159 @@
+/*
+ * SkillEngine.hpp - D2Common batched skill and missile engine
+ *
+ * Every live missile in D2 is a full Unit on the room lists, updated by
+ * calling its missile type's handler through the unit dispatch each tick,
+ * and every timed skill effect (AddOrRemoveTimedSkillEffect: auras, curses,
+ * buffs) is found again by walking each unit's skill and state lists to see
+ * whether it has run out. With a few thousand Blizzard shards or Blessed
+ * Hammers in the air the per-object dispatch dominates, and idle effects
+ * cost a scan every tick whether or not anything expires.
+ *
+ * The engine keeps:
+ *   missiles - one pool per missile type, with position, velocity, range
+ *              left and lifetime in packed parallel arrays. A tick advances
+ *              each pool four missiles at a time (SSE2, with a
+ *              bit-identical scalar fallback) using the type's constant
+ *              speed, then swap-removes the ones whose range or lifetime ran
+ *              out and reports them.
+ *   skills   - per unit (D2 unit GUID) entries of skill level, cooldown and
+ *              timed effect, looked up through an open-addressed unit table.
+ *   effects  - a hashed timing wheel: an effect sits in the slot of its
+ *              expiry tick, so a tick visits one slot instead of every unit.
+ *              Effects longer than the wheel stay in their slot until their
+ *              round comes up.
+ *
+ * Missiles are referenced by generational handles (see UnitStore.hpp); dense
+ * indices change on every removal. Events reported by SKILLENG_Tick stay
+ * valid until the next tick. Game thread only; one engine per game.
+ */
+
+#ifndef SKILLENGINE_HPP
+#define SKILLENGINE_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef DWORD MissileHandle;
+
+#define MISSILE_INVALID_HANDLE 0xFFFFFFFF
+
+// Handle layout: low MISSILE_HANDLE_INDEX_BITS = slot, the rest = generation
+#define MISSILE_HANDLE_INDEX_BITS 20
+#define MISSILE_MAX_CAPACITY (1u << MISSILE_HANDLE_INDEX_BITS)
+
+// MissileEvent reasons
+#define MISSILE_END_RANGE 1    // Travelled its range
+#define MISSILE_END_LIFETIME 2 // Ran out of ticks (checked after range)
+
+typedef struct SkillEngineDesc
+{
+    DWORD missileTypes;    // Missile type ids [0, missileTypes) (0 = 512)
+    DWORD missileCapacity; // Maximum live missiles (0 = 16384), at most MISSILE_MAX_CAPACITY
+    DWORD entryCapacity;   // Maximum unit skill/effect entries (0 = 65536)
+    DWORD wheelSlots;      // Timing wheel size in ticks, rounded up to a power of two (0 = 512)
+    BOOL forceScalar;      // Disable the SIMD missile update (verification)
+} SkillEngineDesc;
+
+typedef struct MissileTypeDesc
+{
+    float speed;    // Subtiles per tick
+    float range;    // Subtiles travelled before it ends (0 = unlimited)
+    DWORD lifetime; // Ticks before it ends (0 = unlimited)
+} MissileTypeDesc;
+
+// Dense arrays of one missile type, valid until the next spawn/remove/tick
+typedef struct MissilePoolView
+{
+    DWORD count;
+    float *x;
+    float *y;
+    const float *vx;
+    const float *vy;
+    const float *rangeLeft;
+    const int *lifeLeft;
+    const DWORD *owner;
+    const MissileHandle *handles;
+} MissilePoolView;
+
+typedef struct MissileEvent
+{
+    MissileHandle handle; // Already stale when reported
+    DWORD owner;
+    WORD type;
+    WORD reason; // MISSILE_END_*
+    float x;     // Final position
+    float y;
+} MissileEvent;
+
+typedef struct EffectEvent
+{
+    DWORD unitId;
+    DWORD skillId;
+} EffectEvent;
+
+typedef struct SkillTickResult
+{
+    DWORD tick;
+    DWORD missilesMoved;
+    const MissileEvent *pMissileEnds;
+    DWORD missileEnds;
+    const EffectEvent *pEffectEnds;
+    DWORD effectEnds;
+} SkillTickResult;
+
+typedef struct SkillEngineStats
+{
+    DWORD missiles;
+    DWORD entries;
+    DWORD units;
+    DWORD effects;
+    uint64_t wheelVisits; // Effect entries looked at while firing
+    uint64_t effectsFired;
+    uint64_t missilesEnded;
+} SkillEngineStats;
+
+typedef struct SkillEngine SkillEngine;
+
+SkillEngine *__cdecl SKILLENG_Create(const SkillEngineDesc *pDesc);
+void __cdecl SKILLENG_Destroy(SkillEngine *pEngine);
+DWORD __cdecl SKILLENG_GetTick(const SkillEngine *pEngine);
+
+// Missiles
+BOOL __cdecl SKILLENG_SetMissileType(SkillEngine *pEngine, DWORD type, const MissileTypeDesc *pDesc);
+// Aimed from (x, y) toward (targetX, targetY) at the type's speed; a zero
+// direction spawns it stationary. MISSILE_INVALID_HANDLE when full.
+MissileHandle __cdecl SKILLENG_SpawnMissile(SkillEngine *pEngine, DWORD type, DWORD owner, float x, float y,
+                                            float targetX, float targetY);
+// Removes without an event (hit, collision)
+BOOL __cdecl SKILLENG_RemoveMissile(SkillEngine *pEngine, MissileHandle handle);
+BOOL __cdecl SKILLENG_IsMissileAlive(const SkillEngine *pEngine, MissileHandle handle);
+BOOL __cdecl SKILLENG_GetMissilePool(SkillEngine *pEngine, DWORD type, MissilePoolView *pView);
+
+// Skills (AddSkillToUnit, CanUnitActivateSkill); FALSE when the entry pool is full
+BOOL __cdecl SKILLENG_SetSkillLevel(SkillEngine *pEngine, DWORD unitId, DWORD skillId, DWORD level);
+DWORD __cdecl SKILLENG_GetSkillLevel(const SkillEngine *pEngine, DWORD unitId, DWORD skillId);
+BOOL __cdecl SKILLENG_StartCooldown(SkillEngine *pEngine, DWORD unitId, DWORD skillId, DWORD ticks);
+// Has the skill at level 1+ and no cooldown running
+BOOL __cdecl SKILLENG_CanActivateSkill(const SkillEngine *pEngine, DWORD unitId, DWORD skillId);
+
+/*
+ * AddOrRemoveTimedSkillEffect: a nonzero duration starts or refreshes the
+ * effect to end duration ticks from now, 0 removes it without an event.
+ * The unit does not need the skill (curses). FALSE when the pool is full.
+ */
+BOOL __cdecl SKILLENG_SetTimedEffect(SkillEngine *pEngine, DWORD unitId, DWORD skillId, DWORD duration);
+// Ticks until the effect ends, 0 when not active
+DWORD __cdecl SKILLENG_GetEffectRemaining(const SkillEngine *pEngine, DWORD unitId, DWORD skillId);
+// Drops a unit's skills and effects without events (death, leaving the game)
+void __cdecl SKILLENG_RemoveUnit(SkillEngine *pEngine, DWORD unitId);
+
+/*
+ * Advance one tick: move every missile and end the ones out of range or
+ * lifetime, then fire the effects that end on the new tick. Do not spawn or
+ * remove missiles from inside a loop over a pool view.
+ */
+void __cdecl SKILLENG_Tick(SkillEngine *pEngine, SkillTickResult *pResult);
+
+void __cdecl SKILLENG_GetStats(const SkillEngine *pEngine, SkillEngineStats *pStats);
+
+#endif // SKILLENGINE_HPP
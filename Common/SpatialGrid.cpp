@@ -0,0 +1,583 @@
+/*
+ * SpatialGrid.cpp - D2Common per-level spatial index for area queries
+ *
+ * See SpatialGrid.hpp. Each cell owns one allocation holding its x, y, type,
+ * id and handle arrays back to back; capacity is always a multiple of four
+ * so the SIMD filter can load whole groups and mask off the tail.
+ */
+
+#include "SpatialGrid.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CELL_SIZE 16
+#define DEFAULT_CAPACITY 4096
+#define MIN_CELL_CAPACITY 8
+
+#define ENTRY_FREE 0xFFFFFFFF
+
+typedef struct SpatialCell
+{
+    float *x;
+    float *y;
+    DWORD *type;
+    DWORD *id;
+    DWORD *handle; // Back-reference so swap-remove can patch the moved entry
+    DWORD count;
+    DWORD capacity;
+} SpatialCell;
+
+typedef struct SpatialEntry
+{
+    DWORD cell; // ENTRY_FREE when unused
+    DWORD slot; // Index in the cell, or next free entry
+} SpatialEntry;
+
+struct SpatialGrid
+{
+    float originX;
+    float originY;
+    DWORD shift;
+    float invCellSize;
+    DWORD cellsX;
+    DWORD cellsY;
+    SpatialCell *cells;
+
+    SpatialEntry *entries;
+    DWORD capacity;
+    DWORD freeHead;
+
+    // QueryRadiusBatch: (cell << 32 | query) keys, sorted to visit cells in order
+    uint64_t *batchKeys;
+    DWORD batchCapacity;
+
+    BOOL simd;
+    SpatialGridStats stats;
+};
+
+// =============================================================================
+// CELLS
+// =============================================================================
+
+static BOOL GrowCell(SpatialCell *pCell)
+{
+    DWORD capacity = pCell->capacity ? pCell->capacity * 2 : MIN_CELL_CAPACITY;
+    BYTE *pBlock = (BYTE *)malloc((size_t)capacity * 5 * sizeof(DWORD));
+    if (!pBlock)
+    {
+        return FALSE;
+    }
+
+    float *x = (float *)pBlock;
+    float *y = x + capacity;
+    DWORD *type = (DWORD *)(y + capacity);
+    DWORD *id = type + capacity;
+    DWORD *handle = id + capacity;
+
+    // Tail lanes are masked, but keep them initialised
+    memset(pBlock, 0, (size_t)capacity * 5 * sizeof(DWORD));
+    if (pCell->count)
+    {
+        memcpy(x, pCell->x, pCell->count * sizeof(float));
+        memcpy(y, pCell->y, pCell->count * sizeof(float));
+        memcpy(type, pCell->type, pCell->count * sizeof(DWORD));
+        memcpy(id, pCell->id, pCell->count * sizeof(DWORD));
+        memcpy(handle, pCell->handle, pCell->count * sizeof(DWORD));
+    }
+    free(pCell->x);
+
+    pCell->x = x;
+    pCell->y = y;
+    pCell->type = type;
+    pCell->id = id;
+    pCell->handle = handle;
+    pCell->capacity = capacity;
+    return TRUE;
+}
+
+static int CellCoord(float value, float origin, float invCellSize, DWORD cells)
+{
+    int c = (int)floorf((value - origin) * invCellSize);
+    if (c < 0)
+        return 0;
+    if (c >= (int)cells)
+        return (int)cells - 1;
+    return c;
+}
+
+static DWORD CellIndex(const SpatialGrid *pGrid, float x, float y)
+{
+    int cx = CellCoord(x, pGrid->originX, pGrid->invCellSize, pGrid->cellsX);
+    int cy = CellCoord(y, pGrid->originY, pGrid->invCellSize, pGrid->cellsY);
+    return (DWORD)cy * pGrid->cellsX + (DWORD)cx;
+}
+
+static BOOL CellAppend(SpatialGrid *pGrid, DWORD cellIndex, DWORD handle, DWORD id, DWORD type, float x, float y)
+{
+    SpatialCell *pCell = &pGrid->cells[cellIndex];
+    if (pCell->count == pCell->capacity && !GrowCell(pCell))
+    {
+        return FALSE;
+    }
+
+    DWORD slot = pCell->count++;
+    pCell->x[slot] = x;
+    pCell->y[slot] = y;
+    pCell->type[slot] = type;
+    pCell->id[slot] = id;
+    pCell->handle[slot] = handle;
+
+    pGrid->entries[handle].cell = cellIndex;
+    pGrid->entries[handle].slot = slot;
+    return TRUE;
+}
+
+static void CellRemove(SpatialGrid *pGrid, DWORD cellIndex, DWORD slot)
+{
+    SpatialCell *pCell = &pGrid->cells[cellIndex];
+    DWORD last = --pCell->count;
+    if (slot != last)
+    {
+        pCell->x[slot] = pCell->x[last];
+        pCell->y[slot] = pCell->y[last];
+        pCell->type[slot] = pCell->type[last];
+        pCell->id[slot] = pCell->id[last];
+        pCell->handle[slot] = pCell->handle[last];
+        pGrid->entries[pCell->handle[slot]].slot = slot;
+    }
+}
+
+// =============================================================================
+// CELL FILTERS
+// =============================================================================
+
+static inline void Emit(DWORD id, DWORD *pOut, DWORD maxOut, DWORD *pTotal)
+{
+    if (*pTotal < maxOut)
+    {
+        pOut[*pTotal] = id;
+    }
+    (*pTotal)++;
+}
+
+static void FilterRadiusScalar(const SpatialCell *pCell, float x, float y, float r2, DWORD typeMask, DWORD *pOut,
+                               DWORD maxOut, DWORD *pTotal)
+{
+    for (DWORD i = 0; i < pCell->count; i++)
+    {
+        float dx = pCell->x[i] - x;
+        float dy = pCell->y[i] - y;
+        float d2 = dx * dx + dy * dy;
+        if (d2 <= r2 && (pCell->type[i] & typeMask))
+        {
+            Emit(pCell->id[i], pOut, maxOut, pTotal);
+        }
+    }
+}
+
+static void FilterBoxScalar(const SpatialCell *pCell, float x0, float y0, float x1, float y1, DWORD typeMask,
+                            DWORD *pOut, DWORD maxOut, DWORD *pTotal)
+{
+    for (DWORD i = 0; i < pCell->count; i++)
+    {
+        float px = pCell->x[i];
+        float py = pCell->y[i];
+        if (px >= x0 && px <= x1 && py >= y0 && py <= y1 && (pCell->type[i] & typeMask))
+        {
+            Emit(pCell->id[i], pOut, maxOut, pTotal);
+        }
+    }
+}
+
+#if D2_SIMD_SSE2
+
+static inline void EmitLanes(const SpatialCell *pCell, DWORD base, int bits, DWORD *pOut, DWORD maxOut,
+                             DWORD *pTotal)
+{
+    DWORD remaining = pCell->count - base;
+    if (remaining < 4)
+    {
+        bits &= (1 << remaining) - 1;
+    }
+    for (DWORD lane = 0; bits; lane++, bits >>= 1)
+    {
+        if (bits & 1)
+        {
+            Emit(pCell->id[base + lane], pOut, maxOut, pTotal);
+        }
+    }
+}
+
+static inline int TypeBits(const DWORD *pType, __m128i typeMask)
+{
+    __m128i t = _mm_and_si128(_mm_loadu_si128((const __m128i *)pType), typeMask);
+    __m128i none = _mm_cmpeq_epi32(t, _mm_setzero_si128());
+    return ~_mm_movemask_ps(_mm_castsi128_ps(none)) & 0xF;
+}
+
+static void FilterRadiusSse2(const SpatialCell *pCell, float x, float y, float r2, DWORD typeMask, DWORD *pOut,
+                             DWORD maxOut, DWORD *pTotal)
+{
+    const __m128 cx = _mm_set1_ps(x);
+    const __m128 cy = _mm_set1_ps(y);
+    const __m128 limit = _mm_set1_ps(r2);
+    const __m128i mask = _mm_set1_epi32((int)typeMask);
+
+    for (DWORD i = 0; i < pCell->count; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(pCell->x + i), cx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(pCell->y + i), cy);
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        int bits = _mm_movemask_ps(_mm_cmple_ps(d2, limit)) & TypeBits(pCell->type + i, mask);
+        if (bits)
+        {
+            EmitLanes(pCell, i, bits, pOut, maxOut, pTotal);
+        }
+    }
+}
+
+static void FilterBoxSse2(const SpatialCell *pCell, float x0, float y0, float x1, float y1, DWORD typeMask,
+                          DWORD *pOut, DWORD maxOut, DWORD *pTotal)
+{
+    const __m128 minX = _mm_set1_ps(x0);
+    const __m128 minY = _mm_set1_ps(y0);
+    const __m128 maxX = _mm_set1_ps(x1);
+    const __m128 maxY = _mm_set1_ps(y1);
+    const __m128i mask = _mm_set1_epi32((int)typeMask);
+
+    for (DWORD i = 0; i < pCell->count; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(pCell->x + i);
+        __m128 py = _mm_loadu_ps(pCell->y + i);
+        __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, minX), _mm_cmple_ps(px, maxX)),
+                               _mm_and_ps(_mm_cmpge_ps(py, minY), _mm_cmple_ps(py, maxY)));
+        int bits = _mm_movemask_ps(in) & TypeBits(pCell->type + i, mask);
+        if (bits)
+        {
+            EmitLanes(pCell, i, bits, pOut, maxOut, pTotal);
+        }
+    }
+}
+
+#endif // D2_SIMD_SSE2
+
+// =============================================================================
+// LIFETIME
+// =============================================================================
+
+SpatialGrid *__cdecl SPATIALGRID_Create(const SpatialGridDesc *pDesc)
+{
+    if (!pDesc || !pDesc->width || !pDesc->height)
+    {
+        return NULL;
+    }
+
+    SpatialGrid *pGrid = (SpatialGrid *)calloc(1, sizeof(SpatialGrid));
+    if (!pGrid)
+    {
+        return NULL;
+    }
+
+    DWORD cellSize = D2_NextPow2(pDesc->cellSize ? pDesc->cellSize : DEFAULT_CELL_SIZE);
+    while ((1u << pGrid->shift) < cellSize)
+    {
+        pGrid->shift++;
+    }
+
+    pGrid->originX = (float)pDesc->originX;
+    pGrid->originY = (float)pDesc->originY;
+    pGrid->invCellSize = 1.0f / (float)cellSize;
+    pGrid->cellsX = (pDesc->width + cellSize - 1) >> pGrid->shift;
+    pGrid->cellsY = (pDesc->height + cellSize - 1) >> pGrid->shift;
+    pGrid->capacity = pDesc->capacity ? pDesc->capacity : DEFAULT_CAPACITY;
+    pGrid->simd = D2_SIMD_SSE2 && !pDesc->forceScalar;
+
+    pGrid->cells = (SpatialCell *)calloc((size_t)pGrid->cellsX * pGrid->cellsY, sizeof(SpatialCell));
+    pGrid->entries = (SpatialEntry *)malloc(pGrid->capacity * sizeof(SpatialEntry));
+    if (!pGrid->cells || !pGrid->entries)
+    {
+        SPATIALGRID_Destroy(pGrid);
+        return NULL;
+    }
+
+    SPATIALGRID_Clear(pGrid);
+    return pGrid;
+}
+
+void __cdecl SPATIALGRID_Destroy(SpatialGrid *pGrid)
+{
+    if (!pGrid)
+    {
+        return;
+    }
+
+    if (pGrid->cells)
+    {
+        for (DWORD i = 0; i < pGrid->cellsX * pGrid->cellsY; i++)
+        {
+            free(pGrid->cells[i].x);
+        }
+    }
+    free(pGrid->cells);
+    free(pGrid->entries);
+    free(pGrid->batchKeys);
+    free(pGrid);
+}
+
+BOOL __cdecl SPATIALGRID_IsSimd(const SpatialGrid *pGrid)
+{
+    return pGrid->simd;
+}
+
+void __cdecl SPATIALGRID_Clear(SpatialGrid *pGrid)
+{
+    for (DWORD i = 0; i < pGrid->cellsX * pGrid->cellsY; i++)
+    {
+        pGrid->cells[i].count = 0;
+    }
+
+    for (DWORD i = 0; i < pGrid->capacity; i++)
+    {
+        pGrid->entries[i].cell = ENTRY_FREE;
+        pGrid->entries[i].slot = i + 1;
+    }
+    pGrid->freeHead = 0;
+    pGrid->stats.entries = 0;
+}
+
+// =============================================================================
+// UPDATES
+// =============================================================================
+
+DWORD __cdecl SPATIALGRID_Insert(SpatialGrid *pGrid, DWORD id, DWORD type, float x, float y)
+{
+    DWORD handle = pGrid->freeHead;
+    if (handle >= pGrid->capacity)
+    {
+        return SPATIAL_INVALID_HANDLE;
+    }
+
+    DWORD nextFree = pGrid->entries[handle].slot;
+    if (!CellAppend(pGrid, CellIndex(pGrid, x, y), handle, id, type, x, y))
+    {
+        return SPATIAL_INVALID_HANDLE;
+    }
+
+    pGrid->freeHead = nextFree;
+    pGrid->stats.entries++;
+    return handle;
+}
+
+void __cdecl SPATIALGRID_Move(SpatialGrid *pGrid, DWORD handle, float x, float y)
+{
+    if (handle >= pGrid->capacity || pGrid->entries[handle].cell == ENTRY_FREE)
+    {
+        return;
+    }
+
+    SpatialEntry *pEntry = &pGrid->entries[handle];
+    DWORD cellIndex = CellIndex(pGrid, x, y);
+    pGrid->stats.moves++;
+
+    if (cellIndex == pEntry->cell)
+    {
+        SpatialCell *pCell = &pGrid->cells[cellIndex];
+        pCell->x[pEntry->slot] = x;
+        pCell->y[pEntry->slot] = y;
+        return;
+    }
+
+    // Reserve room first so a failed grow leaves the entry where it was
+    SpatialCell *pTarget = &pGrid->cells[cellIndex];
+    if (pTarget->count == pTarget->capacity && !GrowCell(pTarget))
+    {
+        return;
+    }
+
+    SpatialCell *pSource = &pGrid->cells[pEntry->cell];
+    DWORD id = pSource->id[pEntry->slot];
+    DWORD type = pSource->type[pEntry->slot];
+    CellRemove(pGrid, pEntry->cell, pEntry->slot);
+    CellAppend(pGrid, cellIndex, handle, id, type, x, y);
+    pGrid->stats.cellChanges++;
+}
+
+void __cdecl SPATIALGRID_Remove(SpatialGrid *pGrid, DWORD handle)
+{
+    if (handle >= pGrid->capacity || pGrid->entries[handle].cell == ENTRY_FREE)
+    {
+        return;
+    }
+
+    SpatialEntry *pEntry = &pGrid->entries[handle];
+    CellRemove(pGrid, pEntry->cell, pEntry->slot);
+    pEntry->cell = ENTRY_FREE;
+    pEntry->slot = pGrid->freeHead;
+    pGrid->freeHead = handle;
+    pGrid->stats.entries--;
+}
+
+// =============================================================================
+// QUERIES
+// =============================================================================
+
+DWORD __cdecl SPATIALGRID_QueryRadius(SpatialGrid *pGrid, float x, float y, float radius, DWORD typeMask,
+                                      DWORD *pOut, DWORD maxOut)
+{
+    int cx0 = CellCoord(x - radius, pGrid->originX, pGrid->invCellSize, pGrid->cellsX);
+    int cx1 = CellCoord(x + radius, pGrid->originX, pGrid->invCellSize, pGrid->cellsX);
+    int cy0 = CellCoord(y - radius, pGrid->originY, pGrid->invCellSize, pGrid->cellsY);
+    int cy1 = CellCoord(y + radius, pGrid->originY, pGrid->invCellSize, pGrid->cellsY);
+    float r2 = radius * radius;
+    DWORD total = 0;
+    DWORD tested = 0;
+
+    for (int cy = cy0; cy <= cy1; cy++)
+    {
+        const SpatialCell *pCell = &pGrid->cells[(DWORD)cy * pGrid->cellsX + (DWORD)cx0];
+        for (int cx = cx0; cx <= cx1; cx++, pCell++)
+        {
+            if (!pCell->count)
+            {
+                continue;
+            }
+            tested += pCell->count;
+#if D2_SIMD_SSE2
+            if (pGrid->simd)
+            {
+                FilterRadiusSse2(pCell, x, y, r2, typeMask, pOut, maxOut, &total);
+                continue;
+            }
+#endif
+            FilterRadiusScalar(pCell, x, y, r2, typeMask, pOut, maxOut, &total);
+        }
+    }
+
+    pGrid->stats.queries++;
+    pGrid->stats.cellsVisited += (DWORD)((cx1 - cx0 + 1) * (cy1 - cy0 + 1));
+    pGrid->stats.candidates += tested;
+    pGrid->stats.hits += total;
+    return total;
+}
+
+DWORD __cdecl SPATIALGRID_QueryBox(SpatialGrid *pGrid, float x0, float y0, float x1, float y1, DWORD typeMask,
+                                   DWORD *pOut, DWORD maxOut)
+{
+    int cx0 = CellCoord(x0, pGrid->originX, pGrid->invCellSize, pGrid->cellsX);
+    int cx1 = CellCoord(x1, pGrid->originX, pGrid->invCellSize, pGrid->cellsX);
+    int cy0 = CellCoord(y0, pGrid->originY, pGrid->invCellSize, pGrid->cellsY);
+    int cy1 = CellCoord(y1, pGrid->originY, pGrid->invCellSize, pGrid->cellsY);
+    DWORD total = 0;
+    DWORD tested = 0;
+
+    if (x1 < x0 || y1 < y0)
+    {
+        return 0;
+    }
+
+    for (int cy = cy0; cy <= cy1; cy++)
+    {
+        const SpatialCell *pCell = &pGrid->cells[(DWORD)cy * pGrid->cellsX + (DWORD)cx0];
+        for (int cx = cx0; cx <= cx1; cx++, pCell++)
+        {
+            if (!pCell->count)
+            {
+                continue;
+            }
+            tested += pCell->count;
+#if D2_SIMD_SSE2
+            if (pGrid->simd)
+            {
+                FilterBoxSse2(pCell, x0, y0, x1, y1, typeMask, pOut, maxOut, &total);
+                continue;
+            }
+#endif
+            FilterBoxScalar(pCell, x0, y0, x1, y1, typeMask, pOut, maxOut, &total);
+        }
+    }
+
+    pGrid->stats.queries++;
+    pGrid->stats.cellsVisited += (DWORD)((cx1 - cx0 + 1) * (cy1 - cy0 + 1));
+    pGrid->stats.candidates += tested;
+    pGrid->stats.hits += total;
+    return total;
+}
+
+static int CompareBatchKeys(const void *pA, const void *pB)
+{
+    uint64_t a = *(const uint64_t *)pA;
+    uint64_t b = *(const uint64_t *)pB;
+    return (a > b) - (a < b);
+}
+
+static BOOL ReserveBatch(SpatialGrid *pGrid, DWORD queryCount)
+{
+    if (queryCount <= pGrid->batchCapacity)
+    {
+        return TRUE;
+    }
+
+    DWORD capacity = D2_NextPow2(queryCount);
+    uint64_t *pKeys = (uint64_t *)malloc(capacity * sizeof(uint64_t));
+    if (!pKeys)
+    {
+        return FALSE;
+    }
+
+    free(pGrid->batchKeys);
+    pGrid->batchKeys = pKeys;
+    pGrid->batchCapacity = capacity;
+    return TRUE;
+}
+
+DWORD __cdecl SPATIALGRID_QueryRadiusBatch(SpatialGrid *pGrid, const SpatialQuery *pQueries, DWORD queryCount,
+                                           DWORD *pOut, DWORD maxOut, DWORD *pOffsets, DWORD *pCounts,
+                                           BOOL *pOverflow)
+{
+    DWORD written = 0;
+    if (pOverflow)
+    {
+        *pOverflow = FALSE;
+    }
+
+    // Visit queries in cell order so neighbouring queries reuse warm cells;
+    // without scratch memory they simply run in submission order
+    BOOL sorted = queryCount > 1 && ReserveBatch(pGrid, queryCount);
+    if (sorted)
+    {
+        for (DWORD i = 0; i < queryCount; i++)
+        {
+            pGrid->batchKeys[i] = ((uint64_t)CellIndex(pGrid, pQueries[i].x, pQueries[i].y) << 32) | i;
+        }
+        qsort(pGrid->batchKeys, queryCount, sizeof(uint64_t), CompareBatchKeys);
+    }
+
+    for (DWORD n = 0; n < queryCount; n++)
+    {
+        DWORD q = sorted ? (DWORD)pGrid->batchKeys[n] : n;
+        const SpatialQuery *pQuery = &pQueries[q];
+        DWORD count = SPATIALGRID_QueryRadius(pGrid, pQuery->x, pQuery->y, pQuery->radius, pQuery->typeMask,
+                                              pOut + written, maxOut - written);
+
+        pOffsets[q] = written;
+        if (count > maxOut - written)
+        {
+            // Partial results are not reported
+            count = 0;
+            if (pOverflow)
+            {
+                *pOverflow = TRUE;
+            }
+        }
+        pCounts[q] = count;
+        written += count;
+    }
+    return written;
+}
+
+void __cdecl SPATIALGRID_GetStats(const SpatialGrid *pGrid, SpatialGridStats *pStats)
+{
+    *pStats = pGrid->stats;
+}
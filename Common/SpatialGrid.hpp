@@ -0,0 +1,103 @@
+/*
+ * SpatialGrid.hpp - D2Common per-level spatial index for area queries
+ *
+ * ProcessUnitsInBoundingBox and the AoE/collision callers of
+ * CalculateUnitDistance walk every unit list of every room overlapping the
+ * query, chasing unit -> path pointers for each position. With a screen full
+ * of monsters and Blizzard/Blessed Hammer missiles that walk dominates the
+ * server tick.
+ *
+ * The grid keeps one uniform cell array per level. Each cell stores its
+ * occupants as packed x/y/type/id arrays, so a query touches only the cells
+ * overlapping it and filters them four candidates at a time (SSE2, with a
+ * bit-identical scalar fallback). Updates are incremental: a move inside the
+ * same cell rewrites two floats, a cell change is a swap-remove plus append.
+ *
+ * Coordinates are subtiles. Positions outside the level bounds are clamped to
+ * the border cells (queries still test the real position). Game thread only;
+ * one grid per level.
+ */
+
+#ifndef SPATIALGRID_HPP
+#define SPATIALGRID_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#define SPATIAL_INVALID_HANDLE 0xFFFFFFFF
+
+// Entry type bits, tested against a query's type mask
+#define SPATIAL_TYPE_PLAYER 0x0001
+#define SPATIAL_TYPE_MONSTER 0x0002
+#define SPATIAL_TYPE_OBJECT 0x0004
+#define SPATIAL_TYPE_MISSILE 0x0008
+#define SPATIAL_TYPE_ITEM 0x0010
+#define SPATIAL_TYPE_TILE 0x0020
+#define SPATIAL_TYPE_ALL 0xFFFFFFFF
+
+typedef struct SpatialGridDesc
+{
+    int originX;      // Level origin in subtiles
+    int originY;
+    DWORD width;      // Level size in subtiles
+    DWORD height;
+    DWORD cellSize;   // Cell edge in subtiles, rounded up to a power of two (0 = 16)
+    DWORD capacity;   // Maximum simultaneous entries (0 = 4096)
+    BOOL forceScalar; // Disable the SIMD filter (verification)
+} SpatialGridDesc;
+
+typedef struct SpatialQuery
+{
+    float x;
+    float y;
+    float radius;
+    DWORD typeMask;
+} SpatialQuery;
+
+typedef struct SpatialGridStats
+{
+    DWORD entries;
+    uint64_t moves;
+    uint64_t cellChanges;
+    uint64_t queries;
+    uint64_t cellsVisited;
+    uint64_t candidates; // Entries distance-tested
+    uint64_t hits;
+} SpatialGridStats;
+
+typedef struct SpatialGrid SpatialGrid;
+
+SpatialGrid *__cdecl SPATIALGRID_Create(const SpatialGridDesc *pDesc);
+void __cdecl SPATIALGRID_Destroy(SpatialGrid *pGrid);
+BOOL __cdecl SPATIALGRID_IsSimd(const SpatialGrid *pGrid);
+
+// id is returned by queries (unit GUID or index); returns SPATIAL_INVALID_HANDLE when full
+DWORD __cdecl SPATIALGRID_Insert(SpatialGrid *pGrid, DWORD id, DWORD type, float x, float y);
+void __cdecl SPATIALGRID_Move(SpatialGrid *pGrid, DWORD handle, float x, float y);
+void __cdecl SPATIALGRID_Remove(SpatialGrid *pGrid, DWORD handle);
+void __cdecl SPATIALGRID_Clear(SpatialGrid *pGrid);
+
+/*
+ * Queries write matching ids to pOut (up to maxOut) and return the total
+ * number of matches, which may exceed maxOut. Radius tests are inclusive:
+ * dx*dx + dy*dy <= radius*radius. Box tests are inclusive on all edges.
+ * Result order follows the cell walk and is not sorted.
+ */
+DWORD __cdecl SPATIALGRID_QueryRadius(SpatialGrid *pGrid, float x, float y, float radius, DWORD typeMask,
+                                      DWORD *pOut, DWORD maxOut);
+DWORD __cdecl SPATIALGRID_QueryBox(SpatialGrid *pGrid, float x0, float y0, float x1, float y1, DWORD typeMask,
+                                   DWORD *pOut, DWORD maxOut);
+
+/*
+ * Run many radius queries in one call (missile collision, AoE ticks).
+ * Results are packed into pOut; query i's ids are
+ * pOut[pOffsets[i] .. pOffsets[i] + pCounts[i]). Returns the number of ids
+ * written; queries that no longer fit report a count of zero and set
+ * *pOverflow (may be NULL).
+ */
+DWORD __cdecl SPATIALGRID_QueryRadiusBatch(SpatialGrid *pGrid, const SpatialQuery *pQueries, DWORD queryCount,
+                                           DWORD *pOut, DWORD maxOut, DWORD *pOffsets, DWORD *pCounts,
+                                           BOOL *pOverflow);
+
+void __cdecl SPATIALGRID_GetStats(const SpatialGrid *pGrid, SpatialGridStats *pStats);
+
+#endif // SPATIALGRID_HPP
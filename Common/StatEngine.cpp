@@ -0,0 +1,570 @@
+/*
+ * StatEngine.cpp - D2Common incremental stat aggregation
+ *
+ * See StatEngine.hpp. The schema stores rules grouped by target and a
+ * dependents list per source (compressed rows, offsets in *Start). Dirty
+ * stats wait in a binary heap ordered by topological rank, so every stat is
+ * re-derived at most once per flush and always after its inputs.
+ */
+
+#include "StatEngine.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BASE_LAYER 0
+
+struct StatSchema
+{
+    DWORD statCount;
+    StatRule *rules;    // Grouped by target
+    DWORD *ruleStart;   // statCount + 1
+    WORD *dependents;   // Targets fed by each source
+    DWORD *depStart;    // statCount + 1
+    DWORD *rank;        // Topological rank
+    WORD *order;        // Stats by rank
+};
+
+typedef struct StatLayer
+{
+    DWORD sourceId;
+    StatMod *mods;
+    DWORD count;
+    DWORD capacity;
+} StatLayer;
+
+struct StatUnit
+{
+    const StatSchema *pSchema;
+    int32_t *flat;
+    int32_t *final;
+    BYTE *dirty;
+    WORD *heap;
+    DWORD heapCount;
+
+    StatLayer *layers;
+    DWORD layerCount;
+    DWORD layerCapacity;
+
+    StatEngineStats stats;
+};
+
+// =============================================================================
+// SCHEMA
+// =============================================================================
+
+static const StatRule s_defaultRules[] = {
+    // Attributes
+    {STATOP_PER_STAT, STAT_MAXHP, STAT_VITALITY, 0, 512},
+    {STATOP_PER_STAT, STAT_MAXHP, STAT_LEVEL, 0, 512},
+    {STATOP_PER_STAT, STAT_MAXSTAMINA, STAT_VITALITY, 0, 256},
+    {STATOP_PER_STAT, STAT_MAXMANA, STAT_ENERGY, 0, 384},
+    {STATOP_PER_STAT, STAT_TOHIT, STAT_DEXTERITY, 0, 1280},
+    {STATOP_PER_STAT, STAT_ARMORCLASS, STAT_DEXTERITY, 0, 64},
+    {STATOP_PER_STAT, STAT_ITEM_MAXDAMAGE_PERCENT, STAT_STRENGTH, 0, 256},
+    {STATOP_PER_STAT, STAT_ITEM_MINDAMAGE_PERCENT, STAT_STRENGTH, 0, 256},
+    // Per-level item properties (1/8 per level, as ItemStatCost op 4)
+    {STATOP_PER_LEVEL, STAT_MAXHP, STAT_ITEM_HP_PERLEVEL, STAT_LEVEL, 32},
+    {STATOP_PER_LEVEL, STAT_MAXMANA, STAT_ITEM_MANA_PERLEVEL, STAT_LEVEL, 32},
+    {STATOP_PER_LEVEL, STAT_ARMORCLASS, STAT_ITEM_ARMOR_PERLEVEL, STAT_LEVEL, 32},
+    {STATOP_PER_LEVEL, STAT_MAXDAMAGE, STAT_ITEM_MAXDAMAGE_PERLEVEL, STAT_LEVEL, 32},
+    // Percent bonuses
+    {STATOP_PERCENT, STAT_MAXHP, STAT_ITEM_MAXHP_PERCENT, 0, 0},
+    {STATOP_PERCENT, STAT_MAXMANA, STAT_ITEM_MAXMANA_PERCENT, 0, 0},
+    {STATOP_PERCENT, STAT_ARMORCLASS, STAT_ITEM_ARMOR_PERCENT, 0, 0},
+    {STATOP_PERCENT, STAT_TOHIT, STAT_ITEM_TOHIT_PERCENT, 0, 0},
+    {STATOP_PERCENT, STAT_MAXDAMAGE, STAT_ITEM_MAXDAMAGE_PERCENT, 0, 0},
+    {STATOP_PERCENT, STAT_MINDAMAGE, STAT_ITEM_MINDAMAGE_PERCENT, 0, 0},
+};
+
+StatSchema *__cdecl STATSCHEMA_Create(DWORD statCount, const StatRule *pRules, DWORD ruleCount)
+{
+    if (!statCount || statCount > 0xFFFF)
+    {
+        return NULL;
+    }
+
+    for (DWORD r = 0; r < ruleCount; r++)
+    {
+        if (pRules[r].target >= statCount || pRules[r].source >= statCount ||
+            (pRules[r].op == STATOP_PER_LEVEL && pRules[r].aux >= statCount) || pRules[r].op > STATOP_PERCENT)
+        {
+            return NULL;
+        }
+    }
+
+    StatSchema *pSchema = (StatSchema *)calloc(1, sizeof(StatSchema));
+    if (!pSchema)
+    {
+        return NULL;
+    }
+
+    // Edges: source -> target, plus aux -> target for per-level rules
+    DWORD edgeCount = 0;
+    for (DWORD r = 0; r < ruleCount; r++)
+    {
+        edgeCount += (pRules[r].op == STATOP_PER_LEVEL) ? 2 : 1;
+    }
+
+    pSchema->statCount = statCount;
+    pSchema->rules = (StatRule *)malloc((ruleCount ? ruleCount : 1) * sizeof(StatRule));
+    pSchema->ruleStart = (DWORD *)calloc(statCount + 1, sizeof(DWORD));
+    pSchema->dependents = (WORD *)malloc((edgeCount ? edgeCount : 1) * sizeof(WORD));
+    pSchema->depStart = (DWORD *)calloc(statCount + 1, sizeof(DWORD));
+    pSchema->rank = (DWORD *)calloc(statCount, sizeof(DWORD));
+    pSchema->order = (WORD *)malloc(statCount * sizeof(WORD));
+    DWORD *pFill = (DWORD *)calloc(statCount + 1, sizeof(DWORD));
+    DWORD *pIndegree = (DWORD *)calloc(statCount, sizeof(DWORD));
+
+    if (!pSchema->rules || !pSchema->ruleStart || !pSchema->dependents || !pSchema->depStart || !pSchema->rank ||
+        !pSchema->order || !pFill || !pIndegree)
+    {
+        free(pFill);
+        free(pIndegree);
+        STATSCHEMA_Destroy(pSchema);
+        return NULL;
+    }
+
+    // Rules grouped by target (counting sort keeps declaration order)
+    for (DWORD r = 0; r < ruleCount; r++)
+    {
+        pSchema->ruleStart[pRules[r].target + 1]++;
+    }
+    for (DWORD s = 0; s < statCount; s++)
+    {
+        pSchema->ruleStart[s + 1] += pSchema->ruleStart[s];
+    }
+    memcpy(pFill, pSchema->ruleStart, (statCount + 1) * sizeof(DWORD));
+    for (DWORD r = 0; r < ruleCount; r++)
+    {
+        pSchema->rules[pFill[pRules[r].target]++] = pRules[r];
+    }
+
+    // Dependents grouped by source
+    for (DWORD r = 0; r < ruleCount; r++)
+    {
+        pSchema->depStart[pRules[r].source + 1]++;
+        if (pRules[r].op == STATOP_PER_LEVEL)
+            pSchema->depStart[pRules[r].aux + 1]++;
+    }
+    for (DWORD s = 0; s < statCount; s++)
+    {
+        pSchema->depStart[s + 1] += pSchema->depStart[s];
+    }
+    memcpy(pFill, pSchema->depStart, (statCount + 1) * sizeof(DWORD));
+    for (DWORD r = 0; r < ruleCount; r++)
+    {
+        pSchema->dependents[pFill[pRules[r].source]++] = pRules[r].target;
+        pIndegree[pRules[r].target]++;
+        if (pRules[r].op == STATOP_PER_LEVEL)
+        {
+            pSchema->dependents[pFill[pRules[r].aux]++] = pRules[r].target;
+            pIndegree[pRules[r].target]++;
+        }
+    }
+
+    // Kahn's algorithm; pFill doubles as the ready queue
+    DWORD head = 0, tail = 0;
+    for (DWORD s = 0; s < statCount; s++)
+    {
+        if (!pIndegree[s])
+            pFill[tail++] = s;
+    }
+    while (head < tail)
+    {
+        DWORD s = pFill[head];
+        pSchema->rank[s] = head;
+        pSchema->order[head++] = (WORD)s;
+        for (DWORD d = pSchema->depStart[s]; d < pSchema->depStart[s + 1]; d++)
+        {
+            if (--pIndegree[pSchema->dependents[d]] == 0)
+                pFill[tail++] = pSchema->dependents[d];
+        }
+    }
+
+    free(pFill);
+    free(pIndegree);
+
+    if (head != statCount)
+    {
+        // Cycle
+        STATSCHEMA_Destroy(pSchema);
+        return NULL;
+    }
+    return pSchema;
+}
+
+StatSchema *__cdecl STATSCHEMA_CreateDefault(void)
+{
+    return STATSCHEMA_Create(STAT_COUNT_D2, s_defaultRules, D2_ARRAY_SIZE(s_defaultRules));
+}
+
+void __cdecl STATSCHEMA_Destroy(StatSchema *pSchema)
+{
+    if (!pSchema)
+    {
+        return;
+    }
+    free(pSchema->rules);
+    free(pSchema->ruleStart);
+    free(pSchema->dependents);
+    free(pSchema->depStart);
+    free(pSchema->rank);
+    free(pSchema->order);
+    free(pSchema);
+}
+
+DWORD __cdecl STATSCHEMA_GetStatCount(const StatSchema *pSchema)
+{
+    return pSchema->statCount;
+}
+
+// =============================================================================
+// DERIVATION
+// =============================================================================
+
+static int32_t Derive(const StatUnit *pUnit, DWORD stat)
+{
+    const StatSchema *pSchema = pUnit->pSchema;
+    const int32_t *final = pUnit->final;
+    int64_t base = pUnit->flat[stat];
+    int64_t percent = 0;
+
+    for (DWORD r = pSchema->ruleStart[stat]; r < pSchema->ruleStart[stat + 1]; r++)
+    {
+        const StatRule *pRule = &pSchema->rules[r];
+        switch (pRule->op)
+        {
+        case STATOP_PER_STAT:
+            base += (int64_t)final[pRule->source] * pRule->scale / 256;
+            break;
+        case STATOP_PER_LEVEL:
+            base += (int64_t)final[pRule->source] * final[pRule->aux] * pRule->scale / 256;
+            break;
+        default:
+            percent += final[pRule->source];
+            break;
+        }
+    }
+
+    int64_t value = base + base * percent / 100;
+    if (value > INT32_MAX)
+        return INT32_MAX;
+    if (value < INT32_MIN)
+        return INT32_MIN;
+    return (int32_t)value;
+}
+
+static void MarkDirty(StatUnit *pUnit, DWORD stat)
+{
+    if (pUnit->dirty[stat])
+    {
+        return;
+    }
+    pUnit->dirty[stat] = 1;
+
+    // Sift up by rank
+    const DWORD *rank = pUnit->pSchema->rank;
+    DWORD i = pUnit->heapCount++;
+    while (i > 0)
+    {
+        DWORD parent = (i - 1) / 2;
+        if (rank[pUnit->heap[parent]] <= rank[stat])
+            break;
+        pUnit->heap[i] = pUnit->heap[parent];
+        i = parent;
+    }
+    pUnit->heap[i] = (WORD)stat;
+}
+
+static DWORD PopDirty(StatUnit *pUnit)
+{
+    const DWORD *rank = pUnit->pSchema->rank;
+    WORD top = pUnit->heap[0];
+    WORD last = pUnit->heap[--pUnit->heapCount];
+    DWORD count = pUnit->heapCount;
+    DWORD i = 0;
+
+    while (count)
+    {
+        DWORD child = i * 2 + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count && rank[pUnit->heap[child + 1]] < rank[pUnit->heap[child]])
+            child++;
+        if (rank[last] <= rank[pUnit->heap[child]])
+            break;
+        pUnit->heap[i] = pUnit->heap[child];
+        i = child;
+    }
+    if (count)
+    {
+        pUnit->heap[i] = last;
+    }
+
+    pUnit->dirty[top] = 0;
+    return top;
+}
+
+void __cdecl STATENGINE_Flush(StatUnit *pUnit)
+{
+    const StatSchema *pSchema = pUnit->pSchema;
+    while (pUnit->heapCount)
+    {
+        DWORD stat = PopDirty(pUnit);
+        int32_t value = Derive(pUnit, stat);
+        pUnit->stats.derivations++;
+
+        if (value == pUnit->final[stat])
+        {
+            pUnit->stats.unchanged++;
+            continue;
+        }
+
+        pUnit->final[stat] = value;
+        for (DWORD d = pSchema->depStart[stat]; d < pSchema->depStart[stat + 1]; d++)
+        {
+            MarkDirty(pUnit, pSchema->dependents[d]);
+        }
+    }
+}
+
+// =============================================================================
+// UNITS
+// =============================================================================
+
+StatUnit *__cdecl STATENGINE_CreateUnit(const StatSchema *pSchema)
+{
+    StatUnit *pUnit = (StatUnit *)calloc(1, sizeof(StatUnit));
+    if (!pUnit)
+    {
+        return NULL;
+    }
+
+    // All-zero flat sums derive to all-zero finals, so no initial flush is needed
+    DWORD count = pSchema->statCount;
+    pUnit->pSchema = pSchema;
+    pUnit->flat = (int32_t *)calloc(count, sizeof(int32_t));
+    pUnit->final = (int32_t *)calloc(count, sizeof(int32_t));
+    pUnit->dirty = (BYTE *)calloc(count, 1);
+    pUnit->heap = (WORD *)malloc(count * sizeof(WORD));
+    if (!pUnit->flat || !pUnit->final || !pUnit->dirty || !pUnit->heap)
+    {
+        STATENGINE_DestroyUnit(pUnit);
+        return NULL;
+    }
+    return pUnit;
+}
+
+void __cdecl STATENGINE_DestroyUnit(StatUnit *pUnit)
+{
+    if (!pUnit)
+    {
+        return;
+    }
+    for (DWORD i = 0; i < pUnit->layerCount; i++)
+    {
+        free(pUnit->layers[i].mods);
+    }
+    free(pUnit->layers);
+    free(pUnit->flat);
+    free(pUnit->final);
+    free(pUnit->dirty);
+    free(pUnit->heap);
+    free(pUnit);
+}
+
+static StatLayer *FindLayer(StatUnit *pUnit, DWORD sourceId)
+{
+    for (DWORD i = 0; i < pUnit->layerCount; i++)
+    {
+        if (pUnit->layers[i].sourceId == sourceId)
+        {
+            return &pUnit->layers[i];
+        }
+    }
+    return NULL;
+}
+
+static void ApplyMods(StatUnit *pUnit, const StatMod *pMods, DWORD count, int sign)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD stat = pMods[i].stat;
+        if (stat < pUnit->pSchema->statCount && pMods[i].value)
+        {
+            pUnit->flat[stat] += sign * pMods[i].value;
+            MarkDirty(pUnit, stat);
+        }
+    }
+}
+
+static BOOL ReserveMods(StatLayer *pLayer, DWORD count)
+{
+    if (count <= pLayer->capacity)
+    {
+        return TRUE;
+    }
+
+    DWORD capacity = D2_NextPow2(count < 4 ? 4 : count);
+    StatMod *pMods = (StatMod *)realloc(pLayer->mods, capacity * sizeof(StatMod));
+    if (!pMods)
+    {
+        return FALSE;
+    }
+    pLayer->mods = pMods;
+    pLayer->capacity = capacity;
+    return TRUE;
+}
+
+static StatLayer *AppendLayer(StatUnit *pUnit, DWORD sourceId)
+{
+    if (pUnit->layerCount == pUnit->layerCapacity)
+    {
+        DWORD capacity = pUnit->layerCapacity ? pUnit->layerCapacity * 2 : 8;
+        StatLayer *pLayers = (StatLayer *)realloc(pUnit->layers, capacity * sizeof(StatLayer));
+        if (!pLayers)
+        {
+            return NULL;
+        }
+        pUnit->layers = pLayers;
+        pUnit->layerCapacity = capacity;
+    }
+
+    StatLayer *pLayer = &pUnit->layers[pUnit->layerCount++];
+    memset(pLayer, 0, sizeof(StatLayer));
+    pLayer->sourceId = sourceId;
+    return pLayer;
+}
+
+BOOL __cdecl STATENGINE_AddLayer(StatUnit *pUnit, DWORD sourceId, const StatMod *pMods, DWORD modCount)
+{
+    StatLayer *pLayer = FindLayer(pUnit, sourceId);
+    if (!pLayer)
+    {
+        pLayer = AppendLayer(pUnit, sourceId);
+        if (!pLayer)
+        {
+            return FALSE;
+        }
+    }
+
+    if (!ReserveMods(pLayer, modCount))
+    {
+        return FALSE;
+    }
+
+    // Replacing a source: retract the old modifiers first
+    ApplyMods(pUnit, pLayer->mods, pLayer->count, -1);
+    memcpy(pLayer->mods, pMods, modCount * sizeof(StatMod));
+    pLayer->count = modCount;
+    ApplyMods(pUnit, pLayer->mods, pLayer->count, 1);
+    pUnit->stats.layerChanges++;
+    return TRUE;
+}
+
+BOOL __cdecl STATENGINE_RemoveLayer(StatUnit *pUnit, DWORD sourceId)
+{
+    StatLayer *pLayer = FindLayer(pUnit, sourceId);
+    if (!pLayer)
+    {
+        return FALSE;
+    }
+
+    ApplyMods(pUnit, pLayer->mods, pLayer->count, -1);
+    free(pLayer->mods);
+    *pLayer = pUnit->layers[--pUnit->layerCount];
+    pUnit->stats.layerChanges++;
+    return TRUE;
+}
+
+BOOL __cdecl STATENGINE_SetBase(StatUnit *pUnit, WORD stat, int32_t value)
+{
+    if (stat >= pUnit->pSchema->statCount)
+    {
+        return FALSE;
+    }
+
+    StatLayer *pLayer = FindLayer(pUnit, BASE_LAYER);
+    if (!pLayer && !(pLayer = AppendLayer(pUnit, BASE_LAYER)))
+    {
+        return FALSE;
+    }
+
+    for (DWORD i = 0; i < pLayer->count; i++)
+    {
+        if (pLayer->mods[i].stat == stat)
+        {
+            StatMod delta = {stat, value - pLayer->mods[i].value};
+            pLayer->mods[i].value = value;
+            ApplyMods(pUnit, &delta, 1, 1);
+            return TRUE;
+        }
+    }
+
+    if (!ReserveMods(pLayer, pLayer->count + 1))
+    {
+        return FALSE;
+    }
+    StatMod mod = {stat, value};
+    pLayer->mods[pLayer->count++] = mod;
+    ApplyMods(pUnit, &mod, 1, 1);
+    return TRUE;
+}
+
+DWORD __cdecl STATENGINE_GetLayerCount(const StatUnit *pUnit)
+{
+    return pUnit->layerCount;
+}
+
+int32_t __cdecl STATENGINE_Get(StatUnit *pUnit, WORD stat)
+{
+    if (pUnit->heapCount)
+    {
+        STATENGINE_Flush(pUnit);
+    }
+    return (stat < pUnit->pSchema->statCount) ? pUnit->final[stat] : 0;
+}
+
+int32_t __cdecl STATENGINE_GetFlat(const StatUnit *pUnit, WORD stat)
+{
+    return (stat < pUnit->pSchema->statCount) ? pUnit->flat[stat] : 0;
+}
+
+const int32_t *__cdecl STATENGINE_GetAll(StatUnit *pUnit)
+{
+    if (pUnit->heapCount)
+    {
+        STATENGINE_Flush(pUnit);
+    }
+    return pUnit->final;
+}
+
+void __cdecl STATENGINE_RebuildAll(StatUnit *pUnit)
+{
+    const StatSchema *pSchema = pUnit->pSchema;
+
+    memset(pUnit->flat, 0, pSchema->statCount * sizeof(int32_t));
+    for (DWORD l = 0; l < pUnit->layerCount; l++)
+    {
+        const StatLayer *pLayer = &pUnit->layers[l];
+        for (DWORD i = 0; i < pLayer->count; i++)
+        {
+            if (pLayer->mods[i].stat < pSchema->statCount)
+                pUnit->flat[pLayer->mods[i].stat] += pLayer->mods[i].value;
+        }
+    }
+
+    for (DWORD i = 0; i < pSchema->statCount; i++)
+    {
+        DWORD stat = pSchema->order[i];
+        pUnit->final[stat] = Derive(pUnit, stat);
+        pUnit->dirty[stat] = 0;
+    }
+    pUnit->heapCount = 0;
+}
+
+void __cdecl STATENGINE_GetStats(const StatUnit *pUnit, StatEngineStats *pStats)
+{
+    *pStats = pUnit->stats;
+}
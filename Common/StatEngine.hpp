@@ -0,0 +1,131 @@
+/*
+ * StatEngine.hpp - D2Common incremental stat aggregation
+ *
+ * ApplyStatModifiersToUnit, ApplyObjectStatsToUnit and
+ * ApplyPassiveSkillSynergies rebuild a unit's whole stat list (base stats,
+ * every equipped item's properties, auras, synergies) whenever anything
+ * changes. During a fight with auras flickering and gear swapping that
+ * rebuild is the hottest server function.
+ *
+ * The engine keeps, per unit:
+ *   layers - one modifier list per source (item GUID, aura, synergy set);
+ *            adding or removing a layer adjusts the flat sums of only the
+ *            stats it touches.
+ *   flat   - sum of every layer's modifiers, per stat id.
+ *   final  - derived values, read in O(1) from a flat array.
+ *
+ * Derived stats follow rules in a StatSchema (vitality -> life,
+ * item_maxhp_percent -> maxhp, item_hp_perlevel x level -> maxhp, ...).
+ * The schema is validated as a DAG and ranked topologically once; a change
+ * marks only the touched stats dirty and re-derives their dependents in rank
+ * order, stopping wherever a value comes out unchanged.
+ *
+ * Parameterised stats (skill-specific "layer" values) stay in the legacy
+ * stat list. A unit is owned by one game thread; a schema is immutable and
+ * may be shared.
+ */
+
+#ifndef STATENGINE_HPP
+#define STATENGINE_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+// ItemStatCost.txt row ids used by the default schema
+#define STAT_STRENGTH 0
+#define STAT_ENERGY 1
+#define STAT_DEXTERITY 2
+#define STAT_VITALITY 3
+#define STAT_MAXHP 7
+#define STAT_MAXMANA 9
+#define STAT_MAXSTAMINA 11
+#define STAT_LEVEL 12
+#define STAT_ITEM_ARMOR_PERCENT 16
+#define STAT_ITEM_MAXDAMAGE_PERCENT 17
+#define STAT_ITEM_MINDAMAGE_PERCENT 18
+#define STAT_TOHIT 19
+#define STAT_MINDAMAGE 21
+#define STAT_MAXDAMAGE 22
+#define STAT_ARMORCLASS 31
+#define STAT_FIRERESIST 39
+#define STAT_LIGHTRESIST 41
+#define STAT_COLDRESIST 43
+#define STAT_POISONRESIST 45
+#define STAT_ITEM_MAXHP_PERCENT 76
+#define STAT_ITEM_MAXMANA_PERCENT 77
+#define STAT_ITEM_TOHIT_PERCENT 119
+#define STAT_ITEM_ARMOR_PERLEVEL 214
+#define STAT_ITEM_HP_PERLEVEL 216
+#define STAT_ITEM_MANA_PERLEVEL 217
+#define STAT_ITEM_MAXDAMAGE_PERLEVEL 218
+
+#define STAT_COUNT_D2 359 // Rows in ItemStatCost.txt
+
+typedef enum StatRuleOp
+{
+    STATOP_PER_STAT = 0,  // target += source * scale / 256
+    STATOP_PER_LEVEL = 1, // target += source * aux * scale / 256 (aux is usually STAT_LEVEL)
+    STATOP_PERCENT = 2,   // target = base + base * (sum of PERCENT sources) / 100
+} StatRuleOp;
+
+typedef struct StatRule
+{
+    BYTE op;     // StatRuleOp
+    WORD target;
+    WORD source;
+    WORD aux;    // STATOP_PER_LEVEL only
+    int32_t scale;
+} StatRule;
+
+typedef struct StatMod
+{
+    WORD stat;
+    int32_t value;
+} StatMod;
+
+typedef struct StatEngineStats
+{
+    uint64_t layerChanges;
+    uint64_t derivations; // Stats re-derived by propagation
+    uint64_t unchanged;   // Re-derived to the same value (propagation stopped)
+} StatEngineStats;
+
+typedef struct StatSchema StatSchema;
+typedef struct StatUnit StatUnit;
+
+/*
+ * Build a schema for stat ids [0, statCount). Fails (NULL) if a rule names
+ * an id out of range or the rules contain a cycle.
+ */
+StatSchema *__cdecl STATSCHEMA_Create(DWORD statCount, const StatRule *pRules, DWORD ruleCount);
+// D2 character rules over STAT_COUNT_D2 ids (attribute, percent and per-level bonuses)
+StatSchema *__cdecl STATSCHEMA_CreateDefault(void);
+void __cdecl STATSCHEMA_Destroy(StatSchema *pSchema);
+DWORD __cdecl STATSCHEMA_GetStatCount(const StatSchema *pSchema);
+
+StatUnit *__cdecl STATENGINE_CreateUnit(const StatSchema *pSchema);
+void __cdecl STATENGINE_DestroyUnit(StatUnit *pUnit);
+
+/*
+ * Layers are keyed by source id (item GUID, aura skill id, ...; 0 is the
+ * base layer used by STATENGINE_SetBase). Adding an existing source id
+ * replaces its modifiers. Changes are applied on the next read or flush.
+ */
+BOOL __cdecl STATENGINE_AddLayer(StatUnit *pUnit, DWORD sourceId, const StatMod *pMods, DWORD modCount);
+BOOL __cdecl STATENGINE_RemoveLayer(StatUnit *pUnit, DWORD sourceId);
+BOOL __cdecl STATENGINE_SetBase(StatUnit *pUnit, WORD stat, int32_t value);
+DWORD __cdecl STATENGINE_GetLayerCount(const StatUnit *pUnit);
+
+// Propagate pending changes (reads do this implicitly)
+void __cdecl STATENGINE_Flush(StatUnit *pUnit);
+
+int32_t __cdecl STATENGINE_Get(StatUnit *pUnit, WORD stat);
+int32_t __cdecl STATENGINE_GetFlat(const StatUnit *pUnit, WORD stat);
+// Whole final array (flushed), statCount entries
+const int32_t *__cdecl STATENGINE_GetAll(StatUnit *pUnit);
+
+// Re-derive every stat from the layers (unit load, verification)
+void __cdecl STATENGINE_RebuildAll(StatUnit *pUnit);
+
+void __cdecl STATENGINE_GetStats(const StatUnit *pUnit, StatEngineStats *pStats);
+
+#endif // STATENGINE_HPP
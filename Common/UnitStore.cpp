@@ -0,0 +1,396 @@
+/*
+ * UnitStore.cpp - D2Common structure-of-arrays unit storage
+ *
+ * See UnitStore.hpp. Slots are stable and own the generation and the cold
+ * block; the hot arrays are dense and reordered by swap-remove, with
+ * slotToDense/denseToSlot linking the two.
+ */
+
+#include "UnitStore.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_CAPACITY 8192
+
+#define INDEX_MASK (UNIT_MAX_CAPACITY - 1)
+// Generations wrap below the all-ones value so no handle equals UNIT_INVALID_HANDLE
+#define GENERATION_LIMIT ((0xFFFFFFFFu >> UNIT_HANDLE_INDEX_BITS) - 1)
+
+#define SLOT_FREE 0xFFFFFFFF
+
+#define TICK_CLEARED_FLAGS (UNITFLAG_ARRIVED | UNITFLAG_ANIM_DONE)
+
+struct UnitStore
+{
+    DWORD capacity;
+    DWORD count;
+    DWORD coldSize;
+
+    // Dense hot arrays [0, count)
+    float *x;
+    float *y;
+    float *targetX;
+    float *targetY;
+    float *speed;
+    DWORD *animFrame;
+    DWORD *animRate;
+    DWORD *animLength;
+    DWORD *flags;
+    BYTE *type;
+    BYTE *mode;
+    UnitHandle *handles;
+
+    // Per slot
+    DWORD *generation;
+    DWORD *slotToDense; // SLOT_FREE when unused
+    DWORD *nextFree;
+    DWORD freeHead;
+    BYTE *cold;
+};
+
+// =============================================================================
+// HANDLES
+// =============================================================================
+
+static inline DWORD HandleSlot(UnitHandle handle)
+{
+    return handle & INDEX_MASK;
+}
+
+static inline DWORD ResolveDense(const UnitStore *pStore, UnitHandle handle)
+{
+    DWORD slot = HandleSlot(handle);
+    if (handle == UNIT_INVALID_HANDLE || slot >= pStore->capacity ||
+        pStore->generation[slot] != (handle >> UNIT_HANDLE_INDEX_BITS))
+    {
+        return UNIT_INVALID_INDEX;
+    }
+    DWORD dense = pStore->slotToDense[slot];
+    return (dense == SLOT_FREE) ? UNIT_INVALID_INDEX : dense;
+}
+
+// =============================================================================
+// LIFETIME
+// =============================================================================
+
+UnitStore *__cdecl UNITSTORE_Create(const UnitStoreDesc *pDesc)
+{
+    UnitStore *pStore = (UnitStore *)calloc(1, sizeof(UnitStore));
+    if (!pStore)
+    {
+        return NULL;
+    }
+
+    DWORD capacity = (pDesc && pDesc->capacity) ? pDesc->capacity : DEFAULT_CAPACITY;
+    if (capacity > UNIT_MAX_CAPACITY)
+    {
+        capacity = UNIT_MAX_CAPACITY;
+    }
+    pStore->capacity = capacity;
+    pStore->coldSize = pDesc ? pDesc->coldSize : 0;
+
+    pStore->x = (float *)malloc(capacity * sizeof(float));
+    pStore->y = (float *)malloc(capacity * sizeof(float));
+    pStore->targetX = (float *)malloc(capacity * sizeof(float));
+    pStore->targetY = (float *)malloc(capacity * sizeof(float));
+    pStore->speed = (float *)malloc(capacity * sizeof(float));
+    pStore->animFrame = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pStore->animRate = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pStore->animLength = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pStore->flags = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pStore->type = (BYTE *)malloc(capacity);
+    pStore->mode = (BYTE *)malloc(capacity);
+    pStore->handles = (UnitHandle *)malloc(capacity * sizeof(UnitHandle));
+    pStore->generation = (DWORD *)calloc(capacity, sizeof(DWORD));
+    pStore->slotToDense = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pStore->nextFree = (DWORD *)malloc(capacity * sizeof(DWORD));
+    pStore->cold = pStore->coldSize ? (BYTE *)malloc((size_t)capacity * pStore->coldSize) : NULL;
+
+    if (!pStore->x || !pStore->y || !pStore->targetX || !pStore->targetY || !pStore->speed || !pStore->animFrame ||
+        !pStore->animRate || !pStore->animLength || !pStore->flags || !pStore->type || !pStore->mode ||
+        !pStore->handles || !pStore->generation || !pStore->slotToDense || !pStore->nextFree ||
+        (pStore->coldSize && !pStore->cold))
+    {
+        UNITSTORE_Destroy(pStore);
+        return NULL;
+    }
+
+    for (DWORD i = 0; i < capacity; i++)
+    {
+        pStore->slotToDense[i] = SLOT_FREE;
+        pStore->nextFree[i] = i + 1;
+    }
+    pStore->freeHead = 0;
+    return pStore;
+}
+
+void __cdecl UNITSTORE_Destroy(UnitStore *pStore)
+{
+    if (!pStore)
+    {
+        return;
+    }
+
+    free(pStore->x);
+    free(pStore->y);
+    free(pStore->targetX);
+    free(pStore->targetY);
+    free(pStore->speed);
+    free(pStore->animFrame);
+    free(pStore->animRate);
+    free(pStore->animLength);
+    free(pStore->flags);
+    free(pStore->type);
+    free(pStore->mode);
+    free(pStore->handles);
+    free(pStore->generation);
+    free(pStore->slotToDense);
+    free(pStore->nextFree);
+    free(pStore->cold);
+    free(pStore);
+}
+
+UnitHandle __cdecl UNITSTORE_Spawn(UnitStore *pStore, BYTE type, float x, float y)
+{
+    DWORD slot = pStore->freeHead;
+    if (slot >= pStore->capacity)
+    {
+        return UNIT_INVALID_HANDLE;
+    }
+    pStore->freeHead = pStore->nextFree[slot];
+
+    DWORD dense = pStore->count++;
+    UnitHandle handle = (pStore->generation[slot] << UNIT_HANDLE_INDEX_BITS) | slot;
+
+    pStore->x[dense] = x;
+    pStore->y[dense] = y;
+    pStore->targetX[dense] = x;
+    pStore->targetY[dense] = y;
+    pStore->speed[dense] = 0.0f;
+    pStore->animFrame[dense] = 0;
+    pStore->animRate[dense] = 0;
+    pStore->animLength[dense] = 0;
+    pStore->flags[dense] = 0;
+    pStore->type[dense] = type;
+    pStore->mode[dense] = 0;
+    pStore->handles[dense] = handle;
+    pStore->slotToDense[slot] = dense;
+
+    if (pStore->cold)
+    {
+        memset(pStore->cold + (size_t)slot * pStore->coldSize, 0, pStore->coldSize);
+    }
+    return handle;
+}
+
+BOOL __cdecl UNITSTORE_Despawn(UnitStore *pStore, UnitHandle handle)
+{
+    DWORD dense = ResolveDense(pStore, handle);
+    if (dense == UNIT_INVALID_INDEX)
+    {
+        return FALSE;
+    }
+
+    DWORD slot = HandleSlot(handle);
+    DWORD last = --pStore->count;
+    if (dense != last)
+    {
+        pStore->x[dense] = pStore->x[last];
+        pStore->y[dense] = pStore->y[last];
+        pStore->targetX[dense] = pStore->targetX[last];
+        pStore->targetY[dense] = pStore->targetY[last];
+        pStore->speed[dense] = pStore->speed[last];
+        pStore->animFrame[dense] = pStore->animFrame[last];
+        pStore->animRate[dense] = pStore->animRate[last];
+        pStore->animLength[dense] = pStore->animLength[last];
+        pStore->flags[dense] = pStore->flags[last];
+        pStore->type[dense] = pStore->type[last];
+        pStore->mode[dense] = pStore->mode[last];
+        pStore->handles[dense] = pStore->handles[last];
+        pStore->slotToDense[HandleSlot(pStore->handles[dense])] = dense;
+    }
+
+    pStore->slotToDense[slot] = SLOT_FREE;
+    pStore->generation[slot] = (pStore->generation[slot] + 1) % (GENERATION_LIMIT + 1);
+    pStore->nextFree[slot] = pStore->freeHead;
+    pStore->freeHead = slot;
+    return TRUE;
+}
+
+BOOL __cdecl UNITSTORE_IsAlive(const UnitStore *pStore, UnitHandle handle)
+{
+    return ResolveDense(pStore, handle) != UNIT_INVALID_INDEX;
+}
+
+DWORD __cdecl UNITSTORE_GetCount(const UnitStore *pStore)
+{
+    return pStore->count;
+}
+
+DWORD __cdecl UNITSTORE_GetIndex(const UnitStore *pStore, UnitHandle handle)
+{
+    return ResolveDense(pStore, handle);
+}
+
+void *__cdecl UNITSTORE_GetCold(UnitStore *pStore, UnitHandle handle)
+{
+    if (!pStore->cold || ResolveDense(pStore, handle) == UNIT_INVALID_INDEX)
+    {
+        return NULL;
+    }
+    return pStore->cold + (size_t)HandleSlot(handle) * pStore->coldSize;
+}
+
+void __cdecl UNITSTORE_GetHot(UnitStore *pStore, UnitHotArrays *pHot)
+{
+    pHot->count = pStore->count;
+    pHot->x = pStore->x;
+    pHot->y = pStore->y;
+    pHot->targetX = pStore->targetX;
+    pHot->targetY = pStore->targetY;
+    pHot->speed = pStore->speed;
+    pHot->animFrame = pStore->animFrame;
+    pHot->animRate = pStore->animRate;
+    pHot->animLength = pStore->animLength;
+    pHot->flags = pStore->flags;
+    pHot->type = pStore->type;
+    pHot->mode = pStore->mode;
+    pHot->handles = pStore->handles;
+}
+
+// =============================================================================
+// SETTERS
+// =============================================================================
+
+BOOL __cdecl UNITSTORE_SetPosition(UnitStore *pStore, UnitHandle handle, float x, float y)
+{
+    DWORD dense = ResolveDense(pStore, handle);
+    if (dense == UNIT_INVALID_INDEX)
+    {
+        return FALSE;
+    }
+
+    pStore->x[dense] = x;
+    pStore->y[dense] = y;
+    pStore->targetX[dense] = x;
+    pStore->targetY[dense] = y;
+    pStore->flags[dense] &= ~UNITFLAG_MOVING;
+    return TRUE;
+}
+
+BOOL __cdecl UNITSTORE_MoveTo(UnitStore *pStore, UnitHandle handle, float targetX, float targetY, float speed)
+{
+    DWORD dense = ResolveDense(pStore, handle);
+    if (dense == UNIT_INVALID_INDEX)
+    {
+        return FALSE;
+    }
+
+    pStore->targetX[dense] = targetX;
+    pStore->targetY[dense] = targetY;
+    pStore->speed[dense] = speed;
+    pStore->flags[dense] = (pStore->flags[dense] & ~UNITFLAG_ARRIVED) | UNITFLAG_MOVING;
+    return TRUE;
+}
+
+BOOL __cdecl UNITSTORE_SetAnimation(UnitStore *pStore, UnitHandle handle, BYTE mode, DWORD frames, DWORD rate,
+                                    BOOL loop)
+{
+    DWORD dense = ResolveDense(pStore, handle);
+    if (dense == UNIT_INVALID_INDEX)
+    {
+        return FALSE;
+    }
+
+    DWORD flags = pStore->flags[dense] & ~(UNITFLAG_ANIM_LOOP | UNITFLAG_ANIM_DONE);
+    pStore->mode[dense] = mode;
+    pStore->animFrame[dense] = 0;
+    pStore->animRate[dense] = rate;
+    pStore->animLength[dense] = frames << 8;
+    pStore->flags[dense] = flags | UNITFLAG_ANIMATING | (loop ? UNITFLAG_ANIM_LOOP : 0);
+    return TRUE;
+}
+
+// =============================================================================
+// TICK
+// =============================================================================
+
+void __cdecl UNITSTORE_Tick(UnitStore *pStore, UnitTickResult *pResult)
+{
+    UnitTickResult result;
+    memset(&result, 0, sizeof(result));
+
+    DWORD count = pStore->count;
+    float *x = pStore->x;
+    float *y = pStore->y;
+    const float *targetX = pStore->targetX;
+    const float *targetY = pStore->targetY;
+    const float *speed = pStore->speed;
+    DWORD *flags = pStore->flags;
+
+    // Movement: touches positions, targets, speed and flags only
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD f = flags[i] & ~TICK_CLEARED_FLAGS;
+        if (f & UNITFLAG_MOVING)
+        {
+            float dx = targetX[i] - x[i];
+            float dy = targetY[i] - y[i];
+            float dist2 = dx * dx + dy * dy;
+            float step = speed[i];
+            if (dist2 <= step * step)
+            {
+                x[i] = targetX[i];
+                y[i] = targetY[i];
+                f = (f & ~UNITFLAG_MOVING) | UNITFLAG_ARRIVED;
+                result.arrived++;
+            }
+            else
+            {
+                float scale = step / sqrtf(dist2);
+                x[i] += dx * scale;
+                y[i] += dy * scale;
+            }
+            result.moved++;
+        }
+        flags[i] = f;
+    }
+
+    // Animation: frame counters and flags only
+    DWORD *animFrame = pStore->animFrame;
+    const DWORD *animRate = pStore->animRate;
+    const DWORD *animLength = pStore->animLength;
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD f = flags[i];
+        if (!(f & UNITFLAG_ANIMATING))
+        {
+            continue;
+        }
+
+        DWORD frame = animFrame[i] + animRate[i];
+        if (frame >= animLength[i])
+        {
+            if ((f & UNITFLAG_ANIM_LOOP) && animLength[i])
+            {
+                frame %= animLength[i];
+            }
+            else
+            {
+                // Hold the last frame, as D2 does for death/cast animations
+                frame = animLength[i] ? animLength[i] - 0x100 : 0;
+                flags[i] = (f & ~UNITFLAG_ANIMATING) | UNITFLAG_ANIM_DONE;
+                result.animDone++;
+            }
+        }
+        animFrame[i] = frame;
+        result.animated++;
+    }
+
+    if (pResult)
+    {
+        *pResult = result;
+    }
+}
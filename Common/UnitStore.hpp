@@ -0,0 +1,109 @@
+/*
+ * UnitStore.hpp - D2Common structure-of-arrays unit storage
+ *
+ * D2's Unit record bundles type, position, stats, inventory, skills, flags,
+ * animation and AI state into one ~0xF4 byte block, reached through the
+ * game's unit hash lists and then through pDynamicPath for the position.
+ * The per-tick update only touches a handful of those fields, but every
+ * unit costs several cache misses to reach them.
+ *
+ * The store splits a unit into:
+ *   hot  - position, movement target, speed, animation frame/rate/length,
+ *          flags, type and mode, in packed parallel arrays. Live units are
+ *          always dense at [0, count), so tick loops run straight through
+ *          them without liveness checks.
+ *   cold - a fixed-size per-unit block for everything else (stats list,
+ *          inventory, AI state, ...), owned by the caller's layout and never
+ *          moved while the unit lives.
+ *
+ * Units are referenced by generational handles: despawning bumps the slot's
+ * generation so stale handles stop resolving instead of aliasing a new
+ * unit. Dense indices change on despawn (swap-remove); hold handles, not
+ * indices, across a despawn. Game thread only.
+ */
+
+#ifndef UNITSTORE_HPP
+#define UNITSTORE_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef DWORD UnitHandle;
+
+#define UNIT_INVALID_HANDLE 0xFFFFFFFF
+#define UNIT_INVALID_INDEX 0xFFFFFFFF
+
+// Handle layout: low UNIT_HANDLE_INDEX_BITS = slot, the rest = generation
+#define UNIT_HANDLE_INDEX_BITS 20
+#define UNIT_MAX_CAPACITY (1u << UNIT_HANDLE_INDEX_BITS)
+
+// Hot flags
+#define UNITFLAG_MOVING 0x0001    // Steps toward target at speed subtiles/tick
+#define UNITFLAG_ARRIVED 0x0002   // Set by the tick that reached the target
+#define UNITFLAG_ANIMATING 0x0004 // Frame advances by rate each tick
+#define UNITFLAG_ANIM_LOOP 0x0008 // Wrap at length instead of stopping
+#define UNITFLAG_ANIM_DONE 0x0010 // Set by the tick that finished a non-looping animation
+#define UNITFLAG_USER 0x0100      // First flag bit free for callers
+
+typedef struct UnitStoreDesc
+{
+    DWORD capacity; // Maximum live units (0 = 8192), at most UNIT_MAX_CAPACITY
+    DWORD coldSize; // Bytes of cold data per unit (0 = none), zeroed on spawn
+} UnitStoreDesc;
+
+// Dense hot arrays, valid until the next spawn/despawn
+typedef struct UnitHotArrays
+{
+    DWORD count;
+    float *x;
+    float *y;
+    float *targetX;
+    float *targetY;
+    float *speed;
+    DWORD *animFrame;  // 24.8 fixed point, as D2's anim frame counters
+    DWORD *animRate;   // Added per tick
+    DWORD *animLength; // Frames << 8
+    DWORD *flags;
+    BYTE *type;
+    BYTE *mode;
+    const UnitHandle *handles;
+} UnitHotArrays;
+
+typedef struct UnitTickResult
+{
+    DWORD moved;
+    DWORD arrived;
+    DWORD animated;
+    DWORD animDone;
+} UnitTickResult;
+
+typedef struct UnitStore UnitStore;
+
+UnitStore *__cdecl UNITSTORE_Create(const UnitStoreDesc *pDesc);
+void __cdecl UNITSTORE_Destroy(UnitStore *pStore);
+
+// Returns UNIT_INVALID_HANDLE when the store is full
+UnitHandle __cdecl UNITSTORE_Spawn(UnitStore *pStore, BYTE type, float x, float y);
+BOOL __cdecl UNITSTORE_Despawn(UnitStore *pStore, UnitHandle handle);
+BOOL __cdecl UNITSTORE_IsAlive(const UnitStore *pStore, UnitHandle handle);
+DWORD __cdecl UNITSTORE_GetCount(const UnitStore *pStore);
+
+// Dense index for direct array access, or UNIT_INVALID_INDEX for stale handles
+DWORD __cdecl UNITSTORE_GetIndex(const UnitStore *pStore, UnitHandle handle);
+void *__cdecl UNITSTORE_GetCold(UnitStore *pStore, UnitHandle handle);
+void __cdecl UNITSTORE_GetHot(UnitStore *pStore, UnitHotArrays *pHot);
+
+// Handle-based setters for code outside the tick loops
+BOOL __cdecl UNITSTORE_SetPosition(UnitStore *pStore, UnitHandle handle, float x, float y);
+BOOL __cdecl UNITSTORE_MoveTo(UnitStore *pStore, UnitHandle handle, float targetX, float targetY, float speed);
+BOOL __cdecl UNITSTORE_SetAnimation(UnitStore *pStore, UnitHandle handle, BYTE mode, DWORD frames, DWORD rate,
+                                    BOOL loop);
+
+/*
+ * Per-tick update over every live unit: step moving units toward their
+ * target (snapping on arrival), advance animations. ARRIVED/ANIM_DONE are
+ * cleared at the start of each tick and set for units that finished during
+ * it. Do not spawn or despawn from inside a loop over the hot arrays.
+ */
+void __cdecl UNITSTORE_Tick(UnitStore *pStore, UnitTickResult *pResult);
+
+#endif // UNITSTORE_HPP
@@ -112,6 +112,10 @@ char g_installPath[260] = {0}; // @ 0x0040B07C - Install path
 DWORD g_gameMode = 0;       // @ 0x0040B040 - Game mode (0=SP, 1=MP, 2=BNet)
 BOOL g_isExpansion = FALSE; // @ 0x0040B044 - Lord of Destruction installed
 
+// Fixed game seed (-seed); not in the original binary
+DWORD g_gameSeed = 0;
+BOOL g_fixedSeed = FALSE;
+
 // Command Line/Args @ 0x0040B3D0-0x0040B3D8
 int g_argc = 0;           // @ 0x0040B3D0 - Argument count
 char **g_argv = NULL;     // @ 0x0040B3D4 - Argument values
@@ -172,8 +176,12 @@ typedef struct LaunchConfig
     DWORD game_mode; // +0x24: 0=SP, 1=MP, 2=BNet
     BOOL expansion;  // +0x28: Lord of Destruction
 
-    // +0x02C: Reserved/padding to offset 0x21C
-    BYTE reserved[0x1F0]; // +0x2C to +0x21C (496 bytes)
+    // +0x02C: Fixed game seed (-seed), carved from the reserved block below
+    DWORD game_seed; // +0x2C: Seed for every game created this session
+    BOOL fixed_seed; // +0x30: game_seed was given on the command line
+
+    // +0x034: Reserved/padding to offset 0x21C
+    BYTE reserved[0x1E8]; // +0x34 to +0x21C (488 bytes)
 
     // +0x21C: Menu control flags (CRITICAL - discovered via Ghidra)
     BOOL skip_menu;           // +0x21C: Skip main menu flag
@@ -232,6 +240,9 @@ typedef void(__cdecl *PFN_CloseEngineSubsystem)(void);
 typedef void(__cdecl *PFN_ShutdownSubsystem6)(void);
 typedef void(__cdecl *PFN_ShutdownExternalSubsystem)(void);
 
+// Save Functions (D2Game.dll)
+typedef void(__cdecl *PFN_FlushPendingSaves)(void);
+
 // Registry Functions (Storm.dll)
 typedef void(__cdecl *PFN_WriteRegistryDwordValue)(const char *, const char *, DWORD);
 
@@ -257,6 +268,7 @@ PFN_InitializeSubsystem4 g_pfnInitializeSubsystem4 = NULL;
 PFN_CloseEngineSubsystem g_pfnCloseEngineSubsystem = NULL;
 PFN_ShutdownSubsystem6 g_pfnShutdownSubsystem6 = NULL;
 PFN_ShutdownExternalSubsystem g_pfnShutdownExternalSubsystem = NULL;
+PFN_FlushPendingSaves g_pfnFlushPendingSaves = NULL;
 PFN_WriteRegistryDwordValue g_pfnWriteRegistryDwordValue = NULL;
 
 // =============================================================================
@@ -1190,6 +1202,20 @@ void __cdecl ShutdownExternalSubsystemThunk(void)
     }
 }
 
+// Drain pending character saves (not in the original binary)
+void __cdecl FlushPendingSavesThunk(void)
+{
+    if (g_pfnFlushPendingSaves)
+    {
+        DEBUG_LOG("[FlushPendingSavesThunk] Calling D2Game.dll...\n");
+        g_pfnFlushPendingSaves();
+    }
+    else
+    {
+        DEBUG_LOG("[FlushPendingSavesThunk] Function pointer not initialized (stub)...\n");
+    }
+}
+
 // Write registry DWORD value @ 0x00407460
 void __cdecl WriteRegistryDwordValue(const char *key, const char *value, DWORD data)
 {
@@ -1523,6 +1549,14 @@ void __cdecl ParseCommandLine(int argc, char **argv)
             g_screenHeight = 480;
             DEBUG_LOG("[ParseCommandLine] Windowed mode 640x480\n");
         }
+        // Fixed game seed for reproducible games: -seed <n> (decimal or 0x hex)
+        else if (_stricmp(arg, "-seed") == 0 && i + 1 < argc)
+        {
+            g_gameSeed = strtoul(argv[++i], NULL, 0);
+            g_fixedSeed = TRUE;
+            sprintf(debugMsg, "[ParseCommandLine] Fixed game seed 0x%08lX\n", g_gameSeed);
+            DEBUG_LOG(debugMsg);
+        }
     }
 }
 
@@ -1728,6 +1762,8 @@ int __cdecl InitializeAndRunGameMainLoop(void)
     g_launchConfig.no_music = g_noMusic;
     g_launchConfig.game_mode = g_gameMode;
     g_launchConfig.expansion = g_isExpansion;
+    g_launchConfig.game_seed = g_gameSeed;
+    g_launchConfig.fixed_seed = g_fixedSeed;
     g_launchConfig.skip_menu = g_skipToBnet;  // Skip menu if going to Battle.net
     g_launchConfig.menu_init_param = 0;       // Default parameter
     g_launchConfig.callback_interface = NULL; // No callback yet
@@ -1896,6 +1932,9 @@ int __cdecl InitializeAndRunGameMainLoop(void)
     // =========================================================================
     DEBUG_LOG("[InitializeAndRunGameMainLoop] Beginning cleanup sequence...\n");
 
+    // Write out character saves still queued in D2Game before anything is torn down
+    FlushPendingSavesThunk();
+
     // Cleanup menu if still active
     if (menuInitialized)
     {
@@ -2290,6 +2329,16 @@ BOOL __cdecl InitializeDLLFunctionPointers(void)
         DEBUG_LOG("[InitializeDLLFunctionPointers] Fog.dll function pointers resolved (2 ordinals, 4 names)\n");
     }
 
+    // D2Game.dll functions
+    // FlushPendingSaves is exported by D2Game builds with the asynchronous save
+    // service; older D2Game.dll files lack it and the thunk stays a stub
+    if (g_hModuleD2Game)
+    {
+        g_pfnFlushPendingSaves = (PFN_FlushPendingSaves)GetProcAddress(g_hModuleD2Game, "FlushPendingSaves");
+        DEBUG_LOG(g_pfnFlushPendingSaves ? "[InitializeDLLFunctionPointers] D2Game.dll FlushPendingSaves resolved\n"
+                                         : "[InitializeDLLFunctionPointers] D2Game.dll has no FlushPendingSaves export\n");
+    }
+
     // Storm.dll functions (File I/O and utility functions)
     // TODO: Discover ordinals
     if (g_hModuleStorm)
@@ -0,0 +1,511 @@
+/*
+ * Admission.cpp - D2Net connection admission control
+ *
+ * Bucket words: key << 32 | arrival time. A key of 0 marks a free entry;
+ * no TCP peer has address 0.0.0.0, and subnet keys have their low bit set.
+ * Arrival times are in ticks of 1/16 ms and wrap every three days. A time
+ * further ahead of now than any bucket can get is one the clock wrapped
+ * past, and reads as a full bucket; the rare wrapped time that lands
+ * inside that window costs its key a short throttle, never a free pass
+ * beyond the burst.
+ *
+ * Ban words: address << 32 | expiry, in whole seconds of the clock.
+ */
+
+#include "Admission.hpp"
+
+#include <atomic>
+#include <new>
+
+#define TICKS_PER_MS 16
+#define TICKS_PER_SECOND (TICKS_PER_MS * 1000)
+#define PROBE_LIMIT 16
+#define MIN_ENTRIES 64
+#define MAX_ENTRIES (1u << 26)
+#define MAX_RATE TICKS_PER_SECOND // One tick per connection
+#define MAX_BURST 10000
+
+#define DEFAULT_ENTRIES 65536
+#define DEFAULT_MAX_BANS 4096
+#define DEFAULT_IP_RATE 2
+#define DEFAULT_IP_BURST 8
+#define DEFAULT_BAN_AFTER 16
+#define DEFAULT_BAN_SECONDS 300
+#define DEFAULT_SUBNET_BITS 24
+#define DEFAULT_SUBNET_RATE 50
+#define DEFAULT_SUBNET_BURST 200
+
+#define GLOBAL_KEY 1
+
+typedef struct Rate
+{
+    DWORD interval;  // Ticks per connection
+    DWORD tolerance; // interval * (burst - 1): how far ahead of now a bucket may run and still admit
+    DWORD banLead;   // Running this far ahead earns a ban (0 = refusals are not counted)
+    DWORD maxLead;   // The furthest ahead a bucket can get
+} Rate;
+
+typedef struct AdmitTable
+{
+    std::atomic<uint64_t> *pWords;
+    DWORD mask;
+    DWORD shift; // 32 - log2(entries), for the hash
+} AdmitTable;
+
+struct Admission
+{
+    AdmitTable ips;
+    AdmitTable subnets;
+    AdmitTable banTable;
+    Rate ipRate;
+    Rate subnetRate;
+    Rate globalRate;
+    BOOL globalLimit;
+    DWORD subnetMask;
+    DWORD banSeconds;
+    std::atomic<uint64_t> global;
+    std::atomic<uint64_t> admitted;
+    std::atomic<uint64_t> refused[ADMIT_VERDICT_COUNT];
+    std::atomic<uint64_t> bans;
+};
+
+enum
+{
+    SPEND_OK,
+    SPEND_EMPTY,
+    SPEND_BAN,
+    SPEND_MOVED, // The entry now belongs to another key
+    SPEND_FULL   // No entry free for the key
+};
+
+// NET_Accept's network order to a number whose high bits are the network
+static DWORD HostOrder(DWORD address)
+{
+    const BYTE *pBytes = (const BYTE *)&address;
+    return ((DWORD)pBytes[0] << 24) | ((DWORD)pBytes[1] << 16) | ((DWORD)pBytes[2] << 8) | pBytes[3];
+}
+
+static DWORD Clamp(DWORD value, DWORD fallback, DWORD low, DWORD high)
+{
+    if (value == 0)
+    {
+        value = fallback;
+    }
+    return value < low ? low : (value > high ? high : value);
+}
+
+static void InitRate(Rate *pRate, DWORD perSecond, DWORD burst, DWORD banAfter)
+{
+    pRate->interval = TICKS_PER_SECOND / perSecond;
+    pRate->tolerance = pRate->interval * (burst - 1);
+    pRate->banLead = banAfter ? pRate->tolerance + pRate->interval * banAfter : 0;
+    pRate->maxLead = pRate->banLead > pRate->tolerance + pRate->interval ? pRate->banLead
+                                                                          : pRate->tolerance + pRate->interval;
+}
+
+static BOOL InitTable(AdmitTable *pTable, DWORD entries)
+{
+    DWORD bits = 0;
+    while ((1u << bits) < entries)
+    {
+        bits++;
+    }
+    pTable->pWords = new (std::nothrow) std::atomic<uint64_t>[(size_t)1 << bits];
+    if (!pTable->pWords)
+    {
+        return FALSE;
+    }
+    for (DWORD i = 0; i < (1u << bits); i++)
+    {
+        pTable->pWords[i].store(0, std::memory_order_relaxed);
+    }
+    pTable->mask = (1u << bits) - 1;
+    pTable->shift = 32 - bits;
+    return TRUE;
+}
+
+static DWORD Home(const AdmitTable *pTable, DWORD key)
+{
+    return (key * 2654435761u) >> pTable->shift;
+}
+
+static DWORD NowTicks(uint64_t nowMs)
+{
+    return (DWORD)(nowMs * TICKS_PER_MS);
+}
+
+static DWORD NowSeconds(uint64_t nowMs)
+{
+    return (DWORD)(nowMs / 1000);
+}
+
+// How far a bucket's arrival time runs ahead of now; 0 = a full bucket
+static DWORD Lead(uint64_t word, DWORD now, const Rate *pRate)
+{
+    DWORD lead = (DWORD)word - now;
+    return (lead & 0x80000000u) || lead > pRate->maxLead ? 0 : lead;
+}
+
+// =============================================================================
+// BUCKETS
+// =============================================================================
+
+// The key's entry, or a free or full one claimed for it; NULL when the probe
+// window has neither. Two threads claiming for one key at once can leave
+// it two entries for a moment; the spare one is full and soon taken over.
+static std::atomic<uint64_t> *FindBucket(AdmitTable *pTable, DWORD key, DWORD now, const Rate *pRate)
+{
+    DWORD home = Home(pTable, key);
+    for (;;)
+    {
+        std::atomic<uint64_t> *pFree = NULL;
+        uint64_t freeWord = 0;
+        for (DWORD i = 0; i < PROBE_LIMIT; i++)
+        {
+            std::atomic<uint64_t> *pWord = &pTable->pWords[(home + i) & pTable->mask];
+            uint64_t word = pWord->load(std::memory_order_acquire);
+            DWORD wordKey = (DWORD)(word >> 32);
+            if (wordKey == key)
+            {
+                return pWord;
+            }
+            if (!pFree && (wordKey == 0 || Lead(word, now, pRate) == 0))
+            {
+                pFree = pWord;
+                freeWord = word;
+            }
+        }
+        if (!pFree)
+        {
+            return NULL;
+        }
+        if (pFree->compare_exchange_strong(freeWord, ((uint64_t)key << 32) | now, std::memory_order_acq_rel))
+        {
+            return pFree;
+        }
+    }
+}
+
+// One attempt against the bucket in *pWord
+static int Spend(std::atomic<uint64_t> *pWord, DWORD key, DWORD now, const Rate *pRate)
+{
+    uint64_t word = pWord->load(std::memory_order_acquire);
+    for (;;)
+    {
+        if ((DWORD)(word >> 32) != key)
+        {
+            return SPEND_MOVED;
+        }
+        DWORD lead = Lead(word, now, pRate);
+        int result = SPEND_OK;
+        if (lead > pRate->tolerance)
+        {
+            if (!pRate->banLead)
+            {
+                return SPEND_EMPTY;
+            }
+            // Refused attempts still count, until there are enough for a ban;
+            // the ban then stands in for the bucket, which starts over full
+            result = lead + pRate->interval > pRate->banLead ? SPEND_BAN : SPEND_EMPTY;
+        }
+        DWORD next = result == SPEND_BAN ? now : now + lead + pRate->interval;
+        if (pWord->compare_exchange_weak(word, ((uint64_t)key << 32) | next, std::memory_order_acq_rel))
+        {
+            return result;
+        }
+    }
+}
+
+// Finds or claims the key's bucket and spends from it
+static int SpendKey(AdmitTable *pTable, DWORD key, DWORD now, const Rate *pRate, std::atomic<uint64_t> **ppWord)
+{
+    for (;;)
+    {
+        std::atomic<uint64_t> *pWord = FindBucket(pTable, key, now, pRate);
+        if (!pWord)
+        {
+            return SPEND_FULL;
+        }
+        int result = Spend(pWord, key, now, pRate);
+        if (result != SPEND_MOVED)
+        {
+            *ppWord = pWord;
+            return result;
+        }
+    }
+}
+
+// Gives back a connection spent from the key's bucket, unless the entry has
+// been taken over since
+static void Refund(std::atomic<uint64_t> *pWord, DWORD key, DWORD now, const Rate *pRate)
+{
+    uint64_t word = pWord->load(std::memory_order_acquire);
+    while ((DWORD)(word >> 32) == key)
+    {
+        DWORD lead = Lead(word, now, pRate);
+        DWORD next = now + (lead > pRate->interval ? lead - pRate->interval : 0);
+        if (pWord->compare_exchange_weak(word, ((uint64_t)key << 32) | next, std::memory_order_acq_rel))
+        {
+            return;
+        }
+    }
+}
+
+// =============================================================================
+// BANS
+// =============================================================================
+
+static BOOL FindBan(const AdmitTable *pTable, DWORD key, DWORD nowSeconds)
+{
+    DWORD home = Home(pTable, key);
+    for (DWORD i = 0; i < PROBE_LIMIT; i++)
+    {
+        uint64_t word = pTable->pWords[(home + i) & pTable->mask].load(std::memory_order_acquire);
+        if ((DWORD)(word >> 32) == key && (DWORD)word > nowSeconds)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Pushes an existing ban's expiry out to at least expiry; FALSE once the
+// entry no longer holds key
+static BOOL ExtendBan(std::atomic<uint64_t> *pWord, DWORD key, DWORD expiry)
+{
+    uint64_t word = pWord->load(std::memory_order_acquire);
+    while ((DWORD)(word >> 32) == key)
+    {
+        if ((DWORD)word >= expiry ||
+            pWord->compare_exchange_weak(word, ((uint64_t)key << 32) | expiry, std::memory_order_acq_rel))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static BOOL PlaceBan(Admission *pAdmission, DWORD key, DWORD nowSeconds, DWORD seconds)
+{
+    AdmitTable *pTable = &pAdmission->banTable;
+    DWORD expiry = nowSeconds + seconds;
+    DWORD home = Home(pTable, key);
+    for (;;)
+    {
+        std::atomic<uint64_t> *pFree = NULL;
+        uint64_t freeWord = 0;
+        BOOL found = FALSE;
+        for (DWORD i = 0; i < PROBE_LIMIT && !found; i++)
+        {
+            std::atomic<uint64_t> *pWord = &pTable->pWords[(home + i) & pTable->mask];
+            uint64_t word = pWord->load(std::memory_order_acquire);
+            if ((DWORD)(word >> 32) == key)
+            {
+                if (ExtendBan(pWord, key, expiry))
+                {
+                    pAdmission->bans.fetch_add(1, std::memory_order_relaxed);
+                    return TRUE;
+                }
+                found = TRUE; // Lifted and reused meanwhile; look again
+            }
+            else if (!pFree && (word == 0 || (DWORD)word <= nowSeconds))
+            {
+                pFree = pWord;
+                freeWord = word;
+            }
+        }
+        if (found)
+        {
+            continue;
+        }
+        if (!pFree)
+        {
+            return FALSE;
+        }
+        if (pFree->compare_exchange_strong(freeWord, ((uint64_t)key << 32) | expiry, std::memory_order_acq_rel))
+        {
+            pAdmission->bans.fetch_add(1, std::memory_order_relaxed);
+            return TRUE;
+        }
+    }
+}
+
+// =============================================================================
+// ADMISSION
+// =============================================================================
+
+Admission *__cdecl ADMIT_Create(const AdmissionDesc *pDesc)
+{
+    if (!pDesc)
+    {
+        return NULL;
+    }
+    Admission *pAdmission = new (std::nothrow) Admission;
+    if (!pAdmission)
+    {
+        return NULL;
+    }
+    DWORD entries = Clamp(pDesc->trackedAddresses, DEFAULT_ENTRIES, MIN_ENTRIES, MAX_ENTRIES);
+    DWORD maxBans = Clamp(pDesc->maxBans, DEFAULT_MAX_BANS, MIN_ENTRIES, MAX_ENTRIES);
+    pAdmission->ips.pWords = pAdmission->subnets.pWords = pAdmission->banTable.pWords = NULL;
+    if (!InitTable(&pAdmission->ips, entries) || !InitTable(&pAdmission->subnets, entries) ||
+        !InitTable(&pAdmission->banTable, maxBans))
+    {
+        ADMIT_Destroy(pAdmission);
+        return NULL;
+    }
+
+    InitRate(&pAdmission->ipRate, Clamp(pDesc->ipRate, DEFAULT_IP_RATE, 1, MAX_RATE),
+             Clamp(pDesc->ipBurst, DEFAULT_IP_BURST, 1, MAX_BURST),
+             Clamp(pDesc->banAfter, DEFAULT_BAN_AFTER, 1, MAX_BURST));
+    InitRate(&pAdmission->subnetRate, Clamp(pDesc->subnetRate, DEFAULT_SUBNET_RATE, 1, MAX_RATE),
+             Clamp(pDesc->subnetBurst, DEFAULT_SUBNET_BURST, 1, MAX_BURST), 0);
+    pAdmission->globalLimit = pDesc->globalRate != 0;
+    DWORD globalRate = Clamp(pDesc->globalRate, 1, 1, MAX_RATE);
+    InitRate(&pAdmission->globalRate, globalRate, Clamp(pDesc->globalBurst, globalRate, 1, MAX_BURST), 0);
+    pAdmission->global.store((uint64_t)GLOBAL_KEY << 32, std::memory_order_relaxed);
+
+    DWORD subnetBits = Clamp(pDesc->subnetBits, DEFAULT_SUBNET_BITS, 1, 31);
+    pAdmission->subnetMask = ~0u << (32 - subnetBits);
+    pAdmission->banSeconds = pDesc->banSeconds ? pDesc->banSeconds : DEFAULT_BAN_SECONDS;
+    pAdmission->admitted = 0;
+    for (DWORD i = 0; i < ADMIT_VERDICT_COUNT; i++)
+    {
+        pAdmission->refused[i] = 0;
+    }
+    pAdmission->bans = 0;
+    return pAdmission;
+}
+
+void __cdecl ADMIT_Destroy(Admission *pAdmission)
+{
+    if (!pAdmission)
+    {
+        return;
+    }
+    delete[] pAdmission->ips.pWords;
+    delete[] pAdmission->subnets.pWords;
+    delete[] pAdmission->banTable.pWords;
+    delete pAdmission;
+}
+
+static BYTE Decide(Admission *pAdmission, DWORD host, uint64_t nowMs)
+{
+    DWORD nowSeconds = NowSeconds(nowMs);
+    if (FindBan(&pAdmission->banTable, host, nowSeconds))
+    {
+        return ADMIT_BANNED;
+    }
+
+    DWORD now = NowTicks(nowMs);
+    std::atomic<uint64_t> *pIp = NULL;
+    switch (SpendKey(&pAdmission->ips, host, now, &pAdmission->ipRate, &pIp))
+    {
+    case SPEND_OK:
+        break;
+    case SPEND_EMPTY:
+        return ADMIT_IP_RATE;
+    case SPEND_BAN:
+        PlaceBan(pAdmission, host, nowSeconds, pAdmission->banSeconds);
+        return ADMIT_BANNED;
+    default:
+        return ADMIT_TABLE_FULL;
+    }
+
+    // A connection refused further on is given back to the buckets before,
+    // so clients held back by their subnet or the server do not use up
+    // their own allowance retrying, let alone earn a ban
+    DWORD subnet = (host & pAdmission->subnetMask) | 1;
+    std::atomic<uint64_t> *pSubnet = NULL;
+    int result = SpendKey(&pAdmission->subnets, subnet, now, &pAdmission->subnetRate, &pSubnet);
+    if (result != SPEND_OK)
+    {
+        Refund(pIp, host, now, &pAdmission->ipRate);
+        return result == SPEND_EMPTY ? ADMIT_SUBNET_RATE : ADMIT_TABLE_FULL;
+    }
+
+    if (pAdmission->globalLimit && Spend(&pAdmission->global, GLOBAL_KEY, now, &pAdmission->globalRate) != SPEND_OK)
+    {
+        Refund(pSubnet, subnet, now, &pAdmission->subnetRate);
+        Refund(pIp, host, now, &pAdmission->ipRate);
+        return ADMIT_GLOBAL_RATE;
+    }
+    return ADMIT_OK;
+}
+
+BYTE __cdecl ADMIT_Check(Admission *pAdmission, DWORD address, uint64_t nowMs)
+{
+    BYTE verdict = Decide(pAdmission, HostOrder(address), nowMs);
+    if (verdict == ADMIT_OK)
+    {
+        pAdmission->admitted.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        pAdmission->refused[verdict].fetch_add(1, std::memory_order_relaxed);
+    }
+    return verdict;
+}
+
+BOOL __cdecl ADMIT_Ban(Admission *pAdmission, DWORD address, DWORD seconds, uint64_t nowMs)
+{
+    return PlaceBan(pAdmission, HostOrder(address), NowSeconds(nowMs), seconds ? seconds : pAdmission->banSeconds);
+}
+
+void __cdecl ADMIT_Unban(Admission *pAdmission, DWORD address)
+{
+    AdmitTable *pTable = &pAdmission->banTable;
+    DWORD key = HostOrder(address);
+    DWORD home = Home(pTable, key);
+    for (DWORD i = 0; i < PROBE_LIMIT; i++)
+    {
+        std::atomic<uint64_t> *pWord = &pTable->pWords[(home + i) & pTable->mask];
+        uint64_t word = pWord->load(std::memory_order_acquire);
+        while ((DWORD)(word >> 32) == key)
+        {
+            if (pWord->compare_exchange_weak(word, 0, std::memory_order_acq_rel))
+            {
+                break;
+            }
+        }
+    }
+}
+
+BOOL __cdecl ADMIT_IsBanned(Admission *pAdmission, DWORD address, uint64_t nowMs)
+{
+    return FindBan(&pAdmission->banTable, HostOrder(address), NowSeconds(nowMs));
+}
+
+void __cdecl ADMIT_GetStats(Admission *pAdmission, uint64_t nowMs, AdmissionStats *pStats)
+{
+    pStats->admitted = pAdmission->admitted.load(std::memory_order_relaxed);
+    pStats->checked = pStats->admitted;
+    for (DWORD i = 0; i < ADMIT_VERDICT_COUNT; i++)
+    {
+        pStats->refused[i] = pAdmission->refused[i].load(std::memory_order_relaxed);
+        pStats->checked += pStats->refused[i];
+    }
+    pStats->bans = pAdmission->bans.load(std::memory_order_relaxed);
+
+    DWORD nowSeconds = NowSeconds(nowMs);
+    pStats->activeBans = 0;
+    for (DWORD i = 0; i <= pAdmission->banTable.mask; i++)
+    {
+        uint64_t word = pAdmission->banTable.pWords[i].load(std::memory_order_relaxed);
+        pStats->activeBans += (word >> 32) != 0 && (DWORD)word > nowSeconds;
+    }
+    DWORD now = NowTicks(nowMs);
+    pStats->trackedAddresses = 0;
+    for (DWORD i = 0; i <= pAdmission->ips.mask; i++)
+    {
+        uint64_t word = pAdmission->ips.pWords[i].load(std::memory_order_relaxed);
+        pStats->trackedAddresses += (word >> 32) != 0 && Lead(word, now, &pAdmission->ipRate) != 0;
+    }
+}
+
+const char *__cdecl ADMIT_VerdictName(BYTE verdict)
+{
+    static const char *const s_names[ADMIT_VERDICT_COUNT] = {"admitted",    "banned",      "address rate",
+                                                             "subnet rate", "server rate", "table full"};
+    return verdict < ADMIT_VERDICT_COUNT ? s_names[verdict] : "unknown";
+}
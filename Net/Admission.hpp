@@ -0,0 +1,100 @@
+/*
+ * Admission.hpp - D2Net connection admission control
+ *
+ * Fog's hack list (FOG_BINARY_ANALYSIS.md, "Hack List Anti-Spam System")
+ * reacts after the fact: sServerThread notices a client "spamming server
+ * with reconnects", QSHackListIP appends the address to a ban list that is
+ * searched on every accept, and every step writes a log line. Until then
+ * each reconnect is accepted and set up like any other, so a reconnect
+ * storm after a server restart reaches the login code in full.
+ *
+ * An Admission decides at accept time, before the server sets anything up
+ * for the connection, in this order:
+ *   1. banned addresses are refused;
+ *   2. each address has a token bucket: ipRate connections a second, ipBurst
+ *      back to back. Attempts made while refused still draw on it, so an
+ *      address that keeps hammering digs itself deeper; banAfter attempts
+ *      past empty ban it for banSeconds;
+ *   3. each subnet (the first subnetBits bits of the address) has a bucket,
+ *      for floods spread over the addresses of one network;
+ *   4. one bucket for the whole server (globalRate; 0 = none) paces a storm
+ *      of well-behaved clients to what the server can log in and turns the
+ *      rest away cheaply, so they retry later instead of timing out inside.
+ * A connection refused by a subnet or the server is given back to the
+ * buckets it already passed, so waiting out those limits costs a client
+ * nothing of its own.
+ *
+ * Buckets are kept in GCRA form, one "theoretical arrival time" per key,
+ * packed with the key into a single 64-bit word of an open-addressing
+ * table and updated with compare-and-swap. A bucket that has refilled
+ * holds nothing a missing entry would not, so a key whose probe window is
+ * full takes such an entry over. When no entry is free or idle the
+ * attempt is refused (ADMIT_TABLE_FULL) rather than let through untracked.
+ * Bans are a second table of address and expiry words; expired entries
+ * are reused in place. Nothing is allocated after ADMIT_Create.
+ *
+ * Addresses are IPv4 in network order, as NET_Accept returns them. Times
+ * are milliseconds of one monotonic clock (EVLOOP_NowMs), the same for
+ * every call on an Admission.
+ *
+ * Threading: every call may be made from any thread; none takes a lock.
+ */
+
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+// Verdicts
+#define ADMIT_OK 0
+#define ADMIT_BANNED 1
+#define ADMIT_IP_RATE 2
+#define ADMIT_SUBNET_RATE 3
+#define ADMIT_GLOBAL_RATE 4
+#define ADMIT_TABLE_FULL 5
+#define ADMIT_VERDICT_COUNT 6
+
+typedef struct AdmissionDesc
+{
+    DWORD trackedAddresses; // Address and subnet table entries each (0 = 65536), rounded up to a power of two
+    DWORD maxBans;          // Ban table entries (0 = 4096), rounded up to a power of two
+    DWORD ipRate;           // Connections per second per address (0 = 2)
+    DWORD ipBurst;          // 0 = 8
+    DWORD banAfter;         // Attempts past an empty bucket that earn a ban (0 = 16)
+    DWORD banSeconds;       // 0 = 300
+    DWORD subnetBits;       // 1 to 31 (0 = 24)
+    DWORD subnetRate;       // 0 = 50
+    DWORD subnetBurst;      // 0 = 200
+    DWORD globalRate;       // Connections per second for the whole server (0 = no limit)
+    DWORD globalBurst;      // 0 = globalRate
+} AdmissionDesc;
+
+typedef struct AdmissionStats
+{
+    uint64_t checked;
+    uint64_t admitted;
+    uint64_t refused[ADMIT_VERDICT_COUNT]; // By verdict
+    uint64_t bans;                         // Placed automatically or by ADMIT_Ban
+    DWORD activeBans;
+    DWORD trackedAddresses; // Address buckets not yet refilled
+} AdmissionStats;
+
+typedef struct Admission Admission;
+
+Admission *__cdecl ADMIT_Create(const AdmissionDesc *pDesc);
+void __cdecl ADMIT_Destroy(Admission *pAdmission);
+
+// ADMIT_OK to take the connection, otherwise why not
+BYTE __cdecl ADMIT_Check(Admission *pAdmission, DWORD address, uint64_t nowMs);
+
+// seconds 0 = banSeconds. FALSE when the ban table has no room near the
+// address's slot.
+BOOL __cdecl ADMIT_Ban(Admission *pAdmission, DWORD address, DWORD seconds, uint64_t nowMs);
+void __cdecl ADMIT_Unban(Admission *pAdmission, DWORD address);
+BOOL __cdecl ADMIT_IsBanned(Admission *pAdmission, DWORD address, uint64_t nowMs);
+
+// activeBans and trackedAddresses walk the tables
+void __cdecl ADMIT_GetStats(Admission *pAdmission, uint64_t nowMs, AdmissionStats *pStats);
+const char *__cdecl ADMIT_VerdictName(BYTE verdict);
+
+#endif // ADMISSION_HPP
@@ -0,0 +1,459 @@
+/*
+ * EventLoop.cpp - D2Net readiness event loop
+ *
+ * Registrations live in a slot array and are named by (generation << 16) |
+ * index, so an event already fetched for a socket that a callback removed
+ * (or whose slot was reused) is recognised as stale and dropped.
+ *
+ * Posted tasks wake the loop through an ordinary registration: an eventfd
+ * on Linux, a pipe on other POSIX systems and a loopback socket pair on
+ * Windows. Only the first post after a drain writes to it.
+ */
+
+#include "EventLoop.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#define EVLOOP_EPOLL 1
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#define EVLOOP_EPOLL 0
+#ifdef _WIN32
+#include <winsock2.h>
+#define PollSockets(pFds, count, timeoutMs) WSAPoll(pFds, (ULONG)(count), timeoutMs)
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#define PollSockets(pFds, count, timeoutMs) poll(pFds, (nfds_t)(count), timeoutMs)
+#endif
+#endif
+
+#define DEFAULT_MAX_SOCKETS 1024
+#define MAX_SOCKETS 0xFFFF
+#define EVENT_BATCH 256
+
+#define ID_INDEX_BITS 16
+#define ID_INDEX_MASK ((1u << ID_INDEX_BITS) - 1)
+#define ID_GENERATION_MASK 0xFFFF
+
+typedef struct PostedTask
+{
+    NetTaskFn pfnTask;
+    void *pContext;
+} PostedTask;
+
+typedef struct Registration
+{
+    NetSocket s;
+    DWORD interest;
+    NetEventFn pfnEvent;
+    void *pContext;
+    DWORD generation;
+    BOOL active;
+} Registration;
+
+struct EventLoop
+{
+    std::vector<Registration> slots;
+    std::vector<DWORD> freeSlots;
+    DWORD count;
+
+    // Cross-thread posts
+    NetSocket wakeRead;
+    NetSocket wakeWrite; // Same as wakeRead for an eventfd
+    std::mutex taskMutex;
+    std::vector<PostedTask> tasks;
+    std::vector<PostedTask> running;
+    std::atomic<bool> wakePending;
+
+#if EVLOOP_EPOLL
+    int epoll;
+    struct epoll_event events[EVENT_BATCH];
+#else
+    // Rebuilt from the slots before a wait when registrations changed
+    std::vector<struct pollfd> fds;
+    std::vector<DWORD> fdIds;
+    BOOL fdsDirty;
+#endif
+};
+
+static DWORD MakeId(DWORD index, DWORD generation)
+{
+    return (generation << ID_INDEX_BITS) | index;
+}
+
+static Registration *LookupId(EventLoop *pLoop, DWORD id)
+{
+    DWORD index = id & ID_INDEX_MASK;
+    if (index >= pLoop->slots.size())
+    {
+        return NULL;
+    }
+    Registration *pReg = &pLoop->slots[index];
+    return (pReg->active && pReg->generation == (id >> ID_INDEX_BITS)) ? pReg : NULL;
+}
+
+#if EVLOOP_EPOLL
+static DWORD ToEpoll(DWORD interest)
+{
+    return ((interest & NET_READ) ? (DWORD)EPOLLIN : 0) | ((interest & NET_WRITE) ? (DWORD)EPOLLOUT : 0);
+}
+#endif
+
+// =============================================================================
+// WAKE-UP
+// =============================================================================
+
+static BOOL CreateWake(EventLoop *pLoop)
+{
+#if EVLOOP_EPOLL
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pLoop->wakeRead = pLoop->wakeWrite = fd;
+    return fd >= 0;
+#elif defined(_WIN32)
+    WORD port;
+    NetSocket listener = NET_Listen("127.0.0.1", 0, 1, &port);
+    pLoop->wakeWrite = NET_Connect("127.0.0.1", port);
+    pLoop->wakeRead = NET_INVALID_SOCKET;
+    for (DWORD waited = 0; pLoop->wakeRead == NET_INVALID_SOCKET && waited < 1000; waited++)
+    {
+        pLoop->wakeRead = NET_Accept(listener, NULL);
+        if (pLoop->wakeRead == NET_INVALID_SOCKET)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    NET_Close(listener);
+    return pLoop->wakeRead != NET_INVALID_SOCKET && pLoop->wakeWrite != NET_INVALID_SOCKET;
+#else
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return FALSE;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+    pLoop->wakeRead = fds[0];
+    pLoop->wakeWrite = fds[1];
+    return TRUE;
+#endif
+}
+
+static void CloseWake(EventLoop *pLoop)
+{
+#if EVLOOP_EPOLL
+    close((int)pLoop->wakeRead);
+#elif defined(_WIN32)
+    NET_Close(pLoop->wakeRead);
+    NET_Close(pLoop->wakeWrite);
+#else
+    close((int)pLoop->wakeRead);
+    close((int)pLoop->wakeWrite);
+#endif
+}
+
+static void SignalWake(EventLoop *pLoop)
+{
+#if EVLOOP_EPOLL
+    uint64_t one = 1;
+    ssize_t written = write((int)pLoop->wakeWrite, &one, sizeof(one));
+    (void)written; // A full counter is still a wake-up
+#elif defined(_WIN32)
+    NET_Send(pLoop->wakeWrite, "w", 1);
+#else
+    ssize_t written = write((int)pLoop->wakeWrite, "w", 1);
+    (void)written; // A full pipe is still a wake-up
+#endif
+}
+
+static void DrainWake(EventLoop *pLoop)
+{
+    BYTE scratch[64];
+#if EVLOOP_EPOLL
+    ssize_t drained = read((int)pLoop->wakeRead, scratch, sizeof(uint64_t));
+    (void)drained;
+#elif defined(_WIN32)
+    while (NET_Recv(pLoop->wakeRead, scratch, sizeof(scratch)) > 0)
+    {
+    }
+#else
+    while (read((int)pLoop->wakeRead, scratch, sizeof(scratch)) > 0)
+    {
+    }
+#endif
+}
+
+static void RunTasks(EventLoop *pLoop)
+{
+    {
+        std::lock_guard<std::mutex> lock(pLoop->taskMutex);
+        pLoop->running.swap(pLoop->tasks);
+    }
+    for (size_t i = 0; i < pLoop->running.size(); i++)
+    {
+        pLoop->running[i].pfnTask(pLoop->running[i].pContext);
+    }
+    pLoop->running.clear();
+}
+
+static void __cdecl OnWake(void *pContext, DWORD events)
+{
+    (void)events;
+    EventLoop *pLoop = (EventLoop *)pContext;
+    // Clear before draining: a post racing with this run writes again
+    pLoop->wakePending.store(false);
+    DrainWake(pLoop);
+    RunTasks(pLoop);
+}
+
+// =============================================================================
+// LOOP
+// =============================================================================
+
+EventLoop *__cdecl EVLOOP_Create(DWORD maxSockets)
+{
+    if (maxSockets == 0)
+    {
+        maxSockets = DEFAULT_MAX_SOCKETS;
+    }
+    if (maxSockets > MAX_SOCKETS)
+    {
+        maxSockets = MAX_SOCKETS;
+    }
+
+    EventLoop *pLoop = new EventLoop;
+    maxSockets++; // The wake-up registration
+    pLoop->slots.resize(maxSockets);
+    pLoop->freeSlots.reserve(maxSockets);
+    for (DWORD i = maxSockets; i-- > 0;)
+    {
+        pLoop->slots[i].active = FALSE;
+        pLoop->slots[i].generation = 0;
+        pLoop->freeSlots.push_back(i);
+    }
+    pLoop->count = 0;
+
+#if EVLOOP_EPOLL
+    pLoop->epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (pLoop->epoll < 0)
+    {
+        delete pLoop;
+        return NULL;
+    }
+#else
+    pLoop->fdsDirty = TRUE;
+#endif
+
+    pLoop->wakePending = false;
+    if (!CreateWake(pLoop) || EVLOOP_Add(pLoop, pLoop->wakeRead, NET_READ, OnWake, pLoop) == EVLOOP_INVALID_ID)
+    {
+        EVLOOP_Destroy(pLoop);
+        return NULL;
+    }
+    return pLoop;
+}
+
+void __cdecl EVLOOP_Destroy(EventLoop *pLoop)
+{
+    if (!pLoop)
+    {
+        return;
+    }
+    RunTasks(pLoop);
+    CloseWake(pLoop);
+#if EVLOOP_EPOLL
+    close(pLoop->epoll);
+#endif
+    delete pLoop;
+}
+
+DWORD __cdecl EVLOOP_Add(EventLoop *pLoop, NetSocket s, DWORD interest, NetEventFn pfnEvent, void *pContext)
+{
+    if (pLoop->freeSlots.empty() || s == NET_INVALID_SOCKET || !pfnEvent)
+    {
+        return EVLOOP_INVALID_ID;
+    }
+    DWORD index = pLoop->freeSlots.back();
+    Registration *pReg = &pLoop->slots[index];
+    DWORD id = MakeId(index, pReg->generation);
+
+#if EVLOOP_EPOLL
+    struct epoll_event event;
+    event.events = ToEpoll(interest);
+    event.data.u64 = id;
+    if (epoll_ctl(pLoop->epoll, EPOLL_CTL_ADD, (int)s, &event) != 0)
+    {
+        return EVLOOP_INVALID_ID;
+    }
+#else
+    pLoop->fdsDirty = TRUE;
+#endif
+    pLoop->freeSlots.pop_back();
+    pReg->s = s;
+    pReg->interest = interest;
+    pReg->pfnEvent = pfnEvent;
+    pReg->pContext = pContext;
+    pReg->active = TRUE;
+    pLoop->count++;
+    return id;
+}
+
+BOOL __cdecl EVLOOP_SetInterest(EventLoop *pLoop, DWORD id, DWORD interest)
+{
+    Registration *pReg = LookupId(pLoop, id);
+    if (!pReg)
+    {
+        return FALSE;
+    }
+    if (pReg->interest == interest)
+    {
+        return TRUE;
+    }
+#if EVLOOP_EPOLL
+    struct epoll_event event;
+    event.events = ToEpoll(interest);
+    event.data.u64 = id;
+    if (epoll_ctl(pLoop->epoll, EPOLL_CTL_MOD, (int)pReg->s, &event) != 0)
+    {
+        return FALSE;
+    }
+#else
+    pLoop->fdsDirty = TRUE;
+#endif
+    pReg->interest = interest;
+    return TRUE;
+}
+
+void __cdecl EVLOOP_Remove(EventLoop *pLoop, DWORD id)
+{
+    Registration *pReg = LookupId(pLoop, id);
+    if (!pReg)
+    {
+        return;
+    }
+#if EVLOOP_EPOLL
+    struct epoll_event event = {};
+    epoll_ctl(pLoop->epoll, EPOLL_CTL_DEL, (int)pReg->s, &event);
+#else
+    pLoop->fdsDirty = TRUE;
+#endif
+    pReg->active = FALSE;
+    pReg->generation = (pReg->generation + 1) & ID_GENERATION_MASK;
+    pLoop->freeSlots.push_back(id & ID_INDEX_MASK);
+    pLoop->count--;
+}
+
+static int Dispatch(EventLoop *pLoop, DWORD id, DWORD events)
+{
+    Registration *pReg = LookupId(pLoop, id);
+    if (!pReg)
+    {
+        return 0; // Removed by an earlier callback of this batch
+    }
+    events &= pReg->interest | NET_HANGUP;
+    if (!events)
+    {
+        return 0;
+    }
+    pReg->pfnEvent(pReg->pContext, events);
+    return 1;
+}
+
+int __cdecl EVLOOP_Run(EventLoop *pLoop, DWORD timeoutMs)
+{
+    int timeout = timeoutMs > 0x7FFFFFFF ? 0x7FFFFFFF : (int)timeoutMs;
+#if EVLOOP_EPOLL
+    int ready = epoll_wait(pLoop->epoll, pLoop->events, EVENT_BATCH, timeout);
+    if (ready < 0)
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+    int dispatched = 0;
+    for (int i = 0; i < ready; i++)
+    {
+        DWORD raw = pLoop->events[i].events;
+        DWORD events = ((raw & EPOLLIN) ? NET_READ : 0) | ((raw & EPOLLOUT) ? NET_WRITE : 0) |
+                       ((raw & (EPOLLERR | EPOLLHUP)) ? NET_HANGUP : 0);
+        dispatched += Dispatch(pLoop, (DWORD)pLoop->events[i].data.u64, events);
+    }
+    return dispatched;
+#else
+    if (pLoop->fdsDirty)
+    {
+        pLoop->fds.clear();
+        pLoop->fdIds.clear();
+        for (DWORD i = 0; i < pLoop->slots.size(); i++)
+        {
+            const Registration *pReg = &pLoop->slots[i];
+            if (!pReg->active)
+            {
+                continue;
+            }
+            struct pollfd fd;
+            fd.fd = pReg->s;
+            fd.events = (short)(((pReg->interest & NET_READ) ? POLLIN : 0) |
+                                ((pReg->interest & NET_WRITE) ? POLLOUT : 0));
+            fd.revents = 0;
+            pLoop->fds.push_back(fd);
+            pLoop->fdIds.push_back(MakeId(i, pReg->generation));
+        }
+        pLoop->fdsDirty = FALSE;
+    }
+    if (pLoop->fds.empty())
+    {
+        // WSAPoll rejects an empty set
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        return 0;
+    }
+
+    int ready = PollSockets(&pLoop->fds[0], pLoop->fds.size(), timeout);
+    if (ready < 0)
+    {
+        return -1;
+    }
+    int dispatched = 0;
+    // Callbacks may mark the set dirty but never resize it before the next run
+    for (size_t i = 0; i < pLoop->fds.size() && ready > 0; i++)
+    {
+        short raw = pLoop->fds[i].revents;
+        if (!raw)
+        {
+            continue;
+        }
+        ready--;
+        DWORD events = ((raw & POLLIN) ? NET_READ : 0) | ((raw & POLLOUT) ? NET_WRITE : 0) |
+                       ((raw & (POLLERR | POLLHUP | POLLNVAL)) ? NET_HANGUP : 0);
+        dispatched += Dispatch(pLoop, pLoop->fdIds[i], events);
+    }
+    return dispatched;
+#endif
+}
+
+void __cdecl EVLOOP_Post(EventLoop *pLoop, NetTaskFn pfnTask, void *pContext)
+{
+    PostedTask task = {pfnTask, pContext};
+    {
+        std::lock_guard<std::mutex> lock(pLoop->taskMutex);
+        pLoop->tasks.push_back(task);
+    }
+    if (!pLoop->wakePending.exchange(true))
+    {
+        SignalWake(pLoop);
+    }
+}
+
+uint64_t __cdecl EVLOOP_NowMs(void)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
@@ -0,0 +1,60 @@
+/*
+ * EventLoop.hpp - D2Net readiness event loop
+ *
+ * D2MCPClient drives its connection from a worker thread that wakes on an
+ * event (or a one-second timeout), reads one command into a fixed buffer
+ * and sleeps 10 ms before looking again. The loop here replaces that: any
+ * number of non-blocking sockets are registered with a callback, and one
+ * call waits for the next readiness change and dispatches it.
+ *
+ * The backend is epoll on Linux and poll (WSAPoll) elsewhere. The loop is
+ * level-triggered: a callback that leaves data unread is called again on
+ * the next run.
+ *
+ * A loop and everything registered on it belong to the thread that runs
+ * it; EVLOOP_Post is the one call other threads may make, to hand that
+ * thread work. Callbacks may add, change and remove registrations, their
+ * own included.
+ */
+
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include "Socket.hpp"
+
+#define EVLOOP_INVALID_ID 0xFFFFFFFF
+
+// Interest and readiness bits
+#define NET_READ 0x01
+#define NET_WRITE 0x02
+#define NET_HANGUP 0x04 // Error or peer closed; reported whether asked for or not
+
+typedef void(__cdecl *NetEventFn)(void *pContext, DWORD events);
+typedef void(__cdecl *NetTaskFn)(void *pContext);
+
+typedef struct EventLoop EventLoop;
+
+// maxSockets: registrations at once (0 = 1024)
+EventLoop *__cdecl EVLOOP_Create(DWORD maxSockets);
+// Sockets still registered are not closed; posted tasks still queued are
+// run on the calling thread
+void __cdecl EVLOOP_Destroy(EventLoop *pLoop);
+
+// Registration id, or EVLOOP_INVALID_ID when full
+DWORD __cdecl EVLOOP_Add(EventLoop *pLoop, NetSocket s, DWORD interest, NetEventFn pfnEvent, void *pContext);
+BOOL __cdecl EVLOOP_SetInterest(EventLoop *pLoop, DWORD id, DWORD interest);
+// The socket is left open. Pending events for it are dropped.
+void __cdecl EVLOOP_Remove(EventLoop *pLoop, DWORD id);
+
+// Waits up to timeoutMs for readiness and dispatches it; returns the
+// number of callbacks made, -1 on a backend error
+int __cdecl EVLOOP_Run(EventLoop *pLoop, DWORD timeoutMs);
+
+// Thread-safe. Queues pfnTask to run on the loop's thread during a later
+// EVLOOP_Run, waking the loop if it is waiting. Tasks run in post order.
+void __cdecl EVLOOP_Post(EventLoop *pLoop, NetTaskFn pfnTask, void *pContext);
+
+// Monotonic milliseconds, for callers' deadlines
+uint64_t __cdecl EVLOOP_NowMs(void);
+
+#endif // EVENTLOOP_HPP
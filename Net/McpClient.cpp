@@ -0,0 +1,649 @@
+/*
+ * McpClient.cpp - D2Net realm (MCP) client with pipelined requests
+ *
+ * Requests in flight live in a power-of-two table indexed by sequence:
+ * a new request takes the next sequence whose slot is free, so a reply
+ * finds its request with one index and one compare.
+ */
+
+#include "McpClient.hpp"
+
+#include <string.h>
+#include <vector>
+
+#define DEFAULT_MAX_PENDING 64
+#define DEFAULT_TIMEOUT_MS 10000
+#define DEFAULT_MAX_RECEIVE (1024 * 1024)
+#define INITIAL_BUFFER_BYTES 4096
+#define MAX_SEND_BYTES (1024 * 1024)
+#define RECEIVE_CHUNK 4096
+
+typedef struct PendingRequest
+{
+    DWORD sequence; // 0 = free
+    BYTE command;
+    McpReplyFn pfnReply;
+    void *pContext;
+    uint64_t deadlineMs;
+} PendingRequest;
+
+struct McpClient
+{
+    EventLoop *pLoop;
+    BOOL ownsLoop;
+    char szHost[256];
+    WORD port;
+    DWORD timeoutMs;
+
+    McpState state;
+    NetSocket s;
+    DWORD loopId;
+    DWORD interest;
+    NetBuffer in;
+    NetBuffer out;
+
+    std::vector<PendingRequest> pending;
+    DWORD pendingMask;
+    DWORD maxPending;
+    DWORD pendingCount;
+    DWORD nextSequence;
+    DWORD newestReplied; // Sequence of the newest request answered so far
+    uint64_t nextDeadlineMs;
+
+    McpReplyFn pfnPush;
+    void *pPushContext;
+
+    uint64_t callbacks;
+    McpStats stats;
+};
+
+static void Complete(McpClient *pClient, PendingRequest *pRequest, BYTE status, const BYTE *pPayload, DWORD size)
+{
+    McpReply reply;
+    reply.request = pRequest->sequence;
+    reply.command = pRequest->command;
+    reply.status = status;
+    reply.pPayload = pPayload;
+    reply.payloadSize = size;
+    McpReplyFn pfnReply = pRequest->pfnReply;
+    void *pContext = pRequest->pContext;
+
+    // Free the slot first: the callback may issue a new request into it
+    pRequest->sequence = 0;
+    pClient->pendingCount--;
+    pClient->callbacks++;
+    if (pfnReply)
+    {
+        pfnReply(pContext, &reply);
+    }
+}
+
+static void FailAll(McpClient *pClient, BYTE status)
+{
+    for (DWORD i = 0; i < pClient->pending.size() && pClient->pendingCount; i++)
+    {
+        if (pClient->pending[i].sequence)
+        {
+            pClient->stats.failed++;
+            Complete(pClient, &pClient->pending[i], status, NULL, 0);
+        }
+    }
+}
+
+static void SetInterest(McpClient *pClient, DWORD interest)
+{
+    if (pClient->interest != interest)
+    {
+        EVLOOP_SetInterest(pClient->pLoop, pClient->loopId, interest);
+        pClient->interest = interest;
+    }
+}
+
+static void CloseConnection(McpClient *pClient, BYTE status)
+{
+    if (pClient->state == MCP_CONNECTING || pClient->state == MCP_CONNECTED)
+    {
+        EVLOOP_Remove(pClient->pLoop, pClient->loopId);
+        NET_Close(pClient->s);
+        pClient->s = NET_INVALID_SOCKET;
+        pClient->loopId = EVLOOP_INVALID_ID;
+        pClient->state = MCP_CLOSED;
+        pClient->in.head = pClient->in.tail = 0;
+        pClient->out.head = pClient->out.tail = 0;
+    }
+    FailAll(pClient, status);
+}
+
+// =============================================================================
+// I/O
+// =============================================================================
+
+static void Flush(McpClient *pClient)
+{
+    while (NETBUF_Size(&pClient->out))
+    {
+        int sent = NET_Send(pClient->s, NETBUF_Data(&pClient->out), NETBUF_Size(&pClient->out));
+        pClient->stats.sendCalls++;
+        if (sent < 0)
+        {
+            CloseConnection(pClient, REALM_ERR_DISCONNECTED);
+            return;
+        }
+        if (sent == 0)
+        {
+            SetInterest(pClient, NET_READ | NET_WRITE);
+            return;
+        }
+        pClient->stats.bytesSent += sent;
+        NETBUF_Consume(&pClient->out, (DWORD)sent);
+    }
+    SetInterest(pClient, NET_READ);
+}
+
+static void DispatchFrame(McpClient *pClient, const RealmFrame *pFrame)
+{
+    if (pFrame->sequence == 0)
+    {
+        pClient->stats.pushes++;
+        pClient->callbacks++;
+        if (pClient->pfnPush)
+        {
+            McpReply reply;
+            reply.request = 0;
+            reply.command = pFrame->command;
+            reply.status = pFrame->status;
+            reply.pPayload = pFrame->pPayload;
+            reply.payloadSize = pFrame->payloadSize;
+            pClient->pfnPush(pClient->pPushContext, &reply);
+        }
+        return;
+    }
+
+    PendingRequest *pRequest = &pClient->pending[pFrame->sequence & pClient->pendingMask];
+    if (pRequest->sequence != pFrame->sequence || REALM_REPLY(pRequest->command) != pFrame->command)
+    {
+        return; // Timed out or cancelled already
+    }
+    pClient->stats.replies++;
+    if ((int32_t)(pFrame->sequence - pClient->newestReplied) < 0)
+    {
+        pClient->stats.outOfOrder++;
+    }
+    else
+    {
+        pClient->newestReplied = pFrame->sequence;
+    }
+    Complete(pClient, pRequest, pFrame->status, pFrame->pPayload, pFrame->payloadSize);
+}
+
+static void Receive(McpClient *pClient)
+{
+    for (;;)
+    {
+        DWORD space;
+        BYTE *pSpace = NETBUF_Reserve(&pClient->in, RECEIVE_CHUNK, &space);
+        if (!pSpace)
+        {
+            CloseConnection(pClient, REALM_ERR_DISCONNECTED); // Frame larger than maxReceiveBytes
+            return;
+        }
+        int received = NET_Recv(pClient->s, pSpace, space);
+        pClient->stats.receiveCalls++;
+        if (received < 0)
+        {
+            CloseConnection(pClient, REALM_ERR_DISCONNECTED);
+            return;
+        }
+        if (received == 0)
+        {
+            break;
+        }
+        pClient->stats.bytesReceived += received;
+        NETBUF_Commit(&pClient->in, (DWORD)received);
+        if ((DWORD)received < space)
+        {
+            break;
+        }
+    }
+    if (pClient->in.capacity > pClient->stats.receiveCapacity)
+    {
+        pClient->stats.receiveCapacity = pClient->in.capacity;
+    }
+
+    for (;;)
+    {
+        RealmFrame frame;
+        int size = REALM_ParseFrame(NETBUF_Data(&pClient->in), NETBUF_Size(&pClient->in), &frame);
+        if (size < 0)
+        {
+            CloseConnection(pClient, REALM_ERR_DISCONNECTED);
+            return;
+        }
+        if (size == 0)
+        {
+            break;
+        }
+        DispatchFrame(pClient, &frame);
+        if (pClient->state != MCP_CONNECTED)
+        {
+            return; // A callback disconnected
+        }
+        NETBUF_Consume(&pClient->in, (DWORD)size);
+    }
+}
+
+static void __cdecl OnSocketEvent(void *pContext, DWORD events)
+{
+    McpClient *pClient = (McpClient *)pContext;
+    if (pClient->state == MCP_CONNECTING)
+    {
+        int result = (events & NET_HANGUP) ? -1 : NET_FinishConnect(pClient->s);
+        if (result < 0)
+        {
+            CloseConnection(pClient, REALM_ERR_DISCONNECTED);
+            return;
+        }
+        if (result == 0)
+        {
+            return;
+        }
+        pClient->state = MCP_CONNECTED;
+        Flush(pClient); // Everything requested while connecting
+        return;
+    }
+
+    if (events & NET_READ)
+    {
+        Receive(pClient);
+    }
+    if (pClient->state == MCP_CONNECTED && (events & NET_WRITE))
+    {
+        Flush(pClient);
+    }
+    if (pClient->state == MCP_CONNECTED && (events & NET_HANGUP) && !(events & NET_READ))
+    {
+        CloseConnection(pClient, REALM_ERR_DISCONNECTED);
+    }
+}
+
+static void ExpireRequests(McpClient *pClient, uint64_t nowMs)
+{
+    if (!pClient->pendingCount || nowMs < pClient->nextDeadlineMs)
+    {
+        return;
+    }
+    uint64_t next = UINT64_MAX;
+    for (DWORD i = 0; i < pClient->pending.size(); i++)
+    {
+        PendingRequest *pRequest = &pClient->pending[i];
+        if (!pRequest->sequence)
+        {
+            continue;
+        }
+        if (pRequest->deadlineMs <= nowMs)
+        {
+            pClient->stats.timeouts++;
+            Complete(pClient, pRequest, REALM_ERR_TIMEOUT, NULL, 0);
+        }
+        else if (pRequest->deadlineMs < next)
+        {
+            next = pRequest->deadlineMs;
+        }
+    }
+    pClient->nextDeadlineMs = next;
+}
+
+// =============================================================================
+// CLIENT
+// =============================================================================
+
+McpClient *__cdecl MCP_Create(const McpClientDesc *pDesc)
+{
+    if (!pDesc || !pDesc->szHost || strlen(pDesc->szHost) >= sizeof(((McpClient *)0)->szHost) || !NET_Startup())
+    {
+        return NULL;
+    }
+
+    McpClient *pClient = new McpClient;
+    pClient->ownsLoop = pDesc->pLoop == NULL;
+    pClient->pLoop = pClient->ownsLoop ? EVLOOP_Create(4) : pDesc->pLoop;
+    if (!pClient->pLoop)
+    {
+        delete pClient;
+        NET_Cleanup();
+        return NULL;
+    }
+    strcpy(pClient->szHost, pDesc->szHost);
+    pClient->port = pDesc->port;
+    pClient->timeoutMs = pDesc->timeoutMs ? pDesc->timeoutMs : DEFAULT_TIMEOUT_MS;
+
+    pClient->state = MCP_IDLE;
+    pClient->s = NET_INVALID_SOCKET;
+    pClient->loopId = EVLOOP_INVALID_ID;
+    pClient->interest = 0;
+    NETBUF_Init(&pClient->in, INITIAL_BUFFER_BYTES,
+                pDesc->maxReceiveBytes ? pDesc->maxReceiveBytes : DEFAULT_MAX_RECEIVE);
+    NETBUF_Init(&pClient->out, INITIAL_BUFFER_BYTES, MAX_SEND_BYTES);
+
+    pClient->maxPending = pDesc->maxPending ? pDesc->maxPending : DEFAULT_MAX_PENDING;
+    DWORD tableSize = 1;
+    while (tableSize < pClient->maxPending)
+    {
+        tableSize <<= 1;
+    }
+    PendingRequest empty;
+    memset(&empty, 0, sizeof(empty));
+    pClient->pending.assign(tableSize, empty);
+    pClient->pendingMask = tableSize - 1;
+    pClient->pendingCount = 0;
+    pClient->nextSequence = 1;
+    pClient->newestReplied = 0;
+    pClient->nextDeadlineMs = UINT64_MAX;
+
+    pClient->pfnPush = NULL;
+    pClient->pPushContext = NULL;
+    pClient->callbacks = 0;
+    memset(&pClient->stats, 0, sizeof(pClient->stats));
+    return pClient;
+}
+
+void __cdecl MCP_Destroy(McpClient *pClient)
+{
+    if (!pClient)
+    {
+        return;
+    }
+    CloseConnection(pClient, REALM_ERR_CANCELLED);
+    FailAll(pClient, REALM_ERR_CANCELLED);
+    NETBUF_Free(&pClient->in);
+    NETBUF_Free(&pClient->out);
+    if (pClient->ownsLoop)
+    {
+        EVLOOP_Destroy(pClient->pLoop);
+    }
+    delete pClient;
+    NET_Cleanup();
+}
+
+BOOL __cdecl MCP_Connect(McpClient *pClient)
+{
+    if (pClient->state == MCP_CONNECTING || pClient->state == MCP_CONNECTED)
+    {
+        return TRUE;
+    }
+    NetSocket s = NET_Connect(pClient->szHost, pClient->port);
+    if (s == NET_INVALID_SOCKET)
+    {
+        return FALSE;
+    }
+    // Writable = connected (or failed)
+    DWORD loopId = EVLOOP_Add(pClient->pLoop, s, NET_WRITE, OnSocketEvent, pClient);
+    if (loopId == EVLOOP_INVALID_ID)
+    {
+        NET_Close(s);
+        return FALSE;
+    }
+    pClient->s = s;
+    pClient->loopId = loopId;
+    pClient->interest = NET_WRITE;
+    pClient->state = MCP_CONNECTING;
+    pClient->newestReplied = pClient->nextSequence - 1;
+    return TRUE;
+}
+
+void __cdecl MCP_Disconnect(McpClient *pClient)
+{
+    CloseConnection(pClient, REALM_ERR_DISCONNECTED);
+}
+
+McpState __cdecl MCP_GetState(const McpClient *pClient)
+{
+    return pClient->state;
+}
+
+void __cdecl MCP_SetPushHandler(McpClient *pClient, McpReplyFn pfnPush, void *pContext)
+{
+    pClient->pfnPush = pfnPush;
+    pClient->pPushContext = pContext;
+}
+
+// =============================================================================
+// REQUESTS
+// =============================================================================
+
+// Reserves a sequence and starts the request's frame in the output buffer
+static PendingRequest *BeginRequest(McpClient *pClient, BYTE command, McpReplyFn pfnReply, void *pContext,
+                                    RealmWriter *pWriter)
+{
+    if ((pClient->state != MCP_CONNECTING && pClient->state != MCP_CONNECTED) ||
+        pClient->pendingCount >= pClient->maxPending || command >= REALM_COMMAND_COUNT || (command & 1))
+    {
+        return NULL;
+    }
+    DWORD sequence = pClient->nextSequence;
+    while (sequence == 0 || pClient->pending[sequence & pClient->pendingMask].sequence)
+    {
+        sequence++;
+    }
+    pClient->nextSequence = sequence + 1;
+
+    PendingRequest *pRequest = &pClient->pending[sequence & pClient->pendingMask];
+    pRequest->sequence = sequence;
+    pRequest->command = command;
+    pRequest->pfnReply = pfnReply;
+    pRequest->pContext = pContext;
+    pRequest->deadlineMs = EVLOOP_NowMs() + pClient->timeoutMs;
+    REALM_BeginFrame(pWriter, &pClient->out, command, REALM_OK, sequence);
+    return pRequest;
+}
+
+static DWORD EndRequest(McpClient *pClient, PendingRequest *pRequest, RealmWriter *pWriter)
+{
+    if (!pRequest)
+    {
+        return MCP_INVALID_REQUEST;
+    }
+    if (!REALM_EndFrame(pWriter))
+    {
+        pRequest->sequence = 0;
+        return MCP_INVALID_REQUEST;
+    }
+    pClient->pendingCount++;
+    pClient->stats.requests++;
+    if (pClient->pendingCount > pClient->stats.maxInFlight)
+    {
+        pClient->stats.maxInFlight = pClient->pendingCount;
+    }
+    if (pRequest->deadlineMs < pClient->nextDeadlineMs)
+    {
+        pClient->nextDeadlineMs = pRequest->deadlineMs;
+    }
+    // Sent on the next loop run with whatever else is queued by then
+    if (pClient->state == MCP_CONNECTED)
+    {
+        SetInterest(pClient, NET_READ | NET_WRITE);
+    }
+    return pRequest->sequence;
+}
+
+DWORD __cdecl MCP_Request(McpClient *pClient, BYTE command, const void *pPayload, DWORD size, McpReplyFn pfnReply,
+                          void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, command, pfnReply, pContext, &writer);
+    if (pRequest && size)
+    {
+        REALM_PutBytes(&writer, pPayload, size);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_Logon(McpClient *pClient, DWORD cookie, const char *szAccount, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_LOGON, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutDword(&writer, cookie);
+        REALM_PutString(&writer, szAccount);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_CreateChar(McpClient *pClient, BYTE charClass, WORD flags, const char *szName, McpReplyFn pfnReply,
+                             void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_CHARCREATE, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutByte(&writer, charClass);
+        REALM_PutWord(&writer, flags);
+        REALM_PutString(&writer, szName);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_RequestCharList(McpClient *pClient, WORD maxChars, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_CHARLIST, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutWord(&writer, maxChars);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_CharLogon(McpClient *pClient, const char *szName, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_CHARLOGON, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutString(&writer, szName);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_RequestGameList(McpClient *pClient, const char *szFilter, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_GAMELIST, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutString(&writer, szFilter);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_RequestGameInfo(McpClient *pClient, DWORD gameId, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_GAMEINFO, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutDword(&writer, gameId);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_CreateGame(McpClient *pClient, const char *szName, const char *szPassword, BYTE difficulty,
+                             BYTE maxPlayers, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_CREATEGAME, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutByte(&writer, difficulty);
+        REALM_PutByte(&writer, maxPlayers);
+        REALM_PutString(&writer, szName);
+        REALM_PutString(&writer, szPassword);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_JoinGame(McpClient *pClient, const char *szName, const char *szPassword, McpReplyFn pfnReply,
+                           void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_JOINGAME, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutString(&writer, szName);
+        REALM_PutString(&writer, szPassword);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_JoinChannel(McpClient *pClient, const char *szChannel, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_CHANNELJOIN, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutString(&writer, szChannel);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_LeaveChannel(McpClient *pClient, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_CHANNELLEAVE, pfnReply, pContext, &writer);
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+DWORD __cdecl MCP_Chat(McpClient *pClient, const char *szText, McpReplyFn pfnReply, void *pContext)
+{
+    RealmWriter writer;
+    PendingRequest *pRequest = BeginRequest(pClient, REALM_CMD_CHAT, pfnReply, pContext, &writer);
+    if (pRequest)
+    {
+        REALM_PutString(&writer, szText);
+    }
+    return EndRequest(pClient, pRequest, &writer);
+}
+
+BOOL __cdecl MCP_Cancel(McpClient *pClient, DWORD request)
+{
+    PendingRequest *pRequest = &pClient->pending[request & pClient->pendingMask];
+    if (request == MCP_INVALID_REQUEST || pRequest->sequence != request)
+    {
+        return FALSE;
+    }
+    pClient->stats.failed++;
+    Complete(pClient, pRequest, REALM_ERR_CANCELLED, NULL, 0);
+    return TRUE;
+}
+
+int __cdecl MCP_Pump(McpClient *pClient, DWORD timeoutMs)
+{
+    uint64_t callbacks = pClient->callbacks;
+    if (pClient->ownsLoop)
+    {
+        if (pClient->state == MCP_CONNECTING || pClient->state == MCP_CONNECTED)
+        {
+            // Never sleep past the next request deadline
+            uint64_t nowMs = EVLOOP_NowMs();
+            if (pClient->pendingCount && pClient->nextDeadlineMs < nowMs + timeoutMs)
+            {
+                timeoutMs = pClient->nextDeadlineMs > nowMs ? (DWORD)(pClient->nextDeadlineMs - nowMs) : 0;
+            }
+            EVLOOP_Run(pClient->pLoop, timeoutMs);
+        }
+    }
+    // Requests issued by callbacks go out now rather than on the next pump
+    if (pClient->state == MCP_CONNECTED && NETBUF_Size(&pClient->out))
+    {
+        Flush(pClient);
+    }
+    ExpireRequests(pClient, EVLOOP_NowMs());
+    return (int)(pClient->callbacks - callbacks);
+}
+
+void __cdecl MCP_GetStats(const McpClient *pClient, McpStats *pStats)
+{
+    *pStats = pClient->stats;
+    pStats->pending = pClient->pendingCount;
+}
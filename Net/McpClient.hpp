@@ -0,0 +1,131 @@
+/*
+ * McpClient.hpp - D2Net realm (MCP) client with pipelined requests
+ *
+ * D2MCPClient's worker thread sends one request, waits for its reply, and
+ * only then sends the next. Character select costs a round trip for the
+ * logon, the character list, the character logon, the game list and then
+ * one more for every game's details, so on a distant realm the screen
+ * takes seconds to fill.
+ *
+ * This client runs on an EventLoop and does not wait: each request is
+ * appended to the connection's output buffer and goes out on the next
+ * loop run, together with anything else queued by then. Replies are
+ * matched to requests by sequence number in whatever order the realm
+ * sends them, and each request's callback is made exactly once: with the
+ * reply, or with REALM_ERR_TIMEOUT, REALM_ERR_DISCONNECTED or
+ * REALM_ERR_CANCELLED.
+ *
+ * Received frames are parsed in place in a growable buffer and handed to
+ * callbacks without copying; a reply's payload (and anything REALM_Get*
+ * decodes from it) is only valid during the callback.
+ *
+ * Usage from the CharSelect state: create the client and MCP_Connect it
+ * when the state is entered, issue the requests the screen needs right
+ * away (they are sent once the connection is up), and call MCP_Pump(0)
+ * every frame; the callbacks fill in the screen as replies arrive.
+ *
+ * Not thread-safe; use a client from the thread that pumps it. Callbacks
+ * may issue and cancel requests and disconnect, but must not destroy the
+ * client.
+ */
+
+#ifndef MCPCLIENT_HPP
+#define MCPCLIENT_HPP
+
+#include "EventLoop.hpp"
+#include "RealmProtocol.hpp"
+
+#define MCP_INVALID_REQUEST 0
+
+typedef enum McpState
+{
+    MCP_IDLE,       // Not connected yet
+    MCP_CONNECTING, // Requests are queued until the connection is up
+    MCP_CONNECTED,
+    MCP_CLOSED, // Failed or disconnected; MCP_Connect starts over
+} McpState;
+
+typedef struct McpClientDesc
+{
+    EventLoop *pLoop; // NULL = the client owns one and runs it in MCP_Pump
+    const char *szHost;
+    WORD port;
+    DWORD maxPending;      // Requests in flight at once (0 = 64)
+    DWORD timeoutMs;       // Per request (0 = 10000)
+    DWORD maxReceiveBytes; // Receive buffer limit (0 = 1 MB); a larger frame drops the connection
+} McpClientDesc;
+
+typedef struct McpReply
+{
+    DWORD request; // As returned when it was issued; 0 for pushes
+    BYTE command;  // The request's command (the push's own for pushes)
+    BYTE status;   // REALM_OK or REALM_ERR_*
+    const BYTE *pPayload;
+    DWORD payloadSize;
+} McpReply;
+
+typedef void(__cdecl *McpReplyFn)(void *pContext, const McpReply *pReply);
+
+typedef struct McpStats
+{
+    uint64_t requests;
+    uint64_t replies;
+    uint64_t outOfOrder; // Replies that overtook an older request
+    uint64_t timeouts;
+    uint64_t failed; // Disconnected or cancelled
+    uint64_t pushes;
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    uint64_t sendCalls;
+    uint64_t receiveCalls;
+    DWORD maxInFlight;
+    DWORD pending;
+    DWORD receiveCapacity; // Current size of the receive buffer
+} McpStats;
+
+typedef struct McpClient McpClient;
+
+McpClient *__cdecl MCP_Create(const McpClientDesc *pDesc);
+// Pending requests complete with REALM_ERR_CANCELLED
+void __cdecl MCP_Destroy(McpClient *pClient);
+
+// Starts connecting; FALSE if the address does not resolve or no socket
+BOOL __cdecl MCP_Connect(McpClient *pClient);
+// Pending requests complete with REALM_ERR_DISCONNECTED
+void __cdecl MCP_Disconnect(McpClient *pClient);
+McpState __cdecl MCP_GetState(const McpClient *pClient);
+
+// Unsolicited frames (REALM_CMD_GAMEUPDATE, REALM_CMD_CHATEVENT)
+void __cdecl MCP_SetPushHandler(McpClient *pClient, McpReplyFn pfnPush, void *pContext);
+
+// Each returns the request id, or MCP_INVALID_REQUEST when the client is
+// idle or closed, or maxPending requests are already in flight
+DWORD __cdecl MCP_Request(McpClient *pClient, BYTE command, const void *pPayload, DWORD size, McpReplyFn pfnReply,
+                          void *pContext);
+DWORD __cdecl MCP_Logon(McpClient *pClient, DWORD cookie, const char *szAccount, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_CreateChar(McpClient *pClient, BYTE charClass, WORD flags, const char *szName, McpReplyFn pfnReply,
+                             void *pContext);
+DWORD __cdecl MCP_RequestCharList(McpClient *pClient, WORD maxChars, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_CharLogon(McpClient *pClient, const char *szName, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_RequestGameList(McpClient *pClient, const char *szFilter, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_RequestGameInfo(McpClient *pClient, DWORD gameId, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_CreateGame(McpClient *pClient, const char *szName, const char *szPassword, BYTE difficulty,
+                             BYTE maxPlayers, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_JoinGame(McpClient *pClient, const char *szName, const char *szPassword, McpReplyFn pfnReply,
+                           void *pContext);
+DWORD __cdecl MCP_JoinChannel(McpClient *pClient, const char *szChannel, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_LeaveChannel(McpClient *pClient, McpReplyFn pfnReply, void *pContext);
+DWORD __cdecl MCP_Chat(McpClient *pClient, const char *szText, McpReplyFn pfnReply, void *pContext);
+
+// Completes the request now with REALM_ERR_CANCELLED; its reply, if one
+// comes, is dropped. FALSE if it already completed.
+BOOL __cdecl MCP_Cancel(McpClient *pClient, DWORD request);
+
+// Runs the client's own loop for up to timeoutMs (an external loop is run
+// by its owner), sends queued requests and expires overdue ones. Returns
+// the number of callbacks made.
+int __cdecl MCP_Pump(McpClient *pClient, DWORD timeoutMs);
+
+void __cdecl MCP_GetStats(const McpClient *pClient, McpStats *pStats);
+
+#endif // MCPCLIENT_HPP
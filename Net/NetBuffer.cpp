@@ -0,0 +1,92 @@
+/*
+ * NetBuffer.cpp - D2Net growable byte buffer for socket I/O
+ */
+
+#include "NetBuffer.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+void __cdecl NETBUF_Init(NetBuffer *pBuffer, DWORD initialCapacity, DWORD maxCapacity)
+{
+    pBuffer->pData = NULL;
+    pBuffer->capacity = 0;
+    pBuffer->maxCapacity = maxCapacity < initialCapacity ? initialCapacity : maxCapacity;
+    pBuffer->head = 0;
+    pBuffer->tail = 0;
+    if (initialCapacity)
+    {
+        pBuffer->pData = (BYTE *)malloc(initialCapacity);
+        pBuffer->capacity = pBuffer->pData ? initialCapacity : 0;
+    }
+}
+
+void __cdecl NETBUF_Free(NetBuffer *pBuffer)
+{
+    free(pBuffer->pData);
+    pBuffer->pData = NULL;
+    pBuffer->capacity = 0;
+    pBuffer->head = 0;
+    pBuffer->tail = 0;
+}
+
+BYTE *__cdecl NETBUF_Reserve(NetBuffer *pBuffer, DWORD minSpace, DWORD *pSpace)
+{
+    if (pBuffer->capacity - pBuffer->tail < minSpace)
+    {
+        DWORD size = NETBUF_Size(pBuffer);
+        if (pBuffer->capacity - size >= minSpace)
+        {
+            // Move the unread bytes to the front
+            memmove(pBuffer->pData, pBuffer->pData + pBuffer->head, size);
+        }
+        else
+        {
+            uint64_t needed = (uint64_t)size + minSpace;
+            if (needed > pBuffer->maxCapacity)
+            {
+                return NULL;
+            }
+            uint64_t capacity = pBuffer->capacity ? pBuffer->capacity : 256;
+            while (capacity < needed)
+            {
+                capacity *= 2;
+            }
+            if (capacity > pBuffer->maxCapacity)
+            {
+                capacity = pBuffer->maxCapacity;
+            }
+            BYTE *pData = (BYTE *)malloc((size_t)capacity);
+            if (!pData)
+            {
+                return NULL;
+            }
+            if (size)
+            {
+                memcpy(pData, pBuffer->pData + pBuffer->head, size);
+            }
+            free(pBuffer->pData);
+            pBuffer->pData = pData;
+            pBuffer->capacity = (DWORD)capacity;
+        }
+        pBuffer->head = 0;
+        pBuffer->tail = size;
+    }
+    if (pSpace)
+    {
+        *pSpace = pBuffer->capacity - pBuffer->tail;
+    }
+    return pBuffer->pData + pBuffer->tail;
+}
+
+BOOL __cdecl NETBUF_Append(NetBuffer *pBuffer, const void *pData, DWORD size)
+{
+    BYTE *pOut = NETBUF_Reserve(pBuffer, size, NULL);
+    if (!pOut)
+    {
+        return FALSE;
+    }
+    memcpy(pOut, pData, size);
+    pBuffer->tail += size;
+    return TRUE;
+}
@@ -0,0 +1,64 @@
+/*
+ * NetBuffer.hpp - D2Net growable byte buffer for socket I/O
+ *
+ * D2MCPClient reads each command into a fixed 1024-byte stack buffer, so a
+ * reply that does not fit (a long game list) cannot be received at all.
+ *
+ * A NetBuffer is one contiguous region with a read offset and a write
+ * offset. Sockets receive straight into the free space after the write
+ * offset and frames are parsed and handed out in place, so a byte is
+ * copied once, by the kernel. Outgoing frames are encoded directly into the
+ * free space as well and sent from there. When the free space runs short,
+ * the unread bytes (usually a partial frame) move to the front; only when
+ * that is not enough does the region grow, doubling up to maxCapacity.
+ */
+
+#ifndef NETBUFFER_HPP
+#define NETBUFFER_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef struct NetBuffer
+{
+    BYTE *pData;
+    DWORD capacity;
+    DWORD maxCapacity;
+    DWORD head; // First unread byte
+    DWORD tail; // End of the data
+} NetBuffer;
+
+void __cdecl NETBUF_Init(NetBuffer *pBuffer, DWORD initialCapacity, DWORD maxCapacity);
+void __cdecl NETBUF_Free(NetBuffer *pBuffer);
+
+// Makes at least minSpace contiguous bytes writable after the data and
+// returns them (how many in pSpace), or NULL past maxCapacity. Pointers
+// into the buffer are invalidated.
+BYTE *__cdecl NETBUF_Reserve(NetBuffer *pBuffer, DWORD minSpace, DWORD *pSpace);
+BOOL __cdecl NETBUF_Append(NetBuffer *pBuffer, const void *pData, DWORD size);
+
+static inline DWORD NETBUF_Size(const NetBuffer *pBuffer)
+{
+    return pBuffer->tail - pBuffer->head;
+}
+
+static inline const BYTE *NETBUF_Data(const NetBuffer *pBuffer)
+{
+    return pBuffer->pData + pBuffer->head;
+}
+
+// Marks bytes written into reserved space as data
+static inline void NETBUF_Commit(NetBuffer *pBuffer, DWORD size)
+{
+    pBuffer->tail += size;
+}
+
+static inline void NETBUF_Consume(NetBuffer *pBuffer, DWORD size)
+{
+    pBuffer->head += size;
+    if (pBuffer->head == pBuffer->tail)
+    {
+        pBuffer->head = pBuffer->tail = 0;
+    }
+}
+
+#endif // NETBUFFER_HPP
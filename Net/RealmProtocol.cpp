@@ -0,0 +1,288 @@
+/*
+ * RealmProtocol.cpp - D2Net realm (MCP) wire format
+ */
+
+#include "RealmProtocol.hpp"
+
+#include <string.h>
+
+static WORD LoadWord(const BYTE *p)
+{
+    return (WORD)(p[0] | (p[1] << 8));
+}
+
+static DWORD LoadDword(const BYTE *p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static void StoreWord(BYTE *p, WORD value)
+{
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+}
+
+static void StoreDword(BYTE *p, DWORD value)
+{
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+    p[2] = (BYTE)(value >> 16);
+    p[3] = (BYTE)(value >> 24);
+}
+
+int __cdecl REALM_ParseFrame(const BYTE *pData, DWORD size, RealmFrame *pFrame)
+{
+    if (size < 2)
+    {
+        return 0;
+    }
+    DWORD frameSize = LoadWord(pData);
+    if (frameSize < REALM_HEADER_BYTES || pData[2] >= REALM_COMMAND_COUNT)
+    {
+        return -1;
+    }
+    if (size < frameSize)
+    {
+        return 0;
+    }
+    pFrame->command = pData[2];
+    pFrame->status = pData[3];
+    pFrame->sequence = LoadDword(pData + 4);
+    pFrame->pPayload = pData + REALM_HEADER_BYTES;
+    pFrame->payloadSize = frameSize - REALM_HEADER_BYTES;
+    return (int)frameSize;
+}
+
+// =============================================================================
+// WRITING
+// =============================================================================
+
+void __cdecl REALM_BeginFrame(RealmWriter *pWriter, NetBuffer *pBuffer, BYTE command, BYTE status, DWORD sequence)
+{
+    BYTE header[REALM_HEADER_BYTES];
+    StoreWord(header, 0);
+    header[2] = command;
+    header[3] = status;
+    StoreDword(header + 4, sequence);
+
+    pWriter->pBuffer = pBuffer;
+    pWriter->start = NETBUF_Size(pBuffer);
+    pWriter->overflow = !NETBUF_Append(pBuffer, header, sizeof(header));
+}
+
+BOOL __cdecl REALM_EndFrame(RealmWriter *pWriter)
+{
+    NetBuffer *pBuffer = pWriter->pBuffer;
+    DWORD frameSize = NETBUF_Size(pBuffer) - pWriter->start;
+    if (pWriter->overflow || frameSize > REALM_MAX_FRAME)
+    {
+        pBuffer->tail = pBuffer->head + pWriter->start;
+        return FALSE;
+    }
+    // The read offset does not move while a frame is written, so start still locates it
+    StoreWord(pBuffer->pData + pBuffer->head + pWriter->start, (WORD)frameSize);
+    return TRUE;
+}
+
+void __cdecl REALM_PutBytes(RealmWriter *pWriter, const void *pData, DWORD size)
+{
+    if (!pWriter->overflow && !NETBUF_Append(pWriter->pBuffer, pData, size))
+    {
+        pWriter->overflow = TRUE;
+    }
+}
+
+void __cdecl REALM_PutByte(RealmWriter *pWriter, BYTE value)
+{
+    REALM_PutBytes(pWriter, &value, 1);
+}
+
+void __cdecl REALM_PutWord(RealmWriter *pWriter, WORD value)
+{
+    BYTE bytes[2];
+    StoreWord(bytes, value);
+    REALM_PutBytes(pWriter, bytes, 2);
+}
+
+void __cdecl REALM_PutDword(RealmWriter *pWriter, DWORD value)
+{
+    BYTE bytes[4];
+    StoreDword(bytes, value);
+    REALM_PutBytes(pWriter, bytes, 4);
+}
+
+void __cdecl REALM_PutString(RealmWriter *pWriter, const char *szValue)
+{
+    if (!szValue)
+    {
+        szValue = "";
+    }
+    REALM_PutBytes(pWriter, szValue, (DWORD)strlen(szValue) + 1);
+}
+
+void __cdecl REALM_PutCharEntry(RealmWriter *pWriter, const RealmCharEntry *pEntry)
+{
+    REALM_PutByte(pWriter, pEntry->charClass);
+    REALM_PutByte(pWriter, pEntry->level);
+    REALM_PutWord(pWriter, pEntry->flags);
+    REALM_PutString(pWriter, pEntry->szName);
+}
+
+void __cdecl REALM_PutGameEntry(RealmWriter *pWriter, const RealmGameEntry *pEntry)
+{
+    REALM_PutDword(pWriter, pEntry->gameId);
+    REALM_PutByte(pWriter, pEntry->players);
+    REALM_PutByte(pWriter, pEntry->maxPlayers);
+    REALM_PutByte(pWriter, pEntry->difficulty);
+    REALM_PutByte(pWriter, pEntry->flags);
+    REALM_PutString(pWriter, pEntry->szName);
+    REALM_PutString(pWriter, pEntry->szDescription);
+}
+
+void __cdecl REALM_PutJoinInfo(RealmWriter *pWriter, const RealmJoinInfo *pInfo)
+{
+    REALM_PutDword(pWriter, pInfo->gameToken);
+    REALM_PutBytes(pWriter, &pInfo->address, 4); // Already in network order
+    REALM_PutWord(pWriter, pInfo->port);
+    REALM_PutDword(pWriter, pInfo->gameHash);
+}
+
+void __cdecl REALM_PutGameInfo(RealmWriter *pWriter, const RealmGameInfo *pInfo)
+{
+    BYTE count = pInfo->playerCount > REALM_MAX_GAME_PLAYERS ? REALM_MAX_GAME_PLAYERS : pInfo->playerCount;
+    REALM_PutDword(pWriter, pInfo->gameId);
+    REALM_PutDword(pWriter, pInfo->uptimeSeconds);
+    REALM_PutByte(pWriter, pInfo->difficulty);
+    REALM_PutByte(pWriter, count);
+    for (BYTE i = 0; i < count; i++)
+    {
+        REALM_PutCharEntry(pWriter, &pInfo->players[i]);
+    }
+}
+
+void __cdecl REALM_PutChatEvent(RealmWriter *pWriter, const RealmChatEvent *pEvent)
+{
+    REALM_PutByte(pWriter, pEvent->type);
+    REALM_PutString(pWriter, pEvent->szUser);
+    REALM_PutString(pWriter, pEvent->szText);
+}
+
+// =============================================================================
+// READING
+// =============================================================================
+
+void __cdecl REALM_InitReader(RealmReader *pReader, const BYTE *pPayload, DWORD size)
+{
+    pReader->pData = pPayload;
+    pReader->size = size;
+    pReader->pos = 0;
+    pReader->error = FALSE;
+}
+
+static const BYTE *Take(RealmReader *pReader, DWORD size)
+{
+    if (pReader->error || pReader->size - pReader->pos < size)
+    {
+        pReader->error = TRUE;
+        return NULL;
+    }
+    const BYTE *p = pReader->pData + pReader->pos;
+    pReader->pos += size;
+    return p;
+}
+
+BYTE __cdecl REALM_GetByte(RealmReader *pReader)
+{
+    const BYTE *p = Take(pReader, 1);
+    return p ? p[0] : 0;
+}
+
+WORD __cdecl REALM_GetWord(RealmReader *pReader)
+{
+    const BYTE *p = Take(pReader, 2);
+    return p ? LoadWord(p) : 0;
+}
+
+DWORD __cdecl REALM_GetDword(RealmReader *pReader)
+{
+    const BYTE *p = Take(pReader, 4);
+    return p ? LoadDword(p) : 0;
+}
+
+const char *__cdecl REALM_GetString(RealmReader *pReader)
+{
+    if (pReader->error)
+    {
+        return "";
+    }
+    const BYTE *pStart = pReader->pData + pReader->pos;
+    const BYTE *pEnd = (const BYTE *)memchr(pStart, 0, pReader->size - pReader->pos);
+    if (!pEnd)
+    {
+        pReader->error = TRUE;
+        return "";
+    }
+    pReader->pos += (DWORD)(pEnd - pStart) + 1;
+    return (const char *)pStart;
+}
+
+BOOL __cdecl REALM_GetCharEntry(RealmReader *pReader, RealmCharEntry *pEntry)
+{
+    pEntry->charClass = REALM_GetByte(pReader);
+    pEntry->level = REALM_GetByte(pReader);
+    pEntry->flags = REALM_GetWord(pReader);
+    pEntry->szName = REALM_GetString(pReader);
+    return !pReader->error;
+}
+
+BOOL __cdecl REALM_GetGameEntry(RealmReader *pReader, RealmGameEntry *pEntry)
+{
+    pEntry->gameId = REALM_GetDword(pReader);
+    pEntry->players = REALM_GetByte(pReader);
+    pEntry->maxPlayers = REALM_GetByte(pReader);
+    pEntry->difficulty = REALM_GetByte(pReader);
+    pEntry->flags = REALM_GetByte(pReader);
+    pEntry->szName = REALM_GetString(pReader);
+    pEntry->szDescription = REALM_GetString(pReader);
+    return !pReader->error;
+}
+
+BOOL __cdecl REALM_GetJoinInfo(RealmReader *pReader, RealmJoinInfo *pInfo)
+{
+    pInfo->gameToken = REALM_GetDword(pReader);
+    const BYTE *pAddress = Take(pReader, 4);
+    pInfo->address = 0;
+    if (pAddress)
+    {
+        memcpy(&pInfo->address, pAddress, 4);
+    }
+    pInfo->port = REALM_GetWord(pReader);
+    pInfo->gameHash = REALM_GetDword(pReader);
+    return !pReader->error;
+}
+
+BOOL __cdecl REALM_GetGameInfo(RealmReader *pReader, RealmGameInfo *pInfo)
+{
+    pInfo->gameId = REALM_GetDword(pReader);
+    pInfo->uptimeSeconds = REALM_GetDword(pReader);
+    pInfo->difficulty = REALM_GetByte(pReader);
+    pInfo->playerCount = REALM_GetByte(pReader);
+    if (pInfo->playerCount > REALM_MAX_GAME_PLAYERS)
+    {
+        pReader->error = TRUE;
+        pInfo->playerCount = 0;
+    }
+    for (BYTE i = 0; i < pInfo->playerCount; i++)
+    {
+        REALM_GetCharEntry(pReader, &pInfo->players[i]);
+    }
+    return !pReader->error;
+}
+
+BOOL __cdecl REALM_GetChatEvent(RealmReader *pReader, RealmChatEvent *pEvent)
+{
+    pEvent->type = REALM_GetByte(pReader);
+    pEvent->szUser = REALM_GetString(pReader);
+    pEvent->szText = REALM_GetString(pReader);
+    return !pReader->error;
+}
@@ -0,0 +1,195 @@
+/*
+ * RealmProtocol.hpp - D2Net realm (MCP) wire format
+ *
+ * D2MCPClient dispatches commands 0x00-0x19 through a 26-entry handler
+ * table; the first byte of a command is its id and every command has to
+ * fit 1024 bytes. Requests carry nothing that ties a reply to them, so the
+ * client can only have one outstanding at a time.
+ *
+ * Frames here keep the command range and add a sequence number:
+ *
+ *   WORD  size      whole frame, header included (8-65535)
+ *   BYTE  command   REALM_CMD_*; a reply is its request's command | 1
+ *   BYTE  status    REALM_OK or REALM_ERR_* (0 in requests)
+ *   DWORD sequence  chosen by the client, echoed in the reply; 0 on pushes
+ *   ...   payload
+ *
+ * All integers are little-endian; strings are NUL-terminated UTF-8. The
+ * server handles a connection's requests in the order they arrive but
+ * may reply in any order, so a client can pipeline (send the character
+ * list, game list and join requests back to back) and match the replies
+ * by sequence.
+ *
+ * Readers return pointers into the frame: entries and strings decoded by
+ * REALM_Get* stay valid as long as the frame's bytes do.
+ */
+
+#ifndef REALMPROTOCOL_HPP
+#define REALMPROTOCOL_HPP
+
+#include "NetBuffer.hpp"
+
+#define REALM_HEADER_BYTES 8
+#define REALM_MAX_FRAME 0xFFFF
+#define REALM_MAX_PAYLOAD (REALM_MAX_FRAME - REALM_HEADER_BYTES)
+#define REALM_MAX_NAME 16 // Character and account names, NUL included
+#define REALM_MAX_GAME_NAME 32
+#define REALM_MAX_GAME_PLAYERS 8
+#define REALM_MAX_CHANNEL_NAME 32
+#define REALM_MAX_CHAT_TEXT 256
+
+// Requests (even) and their replies (request | 1)
+#define REALM_CMD_LOGON 0x00        // DWORD cookie, string account
+#define REALM_CMD_CHARCREATE 0x02   // BYTE class, WORD flags, string name
+#define REALM_CMD_CHARDELETE 0x04   // string name
+#define REALM_CMD_GAMELIST 0x06     // string filter -> WORD count, RealmGameEntry[count]
+#define REALM_CMD_JOINGAME 0x08     // string game, string password -> RealmJoinInfo
+#define REALM_CMD_CHARLIST 0x0A     // WORD max -> WORD count, RealmCharEntry[count]
+#define REALM_CMD_CHARLOGON 0x0C    // string name
+#define REALM_CMD_CREATEGAME 0x0E   // BYTE difficulty, BYTE maxPlayers, string game, string password -> DWORD gameId
+#define REALM_CMD_GAMEINFO 0x10     // DWORD gameId -> RealmGameInfo
+#define REALM_CMD_CHANNELJOIN 0x12  // string channel -> WORD members (the joiner included)
+#define REALM_CMD_CHANNELLEAVE 0x14 // (none)
+#define REALM_CMD_CHAT 0x16         // string text, said in the current channel
+// Server pushes (sequence 0)
+#define REALM_CMD_CHATEVENT 0x18    // RealmChatEvent
+#define REALM_CMD_GAMEUPDATE 0x19   // RealmGameEntry, BYTE removed
+#define REALM_COMMAND_COUNT 0x1A
+
+#define REALM_REPLY(command) ((BYTE)((command) | 1))
+
+// Reply status
+#define REALM_OK 0x00
+#define REALM_ERR_FAILED 0x01
+#define REALM_ERR_NOT_LOGGED_ON 0x02 // No account, or no character selected
+#define REALM_ERR_NOT_FOUND 0x03
+#define REALM_ERR_EXISTS 0x04
+#define REALM_ERR_FULL 0x05
+#define REALM_ERR_PASSWORD 0x06
+#define REALM_ERR_BAD_REQUEST 0x07
+#define REALM_ERR_BUSY 0x08 // Try again later
+// Never sent; reported by clients for requests that got no reply
+#define REALM_ERR_TIMEOUT 0xF0
+#define REALM_ERR_DISCONNECTED 0xF1
+#define REALM_ERR_CANCELLED 0xF2
+
+// Chat event types
+#define REALM_CHAT_JOIN 0x01
+#define REALM_CHAT_LEAVE 0x02
+#define REALM_CHAT_TALK 0x03
+
+// Character flags
+#define REALM_CHAR_EXPANSION 0x0020
+#define REALM_CHAR_HARDCORE 0x0004
+#define REALM_CHAR_LADDER 0x0040
+
+typedef struct RealmFrame
+{
+    BYTE command;
+    BYTE status;
+    DWORD sequence;
+    const BYTE *pPayload;
+    DWORD payloadSize;
+} RealmFrame;
+
+typedef struct RealmCharEntry
+{
+    const char *szName;
+    BYTE charClass;
+    BYTE level;
+    WORD flags; // REALM_CHAR_*
+} RealmCharEntry;
+
+typedef struct RealmGameEntry
+{
+    DWORD gameId;
+    BYTE players;
+    BYTE maxPlayers;
+    BYTE difficulty;
+    BYTE flags; // Bit 0: password protected
+    const char *szName;
+    const char *szDescription;
+} RealmGameEntry;
+
+typedef struct RealmJoinInfo
+{
+    DWORD gameToken;
+    DWORD address; // IPv4, network order
+    WORD port;
+    DWORD gameHash;
+} RealmJoinInfo;
+
+typedef struct RealmGameInfo
+{
+    DWORD gameId;
+    DWORD uptimeSeconds;
+    BYTE difficulty;
+    BYTE playerCount;
+    RealmCharEntry players[REALM_MAX_GAME_PLAYERS];
+} RealmGameInfo;
+
+typedef struct RealmChatEvent
+{
+    BYTE type; // REALM_CHAT_*
+    const char *szUser;
+    const char *szText; // Empty for joins and leaves
+} RealmChatEvent;
+
+// Parses the frame at the front of pData. Returns its size, 0 when more
+// bytes are needed, -1 when the stream is malformed.
+int __cdecl REALM_ParseFrame(const BYTE *pData, DWORD size, RealmFrame *pFrame);
+
+// =============================================================================
+// WRITING
+// =============================================================================
+
+// Appends a frame to a buffer field by field; REALM_EndFrame patches the
+// size. A frame that overflows REALM_MAX_FRAME or the buffer is rolled
+// back.
+typedef struct RealmWriter
+{
+    NetBuffer *pBuffer;
+    DWORD start; // Frame offset from the buffer's read offset
+    BOOL overflow;
+} RealmWriter;
+
+void __cdecl REALM_BeginFrame(RealmWriter *pWriter, NetBuffer *pBuffer, BYTE command, BYTE status, DWORD sequence);
+BOOL __cdecl REALM_EndFrame(RealmWriter *pWriter);
+
+void __cdecl REALM_PutByte(RealmWriter *pWriter, BYTE value);
+void __cdecl REALM_PutWord(RealmWriter *pWriter, WORD value);
+void __cdecl REALM_PutDword(RealmWriter *pWriter, DWORD value);
+void __cdecl REALM_PutString(RealmWriter *pWriter, const char *szValue);
+void __cdecl REALM_PutBytes(RealmWriter *pWriter, const void *pData, DWORD size);
+void __cdecl REALM_PutCharEntry(RealmWriter *pWriter, const RealmCharEntry *pEntry);
+void __cdecl REALM_PutGameEntry(RealmWriter *pWriter, const RealmGameEntry *pEntry);
+void __cdecl REALM_PutJoinInfo(RealmWriter *pWriter, const RealmJoinInfo *pInfo);
+void __cdecl REALM_PutGameInfo(RealmWriter *pWriter, const RealmGameInfo *pInfo);
+void __cdecl REALM_PutChatEvent(RealmWriter *pWriter, const RealmChatEvent *pEvent);
+
+// =============================================================================
+// READING
+// =============================================================================
+
+// Reads past the end or unterminated strings set error; reads then return
+// zeros and empty strings
+typedef struct RealmReader
+{
+    const BYTE *pData;
+    DWORD size;
+    DWORD pos;
+    BOOL error;
+} RealmReader;
+
+void __cdecl REALM_InitReader(RealmReader *pReader, const BYTE *pPayload, DWORD size);
+BYTE __cdecl REALM_GetByte(RealmReader *pReader);
+WORD __cdecl REALM_GetWord(RealmReader *pReader);
+DWORD __cdecl REALM_GetDword(RealmReader *pReader);
+const char *__cdecl REALM_GetString(RealmReader *pReader);
+BOOL __cdecl REALM_GetCharEntry(RealmReader *pReader, RealmCharEntry *pEntry);
+BOOL __cdecl REALM_GetGameEntry(RealmReader *pReader, RealmGameEntry *pEntry);
+BOOL __cdecl REALM_GetJoinInfo(RealmReader *pReader, RealmJoinInfo *pInfo);
+BOOL __cdecl REALM_GetGameInfo(RealmReader *pReader, RealmGameInfo *pInfo);
+BOOL __cdecl REALM_GetChatEvent(RealmReader *pReader, RealmChatEvent *pEvent);
+
+#endif // REALMPROTOCOL_HPP
@@ -0,0 +1,305 @@
+/*
+ * Socket.cpp - D2Net non-blocking TCP sockets
+ */
+
+#include "Socket.hpp"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#define LAST_ERROR_WOULD_BLOCK() (WSAGetLastError() == WSAEWOULDBLOCK)
+#define LAST_ERROR_IN_PROGRESS() (WSAGetLastError() == WSAEWOULDBLOCK)
+#define SEND_FLAGS 0
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define LAST_ERROR_WOULD_BLOCK() (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+#define LAST_ERROR_IN_PROGRESS() (errno == EINPROGRESS || errno == EINTR)
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+#endif
+
+#ifdef _WIN32
+static LONG s_startups = 0;
+#endif
+
+BOOL __cdecl NET_Startup(void)
+{
+#ifdef _WIN32
+    if (InterlockedIncrement(&s_startups) == 1)
+    {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+        {
+            InterlockedDecrement(&s_startups);
+            return FALSE;
+        }
+    }
+#endif
+    return TRUE;
+}
+
+void __cdecl NET_Cleanup(void)
+{
+#ifdef _WIN32
+    if (InterlockedDecrement(&s_startups) == 0)
+    {
+        WSACleanup();
+    }
+#endif
+}
+
+// Non-blocking, no Nagle, and no SIGPIPE where the platform has a socket option for it
+static BOOL PrepareSocket(NetSocket s, BOOL stream)
+{
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    if (ioctlsocket((SOCKET)s, FIONBIO, &nonBlocking) != 0)
+    {
+        return FALSE;
+    }
+#else
+    int flags = fcntl((int)s, F_GETFL, 0);
+    if (flags < 0 || fcntl((int)s, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        return FALSE;
+    }
+#ifdef SO_NOSIGPIPE
+    int noSigpipe = 1;
+    setsockopt((int)s, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+#endif
+#endif
+    if (stream)
+    {
+        int noDelay = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof(noDelay));
+    }
+    return TRUE;
+}
+
+static BOOL Resolve(const char *szHost, WORD port, BOOL passive, struct sockaddr_in *pAddr)
+{
+    memset(pAddr, 0, sizeof(*pAddr));
+    pAddr->sin_family = AF_INET;
+    pAddr->sin_port = htons(port);
+    if (!szHost)
+    {
+        pAddr->sin_addr.s_addr = htonl(passive ? INADDR_ANY : INADDR_LOOPBACK);
+        return TRUE;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *pResult = NULL;
+    if (getaddrinfo(szHost, NULL, &hints, &pResult) != 0 || !pResult)
+    {
+        return FALSE;
+    }
+    pAddr->sin_addr = ((struct sockaddr_in *)pResult->ai_addr)->sin_addr;
+    freeaddrinfo(pResult);
+    return TRUE;
+}
+
+NetSocket __cdecl NET_Listen(const char *szAddress, WORD port, int backlog, WORD *pPort)
+{
+    struct sockaddr_in addr;
+    if (!Resolve(szAddress, port, TRUE, &addr))
+    {
+        return NET_INVALID_SOCKET;
+    }
+    NetSocket s = (NetSocket)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == NET_INVALID_SOCKET)
+    {
+        return NET_INVALID_SOCKET;
+    }
+
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+    if (!PrepareSocket(s, FALSE) || bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(s, backlog > 0 ? backlog : SOMAXCONN) != 0)
+    {
+        NET_Close(s);
+        return NET_INVALID_SOCKET;
+    }
+    if (pPort)
+    {
+        socklen_t length = sizeof(addr);
+        getsockname(s, (struct sockaddr *)&addr, &length);
+        *pPort = ntohs(addr.sin_port);
+    }
+    return s;
+}
+
+NetSocket __cdecl NET_Accept(NetSocket listener, DWORD *pAddress)
+{
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    NetSocket s = (NetSocket)accept(listener, (struct sockaddr *)&addr, &length);
+    if (s == NET_INVALID_SOCKET)
+    {
+        return NET_INVALID_SOCKET;
+    }
+    if (!PrepareSocket(s, TRUE))
+    {
+        NET_Close(s);
+        return NET_INVALID_SOCKET;
+    }
+    if (pAddress)
+    {
+        *pAddress = addr.sin_addr.s_addr;
+    }
+    return s;
+}
+
+NetSocket __cdecl NET_Connect(const char *szHost, WORD port)
+{
+    return NET_ConnectFrom(szHost, port, 0);
+}
+
+NetSocket __cdecl NET_ConnectFrom(const char *szHost, WORD port, DWORD sourceAddress)
+{
+    struct sockaddr_in addr;
+    if (!Resolve(szHost, port, FALSE, &addr))
+    {
+        return NET_INVALID_SOCKET;
+    }
+    NetSocket s = (NetSocket)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == NET_INVALID_SOCKET)
+    {
+        return NET_INVALID_SOCKET;
+    }
+    if (sourceAddress)
+    {
+        struct sockaddr_in source;
+        memset(&source, 0, sizeof(source));
+        source.sin_family = AF_INET;
+        source.sin_addr.s_addr = sourceAddress;
+        if (bind(s, (struct sockaddr *)&source, sizeof(source)) != 0)
+        {
+            NET_Close(s);
+            return NET_INVALID_SOCKET;
+        }
+    }
+    if (!PrepareSocket(s, TRUE) ||
+        (connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 && !LAST_ERROR_IN_PROGRESS()))
+    {
+        NET_Close(s);
+        return NET_INVALID_SOCKET;
+    }
+    return s;
+}
+
+int __cdecl NET_FinishConnect(NetSocket s)
+{
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(s, SOL_SOCKET, SO_ERROR, (char *)&error, &length) != 0 || error != 0)
+    {
+        return -1;
+    }
+    struct sockaddr_in peer;
+    length = sizeof(peer);
+    return getpeername(s, (struct sockaddr *)&peer, &length) == 0 ? 1 : 0;
+}
+
+int __cdecl NET_Send(NetSocket s, const void *pData, DWORD size)
+{
+    int sent = (int)send(s, (const char *)pData, (int)size, SEND_FLAGS);
+    if (sent >= 0)
+    {
+        return sent;
+    }
+    return LAST_ERROR_WOULD_BLOCK() ? 0 : -1;
+}
+
+int __cdecl NET_SendSlices(NetSocket s, const NetSlice *pSlices, DWORD count)
+{
+    if (count > NET_MAX_SLICES)
+    {
+        count = NET_MAX_SLICES;
+    }
+#ifdef _WIN32
+    WSABUF buffers[NET_MAX_SLICES];
+    for (DWORD i = 0; i < count; i++)
+    {
+        buffers[i].buf = (CHAR *)pSlices[i].pData;
+        buffers[i].len = pSlices[i].size;
+    }
+    DWORD sent = 0;
+    if (WSASend((SOCKET)s, buffers, count, &sent, 0, NULL, NULL) == 0)
+    {
+        return (int)sent;
+    }
+#else
+    struct iovec vectors[NET_MAX_SLICES];
+    for (DWORD i = 0; i < count; i++)
+    {
+        vectors[i].iov_base = (void *)pSlices[i].pData;
+        vectors[i].iov_len = pSlices[i].size;
+    }
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = vectors;
+    message.msg_iovlen = count;
+    ssize_t sent = sendmsg((int)s, &message, SEND_FLAGS);
+    if (sent >= 0)
+    {
+        return (int)sent;
+    }
+#endif
+    return LAST_ERROR_WOULD_BLOCK() ? 0 : -1;
+}
+
+int __cdecl NET_Recv(NetSocket s, void *pData, DWORD size)
+{
+    int received = (int)recv(s, (char *)pData, (int)size, 0);
+    if (received > 0)
+    {
+        return received;
+    }
+    if (received == 0)
+    {
+        return -1; // Orderly close
+    }
+    return LAST_ERROR_WOULD_BLOCK() ? 0 : -1;
+}
+
+void __cdecl NET_Close(NetSocket s)
+{
+    if (s == NET_INVALID_SOCKET)
+    {
+        return;
+    }
+#ifdef _WIN32
+    closesocket((SOCKET)s);
+#else
+    close((int)s);
+#endif
+}
+
+void __cdecl NET_Reset(NetSocket s)
+{
+    if (s == NET_INVALID_SOCKET)
+    {
+        return;
+    }
+    struct linger reset;
+    reset.l_onoff = 1;
+    reset.l_linger = 0;
+    setsockopt(s, SOL_SOCKET, SO_LINGER, (const char *)&reset, sizeof(reset));
+    NET_Close(s);
+}
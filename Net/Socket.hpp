@@ -0,0 +1,60 @@
+/*
+ * Socket.hpp - D2Net non-blocking TCP sockets
+ *
+ * A thin layer over BSD sockets / Winsock so the event loop, the realm
+ * client and the server stand-ins share one set of calls. Every socket it
+ * returns is non-blocking with Nagle disabled: the realm protocol is small
+ * request/reply frames, and the senders batch on their own.
+ *
+ * Calls never block except NET_Connect's name lookup; pass a numeric
+ * address to avoid it.
+ */
+
+#ifndef SOCKET_HPP
+#define SOCKET_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+// SOCKET on Windows, a file descriptor elsewhere
+typedef intptr_t NetSocket;
+#define NET_INVALID_SOCKET ((NetSocket)-1)
+
+#define NET_MAX_SLICES 64
+
+// One piece of a gathered send
+typedef struct NetSlice
+{
+    const void *pData;
+    DWORD size;
+} NetSlice;
+
+// Winsock start-up; reference counted, a no-op elsewhere
+BOOL __cdecl NET_Startup(void);
+void __cdecl NET_Cleanup(void);
+
+// szAddress NULL = all interfaces; port 0 picks a free one, returned in pPort
+NetSocket __cdecl NET_Listen(const char *szAddress, WORD port, int backlog, WORD *pPort);
+// NET_INVALID_SOCKET when no connection is waiting. pAddress: IPv4, network order.
+NetSocket __cdecl NET_Accept(NetSocket listener, DWORD *pAddress);
+
+// Starts a connect; wait for the socket to become writable, then call
+// NET_FinishConnect
+NetSocket __cdecl NET_Connect(const char *szHost, WORD port);
+// NET_Connect from a given local address (IPv4, network order; 0 = any),
+// such as one of 127.0.0.0/8 to stand in for many clients on one machine
+NetSocket __cdecl NET_ConnectFrom(const char *szHost, WORD port, DWORD sourceAddress);
+// 1 connected, 0 still in progress, -1 failed
+int __cdecl NET_FinishConnect(NetSocket s);
+
+// Bytes moved; 0 = would block; -1 = the connection is closed or broken
+int __cdecl NET_Send(NetSocket s, const void *pData, DWORD size);
+// Sends up to NET_MAX_SLICES pieces, in order, with one call
+int __cdecl NET_SendSlices(NetSocket s, const NetSlice *pSlices, DWORD count);
+int __cdecl NET_Recv(NetSocket s, void *pData, DWORD size);
+
+void __cdecl NET_Close(NetSocket s);
+// Closes with a reset instead of a FIN, so the socket leaves no TIME_WAIT
+// behind; for connections turned away as soon as they are accepted
+void __cdecl NET_Reset(NetSocket s);
+
+#endif // SOCKET_HPP
@@ -0,0 +1,327 @@
+/*
+ * ChatFanout.cpp - D2Realm chat broadcast: shared messages, gathered sends,
+ * channel history and flood control
+ */
+
+#include "ChatFanout.hpp"
+
+#include <atomic>
+#include <new>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_SEGMENTS 16
+
+struct ChatMessage
+{
+    std::atomic<DWORD> refs;
+    DWORD size;
+    DWORD sequence;
+    BYTE data[1];
+};
+
+ChatMessage *__cdecl CHAT_CreateMessage(const BYTE *pFrame, DWORD size, DWORD sequence, DWORD refs)
+{
+    void *pBlock = malloc(offsetof(ChatMessage, data) + size);
+    if (!pBlock)
+    {
+        return NULL;
+    }
+    ChatMessage *pMessage = new (pBlock) ChatMessage;
+    pMessage->refs.store(refs, std::memory_order_relaxed);
+    pMessage->size = size;
+    pMessage->sequence = sequence;
+    memcpy(pMessage->data, pFrame, size);
+    return pMessage;
+}
+
+void __cdecl CHAT_AddRefs(ChatMessage *pMessage, DWORD refs)
+{
+    pMessage->refs.fetch_add(refs, std::memory_order_relaxed);
+}
+
+void __cdecl CHAT_Release(ChatMessage *pMessage)
+{
+    if (pMessage->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        pMessage->~ChatMessage();
+        free(pMessage);
+    }
+}
+
+const BYTE *__cdecl CHAT_MessageData(const ChatMessage *pMessage)
+{
+    return pMessage->data;
+}
+
+DWORD __cdecl CHAT_MessageSize(const ChatMessage *pMessage)
+{
+    return pMessage->size;
+}
+
+DWORD __cdecl CHAT_MessageSequence(const ChatMessage *pMessage)
+{
+    return pMessage->sequence;
+}
+
+// =============================================================================
+// OUTPUT QUEUE
+// =============================================================================
+
+static ChatSegment *SegmentAt(ChatQueue *pQueue, DWORD i)
+{
+    return &pQueue->pSegments[(pQueue->head + i) & (pQueue->capacity - 1)];
+}
+
+static BOOL PushSegment(ChatQueue *pQueue, ChatMessage *pMessage, DWORD size)
+{
+    if (pQueue->count == pQueue->capacity)
+    {
+        DWORD capacity = pQueue->capacity ? pQueue->capacity * 2 : INITIAL_SEGMENTS;
+        ChatSegment *pSegments = (ChatSegment *)malloc(capacity * sizeof(ChatSegment));
+        if (!pSegments)
+        {
+            return FALSE;
+        }
+        for (DWORD i = 0; i < pQueue->count; i++)
+        {
+            pSegments[i] = *SegmentAt(pQueue, i);
+        }
+        free(pQueue->pSegments);
+        pQueue->pSegments = pSegments;
+        pQueue->capacity = capacity;
+        pQueue->head = 0;
+    }
+    ChatSegment *pSegment = SegmentAt(pQueue, pQueue->count++);
+    pSegment->pMessage = pMessage;
+    pSegment->offset = 0;
+    pSegment->size = size;
+    return TRUE;
+}
+
+// Covers bytes written to the buffer since the last call with a segment,
+// so they go out ahead of anything queued after them
+static BOOL SyncBytes(ChatQueue *pQueue)
+{
+    DWORD pending = NETBUF_Size(&pQueue->bytes) - pQueue->accounted;
+    if (!pending)
+    {
+        return TRUE;
+    }
+    ChatSegment *pLast = pQueue->count ? SegmentAt(pQueue, pQueue->count - 1) : NULL;
+    if (pLast && !pLast->pMessage)
+    {
+        pLast->size += pending;
+    }
+    else if (!PushSegment(pQueue, NULL, pending))
+    {
+        return FALSE;
+    }
+    pQueue->accounted += pending;
+    return TRUE;
+}
+
+void __cdecl CHAT_InitQueue(ChatQueue *pQueue, DWORD maxBytes)
+{
+    NETBUF_Init(&pQueue->bytes, 0, maxBytes);
+    pQueue->pSegments = NULL;
+    pQueue->capacity = 0;
+    pQueue->head = 0;
+    pQueue->count = 0;
+    pQueue->accounted = 0;
+    pQueue->queuedBytes = 0;
+    pQueue->maxBytes = maxBytes;
+}
+
+void __cdecl CHAT_FreeQueue(ChatQueue *pQueue)
+{
+    for (DWORD i = 0; i < pQueue->count; i++)
+    {
+        ChatSegment *pSegment = SegmentAt(pQueue, i);
+        if (pSegment->pMessage)
+        {
+            CHAT_Release(pSegment->pMessage);
+        }
+    }
+    free(pQueue->pSegments);
+    NETBUF_Free(&pQueue->bytes);
+    pQueue->pSegments = NULL;
+    pQueue->capacity = 0;
+    pQueue->head = 0;
+    pQueue->count = 0;
+    pQueue->accounted = 0;
+    pQueue->queuedBytes = 0;
+}
+
+BOOL __cdecl CHAT_QueueMessage(ChatQueue *pQueue, ChatMessage *pMessage)
+{
+    if (CHAT_QueuedBytes(pQueue) + pMessage->size > pQueue->maxBytes || !SyncBytes(pQueue) ||
+        !PushSegment(pQueue, pMessage, pMessage->size))
+    {
+        CHAT_Release(pMessage);
+        return FALSE;
+    }
+    pQueue->queuedBytes += pMessage->size;
+    return TRUE;
+}
+
+DWORD __cdecl CHAT_QueuedBytes(const ChatQueue *pQueue)
+{
+    return pQueue->queuedBytes + NETBUF_Size(&pQueue->bytes);
+}
+
+// Drops sent bytes from the front of the queue
+static void Consume(ChatQueue *pQueue, DWORD sent)
+{
+    while (sent)
+    {
+        ChatSegment *pSegment = SegmentAt(pQueue, 0);
+        DWORD remaining = pSegment->size - pSegment->offset;
+        DWORD take = sent < remaining ? sent : remaining;
+        sent -= take;
+        if (pSegment->pMessage)
+        {
+            pSegment->offset += take;
+            pQueue->queuedBytes -= take;
+        }
+        else
+        {
+            // Byte segments are consumed from the buffer as they go, so the
+            // front one always starts at the buffer's read offset
+            NETBUF_Consume(&pQueue->bytes, take);
+            pQueue->accounted -= take;
+            pSegment->size -= take;
+        }
+        if (pSegment->offset == pSegment->size)
+        {
+            if (pSegment->pMessage)
+            {
+                CHAT_Release(pSegment->pMessage);
+            }
+            pQueue->head = (pQueue->head + 1) & (pQueue->capacity - 1);
+            pQueue->count--;
+        }
+    }
+}
+
+int __cdecl CHAT_FlushQueue(ChatQueue *pQueue, NetSocket s, uint64_t *pBytesSent, uint64_t *pSendCalls)
+{
+    if (!SyncBytes(pQueue))
+    {
+        return -1;
+    }
+    while (pQueue->count)
+    {
+        NetSlice slices[NET_MAX_SLICES];
+        DWORD sliceCount = 0;
+        DWORD byteOffset = 0;
+        for (DWORD i = 0; i < pQueue->count && sliceCount < NET_MAX_SLICES; i++)
+        {
+            ChatSegment *pSegment = SegmentAt(pQueue, i);
+            if (pSegment->pMessage)
+            {
+                slices[sliceCount].pData = pSegment->pMessage->data + pSegment->offset;
+                slices[sliceCount].size = pSegment->size - pSegment->offset;
+            }
+            else
+            {
+                slices[sliceCount].pData = NETBUF_Data(&pQueue->bytes) + byteOffset;
+                slices[sliceCount].size = pSegment->size;
+                byteOffset += pSegment->size;
+            }
+            sliceCount++;
+        }
+
+        int sent = sliceCount == 1 ? NET_Send(s, slices[0].pData, slices[0].size)
+                                   : NET_SendSlices(s, slices, sliceCount);
+        (*pSendCalls)++;
+        if (sent <= 0)
+        {
+            return sent;
+        }
+        *pBytesSent += (DWORD)sent;
+        Consume(pQueue, (DWORD)sent);
+    }
+    return 1;
+}
+
+// =============================================================================
+// HISTORY
+// =============================================================================
+
+void __cdecl CHAT_InitHistory(ChatHistory *pHistory, DWORD capacity)
+{
+    pHistory->ppMessages = capacity ? (ChatMessage **)calloc(capacity, sizeof(ChatMessage *)) : NULL;
+    pHistory->capacity = pHistory->ppMessages ? capacity : 0;
+    pHistory->count = 0;
+    pHistory->next = 0;
+}
+
+void __cdecl CHAT_FreeHistory(ChatHistory *pHistory)
+{
+    for (DWORD i = 0; i < pHistory->count; i++)
+    {
+        CHAT_Release(pHistory->ppMessages[(pHistory->next + pHistory->capacity - 1 - i) % pHistory->capacity]);
+    }
+    free(pHistory->ppMessages);
+    pHistory->ppMessages = NULL;
+    pHistory->capacity = 0;
+    pHistory->count = 0;
+    pHistory->next = 0;
+}
+
+void __cdecl CHAT_Remember(ChatHistory *pHistory, ChatMessage *pMessage)
+{
+    if (!pHistory->capacity)
+    {
+        return;
+    }
+    if (pHistory->count == pHistory->capacity)
+    {
+        CHAT_Release(pHistory->ppMessages[pHistory->next]);
+    }
+    else
+    {
+        pHistory->count++;
+    }
+    CHAT_AddRefs(pMessage, 1);
+    pHistory->ppMessages[pHistory->next] = pMessage;
+    pHistory->next = (pHistory->next + 1) % pHistory->capacity;
+}
+
+DWORD __cdecl CHAT_Recall(const ChatHistory *pHistory, ChatMessage **ppMessages, DWORD maxMessages)
+{
+    DWORD count = pHistory->count < maxMessages ? pHistory->count : maxMessages;
+    DWORD first = (pHistory->next + pHistory->capacity - count) % (pHistory->capacity ? pHistory->capacity : 1);
+    for (DWORD i = 0; i < count; i++)
+    {
+        ppMessages[i] = pHistory->ppMessages[(first + i) % pHistory->capacity];
+        CHAT_AddRefs(ppMessages[i], 1);
+    }
+    return count;
+}
+
+// =============================================================================
+// FLOOD CONTROL
+// =============================================================================
+
+void __cdecl CHAT_InitBucket(ChatBucket *pBucket, DWORD burst, uint64_t nowMs)
+{
+    pBucket->milliTokens = burst * 1000;
+    pBucket->lastMs = nowMs;
+}
+
+BOOL __cdecl CHAT_TakeToken(ChatBucket *pBucket, DWORD ratePerSecond, DWORD burst, uint64_t nowMs)
+{
+    uint64_t refill = (nowMs > pBucket->lastMs ? nowMs - pBucket->lastMs : 0) * ratePerSecond;
+    uint64_t tokens = pBucket->milliTokens + refill;
+    pBucket->milliTokens = (DWORD)(tokens < (uint64_t)burst * 1000 ? tokens : (uint64_t)burst * 1000);
+    pBucket->lastMs = nowMs;
+    if (pBucket->milliTokens < 1000)
+    {
+        return FALSE;
+    }
+    pBucket->milliTokens -= 1000;
+    return TRUE;
+}
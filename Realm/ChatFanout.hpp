@@ -0,0 +1,113 @@
+/*
+ * ChatFanout.hpp - D2Realm chat broadcast: shared messages, gathered sends,
+ * channel history and flood control
+ *
+ * D2Multi's chat hands every line to every channel member separately:
+ * the payload is copied into each member's buffer and sent on its own.
+ * A busy trade channel therefore costs members x lines copies and send
+ * calls, and one realm core ends up doing nothing else.
+ *
+ * The pieces here let the realm do the work once per line:
+ *   - ChatMessage: an encoded CHATEVENT frame in one refcounted block.
+ *     Every recipient's queue points at the same bytes; the last release
+ *     frees it.
+ *   - ChatQueue: a connection's output, in order: its own replies (copied
+ *     into a NetBuffer, as before) and references to shared messages.
+ *     CHAT_FlushQueue hands up to NET_MAX_SLICES pieces to one gathered
+ *     send, so everything queued for a member during a loop run goes out
+ *     in one call without being copied together first.
+ *   - ChatHistory: the last lines said in a channel, in a fixed ring of
+ *     message references, replayed to whoever joins next.
+ *   - ChatBucket: a token bucket per speaker. A line costs one token;
+ *     tokens refill at ratePerSecond up to burst.
+ *
+ * Threading: messages may be referenced and released from any thread.
+ * Queues, histories and buckets belong to one thread at a time.
+ */
+
+#ifndef CHATFANOUT_HPP
+#define CHATFANOUT_HPP
+
+#include "../Net/NetBuffer.hpp"
+#include "../Net/Socket.hpp"
+
+typedef struct ChatMessage ChatMessage;
+
+// Copies the frame; the message starts with refs references
+ChatMessage *__cdecl CHAT_CreateMessage(const BYTE *pFrame, DWORD size, DWORD sequence, DWORD refs);
+void __cdecl CHAT_AddRefs(ChatMessage *pMessage, DWORD refs);
+void __cdecl CHAT_Release(ChatMessage *pMessage);
+const BYTE *__cdecl CHAT_MessageData(const ChatMessage *pMessage);
+DWORD __cdecl CHAT_MessageSize(const ChatMessage *pMessage);
+// Position among the events of its channel
+DWORD __cdecl CHAT_MessageSequence(const ChatMessage *pMessage);
+
+// =============================================================================
+// OUTPUT QUEUE
+// =============================================================================
+
+typedef struct ChatSegment
+{
+    ChatMessage *pMessage; // NULL = the next bytes of the queue's buffer
+    DWORD offset;          // Bytes of the message already sent
+    DWORD size;
+} ChatSegment;
+
+typedef struct ChatQueue
+{
+    NetBuffer bytes; // Replies are written here directly (REALM_BeginFrame)
+    ChatSegment *pSegments;
+    DWORD capacity; // Segments; a power of two
+    DWORD head;
+    DWORD count;
+    DWORD accounted;   // Bytes of the buffer already covered by segments
+    DWORD queuedBytes; // Message bytes not yet sent
+    DWORD maxBytes;
+} ChatQueue;
+
+void __cdecl CHAT_InitQueue(ChatQueue *pQueue, DWORD maxBytes);
+// Releases every queued message
+void __cdecl CHAT_FreeQueue(ChatQueue *pQueue);
+// Takes over one reference to pMessage, also on failure. FALSE when the
+// queue would pass maxBytes: the member is not keeping up.
+BOOL __cdecl CHAT_QueueMessage(ChatQueue *pQueue, ChatMessage *pMessage);
+DWORD __cdecl CHAT_QueuedBytes(const ChatQueue *pQueue);
+// Sends until the queue is empty (1), the socket would block (0) or the
+// connection is gone (-1). Adds to the caller's counters.
+int __cdecl CHAT_FlushQueue(ChatQueue *pQueue, NetSocket s, uint64_t *pBytesSent, uint64_t *pSendCalls);
+
+// =============================================================================
+// HISTORY
+// =============================================================================
+
+typedef struct ChatHistory
+{
+    ChatMessage **ppMessages;
+    DWORD capacity;
+    DWORD count;
+    DWORD next; // Slot the next line goes into
+} ChatHistory;
+
+void __cdecl CHAT_InitHistory(ChatHistory *pHistory, DWORD capacity);
+void __cdecl CHAT_FreeHistory(ChatHistory *pHistory);
+// Adds a reference; the oldest line drops out once the ring is full
+void __cdecl CHAT_Remember(ChatHistory *pHistory, ChatMessage *pMessage);
+// Oldest first. Adds a reference to each message returned; returns how
+// many were written to ppMessages.
+DWORD __cdecl CHAT_Recall(const ChatHistory *pHistory, ChatMessage **ppMessages, DWORD maxMessages);
+
+// =============================================================================
+// FLOOD CONTROL
+// =============================================================================
+
+typedef struct ChatBucket
+{
+    DWORD milliTokens;
+    uint64_t lastMs;
+} ChatBucket;
+
+void __cdecl CHAT_InitBucket(ChatBucket *pBucket, DWORD burst, uint64_t nowMs);
+// Spends a token; FALSE when none are left
+BOOL __cdecl CHAT_TakeToken(ChatBucket *pBucket, DWORD ratePerSecond, DWORD burst, uint64_t nowMs);
+
+#endif // CHATFANOUT_HPP
@@ -0,0 +1,1699 @@
+/*
+ * RealmServer.cpp - D2Realm local realm, chat and game-list server
+ *
+ * Lock order: a handler holds at most one shard lock at a time, and may
+ * post to a worker's loop while holding it (the loop's task lock is never
+ * held while a shard is taken). Posting under the channel lock keeps every
+ * member's view of a channel in one order.
+ */
+
+#include "RealmServer.hpp"
+
+#include "ChatFanout.hpp"
+#include "../Net/Admission.hpp"
+#include "../Net/RealmProtocol.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define DEFAULT_SHARDS 64
+#define MAX_SHARDS 4096
+#define DEFAULT_MAX_CONNECTIONS 16384
+#define DEFAULT_MAX_CHANNEL_MEMBERS 16384
+#define DEFAULT_GAME_LIST_LIMIT 500
+#define MAX_GAME_LIST_LIMIT 1000 // Keeps a full list inside one frame
+#define DEFAULT_MAX_OUTPUT (4 * 1024 * 1024)
+#define DEFAULT_CHAT_RATE 2
+#define DEFAULT_CHAT_BURST 5
+#define DEFAULT_HISTORY_LINES 32
+#define MAX_HISTORY_LINES 256
+#define DEFAULT_MAX_ANNOUNCED 500
+#define MAX_INPUT_BYTES (2 * REALM_MAX_FRAME)
+#define RECEIVE_CHUNK 4096
+#define MAX_CHARS_PER_ACCOUNT 8
+#define CHAR_CLASSES 7
+#define RUN_TIMEOUT_MS 100
+#define GAME_SERVER_PORT 4000
+#define LOOPBACK_ADDRESS 0x0100007F // 127.0.0.1, network order
+
+// worker << 48 | generation << 32 | slot
+typedef uint64_t ConnKey;
+
+typedef struct RealmChar
+{
+    char szName[REALM_MAX_NAME];
+    BYTE charClass;
+    BYTE level;
+    WORD flags;
+} RealmChar;
+
+struct Worker;
+struct RealmServer;
+
+typedef struct Conn
+{
+    Worker *pWorker;
+    DWORD slot;
+    DWORD generation;
+    BOOL open;
+    BOOL flushQueued;
+    NetSocket s;
+    DWORD address; // Peer IPv4, network order
+    DWORD loopId;
+    DWORD interest;
+    NetBuffer in;
+    ChatQueue out; // Replies go into out.bytes
+    ChatBucket chatBucket;
+    char szAccount[REALM_MAX_NAME]; // Empty until logged on
+    RealmChar character;            // szName empty until a character is selected
+    char szChannel[REALM_MAX_CHANNEL_NAME];
+    DWORD channelId;
+    DWORD gameId; // 0 = none
+} Conn;
+
+// A connection in a channel, as its worker sees it. Events numbered below
+// joinSequence were said before it joined; history covers those.
+typedef struct LocalMember
+{
+    ConnKey key;
+    DWORD joinSequence;
+} LocalMember;
+
+// Written by the owning worker only; read by REALMSRV_GetStats
+typedef struct WorkerCounters
+{
+    std::atomic<uint64_t> accepted;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> closed;
+    std::atomic<uint64_t> slowDrops;
+    std::atomic<uint64_t> requests;
+    std::atomic<uint64_t> badRequests;
+    std::atomic<uint64_t> logons;
+    std::atomic<uint64_t> charsCreated;
+    std::atomic<uint64_t> gamesCreated;
+    std::atomic<uint64_t> gamesJoined;
+    std::atomic<uint64_t> gameLists;
+    std::atomic<uint64_t> channelJoins;
+    std::atomic<uint64_t> chatLines;
+    std::atomic<uint64_t> chatDeliveries;
+    std::atomic<uint64_t> chatThrottled;
+    std::atomic<uint64_t> historyReplayed;
+    std::atomic<uint64_t> batchesPosted;
+    std::atomic<uint64_t> sendCalls;
+    std::atomic<uint64_t> bytesReceived;
+    std::atomic<uint64_t> bytesSent;
+} WorkerCounters;
+
+struct Worker
+{
+    RealmServer *pServer;
+    DWORD index;
+    EventLoop *pLoop;
+    std::vector<Conn> conns;
+    std::vector<DWORD> freeConns;
+    std::vector<DWORD> flushList;
+    NetBuffer scratch; // Chat events are encoded here before posting
+    // This worker's connections in each channel, by channel id
+    std::unordered_map<DWORD, std::vector<LocalMember>> channelMembers;
+    std::vector<ConnKey> targets; // Scratch for one delivery
+    WorkerCounters counters;
+    std::thread thread;
+};
+
+// =============================================================================
+// SHARDED STATE
+// =============================================================================
+
+typedef struct Account
+{
+    std::vector<RealmChar> chars;
+} Account;
+
+struct AccountShard
+{
+    std::mutex lock;
+    std::unordered_map<std::string, Account> accounts;   // By account name
+    std::unordered_map<std::string, std::string> owners; // Character name -> account
+};
+
+typedef struct Game
+{
+    DWORD id;
+    std::string name;
+    std::string password;
+    BYTE difficulty;
+    BYTE maxPlayers;
+    uint64_t createdMs;
+    std::vector<RealmChar> players;
+} Game;
+
+struct GameShard
+{
+    std::mutex lock;
+    std::unordered_map<std::string, Game> games;
+    std::unordered_map<DWORD, std::string> names; // By id
+    DWORD nextSerial;
+    // Every game's list entry, encoded; rebuilt on the first list after a change
+    NetBuffer list;
+    std::vector<DWORD> entryEnds;
+    BOOL listDirty;
+};
+
+typedef struct Channel
+{
+    DWORD id; // Never reused, so a delivery cannot reach a later channel of the same name
+    std::vector<DWORD> workerMembers; // Members on each worker
+    DWORD memberCount;
+    DWORD nextSequence;
+    ChatHistory history;
+} Channel;
+
+struct ChannelShard
+{
+    std::mutex lock;
+    std::unordered_map<std::string, Channel> channels;
+};
+
+// One chat event for one worker's members of a channel
+typedef struct ChatDelivery
+{
+    Worker *pWorker;
+    DWORD channelId;
+    ConnKey from;
+    ChatMessage *pMessage; // One reference
+} ChatDelivery;
+
+typedef struct AcceptTask
+{
+    Worker *pWorker;
+    NetSocket s;
+    DWORD address;
+} AcceptTask;
+
+struct RealmServer
+{
+    NetSocket listener;
+    WORD port;
+    DWORD listenId;
+    DWORD shardMask;
+    DWORD shardBits;
+    DWORD maxConnections;
+    DWORD maxChannelMembers;
+    DWORD gameListLimit;
+    DWORD maxOutputBytes;
+    DWORD chatRate;
+    DWORD chatBurst;
+    DWORD historyLines;
+    DWORD maxAnnounced;
+    BOOL copyChat;
+    Admission *pAdmission; // NULL = every connection is taken
+
+    std::vector<Worker *> workers;
+    DWORD nextWorker;
+
+    std::vector<AccountShard> accountShards;
+    std::vector<GameShard> gameShards;
+    std::vector<ChannelShard> channelShards;
+
+    std::atomic<DWORD> connections;
+    std::atomic<DWORD> games;
+    std::atomic<DWORD> channels;
+    std::atomic<DWORD> nextChannelId;
+    std::atomic<bool> stop;
+    std::atomic<bool> stopping; // Connections are being torn down; no more broadcasts
+};
+
+static DWORD HashName(const char *szName)
+{
+    DWORD hash = 2166136261u;
+    for (const BYTE *p = (const BYTE *)szName; *p; p++)
+    {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static ConnKey MakeKey(const Conn *pConn)
+{
+    return ((ConnKey)pConn->pWorker->index << 48) | ((ConnKey)(pConn->generation & 0xFFFF) << 32) | pConn->slot;
+}
+
+static Conn *LookupConn(Worker *pWorker, ConnKey key)
+{
+    DWORD slot = (DWORD)key;
+    if (slot >= pWorker->conns.size())
+    {
+        return NULL;
+    }
+    Conn *pConn = &pWorker->conns[slot];
+    return (pConn->open && (pConn->generation & 0xFFFF) == (DWORD)((key >> 32) & 0xFFFF)) ? pConn : NULL;
+}
+
+// A name is 1 to maxLength - 1 bytes, in printable ASCII
+static BOOL ValidName(const char *szName, size_t maxLength)
+{
+    size_t length = strlen(szName);
+    if (length == 0 || length >= maxLength)
+    {
+        return FALSE;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        if ((BYTE)szName[i] < 0x20 || (BYTE)szName[i] > 0x7E)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void CopyName(char *szDest, const char *szSource, size_t size)
+{
+    strncpy(szDest, szSource, size - 1);
+    szDest[size - 1] = '\0';
+}
+
+// =============================================================================
+// CONNECTION I/O
+// =============================================================================
+
+static void CloseConn(Conn *pConn);
+
+static void SetInterest(Conn *pConn, DWORD interest)
+{
+    if (pConn->interest != interest)
+    {
+        EVLOOP_SetInterest(pConn->pWorker->pLoop, pConn->loopId, interest);
+        pConn->interest = interest;
+    }
+}
+
+static void Flush(Conn *pConn)
+{
+    WorkerCounters *pCounters = &pConn->pWorker->counters;
+    uint64_t bytesSent = 0;
+    uint64_t sendCalls = 0;
+    int result = CHAT_FlushQueue(&pConn->out, pConn->s, &bytesSent, &sendCalls);
+    pCounters->bytesSent.fetch_add(bytesSent, std::memory_order_relaxed);
+    pCounters->sendCalls.fetch_add(sendCalls, std::memory_order_relaxed);
+    if (result < 0)
+    {
+        CloseConn(pConn);
+        return;
+    }
+    SetInterest(pConn, result == 0 ? NET_READ | NET_WRITE : NET_READ);
+}
+
+// Output goes out once per loop run, so everything written to a connection
+// during the run shares its sends
+static void QueueFlush(Conn *pConn)
+{
+    if (!pConn->flushQueued)
+    {
+        pConn->flushQueued = TRUE;
+        pConn->pWorker->flushList.push_back(pConn->slot);
+    }
+}
+
+static void FlushQueued(Worker *pWorker)
+{
+    // Flushing can close connections, which never queues more
+    for (size_t i = 0; i < pWorker->flushList.size(); i++)
+    {
+        Conn *pConn = &pWorker->conns[pWorker->flushList[i]];
+        pConn->flushQueued = FALSE;
+        if (pConn->open)
+        {
+            Flush(pConn);
+        }
+    }
+    pWorker->flushList.clear();
+}
+
+// Appends an encoded frame; a connection that stopped reading is dropped
+static BOOL AppendFrame(Conn *pConn, const BYTE *pFrame, DWORD size)
+{
+    if (!NETBUF_Append(&pConn->out.bytes, pFrame, size))
+    {
+        pConn->pWorker->counters.slowDrops.fetch_add(1, std::memory_order_relaxed);
+        CloseConn(pConn);
+        return FALSE;
+    }
+    QueueFlush(pConn);
+    return TRUE;
+}
+
+// Queues a reference to a shared message, taking over the caller's
+// reference; a connection that stopped reading is dropped
+static BOOL QueueChat(Conn *pConn, ChatMessage *pMessage)
+{
+    if (!CHAT_QueueMessage(&pConn->out, pMessage))
+    {
+        pConn->pWorker->counters.slowDrops.fetch_add(1, std::memory_order_relaxed);
+        CloseConn(pConn);
+        return FALSE;
+    }
+    QueueFlush(pConn);
+    return TRUE;
+}
+
+static BOOL EndReply(Conn *pConn, RealmWriter *pWriter)
+{
+    if (!REALM_EndFrame(pWriter))
+    {
+        pConn->pWorker->counters.slowDrops.fetch_add(1, std::memory_order_relaxed);
+        CloseConn(pConn);
+        return FALSE;
+    }
+    QueueFlush(pConn);
+    return TRUE;
+}
+
+static void SendStatus(Conn *pConn, const RealmFrame *pRequest, BYTE status)
+{
+    RealmWriter writer;
+    REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pRequest->command), status, pRequest->sequence);
+    EndReply(pConn, &writer);
+}
+
+// =============================================================================
+// CHANNELS
+// =============================================================================
+
+static void __cdecl DeliverChat(void *pContext)
+{
+    ChatDelivery *pDelivery = (ChatDelivery *)pContext;
+    Worker *pWorker = pDelivery->pWorker;
+    ChatMessage *pMessage = pDelivery->pMessage;
+    DWORD sequence = CHAT_MessageSequence(pMessage);
+
+    // Closing a slow member edits the member list, so pick the targets first
+    pWorker->targets.clear();
+    std::unordered_map<DWORD, std::vector<LocalMember>>::const_iterator it =
+        pWorker->channelMembers.find(pDelivery->channelId);
+    if (it != pWorker->channelMembers.end())
+    {
+        for (size_t i = 0; i < it->second.size(); i++)
+        {
+            const LocalMember &member = it->second[i];
+            if (member.key != pDelivery->from && sequence >= member.joinSequence)
+            {
+                pWorker->targets.push_back(member.key);
+            }
+        }
+    }
+
+    uint64_t delivered = 0;
+    for (size_t i = 0; i < pWorker->targets.size(); i++)
+    {
+        Conn *pConn = LookupConn(pWorker, pWorker->targets[i]);
+        if (!pConn)
+        {
+            continue;
+        }
+        if (pWorker->pServer->copyChat)
+        {
+            // D2Multi's way, kept for comparison: a copy and a send per member
+            if (AppendFrame(pConn, CHAT_MessageData(pMessage), CHAT_MessageSize(pMessage)))
+            {
+                Flush(pConn);
+                delivered++;
+            }
+            continue;
+        }
+        CHAT_AddRefs(pMessage, 1);
+        if (QueueChat(pConn, pMessage))
+        {
+            delivered++;
+        }
+    }
+    if (CHAT_MessageData(pMessage)[REALM_HEADER_BYTES] == REALM_CHAT_TALK)
+    {
+        pWorker->counters.chatDeliveries.fetch_add(delivered, std::memory_order_relaxed);
+    }
+    CHAT_Release(pMessage);
+    delete pDelivery;
+}
+
+// Encodes the event once into a shared message and posts a reference to
+// every worker with members other than pFrom. Called with the channel's
+// shard locked, which also numbers the channel's events in the order every
+// member sees them.
+static void Broadcast(Conn *pFrom, Channel *pChannel, const RealmChatEvent *pEvent)
+{
+    Worker *pWorker = pFrom->pWorker;
+    RealmServer *pServer = pWorker->pServer;
+    if (pServer->stopping.load())
+    {
+        return;
+    }
+
+    RealmWriter writer;
+    REALM_BeginFrame(&writer, &pWorker->scratch, REALM_CMD_CHATEVENT, REALM_OK, 0);
+    REALM_PutChatEvent(&writer, pEvent);
+    if (!REALM_EndFrame(&writer))
+    {
+        return;
+    }
+    DWORD frameSize = NETBUF_Size(&pWorker->scratch);
+    ChatMessage *pMessage =
+        CHAT_CreateMessage(NETBUF_Data(&pWorker->scratch), frameSize, pChannel->nextSequence++, 1);
+    NETBUF_Consume(&pWorker->scratch, frameSize);
+    if (!pMessage)
+    {
+        return;
+    }
+    if (pEvent->type == REALM_CHAT_TALK)
+    {
+        CHAT_Remember(&pChannel->history, pMessage);
+    }
+
+    ConnKey from = MakeKey(pFrom);
+    BOOL fromIsMember = pFrom->channelId == pChannel->id;
+    for (size_t w = 0; w < pChannel->workerMembers.size(); w++)
+    {
+        DWORD others = pChannel->workerMembers[w] - (w == pWorker->index && fromIsMember ? 1 : 0);
+        if (others == 0)
+        {
+            continue;
+        }
+        ChatDelivery *pDelivery = new ChatDelivery;
+        pDelivery->pWorker = pServer->workers[w];
+        pDelivery->channelId = pChannel->id;
+        pDelivery->from = from;
+        pDelivery->pMessage = pMessage;
+        CHAT_AddRefs(pMessage, 1);
+        pWorker->counters.batchesPosted.fetch_add(1, std::memory_order_relaxed);
+        EVLOOP_Post(pDelivery->pWorker->pLoop, DeliverChat, pDelivery);
+    }
+    CHAT_Release(pMessage);
+}
+
+static ChannelShard *ChannelShardOf(RealmServer *pServer, const char *szChannel)
+{
+    return &pServer->channelShards[HashName(szChannel) & pServer->shardMask];
+}
+
+static void LeaveChannel(Conn *pConn)
+{
+    if (!pConn->szChannel[0])
+    {
+        return;
+    }
+    Worker *pWorker = pConn->pWorker;
+    RealmServer *pServer = pWorker->pServer;
+    DWORD channelId = pConn->channelId;
+    pConn->channelId = 0;
+
+    ConnKey key = MakeKey(pConn);
+    std::unordered_map<DWORD, std::vector<LocalMember>>::iterator local = pWorker->channelMembers.find(channelId);
+    if (local != pWorker->channelMembers.end())
+    {
+        std::vector<LocalMember> &members = local->second;
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            if (members[i].key == key)
+            {
+                members[i] = members.back();
+                members.pop_back();
+                break;
+            }
+        }
+        if (members.empty())
+        {
+            pWorker->channelMembers.erase(local);
+        }
+    }
+
+    ChannelShard *pShard = ChannelShardOf(pServer, pConn->szChannel);
+    {
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        std::unordered_map<std::string, Channel>::iterator it = pShard->channels.find(pConn->szChannel);
+        if (it != pShard->channels.end() && it->second.id == channelId)
+        {
+            Channel *pChannel = &it->second;
+            pChannel->workerMembers[pWorker->index]--;
+            pChannel->memberCount--;
+            if (pChannel->memberCount == 0)
+            {
+                CHAT_FreeHistory(&pChannel->history);
+                pShard->channels.erase(it);
+                pServer->channels--;
+            }
+            else if (pChannel->memberCount < pServer->maxAnnounced)
+            {
+                RealmChatEvent event = {REALM_CHAT_LEAVE, pConn->character.szName, ""};
+                Broadcast(pConn, pChannel, &event);
+            }
+        }
+    }
+    pConn->szChannel[0] = '\0';
+}
+
+// On success ppHistory receives the channel's recent lines, oldest first,
+// each with a reference for the caller
+static BYTE JoinChannel(Conn *pConn, const char *szChannel, WORD *pMembers, ChatMessage **ppHistory,
+                        DWORD *pHistoryCount)
+{
+    Worker *pWorker = pConn->pWorker;
+    RealmServer *pServer = pWorker->pServer;
+    *pMembers = 0;
+    *pHistoryCount = 0;
+    if (strcmp(szChannel, pConn->szChannel) == 0)
+    {
+        return REALM_ERR_EXISTS;
+    }
+    LeaveChannel(pConn);
+
+    DWORD joinSequence;
+    ChannelShard *pShard = ChannelShardOf(pServer, szChannel);
+    {
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        Channel *pChannel = &pShard->channels[szChannel];
+        if (pChannel->workerMembers.empty())
+        {
+            pChannel->id = ++pServer->nextChannelId;
+            pChannel->workerMembers.resize(pServer->workers.size());
+            pChannel->memberCount = 0;
+            pChannel->nextSequence = 0;
+            CHAT_InitHistory(&pChannel->history, pServer->historyLines);
+            pServer->channels++;
+        }
+        if (pChannel->memberCount >= pServer->maxChannelMembers)
+        {
+            return REALM_ERR_FULL;
+        }
+        pChannel->workerMembers[pWorker->index]++;
+        pChannel->memberCount++;
+        pConn->channelId = pChannel->id;
+        CopyName(pConn->szChannel, szChannel, sizeof(pConn->szChannel));
+        *pMembers = (WORD)(pChannel->memberCount > 0xFFFF ? 0xFFFF : pChannel->memberCount);
+        *pHistoryCount = CHAT_Recall(&pChannel->history, ppHistory, MAX_HISTORY_LINES);
+
+        // Events from here on reach the joiner live; history covers the rest
+        joinSequence = pChannel->nextSequence;
+        if (pChannel->memberCount <= pServer->maxAnnounced)
+        {
+            RealmChatEvent event = {REALM_CHAT_JOIN, pConn->character.szName, ""};
+            Broadcast(pConn, pChannel, &event);
+        }
+    }
+
+    // Deliveries run on this thread, so none can slip in before this
+    LocalMember member = {MakeKey(pConn), joinSequence};
+    pWorker->channelMembers[pConn->channelId].push_back(member);
+    return REALM_OK;
+}
+
+// Queues recalled lines behind the join reply, taking over their references
+static void ReplayHistory(Conn *pConn, ChatMessage **ppHistory, DWORD count)
+{
+    uint64_t replayed = 0;
+    for (DWORD i = 0; i < count; i++)
+    {
+        if (!pConn->open)
+        {
+            CHAT_Release(ppHistory[i]);
+        }
+        else if (QueueChat(pConn, ppHistory[i]))
+        {
+            replayed++;
+        }
+    }
+    pConn->pWorker->counters.historyReplayed.fetch_add(replayed, std::memory_order_relaxed);
+}
+
+static BYTE Chat(Conn *pConn, const char *szText)
+{
+    if (!pConn->szChannel[0])
+    {
+        return REALM_ERR_NOT_FOUND;
+    }
+    RealmServer *pServer = pConn->pWorker->pServer;
+    if (!CHAT_TakeToken(&pConn->chatBucket, pServer->chatRate, pServer->chatBurst, EVLOOP_NowMs()))
+    {
+        return REALM_ERR_BUSY;
+    }
+    ChannelShard *pShard = ChannelShardOf(pServer, pConn->szChannel);
+    std::lock_guard<std::mutex> lock(pShard->lock);
+    std::unordered_map<std::string, Channel>::iterator it = pShard->channels.find(pConn->szChannel);
+    if (it == pShard->channels.end() || it->second.id != pConn->channelId)
+    {
+        return REALM_ERR_NOT_FOUND;
+    }
+    RealmChatEvent event = {REALM_CHAT_TALK, pConn->character.szName, szText};
+    Broadcast(pConn, &it->second, &event);
+    return REALM_OK;
+}
+
+// =============================================================================
+// GAMES
+// =============================================================================
+
+static GameShard *GameShardOf(RealmServer *pServer, const char *szGame)
+{
+    return &pServer->gameShards[HashName(szGame) & pServer->shardMask];
+}
+
+static void FillGameEntry(const Game *pGame, RealmGameEntry *pEntry)
+{
+    pEntry->gameId = pGame->id;
+    pEntry->players = (BYTE)pGame->players.size();
+    pEntry->maxPlayers = pGame->maxPlayers;
+    pEntry->difficulty = pGame->difficulty;
+    pEntry->flags = pGame->password.empty() ? 0 : 1;
+    pEntry->szName = pGame->name.c_str();
+    pEntry->szDescription = "";
+}
+
+static void RebuildList(GameShard *pShard)
+{
+    pShard->list.head = pShard->list.tail = 0;
+    pShard->entryEnds.clear();
+    RealmWriter writer = {&pShard->list, 0, FALSE};
+    for (std::unordered_map<std::string, Game>::const_iterator it = pShard->games.begin();
+         it != pShard->games.end(); ++it)
+    {
+        RealmGameEntry entry;
+        FillGameEntry(&it->second, &entry);
+        REALM_PutGameEntry(&writer, &entry);
+        pShard->entryEnds.push_back(NETBUF_Size(&pShard->list));
+    }
+    pShard->listDirty = FALSE;
+}
+
+// Removes the connection's character from the game it is in
+static void LeaveGame(Conn *pConn)
+{
+    if (!pConn->gameId)
+    {
+        return;
+    }
+    RealmServer *pServer = pConn->pWorker->pServer;
+    GameShard *pShard = &pServer->gameShards[pConn->gameId & pServer->shardMask];
+    std::lock_guard<std::mutex> lock(pShard->lock);
+    std::unordered_map<DWORD, std::string>::iterator name = pShard->names.find(pConn->gameId);
+    if (name != pShard->names.end())
+    {
+        Game *pGame = &pShard->games[name->second];
+        for (size_t i = 0; i < pGame->players.size(); i++)
+        {
+            if (strcmp(pGame->players[i].szName, pConn->character.szName) == 0)
+            {
+                pGame->players.erase(pGame->players.begin() + i);
+                break;
+            }
+        }
+        if (pGame->players.empty())
+        {
+            pShard->games.erase(name->second);
+            pShard->names.erase(name);
+            pServer->games--;
+        }
+        pShard->listDirty = TRUE;
+    }
+    pConn->gameId = 0;
+}
+
+static BYTE CreateGame(Conn *pConn, BYTE difficulty, BYTE maxPlayers, const char *szName, const char *szPassword,
+                       DWORD *pGameId)
+{
+    RealmServer *pServer = pConn->pWorker->pServer;
+    if (!ValidName(szName, REALM_MAX_GAME_NAME) || difficulty > 2)
+    {
+        return REALM_ERR_BAD_REQUEST;
+    }
+    if (maxPlayers == 0 || maxPlayers > REALM_MAX_GAME_PLAYERS)
+    {
+        maxPlayers = REALM_MAX_GAME_PLAYERS;
+    }
+
+    DWORD shardIndex = HashName(szName) & pServer->shardMask;
+    GameShard *pShard = &pServer->gameShards[shardIndex];
+    {
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        if (pShard->games.count(szName))
+        {
+            return REALM_ERR_EXISTS;
+        }
+        Game *pGame = &pShard->games[szName];
+        pGame->id = (pShard->nextSerial++ << pServer->shardBits) | shardIndex;
+        pGame->name = szName;
+        pGame->password = szPassword;
+        pGame->difficulty = difficulty;
+        pGame->maxPlayers = maxPlayers;
+        pGame->createdMs = EVLOOP_NowMs();
+        pGame->players.push_back(pConn->character);
+        pShard->names[pGame->id] = pGame->name;
+        pShard->listDirty = TRUE;
+        *pGameId = pGame->id;
+    }
+    pServer->games++;
+
+    // The creator moves over from any game it was in
+    LeaveGame(pConn);
+    pConn->gameId = *pGameId;
+    return REALM_OK;
+}
+
+static BYTE JoinGame(Conn *pConn, const char *szName, const char *szPassword, RealmJoinInfo *pInfo)
+{
+    RealmServer *pServer = pConn->pWorker->pServer;
+    DWORD previous = pConn->gameId;
+    DWORD gameId = 0;
+    {
+        GameShard *pShard = GameShardOf(pServer, szName);
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        std::unordered_map<std::string, Game>::iterator it = pShard->games.find(szName);
+        if (it == pShard->games.end())
+        {
+            return REALM_ERR_NOT_FOUND;
+        }
+        Game *pGame = &it->second;
+        if (pGame->password != szPassword)
+        {
+            return REALM_ERR_PASSWORD;
+        }
+        if (pGame->id != previous)
+        {
+            if (pGame->players.size() >= pGame->maxPlayers)
+            {
+                return REALM_ERR_FULL;
+            }
+            pGame->players.push_back(pConn->character);
+            pShard->listDirty = TRUE;
+        }
+        gameId = pGame->id;
+    }
+    if (previous != gameId)
+    {
+        LeaveGame(pConn);
+        pConn->gameId = gameId;
+    }
+
+    pInfo->gameToken = HashName(pConn->character.szName) ^ gameId;
+    pInfo->address = LOOPBACK_ADDRESS;
+    pInfo->port = GAME_SERVER_PORT;
+    pInfo->gameHash = HashName(szName);
+    return REALM_OK;
+}
+
+static void WriteGameList(Conn *pConn, const RealmFrame *pRequest, const char *szFilter)
+{
+    RealmServer *pServer = pConn->pWorker->pServer;
+    RealmWriter writer;
+    REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pRequest->command), REALM_OK, pRequest->sequence);
+    DWORD countOffset = writer.start + REALM_HEADER_BYTES;
+    REALM_PutWord(&writer, 0);
+
+    DWORD count = 0;
+    for (DWORD s = 0; s <= pServer->shardMask && count < pServer->gameListLimit && !writer.overflow; s++)
+    {
+        GameShard *pShard = &pServer->gameShards[s];
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        if (!szFilter[0])
+        {
+            if (pShard->listDirty)
+            {
+                RebuildList(pShard);
+            }
+            DWORD take = (DWORD)pShard->entryEnds.size();
+            if (take > pServer->gameListLimit - count)
+            {
+                take = pServer->gameListLimit - count;
+            }
+            if (take)
+            {
+                REALM_PutBytes(&writer, NETBUF_Data(&pShard->list), pShard->entryEnds[take - 1]);
+                count += take;
+            }
+            continue;
+        }
+        for (std::unordered_map<std::string, Game>::const_iterator it = pShard->games.begin();
+             it != pShard->games.end() && count < pServer->gameListLimit; ++it)
+        {
+            if (strstr(it->second.name.c_str(), szFilter))
+            {
+                RealmGameEntry entry;
+                FillGameEntry(&it->second, &entry);
+                REALM_PutGameEntry(&writer, &entry);
+                count++;
+            }
+        }
+    }
+    if (!writer.overflow)
+    {
+        // The read offset does not move while a frame is written
+        BYTE *pCount = pConn->out.bytes.pData + pConn->out.bytes.head + countOffset;
+        pCount[0] = (BYTE)count;
+        pCount[1] = (BYTE)(count >> 8);
+    }
+    EndReply(pConn, &writer);
+}
+
+static void WriteGameInfo(Conn *pConn, const RealmFrame *pRequest, DWORD gameId)
+{
+    RealmServer *pServer = pConn->pWorker->pServer;
+    GameShard *pShard = &pServer->gameShards[gameId & pServer->shardMask];
+    RealmWriter writer;
+    std::lock_guard<std::mutex> lock(pShard->lock);
+    std::unordered_map<DWORD, std::string>::iterator name = pShard->names.find(gameId);
+    if (name == pShard->names.end())
+    {
+        REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pRequest->command), REALM_ERR_NOT_FOUND,
+                         pRequest->sequence);
+        EndReply(pConn, &writer);
+        return;
+    }
+    const Game *pGame = &pShard->games[name->second];
+    RealmGameInfo info;
+    info.gameId = pGame->id;
+    info.uptimeSeconds = (DWORD)((EVLOOP_NowMs() - pGame->createdMs) / 1000);
+    info.difficulty = pGame->difficulty;
+    info.playerCount = (BYTE)pGame->players.size();
+    for (BYTE i = 0; i < info.playerCount; i++)
+    {
+        info.players[i].szName = pGame->players[i].szName;
+        info.players[i].charClass = pGame->players[i].charClass;
+        info.players[i].level = pGame->players[i].level;
+        info.players[i].flags = pGame->players[i].flags;
+    }
+    REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pRequest->command), REALM_OK, pRequest->sequence);
+    REALM_PutGameInfo(&writer, &info);
+    EndReply(pConn, &writer);
+}
+
+// =============================================================================
+// ACCOUNTS
+// =============================================================================
+
+static AccountShard *AccountShardOf(RealmServer *pServer, const char *szName)
+{
+    return &pServer->accountShards[HashName(szName) & pServer->shardMask];
+}
+
+static BYTE Logon(Conn *pConn, const char *szAccount)
+{
+    if (!ValidName(szAccount, REALM_MAX_NAME))
+    {
+        return REALM_ERR_BAD_REQUEST;
+    }
+    AccountShard *pShard = AccountShardOf(pConn->pWorker->pServer, szAccount);
+    {
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        pShard->accounts[szAccount]; // Created on first logon
+    }
+    LeaveChannel(pConn);
+    LeaveGame(pConn);
+    CopyName(pConn->szAccount, szAccount, sizeof(pConn->szAccount));
+    pConn->character.szName[0] = '\0';
+    return REALM_OK;
+}
+
+static BYTE CreateChar(Conn *pConn, BYTE charClass, WORD flags, const char *szName)
+{
+    RealmServer *pServer = pConn->pWorker->pServer;
+    if (!ValidName(szName, REALM_MAX_NAME) || charClass >= CHAR_CLASSES)
+    {
+        return REALM_ERR_BAD_REQUEST;
+    }
+    AccountShard *pNames = AccountShardOf(pServer, szName);
+    {
+        std::lock_guard<std::mutex> lock(pNames->lock);
+        if (pNames->owners.count(szName))
+        {
+            return REALM_ERR_EXISTS;
+        }
+        pNames->owners[szName] = pConn->szAccount;
+    }
+
+    RealmChar character;
+    memset(&character, 0, sizeof(character));
+    CopyName(character.szName, szName, sizeof(character.szName));
+    character.charClass = charClass;
+    character.level = 1;
+    character.flags = flags;
+    BOOL added = FALSE;
+    {
+        AccountShard *pAccounts = AccountShardOf(pServer, pConn->szAccount);
+        std::lock_guard<std::mutex> lock(pAccounts->lock);
+        Account *pAccount = &pAccounts->accounts[pConn->szAccount];
+        if (pAccount->chars.size() < MAX_CHARS_PER_ACCOUNT)
+        {
+            pAccount->chars.push_back(character);
+            added = TRUE;
+        }
+    }
+    if (!added)
+    {
+        std::lock_guard<std::mutex> lock(pNames->lock);
+        pNames->owners.erase(szName);
+        return REALM_ERR_FULL;
+    }
+    return REALM_OK;
+}
+
+static BYTE DeleteChar(Conn *pConn, const char *szName)
+{
+    RealmServer *pServer = pConn->pWorker->pServer;
+    BOOL found = FALSE;
+    {
+        AccountShard *pAccounts = AccountShardOf(pServer, pConn->szAccount);
+        std::lock_guard<std::mutex> lock(pAccounts->lock);
+        std::vector<RealmChar> &chars = pAccounts->accounts[pConn->szAccount].chars;
+        for (size_t i = 0; i < chars.size() && !found; i++)
+        {
+            if (strcmp(chars[i].szName, szName) == 0)
+            {
+                chars.erase(chars.begin() + i);
+                found = TRUE;
+            }
+        }
+    }
+    if (!found)
+    {
+        return REALM_ERR_NOT_FOUND;
+    }
+    AccountShard *pNames = AccountShardOf(pServer, szName);
+    {
+        std::lock_guard<std::mutex> lock(pNames->lock);
+        pNames->owners.erase(szName);
+    }
+    if (strcmp(pConn->character.szName, szName) == 0)
+    {
+        LeaveChannel(pConn);
+        LeaveGame(pConn);
+        pConn->character.szName[0] = '\0';
+    }
+    return REALM_OK;
+}
+
+static void WriteCharList(Conn *pConn, const RealmFrame *pRequest, WORD maxChars)
+{
+    AccountShard *pShard = AccountShardOf(pConn->pWorker->pServer, pConn->szAccount);
+    RealmWriter writer;
+    REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pRequest->command), REALM_OK, pRequest->sequence);
+    {
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        const std::vector<RealmChar> &chars = pShard->accounts[pConn->szAccount].chars;
+        WORD count = (WORD)(chars.size() < maxChars ? chars.size() : maxChars);
+        REALM_PutWord(&writer, count);
+        for (WORD i = 0; i < count; i++)
+        {
+            RealmCharEntry entry = {chars[i].szName, chars[i].charClass, chars[i].level, chars[i].flags};
+            REALM_PutCharEntry(&writer, &entry);
+        }
+    }
+    EndReply(pConn, &writer);
+}
+
+static BYTE CharLogon(Conn *pConn, const char *szName)
+{
+    AccountShard *pShard = AccountShardOf(pConn->pWorker->pServer, pConn->szAccount);
+    RealmChar character;
+    BOOL found = FALSE;
+    {
+        std::lock_guard<std::mutex> lock(pShard->lock);
+        const std::vector<RealmChar> &chars = pShard->accounts[pConn->szAccount].chars;
+        for (size_t i = 0; i < chars.size() && !found; i++)
+        {
+            if (strcmp(chars[i].szName, szName) == 0)
+            {
+                character = chars[i];
+                found = TRUE;
+            }
+        }
+    }
+    if (!found)
+    {
+        return REALM_ERR_NOT_FOUND;
+    }
+    if (strcmp(pConn->character.szName, szName) != 0)
+    {
+        LeaveChannel(pConn);
+        LeaveGame(pConn);
+    }
+    pConn->character = character;
+    return REALM_OK;
+}
+
+// =============================================================================
+// REQUESTS
+// =============================================================================
+
+// Commands that need an account, and those that also need a character
+static BOOL NeedsAccount(BYTE command)
+{
+    return command != REALM_CMD_LOGON;
+}
+
+static BOOL NeedsCharacter(BYTE command)
+{
+    return command == REALM_CMD_GAMELIST || command == REALM_CMD_JOINGAME || command == REALM_CMD_CREATEGAME ||
+           command == REALM_CMD_GAMEINFO || command == REALM_CMD_CHANNELJOIN ||
+           command == REALM_CMD_CHANNELLEAVE || command == REALM_CMD_CHAT;
+}
+
+static void HandleRequest(Conn *pConn, const RealmFrame *pFrame)
+{
+    WorkerCounters *pCounters = &pConn->pWorker->counters;
+    pCounters->requests.fetch_add(1, std::memory_order_relaxed);
+    if ((pFrame->command & 1) || pFrame->sequence == 0)
+    {
+        pCounters->badRequests.fetch_add(1, std::memory_order_relaxed);
+        SendStatus(pConn, pFrame, REALM_ERR_BAD_REQUEST);
+        return;
+    }
+    if ((NeedsAccount(pFrame->command) && !pConn->szAccount[0]) ||
+        (NeedsCharacter(pFrame->command) && !pConn->character.szName[0]))
+    {
+        SendStatus(pConn, pFrame, REALM_ERR_NOT_LOGGED_ON);
+        return;
+    }
+
+    RealmReader reader;
+    REALM_InitReader(&reader, pFrame->pPayload, pFrame->payloadSize);
+    RealmWriter writer;
+    BYTE status = REALM_ERR_BAD_REQUEST;
+
+    switch (pFrame->command)
+    {
+    case REALM_CMD_LOGON:
+    {
+        REALM_GetDword(&reader); // Cookie; not checked
+        const char *szAccount = REALM_GetString(&reader);
+        if (!reader.error)
+        {
+            status = Logon(pConn, szAccount);
+            pCounters->logons.fetch_add(status == REALM_OK, std::memory_order_relaxed);
+        }
+        break;
+    }
+
+    case REALM_CMD_CHARCREATE:
+    {
+        BYTE charClass = REALM_GetByte(&reader);
+        WORD flags = REALM_GetWord(&reader);
+        const char *szName = REALM_GetString(&reader);
+        if (!reader.error)
+        {
+            status = CreateChar(pConn, charClass, flags, szName);
+            pCounters->charsCreated.fetch_add(status == REALM_OK, std::memory_order_relaxed);
+        }
+        break;
+    }
+
+    case REALM_CMD_CHARDELETE:
+    {
+        const char *szName = REALM_GetString(&reader);
+        if (!reader.error)
+        {
+            status = DeleteChar(pConn, szName);
+        }
+        break;
+    }
+
+    case REALM_CMD_CHARLIST:
+    {
+        WORD maxChars = REALM_GetWord(&reader);
+        if (!reader.error)
+        {
+            WriteCharList(pConn, pFrame, maxChars);
+            return;
+        }
+        break;
+    }
+
+    case REALM_CMD_CHARLOGON:
+    {
+        const char *szName = REALM_GetString(&reader);
+        if (!reader.error)
+        {
+            status = CharLogon(pConn, szName);
+        }
+        break;
+    }
+
+    case REALM_CMD_GAMELIST:
+    {
+        const char *szFilter = REALM_GetString(&reader);
+        if (!reader.error)
+        {
+            pCounters->gameLists.fetch_add(1, std::memory_order_relaxed);
+            WriteGameList(pConn, pFrame, szFilter);
+            return;
+        }
+        break;
+    }
+
+    case REALM_CMD_GAMEINFO:
+    {
+        DWORD gameId = REALM_GetDword(&reader);
+        if (!reader.error)
+        {
+            WriteGameInfo(pConn, pFrame, gameId);
+            return;
+        }
+        break;
+    }
+
+    case REALM_CMD_CREATEGAME:
+    {
+        BYTE difficulty = REALM_GetByte(&reader);
+        BYTE maxPlayers = REALM_GetByte(&reader);
+        const char *szName = REALM_GetString(&reader);
+        const char *szPassword = REALM_GetString(&reader);
+        if (reader.error)
+        {
+            break;
+        }
+        DWORD gameId = 0;
+        status = CreateGame(pConn, difficulty, maxPlayers, szName, szPassword, &gameId);
+        REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pFrame->command), status, pFrame->sequence);
+        if (status == REALM_OK)
+        {
+            pCounters->gamesCreated.fetch_add(1, std::memory_order_relaxed);
+            REALM_PutDword(&writer, gameId);
+        }
+        EndReply(pConn, &writer);
+        return;
+    }
+
+    case REALM_CMD_JOINGAME:
+    {
+        const char *szName = REALM_GetString(&reader);
+        const char *szPassword = REALM_GetString(&reader);
+        if (reader.error)
+        {
+            break;
+        }
+        RealmJoinInfo info;
+        status = JoinGame(pConn, szName, szPassword, &info);
+        REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pFrame->command), status, pFrame->sequence);
+        if (status == REALM_OK)
+        {
+            pCounters->gamesJoined.fetch_add(1, std::memory_order_relaxed);
+            REALM_PutJoinInfo(&writer, &info);
+        }
+        EndReply(pConn, &writer);
+        return;
+    }
+
+    case REALM_CMD_CHANNELJOIN:
+    {
+        const char *szChannel = REALM_GetString(&reader);
+        if (reader.error || !ValidName(szChannel, REALM_MAX_CHANNEL_NAME))
+        {
+            break;
+        }
+        WORD members = 0;
+        ChatMessage *history[MAX_HISTORY_LINES];
+        DWORD historyCount = 0;
+        status = JoinChannel(pConn, szChannel, &members, history, &historyCount);
+        REALM_BeginFrame(&writer, &pConn->out.bytes, REALM_REPLY(pFrame->command), status, pFrame->sequence);
+        if (status == REALM_OK)
+        {
+            pCounters->channelJoins.fetch_add(1, std::memory_order_relaxed);
+            REALM_PutWord(&writer, members);
+        }
+        EndReply(pConn, &writer);
+        ReplayHistory(pConn, history, historyCount);
+        return;
+    }
+
+    case REALM_CMD_CHANNELLEAVE:
+        status = pConn->szChannel[0] ? REALM_OK : REALM_ERR_NOT_FOUND;
+        LeaveChannel(pConn);
+        break;
+
+    case REALM_CMD_CHAT:
+    {
+        const char *szText = REALM_GetString(&reader);
+        if (reader.error || strlen(szText) >= REALM_MAX_CHAT_TEXT)
+        {
+            break;
+        }
+        status = Chat(pConn, szText);
+        pCounters->chatLines.fetch_add(status == REALM_OK, std::memory_order_relaxed);
+        pCounters->chatThrottled.fetch_add(status == REALM_ERR_BUSY, std::memory_order_relaxed);
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    if (status == REALM_ERR_BAD_REQUEST)
+    {
+        pCounters->badRequests.fetch_add(1, std::memory_order_relaxed);
+    }
+    SendStatus(pConn, pFrame, status);
+}
+
+static void __cdecl OnConnEvent(void *pContext, DWORD events)
+{
+    Conn *pConn = (Conn *)pContext;
+    if (events & NET_WRITE)
+    {
+        Flush(pConn);
+    }
+    if (!pConn->open || !(events & (NET_READ | NET_HANGUP)))
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        DWORD space;
+        BYTE *pSpace = NETBUF_Reserve(&pConn->in, RECEIVE_CHUNK, &space);
+        int received = pSpace ? NET_Recv(pConn->s, pSpace, space) : -1;
+        if (received < 0)
+        {
+            CloseConn(pConn);
+            return;
+        }
+        if (received == 0)
+        {
+            break;
+        }
+        pConn->pWorker->counters.bytesReceived.fetch_add((uint64_t)received, std::memory_order_relaxed);
+        NETBUF_Commit(&pConn->in, (DWORD)received);
+        if ((DWORD)received < space)
+        {
+            break;
+        }
+    }
+
+    for (;;)
+    {
+        RealmFrame frame;
+        int size = REALM_ParseFrame(NETBUF_Data(&pConn->in), NETBUF_Size(&pConn->in), &frame);
+        if (size < 0)
+        {
+            // Not a realm client; Fog bans for PACKET_INVALID the same way
+            RealmServer *pServer = pConn->pWorker->pServer;
+            if (pServer->pAdmission)
+            {
+                ADMIT_Ban(pServer->pAdmission, pConn->address, 0, EVLOOP_NowMs());
+            }
+            CloseConn(pConn);
+            return;
+        }
+        if (size == 0)
+        {
+            break;
+        }
+        HandleRequest(pConn, &frame);
+        if (!pConn->open)
+        {
+            return;
+        }
+        NETBUF_Consume(&pConn->in, (DWORD)size);
+    }
+}
+
+// =============================================================================
+// CONNECTIONS
+// =============================================================================
+
+static void CloseConn(Conn *pConn)
+{
+    if (!pConn->open)
+    {
+        return;
+    }
+    Worker *pWorker = pConn->pWorker;
+    // Leave while the key still names this connection
+    LeaveChannel(pConn);
+    LeaveGame(pConn);
+    EVLOOP_Remove(pWorker->pLoop, pConn->loopId);
+    NET_Close(pConn->s);
+    NETBUF_Free(&pConn->in);
+    CHAT_FreeQueue(&pConn->out);
+    pConn->open = FALSE;
+    pConn->generation++;
+    pWorker->freeConns.push_back(pConn->slot);
+    pWorker->pServer->connections--;
+    pWorker->counters.closed.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void AddConn(Worker *pWorker, NetSocket s, DWORD address)
+{
+    RealmServer *pServer = pWorker->pServer;
+    if (pWorker->freeConns.empty())
+    {
+        NET_Close(s);
+        pServer->connections--;
+        pWorker->counters.rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    DWORD slot = pWorker->freeConns.back();
+    pWorker->freeConns.pop_back();
+
+    Conn *pConn = &pWorker->conns[slot];
+    pConn->open = TRUE;
+    pConn->flushQueued = FALSE;
+    pConn->s = s;
+    pConn->address = address;
+    pConn->interest = NET_READ;
+    NETBUF_Init(&pConn->in, 0, MAX_INPUT_BYTES);
+    CHAT_InitQueue(&pConn->out, pServer->maxOutputBytes);
+    CHAT_InitBucket(&pConn->chatBucket, pServer->chatBurst, EVLOOP_NowMs());
+    pConn->szAccount[0] = '\0';
+    memset(&pConn->character, 0, sizeof(pConn->character));
+    pConn->szChannel[0] = '\0';
+    pConn->channelId = 0;
+    pConn->gameId = 0;
+    pConn->loopId = EVLOOP_Add(pWorker->pLoop, s, NET_READ, OnConnEvent, pConn);
+    pWorker->counters.accepted.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void __cdecl OnAcceptTask(void *pContext)
+{
+    AcceptTask *pTask = (AcceptTask *)pContext;
+    if (pTask->pWorker->pServer->stopping.load())
+    {
+        NET_Close(pTask->s);
+        pTask->pWorker->pServer->connections--;
+    }
+    else
+    {
+        AddConn(pTask->pWorker, pTask->s, pTask->address);
+    }
+    delete pTask;
+}
+
+static void __cdecl OnListenerEvent(void *pContext, DWORD events)
+{
+    (void)events;
+    RealmServer *pServer = (RealmServer *)pContext;
+    for (;;)
+    {
+        DWORD address = 0;
+        NetSocket s = NET_Accept(pServer->listener, &address);
+        if (s == NET_INVALID_SOCKET)
+        {
+            return;
+        }
+        // Turned away before anything is set up for it, with a reset so
+        // not even a TIME_WAIT is left
+        if (pServer->pAdmission && ADMIT_Check(pServer->pAdmission, address, EVLOOP_NowMs()) != ADMIT_OK)
+        {
+            NET_Reset(s);
+            continue;
+        }
+        Worker *pWorker = pServer->workers[pServer->nextWorker];
+        pServer->nextWorker = (pServer->nextWorker + 1) % (DWORD)pServer->workers.size();
+        if (++pServer->connections > pServer->maxConnections)
+        {
+            NET_Close(s);
+            pServer->connections--;
+            pWorker->counters.rejected.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (pWorker == pServer->workers[0])
+        {
+            AddConn(pWorker, s, address);
+            continue;
+        }
+        AcceptTask *pTask = new AcceptTask;
+        pTask->pWorker = pWorker;
+        pTask->s = s;
+        pTask->address = address;
+        EVLOOP_Post(pWorker->pLoop, OnAcceptTask, pTask);
+    }
+}
+
+// CPU time a worker has used so far
+static uint64_t ThreadCpuUs(std::thread &thread)
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes((HANDLE)thread.native_handle(), &created, &exited, &kernel, &user))
+    {
+        return 0;
+    }
+    uint64_t ticks = (((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+                     (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime);
+    return ticks / 10;
+#else
+    clockid_t clock;
+    struct timespec now;
+    if (pthread_getcpuclockid(thread.native_handle(), &clock) != 0 || clock_gettime(clock, &now) != 0)
+    {
+        return 0;
+    }
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+#endif
+}
+
+static void WorkerThread(Worker *pWorker)
+{
+    while (!pWorker->pServer->stop.load())
+    {
+        EVLOOP_Run(pWorker->pLoop, RUN_TIMEOUT_MS);
+        FlushQueued(pWorker);
+    }
+}
+
+// =============================================================================
+// SERVER
+// =============================================================================
+
+RealmServer *__cdecl REALMSRV_Create(const RealmServerDesc *pDesc)
+{
+    if (!NET_Startup())
+    {
+        return NULL;
+    }
+    RealmServer *pServer = new RealmServer;
+    pServer->port = 0;
+    pServer->pAdmission = NULL;
+    if (pDesc->pAdmission)
+    {
+        pServer->pAdmission = ADMIT_Create(pDesc->pAdmission);
+        if (!pServer->pAdmission)
+        {
+            delete pServer;
+            NET_Cleanup();
+            return NULL;
+        }
+    }
+    pServer->listener = NET_Listen(pDesc->szAddress, pDesc->port, 1024, &pServer->port);
+    if (pServer->listener == NET_INVALID_SOCKET)
+    {
+        ADMIT_Destroy(pServer->pAdmission);
+        delete pServer;
+        NET_Cleanup();
+        return NULL;
+    }
+
+    DWORD threads = pDesc->threads;
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    DWORD shards = pDesc->shards ? pDesc->shards : DEFAULT_SHARDS;
+    if (shards > MAX_SHARDS)
+    {
+        shards = MAX_SHARDS;
+    }
+    pServer->shardBits = 0;
+    while ((1u << pServer->shardBits) < shards)
+    {
+        pServer->shardBits++;
+    }
+    pServer->shardMask = (1u << pServer->shardBits) - 1;
+    pServer->maxConnections = pDesc->maxConnections ? pDesc->maxConnections : DEFAULT_MAX_CONNECTIONS;
+    pServer->maxChannelMembers = pDesc->maxChannelMembers ? pDesc->maxChannelMembers : DEFAULT_MAX_CHANNEL_MEMBERS;
+    pServer->gameListLimit = pDesc->gameListLimit ? pDesc->gameListLimit : DEFAULT_GAME_LIST_LIMIT;
+    if (pServer->gameListLimit > MAX_GAME_LIST_LIMIT)
+    {
+        pServer->gameListLimit = MAX_GAME_LIST_LIMIT;
+    }
+    pServer->maxOutputBytes = pDesc->maxOutputBytes ? pDesc->maxOutputBytes : DEFAULT_MAX_OUTPUT;
+    pServer->chatRate = pDesc->chatRate ? pDesc->chatRate : DEFAULT_CHAT_RATE;
+    pServer->chatBurst = pDesc->chatBurst ? pDesc->chatBurst : DEFAULT_CHAT_BURST;
+    pServer->historyLines = pDesc->historyLines ? pDesc->historyLines : DEFAULT_HISTORY_LINES;
+    if (pServer->historyLines > MAX_HISTORY_LINES)
+    {
+        pServer->historyLines = MAX_HISTORY_LINES;
+    }
+    pServer->maxAnnounced = pDesc->maxAnnounced ? pDesc->maxAnnounced : DEFAULT_MAX_ANNOUNCED;
+    pServer->copyChat = pDesc->copyChat;
+    pServer->nextWorker = 0;
+    pServer->connections = 0;
+    pServer->games = 0;
+    pServer->channels = 0;
+    pServer->nextChannelId = 0;
+    pServer->stop = false;
+    pServer->stopping = false;
+
+    pServer->accountShards = std::vector<AccountShard>(pServer->shardMask + 1);
+    pServer->gameShards = std::vector<GameShard>(pServer->shardMask + 1);
+    pServer->channelShards = std::vector<ChannelShard>(pServer->shardMask + 1);
+    for (DWORD s = 0; s <= pServer->shardMask; s++)
+    {
+        GameShard *pShard = &pServer->gameShards[s];
+        pShard->nextSerial = 1;
+        NETBUF_Init(&pShard->list, 0, REALM_MAX_FRAME * 16);
+        pShard->listDirty = FALSE;
+    }
+
+    // Every worker can hold every connection, so an uneven spread never rejects early
+    DWORD perWorker = pServer->maxConnections;
+    if (perWorker > 0xFFFE)
+    {
+        perWorker = 0xFFFE;
+    }
+    for (DWORD w = 0; w < threads; w++)
+    {
+        Worker *pWorker = new Worker(); // Zeroes the counters
+        pWorker->pServer = pServer;
+        pWorker->index = w;
+        pWorker->pLoop = EVLOOP_Create(perWorker + 1);
+        pWorker->conns.resize(perWorker);
+        pWorker->freeConns.reserve(perWorker);
+        for (DWORD i = perWorker; i-- > 0;)
+        {
+            Conn *pConn = &pWorker->conns[i];
+            memset(pConn, 0, sizeof(*pConn));
+            pConn->pWorker = pWorker;
+            pConn->slot = i;
+            pWorker->freeConns.push_back(i);
+        }
+        NETBUF_Init(&pWorker->scratch, 0, REALM_MAX_FRAME);
+        pServer->workers.push_back(pWorker);
+    }
+    pServer->listenId =
+        EVLOOP_Add(pServer->workers[0]->pLoop, pServer->listener, NET_READ, OnListenerEvent, pServer);
+    for (DWORD w = 0; w < threads; w++)
+    {
+        pServer->workers[w]->thread = std::thread(WorkerThread, pServer->workers[w]);
+    }
+    return pServer;
+}
+
+void __cdecl REALMSRV_Destroy(RealmServer *pServer)
+{
+    if (!pServer)
+    {
+        return;
+    }
+    pServer->stop = true;
+    for (size_t w = 0; w < pServer->workers.size(); w++)
+    {
+        pServer->workers[w]->thread.join();
+    }
+
+    // Every loop still exists while connections close, so their leaves can post
+    pServer->stopping = true;
+    EVLOOP_Remove(pServer->workers[0]->pLoop, pServer->listenId);
+    NET_Close(pServer->listener);
+    for (size_t w = 0; w < pServer->workers.size(); w++)
+    {
+        Worker *pWorker = pServer->workers[w];
+        for (size_t i = 0; i < pWorker->conns.size(); i++)
+        {
+            CloseConn(&pWorker->conns[i]);
+        }
+    }
+    for (size_t w = 0; w < pServer->workers.size(); w++)
+    {
+        EVLOOP_Destroy(pServer->workers[w]->pLoop); // Runs deliveries and hand-offs still queued
+    }
+    for (size_t w = 0; w < pServer->workers.size(); w++)
+    {
+        NETBUF_Free(&pServer->workers[w]->scratch);
+        delete pServer->workers[w];
+    }
+    for (DWORD s = 0; s <= pServer->shardMask; s++)
+    {
+        NETBUF_Free(&pServer->gameShards[s].list);
+        std::unordered_map<std::string, Channel> &channels = pServer->channelShards[s].channels;
+        for (std::unordered_map<std::string, Channel>::iterator it = channels.begin(); it != channels.end(); ++it)
+        {
+            CHAT_FreeHistory(&it->second.history);
+        }
+    }
+    ADMIT_Destroy(pServer->pAdmission);
+    delete pServer;
+    NET_Cleanup();
+}
+
+WORD __cdecl REALMSRV_GetPort(const RealmServer *pServer)
+{
+    return pServer->port;
+}
+
+void __cdecl REALMSRV_GetStats(RealmServer *pServer, RealmServerStats *pStats)
+{
+    memset(pStats, 0, sizeof(*pStats));
+    for (size_t w = 0; w < pServer->workers.size(); w++)
+    {
+        const WorkerCounters *pCounters = &pServer->workers[w]->counters;
+        pStats->accepted += pCounters->accepted.load(std::memory_order_relaxed);
+        pStats->rejected += pCounters->rejected.load(std::memory_order_relaxed);
+        pStats->closed += pCounters->closed.load(std::memory_order_relaxed);
+        pStats->slowDrops += pCounters->slowDrops.load(std::memory_order_relaxed);
+        pStats->requests += pCounters->requests.load(std::memory_order_relaxed);
+        pStats->badRequests += pCounters->badRequests.load(std::memory_order_relaxed);
+        pStats->logons += pCounters->logons.load(std::memory_order_relaxed);
+        pStats->charsCreated += pCounters->charsCreated.load(std::memory_order_relaxed);
+        pStats->gamesCreated += pCounters->gamesCreated.load(std::memory_order_relaxed);
+        pStats->gamesJoined += pCounters->gamesJoined.load(std::memory_order_relaxed);
+        pStats->gameLists += pCounters->gameLists.load(std::memory_order_relaxed);
+        pStats->channelJoins += pCounters->channelJoins.load(std::memory_order_relaxed);
+        pStats->chatLines += pCounters->chatLines.load(std::memory_order_relaxed);
+        pStats->chatDeliveries += pCounters->chatDeliveries.load(std::memory_order_relaxed);
+        pStats->chatThrottled += pCounters->chatThrottled.load(std::memory_order_relaxed);
+        pStats->historyReplayed += pCounters->historyReplayed.load(std::memory_order_relaxed);
+        pStats->batchesPosted += pCounters->batchesPosted.load(std::memory_order_relaxed);
+        pStats->sendCalls += pCounters->sendCalls.load(std::memory_order_relaxed);
+        pStats->bytesReceived += pCounters->bytesReceived.load(std::memory_order_relaxed);
+        pStats->bytesSent += pCounters->bytesSent.load(std::memory_order_relaxed);
+        pStats->cpuUs += ThreadCpuUs(pServer->workers[w]->thread);
+    }
+    pStats->connections = pServer->connections.load();
+    pStats->games = pServer->games.load();
+    pStats->channels = pServer->channels.load();
+}
+
+BOOL __cdecl REALMSRV_GetAdmissionStats(RealmServer *pServer, AdmissionStats *pStats)
+{
+    if (!pServer->pAdmission)
+    {
+        return FALSE;
+    }
+    ADMIT_GetStats(pServer->pAdmission, EVLOOP_NowMs(), pStats);
+    return TRUE;
+}
+
+BOOL __cdecl REALMSRV_Ban(RealmServer *pServer, DWORD address, DWORD seconds)
+{
+    return pServer->pAdmission && ADMIT_Ban(pServer->pAdmission, address, seconds, EVLOOP_NowMs());
+}
+
+void __cdecl REALMSRV_Unban(RealmServer *pServer, DWORD address)
+{
+    if (pServer->pAdmission)
+    {
+        ADMIT_Unban(pServer->pAdmission, address);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * RealmServer.hpp - D2Realm local realm, chat and game-list server
+ *
+ * -skiptobnet and g_gameMode 2 lead into D2Multi and BNClient, which need
+ * Battle.net's realm services; BATTLENET_SERVICE_ARCHITECTURE.md describes
+ * those services in prose only, so nothing on that path can run offline.
+ * This is a stand-in for the realm side that speaks the D2Net realm
+ * protocol (RealmProtocol.hpp): accounts and characters, the game list,
+ * game creation and joins, and chat channels, all held in memory.
+ *
+ * Connections are spread over worker threads, each running its own
+ * EventLoop. The first worker also owns the listener and hands accepted
+ * sockets to the workers in turn. A connection is only ever touched by its
+ * worker; everything shared lives in shards, each with its own lock:
+ *   - accounts and their characters, and character names, sharded by name;
+ *   - games, sharded by name. A game id carries its shard, so GAMEINFO
+ *     finds it without a search. Each shard keeps its list entries encoded,
+ *     so a list request copies bytes rather than re-encoding every game;
+ *   - chat channels, sharded by name, with their members grouped by
+ *     worker.
+ * A chat line is encoded once into a shared message (ChatFanout.hpp) and
+ * each worker with members in the channel is posted one reference
+ * (EVLOOP_Post); the worker queues it on its members' outputs, which go out
+ * in one gathered send per member per loop run. Talk is not echoed to the
+ * speaker. The last historyLines lines of a channel are replayed to each
+ * joiner after its join reply. Joins and leaves are announced while the
+ * channel has at most maxAnnounced members; past that they would swamp
+ * the talk. A speaker gets REALM_ERR_BUSY when its token bucket is empty.
+ *
+ * Logon cookies are not checked and accounts are created on first logon.
+ * A connection counts as a player of the game it last joined or created
+ * until it joins another or disconnects; an empty game is removed.
+ * A connection whose output backs up past maxOutputBytes (a reader that
+ * stopped reading) is dropped.
+ *
+ * With pAdmission set, every accepted connection first goes through an
+ * Admission (Admission.hpp): one that is refused is reset on the spot,
+ * before a worker or a connection slot is involved. A connection that
+ * sends something other than realm frames gets its address banned.
+ *
+ * Threading: REALMSRV_* may be called from any thread.
+ */
+
+#ifndef REALMSERVER_HPP
+#define REALMSERVER_HPP
+
+#include "../Net/Admission.hpp"
+#include "../Net/EventLoop.hpp"
+
+typedef struct RealmServerDesc
+{
+    const char *szAddress;   // NULL = all interfaces
+    WORD port;               // 0 = any free port (REALMSRV_GetPort)
+    DWORD threads;           // Event loop workers (0 = one per hardware thread)
+    DWORD shards;            // State shards of each kind (0 = 64), rounded up to a power of two
+    DWORD maxConnections;    // 0 = 16384
+    DWORD maxChannelMembers; // 0 = 16384
+    DWORD gameListLimit;     // Entries in one GAMELIST reply (0 = 500)
+    DWORD maxOutputBytes;    // Per connection (0 = 4 MB)
+    DWORD chatRate;          // Lines per second per speaker, sustained (0 = 2)
+    DWORD chatBurst;         // Lines a quiet speaker may say back to back (0 = 5)
+    DWORD historyLines;      // Replayed to joiners (0 = 32, at most 256)
+    DWORD maxAnnounced;      // Largest channel whose joins and leaves are announced (0 = 500)
+    BOOL copyChat;           // Copy and send each line per member, as D2Multi does (for comparison)
+    // Turns connections away at accept time (NULL = take every connection)
+    const AdmissionDesc *pAdmission;
+} RealmServerDesc;
+
+typedef struct RealmServerStats
+{
+    uint64_t accepted;
+    uint64_t rejected; // Over maxConnections
+    uint64_t closed;
+    uint64_t slowDrops; // Closed for backed-up output
+    uint64_t requests;
+    uint64_t badRequests;
+    uint64_t logons;
+    uint64_t charsCreated;
+    uint64_t gamesCreated;
+    uint64_t gamesJoined;
+    uint64_t gameLists;
+    uint64_t channelJoins;
+    uint64_t chatLines;
+    uint64_t chatDeliveries;  // Talk lines queued for a member
+    uint64_t chatThrottled;   // Lines refused with REALM_ERR_BUSY
+    uint64_t historyReplayed; // History lines queued for joiners
+    uint64_t batchesPosted;
+    uint64_t bytesReceived;
+    uint64_t bytesSent;
+    uint64_t sendCalls;
+    uint64_t cpuUs; // Worker threads, so far
+    DWORD connections;
+    DWORD games;
+    DWORD channels;
+} RealmServerStats;
+
+typedef struct RealmServer RealmServer;
+
+// Starts listening and the workers; NULL if the port cannot be bound
+RealmServer *__cdecl REALMSRV_Create(const RealmServerDesc *pDesc);
+// Closes every connection and stops the workers
+void __cdecl REALMSRV_Destroy(RealmServer *pServer);
+
+WORD __cdecl REALMSRV_GetPort(const RealmServer *pServer);
+void __cdecl REALMSRV_GetStats(RealmServer *pServer, RealmServerStats *pStats);
+// FALSE when the server has no admission control
+BOOL __cdecl REALMSRV_GetAdmissionStats(RealmServer *pServer, AdmissionStats *pStats);
+
+// Address: IPv4, network order. seconds 0 = the admission's banSeconds.
+// FALSE without admission control or room in its ban table.
+BOOL __cdecl REALMSRV_Ban(RealmServer *pServer, DWORD address, DWORD seconds);
+void __cdecl REALMSRV_Unban(RealmServer *pServer, DWORD address);
+
+#endif // REALMSERVER_HPP
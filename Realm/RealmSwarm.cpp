@@ -0,0 +1,567 @@
+/*
+ * RealmSwarm.cpp - D2Realm client swarm for load testing a realm
+ */
+
+#include "RealmSwarm.hpp"
+
+#include "../Net/McpClient.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_CREATE_EVERY 8
+#define DEFAULT_CHAT_INTERVAL_MS 100
+#define DEFAULT_LINGER_MS 500
+#define DEFAULT_TIMEOUT_MS 30000
+#define RUN_TIMEOUT_MS 1
+#define COORDINATOR_POLL_MS 1
+#define GAME_LIST_FETCH 200
+
+typedef enum SwarmPhase
+{
+    PHASE_WAITING, // Not connected yet
+    PHASE_LOGIN,
+    PHASE_READY, // In a channel and a game; waiting for the chat phase
+    PHASE_CHAT,
+    PHASE_CHATTED, // Every line acknowledged; lingering
+    PHASE_DONE,
+    PHASE_FAILED,
+} SwarmPhase;
+
+struct SwarmThread;
+
+typedef struct SwarmClient
+{
+    SwarmThread *pThread;
+    DWORD index;
+    McpClient *pMcp;
+    SwarmPhase phase;
+    uint64_t startUs; // Connect time
+    uint64_t connectAtUs;
+    BOOL inChannel;
+    BOOL inGame;
+    DWORD linesSent;
+    DWORD linesAcked;
+    uint64_t nextLineUs;
+    char szAccount[REALM_MAX_NAME];
+    char szChannel[REALM_MAX_CHANNEL_NAME];
+} SwarmClient;
+
+// Coordination between the threads and REALMSWARM_Run
+typedef struct SwarmShared
+{
+    const RealmSwarmDesc *pDesc;
+    const char *szPrefix;
+    DWORD createEvery;
+    DWORD chatIntervalMs;
+    DWORD timeoutMs;
+    std::atomic<DWORD> ready;
+    std::atomic<DWORD> failed;
+    std::atomic<DWORD> chatted;
+    std::atomic<bool> chatStarted;
+    std::atomic<bool> lingerOver;
+    std::atomic<uint64_t> lastEventUs; // Latest chat event received by any client
+} SwarmShared;
+
+struct SwarmThread
+{
+    SwarmShared *pShared;
+    EventLoop *pLoop;
+    std::vector<SwarmClient> clients;
+    uint64_t random;
+    std::vector<DWORD> loginUs;
+    std::vector<DWORD> chatUs;
+    RealmSwarmStats stats;
+    std::thread thread;
+};
+
+static uint64_t NowUs(void)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static DWORD NextRandom(SwarmThread *pThread)
+{
+    // xorshift64
+    pThread->random ^= pThread->random << 13;
+    pThread->random ^= pThread->random >> 7;
+    pThread->random ^= pThread->random << 17;
+    return (DWORD)(pThread->random >> 16);
+}
+
+static void Fail(SwarmClient *pClient)
+{
+    if (pClient->phase == PHASE_FAILED || pClient->phase == PHASE_DONE)
+    {
+        return;
+    }
+    if (pClient->phase == PHASE_READY || pClient->phase == PHASE_CHAT)
+    {
+        pClient->pThread->pShared->ready--; // Counted again as failed
+    }
+    pClient->phase = PHASE_FAILED;
+    pClient->pThread->pShared->failed++;
+    MCP_Disconnect(pClient->pMcp); // Pending replies come back as disconnected and are ignored
+}
+
+static void CheckReady(SwarmClient *pClient)
+{
+    if (pClient->phase == PHASE_LOGIN && pClient->inChannel && pClient->inGame)
+    {
+        pClient->phase = PHASE_READY;
+        uint64_t us = NowUs() - pClient->startUs;
+        pClient->pThread->loginUs.push_back(us > 0xFFFFFFFF ? 0xFFFFFFFF : (DWORD)us);
+        pClient->pThread->pShared->ready++;
+    }
+}
+
+// =============================================================================
+// REPLIES
+// =============================================================================
+
+static void __cdecl OnStep(void *pContext, const McpReply *pReply)
+{
+    SwarmClient *pClient = (SwarmClient *)pContext;
+    if (pClient->phase == PHASE_FAILED)
+    {
+        return;
+    }
+    BOOL ok = pReply->status == REALM_OK;
+    if (pReply->command == REALM_CMD_CHARCREATE)
+    {
+        ok = ok || pReply->status == REALM_ERR_EXISTS; // Left over from an earlier swarm
+    }
+    if (!ok)
+    {
+        Fail(pClient);
+        return;
+    }
+    if (pReply->command == REALM_CMD_CHANNELJOIN)
+    {
+        pClient->inChannel = TRUE;
+        CheckReady(pClient);
+    }
+}
+
+static void __cdecl OnJoined(void *pContext, const McpReply *pReply);
+
+static void CreateOwnGame(SwarmClient *pClient)
+{
+    char szGame[REALM_MAX_GAME_NAME];
+    snprintf(szGame, sizeof(szGame), "%sg%u", pClient->pThread->pShared->szPrefix, pClient->index);
+    if (MCP_CreateGame(pClient->pMcp, szGame, "", 0, REALM_MAX_GAME_PLAYERS, OnJoined, pClient) ==
+        MCP_INVALID_REQUEST)
+    {
+        Fail(pClient);
+    }
+}
+
+static void __cdecl OnJoined(void *pContext, const McpReply *pReply)
+{
+    SwarmClient *pClient = (SwarmClient *)pContext;
+    if (pClient->phase == PHASE_FAILED)
+    {
+        return;
+    }
+    if (pReply->command == REALM_CMD_JOINGAME &&
+        (pReply->status == REALM_ERR_FULL || pReply->status == REALM_ERR_NOT_FOUND))
+    {
+        pClient->pThread->stats.fullRetries++;
+        CreateOwnGame(pClient);
+        return;
+    }
+    if (pReply->status != REALM_OK)
+    {
+        Fail(pClient);
+        return;
+    }
+    if (pReply->command == REALM_CMD_CREATEGAME)
+    {
+        pClient->pThread->stats.gamesCreated++;
+    }
+    else
+    {
+        pClient->pThread->stats.gamesJoined++;
+    }
+    pClient->inGame = TRUE;
+    CheckReady(pClient);
+}
+
+static void __cdecl OnGameList(void *pContext, const McpReply *pReply)
+{
+    SwarmClient *pClient = (SwarmClient *)pContext;
+    SwarmThread *pThread = pClient->pThread;
+    if (pClient->phase == PHASE_FAILED)
+    {
+        return;
+    }
+    if (pReply->status != REALM_OK)
+    {
+        Fail(pClient);
+        return;
+    }
+    if (pClient->index % pThread->pShared->createEvery == 0)
+    {
+        CreateOwnGame(pClient);
+        return;
+    }
+
+    // Pick one of the games with room at random
+    RealmReader reader;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    WORD count = REALM_GetWord(&reader);
+    const char *open[GAME_LIST_FETCH];
+    DWORD openCount = 0;
+    for (WORD i = 0; i < count && openCount < GAME_LIST_FETCH; i++)
+    {
+        RealmGameEntry entry;
+        if (!REALM_GetGameEntry(&reader, &entry))
+        {
+            Fail(pClient);
+            return;
+        }
+        if (entry.players < entry.maxPlayers && !(entry.flags & 1))
+        {
+            open[openCount++] = entry.szName;
+        }
+    }
+    if (openCount == 0)
+    {
+        CreateOwnGame(pClient);
+        return;
+    }
+    if (MCP_JoinGame(pClient->pMcp, open[NextRandom(pThread) % openCount], "", OnJoined, pClient) ==
+        MCP_INVALID_REQUEST)
+    {
+        Fail(pClient);
+    }
+}
+
+static void __cdecl OnChatAck(void *pContext, const McpReply *pReply)
+{
+    SwarmClient *pClient = (SwarmClient *)pContext;
+    if (pClient->phase == PHASE_FAILED)
+    {
+        return;
+    }
+    if (pReply->status == REALM_ERR_BUSY)
+    {
+        // Flood control turned the line away; the client carries on
+        pClient->pThread->stats.chatThrottled++;
+    }
+    else if (pReply->status != REALM_OK)
+    {
+        Fail(pClient);
+        return;
+    }
+    pClient->linesAcked++;
+}
+
+static void __cdecl OnPush(void *pContext, const McpReply *pReply)
+{
+    SwarmClient *pClient = (SwarmClient *)pContext;
+    SwarmThread *pThread = pClient->pThread;
+    if (pReply->command != REALM_CMD_CHATEVENT)
+    {
+        return;
+    }
+    RealmReader reader;
+    RealmChatEvent event;
+    REALM_InitReader(&reader, pReply->pPayload, pReply->payloadSize);
+    if (!REALM_GetChatEvent(&reader, &event))
+    {
+        return;
+    }
+    pThread->pShared->lastEventUs.store(NowUs(), std::memory_order_relaxed);
+    switch (event.type)
+    {
+    case REALM_CHAT_TALK:
+    {
+        pThread->stats.chatReceived++;
+        uint64_t sentUs = strtoull(event.szText, NULL, 10);
+        uint64_t nowUs = NowUs();
+        if (sentUs && sentUs <= nowUs)
+        {
+            uint64_t us = nowUs - sentUs;
+            pThread->chatUs.push_back(us > 0xFFFFFFFF ? 0xFFFFFFFF : (DWORD)us);
+        }
+        break;
+    }
+    case REALM_CHAT_JOIN:
+        pThread->stats.joinEvents++;
+        break;
+    case REALM_CHAT_LEAVE:
+        pThread->stats.leaveEvents++;
+        break;
+    default:
+        break;
+    }
+}
+
+// =============================================================================
+// SCRIPT
+// =============================================================================
+
+static void Start(SwarmClient *pClient)
+{
+    SwarmShared *pShared = pClient->pThread->pShared;
+    pClient->startUs = NowUs();
+    pClient->phase = PHASE_LOGIN;
+    if (!MCP_Connect(pClient->pMcp))
+    {
+        Fail(pClient);
+        return;
+    }
+    // Queued while connecting and sent together once the connection is up
+    char szChar[REALM_MAX_NAME];
+    snprintf(szChar, sizeof(szChar), "%sc%u", pShared->szPrefix, pClient->index);
+    MCP_Logon(pClient->pMcp, 0, pClient->szAccount, OnStep, pClient);
+    MCP_CreateChar(pClient->pMcp, (BYTE)(pClient->index % 7), REALM_CHAR_EXPANSION, szChar, OnStep, pClient);
+    MCP_CharLogon(pClient->pMcp, szChar, OnStep, pClient);
+    MCP_JoinChannel(pClient->pMcp, pClient->szChannel, OnStep, pClient);
+    MCP_RequestGameList(pClient->pMcp, "", OnGameList, pClient);
+}
+
+static void SayLine(SwarmClient *pClient)
+{
+    char szText[64];
+    snprintf(szText, sizeof(szText), "%llu hello from %s", (unsigned long long)NowUs(), pClient->szAccount);
+    if (MCP_Chat(pClient->pMcp, szText, OnChatAck, pClient) == MCP_INVALID_REQUEST)
+    {
+        Fail(pClient);
+        return;
+    }
+    pClient->linesSent++;
+    pClient->pThread->stats.chatSent++;
+}
+
+// Advances one client; FALSE once it is finished
+static BOOL Step(SwarmClient *pClient, uint64_t nowUs)
+{
+    SwarmShared *pShared = pClient->pThread->pShared;
+    const RealmSwarmDesc *pDesc = pShared->pDesc;
+    switch (pClient->phase)
+    {
+    case PHASE_WAITING:
+        if (nowUs >= pClient->connectAtUs)
+        {
+            Start(pClient);
+        }
+        break;
+
+    case PHASE_READY:
+        if (pShared->chatStarted.load())
+        {
+            pClient->phase = PHASE_CHAT;
+            pClient->nextLineUs = nowUs + NextRandom(pClient->pThread) % (pShared->chatIntervalMs * 1000 + 1);
+        }
+        break;
+
+    case PHASE_CHAT:
+    {
+        DWORD lines = (pDesc->talkers == 0 || pClient->index < pDesc->talkers) ? pDesc->chatLines : 0;
+        while (pClient->phase == PHASE_CHAT && pClient->linesSent < lines && nowUs >= pClient->nextLineUs)
+        {
+            SayLine(pClient);
+            pClient->nextLineUs += (uint64_t)pShared->chatIntervalMs * 1000;
+        }
+        if (pClient->phase == PHASE_CHAT && pClient->linesAcked == lines)
+        {
+            pClient->phase = PHASE_CHATTED;
+            pShared->chatted++;
+        }
+        break;
+    }
+
+    case PHASE_CHATTED:
+        if (pShared->lingerOver.load())
+        {
+            MCP_Disconnect(pClient->pMcp);
+            pClient->phase = PHASE_DONE;
+        }
+        break;
+
+    default:
+        break;
+    }
+    if (pClient->phase == PHASE_LOGIN || pClient->phase == PHASE_READY || pClient->phase == PHASE_CHAT ||
+        pClient->phase == PHASE_CHATTED)
+    {
+        MCP_Pump(pClient->pMcp, 0); // Sends what callbacks queued and expires overdue requests
+    }
+    return pClient->phase != PHASE_DONE && pClient->phase != PHASE_FAILED;
+}
+
+static void ThreadMain(SwarmThread *pThread)
+{
+    BOOL running = TRUE;
+    while (running)
+    {
+        EVLOOP_Run(pThread->pLoop, RUN_TIMEOUT_MS);
+        uint64_t nowUs = NowUs();
+        running = FALSE;
+        for (size_t i = 0; i < pThread->clients.size(); i++)
+        {
+            running |= Step(&pThread->clients[i], nowUs);
+        }
+    }
+}
+
+// =============================================================================
+// SWARM
+// =============================================================================
+
+static void Percentiles(std::vector<DWORD> &samples, DWORD *pP50, DWORD *pP99, DWORD *pMax)
+{
+    if (samples.empty())
+    {
+        *pP50 = *pP99 = *pMax = 0;
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    *pP50 = samples[samples.size() / 2];
+    *pP99 = samples[(samples.size() * 99) / 100];
+    *pMax = samples.back();
+}
+
+static void WaitFor(const std::atomic<DWORD> &a, const std::atomic<DWORD> &b, DWORD target)
+{
+    while (a.load() + b.load() < target)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(COORDINATOR_POLL_MS));
+    }
+}
+
+BOOL __cdecl REALMSWARM_Run(const RealmSwarmDesc *pDesc, RealmSwarmStats *pStats)
+{
+    memset(pStats, 0, sizeof(*pStats));
+    if (!pDesc->clients || !NET_Startup())
+    {
+        return FALSE;
+    }
+    SwarmShared shared;
+    shared.pDesc = pDesc;
+    shared.szPrefix = pDesc->szPrefix ? pDesc->szPrefix : "sw";
+    shared.createEvery = pDesc->createEvery ? pDesc->createEvery : DEFAULT_CREATE_EVERY;
+    shared.chatIntervalMs = pDesc->chatIntervalMs ? pDesc->chatIntervalMs : DEFAULT_CHAT_INTERVAL_MS;
+    shared.timeoutMs = pDesc->timeoutMs ? pDesc->timeoutMs : DEFAULT_TIMEOUT_MS;
+    shared.ready = 0;
+    shared.failed = 0;
+    shared.chatted = 0;
+    shared.chatStarted = false;
+    shared.lingerOver = false;
+    shared.lastEventUs = 0;
+
+    DWORD threadCount = pDesc->threads ? pDesc->threads : 1;
+    if (threadCount > pDesc->clients)
+    {
+        threadCount = pDesc->clients;
+    }
+    DWORD channels = pDesc->channels ? pDesc->channels : 1;
+    uint64_t startUs = NowUs();
+
+    std::vector<SwarmThread *> threads;
+    for (DWORD t = 0; t < threadCount; t++)
+    {
+        SwarmThread *pThread = new SwarmThread;
+        pThread->pShared = &shared;
+        memset(&pThread->stats, 0, sizeof(pThread->stats));
+        pThread->random = 0x9E3779B97F4A7C15ull ^ ((uint64_t)(t + 1) << 32);
+        DWORD first = (DWORD)((uint64_t)pDesc->clients * t / threadCount);
+        DWORD last = (DWORD)((uint64_t)pDesc->clients * (t + 1) / threadCount);
+        pThread->pLoop = EVLOOP_Create(last - first + 16);
+        pThread->clients.resize(last - first);
+
+        McpClientDesc mcp;
+        memset(&mcp, 0, sizeof(mcp));
+        mcp.pLoop = pThread->pLoop;
+        mcp.szHost = pDesc->szHost;
+        mcp.port = pDesc->port;
+        mcp.timeoutMs = shared.timeoutMs;
+        for (DWORD i = first; i < last; i++)
+        {
+            SwarmClient *pClient = &pThread->clients[i - first];
+            memset(pClient, 0, sizeof(*pClient));
+            pClient->pThread = pThread;
+            pClient->index = i;
+            pClient->phase = PHASE_WAITING;
+            pClient->connectAtUs = startUs + (uint64_t)pDesc->connectSpreadMs * 1000 * i / pDesc->clients;
+            snprintf(pClient->szAccount, sizeof(pClient->szAccount), "%s%u", shared.szPrefix, i);
+            snprintf(pClient->szChannel, sizeof(pClient->szChannel), "%sch%u", shared.szPrefix, i % channels);
+            pClient->pMcp = MCP_Create(&mcp);
+            MCP_SetPushHandler(pClient->pMcp, OnPush, pClient);
+        }
+        threads.push_back(pThread);
+    }
+    for (DWORD t = 0; t < threadCount; t++)
+    {
+        threads[t]->thread = std::thread(ThreadMain, threads[t]);
+    }
+
+    WaitFor(shared.ready, shared.failed, pDesc->clients);
+    uint64_t chatStartUs = NowUs();
+    pStats->loginPhaseMs = (DWORD)((chatStartUs - startUs) / 1000);
+    shared.chatStarted = true;
+    WaitFor(shared.chatted, shared.failed, pDesc->clients);
+    pStats->chatPhaseMs = pDesc->chatLines ? (DWORD)((NowUs() - chatStartUs) / 1000) : 0;
+    // Under load deliveries trail the acknowledgements, so wait for them to stop
+    uint64_t lingerUs = (uint64_t)(pDesc->lingerMs ? pDesc->lingerMs : DEFAULT_LINGER_MS) * 1000;
+    uint64_t quietSinceUs = NowUs();
+    for (;;)
+    {
+        uint64_t lastEventUs = shared.lastEventUs.load(std::memory_order_relaxed);
+        if (lastEventUs > quietSinceUs)
+        {
+            quietSinceUs = lastEventUs;
+        }
+        uint64_t nowUs = NowUs();
+        if (nowUs - quietSinceUs >= lingerUs)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(lingerUs - (nowUs - quietSinceUs)));
+    }
+    shared.lingerOver = true;
+
+    std::vector<DWORD> loginUs;
+    std::vector<DWORD> chatUs;
+    for (DWORD t = 0; t < threadCount; t++)
+    {
+        SwarmThread *pThread = threads[t];
+        pThread->thread.join();
+        for (size_t i = 0; i < pThread->clients.size(); i++)
+        {
+            McpStats mcp;
+            MCP_GetStats(pThread->clients[i].pMcp, &mcp);
+            pStats->requests += mcp.requests;
+            MCP_Destroy(pThread->clients[i].pMcp);
+        }
+        EVLOOP_Destroy(pThread->pLoop);
+        pStats->gamesCreated += pThread->stats.gamesCreated;
+        pStats->gamesJoined += pThread->stats.gamesJoined;
+        pStats->fullRetries += pThread->stats.fullRetries;
+        pStats->chatSent += pThread->stats.chatSent;
+        pStats->chatThrottled += pThread->stats.chatThrottled;
+        pStats->chatReceived += pThread->stats.chatReceived;
+        pStats->joinEvents += pThread->stats.joinEvents;
+        pStats->leaveEvents += pThread->stats.leaveEvents;
+        loginUs.insert(loginUs.end(), pThread->loginUs.begin(), pThread->loginUs.end());
+        chatUs.insert(chatUs.end(), pThread->chatUs.begin(), pThread->chatUs.end());
+        delete pThread;
+    }
+    Percentiles(loginUs, &pStats->loginP50Us, &pStats->loginP99Us, &pStats->loginMaxUs);
+    Percentiles(chatUs, &pStats->chatP50Us, &pStats->chatP99Us, &pStats->chatMaxUs);
+    pStats->ready = shared.ready.load();
+    pStats->failed = shared.failed.load();
+    pStats->totalMs = (DWORD)((NowUs() - startUs) / 1000);
+    NET_Cleanup();
+    return pStats->failed == 0;
+}
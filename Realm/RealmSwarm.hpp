@@ -0,0 +1,81 @@
+/*
+ * RealmSwarm.hpp - D2Realm client swarm for load testing a realm
+ *
+ * Drives many McpClients against a realm server the way a crowd of game
+ * clients arriving at character select does, so join storms and chat
+ * fan-out can be reproduced and measured on one machine.
+ *
+ * Clients are spread over a few threads; each thread runs one EventLoop
+ * shared by its clients. Every client runs the same script:
+ *   1. connect at its start time (all at once, or spread over
+ *      connectSpreadMs) and send logon, character create, character logon,
+ *      channel join and game list back to back;
+ *   2. join a game from the list with room in it, or create one (every
+ *      createEvery-th client does, and so does any client whose pick filled
+ *      up first). A client in its channel and a game is ready; the time
+ *      from connecting to ready is its login latency;
+ *   3. once every client is ready (or has failed), the first talkers
+ *      clients say chatLines lines in their channel, chatIntervalMs apart.
+ *      Each line carries its send time, so receivers measure delivery
+ *      latency. A line refused by flood control (REALM_ERR_BUSY) is
+ *      counted and not retried;
+ *   4. once every client has had its lines acknowledged, stay connected
+ *      until no chat event has arrived for lingerMs, so deliveries still in
+ *      flight arrive, then disconnect.
+ *
+ * Clients are named <prefix><index>, so one server can take several swarms
+ * with different prefixes. Any reply other than the expected ones fails
+ * that client; the others carry on.
+ */
+
+#ifndef REALMSWARM_HPP
+#define REALMSWARM_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef struct RealmSwarmDesc
+{
+    const char *szHost;
+    WORD port;
+    const char *szPrefix;  // Account, character and game names (NULL = "sw")
+    DWORD clients;
+    DWORD threads;         // 0 = 1
+    DWORD channels;        // Clients are dealt round-robin into this many (0 = 1)
+    DWORD createEvery;     // 0 = 8
+    DWORD connectSpreadMs; // 0 = every client connects at once
+    DWORD chatLines;       // Per talker (0 = no chat phase)
+    DWORD talkers;         // Clients that talk (0 = all)
+    DWORD chatIntervalMs;  // 0 = 100
+    DWORD lingerMs;        // Quiet time before disconnecting (0 = 500)
+    DWORD timeoutMs;       // Per request (0 = 30000)
+} RealmSwarmDesc;
+
+typedef struct RealmSwarmStats
+{
+    DWORD ready;
+    DWORD failed;
+    uint64_t requests;
+    uint64_t gamesCreated;
+    uint64_t gamesJoined;
+    uint64_t fullRetries; // Picked games that filled up first
+    uint64_t chatSent;
+    uint64_t chatThrottled; // Sent lines refused with REALM_ERR_BUSY
+    uint64_t chatReceived;  // Talk lines from others
+    uint64_t joinEvents;
+    uint64_t leaveEvents;
+    DWORD loginP50Us;
+    DWORD loginP99Us;
+    DWORD loginMaxUs;
+    DWORD chatP50Us;
+    DWORD chatP99Us;
+    DWORD chatMaxUs;
+    DWORD loginPhaseMs; // Start until every client is ready or failed
+    DWORD chatPhaseMs;  // Chat start until every line is acknowledged
+    DWORD totalMs;
+} RealmSwarmStats;
+
+// Runs the whole script and returns when every client has disconnected.
+// TRUE if every client got through it.
+BOOL __cdecl REALMSWARM_Run(const RealmSwarmDesc *pDesc, RealmSwarmStats *pStats);
+
+#endif // REALMSWARM_HPP
@@ -0,0 +1,336 @@
+/*
+ * GameData.cpp - D2Server process-wide read-only game data
+ *
+ * See GameData.hpp. Publication is an atomic pointer; the grace period is
+ * a count of acquires in flight between loading that pointer and taking a
+ * reference on what it pointed to. Acquires are rare (game start and
+ * refresh points), so one shared counter is enough.
+ */
+
+#include "GameData.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef struct LoadedItem
+{
+    const void *pData;
+    size_t size;
+    DataTable *pTable; // GAMEDATA_TABLE only
+} LoadedItem;
+
+struct GameDataView
+{
+    GameData *pOwner;
+    DWORD version;
+    std::atomic<DWORD> refs;
+    std::vector<LoadedItem> items;
+    PresetStore *pPresets;
+    size_t bytes;
+};
+
+struct GameData
+{
+    std::vector<std::string> names;
+    std::vector<DWORD> kinds;
+    GameDataSource source;
+    PresetSource presets;
+    DWORD maxPresets;
+    DWORD tableFlags;
+
+    std::atomic<GameDataView *> current;
+    std::atomic<DWORD> readers; // Acquires between loading current and taking a reference
+    std::mutex reloadMutex;
+    DWORD nextVersion;
+
+    std::atomic<DWORD> liveVersions;
+    std::atomic<DWORD> views;
+    std::atomic<size_t> bytes;
+    std::atomic<uint64_t> acquires;
+    DWORD reloads;
+    DWORD failedReloads;
+};
+
+// =============================================================================
+// VERSIONS
+// =============================================================================
+
+static void FreeItems(GameData *pData, std::vector<LoadedItem> *pItems)
+{
+    for (size_t i = 0; i < pItems->size(); i++)
+    {
+        LoadedItem *pItem = &(*pItems)[i];
+        if (pItem->pTable)
+        {
+            DATATABLE_Close(pItem->pTable);
+        }
+        if (pData->source.pfnFree)
+        {
+            pData->source.pfnFree(pData->source.pContext, pItem->pData);
+        }
+    }
+    pItems->clear();
+}
+
+static GameDataView *LoadVersion(GameData *pData, DWORD version)
+{
+    GameDataView *pView = new GameDataView();
+    pView->pOwner = pData;
+    pView->version = version;
+    pView->refs.store(1); // The registry's
+    pView->pPresets = NULL;
+    pView->bytes = 0;
+
+    for (size_t i = 0; i < pData->names.size(); i++)
+    {
+        LoadedItem item;
+        item.pData = NULL;
+        item.size = 0;
+        item.pTable = NULL;
+        if (!pData->source.pfnLoad(pData->source.pContext, pData->names[i].c_str(), &item.pData, &item.size))
+        {
+            FreeItems(pData, &pView->items);
+            delete pView;
+            return NULL;
+        }
+        pView->items.push_back(item);
+
+        if (pData->kinds[i] == GAMEDATA_TABLE)
+        {
+            pView->items.back().pTable = DATATABLE_OpenMemory(item.pData, item.size, pData->tableFlags);
+            if (!pView->items.back().pTable)
+            {
+                FreeItems(pData, &pView->items);
+                delete pView;
+                return NULL;
+            }
+        }
+        pView->bytes += item.size;
+    }
+
+    if (pData->presets.pfnLoad)
+    {
+        pView->pPresets = PRESETSTORE_Create(&pData->presets, pData->maxPresets);
+        if (!pView->pPresets)
+        {
+            FreeItems(pData, &pView->items);
+            delete pView;
+            return NULL;
+        }
+    }
+
+    pData->liveVersions.fetch_add(1);
+    pData->bytes.fetch_add(pView->bytes);
+    return pView;
+}
+
+static void ReleaseVersion(GameDataView *pView)
+{
+    if (pView->refs.fetch_sub(1) != 1)
+    {
+        return;
+    }
+
+    GameData *pData = pView->pOwner;
+    FreeItems(pData, &pView->items);
+    if (pView->pPresets)
+    {
+        PRESETSTORE_Destroy(pView->pPresets);
+    }
+    pData->bytes.fetch_sub(pView->bytes);
+    pData->liveVersions.fetch_sub(1);
+    delete pView;
+}
+
+// =============================================================================
+// REGISTRY
+// =============================================================================
+
+GameData *__cdecl GAMEDATA_Create(const GameDataDesc *pDesc)
+{
+    if (!pDesc || !pDesc->source.pfnLoad || pDesc->itemCount > GAMEDATA_MAX_ITEMS ||
+        (pDesc->itemCount && !pDesc->pItems))
+    {
+        return NULL;
+    }
+
+    GameData *pData = new GameData();
+    for (DWORD i = 0; i < pDesc->itemCount; i++)
+    {
+        pData->names.push_back(pDesc->pItems[i].szName ? pDesc->pItems[i].szName : "");
+        pData->kinds.push_back(pDesc->pItems[i].kind);
+    }
+    pData->source = pDesc->source;
+    pData->presets = pDesc->presets;
+    pData->maxPresets = pDesc->maxPresets;
+    pData->tableFlags = pDesc->tableFlags;
+    pData->readers.store(0);
+    pData->nextVersion = 1;
+    pData->liveVersions.store(0);
+    pData->views.store(0);
+    pData->bytes.store(0);
+    pData->acquires.store(0);
+    pData->reloads = 0;
+    pData->failedReloads = 0;
+
+    GameDataView *pFirst = LoadVersion(pData, pData->nextVersion++);
+    if (!pFirst)
+    {
+        delete pData;
+        return NULL;
+    }
+    pData->current.store(pFirst);
+    return pData;
+}
+
+void __cdecl GAMEDATA_Destroy(GameData *pData)
+{
+    if (!pData)
+    {
+        return;
+    }
+    ReleaseVersion(pData->current.load());
+    delete pData;
+}
+
+DWORD __cdecl GAMEDATA_Reload(GameData *pData)
+{
+    std::lock_guard<std::mutex> lock(pData->reloadMutex);
+
+    GameDataView *pNew = LoadVersion(pData, pData->nextVersion);
+    if (!pNew)
+    {
+        pData->failedReloads++;
+        return 0;
+    }
+    pData->nextVersion++;
+    pData->reloads++;
+
+    GameDataView *pOld = pData->current.exchange(pNew);
+
+    // Grace period: an acquire that loaded pOld before the exchange has not
+    // necessarily taken its reference yet
+    while (pData->readers.load() != 0)
+    {
+        std::this_thread::yield();
+    }
+    ReleaseVersion(pOld);
+    return pNew->version;
+}
+
+// =============================================================================
+// VIEWS
+// =============================================================================
+
+const GameDataView *__cdecl GAMEDATA_Acquire(GameData *pData)
+{
+    pData->readers.fetch_add(1);
+    GameDataView *pView = pData->current.load();
+    pView->refs.fetch_add(1);
+    pData->readers.fetch_sub(1);
+
+    pData->acquires.fetch_add(1, std::memory_order_relaxed);
+    pData->views.fetch_add(1, std::memory_order_relaxed);
+    return pView;
+}
+
+void __cdecl GAMEDATA_Release(const GameDataView *pView)
+{
+    if (!pView)
+    {
+        return;
+    }
+    GameDataView *pMutable = const_cast<GameDataView *>(pView);
+    pMutable->pOwner->views.fetch_sub(1, std::memory_order_relaxed);
+    ReleaseVersion(pMutable);
+}
+
+BOOL __cdecl GAMEDATA_Refresh(GameData *pData, const GameDataView **ppView)
+{
+    // The held view keeps its address from being reused, so a pointer compare is enough
+    if (*ppView && *ppView == pData->current.load())
+    {
+        return FALSE;
+    }
+    const GameDataView *pOld = *ppView;
+    *ppView = GAMEDATA_Acquire(pData);
+    GAMEDATA_Release(pOld);
+    return TRUE;
+}
+
+DWORD __cdecl GAMEDATA_GetVersion(const GameDataView *pView)
+{
+    return pView->version;
+}
+
+DWORD __cdecl GAMEDATA_FindItem(const GameDataView *pView, const char *szName)
+{
+    const std::vector<std::string> &names = pView->pOwner->names;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        if (names[i] == szName)
+        {
+            return (DWORD)i;
+        }
+    }
+    return GAMEDATA_NO_ITEM;
+}
+
+const DataTable *__cdecl GAMEDATA_GetTable(const GameDataView *pView, DWORD item)
+{
+    if (item >= pView->items.size())
+    {
+        return NULL;
+    }
+    return pView->items[item].pTable;
+}
+
+const void *__cdecl GAMEDATA_GetBlob(const GameDataView *pView, DWORD item, size_t *pSize)
+{
+    if (item >= pView->items.size())
+    {
+        if (pSize)
+        {
+            *pSize = 0;
+        }
+        return NULL;
+    }
+    if (pSize)
+    {
+        *pSize = pView->items[item].size;
+    }
+    return pView->items[item].pData;
+}
+
+PresetStore *__cdecl GAMEDATA_GetPresets(const GameDataView *pView)
+{
+    return pView->pPresets;
+}
+
+void __cdecl GAMEDATA_GetStats(GameData *pData, GameDataStats *pStats)
+{
+    const GameDataView *pView = GAMEDATA_Acquire(pData);
+    size_t presetBytes = 0;
+    if (pView->pPresets)
+    {
+        PresetStoreStats presets;
+        PRESETSTORE_GetStats(pView->pPresets, &presets);
+        presetBytes = presets.bytes;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pData->reloadMutex);
+        pStats->version = pView->version;
+        pStats->reloads = pData->reloads;
+        pStats->failedReloads = pData->failedReloads;
+    }
+    pStats->liveVersions = pData->liveVersions.load();
+    pStats->views = pData->views.load() - 1; // Not counting our own
+    pStats->acquires = pData->acquires.load() - 1;
+    pStats->bytes = pData->bytes.load() + presetBytes;
+    GAMEDATA_Release(pView);
+}
@@ -0,0 +1,115 @@
+/*
+ * GameData.hpp - D2Server process-wide read-only game data
+ *
+ * LoadAllGameDLLs / InitializeDLLFunctionPointers bring up one game per
+ * process, and every process loads its own GlobalDataTables, string tables,
+ * palettes and DRLG presets. Hosted in one process (GameHost.hpp), each game
+ * would still hold a private copy; that duplicate static data is most of a
+ * game's resident memory.
+ *
+ * The registry loads the data once into an immutable version and hands out
+ * reference-counted read-only views of it:
+ *   - items (compiled tables, raw blobs such as string tables and palettes)
+ *     are named in the desc and read through a source callback; a table is
+ *     opened in place over its bytes (DATATABLE_OpenMemory);
+ *   - each version owns a PresetStore, so decoded DS1 presets are shared
+ *     by every game on that version as well;
+ *   - item indices are the desc order and stay the same across versions:
+ *     resolve them once with GAMEDATA_FindItem.
+ *
+ * Hot reload is RCU-style: GAMEDATA_Reload builds a complete new version
+ * off to the side, publishes it with one atomic pointer exchange, waits out
+ * the short grace period of acquires that may still be reading the old
+ * pointer, and drops the registry's reference. Games keep the version they
+ * hold until they call GAMEDATA_Refresh at a safe point (between ticks);
+ * the old version is freed when the last game lets go of it. A failed
+ * reload leaves the current version in place.
+ *
+ * Threading: Acquire, Release, Refresh and the view accessors may be called
+ * from any thread. Reloads are serialized with each other. Views are never
+ * written after publication, so readers take no locks.
+ */
+
+#ifndef GAMEDATA_HPP
+#define GAMEDATA_HPP
+
+#include "../Common/DataTable.hpp"
+#include "../Common/PresetStore.hpp"
+
+#include <stddef.h>
+
+#define GAMEDATA_MAX_ITEMS 256
+#define GAMEDATA_NO_ITEM 0xFFFFFFFF
+
+typedef enum GameDataKind
+{
+    GAMEDATA_TABLE = 1, // Compiled .d2t, opened with DATATABLE_OpenMemory
+    GAMEDATA_BLOB,      // Raw bytes (string tables, palettes, ...)
+} GameDataKind;
+
+typedef struct GameDataItem
+{
+    const char *szName; // Passed to the source; copied by GAMEDATA_Create
+    DWORD kind;         // GameDataKind
+} GameDataItem;
+
+/*
+ * Supplies an item's bytes (in the game: read through Storm from the MPQs).
+ * The buffer is kept, unmodified, until pfnFree when its version is freed.
+ * Called from whichever thread creates or reloads the registry.
+ */
+typedef struct GameDataSource
+{
+    BOOL(__cdecl *pfnLoad)(void *pContext, const char *szName, const void **ppData, size_t *pSize);
+    void(__cdecl *pfnFree)(void *pContext, const void *pData); // May be NULL
+    void *pContext;
+} GameDataSource;
+
+typedef struct GameDataDesc
+{
+    const GameDataItem *pItems;
+    DWORD itemCount; // At most GAMEDATA_MAX_ITEMS
+    GameDataSource source;
+    PresetSource presets; // pfnLoad NULL = no preset store
+    DWORD maxPresets;
+    DWORD tableFlags; // DATATABLE_OPEN_* for every table
+} GameDataDesc;
+
+typedef struct GameDataStats
+{
+    DWORD version;      // Current
+    DWORD liveVersions; // Current plus retired ones still held by views
+    DWORD views;        // Acquired and not yet released
+    DWORD reloads;
+    DWORD failedReloads;
+    uint64_t acquires;
+    size_t bytes; // Item bytes of all live versions, plus the current one's decoded presets
+} GameDataStats;
+
+typedef struct GameData GameData;
+typedef struct GameDataView GameDataView;
+
+// Loads version 1; NULL if any item fails to load or open
+GameData *__cdecl GAMEDATA_Create(const GameDataDesc *pDesc);
+// Every view must be released first
+void __cdecl GAMEDATA_Destroy(GameData *pData);
+
+// New version number, or 0 if loading failed (the current version stays)
+DWORD __cdecl GAMEDATA_Reload(GameData *pData);
+
+const GameDataView *__cdecl GAMEDATA_Acquire(GameData *pData);
+void __cdecl GAMEDATA_Release(const GameDataView *pView);
+// Swaps *ppView for the current version if it is older; TRUE if it changed
+BOOL __cdecl GAMEDATA_Refresh(GameData *pData, const GameDataView **ppView);
+
+DWORD __cdecl GAMEDATA_GetVersion(const GameDataView *pView);
+DWORD __cdecl GAMEDATA_FindItem(const GameDataView *pView, const char *szName);
+// NULL if the item is not a table
+const DataTable *__cdecl GAMEDATA_GetTable(const GameDataView *pView, DWORD item);
+const void *__cdecl GAMEDATA_GetBlob(const GameDataView *pView, DWORD item, size_t *pSize);
+// This version's shared preset store; NULL without presets
+PresetStore *__cdecl GAMEDATA_GetPresets(const GameDataView *pView);
+
+void __cdecl GAMEDATA_GetStats(GameData *pData, GameDataStats *pStats);
+
+#endif // GAMEDATA_HPP
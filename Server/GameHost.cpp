@@ -0,0 +1,596 @@
+/*
+ * GameHost.cpp - D2Server multi-game host
+ *
+ * See GameHost.hpp. Lock order: host mutex, then a worker queue mutex or a
+ * mailbox mutex. Workers never hold a queue mutex while taking the host
+ * mutex, and posting clients only ever take a mailbox mutex.
+ */
+
+#include "GameHost.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#define DEFAULT_TICK_HZ 25
+#define DEFAULT_MAX_GAMES 1024
+#define DEFAULT_MAX_LAG_TICKS 5
+#define DEFAULT_MAILBOX_BYTES 65536
+
+// Game id layout: low 16 bits = slot, high 16 bits = generation
+#define GAME_INDEX_BITS 16
+#define GAME_INDEX_MASK ((1u << GAME_INDEX_BITS) - 1)
+#define GAME_GENERATION_LIMIT 0xFFFE
+
+enum GameState
+{
+    GAME_FREE,
+    GAME_IDLE,    // Waiting in the release heap (or being removed)
+    GAME_QUEUED,  // On a worker queue
+    GAME_RUNNING, // Inside its tick callback
+};
+
+typedef struct MailboxRecord
+{
+    DWORD clientId;
+    DWORD offset;
+    DWORD size;
+} MailboxRecord;
+
+struct HostedGame
+{
+    // Guarded by the host mutex
+    DWORD generation;
+    DWORD state;
+    BOOL removing;
+    GameTickFn pfnTick;
+    void *pGame;
+    int64_t releaseNs; // Start of the next period
+    DWORD tick;
+    DWORD lastWorker;
+    HostedGameStats stats;
+
+    // Guarded by mailboxMutex
+    std::mutex mailboxMutex;
+    BOOL open;
+    DWORD mailboxGeneration;
+    std::vector<BYTE> postBytes;
+    std::vector<MailboxRecord> postRecords;
+    uint64_t messages;
+    uint64_t refused;
+
+    // Owned by the worker running the tick
+    std::vector<BYTE> tickBytes;
+    std::vector<MailboxRecord> tickRecords;
+    std::vector<HostMessage> tickMessages;
+};
+
+typedef struct HostTask
+{
+    DWORD game;
+    int64_t deadlineNs; // End of the period the tick belongs to
+} HostTask;
+
+struct HostWorker
+{
+    std::mutex mutex;
+    std::deque<HostTask> queue; // Deadline order
+    std::thread thread;
+};
+
+typedef struct ReleaseEntry
+{
+    int64_t releaseNs;
+    DWORD game;
+    DWORD generation; // Entries of removed games are skipped
+} ReleaseEntry;
+
+struct GameHost
+{
+    DWORD workerCount;
+    DWORD maxGames;
+    DWORD maxLagTicks;
+    DWORD mailboxBytes;
+    int64_t periodNs;
+
+    std::mutex mutex;
+    std::condition_variable pacerWake;
+    std::condition_variable gameIdle; // A game being removed left QUEUED/RUNNING
+    std::vector<ReleaseEntry> releases; // Min-heap on releaseNs
+    HostedGame *games;
+    std::vector<DWORD> freeGames;
+    DWORD gameCount;
+    uint64_t tasks;
+    uint64_t steals;
+    uint64_t deadlineMisses;
+    uint64_t skipped;
+    uint64_t busyNs;
+
+    HostWorker *workers;
+    std::atomic<int> queued; // Tasks on all worker queues, updated under the queue mutex
+    std::mutex idleMutex;
+    std::condition_variable workReady;
+    std::atomic<bool> stopping;
+    std::thread pacer;
+};
+
+// =============================================================================
+// CLOCKS
+// =============================================================================
+
+static inline int64_t NowNs(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Thread CPU time where the platform has a precise one; GetThreadTimes only
+// ticks every 15.6 ms, so Windows accounts wall time inside the tick instead
+static inline int64_t ThreadCpuNs(void)
+{
+#ifdef _WIN32
+    return NowNs();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static bool LaterRelease(const ReleaseEntry &a, const ReleaseEntry &b)
+{
+    return a.releaseNs > b.releaseNs;
+}
+
+// Host mutex held
+static void PushRelease(GameHost *pHost, DWORD index)
+{
+    HostedGame *pGame = &pHost->games[index];
+    ReleaseEntry entry;
+    entry.releaseNs = pGame->releaseNs;
+    entry.game = index;
+    entry.generation = pGame->generation;
+    pHost->releases.push_back(entry);
+    std::push_heap(pHost->releases.begin(), pHost->releases.end(), LaterRelease);
+    if (pHost->releases.front().game == index)
+    {
+        pHost->pacerWake.notify_one();
+    }
+}
+
+// =============================================================================
+// PACER
+// =============================================================================
+
+// Host mutex held
+static void QueueTask(GameHost *pHost, DWORD index, int64_t deadlineNs)
+{
+    HostWorker *pWorker = &pHost->workers[pHost->games[index].lastWorker];
+    HostTask task;
+    task.game = index;
+    task.deadlineNs = deadlineNs;
+    {
+        std::lock_guard<std::mutex> queueLock(pWorker->mutex);
+        std::deque<HostTask>::iterator it = pWorker->queue.end();
+        while (it != pWorker->queue.begin() && (it - 1)->deadlineNs > deadlineNs)
+        {
+            --it;
+        }
+        pWorker->queue.insert(it, task);
+        pHost->queued.fetch_add(1);
+    }
+    std::lock_guard<std::mutex> idleLock(pHost->idleMutex);
+    pHost->workReady.notify_one();
+}
+
+static void PacerMain(GameHost *pHost)
+{
+    std::unique_lock<std::mutex> lock(pHost->mutex);
+    while (!pHost->stopping.load())
+    {
+        if (pHost->releases.empty())
+        {
+            pHost->pacerWake.wait(lock);
+            continue;
+        }
+
+        ReleaseEntry top = pHost->releases.front();
+        if (top.releaseNs > NowNs())
+        {
+            std::chrono::nanoseconds release(top.releaseNs);
+            std::chrono::steady_clock::time_point until(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(release));
+            pHost->pacerWake.wait_until(lock, until);
+            continue;
+        }
+
+        std::pop_heap(pHost->releases.begin(), pHost->releases.end(), LaterRelease);
+        pHost->releases.pop_back();
+        HostedGame *pGame = &pHost->games[top.game];
+        if (pGame->generation != top.generation || pGame->state != GAME_IDLE || pGame->removing)
+        {
+            continue;
+        }
+        pGame->state = GAME_QUEUED;
+        QueueTask(pHost, top.game, top.releaseNs + pHost->periodNs);
+    }
+}
+
+// =============================================================================
+// WORKERS
+// =============================================================================
+
+static BOOL PopTask(GameHost *pHost, DWORD self, HostTask *pTask, BOOL *pStolen)
+{
+    {
+        HostWorker *pWorker = &pHost->workers[self];
+        std::lock_guard<std::mutex> lock(pWorker->mutex);
+        if (!pWorker->queue.empty())
+        {
+            *pTask = pWorker->queue.front();
+            pWorker->queue.pop_front();
+            pHost->queued.fetch_sub(1);
+            *pStolen = FALSE;
+            return TRUE;
+        }
+    }
+
+    // Steal the earliest deadline anywhere
+    DWORD victim = GAMEHOST_MAX_WORKERS;
+    int64_t earliest = INT64_MAX;
+    for (DWORD i = 1; i < pHost->workerCount; i++)
+    {
+        DWORD w = (self + i) % pHost->workerCount;
+        std::lock_guard<std::mutex> lock(pHost->workers[w].mutex);
+        if (!pHost->workers[w].queue.empty() && pHost->workers[w].queue.front().deadlineNs < earliest)
+        {
+            earliest = pHost->workers[w].queue.front().deadlineNs;
+            victim = w;
+        }
+    }
+    if (victim == GAMEHOST_MAX_WORKERS)
+    {
+        return FALSE;
+    }
+
+    HostWorker *pVictim = &pHost->workers[victim];
+    std::lock_guard<std::mutex> lock(pVictim->mutex);
+    if (pVictim->queue.empty())
+    {
+        return FALSE;
+    }
+    *pTask = pVictim->queue.front();
+    pVictim->queue.pop_front();
+    pHost->queued.fetch_sub(1);
+    *pStolen = TRUE;
+    return TRUE;
+}
+
+static void RunTask(GameHost *pHost, DWORD self, const HostTask *pTask, BOOL stolen)
+{
+    HostedGame *pGame = &pHost->games[pTask->game];
+    int64_t releaseNs;
+    DWORD tick;
+    {
+        std::lock_guard<std::mutex> lock(pHost->mutex);
+        if (pGame->removing)
+        {
+            pGame->state = GAME_IDLE;
+            pHost->gameIdle.notify_all();
+            return;
+        }
+        pGame->state = GAME_RUNNING;
+        releaseNs = pGame->releaseNs;
+        tick = pGame->tick;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pGame->mailboxMutex);
+        pGame->postBytes.swap(pGame->tickBytes);
+        pGame->postRecords.swap(pGame->tickRecords);
+    }
+    pGame->tickMessages.resize(pGame->tickRecords.size());
+    for (size_t i = 0; i < pGame->tickRecords.size(); i++)
+    {
+        const MailboxRecord *pRecord = &pGame->tickRecords[i];
+        pGame->tickMessages[i].clientId = pRecord->clientId;
+        pGame->tickMessages[i].size = pRecord->size;
+        pGame->tickMessages[i].pData = pGame->tickBytes.data() + pRecord->offset;
+    }
+
+    int64_t startNs = NowNs();
+    int64_t cpuStart = ThreadCpuNs();
+    pGame->pfnTick(pGame->pGame, tick, pGame->tickMessages.data(), (DWORD)pGame->tickMessages.size());
+    int64_t cpuNs = ThreadCpuNs() - cpuStart;
+    int64_t endNs = NowNs();
+
+    pGame->tickBytes.clear();
+    pGame->tickRecords.clear();
+
+    std::lock_guard<std::mutex> lock(pHost->mutex);
+    HostedGameStats *pStats = &pGame->stats;
+    int64_t latenessUs = (startNs - releaseNs) / 1000;
+    pStats->ticks++;
+    pStats->cpuNs += (uint64_t)cpuNs;
+    pStats->maxTickNs = std::max(pStats->maxTickNs, (DWORD)std::min<int64_t>(endNs - startNs, 0xFFFFFFFF));
+    pStats->maxLatenessUs = std::max(pStats->maxLatenessUs, (DWORD)std::min<int64_t>(latenessUs, 0xFFFFFFFF));
+    if (endNs > pTask->deadlineNs)
+    {
+        pStats->deadlineMisses++;
+        pHost->deadlineMisses++;
+    }
+    pHost->tasks++;
+    pHost->steals += stolen ? 1 : 0;
+    pHost->busyNs += (uint64_t)(endNs - startNs);
+
+    // Late games release at once to catch up; too late and the gap is skipped
+    int64_t next = releaseNs + pHost->periodNs;
+    int64_t behind = endNs - next;
+    if (behind > (int64_t)pHost->maxLagTicks * pHost->periodNs)
+    {
+        int64_t periods = behind / pHost->periodNs;
+        next += periods * pHost->periodNs;
+        pStats->skipped += (uint64_t)periods;
+        pHost->skipped += (uint64_t)periods;
+    }
+    pGame->releaseNs = next;
+    pGame->tick = tick + 1;
+    pGame->lastWorker = self;
+    pGame->state = GAME_IDLE;
+    if (pGame->removing)
+    {
+        pHost->gameIdle.notify_all();
+    }
+    else
+    {
+        PushRelease(pHost, pTask->game);
+    }
+}
+
+static void WorkerMain(GameHost *pHost, DWORD self)
+{
+    for (;;)
+    {
+        HostTask task;
+        BOOL stolen;
+        if (PopTask(pHost, self, &task, &stolen))
+        {
+            RunTask(pHost, self, &task, stolen);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(pHost->idleMutex);
+        pHost->workReady.wait(lock, [pHost] { return pHost->stopping.load() || pHost->queued.load() > 0; });
+        if (pHost->stopping.load())
+        {
+            return;
+        }
+    }
+}
+
+// =============================================================================
+// LIFETIME
+// =============================================================================
+
+GameHost *__cdecl GAMEHOST_Create(const GameHostDesc *pDesc)
+{
+    DWORD workers = pDesc ? pDesc->workerCount : 0;
+    if (!workers)
+    {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    DWORD tickHz = (pDesc && pDesc->tickHz) ? pDesc->tickHz : DEFAULT_TICK_HZ;
+    DWORD maxGames = (pDesc && pDesc->maxGames) ? pDesc->maxGames : DEFAULT_MAX_GAMES;
+
+    GameHost *pHost = new GameHost();
+    pHost->workerCount = std::min<DWORD>(workers, GAMEHOST_MAX_WORKERS);
+    pHost->maxGames = std::min<DWORD>(maxGames, GAME_INDEX_MASK + 1);
+    pHost->maxLagTicks = (pDesc && pDesc->maxLagTicks) ? pDesc->maxLagTicks : DEFAULT_MAX_LAG_TICKS;
+    pHost->mailboxBytes = (pDesc && pDesc->mailboxBytes) ? pDesc->mailboxBytes : DEFAULT_MAILBOX_BYTES;
+    pHost->periodNs = 1000000000 / tickHz;
+    pHost->games = new HostedGame[pHost->maxGames]();
+    pHost->gameCount = 0;
+    pHost->tasks = pHost->steals = pHost->deadlineMisses = pHost->skipped = pHost->busyNs = 0;
+    pHost->queued.store(0);
+    pHost->stopping.store(false);
+
+    for (DWORD i = pHost->maxGames; i > 0; i--)
+    {
+        pHost->freeGames.push_back(i - 1);
+    }
+
+    pHost->workers = new HostWorker[pHost->workerCount];
+    for (DWORD i = 0; i < pHost->workerCount; i++)
+    {
+        pHost->workers[i].thread = std::thread(WorkerMain, pHost, i);
+    }
+    pHost->pacer = std::thread(PacerMain, pHost);
+    return pHost;
+}
+
+void __cdecl GAMEHOST_Destroy(GameHost *pHost)
+{
+    if (!pHost)
+    {
+        return;
+    }
+
+    pHost->stopping.store(true);
+    {
+        std::lock_guard<std::mutex> lock(pHost->mutex);
+        pHost->pacerWake.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(pHost->idleMutex);
+        pHost->workReady.notify_all();
+    }
+    pHost->pacer.join();
+    for (DWORD i = 0; i < pHost->workerCount; i++)
+    {
+        pHost->workers[i].thread.join();
+    }
+    delete[] pHost->workers;
+    delete[] pHost->games;
+    delete pHost;
+}
+
+// =============================================================================
+// GAMES
+// =============================================================================
+
+// Host mutex held
+static HostedGame *ResolveGame(GameHost *pHost, HostedGameId id)
+{
+    DWORD index = id & GAME_INDEX_MASK;
+    if (id == GAMEHOST_INVALID_GAME || index >= pHost->maxGames)
+    {
+        return NULL;
+    }
+    HostedGame *pGame = &pHost->games[index];
+    if (pGame->state == GAME_FREE || pGame->removing || pGame->generation != (id >> GAME_INDEX_BITS))
+    {
+        return NULL;
+    }
+    return pGame;
+}
+
+static void ReadStats(HostedGame *pGame, HostedGameStats *pStats)
+{
+    *pStats = pGame->stats;
+    std::lock_guard<std::mutex> lock(pGame->mailboxMutex);
+    pStats->messages = pGame->messages;
+    pStats->refused = pGame->refused;
+}
+
+HostedGameId __cdecl GAMEHOST_AddGame(GameHost *pHost, const HostedGameDesc *pDesc)
+{
+    if (!pDesc || !pDesc->pfnTick)
+    {
+        return GAMEHOST_INVALID_GAME;
+    }
+
+    std::lock_guard<std::mutex> lock(pHost->mutex);
+    if (pHost->freeGames.empty())
+    {
+        return GAMEHOST_INVALID_GAME;
+    }
+    DWORD index = pHost->freeGames.back();
+    pHost->freeGames.pop_back();
+    pHost->gameCount++;
+
+    HostedGame *pGame = &pHost->games[index];
+    pGame->state = GAME_IDLE;
+    pGame->removing = FALSE;
+    pGame->pfnTick = pDesc->pfnTick;
+    pGame->pGame = pDesc->pGame;
+    pGame->releaseNs = NowNs();
+    pGame->tick = 0;
+    pGame->lastWorker = index % pHost->workerCount;
+    memset(&pGame->stats, 0, sizeof(pGame->stats));
+    {
+        std::lock_guard<std::mutex> mailboxLock(pGame->mailboxMutex);
+        pGame->open = TRUE;
+        pGame->mailboxGeneration = pGame->generation;
+        pGame->postBytes.clear();
+        pGame->postRecords.clear();
+        pGame->messages = 0;
+        pGame->refused = 0;
+    }
+    PushRelease(pHost, index);
+    return (pGame->generation << GAME_INDEX_BITS) | index;
+}
+
+BOOL __cdecl GAMEHOST_RemoveGame(GameHost *pHost, HostedGameId id, HostedGameStats *pStats)
+{
+    std::unique_lock<std::mutex> lock(pHost->mutex);
+    HostedGame *pGame = ResolveGame(pHost, id);
+    if (!pGame)
+    {
+        return FALSE;
+    }
+
+    // A queued tick is dropped by the worker that pops it, a running one finishes
+    pGame->removing = TRUE;
+    pHost->gameIdle.wait(lock, [pGame] { return pGame->state == GAME_IDLE; });
+
+    {
+        std::lock_guard<std::mutex> mailboxLock(pGame->mailboxMutex);
+        pGame->open = FALSE;
+    }
+    if (pStats)
+    {
+        ReadStats(pGame, pStats);
+    }
+
+    DWORD index = id & GAME_INDEX_MASK;
+    pGame->state = GAME_FREE;
+    pGame->removing = FALSE;
+    pGame->generation = pGame->generation >= GAME_GENERATION_LIMIT ? 0 : pGame->generation + 1;
+    pHost->freeGames.push_back(index);
+    pHost->gameCount--;
+    return TRUE;
+}
+
+BOOL __cdecl GAMEHOST_Post(GameHost *pHost, HostedGameId id, DWORD clientId, const void *pData, DWORD size)
+{
+    DWORD index = id & GAME_INDEX_MASK;
+    if (id == GAMEHOST_INVALID_GAME || index >= pHost->maxGames)
+    {
+        return FALSE;
+    }
+
+    HostedGame *pGame = &pHost->games[index];
+    std::lock_guard<std::mutex> lock(pGame->mailboxMutex);
+    if (!pGame->open || pGame->mailboxGeneration != (id >> GAME_INDEX_BITS))
+    {
+        return FALSE;
+    }
+    if (pGame->postBytes.size() + size > pHost->mailboxBytes)
+    {
+        pGame->refused++;
+        return FALSE;
+    }
+
+    MailboxRecord record;
+    record.clientId = clientId;
+    record.offset = (DWORD)pGame->postBytes.size();
+    record.size = size;
+    pGame->postRecords.push_back(record);
+    pGame->postBytes.insert(pGame->postBytes.end(), (const BYTE *)pData, (const BYTE *)pData + size);
+    pGame->messages++;
+    return TRUE;
+}
+
+BOOL __cdecl GAMEHOST_GetGameStats(GameHost *pHost, HostedGameId id, HostedGameStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(pHost->mutex);
+    HostedGame *pGame = ResolveGame(pHost, id);
+    if (!pGame)
+    {
+        return FALSE;
+    }
+    ReadStats(pGame, pStats);
+    return TRUE;
+}
+
+void __cdecl GAMEHOST_GetStats(GameHost *pHost, GameHostStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(pHost->mutex);
+    pStats->games = pHost->gameCount;
+    pStats->workers = pHost->workerCount;
+    pStats->tasks = pHost->tasks;
+    pStats->steals = pHost->steals;
+    pStats->deadlineMisses = pHost->deadlineMisses;
+    pStats->skipped = pHost->skipped;
+    pStats->busyNs = pHost->busyNs;
+}
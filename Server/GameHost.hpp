@@ -0,0 +1,108 @@
+/*
+ * GameHost.hpp - D2Server multi-game host
+ *
+ * D2ServerMain / InitializeAndRunGameMainLoop own the whole process: one
+ * game, one loop, sleeping to the next 40 ms frame. A dedicated server that
+ * wants hundreds of games has to start hundreds of processes, each with its
+ * own copy of the data tables and DLL state.
+ *
+ * The host runs many independent games in one process. Each game's tick is
+ * a task on a small worker pool:
+ *   - a pacer thread releases a game when its next 25 Hz period starts and
+ *     queues it on the worker that ran it last (warm caches);
+ *   - worker queues are kept in deadline order (end of the period); a
+ *     worker runs its earliest task and, when empty, steals the earliest
+ *     task from the other workers;
+ *   - a game never runs two ticks at once. A game that overran releases its
+ *     next tick immediately to catch up; one more than maxLagTicks behind
+ *     skips the missed periods instead of spiralling.
+ *
+ * Every tick is accounted to its game: thread CPU time (wall time on
+ * Windows), worst tick, lateness against the period start, deadline misses
+ * and skipped periods.
+ *
+ * Clients talk to games through per-game mailboxes: GAMEHOST_Post may be
+ * called from any thread, and each tick receives everything posted since the
+ * previous one, in posting order, as a batch.
+ *
+ * Threading: every call may be made from any thread except from inside a
+ * tick callback, which must not add or remove games. Tick callbacks of
+ * different games run concurrently and must not share mutable state.
+ */
+
+#ifndef GAMEHOST_HPP
+#define GAMEHOST_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#define GAMEHOST_MAX_WORKERS 64
+#define GAMEHOST_INVALID_GAME 0xFFFFFFFF
+
+typedef DWORD HostedGameId;
+
+typedef struct HostMessage
+{
+    DWORD clientId;
+    DWORD size;
+    const BYTE *pData; // Valid for the duration of the tick callback
+} HostMessage;
+
+// One game tick; tick counts the ticks this game has run, from 0
+typedef void(__cdecl *GameTickFn)(void *pGame, DWORD tick, const HostMessage *pMessages, DWORD count);
+
+typedef struct GameHostDesc
+{
+    DWORD workerCount;  // 0 = one per hardware thread, at most GAMEHOST_MAX_WORKERS
+    DWORD tickHz;       // 0 = 25
+    DWORD maxGames;     // 0 = 1024
+    DWORD maxLagTicks;  // Periods a game may fall behind before skipping (0 = 5)
+    DWORD mailboxBytes; // Per game, per tick; posts beyond it are refused (0 = 64 KB)
+} GameHostDesc;
+
+typedef struct HostedGameDesc
+{
+    GameTickFn pfnTick;
+    void *pGame; // Passed back to pfnTick, owned by the caller
+} HostedGameDesc;
+
+typedef struct HostedGameStats
+{
+    uint64_t ticks;
+    uint64_t skipped;        // Periods dropped after falling behind
+    uint64_t deadlineMisses; // Ticks that finished after their period ended
+    uint64_t cpuNs;          // Spent inside the tick callback
+    DWORD maxTickNs;
+    DWORD maxLatenessUs; // Worst start delay past the period start
+    uint64_t messages;
+    uint64_t refused; // Posts refused by a full mailbox
+} HostedGameStats;
+
+typedef struct GameHostStats
+{
+    DWORD games;
+    DWORD workers;
+    uint64_t tasks;
+    uint64_t steals;
+    uint64_t deadlineMisses;
+    uint64_t skipped;
+    uint64_t busyNs; // Sum over workers of time spent in ticks
+} GameHostStats;
+
+typedef struct GameHost GameHost;
+
+GameHost *__cdecl GAMEHOST_Create(const GameHostDesc *pDesc);
+// Every game must be removed first
+void __cdecl GAMEHOST_Destroy(GameHost *pHost);
+
+// First tick is released immediately. GAMEHOST_INVALID_GAME when full.
+HostedGameId __cdecl GAMEHOST_AddGame(GameHost *pHost, const HostedGameDesc *pDesc);
+// Waits for a running tick to finish; pStats (may be NULL) receives the final numbers
+BOOL __cdecl GAMEHOST_RemoveGame(GameHost *pHost, HostedGameId id, HostedGameStats *pStats);
+
+// Copies the message into the game's mailbox. FALSE for removed games or a full mailbox.
+BOOL __cdecl GAMEHOST_Post(GameHost *pHost, HostedGameId id, DWORD clientId, const void *pData, DWORD size);
+
+BOOL __cdecl GAMEHOST_GetGameStats(GameHost *pHost, HostedGameId id, HostedGameStats *pStats);
+void __cdecl GAMEHOST_GetStats(GameHost *pHost, GameHostStats *pStats);
+
+#endif // GAMEHOST_HPP
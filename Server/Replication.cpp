@@ -0,0 +1,729 @@
+/*
+ * Replication.cpp - D2Server delta-compressed unit replication
+ *
+ * See Replication.hpp. Frame payload, LSB-first bit stream:
+ *
+ *   record  op:2  (0 end, 1 create, 2 update, 3 remove)
+ *   create  slot:10 guid:32 type:3 class:16 x:16 y:16 mode:5 life:8 dir:6 flags:16
+ *   update  slot:10 mask:6, then each field in the mask in bit order:
+ *           x/y  small:1, then delta:7 (signed) or value:16
+ *           mode:5 life:8 dir:6 flags:16
+ *   remove  slot:10
+ */
+
+#include "Replication.hpp"
+
+#include "../Shared/HashIndex.hpp"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#define NONE 0xFFFFFFFF
+
+#define DEFAULT_MAX_UNITS 4096
+#define DEFAULT_MAX_CLIENTS 8
+#define DEFAULT_VIEW_RADIUS 48
+#define HYSTERESIS 8 // Subtiles past the radius before a visible unit is removed
+
+#define OP_END 0
+#define OP_CREATE 1
+#define OP_UPDATE 2
+#define OP_REMOVE 3
+
+#define OP_BITS 2
+#define CREATE_BITS (OP_BITS + REPL_SLOT_BITS + 32 + 3 + 16 + 16 + 16 + 5 + 8 + 6 + 16)
+#define REMOVE_BITS (OP_BITS + REPL_SLOT_BITS)
+#define DELTA_BITS 7
+
+#define SLOT_FREE 0
+#define SLOT_PENDING 1 // Relevant, not yet created on the client
+#define SLOT_LIVE 2
+
+// =============================================================================
+// BIT STREAM
+// =============================================================================
+
+typedef struct BitWriter
+{
+    BYTE *pData;
+    DWORD bits;
+    DWORD capacityBits;
+} BitWriter;
+
+static void WriteBits(BitWriter *pWriter, DWORD value, DWORD count)
+{
+    while (count)
+    {
+        BYTE *pByte = &pWriter->pData[pWriter->bits >> 3];
+        DWORD bit = pWriter->bits & 7;
+        DWORD take = std::min(8 - bit, count);
+        if (bit == 0)
+        {
+            *pByte = 0;
+        }
+        *pByte |= (BYTE)((value & ((1u << take) - 1)) << bit);
+        value >>= take;
+        count -= take;
+        pWriter->bits += take;
+    }
+}
+
+typedef struct BitReader
+{
+    const BYTE *pData;
+    DWORD bits;
+    DWORD totalBits;
+    BOOL overrun;
+} BitReader;
+
+static DWORD ReadBits(BitReader *pReader, DWORD count)
+{
+    if (pReader->totalBits - pReader->bits < count)
+    {
+        pReader->overrun = TRUE;
+        pReader->bits = pReader->totalBits;
+        return 0;
+    }
+    DWORD value = 0;
+    for (DWORD shift = 0; shift < count;)
+    {
+        DWORD bit = pReader->bits & 7;
+        DWORD take = std::min(8 - bit, count - shift);
+        value |= (DWORD)((pReader->pData[pReader->bits >> 3] >> bit) & ((1u << take) - 1)) << shift;
+        shift += take;
+        pReader->bits += take;
+    }
+    return value;
+}
+
+// =============================================================================
+// SERVER
+// =============================================================================
+
+typedef struct ClientSlot
+{
+    DWORD guid;
+    BYTE state;
+    BYTE seen;
+    WORD reserved;
+    ReplUnitState baseline; // What the client holds (SLOT_LIVE)
+    float priority;
+    DWORD waitingSince; // Frame the pending record appeared, NONE if nothing pending
+} ClientSlot;
+
+typedef struct Candidate
+{
+    float priority;
+    DWORD slot;
+    DWORD unit;
+    DWORD mask; // 0 = create
+    DWORD bits;
+} Candidate;
+
+typedef struct ClientState
+{
+    BOOL active;
+    DWORD controlledGuid;
+    DWORD budget;
+    std::vector<ClientSlot> slots;
+    std::vector<DWORD> freeSlots;
+    HashIndex slotMap; // GUID -> slot
+    DWORD frame;
+    ReplClientStats stats;
+} ClientState;
+
+struct Replicator
+{
+    DWORD maxUnits;
+    DWORD viewRadius;
+    DWORD defaultBudget;
+    std::vector<ReplUnitState> units; // Dense
+    HashIndex unitMap;                // GUID -> dense index
+    std::vector<ClientState> clients;
+
+    // Frame scratch
+    std::vector<Candidate> candidates;
+    std::vector<DWORD> removals;
+};
+
+static DWORD DiffMask(const ReplUnitState *pBase, const ReplUnitState *pState)
+{
+    DWORD mask = 0;
+    mask |= (pBase->x != pState->x) ? REPL_FIELD_X : 0;
+    mask |= (pBase->y != pState->y) ? REPL_FIELD_Y : 0;
+    mask |= (pBase->mode != pState->mode) ? REPL_FIELD_MODE : 0;
+    mask |= (pBase->life != pState->life) ? REPL_FIELD_LIFE : 0;
+    mask |= (pBase->direction != pState->direction) ? REPL_FIELD_DIR : 0;
+    mask |= (pBase->flags != pState->flags) ? REPL_FIELD_FLAGS : 0;
+    return mask;
+}
+
+static inline BOOL IsSmallStep(WORD from, WORD to)
+{
+    int delta = (int)(short)(WORD)(to - from);
+    return delta >= -(1 << (DELTA_BITS - 1)) && delta < (1 << (DELTA_BITS - 1));
+}
+
+static DWORD UpdateBits(const ReplUnitState *pBase, const ReplUnitState *pState, DWORD mask)
+{
+    DWORD bits = OP_BITS + REPL_SLOT_BITS + REPL_FIELD_COUNT;
+    if (mask & REPL_FIELD_X)
+    {
+        bits += 1 + (IsSmallStep(pBase->x, pState->x) ? DELTA_BITS : 16);
+    }
+    if (mask & REPL_FIELD_Y)
+    {
+        bits += 1 + (IsSmallStep(pBase->y, pState->y) ? DELTA_BITS : 16);
+    }
+    bits += (mask & REPL_FIELD_MODE) ? 5 : 0;
+    bits += (mask & REPL_FIELD_LIFE) ? 8 : 0;
+    bits += (mask & REPL_FIELD_DIR) ? 6 : 0;
+    bits += (mask & REPL_FIELD_FLAGS) ? 16 : 0;
+    return bits;
+}
+
+static void WriteCoord(BitWriter *pWriter, WORD from, WORD to)
+{
+    if (IsSmallStep(from, to))
+    {
+        WriteBits(pWriter, 1, 1);
+        WriteBits(pWriter, (DWORD)(WORD)(to - from) & ((1u << DELTA_BITS) - 1), DELTA_BITS);
+    }
+    else
+    {
+        WriteBits(pWriter, 0, 1);
+        WriteBits(pWriter, to, 16);
+    }
+}
+
+static void WriteCreate(BitWriter *pWriter, DWORD slot, const ReplUnitState *pState)
+{
+    WriteBits(pWriter, OP_CREATE, OP_BITS);
+    WriteBits(pWriter, slot, REPL_SLOT_BITS);
+    WriteBits(pWriter, pState->guid, 32);
+    WriteBits(pWriter, pState->type, 3);
+    WriteBits(pWriter, pState->classId, 16);
+    WriteBits(pWriter, pState->x, 16);
+    WriteBits(pWriter, pState->y, 16);
+    WriteBits(pWriter, pState->mode, 5);
+    WriteBits(pWriter, pState->life, 8);
+    WriteBits(pWriter, pState->direction, 6);
+    WriteBits(pWriter, pState->flags, 16);
+}
+
+static void WriteUpdate(BitWriter *pWriter, DWORD slot, const ReplUnitState *pBase, const ReplUnitState *pState,
+                        DWORD mask)
+{
+    WriteBits(pWriter, OP_UPDATE, OP_BITS);
+    WriteBits(pWriter, slot, REPL_SLOT_BITS);
+    WriteBits(pWriter, mask, REPL_FIELD_COUNT);
+    if (mask & REPL_FIELD_X)
+    {
+        WriteCoord(pWriter, pBase->x, pState->x);
+    }
+    if (mask & REPL_FIELD_Y)
+    {
+        WriteCoord(pWriter, pBase->y, pState->y);
+    }
+    if (mask & REPL_FIELD_MODE)
+    {
+        WriteBits(pWriter, pState->mode, 5);
+    }
+    if (mask & REPL_FIELD_LIFE)
+    {
+        WriteBits(pWriter, pState->life, 8);
+    }
+    if (mask & REPL_FIELD_DIR)
+    {
+        WriteBits(pWriter, pState->direction, 6);
+    }
+    if (mask & REPL_FIELD_FLAGS)
+    {
+        WriteBits(pWriter, pState->flags, 16);
+    }
+}
+
+// Relevance weight per tick a record waits
+static float Relevance(const ReplUnitState *pState, BOOL self, DWORD dist2)
+{
+    static const float s_typeWeight[] = {8.0f, 4.0f, 1.0f, 2.0f, 1.0f, 1.0f};
+    float weight = self ? 64.0f : s_typeWeight[pState->type < 6 ? pState->type : 5];
+    // Nearness falls off over about a quarter of the screen
+    return weight / (1.0f + (float)dist2 / 144.0f);
+}
+
+static bool HigherPriority(const Candidate &a, const Candidate &b)
+{
+    return a.priority > b.priority;
+}
+
+static void FreeSlot(ClientState *pClient, DWORD slot)
+{
+    ClientSlot *pSlot = &pClient->slots[slot];
+    DWORD at = HASHINDEX_Find(&pClient->slotMap, pSlot->guid);
+    if (at != NONE)
+    {
+        HASHINDEX_Erase(&pClient->slotMap, at);
+    }
+    pSlot->state = SLOT_FREE;
+    pClient->freeSlots.push_back(slot);
+}
+
+Replicator *__cdecl REPL_Create(const ReplDesc *pDesc)
+{
+    ReplDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    if (pDesc)
+    {
+        desc = *pDesc;
+    }
+
+    Replicator *pRepl = new Replicator();
+    pRepl->maxUnits = desc.maxUnits ? desc.maxUnits : DEFAULT_MAX_UNITS;
+    pRepl->viewRadius = desc.viewRadius ? desc.viewRadius : DEFAULT_VIEW_RADIUS;
+    pRepl->defaultBudget = std::min<DWORD>(desc.bytesPerFrame ? desc.bytesPerFrame : REPL_MAX_FRAME, REPL_MAX_FRAME);
+    pRepl->units.reserve(pRepl->maxUnits);
+    if (!HASHINDEX_Init(&pRepl->unitMap, pRepl->maxUnits))
+    {
+        delete pRepl;
+        return NULL;
+    }
+    pRepl->clients.resize(desc.maxClients ? desc.maxClients : DEFAULT_MAX_CLIENTS);
+    for (size_t c = 0; c < pRepl->clients.size(); c++)
+    {
+        pRepl->clients[c].active = FALSE;
+    }
+    return pRepl;
+}
+
+void __cdecl REPL_Destroy(Replicator *pRepl)
+{
+    if (!pRepl)
+    {
+        return;
+    }
+    for (size_t c = 0; c < pRepl->clients.size(); c++)
+    {
+        HASHINDEX_Free(&pRepl->clients[c].slotMap);
+    }
+    HASHINDEX_Free(&pRepl->unitMap);
+    delete pRepl;
+}
+
+BOOL __cdecl REPL_SetUnit(Replicator *pRepl, const ReplUnitState *pState)
+{
+    DWORD at = HASHINDEX_Find(&pRepl->unitMap, pState->guid);
+    if (at != NONE)
+    {
+        pRepl->units[pRepl->unitMap.pValues[at]] = *pState;
+        return TRUE;
+    }
+    if (pRepl->units.size() >= pRepl->maxUnits)
+    {
+        return FALSE;
+    }
+    HASHINDEX_Insert(&pRepl->unitMap, pState->guid, (DWORD)pRepl->units.size());
+    pRepl->units.push_back(*pState);
+    return TRUE;
+}
+
+BOOL __cdecl REPL_RemoveUnit(Replicator *pRepl, DWORD guid)
+{
+    DWORD at = HASHINDEX_Find(&pRepl->unitMap, guid);
+    if (at == NONE)
+    {
+        return FALSE;
+    }
+    DWORD index = pRepl->unitMap.pValues[at];
+    HASHINDEX_Erase(&pRepl->unitMap, at);
+
+    // Swap-remove; clients notice the unit is gone on their next frame
+    DWORD last = (DWORD)pRepl->units.size() - 1;
+    if (index != last)
+    {
+        pRepl->units[index] = pRepl->units[last];
+        pRepl->unitMap.pValues[HASHINDEX_Find(&pRepl->unitMap, pRepl->units[index].guid)] = index;
+    }
+    pRepl->units.pop_back();
+    return TRUE;
+}
+
+int __cdecl REPL_AddClient(Replicator *pRepl, DWORD controlledGuid)
+{
+    for (size_t c = 0; c < pRepl->clients.size(); c++)
+    {
+        ClientState *pClient = &pRepl->clients[c];
+        if (pClient->active)
+        {
+            continue;
+        }
+        if (!HASHINDEX_Init(&pClient->slotMap, REPL_MAX_SLOTS))
+        {
+            return -1;
+        }
+        pClient->active = TRUE;
+        pClient->controlledGuid = controlledGuid;
+        pClient->budget = pRepl->defaultBudget;
+        pClient->slots.assign(REPL_MAX_SLOTS, ClientSlot());
+        pClient->freeSlots.clear();
+        for (DWORD s = REPL_MAX_SLOTS; s-- > 0;)
+        {
+            pClient->slots[s].state = SLOT_FREE;
+            pClient->freeSlots.push_back(s);
+        }
+        pClient->frame = 0;
+        memset(&pClient->stats, 0, sizeof(pClient->stats));
+        return (int)c;
+    }
+    return -1;
+}
+
+void __cdecl REPL_RemoveClient(Replicator *pRepl, int client)
+{
+    if (client < 0 || client >= (int)pRepl->clients.size())
+    {
+        return;
+    }
+    ClientState *pClient = &pRepl->clients[client];
+    pClient->active = FALSE;
+    pClient->slots.clear();
+    pClient->freeSlots.clear();
+    HASHINDEX_Free(&pClient->slotMap);
+}
+
+void __cdecl REPL_SetClientBudget(Replicator *pRepl, int client, DWORD bytesPerFrame)
+{
+    if (client < 0 || client >= (int)pRepl->clients.size())
+    {
+        return;
+    }
+    DWORD budget = bytesPerFrame ? bytesPerFrame : pRepl->defaultBudget;
+    pRepl->clients[client].budget = std::min<DWORD>(budget, REPL_MAX_FRAME);
+}
+
+DWORD __cdecl REPL_BuildFrame(Replicator *pRepl, int client, BYTE *pOut, DWORD capacity)
+{
+    if (client < 0 || client >= (int)pRepl->clients.size() || !pRepl->clients[client].active)
+    {
+        return 0;
+    }
+    ClientState *pClient = &pRepl->clients[client];
+    DWORD budget = std::min(pClient->budget, capacity);
+    if (budget <= REPL_FRAME_HEADER)
+    {
+        return 0;
+    }
+
+    DWORD frame = pClient->frame++;
+    DWORD viewer = HASHINDEX_Find(&pRepl->unitMap, pClient->controlledGuid);
+    const ReplUnitState *pViewer = (viewer != NONE) ? &pRepl->units[pRepl->unitMap.pValues[viewer]] : NULL;
+    DWORD radius2 = pRepl->viewRadius * pRepl->viewRadius;
+    DWORD keep2 = (pRepl->viewRadius + HYSTERESIS) * (pRepl->viewRadius + HYSTERESIS);
+
+    // Interest: units in range get (or keep) a slot and, if anything is pending, a candidate record
+    pRepl->candidates.clear();
+    for (DWORD u = 0; pViewer && u < (DWORD)pRepl->units.size(); u++)
+    {
+        const ReplUnitState *pState = &pRepl->units[u];
+        int dx = (int)pState->x - (int)pViewer->x;
+        int dy = (int)pState->y - (int)pViewer->y;
+        DWORD dist2 = (DWORD)(dx * dx + dy * dy);
+
+        DWORD at = HASHINDEX_Find(&pClient->slotMap, pState->guid);
+        DWORD slot;
+        if (at != NONE)
+        {
+            if (dist2 > keep2)
+            {
+                continue;
+            }
+            slot = pClient->slotMap.pValues[at];
+        }
+        else
+        {
+            if (dist2 > radius2 || pClient->freeSlots.empty())
+            {
+                continue;
+            }
+            slot = pClient->freeSlots.back();
+            pClient->freeSlots.pop_back();
+            ClientSlot *pNew = &pClient->slots[slot];
+            pNew->guid = pState->guid;
+            pNew->state = SLOT_PENDING;
+            pNew->priority = 0.0f;
+            pNew->waitingSince = NONE;
+            HASHINDEX_Insert(&pClient->slotMap, pState->guid, slot);
+        }
+
+        ClientSlot *pSlot = &pClient->slots[slot];
+        pSlot->seen = 1;
+        DWORD mask = (pSlot->state == SLOT_LIVE) ? DiffMask(&pSlot->baseline, pState) : 0;
+        if (pSlot->state == SLOT_LIVE && !mask)
+        {
+            continue;
+        }
+
+        BOOL self = pState->guid == pClient->controlledGuid;
+        pSlot->priority += Relevance(pState, self, dist2) * (pSlot->state == SLOT_PENDING ? 2.0f : 1.0f);
+        if (pSlot->waitingSince == NONE)
+        {
+            pSlot->waitingSince = frame;
+        }
+
+        Candidate candidate;
+        candidate.priority = pSlot->priority;
+        candidate.slot = slot;
+        candidate.unit = u;
+        candidate.mask = mask;
+        candidate.bits = mask ? UpdateBits(&pSlot->baseline, pState, mask) : CREATE_BITS;
+        pRepl->candidates.push_back(candidate);
+    }
+
+    // Slots not seen this frame: out of range or despawned
+    pRepl->removals.clear();
+    for (DWORD s = 0; s < REPL_MAX_SLOTS; s++)
+    {
+        ClientSlot *pSlot = &pClient->slots[s];
+        if (pSlot->state == SLOT_FREE)
+        {
+            continue;
+        }
+        if (pSlot->seen)
+        {
+            pSlot->seen = 0;
+        }
+        else if (pSlot->state == SLOT_PENDING)
+        {
+            FreeSlot(pClient, s); // The client never heard of it
+        }
+        else
+        {
+            pRepl->removals.push_back(s);
+        }
+    }
+
+    BitWriter writer;
+    writer.pData = pOut + REPL_FRAME_HEADER;
+    writer.bits = 0;
+    writer.capacityBits = (budget - REPL_FRAME_HEADER) * 8 - OP_BITS; // Room for the end marker
+
+    // Removals first: they are small and free slots for creates
+    for (size_t i = 0; i < pRepl->removals.size(); i++)
+    {
+        if (writer.bits + REMOVE_BITS > writer.capacityBits)
+        {
+            pClient->stats.deferred += pRepl->removals.size() - i;
+            break;
+        }
+        WriteBits(&writer, OP_REMOVE, OP_BITS);
+        WriteBits(&writer, pRepl->removals[i], REPL_SLOT_BITS);
+        FreeSlot(pClient, pRepl->removals[i]);
+        pClient->stats.removes++;
+    }
+
+    std::sort(pRepl->candidates.begin(), pRepl->candidates.end(), HigherPriority);
+    for (size_t i = 0; i < pRepl->candidates.size(); i++)
+    {
+        const Candidate *pCandidate = &pRepl->candidates[i];
+        if (writer.bits + pCandidate->bits > writer.capacityBits)
+        {
+            // A smaller record further down may still fit
+            pClient->stats.deferred++;
+            continue;
+        }
+        ClientSlot *pSlot = &pClient->slots[pCandidate->slot];
+        const ReplUnitState *pState = &pRepl->units[pCandidate->unit];
+        if (pCandidate->mask)
+        {
+            WriteUpdate(&writer, pCandidate->slot, &pSlot->baseline, pState, pCandidate->mask);
+            pClient->stats.updates++;
+        }
+        else
+        {
+            WriteCreate(&writer, pCandidate->slot, pState);
+            pSlot->state = SLOT_LIVE;
+            pClient->stats.creates++;
+        }
+        pSlot->baseline = *pState;
+        pSlot->priority = 0.0f;
+        pClient->stats.maxWaitTicks = std::max(pClient->stats.maxWaitTicks, frame - pSlot->waitingSince);
+        pSlot->waitingSince = NONE;
+    }
+    WriteBits(&writer, OP_END, OP_BITS);
+
+    DWORD payload = (writer.bits + 7) >> 3;
+    pOut[0] = REPL_FRAME_OPCODE;
+    pOut[1] = (BYTE)payload;
+    pOut[2] = (BYTE)(payload >> 8);
+
+    DWORD visible = 0;
+    for (DWORD s = 0; s < REPL_MAX_SLOTS; s++)
+    {
+        visible += pClient->slots[s].state == SLOT_LIVE;
+    }
+    pClient->stats.visible = visible;
+    pClient->stats.frames++;
+    pClient->stats.bytes += REPL_FRAME_HEADER + payload;
+    return REPL_FRAME_HEADER + payload;
+}
+
+void __cdecl REPL_GetClientStats(const Replicator *pRepl, int client, ReplClientStats *pStats)
+{
+    if (client < 0 || client >= (int)pRepl->clients.size())
+    {
+        memset(pStats, 0, sizeof(*pStats));
+        return;
+    }
+    *pStats = pRepl->clients[client].stats;
+}
+
+// =============================================================================
+// CLIENT
+// =============================================================================
+
+struct ReplClient
+{
+    BYTE live[REPL_MAX_SLOTS];
+    ReplUnitState units[REPL_MAX_SLOTS];
+    DWORD count;
+};
+
+ReplClient *__cdecl REPL_CreateClient(void)
+{
+    ReplClient *pClient = new ReplClient();
+    memset(pClient->live, 0, sizeof(pClient->live));
+    pClient->count = 0;
+    return pClient;
+}
+
+void __cdecl REPL_DestroyClient(ReplClient *pClient)
+{
+    delete pClient;
+}
+
+static WORD ReadCoord(BitReader *pReader, WORD from)
+{
+    if (ReadBits(pReader, 1))
+    {
+        DWORD raw = ReadBits(pReader, DELTA_BITS);
+        int delta = (raw & (1u << (DELTA_BITS - 1))) ? (int)raw - (1 << DELTA_BITS) : (int)raw;
+        return (WORD)(from + delta);
+    }
+    return (WORD)ReadBits(pReader, 16);
+}
+
+BOOL __cdecl REPL_ApplyFrame(ReplClient *pClient, const BYTE *pFrame, DWORD size)
+{
+    if (size < REPL_FRAME_HEADER || pFrame[0] != REPL_FRAME_OPCODE)
+    {
+        return FALSE;
+    }
+    DWORD payload = pFrame[1] | ((DWORD)pFrame[2] << 8);
+    if (payload != size - REPL_FRAME_HEADER)
+    {
+        return FALSE;
+    }
+
+    BitReader reader;
+    reader.pData = pFrame + REPL_FRAME_HEADER;
+    reader.bits = 0;
+    reader.totalBits = payload * 8;
+    reader.overrun = FALSE;
+
+    for (;;)
+    {
+        DWORD op = ReadBits(&reader, OP_BITS);
+        if (reader.overrun)
+        {
+            return FALSE;
+        }
+        if (op == OP_END)
+        {
+            return TRUE;
+        }
+
+        DWORD slot = ReadBits(&reader, REPL_SLOT_BITS);
+        ReplUnitState *pUnit = &pClient->units[slot];
+        if (op == OP_REMOVE)
+        {
+            if (!pClient->live[slot])
+            {
+                return FALSE;
+            }
+            pClient->live[slot] = 0;
+            pClient->count--;
+        }
+        else if (op == OP_CREATE)
+        {
+            if (pClient->live[slot])
+            {
+                return FALSE;
+            }
+            pUnit->guid = ReadBits(&reader, 32);
+            pUnit->type = (BYTE)ReadBits(&reader, 3);
+            pUnit->classId = (WORD)ReadBits(&reader, 16);
+            pUnit->x = (WORD)ReadBits(&reader, 16);
+            pUnit->y = (WORD)ReadBits(&reader, 16);
+            pUnit->mode = (BYTE)ReadBits(&reader, 5);
+            pUnit->life = (BYTE)ReadBits(&reader, 8);
+            pUnit->direction = (BYTE)ReadBits(&reader, 6);
+            pUnit->flags = (WORD)ReadBits(&reader, 16);
+            pClient->live[slot] = 1;
+            pClient->count++;
+        }
+        else
+        {
+            if (!pClient->live[slot])
+            {
+                return FALSE;
+            }
+            DWORD mask = ReadBits(&reader, REPL_FIELD_COUNT);
+            if (mask & REPL_FIELD_X)
+            {
+                pUnit->x = ReadCoord(&reader, pUnit->x);
+            }
+            if (mask & REPL_FIELD_Y)
+            {
+                pUnit->y = ReadCoord(&reader, pUnit->y);
+            }
+            if (mask & REPL_FIELD_MODE)
+            {
+                pUnit->mode = (BYTE)ReadBits(&reader, 5);
+            }
+            if (mask & REPL_FIELD_LIFE)
+            {
+                pUnit->life = (BYTE)ReadBits(&reader, 8);
+            }
+            if (mask & REPL_FIELD_DIR)
+            {
+                pUnit->direction = (BYTE)ReadBits(&reader, 6);
+            }
+            if (mask & REPL_FIELD_FLAGS)
+            {
+                pUnit->flags = (WORD)ReadBits(&reader, 16);
+            }
+        }
+    }
+}
+
+DWORD __cdecl REPL_GetClientUnitCount(const ReplClient *pClient)
+{
+    return pClient->count;
+}
+
+BOOL __cdecl REPL_FindClientUnit(const ReplClient *pClient, DWORD guid, ReplUnitState *pState)
+{
+    for (DWORD s = 0; s < REPL_MAX_SLOTS; s++)
+    {
+        if (pClient->live[s] && pClient->units[s].guid == guid)
+        {
+            if (pState)
+            {
+                *pState = pClient->units[s];
+            }
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
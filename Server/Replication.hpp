@@ -0,0 +1,125 @@
+/*
+ * Replication.hpp - D2Server delta-compressed unit replication
+ *
+ * The game sends every client in range a separate packet per unit update
+ * (walk, mode, life, ...), each carrying the unit's full fields whether they
+ * changed or not, through D2Net's 516-byte packets. In a crowded screen
+ * that is hundreds of packets per tick per player.
+ *
+ * The replicator keeps, per client, the last state it sent of every unit
+ * the client can see (the baseline) and builds one frame per client per
+ * tick:
+ *   - interest: units within the client's view radius are relevant; a unit
+ *     entering it is created on the client, one leaving it (past a little
+ *     hysteresis) or despawning is removed;
+ *   - deltas: an update carries a change mask and only the changed fields,
+ *     bit-packed; small position steps are sent as 7-bit deltas;
+ *   - priority: pending creates and updates accumulate priority every tick
+ *     by relevance (the client's own unit, players, monsters, missiles,
+ *     objects) and nearness, and the frame takes the most urgent ones that
+ *     fit the client's per-tick byte budget. Deferred units keep climbing,
+ *     so nothing starves;
+ *   - units are named by a client-local 10-bit slot instead of the GUID,
+ *     assigned on create.
+ *
+ * The game's transport is TCP, so frames arrive complete and in order and
+ * the baseline is simply what was last sent; there are no acks. A frame is
+ * a 3-byte header (opcode, payload length) followed by the bit stream, and
+ * still fits one D2Net packet: budgets are capped at REPL_MAX_FRAME.
+ *
+ * The client side (ReplClient) applies frames to its own slot table. Both
+ * sides are single-threaded: call them from the game's (or client's) tick.
+ */
+
+#ifndef REPLICATION_HPP
+#define REPLICATION_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+#define REPL_FRAME_OPCODE 0xF0
+#define REPL_FRAME_HEADER 3
+#define REPL_MAX_FRAME 516 // D2Net packet limit
+#define REPL_SLOT_BITS 10
+#define REPL_MAX_SLOTS (1u << REPL_SLOT_BITS) // Units one client can see at once
+
+// D2 unit types
+#define REPL_UNIT_PLAYER 0
+#define REPL_UNIT_MONSTER 1
+#define REPL_UNIT_OBJECT 2
+#define REPL_UNIT_MISSILE 3
+#define REPL_UNIT_ITEM 4
+#define REPL_UNIT_TILE 5
+
+// Replicated fields (change mask bits)
+#define REPL_FIELD_X 0x01
+#define REPL_FIELD_Y 0x02
+#define REPL_FIELD_MODE 0x04
+#define REPL_FIELD_LIFE 0x08
+#define REPL_FIELD_DIR 0x10
+#define REPL_FIELD_FLAGS 0x20
+#define REPL_FIELD_COUNT 6
+
+typedef struct ReplUnitState
+{
+    DWORD guid;
+    BYTE type;    // REPL_UNIT_*
+    BYTE mode;    // 5 bits
+    WORD classId; // Fixed for the unit's life
+    WORD x;       // Subtiles
+    WORD y;
+    BYTE life;      // 0-128, as the game's life packets
+    BYTE direction; // 6 bits
+    WORD flags;
+} ReplUnitState;
+
+typedef struct ReplDesc
+{
+    DWORD maxUnits;      // 0 = 4096
+    DWORD maxClients;    // 0 = 8
+    DWORD viewRadius;    // Subtiles (0 = 48, about a screen)
+    DWORD bytesPerFrame; // Default per-client budget, header included (0 = REPL_MAX_FRAME)
+} ReplDesc;
+
+typedef struct ReplClientStats
+{
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t creates;
+    uint64_t updates;
+    uint64_t removes;
+    uint64_t deferred;  // Pending records left for a later frame by the budget
+    DWORD maxWaitTicks; // Longest a pending record waited before it was sent
+    DWORD visible;      // Units the client holds now
+} ReplClientStats;
+
+typedef struct Replicator Replicator;
+typedef struct ReplClient ReplClient;
+
+Replicator *__cdecl REPL_Create(const ReplDesc *pDesc);
+void __cdecl REPL_Destroy(Replicator *pRepl);
+
+// Authoritative state; inserts the unit on first sight. FALSE when full.
+BOOL __cdecl REPL_SetUnit(Replicator *pRepl, const ReplUnitState *pState);
+BOOL __cdecl REPL_RemoveUnit(Replicator *pRepl, DWORD guid);
+
+// Client index, or -1 when full. The client starts with nothing visible.
+int __cdecl REPL_AddClient(Replicator *pRepl, DWORD controlledGuid);
+void __cdecl REPL_RemoveClient(Replicator *pRepl, int client);
+// 0 = the replicator's default; capped at REPL_MAX_FRAME
+void __cdecl REPL_SetClientBudget(Replicator *pRepl, int client, DWORD bytesPerFrame);
+
+// One frame for one client; returns its size (0 if capacity is too small).
+// Call once per client per tick, after the tick's REPL_SetUnit calls.
+DWORD __cdecl REPL_BuildFrame(Replicator *pRepl, int client, BYTE *pOut, DWORD capacity);
+void __cdecl REPL_GetClientStats(const Replicator *pRepl, int client, ReplClientStats *pStats);
+
+// Client side
+ReplClient *__cdecl REPL_CreateClient(void);
+void __cdecl REPL_DestroyClient(ReplClient *pClient);
+// FALSE on a malformed frame (the slot table is left as far as it got)
+BOOL __cdecl REPL_ApplyFrame(ReplClient *pClient, const BYTE *pFrame, DWORD size);
+DWORD __cdecl REPL_GetClientUnitCount(const ReplClient *pClient);
+// Linear over the slots; meant for tools and checks
+BOOL __cdecl REPL_FindClientUnit(const ReplClient *pClient, DWORD guid, ReplUnitState *pState);
+
+#endif // REPLICATION_HPP
@@ -0,0 +1,781 @@
+/*
+ * SaveService.cpp - D2Server asynchronous character saves
+ *
+ * See SaveService.hpp. A slot's pLast blocks belong to the thread that
+ * captures it; everything else in a slot, and the stats, is guarded by the
+ * service mutex. Blocks are immutable once built and freed by whichever
+ * side drops the last reference.
+ */
+
+#include "SaveService.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define DEFAULT_MAX_SLOTS 1024
+#define DEFAULT_MAX_ITEMS 2048
+#define DEFAULT_AUTOSAVE_DELAY_MS 2000
+#define DEFAULT_RETRY_DELAY_MS 1000
+#define DEFAULT_MAX_RETRIES 3
+#define INITIAL_FILE_BYTES (256 * 1024)
+#define MAX_FILE_BYTES (16 * 1024 * 1024)
+
+// Slot id layout: low 16 bits = index, high 16 bits = generation
+#define SLOT_INDEX_BITS 16
+#define SLOT_INDEX_MASK ((1u << SLOT_INDEX_BITS) - 1)
+#define SLOT_GENERATION_LIMIT 0xFFFE
+
+// Directory, '/', name, ".d2s.tmp"
+#define PATH_BYTES (SAVE_MAX_PATH + SAVE_MAX_NAME + 16)
+
+enum SaveSection
+{
+    SECTION_CORE,
+    SECTION_ITEMS,
+    SECTION_CORPSE,
+    SECTION_MERC,
+    SECTION_COUNT,
+};
+
+// Immutable once built; packed items follow the header
+typedef struct SaveBlock
+{
+    std::atomic<int> refs;
+    size_t size; // Of the whole block
+    DWORD itemCount;
+    BYTE flag; // hasCorpse / hasGolem
+    BYTE extra[D2S_CORPSE_DATA];
+} SaveBlock;
+
+#define BLOCK_DATA(pBlock) ((BYTE *)(pBlock) + sizeof(SaveBlock))
+#define CORE_BYTES offsetof(D2Character, items)
+#define ITEM_FIXED_BYTES offsetof(D2Item, stats)
+
+typedef struct Snapshot
+{
+    SaveBlock *pBlocks[SECTION_COUNT];
+    int64_t dueMs;
+    DWORD attempts;
+} Snapshot;
+
+typedef struct SaveSlot
+{
+    // Owned by the capturing thread
+    SaveBlock *pLast[SECTION_COUNT];
+
+    // Guarded by the service mutex
+    DWORD generation;
+    BOOL open;
+    BOOL closing;
+    BOOL writing;
+    BOOL hasPending;
+    Snapshot pending;
+    char szName[SAVE_MAX_NAME]; // Not changed while writing
+} SaveSlot;
+
+struct SaveService
+{
+    const ItemCodec *pCodec;
+    char szDirectory[SAVE_MAX_PATH];
+    DWORD maxItems;
+    DWORD autosaveDelayMs;
+    DWORD retryDelayMs;
+    DWORD maxRetries;
+
+    std::vector<SaveSlot> slots;
+
+    std::mutex mutex;
+    std::condition_variable wake; // I/O thread: new work or stop
+    std::condition_variable done; // Flush: a write finished
+    DWORD flushing;
+    BOOL stopping;
+    DWORD writing;
+    uint64_t failedAtFlush;
+    SaveStats stats;
+    std::thread thread;
+
+    // I/O thread only
+    D2Character scratch;
+    std::vector<D2Item> items;
+    std::vector<D2Item> corpseItems;
+    std::vector<D2Item> mercItems;
+    std::vector<BYTE> file;
+    std::vector<BYTE> readBack;
+};
+
+static int64_t NowMs(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// =============================================================================
+// BLOCKS
+// =============================================================================
+
+static void ReleaseBlock(SaveBlock *pBlock)
+{
+    if (pBlock && pBlock->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        pBlock->~SaveBlock();
+        free(pBlock);
+    }
+}
+
+static void ReleaseSnapshot(Snapshot *pSnapshot)
+{
+    for (DWORD s = 0; s < SECTION_COUNT; s++)
+    {
+        ReleaseBlock(pSnapshot->pBlocks[s]);
+        pSnapshot->pBlocks[s] = NULL;
+    }
+}
+
+static SaveBlock *NewBlock(size_t dataBytes)
+{
+    void *pMemory = malloc(sizeof(SaveBlock) + dataBytes);
+    if (!pMemory)
+    {
+        return NULL;
+    }
+    SaveBlock *pBlock = new (pMemory) SaveBlock;
+    pBlock->refs.store(1, std::memory_order_relaxed);
+    pBlock->size = sizeof(SaveBlock) + dataBytes;
+    pBlock->itemCount = 0;
+    pBlock->flag = 0;
+    memset(pBlock->extra, 0, sizeof(pBlock->extra));
+    return pBlock;
+}
+
+// Items are stored without their unused stat slots
+static size_t PackedBytes(const D2Item *pItems, DWORD count)
+{
+    size_t bytes = 0;
+    for (DWORD i = 0; i < count; i++)
+    {
+        bytes += ITEM_FIXED_BYTES + pItems[i].statCount * sizeof(ItemStat);
+    }
+    return bytes;
+}
+
+static BYTE *PackItems(BYTE *pOut, const D2Item *pItems, DWORD count)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        size_t bytes = ITEM_FIXED_BYTES + pItems[i].statCount * sizeof(ItemStat);
+        memcpy(pOut, &pItems[i], bytes);
+        pOut += bytes;
+    }
+    return pOut;
+}
+
+static const BYTE *UnpackItems(const BYTE *pIn, D2Item *pItems, DWORD count)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        memcpy(&pItems[i], pIn, ITEM_FIXED_BYTES);
+        pIn += ITEM_FIXED_BYTES;
+        memcpy(pItems[i].stats, pIn, pItems[i].statCount * sizeof(ItemStat));
+        pIn += pItems[i].statCount * sizeof(ItemStat);
+    }
+    return pIn;
+}
+
+static SaveBlock *BuildSection(DWORD section, const D2Character *pChar)
+{
+    SaveBlock *pBlock = NULL;
+    switch (section)
+    {
+    case SECTION_CORE:
+        pBlock = NewBlock(CORE_BYTES);
+        if (pBlock)
+        {
+            memcpy(BLOCK_DATA(pBlock), pChar, CORE_BYTES);
+        }
+        break;
+    case SECTION_ITEMS:
+        pBlock = NewBlock(PackedBytes(pChar->items.pItems, pChar->items.count));
+        if (pBlock)
+        {
+            pBlock->itemCount = pChar->items.count;
+            PackItems(BLOCK_DATA(pBlock), pChar->items.pItems, pChar->items.count);
+        }
+        break;
+    case SECTION_CORPSE:
+    {
+        DWORD count = pChar->hasCorpse ? pChar->corpseItems.count : 0;
+        pBlock = NewBlock(PackedBytes(pChar->corpseItems.pItems, count));
+        if (pBlock)
+        {
+            pBlock->itemCount = count;
+            pBlock->flag = pChar->hasCorpse ? 1 : 0;
+            memcpy(pBlock->extra, pChar->corpseData, D2S_CORPSE_DATA);
+            PackItems(BLOCK_DATA(pBlock), pChar->corpseItems.pItems, count);
+        }
+        break;
+    }
+    case SECTION_MERC:
+    {
+        // Merc items, then the golem as one more item
+        DWORD count = pChar->mercItems.count;
+        size_t bytes = PackedBytes(pChar->mercItems.pItems, count);
+        pBlock = NewBlock(bytes + (pChar->hasGolem ? PackedBytes(&pChar->golem, 1) : 0));
+        if (pBlock)
+        {
+            pBlock->itemCount = count;
+            pBlock->flag = pChar->hasGolem ? 1 : 0;
+            BYTE *pOut = PackItems(BLOCK_DATA(pBlock), pChar->mercItems.pItems, count);
+            if (pChar->hasGolem)
+            {
+                PackItems(pOut, &pChar->golem, 1);
+            }
+        }
+        break;
+    }
+    }
+    return pBlock;
+}
+
+// =============================================================================
+// I/O THREAD
+// =============================================================================
+
+static void MakePath(const SaveService *pService, const char *szName, const char *szSuffix, char *szPath)
+{
+    snprintf(szPath, PATH_BYTES, "%s/%s.d2s%s", pService->szDirectory, szName, szSuffix);
+}
+
+// Write, flush to disk, read back and compare
+static BOOL WriteDurably(SaveService *pService, const char *szPath, const BYTE *pData, size_t size)
+{
+    FILE *pFile = fopen(szPath, "wb");
+    if (!pFile)
+    {
+        return FALSE;
+    }
+    BOOL ok = fwrite(pData, 1, size, pFile) == size && fflush(pFile) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(pFile)) == 0;
+#else
+    ok = ok && fsync(fileno(pFile)) == 0;
+#endif
+    if (fclose(pFile) != 0 || !ok)
+    {
+        return FALSE;
+    }
+
+    pFile = fopen(szPath, "rb");
+    if (!pFile)
+    {
+        return FALSE;
+    }
+    pService->readBack.resize(size + 1);
+    size_t read = fread(&pService->readBack[0], 1, size + 1, pFile);
+    fclose(pFile);
+    return read == size && memcmp(&pService->readBack[0], pData, size) == 0;
+}
+
+static BOOL ReplaceFile(const SaveService *pService, const char *szTemp, const char *szPath)
+{
+#ifdef _WIN32
+    (void)pService;
+    return MoveFileExA(szTemp, szPath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(szTemp, szPath) != 0)
+    {
+        return FALSE;
+    }
+    // Make the rename itself durable
+    int fd = open(pService->szDirectory, O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+    return TRUE;
+#endif
+}
+
+static BOOL WriteSnapshot(SaveService *pService, const char *szName, const Snapshot *pSnapshot, size_t *pBytes)
+{
+    D2Character *pChar = &pService->scratch;
+    const SaveBlock *pCore = pSnapshot->pBlocks[SECTION_CORE];
+    const SaveBlock *pItems = pSnapshot->pBlocks[SECTION_ITEMS];
+    const SaveBlock *pCorpse = pSnapshot->pBlocks[SECTION_CORPSE];
+    const SaveBlock *pMerc = pSnapshot->pBlocks[SECTION_MERC];
+
+    memcpy(pChar, BLOCK_DATA(pCore), CORE_BYTES);
+    pChar->items.count = pItems->itemCount;
+    UnpackItems(BLOCK_DATA(pItems), pChar->items.pItems, pItems->itemCount);
+    pChar->hasCorpse = pCorpse->flag;
+    memcpy(pChar->corpseData, pCorpse->extra, D2S_CORPSE_DATA);
+    pChar->corpseItems.count = pCorpse->itemCount;
+    UnpackItems(BLOCK_DATA(pCorpse), pChar->corpseItems.pItems, pCorpse->itemCount);
+    pChar->mercItems.count = pMerc->itemCount;
+    const BYTE *pGolem = UnpackItems(BLOCK_DATA(pMerc), pChar->mercItems.pItems, pMerc->itemCount);
+    pChar->hasGolem = pMerc->flag;
+    if (pChar->hasGolem)
+    {
+        UnpackItems(pGolem, &pChar->golem, 1);
+    }
+
+    // Encode, growing the buffer for very large characters
+    size_t size = 0;
+    while (!D2S_Encode(pService->pCodec, pChar, &pService->file[0], pService->file.size(), &size))
+    {
+        if (pService->file.size() >= MAX_FILE_BYTES)
+        {
+            return FALSE;
+        }
+        pService->file.resize(pService->file.size() * 2);
+    }
+    // Never replace a good save with one that will not load
+    if (!D2S_Validate(pService->pCodec, &pService->file[0], size, NULL))
+    {
+        return FALSE;
+    }
+
+    char szTemp[PATH_BYTES], szPath[PATH_BYTES];
+    MakePath(pService, szName, ".tmp", szTemp);
+    MakePath(pService, szName, "", szPath);
+    if (!WriteDurably(pService, szTemp, &pService->file[0], size) || !ReplaceFile(pService, szTemp, szPath))
+    {
+        remove(szTemp);
+        return FALSE;
+    }
+    *pBytes = size;
+    return TRUE;
+}
+
+static void FreeSlotLocked(SaveSlot *pSlot)
+{
+    pSlot->open = FALSE;
+    pSlot->closing = FALSE;
+    pSlot->szName[0] = 0;
+    if (++pSlot->generation > SLOT_GENERATION_LIMIT)
+    {
+        pSlot->generation = 0;
+    }
+}
+
+static void IoThread(SaveService *pService)
+{
+    std::unique_lock<std::mutex> lock(pService->mutex);
+    for (;;)
+    {
+        // Earliest due snapshot; everything is due while flushing or stopping
+        int64_t now = NowMs();
+        BOOL urgent = pService->flushing || pService->stopping;
+        SaveSlot *pNext = NULL;
+        int64_t earliest = INT64_MAX;
+        for (size_t i = 0; i < pService->slots.size(); i++)
+        {
+            SaveSlot *pSlot = &pService->slots[i];
+            if (pSlot->hasPending && pSlot->pending.dueMs < earliest)
+            {
+                earliest = pSlot->pending.dueMs;
+                pNext = pSlot;
+            }
+        }
+        if (!pNext || (!urgent && earliest > now))
+        {
+            if (pService->stopping && !pNext)
+            {
+                return;
+            }
+            if (pNext)
+            {
+                pService->wake.wait_for(lock, std::chrono::milliseconds(earliest - now));
+            }
+            else
+            {
+                pService->wake.wait(lock);
+            }
+            continue;
+        }
+
+        Snapshot snapshot = pNext->pending;
+        pNext->hasPending = FALSE;
+        pNext->writing = TRUE;
+        pService->stats.pending--;
+        pService->writing++;
+        lock.unlock();
+
+        size_t bytes = 0;
+        BOOL ok = WriteSnapshot(pService, pNext->szName, &snapshot, &bytes);
+
+        lock.lock();
+        pNext->writing = FALSE;
+        pService->writing--;
+        if (ok)
+        {
+            pService->stats.written++;
+            pService->stats.bytesWritten += bytes;
+            ReleaseSnapshot(&snapshot);
+        }
+        else if (pNext->hasPending)
+        {
+            // A newer snapshot replaces the one that failed
+            ReleaseSnapshot(&snapshot);
+        }
+        else if (++snapshot.attempts < pService->maxRetries)
+        {
+            pService->stats.retries++;
+            snapshot.dueMs = NowMs() + pService->retryDelayMs;
+            pNext->pending = snapshot;
+            pNext->hasPending = TRUE;
+            pService->stats.pending++;
+        }
+        else
+        {
+            pService->stats.failed++;
+            ReleaseSnapshot(&snapshot);
+        }
+        if (pNext->closing && !pNext->hasPending)
+        {
+            FreeSlotLocked(pNext);
+            pService->stats.openSlots--;
+        }
+        pService->done.notify_all();
+    }
+}
+
+// =============================================================================
+// API
+// =============================================================================
+
+static BOOL CreateDirectoryPath(const char *szDirectory)
+{
+#ifdef _WIN32
+    return CreateDirectoryA(szDirectory, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    return mkdir(szDirectory, 0755) == 0 || (stat(szDirectory, &st) == 0 && S_ISDIR(st.st_mode));
+#endif
+}
+
+SaveService *__cdecl SAVE_Create(const SaveServiceDesc *pDesc)
+{
+    if (!pDesc || !pDesc->pCodec || !pDesc->szDirectory || strlen(pDesc->szDirectory) >= SAVE_MAX_PATH ||
+        !CreateDirectoryPath(pDesc->szDirectory))
+    {
+        return NULL;
+    }
+    DWORD maxSlots = pDesc->maxSlots ? pDesc->maxSlots : DEFAULT_MAX_SLOTS;
+    if (maxSlots > SLOT_INDEX_MASK)
+    {
+        return NULL;
+    }
+
+    SaveService *pService = new SaveService;
+    pService->pCodec = pDesc->pCodec;
+    strcpy(pService->szDirectory, pDesc->szDirectory);
+    pService->maxItems = pDesc->maxItems ? pDesc->maxItems : DEFAULT_MAX_ITEMS;
+    pService->autosaveDelayMs = pDesc->autosaveDelayMs ? pDesc->autosaveDelayMs : DEFAULT_AUTOSAVE_DELAY_MS;
+    pService->retryDelayMs = pDesc->retryDelayMs ? pDesc->retryDelayMs : DEFAULT_RETRY_DELAY_MS;
+    pService->maxRetries = pDesc->maxRetries ? pDesc->maxRetries : DEFAULT_MAX_RETRIES;
+    pService->slots.resize(maxSlots);
+    memset(&pService->slots[0], 0, maxSlots * sizeof(SaveSlot));
+    pService->flushing = 0;
+    pService->stopping = FALSE;
+    pService->writing = 0;
+    pService->failedAtFlush = 0;
+    memset(&pService->stats, 0, sizeof(pService->stats));
+
+    memset(&pService->scratch, 0, sizeof(pService->scratch));
+    pService->items.resize(pService->maxItems);
+    pService->corpseItems.resize(pService->maxItems);
+    pService->mercItems.resize(pService->maxItems);
+    pService->scratch.items.pItems = &pService->items[0];
+    pService->scratch.items.capacity = pService->maxItems;
+    pService->scratch.corpseItems.pItems = &pService->corpseItems[0];
+    pService->scratch.corpseItems.capacity = pService->maxItems;
+    pService->scratch.mercItems.pItems = &pService->mercItems[0];
+    pService->scratch.mercItems.capacity = pService->maxItems;
+    pService->file.resize(INITIAL_FILE_BYTES);
+
+    pService->thread = std::thread(IoThread, pService);
+    return pService;
+}
+
+void __cdecl SAVE_Destroy(SaveService *pService)
+{
+    if (!pService)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pService->mutex);
+        pService->stopping = TRUE;
+    }
+    pService->wake.notify_one();
+    pService->thread.join();
+
+    for (size_t i = 0; i < pService->slots.size(); i++)
+    {
+        SaveSlot *pSlot = &pService->slots[i];
+        for (DWORD s = 0; s < SECTION_COUNT; s++)
+        {
+            ReleaseBlock(pSlot->pLast[s]);
+        }
+    }
+    delete pService;
+}
+
+static BOOL IsValidName(const char *szName)
+{
+    size_t length = szName ? strlen(szName) : 0;
+    if (length < 2 || length >= SAVE_MAX_NAME)
+    {
+        return FALSE;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = szName[i];
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_'))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static SaveSlot *LookupSlot(SaveService *pService, DWORD slot)
+{
+    DWORD index = slot & SLOT_INDEX_MASK;
+    if (index >= pService->slots.size())
+    {
+        return NULL;
+    }
+    SaveSlot *pSlot = &pService->slots[index];
+    return (pSlot->open && !pSlot->closing && pSlot->generation == slot >> SLOT_INDEX_BITS) ? pSlot : NULL;
+}
+
+DWORD __cdecl SAVE_Open(SaveService *pService, const char *szName)
+{
+    if (!IsValidName(szName))
+    {
+        return SAVE_INVALID_SLOT;
+    }
+
+    std::lock_guard<std::mutex> lock(pService->mutex);
+    SaveSlot *pFree = NULL;
+    for (size_t i = 0; i < pService->slots.size(); i++)
+    {
+        SaveSlot *pSlot = &pService->slots[i];
+        if (pSlot->open && strcmp(pSlot->szName, szName) == 0)
+        {
+            if (!pSlot->closing)
+            {
+                return SAVE_INVALID_SLOT;
+            }
+            // Rejoined before the last save was written: that write still goes ahead
+            pSlot->closing = FALSE;
+            if (++pSlot->generation > SLOT_GENERATION_LIMIT)
+            {
+                pSlot->generation = 0;
+            }
+            return (pSlot->generation << SLOT_INDEX_BITS) | (DWORD)i;
+        }
+        if (!pSlot->open && !pFree)
+        {
+            pFree = pSlot;
+        }
+    }
+    if (!pFree)
+    {
+        return SAVE_INVALID_SLOT;
+    }
+
+    // A temp file left by a crash is never the newest good save
+    char szTemp[PATH_BYTES];
+    MakePath(pService, szName, ".tmp", szTemp);
+    remove(szTemp);
+
+    pFree->open = TRUE;
+    strcpy(pFree->szName, szName);
+    pService->stats.openSlots++;
+    return (pFree->generation << SLOT_INDEX_BITS) | (DWORD)(pFree - &pService->slots[0]);
+}
+
+void __cdecl SAVE_Close(SaveService *pService, DWORD slot)
+{
+    SaveBlock *pLast[SECTION_COUNT];
+    {
+        std::lock_guard<std::mutex> lock(pService->mutex);
+        SaveSlot *pSlot = LookupSlot(pService, slot);
+        if (!pSlot)
+        {
+            return;
+        }
+        memcpy(pLast, pSlot->pLast, sizeof(pLast));
+        memset(pSlot->pLast, 0, sizeof(pSlot->pLast));
+        if (pSlot->hasPending || pSlot->writing)
+        {
+            pSlot->closing = TRUE;
+        }
+        else
+        {
+            FreeSlotLocked(pSlot);
+            pService->stats.openSlots--;
+        }
+    }
+    for (DWORD s = 0; s < SECTION_COUNT; s++)
+    {
+        ReleaseBlock(pLast[s]);
+    }
+}
+
+BOOL __cdecl SAVE_Capture(SaveService *pService, DWORD slot, const D2Character *pChar, DWORD dirty, SaveKind kind)
+{
+    DWORD index = slot & SLOT_INDEX_MASK;
+    if (!pChar || index >= pService->slots.size() || pChar->items.count > pService->maxItems ||
+        pChar->corpseItems.count > pService->maxItems || pChar->mercItems.count > pService->maxItems)
+    {
+        return FALSE;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pService->mutex);
+        if (!LookupSlot(pService, slot))
+        {
+            return FALSE;
+        }
+    }
+    SaveSlot *pSlot = &pService->slots[index];
+
+    // Copy the dirty sections outside the lock; clean ones are shared
+    Snapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    DWORD copied = 0;
+    uint64_t bytes = 0;
+    for (DWORD s = 0; s < SECTION_COUNT; s++)
+    {
+        if (!(dirty & (1u << s)) && pSlot->pLast[s])
+        {
+            snapshot.pBlocks[s] = pSlot->pLast[s];
+            snapshot.pBlocks[s]->refs.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        SaveBlock *pBlock = BuildSection(s, pChar);
+        if (!pBlock)
+        {
+            ReleaseSnapshot(&snapshot);
+            return FALSE;
+        }
+        snapshot.pBlocks[s] = pBlock;
+        copied++;
+        bytes += pBlock->size;
+    }
+    for (DWORD s = 0; s < SECTION_COUNT; s++)
+    {
+        if (snapshot.pBlocks[s] != pSlot->pLast[s])
+        {
+            ReleaseBlock(pSlot->pLast[s]);
+            pSlot->pLast[s] = snapshot.pBlocks[s];
+            pSlot->pLast[s]->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot replaced;
+    BOOL coalesced = FALSE;
+    {
+        std::lock_guard<std::mutex> lock(pService->mutex);
+        int64_t now = NowMs();
+        snapshot.dueMs = (kind == SAVE_IMMEDIATE) ? now : now + pService->autosaveDelayMs;
+        if (pSlot->hasPending)
+        {
+            // An autosave does not push back a write that is already due sooner
+            replaced = pSlot->pending;
+            coalesced = TRUE;
+            if (replaced.dueMs < snapshot.dueMs)
+            {
+                snapshot.dueMs = replaced.dueMs;
+            }
+            pService->stats.coalesced++;
+        }
+        else
+        {
+            pService->stats.pending++;
+        }
+        pSlot->pending = snapshot;
+        pSlot->hasPending = TRUE;
+        pService->stats.captures++;
+        pService->stats.sectionsCopied += copied;
+        pService->stats.sectionsShared += SECTION_COUNT - copied;
+        pService->stats.bytesCopied += bytes;
+    }
+    if (coalesced)
+    {
+        ReleaseSnapshot(&replaced);
+    }
+    pService->wake.notify_one();
+    return TRUE;
+}
+
+BOOL __cdecl SAVE_Flush(SaveService *pService)
+{
+    std::unique_lock<std::mutex> lock(pService->mutex);
+    pService->flushing++;
+    pService->wake.notify_one();
+    while (pService->stats.pending || pService->writing)
+    {
+        pService->done.wait(lock);
+    }
+    pService->flushing--;
+    BOOL ok = pService->stats.failed == pService->failedAtFlush;
+    pService->failedAtFlush = pService->stats.failed;
+    return ok;
+}
+
+BOOL __cdecl SAVE_Load(SaveService *pService, const char *szName, BYTE *pBuffer, size_t capacity, size_t *pSize)
+{
+    if (!IsValidName(szName))
+    {
+        return FALSE;
+    }
+    char szPath[PATH_BYTES];
+    MakePath(pService, szName, "", szPath);
+    FILE *pFile = fopen(szPath, "rb");
+    if (!pFile)
+    {
+        return FALSE;
+    }
+    size_t size = fread(pBuffer, 1, capacity, pFile);
+    BOOL whole = fgetc(pFile) == EOF;
+    fclose(pFile);
+    if (!whole || !D2S_Validate(pService->pCodec, pBuffer, size, NULL))
+    {
+        return FALSE;
+    }
+    if (pSize)
+    {
+        *pSize = size;
+    }
+    return TRUE;
+}
+
+void __cdecl SAVE_GetStats(SaveService *pService, SaveStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(pService->mutex);
+    *pStats = pService->stats;
+}
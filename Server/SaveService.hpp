@@ -0,0 +1,109 @@
+/*
+ * SaveService.hpp - D2Server asynchronous character saves
+ *
+ * D2Game saves a character on the game thread: when the player leaves, and
+ * on every autosave, it serializes the whole character and writes the .d2s
+ * straight over the old file. Every player in the game waits for the disk,
+ * a crash mid-write leaves a truncated save, and nothing in the shutdown
+ * path waits for saves that are still in flight.
+ *
+ * The service splits a save in two:
+ *   - SAVE_Capture (game thread) snapshots the character. The snapshot is
+ *     four sections (core: header, attributes and skills; player items;
+ *     corpse; mercenary and golem), each an immutable refcounted block. A
+ *     section the caller did not mark dirty is shared with the previous
+ *     snapshot, so an autosave after a gold pickup copies a few hundred
+ *     bytes instead of the whole inventory; items are packed without their
+ *     unused stat slots.
+ *   - An I/O thread encodes the snapshot (CharacterCodec) and validates
+ *     it, checksum included, writes <name>.d2s.tmp, flushes it to disk,
+ *     reads it back and compares, then renames it over <name>.d2s. The
+ *     previous save stays intact until the rename; a failed write is
+ *     retried.
+ *
+ * Each character has at most one pending snapshot: a newer capture replaces
+ * it. Autosaves wait autosaveDelayMs before writing, so a burst of them
+ * costs one write; an immediate save (leaving the game) is written next.
+ * SAVE_Flush writes everything pending and waits; SAVE_Destroy does the
+ * same before stopping the thread. A D2Game built on this exports
+ * SAVE_Flush as FlushPendingSaves, which game.exe calls before teardown.
+ *
+ * Threading: any thread may call any function. Captures and the close of
+ * one slot must come from one thread at a time (the game that owns the
+ * character).
+ */
+
+#ifndef SAVESERVICE_HPP
+#define SAVESERVICE_HPP
+
+#include "../Common/CharacterCodec.hpp"
+
+#define SAVE_INVALID_SLOT 0xFFFFFFFF
+#define SAVE_MAX_NAME 16 // Character names, NUL included
+#define SAVE_MAX_PATH 260
+
+// Sections of a capture; clean ones are shared with the previous snapshot
+#define SAVE_DIRTY_CORE 0x01   // Header, attributes, skills
+#define SAVE_DIRTY_ITEMS 0x02  // Player items
+#define SAVE_DIRTY_CORPSE 0x04 // Corpse and its items
+#define SAVE_DIRTY_MERC 0x08   // Mercenary items and iron golem
+#define SAVE_DIRTY_ALL 0x0F
+
+typedef enum SaveKind
+{
+    SAVE_AUTOSAVE,  // Written after autosaveDelayMs unless superseded
+    SAVE_IMMEDIATE, // Written next (leaving the game, trade, ...)
+} SaveKind;
+
+typedef struct SaveServiceDesc
+{
+    const ItemCodec *pCodec;
+    const char *szDirectory; // Created if missing
+    DWORD maxSlots;          // Characters open at once (0 = 1024)
+    DWORD maxItems;          // Per item list (0 = 2048)
+    DWORD autosaveDelayMs;   // 0 = 2000
+    DWORD retryDelayMs;      // After a failed write (0 = 1000)
+    DWORD maxRetries;        // Before a snapshot is dropped (0 = 3)
+} SaveServiceDesc;
+
+typedef struct SaveStats
+{
+    uint64_t captures;
+    uint64_t sectionsCopied;
+    uint64_t sectionsShared; // Clean sections reused from the previous snapshot
+    uint64_t bytesCopied;    // By captures, on the calling thread
+    uint64_t coalesced;      // Snapshots replaced before they were written
+    uint64_t written;
+    uint64_t bytesWritten;
+    uint64_t retries;
+    uint64_t failed; // Snapshots dropped after maxRetries
+    DWORD pending;
+    DWORD openSlots;
+} SaveStats;
+
+typedef struct SaveService SaveService;
+
+SaveService *__cdecl SAVE_Create(const SaveServiceDesc *pDesc);
+// Writes everything pending, then stops the I/O thread
+void __cdecl SAVE_Destroy(SaveService *pService);
+
+// szName: 2-15 letters, digits, '-' or '_'. SAVE_INVALID_SLOT when full, the
+// name is invalid or already open.
+DWORD __cdecl SAVE_Open(SaveService *pService, const char *szName);
+// A pending snapshot is still written; the slot is reused after that
+void __cdecl SAVE_Close(SaveService *pService, DWORD slot);
+
+// dirty: SAVE_DIRTY_* sections that changed since the last capture of this
+// slot (the first capture copies everything)
+BOOL __cdecl SAVE_Capture(SaveService *pService, DWORD slot, const D2Character *pChar, DWORD dirty, SaveKind kind);
+
+// Writes everything pending now and waits; FALSE if a snapshot was dropped
+// since the previous flush
+BOOL __cdecl SAVE_Flush(SaveService *pService);
+
+// Reads <name>.d2s into pBuffer and validates it
+BOOL __cdecl SAVE_Load(SaveService *pService, const char *szName, BYTE *pBuffer, size_t capacity, size_t *pSize);
+
+void __cdecl SAVE_GetStats(SaveService *pService, SaveStats *pStats);
+
+#endif // SAVESERVICE_HPP
@@ -0,0 +1,199 @@
+/*
+ * SimClients.cpp - D2Server simulated-client load generator
+ *
+ * See SimClients.hpp. Clients wait in a min-heap on their next send time;
+ * the generator sleeps until the earliest one is due.
+ */
+
+#include "SimClients.hpp"
+
+#include "../Common/Rng.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_ACTIONS_PER_SECOND 8
+#define SIM_CHAT_MAX 64
+
+typedef struct SimClient
+{
+    HostedGameId game;
+    DWORD clientId;
+    DWORD seq;
+    RngStream rng;
+} SimClient;
+
+typedef struct SendEntry
+{
+    int64_t dueNs;
+    DWORD client;
+} SendEntry;
+
+struct SimClients
+{
+    GameHost *pHost;
+    double meanIntervalNs;
+    std::vector<SimClient> clients;
+    std::vector<SendEntry> due; // Min-heap on dueNs
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping;
+    std::thread thread;
+    SimClientsStats stats;
+};
+
+static inline int64_t NowNs(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static bool LaterDue(const SendEntry &a, const SendEntry &b)
+{
+    return a.dueNs > b.dueNs;
+}
+
+// Exponential think time, so sends form a Poisson process per client
+static int64_t ThinkNs(SimClients *pClients, SimClient *pClient)
+{
+    double u = ((double)RNG_Next(&pClient->rng) + 1.0) / 4294967297.0;
+    return (int64_t)(-log(u) * pClients->meanIntervalNs) + 1;
+}
+
+static void SendOne(SimClients *pClients, SimClient *pClient)
+{
+    BYTE buffer[SIMCLIENT_MAX_PACKET];
+    SimClientPacket *pPacket = (SimClientPacket *)buffer;
+    DWORD roll = RNG_Range(&pClient->rng, 100);
+
+    memset(pPacket, 0, sizeof(SimClientPacket));
+    pPacket->clientId = pClient->clientId;
+    pPacket->seq = pClient->seq;
+    pPacket->x = (WORD)RNG_Range(&pClient->rng, 4096);
+    pPacket->y = (WORD)RNG_Range(&pClient->rng, 4096);
+    pPacket->size = sizeof(SimClientPacket);
+    if (roll < 70)
+    {
+        pPacket->opcode = SIMCLIENT_OP_WALK;
+    }
+    else if (roll < 95)
+    {
+        pPacket->opcode = SIMCLIENT_OP_CAST;
+        pPacket->arg = RNG_Range(&pClient->rng, 356);
+    }
+    else
+    {
+        DWORD length = 1 + RNG_Range(&pClient->rng, SIM_CHAT_MAX);
+        pPacket->opcode = SIMCLIENT_OP_CHAT;
+        pPacket->arg = length;
+        pPacket->size = (BYTE)(sizeof(SimClientPacket) + length);
+        for (DWORD i = 0; i < length; i++)
+        {
+            buffer[sizeof(SimClientPacket) + i] = (BYTE)('a' + RNG_Range(&pClient->rng, 26));
+        }
+    }
+
+    if (GAMEHOST_Post(pClients->pHost, pClient->game, pClient->clientId, buffer, pPacket->size))
+    {
+        pClient->seq++;
+        pClients->stats.sent++;
+        pClients->stats.bytes += pPacket->size;
+    }
+    else
+    {
+        pClients->stats.refused++;
+    }
+}
+
+static void GeneratorMain(SimClients *pClients)
+{
+    std::unique_lock<std::mutex> lock(pClients->mutex);
+    while (!pClients->stopping.load() && !pClients->due.empty())
+    {
+        SendEntry top = pClients->due.front();
+        if (top.dueNs > NowNs())
+        {
+            std::chrono::nanoseconds due(top.dueNs);
+            std::chrono::steady_clock::time_point until(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(due));
+            pClients->wake.wait_until(lock, until);
+            continue;
+        }
+
+        std::pop_heap(pClients->due.begin(), pClients->due.end(), LaterDue);
+        SimClient *pClient = &pClients->clients[top.client];
+        SendOne(pClients, pClient);
+
+        // From the scheduled time, not now, so a late generator does not lower the rate
+        pClients->due.back().dueNs = top.dueNs + ThinkNs(pClients, pClient);
+        std::push_heap(pClients->due.begin(), pClients->due.end(), LaterDue);
+    }
+}
+
+SimClients *__cdecl SIMCLIENTS_Start(const SimClientsDesc *pDesc)
+{
+    if (!pDesc || !pDesc->pHost || !pDesc->pGames)
+    {
+        return NULL;
+    }
+
+    SimClients *pClients = new SimClients();
+    DWORD rate = pDesc->actionsPerSecond ? pDesc->actionsPerSecond : DEFAULT_ACTIONS_PER_SECOND;
+    pClients->pHost = pDesc->pHost;
+    pClients->meanIntervalNs = 1e9 / rate;
+    pClients->stopping.store(false);
+    memset(&pClients->stats, 0, sizeof(pClients->stats));
+
+    RngStream root;
+    RNG_InitGame(&root, pDesc->seed);
+    int64_t now = NowNs();
+    for (DWORD g = 0; g < pDesc->gameCount; g++)
+    {
+        for (DWORD c = 0; c < pDesc->clientsPerGame; c++)
+        {
+            SimClient client;
+            client.game = pDesc->pGames[g];
+            client.clientId = g * pDesc->clientsPerGame + c;
+            client.seq = 0;
+            RNG_Split(&root, RNG_DOMAIN_UNIT, client.clientId, &client.rng);
+            pClients->clients.push_back(client);
+
+            SendEntry entry;
+            entry.client = (DWORD)pClients->clients.size() - 1;
+            entry.dueNs = now + ThinkNs(pClients, &pClients->clients.back());
+            pClients->due.push_back(entry);
+        }
+    }
+    std::make_heap(pClients->due.begin(), pClients->due.end(), LaterDue);
+
+    pClients->thread = std::thread(GeneratorMain, pClients);
+    return pClients;
+}
+
+void __cdecl SIMCLIENTS_Stop(SimClients *pClients, SimClientsStats *pStats)
+{
+    if (!pClients)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pClients->mutex);
+        pClients->stopping.store(true);
+        pClients->wake.notify_all();
+    }
+    pClients->thread.join();
+    if (pStats)
+    {
+        *pStats = pClients->stats;
+    }
+    delete pClients;
+}
@@ -0,0 +1,62 @@
+/*
+ * SimClients.hpp - D2Server simulated-client load generator
+ *
+ * Drives a GameHost the way connected players would, without sockets: every
+ * simulated client posts walk, cast and chat packets to its game with
+ * exponentially distributed think times, from one generator thread. Meant
+ * for benchmarking and soak runs on a headless (Linux) box.
+ *
+ * Each client draws from its own random stream split from the seed, so the
+ * packet contents (not their timing) are reproducible. A client's sequence
+ * number only advances when its post is accepted, so a game can check that
+ * it saw every client's packets exactly once and in order.
+ */
+
+#ifndef SIMCLIENTS_HPP
+#define SIMCLIENTS_HPP
+
+#include "GameHost.hpp"
+
+// Packet opcodes, after the client-to-server ids they stand in for
+#define SIMCLIENT_OP_WALK 0x03 // Run to location
+#define SIMCLIENT_OP_CAST 0x0C // Right skill on location
+#define SIMCLIENT_OP_CHAT 0x15
+
+#define SIMCLIENT_MAX_PACKET 96
+
+typedef struct SimClientPacket
+{
+    BYTE opcode;
+    BYTE size; // Whole packet, header included
+    WORD reserved;
+    DWORD clientId;
+    DWORD seq; // Per client, from 0
+    WORD x;    // Walk/cast target
+    WORD y;
+    DWORD arg; // Skill id, or chat text length
+} SimClientPacket;
+
+typedef struct SimClientsDesc
+{
+    GameHost *pHost;
+    const HostedGameId *pGames;
+    DWORD gameCount;
+    DWORD clientsPerGame;   // Client ids are game index * clientsPerGame + client
+    DWORD actionsPerSecond; // Mean per client (0 = 8)
+    DWORD seed;
+} SimClientsDesc;
+
+typedef struct SimClientsStats
+{
+    uint64_t sent;
+    uint64_t refused; // Posts the host refused (full mailbox)
+    uint64_t bytes;
+} SimClientsStats;
+
+typedef struct SimClients SimClients;
+
+SimClients *__cdecl SIMCLIENTS_Start(const SimClientsDesc *pDesc);
+// Stops the generator; the games may still hold packets posted before it
+void __cdecl SIMCLIENTS_Stop(SimClients *pClients, SimClientsStats *pStats);
+
+#endif // SIMCLIENTS_HPP
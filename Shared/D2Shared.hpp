@@ -0,0 +1,141 @@
+/*
+ * D2Shared.hpp - Types and helpers shared by the native subsystem libraries
+ *
+ * Game.exe itself is Windows-only, but the native subsystems (D2Win text
+ * layout, D2Sound mixer, D2Common tables, server host, ...) are plain C++
+ * so they can be built and benchmarked headless on Linux as well.
+ *
+ * On Windows the real <windows.h> types are used. Everywhere else the
+ * handful of Win32 scalar types the tree relies on are provided here with
+ * identical widths, so structure layouts match between platforms.
+ */
+
+#ifndef D2SHARED_HPP
+#define D2SHARED_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t BOOL;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+// Calling convention keywords are meaningless outside MSVC/x86
+#ifndef __cdecl
+#define __cdecl
+#endif
+#ifndef __stdcall
+#define __stdcall
+#endif
+#endif // _WIN32
+
+// =============================================================================
+// SIMD CONFIGURATION
+// =============================================================================
+
+// SSE2 is baseline on every x64 target and on x86 builds compiled with
+// /arch:SSE2 or -msse2. Kernels fall back to scalar loops otherwise.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define D2_SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define D2_SIMD_SSE2 0
+#endif
+
+// =============================================================================
+// HELPERS
+// =============================================================================
+
+#define D2_ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit (v must be non-zero)
+static inline DWORD D2_Ctz64(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (DWORD)__builtin_ctzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (DWORD)index;
+#else
+    DWORD n = 0;
+    if (!(v & 0xFFFFFFFFu))
+    {
+        v >>= 32;
+        n += 32;
+    }
+    while (!(v & 1))
+    {
+        v >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Index of the highest set bit (v must be non-zero)
+static inline DWORD D2_Msb64(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - (DWORD)__builtin_clzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (DWORD)index;
+#else
+    DWORD n = 0;
+    if (v >> 32)
+    {
+        v >>= 32;
+        n += 32;
+    }
+    while (v >>= 1)
+    {
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Round up to the next power of two (v must be non-zero and <= 2^31)
+static inline DWORD D2_NextPow2(DWORD v)
+{
+    v--;
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    return v + 1;
+}
+
+// 32-bit integer mix (lowbias32) used for hash table slot selection
+static inline DWORD D2_HashDword(DWORD x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+#endif // D2SHARED_HPP
@@ -0,0 +1,128 @@
+/*
+ * HashIndex.hpp - Open-addressed DWORD key to DWORD value table
+ *
+ * Linear probing over a power-of-two slot array sized to stay at most half
+ * full, with backward-shift deletion: erasing a slot pulls the later members
+ * of its probe chain back into the hole, so there are no tombstones and a
+ * table with constant churn never degrades.
+ *
+ * Find returns a slot rather than a value, so callers can update the value
+ * in place and erase without a second lookup. Erase moves entries between
+ * slots: a slot number is only good until the next Insert or Erase.
+ *
+ * A key may be stored more than once. Callers whose real key is wider than
+ * 32 bits store a hash of it and tell the candidates apart with
+ * HASHINDEX_Next.
+ */
+
+#ifndef HASHINDEX_HPP
+#define HASHINDEX_HPP
+
+#include "D2Shared.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define HASHINDEX_NONE 0xFFFFFFFF // No slot; also marks an empty slot's value, so never store it
+
+typedef struct HashIndex
+{
+    DWORD *pKeys;
+    DWORD *pValues;
+    DWORD mask;
+    DWORD count;
+} HashIndex;
+
+static inline void HASHINDEX_Clear(HashIndex *pIndex)
+{
+    memset(pIndex->pValues, 0xFF, (size_t)(pIndex->mask + 1) * sizeof(DWORD));
+    pIndex->count = 0;
+}
+
+// Room for capacity entries
+static inline BOOL HASHINDEX_Init(HashIndex *pIndex, DWORD capacity)
+{
+    DWORD size = D2_NextPow2(capacity ? capacity * 2 : 2);
+
+    pIndex->pKeys = (DWORD *)malloc((size_t)size * sizeof(DWORD));
+    pIndex->pValues = (DWORD *)malloc((size_t)size * sizeof(DWORD));
+    pIndex->mask = size - 1;
+    if (!pIndex->pKeys || !pIndex->pValues)
+    {
+        free(pIndex->pKeys);
+        free(pIndex->pValues);
+        memset(pIndex, 0, sizeof(HashIndex));
+        return FALSE;
+    }
+    HASHINDEX_Clear(pIndex);
+    return TRUE;
+}
+
+static inline void HASHINDEX_Free(HashIndex *pIndex)
+{
+    free(pIndex->pKeys);
+    free(pIndex->pValues);
+    memset(pIndex, 0, sizeof(HashIndex));
+}
+
+// First slot holding key at or after slot i along the probe chain, or HASHINDEX_NONE
+static inline DWORD HASHINDEX_Probe(const HashIndex *pIndex, DWORD key, DWORD i)
+{
+    for (;; i = (i + 1) & pIndex->mask)
+    {
+        if (pIndex->pValues[i] == HASHINDEX_NONE)
+        {
+            return HASHINDEX_NONE;
+        }
+        if (pIndex->pKeys[i] == key)
+        {
+            return i;
+        }
+    }
+}
+
+// Slot of the first entry with this key, or HASHINDEX_NONE
+static inline DWORD HASHINDEX_Find(const HashIndex *pIndex, DWORD key)
+{
+    return HASHINDEX_Probe(pIndex, key, D2_HashDword(key) & pIndex->mask);
+}
+
+// Slot of the next entry with this key after slot, or HASHINDEX_NONE
+static inline DWORD HASHINDEX_Next(const HashIndex *pIndex, DWORD key, DWORD slot)
+{
+    return HASHINDEX_Probe(pIndex, key, (slot + 1) & pIndex->mask);
+}
+
+// Adds an entry (even if the key is already present) and returns its slot. The caller keeps within capacity.
+static inline DWORD HASHINDEX_Insert(HashIndex *pIndex, DWORD key, DWORD value)
+{
+    DWORD i = D2_HashDword(key) & pIndex->mask;
+    while (pIndex->pValues[i] != HASHINDEX_NONE)
+    {
+        i = (i + 1) & pIndex->mask;
+    }
+    pIndex->pKeys[i] = key;
+    pIndex->pValues[i] = value;
+    pIndex->count++;
+    return i;
+}
+
+static inline void HASHINDEX_Erase(HashIndex *pIndex, DWORD hole)
+{
+    DWORD mask = pIndex->mask;
+    for (DWORD j = (hole + 1) & mask; pIndex->pValues[j] != HASHINDEX_NONE; j = (j + 1) & mask)
+    {
+        DWORD home = D2_HashDword(pIndex->pKeys[j]) & mask;
+        // Move j into the hole unless its home lies cyclically in (hole, j]
+        if (((j - home) & mask) >= ((j - hole) & mask))
+        {
+            pIndex->pKeys[hole] = pIndex->pKeys[j];
+            pIndex->pValues[hole] = pIndex->pValues[j];
+            hole = j;
+        }
+    }
+    pIndex->pValues[hole] = HASHINDEX_NONE;
+    pIndex->count--;
+}
+
+#endif // HASHINDEX_HPP
@@ -0,0 +1,97 @@
+/*
+ * SpscRing.hpp - Lock-free single-producer/single-consumer ring buffer
+ *
+ * Fixed-size elements copied in and out by value. Exactly one thread may push
+ * and exactly one (other) thread may pop; neither side ever blocks or takes a
+ * lock, which makes it safe to use from a real-time audio callback.
+ *
+ * Head and tail live on separate cache lines so producer and consumer do not
+ * false-share. Capacity is rounded up to a power of two.
+ */
+
+#ifndef SPSCRING_HPP
+#define SPSCRING_HPP
+
+#include "D2Shared.hpp"
+
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+
+#define SPSCRING_CACHE_LINE 64
+
+// Padding rather than alignas: rings are embedded in malloc'd structures,
+// which only guarantee fundamental alignment.
+typedef struct SpscRing
+{
+    std::atomic<DWORD> head; // Next slot to write (producer)
+    BYTE pad0[SPSCRING_CACHE_LINE - sizeof(DWORD)];
+    std::atomic<DWORD> tail; // Next slot to read (consumer)
+    BYTE pad1[SPSCRING_CACHE_LINE - sizeof(DWORD)];
+    BYTE *slots;
+    DWORD elementSize;
+    DWORD mask;
+} SpscRing;
+
+static inline BOOL SPSCRING_Init(SpscRing *pRing, DWORD elementSize, DWORD capacity)
+{
+    DWORD size = D2_NextPow2(capacity < 2 ? 2 : capacity);
+
+    pRing->slots = (BYTE *)malloc((size_t)size * elementSize);
+    if (!pRing->slots)
+    {
+        return FALSE;
+    }
+    pRing->elementSize = elementSize;
+    pRing->mask = size - 1;
+    pRing->head.store(0, std::memory_order_relaxed);
+    pRing->tail.store(0, std::memory_order_relaxed);
+    return TRUE;
+}
+
+static inline void SPSCRING_Free(SpscRing *pRing)
+{
+    free(pRing->slots);
+    pRing->slots = NULL;
+}
+
+// Producer side. Returns FALSE when the ring is full.
+static inline BOOL SPSCRING_Push(SpscRing *pRing, const void *pElement)
+{
+    DWORD head = pRing->head.load(std::memory_order_relaxed);
+    DWORD tail = pRing->tail.load(std::memory_order_acquire);
+
+    if (head - tail > pRing->mask)
+    {
+        return FALSE;
+    }
+
+    memcpy(pRing->slots + (size_t)(head & pRing->mask) * pRing->elementSize, pElement, pRing->elementSize);
+    pRing->head.store(head + 1, std::memory_order_release);
+    return TRUE;
+}
+
+// Consumer side. Returns FALSE when the ring is empty.
+static inline BOOL SPSCRING_Pop(SpscRing *pRing, void *pElement)
+{
+    DWORD tail = pRing->tail.load(std::memory_order_relaxed);
+    DWORD head = pRing->head.load(std::memory_order_acquire);
+
+    if (tail == head)
+    {
+        return FALSE;
+    }
+
+    memcpy(pElement, pRing->slots + (size_t)(tail & pRing->mask) * pRing->elementSize, pRing->elementSize);
+    pRing->tail.store(tail + 1, std::memory_order_release);
+    return TRUE;
+}
+
+// Approximate fill level; exact only when called from one of the two sides
+// while the other is idle.
+static inline DWORD SPSCRING_Count(const SpscRing *pRing)
+{
+    return pRing->head.load(std::memory_order_acquire) - pRing->tail.load(std::memory_order_acquire);
+}
+
+#endif // SPSCRING_HPP
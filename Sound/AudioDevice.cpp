@@ -0,0 +1,163 @@
+/*
+ * AudioDevice.cpp - D2Sound output devices for the native mixer
+ */
+
+#include "AudioDevice.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// NULL DEVICE
+// =============================================================================
+
+static BOOL __cdecl NullOpen(AudioDevice *pDevice, DWORD sampleRate, WORD channels)
+{
+    pDevice->sampleRate = sampleRate;
+    pDevice->channels = channels;
+    pDevice->framesWritten = 0;
+    return TRUE;
+}
+
+static BOOL __cdecl NullWrite(AudioDevice *pDevice, const int16_t *pSamples, DWORD frames)
+{
+    (void)pSamples;
+    pDevice->framesWritten += frames;
+    return TRUE;
+}
+
+static void __cdecl NullClose(AudioDevice *pDevice)
+{
+    (void)pDevice;
+}
+
+void __cdecl AUDIODEVICE_InitNull(AudioDevice *pDevice)
+{
+    memset(pDevice, 0, sizeof(AudioDevice));
+    pDevice->pfnOpen = NullOpen;
+    pDevice->pfnWrite = NullWrite;
+    pDevice->pfnClose = NullClose;
+}
+
+// =============================================================================
+// WAV FILE DEVICE
+// =============================================================================
+
+typedef struct WavFileState
+{
+    FILE *pFile;
+    char szPath[260];
+} WavFileState;
+
+static void WriteLE32(BYTE *p, DWORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static void WriteLE16(BYTE *p, WORD v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+}
+
+/*
+ * WriteWavHeader
+ * 44-byte canonical RIFF/WAVE PCM header (same layout ParseWaveFileHeader
+ * reads in D2Sound). Written with zero sizes on open and patched on close.
+ */
+static BOOL WriteWavHeader(FILE *pFile, DWORD sampleRate, WORD channels, DWORD dataBytes)
+{
+    BYTE header[44];
+
+    memcpy(header + 0, "RIFF", 4);
+    WriteLE32(header + 4, 36 + dataBytes);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    WriteLE32(header + 16, 16);
+    WriteLE16(header + 20, 1); // PCM
+    WriteLE16(header + 22, channels);
+    WriteLE32(header + 24, sampleRate);
+    WriteLE32(header + 28, sampleRate * channels * 2);
+    WriteLE16(header + 32, (WORD)(channels * 2));
+    WriteLE16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    WriteLE32(header + 40, dataBytes);
+
+    return fwrite(header, 1, sizeof(header), pFile) == sizeof(header);
+}
+
+static BOOL __cdecl WavOpen(AudioDevice *pDevice, DWORD sampleRate, WORD channels)
+{
+    WavFileState *pState = (WavFileState *)pDevice->pState;
+
+    pState->pFile = fopen(pState->szPath, "wb");
+    if (!pState->pFile)
+    {
+        return FALSE;
+    }
+
+    pDevice->sampleRate = sampleRate;
+    pDevice->channels = channels;
+    pDevice->framesWritten = 0;
+    return WriteWavHeader(pState->pFile, sampleRate, channels, 0);
+}
+
+static BOOL __cdecl WavWrite(AudioDevice *pDevice, const int16_t *pSamples, DWORD frames)
+{
+    WavFileState *pState = (WavFileState *)pDevice->pState;
+    DWORD count = frames * pDevice->channels;
+
+    if (!pState->pFile)
+    {
+        return FALSE;
+    }
+
+    // WAV is little-endian; every supported target is too
+    if (fwrite(pSamples, sizeof(int16_t), count, pState->pFile) != count)
+    {
+        return FALSE;
+    }
+    pDevice->framesWritten += frames;
+    return TRUE;
+}
+
+static void __cdecl WavClose(AudioDevice *pDevice)
+{
+    WavFileState *pState = (WavFileState *)pDevice->pState;
+
+    if (pState)
+    {
+        if (pState->pFile)
+        {
+            DWORD dataBytes = (DWORD)(pDevice->framesWritten * pDevice->channels * 2);
+            fseek(pState->pFile, 0, SEEK_SET);
+            WriteWavHeader(pState->pFile, pDevice->sampleRate, pDevice->channels, dataBytes);
+            fclose(pState->pFile);
+        }
+        free(pState);
+        pDevice->pState = NULL;
+    }
+}
+
+BOOL __cdecl AUDIODEVICE_InitWavFile(AudioDevice *pDevice, const char *szPath)
+{
+    memset(pDevice, 0, sizeof(AudioDevice));
+
+    WavFileState *pState = (WavFileState *)calloc(1, sizeof(WavFileState));
+    if (!pState || !szPath || strlen(szPath) >= sizeof(pState->szPath))
+    {
+        free(pState);
+        return FALSE;
+    }
+
+    strcpy(pState->szPath, szPath);
+    pDevice->pState = pState;
+    pDevice->pfnOpen = WavOpen;
+    pDevice->pfnWrite = WavWrite;
+    pDevice->pfnClose = WavClose;
+    return TRUE;
+}
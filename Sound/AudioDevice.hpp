@@ -0,0 +1,33 @@
+/*
+ * AudioDevice.hpp - D2Sound output devices for the native mixer
+ *
+ * A device consumes interleaved 16-bit stereo blocks produced by the mixer
+ * thread. D2Sound.dll still owns DirectSound output in game.exe; the devices
+ * here exist so the mixer can run without a sound card:
+ *   - Null: discards audio, counts frames (benchmarks, dedicated servers)
+ *   - WAV file: writes a RIFF/PCM file (offline captures, regression diffs)
+ */
+
+#ifndef AUDIODEVICE_HPP
+#define AUDIODEVICE_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef struct AudioDevice AudioDevice;
+
+struct AudioDevice
+{
+    BOOL(__cdecl *pfnOpen)(AudioDevice *pDevice, DWORD sampleRate, WORD channels);
+    BOOL(__cdecl *pfnWrite)(AudioDevice *pDevice, const int16_t *pSamples, DWORD frames);
+    void(__cdecl *pfnClose)(AudioDevice *pDevice);
+
+    void *pState;
+    DWORD sampleRate;
+    WORD channels;
+    uint64_t framesWritten;
+};
+
+void __cdecl AUDIODEVICE_InitNull(AudioDevice *pDevice);
+BOOL __cdecl AUDIODEVICE_InitWavFile(AudioDevice *pDevice, const char *szPath);
+
+#endif // AUDIODEVICE_HPP
@@ -0,0 +1,709 @@
+/*
+ * AudioMixer.cpp - D2Sound native real-time mixer
+ *
+ * See AudioMixer.hpp for the threading model.
+ */
+
+#include "AudioMixer.hpp"
+#include "MixKernels.hpp"
+#include "../Shared/SpscRing.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <thread>
+
+typedef enum MixerCommandType
+{
+    MIXCMD_PLAY = 1,
+    MIXCMD_STOP,
+    MIXCMD_SET_VOLUME,
+    MIXCMD_SET_PAN,
+    MIXCMD_SET_MASTER,
+    MIXCMD_STOP_ALL,
+} MixerCommandType;
+
+// Internal voice flag: source is a MixerStream rather than an AudioSample
+#define MIXVOICE_STREAM 0x8000
+
+// 32 bytes on 64-bit targets
+typedef struct MixerCommand
+{
+    BYTE type;
+    BYTE priority;
+    WORD flags;
+    DWORD voiceId;
+    union
+    {
+        const AudioSample *pSample;
+        const MixerStream *pStream; // MIXVOICE_STREAM
+    };
+    float volume;
+    float pan;
+    DWORD frames; // Fade/ramp length
+} MixerCommand;
+
+typedef struct MixerVoice
+{
+    DWORD id; // 0 = free
+    const AudioSample *pSample;
+    const MixerStream *pStream; // Set instead of pSample for streamed voices
+    uint64_t position; // 48.16 fixed point source frame
+    DWORD step;        // 16.16 source frames per output frame
+    DWORD serial;      // Start order, for oldest-first stealing
+    BYTE priority;
+    BOOL loop;
+    BOOL stopping; // Fading out; freed when the ramp completes
+
+    float volume;
+    float pan;
+    float gainLeft;
+    float gainRight;
+    float targetLeft;
+    float targetRight;
+    float deltaLeft;
+    float deltaRight;
+    DWORD rampFrames;
+} MixerVoice;
+
+struct AudioMixer
+{
+    SpscRing commands; // Game thread -> mixer
+    SpscRing events;   // Mixer -> game thread
+
+    DWORD sampleRate;
+    DWORD maxVoices;
+    MixKernels kernels;
+
+    // Game thread state
+    DWORD nextVoiceId;
+    DWORD commandsRejected;
+
+    // Mixer thread state
+    float master;
+    DWORD serial;
+    DWORD activeVoices;
+    MixerVoice voices[MIXER_MAX_VOICES];
+    float accum[MIXER_BLOCK_FRAMES * 2];
+    int16_t streamScratch[MIXER_BLOCK_FRAMES * 2];
+
+    std::atomic<uint64_t> blocksRendered;
+    std::atomic<uint64_t> commandsProcessed;
+    std::atomic<DWORD> voicesStolen;
+    std::atomic<DWORD> voicesDropped;
+    std::atomic<DWORD> peakVoices;
+    std::atomic<uint64_t> renderNanosTotal;
+    std::atomic<DWORD> renderNanosMax;
+
+    // Thread driver
+    std::thread thread;
+    std::atomic<BOOL> running;
+    AudioDevice *pDevice;
+    BOOL realtime;
+};
+
+// =============================================================================
+// CREATION
+// =============================================================================
+
+AudioMixer *__cdecl MIXER_Create(const AudioMixerDesc *pDesc)
+{
+    AudioMixerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    if (pDesc)
+    {
+        desc = *pDesc;
+    }
+
+    AudioMixer *pMixer = new AudioMixer();
+    pMixer->sampleRate = desc.sampleRate ? desc.sampleRate : MIXER_DEFAULT_RATE;
+    pMixer->maxVoices = desc.maxVoices ? desc.maxVoices : 64;
+    if (pMixer->maxVoices > MIXER_MAX_VOICES)
+    {
+        pMixer->maxVoices = MIXER_MAX_VOICES;
+    }
+    pMixer->master = 1.0f;
+    pMixer->nextVoiceId = 1;
+    MIXKERNELS_Select(&pMixer->kernels, desc.forceScalar);
+
+    DWORD capacity = desc.commandCapacity ? desc.commandCapacity : 1024;
+    if (!SPSCRING_Init(&pMixer->commands, sizeof(MixerCommand), capacity) ||
+        !SPSCRING_Init(&pMixer->events, sizeof(MixerEvent), capacity))
+    {
+        SPSCRING_Free(&pMixer->commands);
+        SPSCRING_Free(&pMixer->events);
+        delete pMixer;
+        return NULL;
+    }
+
+    return pMixer;
+}
+
+void __cdecl MIXER_Destroy(AudioMixer *pMixer)
+{
+    if (!pMixer)
+    {
+        return;
+    }
+
+    MIXER_StopThread(pMixer);
+    SPSCRING_Free(&pMixer->commands);
+    SPSCRING_Free(&pMixer->events);
+    delete pMixer;
+}
+
+DWORD __cdecl MIXER_GetSampleRate(const AudioMixer *pMixer)
+{
+    return pMixer->sampleRate;
+}
+
+BOOL __cdecl MIXER_IsSimd(const AudioMixer *pMixer)
+{
+    return pMixer->kernels.simd;
+}
+
+// =============================================================================
+// GAME THREAD API
+// =============================================================================
+
+static BOOL SubmitCommand(AudioMixer *pMixer, const MixerCommand *pCommand)
+{
+    if (!SPSCRING_Push(&pMixer->commands, pCommand))
+    {
+        pMixer->commandsRejected++;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static DWORD SubmitPlay(AudioMixer *pMixer, MixerCommand *pCommand, float volume, float pan, DWORD priority,
+                        DWORD flags, DWORD fadeInFrames)
+{
+    pCommand->type = MIXCMD_PLAY;
+    pCommand->priority = (BYTE)priority;
+    pCommand->flags = (WORD)flags;
+    pCommand->voiceId = pMixer->nextVoiceId;
+    pCommand->volume = volume;
+    pCommand->pan = pan;
+    pCommand->frames = fadeInFrames;
+
+    if (!SubmitCommand(pMixer, pCommand))
+    {
+        return 0;
+    }
+
+    // Skip 0 on wrap-around; it means "no voice"
+    if (++pMixer->nextVoiceId == 0)
+    {
+        pMixer->nextVoiceId = 1;
+    }
+    return pCommand->voiceId;
+}
+
+DWORD __cdecl MIXER_Play(AudioMixer *pMixer, const AudioSample *pSample, float volume, float pan,
+                         DWORD priority, DWORD flags, DWORD fadeInFrames)
+{
+    if (!pSample || !pSample->pcm || pSample->frames == 0 || pSample->sampleRate == 0 ||
+        (pSample->channels != 1 && pSample->channels != 2))
+    {
+        return 0;
+    }
+
+    MixerCommand command;
+    memset(&command, 0, sizeof(command));
+    command.pSample = pSample;
+    return SubmitPlay(pMixer, &command, volume, pan, priority, flags & ~MIXVOICE_STREAM, fadeInFrames);
+}
+
+DWORD __cdecl MIXER_PlayStream(AudioMixer *pMixer, const MixerStream *pStream, float volume, float pan,
+                               DWORD priority, DWORD fadeInFrames)
+{
+    if (!pStream || !pStream->pfnRead || (pStream->channels != 1 && pStream->channels != 2))
+    {
+        return 0;
+    }
+
+    MixerCommand command;
+    memset(&command, 0, sizeof(command));
+    command.pStream = pStream;
+    return SubmitPlay(pMixer, &command, volume, pan, priority, MIXVOICE_STREAM, fadeInFrames);
+}
+
+static BOOL SubmitVoiceCommand(AudioMixer *pMixer, BYTE type, DWORD voiceId, float volume, float pan, DWORD frames)
+{
+    MixerCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = type;
+    command.voiceId = voiceId;
+    command.volume = volume;
+    command.pan = pan;
+    command.frames = frames;
+    return SubmitCommand(pMixer, &command);
+}
+
+BOOL __cdecl MIXER_StopVoice(AudioMixer *pMixer, DWORD voiceId, DWORD fadeOutFrames)
+{
+    return SubmitVoiceCommand(pMixer, MIXCMD_STOP, voiceId, 0.0f, 0.0f, fadeOutFrames);
+}
+
+BOOL __cdecl MIXER_SetVolume(AudioMixer *pMixer, DWORD voiceId, float volume, DWORD rampFrames)
+{
+    return SubmitVoiceCommand(pMixer, MIXCMD_SET_VOLUME, voiceId, volume, 0.0f, rampFrames);
+}
+
+BOOL __cdecl MIXER_SetPan(AudioMixer *pMixer, DWORD voiceId, float pan, DWORD rampFrames)
+{
+    return SubmitVoiceCommand(pMixer, MIXCMD_SET_PAN, voiceId, 0.0f, pan, rampFrames);
+}
+
+BOOL __cdecl MIXER_SetMasterVolume(AudioMixer *pMixer, float volume)
+{
+    return SubmitVoiceCommand(pMixer, MIXCMD_SET_MASTER, 0, volume, 0.0f, 0);
+}
+
+BOOL __cdecl MIXER_StopAll(AudioMixer *pMixer)
+{
+    return SubmitVoiceCommand(pMixer, MIXCMD_STOP_ALL, 0, 0.0f, 0.0f, 0);
+}
+
+BOOL __cdecl MIXER_PollEvent(AudioMixer *pMixer, MixerEvent *pEvent)
+{
+    return SPSCRING_Pop(&pMixer->events, pEvent);
+}
+
+// =============================================================================
+// VOICE MANAGEMENT (mixer thread)
+// =============================================================================
+
+static void PostEvent(AudioMixer *pMixer, DWORD type, DWORD voiceId)
+{
+    MixerEvent event;
+    event.type = type;
+    event.voiceId = voiceId;
+
+    // A game thread that never polls only loses notifications, never audio
+    SPSCRING_Push(&pMixer->events, &event);
+}
+
+static void ReleaseVoice(AudioMixer *pMixer, MixerVoice *pVoice, DWORD eventType)
+{
+    PostEvent(pMixer, eventType, pVoice->id);
+    pVoice->id = 0;
+    pVoice->pSample = NULL;
+    pVoice->pStream = NULL;
+    pMixer->activeVoices--;
+}
+
+static MixerVoice *FindVoice(AudioMixer *pMixer, DWORD voiceId)
+{
+    for (DWORD i = 0; i < pMixer->maxVoices; i++)
+    {
+        if (pMixer->voices[i].id == voiceId)
+        {
+            return &pMixer->voices[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * ComputeGains
+ * Linear pan law matching D2Sound: the far channel is attenuated, the near
+ * channel stays at full volume.
+ */
+static void ComputeGains(float volume, float pan, float *pLeft, float *pRight)
+{
+    if (pan < -1.0f)
+        pan = -1.0f;
+    if (pan > 1.0f)
+        pan = 1.0f;
+
+    *pLeft = volume * (pan > 0.0f ? 1.0f - pan : 1.0f);
+    *pRight = volume * (pan < 0.0f ? 1.0f + pan : 1.0f);
+}
+
+static void SetVoiceRamp(MixerVoice *pVoice, DWORD frames)
+{
+    float left, right;
+    ComputeGains(pVoice->volume, pVoice->pan, &left, &right);
+
+    pVoice->targetLeft = left;
+    pVoice->targetRight = right;
+    if (frames == 0)
+    {
+        pVoice->gainLeft = left;
+        pVoice->gainRight = right;
+        pVoice->deltaLeft = 0.0f;
+        pVoice->deltaRight = 0.0f;
+        pVoice->rampFrames = 0;
+    }
+    else
+    {
+        pVoice->deltaLeft = (left - pVoice->gainLeft) / (float)frames;
+        pVoice->deltaRight = (right - pVoice->gainRight) / (float)frames;
+        pVoice->rampFrames = frames;
+    }
+}
+
+/*
+ * AllocateVoice
+ * Free slot first; otherwise steal the lowest priority voice, oldest first.
+ * A new voice never steals from a higher priority one.
+ */
+static MixerVoice *AllocateVoice(AudioMixer *pMixer, BYTE priority)
+{
+    MixerVoice *pVictim = NULL;
+
+    for (DWORD i = 0; i < pMixer->maxVoices; i++)
+    {
+        MixerVoice *pVoice = &pMixer->voices[i];
+        if (pVoice->id == 0)
+        {
+            return pVoice;
+        }
+        if (!pVictim || pVoice->priority < pVictim->priority ||
+            (pVoice->priority == pVictim->priority && (int)(pVoice->serial - pVictim->serial) < 0))
+        {
+            pVictim = pVoice;
+        }
+    }
+
+    if (!pVictim || pVictim->priority > priority)
+    {
+        return NULL;
+    }
+
+    ReleaseVoice(pMixer, pVictim, MIXEVT_VOICE_STOLEN);
+    pMixer->voicesStolen.fetch_add(1, std::memory_order_relaxed);
+    return pVictim;
+}
+
+static void StartVoice(AudioMixer *pMixer, const MixerCommand *pCommand)
+{
+    MixerVoice *pVoice = AllocateVoice(pMixer, pCommand->priority);
+    if (!pVoice)
+    {
+        PostEvent(pMixer, MIXEVT_VOICE_DROPPED, pCommand->voiceId);
+        pMixer->voicesDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    memset(pVoice, 0, sizeof(MixerVoice));
+    pVoice->id = pCommand->voiceId;
+    if (pCommand->flags & MIXVOICE_STREAM)
+    {
+        pVoice->pStream = pCommand->pStream;
+        pVoice->step = 0x10000;
+    }
+    else
+    {
+        pVoice->pSample = pCommand->pSample;
+        pVoice->step = (DWORD)(((uint64_t)pCommand->pSample->sampleRate << 16) / pMixer->sampleRate);
+    }
+    pVoice->serial = pMixer->serial++;
+    pVoice->priority = pCommand->priority;
+    pVoice->loop = (pCommand->flags & MIXVOICE_LOOP) != 0;
+    pVoice->volume = pCommand->volume;
+    pVoice->pan = pCommand->pan;
+    SetVoiceRamp(pVoice, pCommand->frames); // Fade in from silence
+
+    pMixer->activeVoices++;
+    if (pMixer->activeVoices > pMixer->peakVoices.load(std::memory_order_relaxed))
+    {
+        pMixer->peakVoices.store(pMixer->activeVoices, std::memory_order_relaxed);
+    }
+}
+
+static void ProcessCommand(AudioMixer *pMixer, const MixerCommand *pCommand)
+{
+    MixerVoice *pVoice;
+
+    switch (pCommand->type)
+    {
+    case MIXCMD_PLAY:
+        StartVoice(pMixer, pCommand);
+        break;
+
+    case MIXCMD_STOP:
+        pVoice = FindVoice(pMixer, pCommand->voiceId);
+        if (pVoice)
+        {
+            if (pCommand->frames == 0)
+            {
+                ReleaseVoice(pMixer, pVoice, MIXEVT_VOICE_ENDED);
+            }
+            else
+            {
+                pVoice->volume = 0.0f;
+                pVoice->stopping = TRUE;
+                SetVoiceRamp(pVoice, pCommand->frames);
+            }
+        }
+        break;
+
+    case MIXCMD_SET_VOLUME:
+        pVoice = FindVoice(pMixer, pCommand->voiceId);
+        if (pVoice && !pVoice->stopping)
+        {
+            pVoice->volume = pCommand->volume;
+            SetVoiceRamp(pVoice, pCommand->frames);
+        }
+        break;
+
+    case MIXCMD_SET_PAN:
+        pVoice = FindVoice(pMixer, pCommand->voiceId);
+        if (pVoice && !pVoice->stopping)
+        {
+            pVoice->pan = pCommand->pan;
+            SetVoiceRamp(pVoice, pCommand->frames);
+        }
+        break;
+
+    case MIXCMD_SET_MASTER:
+        pMixer->master = pCommand->volume;
+        break;
+
+    case MIXCMD_STOP_ALL:
+        for (DWORD i = 0; i < pMixer->maxVoices; i++)
+        {
+            if (pMixer->voices[i].id)
+            {
+                ReleaseVoice(pMixer, &pMixer->voices[i], MIXEVT_VOICE_ENDED);
+            }
+        }
+        break;
+    }
+}
+
+// =============================================================================
+// RENDERING (mixer thread)
+// =============================================================================
+
+/*
+ * MixSegment
+ * Mix up to `frames` frames of one voice with a single gain ramp. Returns the
+ * frames produced; fewer than requested means the source ran out.
+ */
+static DWORD MixSegment(AudioMixer *pMixer, MixerVoice *pVoice, float *pAccum, DWORD frames, const MixGain *pGain)
+{
+    const AudioSample *pSample = pVoice->pSample;
+
+    if (pVoice->pStream)
+    {
+        const MixerStream *pStream = pVoice->pStream;
+        DWORD produced = pStream->pfnRead(pStream->pContext, pMixer->streamScratch, frames);
+        if (produced > frames)
+        {
+            produced = frames;
+        }
+        if (produced)
+        {
+            PFN_MixUnitStep pfnStream =
+                (pStream->channels == 1) ? pMixer->kernels.pfnMixMono : pMixer->kernels.pfnMixStereo;
+            pfnStream(pAccum, pMixer->streamScratch, produced, pGain);
+        }
+        return produced;
+    }
+
+    if (pVoice->step != 0x10000)
+    {
+        return MIXKERNELS_MixResampled(pAccum, pSample->pcm, pSample->frames, pSample->channels,
+                                       &pVoice->position, pVoice->step, pVoice->loop, frames, pGain);
+    }
+
+    PFN_MixUnitStep pfnMix = (pSample->channels == 1) ? pMixer->kernels.pfnMixMono : pMixer->kernels.pfnMixStereo;
+    DWORD produced = 0;
+
+    while (produced < frames)
+    {
+        DWORD index = (DWORD)(pVoice->position >> 16);
+        if (index >= pSample->frames)
+        {
+            if (!pVoice->loop)
+            {
+                break;
+            }
+            index = 0;
+            pVoice->position = 0;
+        }
+
+        DWORD count = pSample->frames - index;
+        if (count > frames - produced)
+        {
+            count = frames - produced;
+        }
+
+        // Continue the ramp where the previous chunk (before a loop) ended
+        MixGain gain = *pGain;
+        gain.left += (float)produced * pGain->deltaLeft;
+        gain.right += (float)produced * pGain->deltaRight;
+
+        pfnMix(pAccum + produced * 2, pSample->pcm + (size_t)index * pSample->channels, count, &gain);
+        pVoice->position += (uint64_t)count << 16;
+        produced += count;
+    }
+
+    return produced;
+}
+
+static void RenderVoice(AudioMixer *pMixer, MixerVoice *pVoice)
+{
+    DWORD done = 0;
+
+    while (done < MIXER_BLOCK_FRAMES)
+    {
+        DWORD segment = MIXER_BLOCK_FRAMES - done;
+        MixGain gain;
+
+        gain.left = pVoice->gainLeft;
+        gain.right = pVoice->gainRight;
+        gain.deltaLeft = 0.0f;
+        gain.deltaRight = 0.0f;
+        if (pVoice->rampFrames)
+        {
+            if (segment > pVoice->rampFrames)
+            {
+                segment = pVoice->rampFrames;
+            }
+            gain.deltaLeft = pVoice->deltaLeft;
+            gain.deltaRight = pVoice->deltaRight;
+        }
+
+        DWORD produced = MixSegment(pMixer, pVoice, pMixer->accum + done * 2, segment, &gain);
+        done += produced;
+
+        if (pVoice->rampFrames)
+        {
+            pVoice->rampFrames -= produced;
+            if (pVoice->rampFrames == 0)
+            {
+                pVoice->gainLeft = pVoice->targetLeft;
+                pVoice->gainRight = pVoice->targetRight;
+                if (pVoice->stopping)
+                {
+                    ReleaseVoice(pMixer, pVoice, MIXEVT_VOICE_ENDED);
+                    return;
+                }
+            }
+            else
+            {
+                pVoice->gainLeft += (float)produced * pVoice->deltaLeft;
+                pVoice->gainRight += (float)produced * pVoice->deltaRight;
+            }
+        }
+
+        if (produced < segment)
+        {
+            ReleaseVoice(pMixer, pVoice, MIXEVT_VOICE_ENDED);
+            return;
+        }
+    }
+}
+
+void __cdecl MIXER_RenderBlock(AudioMixer *pMixer, int16_t *pOut)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MixerCommand command;
+    DWORD budget = pMixer->commands.mask + 1;
+    uint64_t processed = 0;
+
+    // Bounded drain: a producer that never stops cannot stall the block
+    while (budget-- && SPSCRING_Pop(&pMixer->commands, &command))
+    {
+        ProcessCommand(pMixer, &command);
+        processed++;
+    }
+
+    memset(pMixer->accum, 0, sizeof(pMixer->accum));
+    for (DWORD i = 0; i < pMixer->maxVoices; i++)
+    {
+        if (pMixer->voices[i].id)
+        {
+            RenderVoice(pMixer, &pMixer->voices[i]);
+        }
+    }
+
+    pMixer->kernels.pfnConvert(pOut, pMixer->accum, MIXER_BLOCK_FRAMES * 2, pMixer->master);
+
+    DWORD nanos = (DWORD)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    pMixer->commandsProcessed.fetch_add(processed, std::memory_order_relaxed);
+    pMixer->blocksRendered.fetch_add(1, std::memory_order_relaxed);
+    pMixer->renderNanosTotal.fetch_add(nanos, std::memory_order_relaxed);
+    if (nanos > pMixer->renderNanosMax.load(std::memory_order_relaxed))
+    {
+        pMixer->renderNanosMax.store(nanos, std::memory_order_relaxed);
+    }
+}
+
+// =============================================================================
+// THREAD DRIVER
+// =============================================================================
+
+static void MixerThreadMain(AudioMixer *pMixer)
+{
+    int16_t block[MIXER_BLOCK_FRAMES * 2];
+    std::chrono::steady_clock::duration blockDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::nanoseconds((uint64_t)MIXER_BLOCK_FRAMES * 1000000000ull / pMixer->sampleRate));
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+
+    while (pMixer->running.load(std::memory_order_acquire))
+    {
+        MIXER_RenderBlock(pMixer, block);
+        if (!pMixer->pDevice->pfnWrite(pMixer->pDevice, block, MIXER_BLOCK_FRAMES))
+        {
+            break;
+        }
+
+        if (pMixer->realtime)
+        {
+            deadline += blockDuration;
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+}
+
+BOOL __cdecl MIXER_StartThread(AudioMixer *pMixer, AudioDevice *pDevice, BOOL realtime)
+{
+    if (!pDevice || pMixer->running.load())
+    {
+        return FALSE;
+    }
+
+    if (!pDevice->pfnOpen(pDevice, pMixer->sampleRate, 2))
+    {
+        return FALSE;
+    }
+
+    pMixer->pDevice = pDevice;
+    pMixer->realtime = realtime;
+    pMixer->running.store(TRUE, std::memory_order_release);
+    pMixer->thread = std::thread(MixerThreadMain, pMixer);
+    return TRUE;
+}
+
+void __cdecl MIXER_StopThread(AudioMixer *pMixer)
+{
+    if (!pMixer->thread.joinable())
+    {
+        return;
+    }
+
+    pMixer->running.store(FALSE, std::memory_order_release);
+    pMixer->thread.join();
+    pMixer->pDevice->pfnClose(pMixer->pDevice);
+    pMixer->pDevice = NULL;
+}
+
+void __cdecl MIXER_GetStats(const AudioMixer *pMixer, AudioMixerStats *pStats)
+{
+    pStats->blocksRendered = pMixer->blocksRendered.load(std::memory_order_relaxed);
+    pStats->commandsProcessed = pMixer->commandsProcessed.load(std::memory_order_relaxed);
+    pStats->commandsRejected = pMixer->commandsRejected;
+    pStats->voicesStolen = pMixer->voicesStolen.load(std::memory_order_relaxed);
+    pStats->voicesDropped = pMixer->voicesDropped.load(std::memory_order_relaxed);
+    pStats->peakVoices = pMixer->peakVoices.load(std::memory_order_relaxed);
+    pStats->renderNanosTotal = pMixer->renderNanosTotal.load(std::memory_order_relaxed);
+    pStats->renderNanosMax = pMixer->renderNanosMax.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,142 @@
+/*
+ * AudioMixer.hpp - D2Sound native real-time mixer
+ *
+ * Replaces the D2Sound audio-thread path where events are pulled from a
+ * linked-list queue under critical sections (ProcessQueueWithLocking) and
+ * mixed per effect.
+ *
+ * Threading model:
+ *   - The game thread is the only producer. Play/stop/volume/pan requests are
+ *     written into a lock-free SPSC command ring and return immediately.
+ *   - The mixer thread is the only consumer. At the top of every block it
+ *     drains the ring, then renders MIXER_BLOCK_FRAMES stereo frames with the
+ *     SIMD kernels and hands them to the output device.
+ *   - Voice lifecycle notifications (finished, stolen, dropped) travel back to
+ *     the game thread through a second SPSC ring polled with MIXER_PollEvent.
+ * Neither thread ever waits on the other, so a busy game thread cannot starve
+ * the audio thread into an underrun (the crackle under load).
+ *
+ * Samples (AudioSample) and streams (MixerStream) are owned by the caller and
+ * must stay alive until every voice playing them has reported
+ * MIXEVT_VOICE_ENDED/STOLEN/DROPPED.
+ */
+
+#ifndef AUDIOMIXER_HPP
+#define AUDIOMIXER_HPP
+
+#include "AudioDevice.hpp"
+
+#define MIXER_BLOCK_FRAMES 256
+#define MIXER_MAX_VOICES 128
+#define MIXER_DEFAULT_RATE 44100
+
+// Voice flags
+#define MIXVOICE_LOOP 0x0001
+
+// Priorities (D2Sound levels): higher wins when voices must be stolen
+#define MIXPRIORITY_AMBIENT 0
+#define MIXPRIORITY_EFFECT 1
+#define MIXPRIORITY_CRITICAL 2
+
+typedef struct AudioSample
+{
+    const int16_t *pcm; // Interleaved when stereo
+    DWORD frames;
+    DWORD sampleRate;
+    WORD channels; // 1 or 2
+} AudioSample;
+
+/*
+ * Pull source for streamed voices (music, speech). pfnRead is called on the
+ * mixer thread and must not block: it copies up to `frames` frames at the
+ * mixer output rate and returns how many it wrote. Returning fewer than
+ * requested ends the voice.
+ */
+typedef struct MixerStream
+{
+    DWORD(__cdecl *pfnRead)(void *pContext, int16_t *pOut, DWORD frames);
+    void *pContext;
+    WORD channels; // 1 or 2
+} MixerStream;
+
+typedef enum MixerEventType
+{
+    MIXEVT_VOICE_ENDED = 1, // Played to the end or faded out after a stop
+    MIXEVT_VOICE_STOLEN,    // Cut to make room for a higher priority voice
+    MIXEVT_VOICE_DROPPED,   // Never started: no voice available
+} MixerEventType;
+
+typedef struct MixerEvent
+{
+    DWORD type;
+    DWORD voiceId;
+} MixerEvent;
+
+typedef struct AudioMixerDesc
+{
+    DWORD sampleRate;      // Output rate (0 = MIXER_DEFAULT_RATE)
+    DWORD maxVoices;       // 0 = 64, clamped to MIXER_MAX_VOICES
+    DWORD commandCapacity; // Command ring slots (0 = 1024)
+    BOOL forceScalar;      // Disable SIMD kernels (verification)
+} AudioMixerDesc;
+
+typedef struct AudioMixerStats
+{
+    uint64_t blocksRendered;
+    uint64_t commandsProcessed;
+    DWORD commandsRejected; // Ring full on the game thread
+    DWORD voicesStolen;
+    DWORD voicesDropped;
+    DWORD peakVoices;
+    uint64_t renderNanosTotal; // Mixer thread only
+    DWORD renderNanosMax;
+} AudioMixerStats;
+
+typedef struct AudioMixer AudioMixer;
+
+AudioMixer *__cdecl MIXER_Create(const AudioMixerDesc *pDesc);
+void __cdecl MIXER_Destroy(AudioMixer *pMixer);
+
+DWORD __cdecl MIXER_GetSampleRate(const AudioMixer *pMixer);
+BOOL __cdecl MIXER_IsSimd(const AudioMixer *pMixer);
+
+// =============================================================================
+// GAME THREAD API (single producer)
+// =============================================================================
+
+/*
+ * Queue a new voice. volume 0..1, pan -1 (left) .. +1 (right).
+ * Returns the voice id used by the other calls, or 0 if the ring is full.
+ */
+DWORD __cdecl MIXER_Play(AudioMixer *pMixer, const AudioSample *pSample, float volume, float pan,
+                         DWORD priority, DWORD flags, DWORD fadeInFrames);
+// Queue a streamed voice; the stream must already be at MIXER_GetSampleRate
+DWORD __cdecl MIXER_PlayStream(AudioMixer *pMixer, const MixerStream *pStream, float volume, float pan,
+                               DWORD priority, DWORD fadeInFrames);
+BOOL __cdecl MIXER_StopVoice(AudioMixer *pMixer, DWORD voiceId, DWORD fadeOutFrames);
+BOOL __cdecl MIXER_SetVolume(AudioMixer *pMixer, DWORD voiceId, float volume, DWORD rampFrames);
+BOOL __cdecl MIXER_SetPan(AudioMixer *pMixer, DWORD voiceId, float pan, DWORD rampFrames);
+BOOL __cdecl MIXER_SetMasterVolume(AudioMixer *pMixer, float volume);
+BOOL __cdecl MIXER_StopAll(AudioMixer *pMixer);
+
+BOOL __cdecl MIXER_PollEvent(AudioMixer *pMixer, MixerEvent *pEvent);
+
+// =============================================================================
+// MIXER THREAD API (single consumer)
+// =============================================================================
+
+// Drain pending commands and render one block (MIXER_BLOCK_FRAMES stereo frames)
+void __cdecl MIXER_RenderBlock(AudioMixer *pMixer, int16_t *pOut);
+
+/*
+ * Run the mixer on its own thread, writing to pDevice until MIXER_StopThread.
+ * realtime paces blocks to the wall clock; without it the thread renders as
+ * fast as the device accepts (offline capture, benchmarks).
+ */
+BOOL __cdecl MIXER_StartThread(AudioMixer *pMixer, AudioDevice *pDevice, BOOL realtime);
+void __cdecl MIXER_StopThread(AudioMixer *pMixer);
+
+// Snapshot; counters written by the mixer thread may be slightly stale
+void __cdecl MIXER_GetStats(const AudioMixer *pMixer, AudioMixerStats *pStats);
+
+#endif // AUDIOMIXER_HPP
@@ -0,0 +1,771 @@
+/*
+ * AudioStream.cpp - D2Sound streaming music and speech decoder
+ *
+ * See AudioStream.hpp for the memory and threading model.
+ */
+
+#include "AudioStream.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// Worker poll interval when every ring is full; the mixer never signals
+#define STREAM_IDLE_WAIT_MS 10
+
+// Slot ownership (game thread <-> worker)
+#define SLOT_FREE 0
+#define SLOT_ACTIVE 1
+#define SLOT_CLOSING 2
+
+#define WAVE_FORMAT_PCM 1
+
+typedef struct WaveFormat
+{
+    WORD channels;
+    WORD bitsPerSample;
+    WORD blockAlign;
+    DWORD sampleRate;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+} WaveFormat;
+
+struct AudioStream
+{
+    // Ring positions are free-running frame counters
+    std::atomic<DWORD> writeFrame; // Worker
+    BYTE pad0[64 - sizeof(std::atomic<DWORD>)];
+    std::atomic<DWORD> readFrame; // Mixer
+    BYTE pad1[64 - sizeof(std::atomic<DWORD>)];
+
+    std::atomic<DWORD> slotState;
+    std::atomic<DWORD> decodeState;
+    std::atomic<DWORD> underruns;
+    std::atomic<uint64_t> framesPlayed;
+    std::atomic<uint64_t> framesDecoded;
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<DWORD> chunksRead;
+
+    int16_t *pRing; // Interleaved stereo
+    DWORD ringMask;
+    BYTE *pChunk;
+    MixerStream mixerStream;
+
+    // Worker-owned decoder state
+    StreamSource source;
+    BOOL loop;
+    WaveFormat format;
+    uint64_t dataPos;
+    DWORD readBytes;      // Whole frames, sized so one chunk always fits in half the ring
+    DWORD step;           // 16.16 source frames per output frame
+    DWORD resamplePos;    // 16.16, relative to the frame before the current chunk
+    int16_t history[2];   // Last source frame of the previous chunk
+};
+
+struct AudioStreamManager
+{
+    DWORD outputRate;
+    DWORD streamCount;
+    DWORD chunkBytes;
+    DWORD ringFrames;
+    BOOL noMusic;
+    size_t memoryBytes;
+
+    AudioStream *pStreams;
+    int16_t *pDecodeScratch; // chunkBytes samples
+    int16_t *pOutScratch;    // ringFrames / 2 stereo frames
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    BOOL stopping; // Guarded by mutex
+};
+
+// =============================================================================
+// SOURCES
+// =============================================================================
+
+typedef struct FileSourceState
+{
+    FILE *pFile;
+    uint64_t position;
+} FileSourceState;
+
+static BOOL __cdecl FileSourceRead(void *pContext, uint64_t offset, void *pBuffer, DWORD bytes, DWORD *pBytesRead)
+{
+    FileSourceState *pState = (FileSourceState *)pContext;
+
+    // Streams read sequentially; only seek on loop or header probing
+    if (offset != pState->position)
+    {
+        if (fseek(pState->pFile, (long)offset, SEEK_SET) != 0)
+        {
+            return FALSE;
+        }
+        pState->position = offset;
+    }
+
+    size_t got = fread(pBuffer, 1, bytes, pState->pFile);
+    pState->position += got;
+    *pBytesRead = (DWORD)got;
+    return got == bytes || feof(pState->pFile);
+}
+
+static void __cdecl FileSourceClose(void *pContext)
+{
+    FileSourceState *pState = (FileSourceState *)pContext;
+    fclose(pState->pFile);
+    free(pState);
+}
+
+BOOL __cdecl AUDIOSTREAM_OpenFileSource(StreamSource *pSource, const char *szPath)
+{
+    memset(pSource, 0, sizeof(StreamSource));
+
+    FileSourceState *pState = (FileSourceState *)calloc(1, sizeof(FileSourceState));
+    if (!pState)
+    {
+        return FALSE;
+    }
+
+    pState->pFile = fopen(szPath, "rb");
+    if (!pState->pFile)
+    {
+        free(pState);
+        return FALSE;
+    }
+
+    pSource->pfnRead = FileSourceRead;
+    pSource->pfnClose = FileSourceClose;
+    pSource->pContext = pState;
+    return TRUE;
+}
+
+typedef struct MemorySourceState
+{
+    const BYTE *pData;
+    size_t size;
+} MemorySourceState;
+
+static BOOL __cdecl MemorySourceRead(void *pContext, uint64_t offset, void *pBuffer, DWORD bytes, DWORD *pBytesRead)
+{
+    MemorySourceState *pState = (MemorySourceState *)pContext;
+
+    if (offset >= pState->size)
+    {
+        *pBytesRead = 0;
+        return TRUE;
+    }
+    if (bytes > pState->size - offset)
+    {
+        bytes = (DWORD)(pState->size - offset);
+    }
+
+    memcpy(pBuffer, pState->pData + offset, bytes);
+    *pBytesRead = bytes;
+    return TRUE;
+}
+
+static void __cdecl MemorySourceClose(void *pContext)
+{
+    free(pContext);
+}
+
+BOOL __cdecl AUDIOSTREAM_OpenMemorySource(StreamSource *pSource, const void *pData, size_t size)
+{
+    memset(pSource, 0, sizeof(StreamSource));
+
+    MemorySourceState *pState = (MemorySourceState *)calloc(1, sizeof(MemorySourceState));
+    if (!pState)
+    {
+        return FALSE;
+    }
+
+    pState->pData = (const BYTE *)pData;
+    pState->size = size;
+    pSource->pfnRead = MemorySourceRead;
+    pSource->pfnClose = MemorySourceClose;
+    pSource->pContext = pState;
+    return TRUE;
+}
+
+static void CloseSource(StreamSource *pSource)
+{
+    if (pSource->pfnClose)
+    {
+        pSource->pfnClose(pSource->pContext);
+    }
+    memset(pSource, 0, sizeof(StreamSource));
+}
+
+// =============================================================================
+// WAVE HEADER (worker)
+// =============================================================================
+
+static DWORD ReadLE32(const BYTE *p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static WORD ReadLE16(const BYTE *p)
+{
+    return (WORD)(p[0] | (p[1] << 8));
+}
+
+static BOOL ReadExact(const StreamSource *pSource, uint64_t offset, void *pBuffer, DWORD bytes)
+{
+    DWORD got = 0;
+    return pSource->pfnRead(pSource->pContext, offset, pBuffer, bytes, &got) && got == bytes;
+}
+
+/*
+ * ParseWaveHeader
+ * Walks the RIFF chunk list (same checks as D2Sound's ParseWaveFileHeader)
+ * reading only chunk headers and the fmt body, never sample data.
+ */
+static BOOL ParseWaveHeader(const StreamSource *pSource, WaveFormat *pFormat)
+{
+    BYTE header[16];
+    BOOL haveFormat = FALSE;
+    uint64_t offset = 12;
+
+    memset(pFormat, 0, sizeof(WaveFormat));
+    if (!ReadExact(pSource, 0, header, 12) || memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        return FALSE;
+    }
+
+    // Bounded walk: a corrupt size cannot make this loop forever
+    for (DWORD chunk = 0; chunk < 64; chunk++)
+    {
+        if (!ReadExact(pSource, offset, header, 8))
+        {
+            return FALSE;
+        }
+        DWORD size = ReadLE32(header + 4);
+
+        if (memcmp(header, "fmt ", 4) == 0)
+        {
+            if (size < 16 || !ReadExact(pSource, offset + 8, header, 16))
+            {
+                return FALSE;
+            }
+            if (ReadLE16(header) != WAVE_FORMAT_PCM)
+            {
+                return FALSE;
+            }
+            pFormat->channels = ReadLE16(header + 2);
+            pFormat->sampleRate = ReadLE32(header + 4);
+            pFormat->blockAlign = ReadLE16(header + 12);
+            pFormat->bitsPerSample = ReadLE16(header + 14);
+            haveFormat = TRUE;
+        }
+        else if (memcmp(header, "data", 4) == 0)
+        {
+            if (!haveFormat)
+            {
+                return FALSE;
+            }
+            pFormat->dataOffset = offset + 8;
+            pFormat->dataSize = size;
+            break;
+        }
+
+        offset += 8 + (uint64_t)size + (size & 1);
+    }
+
+    if (pFormat->dataOffset == 0 || (pFormat->channels != 1 && pFormat->channels != 2) ||
+        (pFormat->bitsPerSample != 8 && pFormat->bitsPerSample != 16) || pFormat->sampleRate == 0 ||
+        pFormat->blockAlign != pFormat->channels * pFormat->bitsPerSample / 8)
+    {
+        return FALSE;
+    }
+
+    pFormat->dataSize -= pFormat->dataSize % pFormat->blockAlign;
+    return TRUE;
+}
+
+// =============================================================================
+// DECODE AND RESAMPLE (worker)
+// =============================================================================
+
+static void DecodePcm(const WaveFormat *pFormat, const BYTE *pIn, DWORD frames, int16_t *pOut)
+{
+    DWORD samples = frames * pFormat->channels;
+
+    if (pFormat->bitsPerSample == 16)
+    {
+        for (DWORD i = 0; i < samples; i++)
+        {
+            pOut[i] = (int16_t)ReadLE16(pIn + i * 2);
+        }
+    }
+    else
+    {
+        for (DWORD i = 0; i < samples; i++)
+        {
+            pOut[i] = (int16_t)(((int)pIn[i] - 128) * 256);
+        }
+    }
+}
+
+/*
+ * Resample
+ * Linear interpolation to the output rate, upmixing mono to stereo. The
+ * position is carried across chunks (and across a loop seam) using the last
+ * frame of the previous chunk, so chunk boundaries are inaudible.
+ */
+static DWORD Resample(AudioStream *pStream, const int16_t *pIn, DWORD inFrames, int16_t *pOut)
+{
+    WORD channels = pStream->format.channels;
+    DWORD produced = 0;
+
+    if (pStream->step == 0x10000)
+    {
+        for (DWORD i = 0; i < inFrames; i++)
+        {
+            pOut[i * 2] = pIn[i * channels];
+            pOut[i * 2 + 1] = pIn[i * channels + channels - 1];
+        }
+        return inFrames;
+    }
+
+    DWORD x = pStream->resamplePos;
+    while ((x >> 16) + 1 <= inFrames)
+    {
+        DWORD j = x >> 16;
+        int frac = (int)((x & 0xFFFF) >> 1); // 15 bits keeps the product in range
+
+        for (DWORD c = 0; c < 2; c++)
+        {
+            DWORD sc = (channels == 1) ? 0 : c;
+            int a = (j == 0) ? pStream->history[sc] : pIn[(j - 1) * channels + sc];
+            int b = pIn[j * channels + sc];
+            pOut[produced * 2 + c] = (int16_t)(a + (((b - a) * frac) >> 15));
+        }
+        produced++;
+        x += pStream->step;
+    }
+
+    pStream->resamplePos = x - (inFrames << 16);
+    pStream->history[0] = pIn[(inFrames - 1) * channels];
+    pStream->history[1] = pIn[(inFrames - 1) * channels + channels - 1];
+    return produced;
+}
+
+static void PushFrames(AudioStream *pStream, const int16_t *pFrames, DWORD frames)
+{
+    DWORD write = pStream->writeFrame.load(std::memory_order_relaxed);
+    DWORD capacity = pStream->ringMask + 1;
+    DWORD index = write & pStream->ringMask;
+    DWORD first = (frames < capacity - index) ? frames : capacity - index;
+
+    memcpy(pStream->pRing + (size_t)index * 2, pFrames, (size_t)first * 2 * sizeof(int16_t));
+    memcpy(pStream->pRing, pFrames + (size_t)first * 2, (size_t)(frames - first) * 2 * sizeof(int16_t));
+    pStream->writeFrame.store(write + frames, std::memory_order_release);
+}
+
+static BOOL StartDecode(AudioStreamManager *pManager, AudioStream *pStream)
+{
+    WaveFormat *pFormat = &pStream->format;
+
+    if (!ParseWaveHeader(&pStream->source, pFormat))
+    {
+        return FALSE;
+    }
+
+    pStream->step = (DWORD)(((uint64_t)pFormat->sampleRate << 16) / pManager->outputRate);
+    if (pStream->step == 0)
+    {
+        return FALSE;
+    }
+    pStream->resamplePos = 0x10000;
+    pStream->history[0] = 0;
+    pStream->history[1] = 0;
+    pStream->dataPos = 0;
+
+    // Largest chunk whose resampled output fits in half the ring
+    uint64_t maxOut = pManager->ringFrames / 2 - 2;
+    uint64_t framesPerRead = maxOut * pFormat->sampleRate / pManager->outputRate;
+    if (framesPerRead > pManager->chunkBytes / pFormat->blockAlign)
+    {
+        framesPerRead = pManager->chunkBytes / pFormat->blockAlign;
+    }
+    if (framesPerRead == 0)
+    {
+        return FALSE;
+    }
+    pStream->readBytes = (DWORD)framesPerRead * pFormat->blockAlign;
+    return TRUE;
+}
+
+/*
+ * FillChunk
+ * Read, decode and resample one chunk if the ring has room for it. Returns
+ * TRUE if work was done.
+ */
+static BOOL FillChunk(AudioStreamManager *pManager, AudioStream *pStream)
+{
+    DWORD used = pStream->writeFrame.load(std::memory_order_relaxed) -
+                 pStream->readFrame.load(std::memory_order_acquire);
+    if (pStream->ringMask + 1 - used < pManager->ringFrames / 2)
+    {
+        return FALSE;
+    }
+
+    WaveFormat *pFormat = &pStream->format;
+    if (pStream->dataPos >= pFormat->dataSize)
+    {
+        if (!pStream->loop || pFormat->dataSize == 0)
+        {
+            pStream->decodeState.store(STREAMSTATE_EOF, std::memory_order_release);
+            return FALSE;
+        }
+        pStream->dataPos = 0; // Seamless: resampler history carries over
+    }
+
+    DWORD bytes = pStream->readBytes;
+    if (bytes > pFormat->dataSize - pStream->dataPos)
+    {
+        bytes = (DWORD)(pFormat->dataSize - pStream->dataPos);
+    }
+
+    DWORD got = 0;
+    if (!pStream->source.pfnRead(pStream->source.pContext, pFormat->dataOffset + pStream->dataPos, pStream->pChunk,
+                                 bytes, &got))
+    {
+        pStream->decodeState.store(STREAMSTATE_FAILED, std::memory_order_release);
+        return FALSE;
+    }
+
+    DWORD frames = got / pFormat->blockAlign;
+    if (frames == 0)
+    {
+        // Truncated archive entry: play what we have
+        pStream->decodeState.store(STREAMSTATE_EOF, std::memory_order_release);
+        return FALSE;
+    }
+
+    DecodePcm(pFormat, pStream->pChunk, frames, pManager->pDecodeScratch);
+    DWORD produced = Resample(pStream, pManager->pDecodeScratch, frames, pManager->pOutScratch);
+    PushFrames(pStream, pManager->pOutScratch, produced);
+
+    pStream->dataPos += (uint64_t)frames * pFormat->blockAlign;
+    pStream->bytesRead.fetch_add(got, std::memory_order_relaxed);
+    pStream->framesDecoded.fetch_add(produced, std::memory_order_relaxed);
+    pStream->chunksRead.fetch_add(1, std::memory_order_relaxed);
+    return TRUE;
+}
+
+static BOOL ServiceStreams(AudioStreamManager *pManager)
+{
+    BOOL didWork = FALSE;
+
+    for (DWORD i = 0; i < pManager->streamCount; i++)
+    {
+        AudioStream *pStream = &pManager->pStreams[i];
+        DWORD slot = pStream->slotState.load(std::memory_order_acquire);
+
+        if (slot == SLOT_CLOSING)
+        {
+            CloseSource(&pStream->source);
+            pStream->slotState.store(SLOT_FREE, std::memory_order_release);
+            continue;
+        }
+        if (slot != SLOT_ACTIVE)
+        {
+            continue;
+        }
+
+        DWORD state = pStream->decodeState.load(std::memory_order_relaxed);
+        if (state == STREAMSTATE_PENDING)
+        {
+            state = StartDecode(pManager, pStream) ? STREAMSTATE_PLAYING : STREAMSTATE_FAILED;
+            pStream->decodeState.store(state, std::memory_order_release);
+            didWork = TRUE;
+        }
+        if (state == STREAMSTATE_PLAYING && FillChunk(pManager, pStream))
+        {
+            didWork = TRUE;
+        }
+    }
+
+    return didWork;
+}
+
+static void WorkerMain(AudioStreamManager *pManager)
+{
+    std::unique_lock<std::mutex> lock(pManager->mutex);
+
+    while (!pManager->stopping)
+    {
+        lock.unlock();
+        BOOL didWork = ServiceStreams(pManager);
+        lock.lock();
+
+        // Keep going while there is work; otherwise idle until the rings drain
+        if (!didWork && !pManager->stopping)
+        {
+            pManager->wake.wait_for(lock, std::chrono::milliseconds(STREAM_IDLE_WAIT_MS));
+        }
+    }
+}
+
+// =============================================================================
+// MIXER PULL (mixer thread)
+// =============================================================================
+
+static DWORD __cdecl StreamRead(void *pContext, int16_t *pOut, DWORD frames)
+{
+    AudioStream *pStream = (AudioStream *)pContext;
+    DWORD read = pStream->readFrame.load(std::memory_order_relaxed);
+    DWORD available = pStream->writeFrame.load(std::memory_order_acquire) - read;
+    DWORD count = (available < frames) ? available : frames;
+    DWORD capacity = pStream->ringMask + 1;
+    DWORD index = read & pStream->ringMask;
+    DWORD first = (count < capacity - index) ? count : capacity - index;
+
+    memcpy(pOut, pStream->pRing + (size_t)index * 2, (size_t)first * 2 * sizeof(int16_t));
+    memcpy(pOut + (size_t)first * 2, pStream->pRing, (size_t)(count - first) * 2 * sizeof(int16_t));
+    pStream->readFrame.store(read + count, std::memory_order_release);
+    pStream->framesPlayed.fetch_add(count, std::memory_order_relaxed);
+
+    if (count == frames)
+    {
+        return frames;
+    }
+
+    // Short ring: end the voice if decoding is over, else pad with silence.
+    // writeFrame is re-read after the state so frames pushed just before EOF
+    // are not dropped.
+    DWORD state = pStream->decodeState.load(std::memory_order_acquire);
+    if ((state == STREAMSTATE_EOF || state == STREAMSTATE_FAILED) &&
+        pStream->writeFrame.load(std::memory_order_acquire) == read + count)
+    {
+        return count;
+    }
+
+    if (state != STREAMSTATE_PENDING)
+    {
+        pStream->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    memset(pOut + (size_t)count * 2, 0, (size_t)(frames - count) * 2 * sizeof(int16_t));
+    return frames;
+}
+
+// =============================================================================
+// MANAGER
+// =============================================================================
+
+AudioStreamManager *__cdecl AUDIOSTREAM_CreateManager(const AudioStreamManagerDesc *pDesc)
+{
+    AudioStreamManagerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    if (pDesc)
+    {
+        desc = *pDesc;
+    }
+
+    AudioStreamManager *pManager = new AudioStreamManager();
+    pManager->memoryBytes = sizeof(AudioStreamManager);
+    pManager->outputRate = desc.outputRate ? desc.outputRate : MIXER_DEFAULT_RATE;
+    pManager->noMusic = desc.noMusic;
+
+    // -ns: nothing to stream, so own nothing
+    if (desc.noSound)
+    {
+        return pManager;
+    }
+
+    pManager->streamCount = desc.maxStreams ? desc.maxStreams : 2;
+    if (pManager->streamCount > AUDIOSTREAM_MAX_STREAMS)
+    {
+        pManager->streamCount = AUDIOSTREAM_MAX_STREAMS;
+    }
+    pManager->chunkBytes = (desc.chunkBytes ? desc.chunkBytes : 16384) & ~3u;
+    if (pManager->chunkBytes < 1024)
+    {
+        pManager->chunkBytes = 1024;
+    }
+    pManager->ringFrames = D2_NextPow2(desc.ringFrames ? desc.ringFrames : 16384);
+    if (pManager->ringFrames < 2 * MIXER_BLOCK_FRAMES)
+    {
+        pManager->ringFrames = 2 * MIXER_BLOCK_FRAMES;
+    }
+
+    size_t chunkSize = pManager->chunkBytes;
+    size_t ringSize = (size_t)pManager->ringFrames * 2 * sizeof(int16_t);
+    size_t decodeSize = (size_t)pManager->chunkBytes * sizeof(int16_t);
+    size_t outSize = ringSize / 2;
+
+    pManager->pStreams = new AudioStream[pManager->streamCount]();
+    pManager->pDecodeScratch = (int16_t *)malloc(decodeSize);
+    pManager->pOutScratch = (int16_t *)malloc(outSize);
+    BOOL ok = pManager->pDecodeScratch && pManager->pOutScratch;
+    pManager->memoryBytes += pManager->streamCount * sizeof(AudioStream) + decodeSize + outSize;
+
+    for (DWORD i = 0; ok && i < pManager->streamCount; i++)
+    {
+        AudioStream *pStream = &pManager->pStreams[i];
+        pStream->pRing = (int16_t *)malloc(ringSize);
+        pStream->pChunk = (BYTE *)malloc(chunkSize);
+        pStream->ringMask = pManager->ringFrames - 1;
+        pStream->mixerStream.pfnRead = StreamRead;
+        pStream->mixerStream.pContext = pStream;
+        pStream->mixerStream.channels = 2;
+        ok = pStream->pRing && pStream->pChunk;
+        pManager->memoryBytes += ringSize + chunkSize;
+    }
+
+    if (ok && !desc.manualPump)
+    {
+        pManager->worker = std::thread(WorkerMain, pManager);
+    }
+    if (!ok)
+    {
+        AUDIOSTREAM_DestroyManager(pManager);
+        return NULL;
+    }
+    return pManager;
+}
+
+void __cdecl AUDIOSTREAM_DestroyManager(AudioStreamManager *pManager)
+{
+    if (!pManager)
+    {
+        return;
+    }
+
+    if (pManager->worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(pManager->mutex);
+            pManager->stopping = TRUE;
+        }
+        pManager->wake.notify_one();
+        pManager->worker.join();
+    }
+
+    for (DWORD i = 0; pManager->pStreams && i < pManager->streamCount; i++)
+    {
+        AudioStream *pStream = &pManager->pStreams[i];
+        if (pStream->slotState.load() != SLOT_FREE)
+        {
+            CloseSource(&pStream->source);
+        }
+        free(pStream->pRing);
+        free(pStream->pChunk);
+    }
+
+    delete[] pManager->pStreams;
+    free(pManager->pDecodeScratch);
+    free(pManager->pOutScratch);
+    delete pManager;
+}
+
+size_t __cdecl AUDIOSTREAM_GetMemoryBudget(const AudioStreamManager *pManager)
+{
+    return pManager->memoryBytes;
+}
+
+static void WakeWorker(AudioStreamManager *pManager)
+{
+    if (pManager->worker.joinable())
+    {
+        pManager->wake.notify_one();
+    }
+}
+
+AudioStream *__cdecl AUDIOSTREAM_Open(AudioStreamManager *pManager, AudioStreamKind kind, const StreamSource *pSource,
+                                      DWORD flags)
+{
+    StreamSource source = *pSource;
+
+    if (kind == AUDIOSTREAM_MUSIC && pManager->noMusic)
+    {
+        CloseSource(&source);
+        return NULL;
+    }
+
+    for (DWORD i = 0; i < pManager->streamCount; i++)
+    {
+        AudioStream *pStream = &pManager->pStreams[i];
+        if (pStream->slotState.load(std::memory_order_acquire) != SLOT_FREE)
+        {
+            continue;
+        }
+
+        // The worker ignores FREE slots, so plain writes are safe until publish
+        pStream->source = source;
+        pStream->loop = (flags & AUDIOSTREAM_LOOP) != 0;
+        pStream->writeFrame.store(0, std::memory_order_relaxed);
+        pStream->readFrame.store(0, std::memory_order_relaxed);
+        pStream->underruns.store(0, std::memory_order_relaxed);
+        pStream->framesPlayed.store(0, std::memory_order_relaxed);
+        pStream->framesDecoded.store(0, std::memory_order_relaxed);
+        pStream->bytesRead.store(0, std::memory_order_relaxed);
+        pStream->chunksRead.store(0, std::memory_order_relaxed);
+        pStream->decodeState.store(STREAMSTATE_PENDING, std::memory_order_relaxed);
+        pStream->slotState.store(SLOT_ACTIVE, std::memory_order_release);
+
+        WakeWorker(pManager);
+        return pStream;
+    }
+
+    // -ns (no slots) or every slot busy
+    CloseSource(&source);
+    return NULL;
+}
+
+void __cdecl AUDIOSTREAM_Close(AudioStreamManager *pManager, AudioStream *pStream)
+{
+    if (!pStream || pStream->slotState.load(std::memory_order_acquire) != SLOT_ACTIVE)
+    {
+        return;
+    }
+
+    if (pManager->worker.joinable())
+    {
+        // The worker owns the source while the slot is active
+        pStream->slotState.store(SLOT_CLOSING, std::memory_order_release);
+        WakeWorker(pManager);
+    }
+    else
+    {
+        CloseSource(&pStream->source);
+        pStream->slotState.store(SLOT_FREE, std::memory_order_release);
+    }
+}
+
+const MixerStream *__cdecl AUDIOSTREAM_GetMixerStream(AudioStream *pStream)
+{
+    return &pStream->mixerStream;
+}
+
+AudioStreamState __cdecl AUDIOSTREAM_GetState(const AudioStream *pStream)
+{
+    return (AudioStreamState)pStream->decodeState.load(std::memory_order_acquire);
+}
+
+void __cdecl AUDIOSTREAM_GetStats(const AudioStream *pStream, AudioStreamStats *pStats)
+{
+    pStats->bytesRead = pStream->bytesRead.load(std::memory_order_relaxed);
+    pStats->framesDecoded = pStream->framesDecoded.load(std::memory_order_relaxed);
+    pStats->framesPlayed = pStream->framesPlayed.load(std::memory_order_relaxed);
+    pStats->chunksRead = pStream->chunksRead.load(std::memory_order_relaxed);
+    pStats->underruns = pStream->underruns.load(std::memory_order_relaxed);
+}
+
+BOOL __cdecl AUDIOSTREAM_Update(AudioStreamManager *pManager)
+{
+    if (pManager->worker.joinable())
+    {
+        return FALSE;
+    }
+    return ServiceStreams(pManager);
+}
@@ -0,0 +1,117 @@
+/*
+ * AudioStream.hpp - D2Sound streaming music and speech decoder
+ *
+ * D2Sound reads a whole WAV through Storm and keeps it resident while it
+ * plays (the act tracks are several megabytes each). Streams here are
+ * decoded a chunk at a time into a small ring of output-rate stereo frames
+ * that the mixer pulls from through a MixerStream.
+ *
+ * Memory: every buffer is allocated once in AUDIOSTREAM_CreateManager -
+ * one compressed chunk and one PCM ring per stream slot, plus decode
+ * scratch shared by all slots. Opening a stream allocates nothing, so the
+ * footprint is the same for a 10 second speech line and an hour-long loop.
+ *
+ * Threading:
+ *   - Game thread: Open/Close/GetState/GetStats. Open performs no I/O.
+ *   - Stream worker (one per manager): parses headers, reads the next chunk
+ *     through the StreamSource while the mixer is still playing the
+ *     previous ones, decodes and resamples it into the ring.
+ *   - Mixer thread: pulls frames through the MixerStream, lock-free. An
+ *     empty ring yields silence (counted as an underrun), never a wait.
+ *
+ * No-sound/no-music: with noSound the manager owns no buffers and no
+ * thread; with noMusic only music opens are refused. A refused Open closes
+ * the source without reading it and returns NULL, so the caller never
+ * reaches the mixer or the audio device.
+ */
+
+#ifndef AUDIOSTREAM_HPP
+#define AUDIOSTREAM_HPP
+
+#include "AudioMixer.hpp"
+
+#define AUDIOSTREAM_MAX_STREAMS 8
+
+// Open flags
+#define AUDIOSTREAM_LOOP 0x0001
+
+typedef enum AudioStreamKind
+{
+    AUDIOSTREAM_MUSIC = 0,
+    AUDIOSTREAM_SPEECH,
+} AudioStreamKind;
+
+typedef enum AudioStreamState
+{
+    STREAMSTATE_PENDING = 0, // Header not parsed yet
+    STREAMSTATE_PLAYING,
+    STREAMSTATE_EOF,    // Source fully decoded; ring may still hold frames
+    STREAMSTATE_FAILED, // Bad header or read error
+} AudioStreamState;
+
+/*
+ * Random-access byte source. In the game this wraps an MPQ file handle
+ * (SFileSetFilePointer + SFileReadFile); file and memory sources are
+ * provided for tools and benchmarks. Called on the stream worker only.
+ */
+typedef struct StreamSource
+{
+    BOOL(__cdecl *pfnRead)(void *pContext, uint64_t offset, void *pBuffer, DWORD bytes, DWORD *pBytesRead);
+    void(__cdecl *pfnClose)(void *pContext); // May be NULL
+    void *pContext;
+} StreamSource;
+
+typedef struct AudioStreamManagerDesc
+{
+    DWORD outputRate; // Mixer rate (0 = MIXER_DEFAULT_RATE)
+    DWORD maxStreams; // Slots (0 = 2: music + speech), clamped to AUDIOSTREAM_MAX_STREAMS
+    DWORD chunkBytes; // Compressed bytes per read (0 = 16 KB)
+    DWORD ringFrames; // Decoded stereo frames per slot (0 = 16384, ~370 ms at 44.1 kHz)
+    BOOL noSound;     // g_noSound / LaunchConfig.no_sound
+    BOOL noMusic;     // g_noMusic / LaunchConfig.no_music
+    BOOL manualPump;  // No worker thread; caller drives AUDIOSTREAM_Update
+} AudioStreamManagerDesc;
+
+typedef struct AudioStreamStats
+{
+    uint64_t bytesRead;
+    uint64_t framesDecoded; // Output-rate frames written to the ring
+    uint64_t framesPlayed;  // Frames pulled by the mixer (excluding silence)
+    DWORD chunksRead;
+    DWORD underruns; // Mixer pulls that found the ring short
+} AudioStreamStats;
+
+typedef struct AudioStream AudioStream;
+typedef struct AudioStreamManager AudioStreamManager;
+
+AudioStreamManager *__cdecl AUDIOSTREAM_CreateManager(const AudioStreamManagerDesc *pDesc);
+void __cdecl AUDIOSTREAM_DestroyManager(AudioStreamManager *pManager);
+
+// Bytes allocated by the manager; fixed at creation
+size_t __cdecl AUDIOSTREAM_GetMemoryBudget(const AudioStreamManager *pManager);
+
+/*
+ * Start streaming a RIFF/WAVE PCM (8/16-bit, mono/stereo) source. Takes
+ * ownership of the source: it is closed by AUDIOSTREAM_Close, or right away
+ * when the stream is refused (kind disabled, no free slot).
+ */
+AudioStream *__cdecl AUDIOSTREAM_Open(AudioStreamManager *pManager, AudioStreamKind kind, const StreamSource *pSource,
+                                      DWORD flags);
+
+// Release the slot. Only after the mixer voice playing it has ended or been stopped.
+void __cdecl AUDIOSTREAM_Close(AudioStreamManager *pManager, AudioStream *pStream);
+
+// Pull interface for MIXER_PlayStream (always stereo at the manager output rate)
+const MixerStream *__cdecl AUDIOSTREAM_GetMixerStream(AudioStream *pStream);
+
+AudioStreamState __cdecl AUDIOSTREAM_GetState(const AudioStream *pStream);
+void __cdecl AUDIOSTREAM_GetStats(const AudioStream *pStream, AudioStreamStats *pStats);
+
+// Service every slot once (manualPump only). Returns TRUE if any chunk was decoded.
+BOOL __cdecl AUDIOSTREAM_Update(AudioStreamManager *pManager);
+
+// Sources. Memory sources do not copy: pData must outlive the stream.
+BOOL __cdecl AUDIOSTREAM_OpenFileSource(StreamSource *pSource, const char *szPath);
+BOOL __cdecl AUDIOSTREAM_OpenMemorySource(StreamSource *pSource, const void *pData, size_t size);
+
+#endif // AUDIOSTREAM_HPP
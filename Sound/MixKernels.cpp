@@ -0,0 +1,235 @@
+/*
+ * MixKernels.cpp - D2Sound mixing kernels
+ *
+ * See MixKernels.hpp. The SSE2 variants process four output frames per
+ * iteration and fall through to the scalar loop for the remainder.
+ */
+
+#include "MixKernels.hpp"
+
+#include <math.h>
+
+// =============================================================================
+// SCALAR KERNELS
+// =============================================================================
+
+static void MixMonoScalar(float *pAccum, const int16_t *pSrc, DWORD frames, const MixGain *pGain)
+{
+    for (DWORD i = 0; i < frames; i++)
+    {
+        float s = (float)pSrc[i];
+        float fi = (float)i;
+        pAccum[i * 2 + 0] += s * (pGain->left + fi * pGain->deltaLeft);
+        pAccum[i * 2 + 1] += s * (pGain->right + fi * pGain->deltaRight);
+    }
+}
+
+static void MixStereoScalar(float *pAccum, const int16_t *pSrc, DWORD frames, const MixGain *pGain)
+{
+    for (DWORD i = 0; i < frames; i++)
+    {
+        float fi = (float)i;
+        pAccum[i * 2 + 0] += (float)pSrc[i * 2 + 0] * (pGain->left + fi * pGain->deltaLeft);
+        pAccum[i * 2 + 1] += (float)pSrc[i * 2 + 1] * (pGain->right + fi * pGain->deltaRight);
+    }
+}
+
+static inline int16_t ClampToPcm16(float value)
+{
+    long v = lrintf(value);
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+    return (int16_t)v;
+}
+
+static void ConvertScalar(int16_t *pOut, const float *pAccum, DWORD samples, float master)
+{
+    for (DWORD i = 0; i < samples; i++)
+    {
+        pOut[i] = ClampToPcm16(pAccum[i] * master);
+    }
+}
+
+// =============================================================================
+// SSE2 KERNELS
+// =============================================================================
+
+#if D2_SIMD_SSE2
+
+// Sign-extend four int16 samples to float
+static inline __m128 LoadPcm16x4(const int16_t *pSrc)
+{
+    __m128i v = _mm_loadl_epi64((const __m128i *)pSrc);
+    v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    return _mm_cvtepi32_ps(v);
+}
+
+static void MixMonoSse2(float *pAccum, const int16_t *pSrc, DWORD frames, const MixGain *pGain)
+{
+    const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 baseL = _mm_set1_ps(pGain->left);
+    const __m128 baseR = _mm_set1_ps(pGain->right);
+    const __m128 deltaL = _mm_set1_ps(pGain->deltaLeft);
+    const __m128 deltaR = _mm_set1_ps(pGain->deltaRight);
+    DWORD i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 fi = _mm_add_ps(lane, _mm_set1_ps((float)i));
+        __m128 gainL = _mm_add_ps(baseL, _mm_mul_ps(fi, deltaL));
+        __m128 gainR = _mm_add_ps(baseR, _mm_mul_ps(fi, deltaR));
+        __m128 s = LoadPcm16x4(pSrc + i);
+        __m128 l = _mm_mul_ps(s, gainL);
+        __m128 r = _mm_mul_ps(s, gainR);
+
+        float *pOut = pAccum + i * 2;
+        _mm_storeu_ps(pOut + 0, _mm_add_ps(_mm_loadu_ps(pOut + 0), _mm_unpacklo_ps(l, r)));
+        _mm_storeu_ps(pOut + 4, _mm_add_ps(_mm_loadu_ps(pOut + 4), _mm_unpackhi_ps(l, r)));
+    }
+
+    for (; i < frames; i++)
+    {
+        float s = (float)pSrc[i];
+        float fi = (float)i;
+        pAccum[i * 2 + 0] += s * (pGain->left + fi * pGain->deltaLeft);
+        pAccum[i * 2 + 1] += s * (pGain->right + fi * pGain->deltaRight);
+    }
+}
+
+static void MixStereoSse2(float *pAccum, const int16_t *pSrc, DWORD frames, const MixGain *pGain)
+{
+    const __m128 lane = _mm_set_ps(1.0f, 1.0f, 0.0f, 0.0f);
+    const __m128 base = _mm_set_ps(pGain->right, pGain->left, pGain->right, pGain->left);
+    const __m128 delta = _mm_set_ps(pGain->deltaRight, pGain->deltaLeft, pGain->deltaRight, pGain->deltaLeft);
+    DWORD i = 0;
+
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 fi0 = _mm_add_ps(lane, _mm_set1_ps((float)i));
+        __m128 fi1 = _mm_add_ps(lane, _mm_set1_ps((float)(i + 2)));
+        __m128 gain0 = _mm_add_ps(base, _mm_mul_ps(fi0, delta));
+        __m128 gain1 = _mm_add_ps(base, _mm_mul_ps(fi1, delta));
+        __m128 s0 = LoadPcm16x4(pSrc + i * 2);
+        __m128 s1 = LoadPcm16x4(pSrc + i * 2 + 4);
+
+        float *pOut = pAccum + i * 2;
+        _mm_storeu_ps(pOut + 0, _mm_add_ps(_mm_loadu_ps(pOut + 0), _mm_mul_ps(s0, gain0)));
+        _mm_storeu_ps(pOut + 4, _mm_add_ps(_mm_loadu_ps(pOut + 4), _mm_mul_ps(s1, gain1)));
+    }
+
+    for (; i < frames; i++)
+    {
+        float fi = (float)i;
+        pAccum[i * 2 + 0] += (float)pSrc[i * 2 + 0] * (pGain->left + fi * pGain->deltaLeft);
+        pAccum[i * 2 + 1] += (float)pSrc[i * 2 + 1] * (pGain->right + fi * pGain->deltaRight);
+    }
+}
+
+static void ConvertSse2(int16_t *pOut, const float *pAccum, DWORD samples, float master)
+{
+    const __m128 scale = _mm_set1_ps(master);
+    DWORD i = 0;
+
+    // cvtps rounds to nearest-even like lrintf; packs saturates like the clamp
+    for (; i + 8 <= samples; i += 8)
+    {
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(pAccum + i), scale));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(pAccum + i + 4), scale));
+        _mm_storeu_si128((__m128i *)(pOut + i), _mm_packs_epi32(a, b));
+    }
+
+    for (; i < samples; i++)
+    {
+        pOut[i] = ClampToPcm16(pAccum[i] * master);
+    }
+}
+
+#endif // D2_SIMD_SSE2
+
+// =============================================================================
+// SELECTION
+// =============================================================================
+
+void __cdecl MIXKERNELS_Select(MixKernels *pKernels, BOOL forceScalar)
+{
+    pKernels->pfnMixMono = MixMonoScalar;
+    pKernels->pfnMixStereo = MixStereoScalar;
+    pKernels->pfnConvert = ConvertScalar;
+    pKernels->simd = FALSE;
+
+#if D2_SIMD_SSE2
+    if (!forceScalar)
+    {
+        pKernels->pfnMixMono = MixMonoSse2;
+        pKernels->pfnMixStereo = MixStereoSse2;
+        pKernels->pfnConvert = ConvertSse2;
+        pKernels->simd = TRUE;
+    }
+#else
+    (void)forceScalar;
+#endif
+}
+
+// =============================================================================
+// RESAMPLING
+// =============================================================================
+
+/*
+ * MIXKERNELS_MixResampled
+ * Linear interpolation between neighbouring source frames. D2 effects are
+ * mostly 22050 Hz mono, so this path is only taken for voices whose rate
+ * differs from the output; it is scalar in both kernel sets.
+ */
+DWORD __cdecl MIXKERNELS_MixResampled(float *pAccum, const int16_t *pSrc, DWORD srcFrames, WORD channels,
+                                      uint64_t *pPosition, DWORD step, BOOL loop,
+                                      DWORD frames, const MixGain *pGain)
+{
+    uint64_t pos = *pPosition;
+    uint64_t end = (uint64_t)srcFrames << 16;
+    DWORD i;
+
+    for (i = 0; i < frames; i++)
+    {
+        if (pos >= end)
+        {
+            if (!loop || srcFrames == 0)
+            {
+                break;
+            }
+            pos %= end;
+        }
+
+        DWORD index = (DWORD)(pos >> 16);
+        DWORD next = index + 1;
+        if (next >= srcFrames)
+        {
+            next = loop ? 0 : index;
+        }
+        float frac = (float)(pos & 0xFFFF) * (1.0f / 65536.0f);
+        float fi = (float)i;
+        float gainL = pGain->left + fi * pGain->deltaLeft;
+        float gainR = pGain->right + fi * pGain->deltaRight;
+
+        if (channels == 1)
+        {
+            float a = (float)pSrc[index];
+            float s = a + ((float)pSrc[next] - a) * frac;
+            pAccum[i * 2 + 0] += s * gainL;
+            pAccum[i * 2 + 1] += s * gainR;
+        }
+        else
+        {
+            float aL = (float)pSrc[index * 2 + 0];
+            float aR = (float)pSrc[index * 2 + 1];
+            pAccum[i * 2 + 0] += (aL + ((float)pSrc[next * 2 + 0] - aL) * frac) * gainL;
+            pAccum[i * 2 + 1] += (aR + ((float)pSrc[next * 2 + 1] - aR) * frac) * gainR;
+        }
+
+        pos += step;
+    }
+
+    *pPosition = pos;
+    return i;
+}
@@ -0,0 +1,46 @@
+/*
+ * MixKernels.hpp - D2Sound mixing kernels
+ *
+ * Inner loops of the native mixer. Every kernel accumulates into an
+ * interleaved stereo float buffer with a per-frame linear gain ramp:
+ *     gain(frame i) = gain + i * delta
+ * Scalar and SSE2 variants evaluate exactly the same expression so both
+ * produce bit-identical output.
+ */
+
+#ifndef MIXKERNELS_HPP
+#define MIXKERNELS_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef struct MixGain
+{
+    float left;
+    float right;
+    float deltaLeft; // Per-frame increment
+    float deltaRight;
+} MixGain;
+
+typedef void (*PFN_MixUnitStep)(float *pAccum, const int16_t *pSrc, DWORD frames, const MixGain *pGain);
+typedef void (*PFN_ConvertToPcm16)(int16_t *pOut, const float *pAccum, DWORD samples, float master);
+
+typedef struct MixKernels
+{
+    PFN_MixUnitStep pfnMixMono;   // Mono source, source rate == output rate
+    PFN_MixUnitStep pfnMixStereo; // Stereo source, source rate == output rate
+    PFN_ConvertToPcm16 pfnConvert;
+    BOOL simd;
+} MixKernels;
+
+void __cdecl MIXKERNELS_Select(MixKernels *pKernels, BOOL forceScalar);
+
+/*
+ * Resampling mix (any rate). pPosition is 48.16 fixed point and is advanced;
+ * step is srcRate/dstRate in 16.16. With loop set the read position wraps.
+ * Returns the number of output frames produced before the source ran out.
+ */
+DWORD __cdecl MIXKERNELS_MixResampled(float *pAccum, const int16_t *pSrc, DWORD srcFrames, WORD channels,
+                                      uint64_t *pPosition, DWORD step, BOOL loop,
+                                      DWORD frames, const MixGain *pGain);
+
+#endif // MIXKERNELS_HPP
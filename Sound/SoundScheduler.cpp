@@ -0,0 +1,421 @@
+/*
+ * SoundScheduler.cpp - D2Sound effect scheduler (dedup, culling, voice cap)
+ *
+ * See SoundScheduler.hpp for the per-tick pipeline.
+ */
+
+#include "SoundScheduler.hpp"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Score = priority * PRIORITY_WEIGHT + audibility (0..1): priority always wins
+#define PRIORITY_WEIGHT 2.0f
+// Running voices lose this much score per tick so long sounds yield first
+#define AGE_PENALTY 0.02f
+// A newcomer must beat the victim by this much (avoids steal churn)
+#define STEAL_HYSTERESIS 0.05f
+// Identical events stacked in one tick: +10% each, up to +50%
+#define STACK_BOOST 0.1f
+#define STACK_BOOST_MAX 5
+
+typedef struct SchedVoice
+{
+    DWORD voiceId;
+    DWORD soundId;
+    float score;
+    DWORD startTick;
+    BOOL stopping; // Stolen; waiting for the mixer's ENDED event
+} SchedVoice;
+
+typedef struct SchedCandidate
+{
+    float score;
+    DWORD index;
+} SchedCandidate;
+
+struct SoundScheduler
+{
+    AudioMixer *pMixer;
+    DWORD maxVoices;
+    DWORD maxPerSound;
+    DWORD capacity;
+    float radius;
+    DWORD stealFade;
+    void(__cdecl *pfnOtherEvent)(void *pContext, const MixerEvent *pEvent);
+    void *pEventContext;
+
+    float listenerX;
+    float listenerY;
+    DWORD tick; // Never 0, so a zeroed stamp means "empty"
+
+    // This tick's unique events, structure-of-arrays for the distance pass
+    DWORD count;
+    DWORD *soundIds;
+    const AudioSample **samples;
+    float *x;
+    float *y;
+    float *volume;
+    float *dist2;
+    BYTE *priority;
+    WORD *flags;
+    WORD *stack;
+    SchedCandidate *candidates;
+
+    // Dedup table: sound id -> queue index, valid when stamp == tick
+    DWORD tableMask;
+    DWORD *tableKey;
+    DWORD *tableStamp;
+    DWORD *tableIndex;
+
+    // Running voices plus room for the ones fading out after a steal
+    SchedVoice voices[SCHED_MAX_VOICES * 2];
+    DWORD voiceCount;
+    DWORD activeVoices; // Excludes stopping voices
+
+    SoundSchedulerStats stats;
+};
+
+// =============================================================================
+// CREATION
+// =============================================================================
+
+SoundScheduler *__cdecl SCHED_Create(AudioMixer *pMixer, const SoundSchedulerDesc *pDesc)
+{
+    SoundSchedulerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    if (pDesc)
+    {
+        desc = *pDesc;
+    }
+
+    SoundScheduler *pScheduler = (SoundScheduler *)calloc(1, sizeof(SoundScheduler));
+    if (!pScheduler)
+    {
+        return NULL;
+    }
+
+    pScheduler->pMixer = pMixer;
+    pScheduler->maxVoices = desc.maxVoices ? desc.maxVoices : 24;
+    if (pScheduler->maxVoices > SCHED_MAX_VOICES)
+    {
+        pScheduler->maxVoices = SCHED_MAX_VOICES;
+    }
+    pScheduler->maxPerSound = desc.maxPerSound ? desc.maxPerSound : 3;
+    pScheduler->capacity = desc.queueCapacity ? desc.queueCapacity : 512;
+    pScheduler->radius = desc.audibleRadius > 0.0f ? desc.audibleRadius : 40.0f;
+    pScheduler->stealFade = desc.stealFadeFrames ? desc.stealFadeFrames : 256;
+    pScheduler->pfnOtherEvent = desc.pfnOtherEvent;
+    pScheduler->pEventContext = desc.pEventContext;
+    pScheduler->tick = 1;
+
+    DWORD n = pScheduler->capacity;
+    DWORD tableSize = D2_NextPow2(n * 2);
+    pScheduler->soundIds = (DWORD *)malloc(n * sizeof(DWORD));
+    pScheduler->samples = (const AudioSample **)malloc(n * sizeof(const AudioSample *));
+    pScheduler->x = (float *)malloc(n * sizeof(float));
+    pScheduler->y = (float *)malloc(n * sizeof(float));
+    pScheduler->volume = (float *)malloc(n * sizeof(float));
+    pScheduler->dist2 = (float *)malloc(n * sizeof(float));
+    pScheduler->priority = (BYTE *)malloc(n);
+    pScheduler->flags = (WORD *)malloc(n * sizeof(WORD));
+    pScheduler->stack = (WORD *)malloc(n * sizeof(WORD));
+    pScheduler->candidates = (SchedCandidate *)malloc(n * sizeof(SchedCandidate));
+    pScheduler->tableMask = tableSize - 1;
+    pScheduler->tableKey = (DWORD *)calloc(tableSize, sizeof(DWORD));
+    pScheduler->tableStamp = (DWORD *)calloc(tableSize, sizeof(DWORD));
+    pScheduler->tableIndex = (DWORD *)calloc(tableSize, sizeof(DWORD));
+
+    if (!pScheduler->soundIds || !pScheduler->samples || !pScheduler->x || !pScheduler->y || !pScheduler->volume ||
+        !pScheduler->dist2 || !pScheduler->priority || !pScheduler->flags || !pScheduler->stack ||
+        !pScheduler->candidates || !pScheduler->tableKey || !pScheduler->tableStamp || !pScheduler->tableIndex)
+    {
+        SCHED_Destroy(pScheduler);
+        return NULL;
+    }
+
+    return pScheduler;
+}
+
+void __cdecl SCHED_Destroy(SoundScheduler *pScheduler)
+{
+    if (!pScheduler)
+    {
+        return;
+    }
+
+    free(pScheduler->soundIds);
+    free((void *)pScheduler->samples);
+    free(pScheduler->x);
+    free(pScheduler->y);
+    free(pScheduler->volume);
+    free(pScheduler->dist2);
+    free(pScheduler->priority);
+    free(pScheduler->flags);
+    free(pScheduler->stack);
+    free(pScheduler->candidates);
+    free(pScheduler->tableKey);
+    free(pScheduler->tableStamp);
+    free(pScheduler->tableIndex);
+    free(pScheduler);
+}
+
+void __cdecl SCHED_SetListener(SoundScheduler *pScheduler, float x, float y)
+{
+    pScheduler->listenerX = x;
+    pScheduler->listenerY = y;
+}
+
+// =============================================================================
+// QUEUE
+// =============================================================================
+
+BOOL __cdecl SCHED_Queue(SoundScheduler *pScheduler, DWORD soundId, const AudioSample *pSample, float x, float y,
+                         float volume, DWORD priority, DWORD flags)
+{
+    pScheduler->stats.queued++;
+
+    DWORD slot = D2_HashDword(soundId) & pScheduler->tableMask;
+    while (pScheduler->tableStamp[slot] == pScheduler->tick && pScheduler->tableKey[slot] != soundId)
+    {
+        slot = (slot + 1) & pScheduler->tableMask;
+    }
+
+    if (pScheduler->tableStamp[slot] == pScheduler->tick)
+    {
+        // Same effect already queued this tick: keep the nearest, loudest instance
+        DWORD i = pScheduler->tableIndex[slot];
+        float dx = x - pScheduler->listenerX, dy = y - pScheduler->listenerY;
+        float ox = pScheduler->x[i] - pScheduler->listenerX, oy = pScheduler->y[i] - pScheduler->listenerY;
+        if (dx * dx + dy * dy < ox * ox + oy * oy)
+        {
+            pScheduler->x[i] = x;
+            pScheduler->y[i] = y;
+        }
+        if (volume > pScheduler->volume[i])
+            pScheduler->volume[i] = volume;
+        if (priority > pScheduler->priority[i])
+            pScheduler->priority[i] = (BYTE)priority;
+        pScheduler->flags[i] |= (WORD)flags;
+        pScheduler->stack[i]++;
+        pScheduler->stats.merged++;
+        return TRUE;
+    }
+
+    if (pScheduler->count == pScheduler->capacity || !pSample)
+    {
+        pScheduler->stats.overflow++;
+        return FALSE;
+    }
+
+    DWORD i = pScheduler->count++;
+    pScheduler->tableStamp[slot] = pScheduler->tick;
+    pScheduler->tableKey[slot] = soundId;
+    pScheduler->tableIndex[slot] = i;
+
+    pScheduler->soundIds[i] = soundId;
+    pScheduler->samples[i] = pSample;
+    pScheduler->x[i] = x;
+    pScheduler->y[i] = y;
+    pScheduler->volume[i] = volume;
+    pScheduler->priority[i] = (BYTE)priority;
+    pScheduler->flags[i] = (WORD)flags;
+    pScheduler->stack[i] = 1;
+    return TRUE;
+}
+
+// =============================================================================
+// FLUSH
+// =============================================================================
+
+static void RemoveVoice(SoundScheduler *pScheduler, DWORD index)
+{
+    if (!pScheduler->voices[index].stopping)
+    {
+        pScheduler->activeVoices--;
+    }
+    pScheduler->voices[index] = pScheduler->voices[--pScheduler->voiceCount];
+}
+
+static void DrainMixerEvents(SoundScheduler *pScheduler)
+{
+    MixerEvent event;
+
+    while (MIXER_PollEvent(pScheduler->pMixer, &event))
+    {
+        DWORD i = 0;
+        while (i < pScheduler->voiceCount && pScheduler->voices[i].voiceId != event.voiceId)
+        {
+            i++;
+        }
+
+        if (i < pScheduler->voiceCount)
+        {
+            RemoveVoice(pScheduler, i);
+        }
+        else if (pScheduler->pfnOtherEvent)
+        {
+            pScheduler->pfnOtherEvent(pScheduler->pEventContext, &event);
+        }
+    }
+}
+
+static int CompareCandidates(const void *pA, const void *pB)
+{
+    float a = ((const SchedCandidate *)pA)->score;
+    float b = ((const SchedCandidate *)pB)->score;
+    return (a < b) - (a > b); // Descending
+}
+
+static DWORD CountInstances(const SoundScheduler *pScheduler, DWORD soundId)
+{
+    DWORD n = 0;
+    for (DWORD i = 0; i < pScheduler->voiceCount; i++)
+    {
+        if (pScheduler->voices[i].soundId == soundId && !pScheduler->voices[i].stopping)
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+/*
+ * FindVictim
+ * Weakest running voice by aged score, or -1 if none is weak enough to lose
+ * to a newcomer scoring `score`.
+ */
+static int FindVictim(const SoundScheduler *pScheduler, float score)
+{
+    int victim = -1;
+    float weakest = score - STEAL_HYSTERESIS;
+
+    for (DWORD i = 0; i < pScheduler->voiceCount; i++)
+    {
+        const SchedVoice *pVoice = &pScheduler->voices[i];
+        if (pVoice->stopping)
+        {
+            continue;
+        }
+        float aged = pVoice->score - (float)(pScheduler->tick - pVoice->startTick) * AGE_PENALTY;
+        if (aged < weakest)
+        {
+            weakest = aged;
+            victim = (int)i;
+        }
+    }
+    return victim;
+}
+
+void __cdecl SCHED_Flush(SoundScheduler *pScheduler)
+{
+    DrainMixerEvents(pScheduler);
+
+    DWORD count = pScheduler->count;
+    float lx = pScheduler->listenerX;
+    float ly = pScheduler->listenerY;
+    float radius = pScheduler->radius;
+    float radius2 = radius * radius;
+
+    // Distance pass over packed arrays; no branches so it vectorizes
+    for (DWORD i = 0; i < count; i++)
+    {
+        float dx = pScheduler->x[i] - lx;
+        float dy = pScheduler->y[i] - ly;
+        pScheduler->dist2[i] = dx * dx + dy * dy;
+    }
+
+    // Score the survivors; attenuation is only computed for these
+    DWORD candidates = 0;
+    for (DWORD i = 0; i < count; i++)
+    {
+        BOOL global = (pScheduler->flags[i] & SOUNDEVT_GLOBAL) != 0;
+        if (!global && pScheduler->dist2[i] >= radius2)
+        {
+            pScheduler->stats.culledDistance++;
+            continue;
+        }
+
+        float attenuation = global ? 1.0f : 1.0f - sqrtf(pScheduler->dist2[i]) / radius;
+        DWORD stacked = pScheduler->stack[i] - 1;
+        float boost = 1.0f + STACK_BOOST * (float)(stacked < STACK_BOOST_MAX ? stacked : STACK_BOOST_MAX);
+        float gain = pScheduler->volume[i] * attenuation * boost;
+        if (gain > 1.0f)
+        {
+            gain = 1.0f;
+        }
+
+        pScheduler->volume[i] = gain;
+        pScheduler->candidates[candidates].score = (float)pScheduler->priority[i] * PRIORITY_WEIGHT + gain;
+        pScheduler->candidates[candidates].index = i;
+        candidates++;
+    }
+
+    qsort(pScheduler->candidates, candidates, sizeof(SchedCandidate), CompareCandidates);
+
+    for (DWORD c = 0; c < candidates; c++)
+    {
+        DWORD i = pScheduler->candidates[c].index;
+        float score = pScheduler->candidates[c].score;
+        DWORD soundId = pScheduler->soundIds[i];
+
+        if (CountInstances(pScheduler, soundId) >= pScheduler->maxPerSound ||
+            pScheduler->voiceCount == D2_ARRAY_SIZE(pScheduler->voices))
+        {
+            pScheduler->stats.culledBudget++;
+            continue;
+        }
+
+        if (pScheduler->activeVoices >= pScheduler->maxVoices)
+        {
+            int victim = FindVictim(pScheduler, score);
+            if (victim < 0)
+            {
+                pScheduler->stats.culledBudget++;
+                continue;
+            }
+            MIXER_StopVoice(pScheduler->pMixer, pScheduler->voices[victim].voiceId, pScheduler->stealFade);
+            pScheduler->voices[victim].stopping = TRUE;
+            pScheduler->activeVoices--;
+            pScheduler->stats.stolen++;
+        }
+
+        float pan = 0.0f;
+        if (!(pScheduler->flags[i] & SOUNDEVT_GLOBAL))
+        {
+            pan = (pScheduler->x[i] - lx) / radius;
+        }
+
+        DWORD voiceId = MIXER_Play(pScheduler->pMixer, pScheduler->samples[i], pScheduler->volume[i], pan,
+                                   pScheduler->priority[i], 0, 0);
+        if (!voiceId)
+        {
+            pScheduler->stats.culledBudget++;
+            continue;
+        }
+
+        SchedVoice *pVoice = &pScheduler->voices[pScheduler->voiceCount++];
+        pVoice->voiceId = voiceId;
+        pVoice->soundId = soundId;
+        pVoice->score = score;
+        pVoice->startTick = pScheduler->tick;
+        pVoice->stopping = FALSE;
+        pScheduler->activeVoices++;
+        pScheduler->stats.played++;
+    }
+
+    // New tick: stamps from this one no longer match, so the table needs no clearing
+    pScheduler->count = 0;
+    if (++pScheduler->tick == 0)
+    {
+        memset(pScheduler->tableStamp, 0, (pScheduler->tableMask + 1) * sizeof(DWORD));
+        pScheduler->tick = 1;
+    }
+}
+
+void __cdecl SCHED_GetStats(const SoundScheduler *pScheduler, SoundSchedulerStats *pStats)
+{
+    *pStats = pScheduler->stats;
+    pStats->activeVoices = pScheduler->activeVoices;
+}
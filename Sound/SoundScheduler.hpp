@@ -0,0 +1,75 @@
+/*
+ * SoundScheduler.hpp - D2Sound effect scheduler (dedup, culling, voice cap)
+ *
+ * D2Sound computes positional bias for every queued effect and hands each one
+ * to DirectSound, so a pack of monsters hitting in the same frame becomes
+ * dozens of identical voices. The scheduler sits between game code and the
+ * mixer and does the triage once per game tick:
+ *
+ *   1. Queue: identical sounds queued in the same tick are merged into one
+ *      event (nearest position, loudest volume, small stacking boost).
+ *   2. Cull: unique events beyond the audible radius are dropped before any
+ *      pan/attenuation work; the distance pass runs over packed x/y arrays.
+ *   3. Select: survivors are scored (priority first, then audibility) and
+ *      started best-first under a global voice cap and a per-sound cap.
+ *   4. Steal: when the cap is reached, a better event replaces the weakest
+ *      running voice (score aged by how long it has played) with a short fade.
+ *
+ * Game thread only. SCHED_Flush also drains the mixer event ring; events for
+ * voices the scheduler did not start are forwarded to pfnOtherEvent.
+ */
+
+#ifndef SOUNDSCHEDULER_HPP
+#define SOUNDSCHEDULER_HPP
+
+#include "AudioMixer.hpp"
+
+#define SCHED_MAX_VOICES 64
+
+// Queue flags
+#define SOUNDEVT_GLOBAL 0x0001 // UI/speech: no position, never distance-culled
+
+typedef struct SoundSchedulerDesc
+{
+    DWORD maxVoices;       // Concurrent scheduled voices (0 = 24), clamped to SCHED_MAX_VOICES
+    DWORD maxPerSound;     // Concurrent voices of one sound id (0 = 3)
+    DWORD queueCapacity;   // Unique events per tick (0 = 512)
+    float audibleRadius;   // Distance at which attenuation reaches zero (0 = 40)
+    DWORD stealFadeFrames; // Fade applied to stolen voices (0 = 256)
+    void(__cdecl *pfnOtherEvent)(void *pContext, const MixerEvent *pEvent);
+    void *pEventContext;
+} SoundSchedulerDesc;
+
+typedef struct SoundSchedulerStats
+{
+    uint64_t queued;         // SCHED_Queue calls
+    uint64_t merged;         // Folded into an identical event this tick
+    uint64_t overflow;       // Queue full this tick
+    uint64_t culledDistance; // Out of range
+    uint64_t culledBudget;   // Lost the score contest (voice or per-sound cap)
+    uint64_t played;
+    uint64_t stolen; // Running voices replaced by better events
+    DWORD activeVoices;
+} SoundSchedulerStats;
+
+typedef struct SoundScheduler SoundScheduler;
+
+SoundScheduler *__cdecl SCHED_Create(AudioMixer *pMixer, const SoundSchedulerDesc *pDesc);
+void __cdecl SCHED_Destroy(SoundScheduler *pScheduler);
+
+void __cdecl SCHED_SetListener(SoundScheduler *pScheduler, float x, float y);
+
+/*
+ * Queue an effect for this tick. soundId identifies the effect (sounds.txt
+ * row); events with the same id in one tick are merged. Returns FALSE if the
+ * event was dropped because the tick's queue is full.
+ */
+BOOL __cdecl SCHED_Queue(SoundScheduler *pScheduler, DWORD soundId, const AudioSample *pSample, float x, float y,
+                         float volume, DWORD priority, DWORD flags);
+
+// Once per game tick: cull, select and start voices, then reset the queue
+void __cdecl SCHED_Flush(SoundScheduler *pScheduler);
+
+void __cdecl SCHED_GetStats(const SoundScheduler *pScheduler, SoundSchedulerStats *pStats);
+
+#endif // SOUNDSCHEDULER_HPP
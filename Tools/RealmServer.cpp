@@ -0,0 +1,163 @@
+/*
+ * RealmServer.cpp - d2realm, local realm server and client swarm
+ *
+ * Usage: d2realm serve [-address a.b.c.d] [-port n] [-threads n] [-shards n] [-seconds n]
+ *        d2realm swarm [-host a.b.c.d] [-port n] [-clients n] [-threads n] [-channels n]
+ *                      [-spread ms] [-lines n] [-interval ms] [-prefix name]
+ *
+ * serve runs the realm until killed (or for -seconds) and prints its
+ * counters every five seconds. swarm runs one RealmSwarm against a realm
+ * and prints the results; it exits nonzero if any client failed.
+ */
+
+#include "../Realm/RealmServer.hpp"
+#include "../Realm/RealmSwarm.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#define DEFAULT_PORT 6112
+#define REPORT_SECONDS 5
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: d2realm serve [-address a.b.c.d] [-port n] [-threads n] [-shards n] [-seconds n]\n"
+                    "                     [-chatrate n] [-burst n] [-history n] [-iprate n] [-subnetrate n]\n"
+                    "                     [-serverrate n]\n"
+                    "       d2realm swarm [-host a.b.c.d] [-port n] [-clients n] [-threads n] [-channels n]\n"
+                    "                     [-spread ms] [-lines n] [-talkers n] [-interval ms] [-prefix name]\n");
+}
+
+// Value of "-name value" in argv, or NULL
+static const char *Option(int argc, char **argv, const char *szName)
+{
+    for (int i = 2; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], szName) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+    return NULL;
+}
+
+static DWORD NumberOption(int argc, char **argv, const char *szName, DWORD defaultValue)
+{
+    const char *szValue = Option(argc, argv, szName);
+    return szValue ? (DWORD)strtoul(szValue, NULL, 10) : defaultValue;
+}
+
+static int Serve(int argc, char **argv)
+{
+    RealmServerDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szAddress = Option(argc, argv, "-address");
+    desc.port = (WORD)NumberOption(argc, argv, "-port", DEFAULT_PORT);
+    desc.threads = NumberOption(argc, argv, "-threads", 0);
+    desc.shards = NumberOption(argc, argv, "-shards", 0);
+    desc.chatRate = NumberOption(argc, argv, "-chatrate", 0);
+    desc.chatBurst = NumberOption(argc, argv, "-burst", 0);
+    desc.historyLines = NumberOption(argc, argv, "-history", 0);
+    DWORD seconds = NumberOption(argc, argv, "-seconds", 0);
+
+    // Any of the rates turns admission control on; the others keep their defaults
+    AdmissionDesc admission;
+    memset(&admission, 0, sizeof(admission));
+    admission.ipRate = NumberOption(argc, argv, "-iprate", 0);
+    admission.subnetRate = NumberOption(argc, argv, "-subnetrate", 0);
+    admission.globalRate = NumberOption(argc, argv, "-serverrate", 0);
+    if (admission.ipRate || admission.subnetRate || admission.globalRate)
+    {
+        desc.pAdmission = &admission;
+    }
+
+    RealmServer *pServer = REALMSRV_Create(&desc);
+    if (!pServer)
+    {
+        fprintf(stderr, "d2realm: cannot listen on port %u\n", desc.port);
+        return 1;
+    }
+    printf("d2realm: listening on port %u\n", REALMSRV_GetPort(pServer));
+    fflush(stdout);
+
+    for (DWORD elapsed = 0; seconds == 0 || elapsed < seconds; elapsed += REPORT_SECONDS)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(REPORT_SECONDS));
+        RealmServerStats stats;
+        REALMSRV_GetStats(pServer, &stats);
+        printf("connections %u  games %u  channels %u  logons %llu  joins %llu  chat %llu -> %llu  drops %llu\n",
+               stats.connections, stats.games, stats.channels, (unsigned long long)stats.logons,
+               (unsigned long long)(stats.gamesJoined + stats.gamesCreated), (unsigned long long)stats.chatLines,
+               (unsigned long long)stats.chatDeliveries, (unsigned long long)stats.slowDrops);
+        AdmissionStats admitted;
+        if (REALMSRV_GetAdmissionStats(pServer, &admitted))
+        {
+            printf("admission: %llu admitted, refused %llu banned / %llu address / %llu subnet / %llu server / "
+                   "%llu table full, %u bans active\n",
+                   (unsigned long long)admitted.admitted, (unsigned long long)admitted.refused[ADMIT_BANNED],
+                   (unsigned long long)admitted.refused[ADMIT_IP_RATE],
+                   (unsigned long long)admitted.refused[ADMIT_SUBNET_RATE],
+                   (unsigned long long)admitted.refused[ADMIT_GLOBAL_RATE],
+                   (unsigned long long)admitted.refused[ADMIT_TABLE_FULL], admitted.activeBans);
+        }
+        fflush(stdout);
+    }
+    REALMSRV_Destroy(pServer);
+    return 0;
+}
+
+static int Swarm(int argc, char **argv)
+{
+    RealmSwarmDesc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.szHost = Option(argc, argv, "-host");
+    if (!desc.szHost)
+    {
+        desc.szHost = "127.0.0.1";
+    }
+    desc.port = (WORD)NumberOption(argc, argv, "-port", DEFAULT_PORT);
+    desc.szPrefix = Option(argc, argv, "-prefix");
+    desc.clients = NumberOption(argc, argv, "-clients", 1000);
+    desc.threads = NumberOption(argc, argv, "-threads", 1);
+    desc.channels = NumberOption(argc, argv, "-channels", 1);
+    desc.connectSpreadMs = NumberOption(argc, argv, "-spread", 0);
+    desc.chatLines = NumberOption(argc, argv, "-lines", 0);
+    desc.talkers = NumberOption(argc, argv, "-talkers", 0);
+    desc.chatIntervalMs = NumberOption(argc, argv, "-interval", 0);
+
+    RealmSwarmStats stats;
+    BOOL ok = REALMSWARM_Run(&desc, &stats);
+    printf("clients %u: ready %u, failed %u, %llu requests\n", desc.clients, stats.ready, stats.failed,
+           (unsigned long long)stats.requests);
+    printf("login: %u ms for all; p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", stats.loginPhaseMs,
+           stats.loginP50Us / 1000.0, stats.loginP99Us / 1000.0, stats.loginMaxUs / 1000.0);
+    printf("games: %llu created, %llu joined, %llu retried after filling up\n",
+           (unsigned long long)stats.gamesCreated, (unsigned long long)stats.gamesJoined,
+           (unsigned long long)stats.fullRetries);
+    if (desc.chatLines)
+    {
+        printf("chat: %llu lines sent (%llu throttled), %llu received in %u ms; p50 %.2f ms, p99 %.2f ms, "
+               "max %.2f ms\n",
+               (unsigned long long)stats.chatSent, (unsigned long long)stats.chatThrottled,
+               (unsigned long long)stats.chatReceived, stats.chatPhaseMs,
+               stats.chatP50Us / 1000.0, stats.chatP99Us / 1000.0, stats.chatMaxUs / 1000.0);
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "serve") == 0)
+    {
+        return Serve(argc, argv);
+    }
+    if (argc >= 2 && strcmp(argv[1], "swarm") == 0)
+    {
+        return Swarm(argc, argv);
+    }
+    Usage();
+    return 2;
+}
@@ -0,0 +1,129 @@
+/*
+ * TableCompiler.cpp - d2tablec, compiles D2Common excel tables to .d2t
+ *
+ * Usage: d2tablec <output-dir> <table.txt>...
+ *
+ * The schema is picked from the file name (missiles.txt -> "missiles"). All
+ * tables are parsed before any is compiled so cross-table links resolve; pass
+ * link targets (e.g. missiles.txt for skills.txt) in the same invocation.
+ */
+
+#include "../Common/DataTableCompiler.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *ReadWholeFile(const char *szPath, size_t *pLength)
+{
+    FILE *pFile = fopen(szPath, "rb");
+    if (!pFile)
+    {
+        return NULL;
+    }
+
+    fseek(pFile, 0, SEEK_END);
+    long size = ftell(pFile);
+    fseek(pFile, 0, SEEK_SET);
+
+    char *pText = (size >= 0) ? (char *)malloc((size_t)size + 1) : NULL;
+    if (pText && fread(pText, 1, (size_t)size, pFile) != (size_t)size)
+    {
+        free(pText);
+        pText = NULL;
+    }
+    fclose(pFile);
+
+    if (pText)
+    {
+        pText[size] = '\0';
+        *pLength = (size_t)size;
+    }
+    return pText;
+}
+
+// "data\global\excel\Missiles.txt" -> "missiles"
+static void TableNameFromPath(const char *szPath, char *szName, size_t size)
+{
+    const char *pBase = szPath;
+    for (const char *p = szPath; *p; p++)
+    {
+        if (*p == '/' || *p == '\\')
+        {
+            pBase = p + 1;
+        }
+    }
+
+    size_t i = 0;
+    while (pBase[i] && pBase[i] != '.' && i + 1 < size)
+    {
+        char c = pBase[i];
+        szName[i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        i++;
+    }
+    szName[i] = '\0';
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: d2tablec <output-dir> <table.txt>...\n");
+        return 2;
+    }
+
+    DataCompiler *pCompiler = DATACOMPILER_Create();
+    const DataTableSchema *schemas[64];
+    DWORD schemaCount = 0;
+    int result = 0;
+
+    for (int i = 2; i < argc && schemaCount < D2_ARRAY_SIZE(schemas); i++)
+    {
+        char szName[DATATABLE_NAME_LENGTH];
+        TableNameFromPath(argv[i], szName, sizeof(szName));
+
+        const DataTableSchema *pSchema = DATACOMPILER_FindSchema(szName);
+        if (!pSchema)
+        {
+            printf("skip     %s (no schema for '%s')\n", argv[i], szName);
+            continue;
+        }
+
+        size_t length = 0;
+        char *pText = ReadWholeFile(argv[i], &length);
+        if (!pText || !DATACOMPILER_AddTable(pCompiler, pSchema, pText, length))
+        {
+            fprintf(stderr, "error    %s: %s\n", argv[i], pText ? DATACOMPILER_GetError(pCompiler) : "cannot read");
+            free(pText);
+            result = 1;
+            continue;
+        }
+        free(pText);
+        schemas[schemaCount++] = pSchema;
+    }
+
+    for (DWORD s = 0; s < schemaCount; s++)
+    {
+        char szPath[1024];
+        snprintf(szPath, sizeof(szPath), "%s/%s.d2t", argv[1], schemas[s]->szName);
+
+        if (DATACOMPILER_WriteFile(pCompiler, schemas[s]->szName, szPath))
+        {
+            printf("compiled %s\n", szPath);
+        }
+        else
+        {
+            fprintf(stderr, "error    %s\n", DATACOMPILER_GetError(pCompiler));
+            result = 1;
+        }
+    }
+
+    if (DATACOMPILER_GetWarningCount(pCompiler))
+    {
+        printf("%u warnings (last: %s)\n", DATACOMPILER_GetWarningCount(pCompiler),
+               DATACOMPILER_GetLastWarning(pCompiler));
+    }
+
+    DATACOMPILER_Destroy(pCompiler);
+    return result;
+}
@@ -0,0 +1,847 @@
+/*
+ * SmackPlayer.cpp - D2Video threaded Smacker playback
+ *
+ * See SmackPlayer.hpp for the threading model.
+ *
+ * Frames move through a ring of frameSlots slots, each holding a decoded
+ * index picture and its palette in XRGB. The decode thread owns the
+ * running picture the bitstream updates; once a frame is decoded it is
+ * copied into slot (frame % frameSlots), so the thread can go on with the
+ * next frame while NextFrame converts this one.
+ *
+ * Conversion works a band of output rows at a time. For each output row
+ * the two source rows it falls between are looked up through the palette,
+ * scaled to the output width and blended; a band keeps the last two scaled
+ * rows, so when upscaling each source row is scaled once per band rather
+ * than once per output row that uses it.
+ */
+
+#include "SmackPlayer.hpp"
+#include "VideoKernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_OUTPUT_WIDTH 800  // g_screenWidth
+#define DEFAULT_OUTPUT_HEIGHT 600 // g_screenHeight
+#define DEFAULT_OUTPUT_BITS 32    // g_colorDepth
+#define DEFAULT_FRAME_SLOTS 3
+#define DEFAULT_AUDIO_RING_FRAMES 32768
+
+#define NO_ROW 0xFFFFFFFFu
+
+typedef struct FrameSlot
+{
+    BYTE *pIndices; // width x height
+    DWORD palette[256];
+} FrameSlot;
+
+typedef struct PlayerTrack
+{
+    // Ring positions are free-running frame counters
+    std::atomic<DWORD> writeFrame; // Decode side
+    BYTE pad0[64 - sizeof(std::atomic<DWORD>)];
+    std::atomic<DWORD> readFrame; // Mixer
+    BYTE pad1[64 - sizeof(std::atomic<DWORD>)];
+
+    std::atomic<DWORD> underruns;
+    std::atomic<uint64_t> queued;
+    std::atomic<uint64_t> dropped;
+
+    SmackPlayer *pPlayer;
+    BOOL active;
+    int16_t *pRing; // Interleaved stereo
+    DWORD ringMask;
+    MixerStream mixerStream;
+
+    // Decode side: one audio job at a time per track
+    WORD channels;
+    DWORD step;         // 16.16 source frames per output frame
+    DWORD resamplePos;  // 16.16, relative to the frame before the current chunk
+    int16_t history[2]; // Last source frame of the previous chunk
+    int16_t *pSamples;
+    DWORD samplesCapacity;
+    int16_t *pFrames; // Resampled stereo
+    DWORD framesCapacity;
+} PlayerTrack;
+
+typedef struct BandScratch
+{
+    DWORD firstRow;
+    DWORD endRow;
+    DWORD *pExpanded; // Source width + 1
+    DWORD *pRows[2];  // Scaled to the region width
+    DWORD rowIds[2];
+    DWORD *pBlend; // 16-bit output only
+} BandScratch;
+
+typedef struct PlayerJob
+{
+    void (*pfnRun)(SmackPlayer *pPlayer, DWORD arg);
+    DWORD arg;
+    DWORD *pPending; // Guarded by poolMutex
+} PlayerJob;
+
+struct SmackPlayer
+{
+    SmackerFile *pFile;
+    SmackerInfo info;
+    VideoKernels kernels;
+    BOOL synchronous;
+
+    // Output geometry
+    DWORD outputWidth;
+    DWORD outputHeight;
+    DWORD bytesPerPixel;
+    DWORD regionX; // Picture area inside the output; the rest is black
+    DWORD regionY;
+    DWORD regionWidth;
+    DWORD regionHeight;
+    DWORD rowShift; // 1 when each source row is shown twice
+    BOOL identityColumns;
+    BOOL smooth;
+    VideoTap *pColumnTaps;
+    VideoTap *pRowTaps;
+
+    // Decode side
+    BYTE *pPicture;
+    BYTE palette[SMACKER_PALETTE_BYTES];
+    SmackerPacket packet;
+    DWORD nextFrame;
+
+    FrameSlot *pSlots;
+    DWORD slotCount;
+    std::mutex mutex;
+    std::condition_variable slotReady;
+    std::condition_variable slotFreed;
+    DWORD decoded; // Guarded by mutex
+    DWORD shown;   // Guarded by mutex; written by the NextFrame thread only
+    BOOL stopping; // Guarded by mutex
+    std::atomic<BOOL> decodeDone;
+    std::thread decoder;
+
+    // Workers
+    std::vector<std::thread> workers;
+    std::mutex poolMutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    std::deque<PlayerJob> jobs;
+    BOOL poolStopping;
+
+    // Frame being converted
+    BandScratch *pBands;
+    DWORD bandCount;
+    const FrameSlot *pConvertSlot;
+    BYTE *pConvertDest;
+    DWORD convertPitch;
+
+    PlayerTrack tracks[SMACKER_MAX_TRACKS];
+
+    std::atomic<DWORD> framesDecoded;
+    std::atomic<DWORD> framesShown;
+    std::atomic<DWORD> framesCorrupt;
+    std::atomic<uint64_t> decodeMicros;
+    std::atomic<uint64_t> convertMicros;
+};
+
+static uint64_t NowMicros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// =============================================================================
+// JOBS
+// =============================================================================
+
+static void WorkerMain(SmackPlayer *pPlayer)
+{
+    std::unique_lock<std::mutex> lock(pPlayer->poolMutex);
+
+    for (;;)
+    {
+        pPlayer->jobReady.wait(lock, [pPlayer] { return pPlayer->poolStopping || !pPlayer->jobs.empty(); });
+        if (pPlayer->jobs.empty())
+        {
+            return;
+        }
+
+        PlayerJob job = pPlayer->jobs.front();
+        pPlayer->jobs.pop_front();
+        lock.unlock();
+        job.pfnRun(pPlayer, job.arg);
+        lock.lock();
+
+        if (--*job.pPending == 0)
+        {
+            pPlayer->jobDone.notify_all();
+        }
+    }
+}
+
+static void SubmitJob(SmackPlayer *pPlayer, void (*pfnRun)(SmackPlayer *, DWORD), DWORD arg, DWORD *pPending)
+{
+    PlayerJob job;
+    job.pfnRun = pfnRun;
+    job.arg = arg;
+    job.pPending = pPending;
+
+    {
+        std::lock_guard<std::mutex> lock(pPlayer->poolMutex);
+        ++*pPending;
+        pPlayer->jobs.push_back(job);
+    }
+    pPlayer->jobReady.notify_one();
+}
+
+/*
+ * WaitJobs
+ * Runs queued jobs - any, not only the caller's - until the caller's have
+ * all finished. Without workers this is where every job runs.
+ */
+static void WaitJobs(SmackPlayer *pPlayer, DWORD *pPending)
+{
+    std::unique_lock<std::mutex> lock(pPlayer->poolMutex);
+
+    while (*pPending > 0)
+    {
+        if (pPlayer->jobs.empty())
+        {
+            pPlayer->jobDone.wait(lock);
+            continue;
+        }
+
+        PlayerJob job = pPlayer->jobs.front();
+        pPlayer->jobs.pop_front();
+        lock.unlock();
+        job.pfnRun(pPlayer, job.arg);
+        lock.lock();
+
+        if (--*job.pPending == 0 && job.pPending != pPending)
+        {
+            pPlayer->jobDone.notify_all();
+        }
+    }
+}
+
+// =============================================================================
+// AUDIO (decode side)
+// =============================================================================
+
+/*
+ * Resample
+ * Linear interpolation to the mixer rate, upmixing mono to stereo, carried
+ * across chunks with the last frame of the previous one (as AudioStream's
+ * resampler does).
+ */
+static DWORD Resample(PlayerTrack *pTrack, const int16_t *pIn, DWORD inFrames, int16_t *pOut)
+{
+    WORD channels = pTrack->channels;
+    DWORD produced = 0;
+
+    if (pTrack->step == 0x10000)
+    {
+        for (DWORD i = 0; i < inFrames; i++)
+        {
+            pOut[i * 2] = pIn[i * channels];
+            pOut[i * 2 + 1] = pIn[i * channels + channels - 1];
+        }
+        return inFrames;
+    }
+
+    DWORD x = pTrack->resamplePos;
+    while ((x >> 16) + 1 <= inFrames)
+    {
+        DWORD j = x >> 16;
+        int frac = (int)((x & 0xFFFF) >> 1); // 15 bits keeps the product in range
+
+        for (DWORD c = 0; c < 2; c++)
+        {
+            DWORD sc = (channels == 1) ? 0 : c;
+            int a = (j == 0) ? pTrack->history[sc] : pIn[(j - 1) * channels + sc];
+            int b = pIn[j * channels + sc];
+            pOut[produced * 2 + c] = (int16_t)(a + (((b - a) * frac) >> 15));
+        }
+        produced++;
+        x += pTrack->step;
+    }
+
+    pTrack->resamplePos = x - (inFrames << 16);
+    pTrack->history[0] = pIn[(inFrames - 1) * channels];
+    pTrack->history[1] = pIn[(inFrames - 1) * channels + channels - 1];
+    return produced;
+}
+
+static BOOL Reserve(int16_t **ppBuffer, DWORD *pCapacity, DWORD samples)
+{
+    if (samples <= *pCapacity)
+    {
+        return TRUE;
+    }
+
+    int16_t *pBuffer = (int16_t *)realloc(*ppBuffer, (size_t)samples * sizeof(int16_t));
+    if (!pBuffer)
+    {
+        return FALSE;
+    }
+    *ppBuffer = pBuffer;
+    *pCapacity = samples;
+    return TRUE;
+}
+
+static void DecodeAudioJob(SmackPlayer *pPlayer, DWORD track)
+{
+    PlayerTrack *pTrack = &pPlayer->tracks[track];
+    DWORD samples = SMACKER_AudioSamples(pPlayer->pFile, track, &pPlayer->packet);
+
+    if (samples == 0 || !Reserve(&pTrack->pSamples, &pTrack->samplesCapacity, samples))
+    {
+        return;
+    }
+
+    int got = SMACKER_DecodeAudio(pPlayer->pFile, track, &pPlayer->packet, pTrack->pSamples, samples);
+    DWORD inFrames = (got > 0) ? (DWORD)got / pTrack->channels : 0;
+    DWORD maxOut = (DWORD)(((uint64_t)inFrames << 16) / pTrack->step) + 2;
+    if (inFrames == 0 || !Reserve(&pTrack->pFrames, &pTrack->framesCapacity, maxOut * 2))
+    {
+        return;
+    }
+
+    DWORD frames = Resample(pTrack, pTrack->pSamples, inFrames, pTrack->pFrames);
+    DWORD write = pTrack->writeFrame.load(std::memory_order_relaxed);
+    DWORD capacity = pTrack->ringMask + 1;
+    DWORD room = capacity - (write - pTrack->readFrame.load(std::memory_order_acquire));
+
+    // The mixer is not keeping up (or not playing this track): drop, never stall video
+    if (frames > room)
+    {
+        pTrack->dropped.fetch_add(frames - room, std::memory_order_relaxed);
+        frames = room;
+    }
+
+    DWORD index = write & pTrack->ringMask;
+    DWORD first = (frames < capacity - index) ? frames : capacity - index;
+    memcpy(pTrack->pRing + (size_t)index * 2, pTrack->pFrames, (size_t)first * 2 * sizeof(int16_t));
+    memcpy(pTrack->pRing, pTrack->pFrames + (size_t)first * 2, (size_t)(frames - first) * 2 * sizeof(int16_t));
+    pTrack->writeFrame.store(write + frames, std::memory_order_release);
+    pTrack->queued.fetch_add(frames, std::memory_order_relaxed);
+}
+
+// =============================================================================
+// MIXER PULL (mixer thread)
+// =============================================================================
+
+static DWORD __cdecl TrackRead(void *pContext, int16_t *pOut, DWORD frames)
+{
+    PlayerTrack *pTrack = (PlayerTrack *)pContext;
+    DWORD read = pTrack->readFrame.load(std::memory_order_relaxed);
+    DWORD available = pTrack->writeFrame.load(std::memory_order_acquire) - read;
+    DWORD count = (available < frames) ? available : frames;
+    DWORD capacity = pTrack->ringMask + 1;
+    DWORD index = read & pTrack->ringMask;
+    DWORD first = (count < capacity - index) ? count : capacity - index;
+
+    memcpy(pOut, pTrack->pRing + (size_t)index * 2, (size_t)first * 2 * sizeof(int16_t));
+    memcpy(pOut + (size_t)first * 2, pTrack->pRing, (size_t)(count - first) * 2 * sizeof(int16_t));
+    pTrack->readFrame.store(read + count, std::memory_order_release);
+
+    if (count == frames)
+    {
+        return frames;
+    }
+
+    // Short ring: end the voice once the last frame is decoded, else pad.
+    // writeFrame is re-read after decodeDone so the final chunk is not lost.
+    if (pTrack->pPlayer->decodeDone.load(std::memory_order_acquire) &&
+        pTrack->writeFrame.load(std::memory_order_acquire) == read + count)
+    {
+        return count;
+    }
+
+    pTrack->underruns.fetch_add(1, std::memory_order_relaxed);
+    memset(pOut + (size_t)count * 2, 0, (size_t)(frames - count) * 2 * sizeof(int16_t));
+    return frames;
+}
+
+// =============================================================================
+// DECODE
+// =============================================================================
+
+/*
+ * DecodeNext
+ * Reads the next frame, starts its audio chunks on the workers, decodes
+ * the video meanwhile and publishes both into the frame's slot. FALSE at
+ * the end of the file or on a read error.
+ */
+static BOOL DecodeNext(SmackPlayer *pPlayer)
+{
+    DWORD frame = pPlayer->nextFrame;
+    if (frame >= pPlayer->info.frames || !SMACKER_ReadPacket(pPlayer->pFile, frame, &pPlayer->packet))
+    {
+        return FALSE;
+    }
+
+    DWORD pending = 0;
+    for (DWORD i = 0; i < SMACKER_MAX_TRACKS; i++)
+    {
+        if (pPlayer->tracks[i].active && pPlayer->packet.pAudio[i])
+        {
+            SubmitJob(pPlayer, DecodeAudioJob, i, &pending);
+        }
+    }
+
+    uint64_t start = NowMicros();
+    if (!SMACKER_DecodeVideo(pPlayer->pFile, &pPlayer->packet, pPlayer->pPicture, pPlayer->info.width,
+                             pPlayer->palette))
+    {
+        pPlayer->framesCorrupt.fetch_add(1, std::memory_order_relaxed);
+    }
+    pPlayer->decodeMicros.fetch_add(NowMicros() - start, std::memory_order_relaxed);
+
+    FrameSlot *pSlot = &pPlayer->pSlots[frame % pPlayer->slotCount];
+    memcpy(pSlot->pIndices, pPlayer->pPicture, (size_t)pPlayer->info.width * pPlayer->info.height);
+    VIDEOKERNELS_ConvertPalette(pSlot->palette, pPlayer->palette);
+
+    // The packet is reused for the next frame
+    WaitJobs(pPlayer, &pending);
+    pPlayer->nextFrame++;
+    pPlayer->framesDecoded.fetch_add(1, std::memory_order_relaxed);
+    return TRUE;
+}
+
+static void DecodeMain(SmackPlayer *pPlayer)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pPlayer->mutex);
+            pPlayer->slotFreed.wait(lock, [pPlayer] {
+                return pPlayer->stopping || pPlayer->decoded - pPlayer->shown < pPlayer->slotCount;
+            });
+            if (pPlayer->stopping)
+            {
+                return;
+            }
+        }
+
+        BOOL more = DecodeNext(pPlayer);
+        {
+            std::lock_guard<std::mutex> lock(pPlayer->mutex);
+            if (more)
+            {
+                pPlayer->decoded++;
+            }
+            else
+            {
+                pPlayer->decodeDone.store(TRUE, std::memory_order_release);
+            }
+        }
+        pPlayer->slotReady.notify_one();
+
+        if (!more)
+        {
+            return;
+        }
+    }
+}
+
+// =============================================================================
+// CONVERSION
+// =============================================================================
+
+// Source row `row` looked up and scaled to the region width, keeping the cached row `keep`
+static const DWORD *ScaledRow(SmackPlayer *pPlayer, BandScratch *pBand, DWORD row, DWORD keep)
+{
+    for (DWORD i = 0; i < 2; i++)
+    {
+        if (pBand->rowIds[i] == row)
+        {
+            return pBand->pRows[i];
+        }
+    }
+
+    DWORD i = (pBand->rowIds[0] == keep) ? 1 : 0;
+    DWORD width = pPlayer->info.width;
+    const FrameSlot *pSlot = pPlayer->pConvertSlot;
+    const BYTE *pIndices = pSlot->pIndices + (size_t)row * width;
+
+    if (pPlayer->identityColumns)
+    {
+        pPlayer->kernels.pfnExpand(pBand->pRows[i], pIndices, pSlot->palette, width);
+    }
+    else
+    {
+        pPlayer->kernels.pfnExpand(pBand->pExpanded, pIndices, pSlot->palette, width);
+        pBand->pExpanded[width] = pBand->pExpanded[width - 1];
+        PFN_ScaleRow pfnScale = pPlayer->smooth ? pPlayer->kernels.pfnScaleSmooth : pPlayer->kernels.pfnScaleNearest;
+        pfnScale(pBand->pRows[i], pBand->pExpanded, pPlayer->pColumnTaps, pPlayer->regionWidth);
+    }
+
+    pBand->rowIds[i] = row;
+    return pBand->pRows[i];
+}
+
+static void ConvertBand(SmackPlayer *pPlayer, DWORD band)
+{
+    BandScratch *pBand = &pPlayer->pBands[band];
+    DWORD bpp = pPlayer->bytesPerPixel;
+    DWORD regionEnd = pPlayer->regionY + pPlayer->regionHeight;
+    DWORD rightMargin = pPlayer->outputWidth - pPlayer->regionX - pPlayer->regionWidth;
+    DWORD lastDisplayRow = pPlayer->info.displayHeight - 1;
+
+    pBand->rowIds[0] = pBand->rowIds[1] = NO_ROW;
+
+    for (DWORD y = pBand->firstRow; y < pBand->endRow; y++)
+    {
+        BYTE *pOut = pPlayer->pConvertDest + (size_t)y * pPlayer->convertPitch;
+
+        if (y < pPlayer->regionY || y >= regionEnd)
+        {
+            memset(pOut, 0, (size_t)pPlayer->outputWidth * bpp);
+            continue;
+        }
+        memset(pOut, 0, (size_t)pPlayer->regionX * bpp);
+        memset(pOut + (size_t)(pPlayer->regionX + pPlayer->regionWidth) * bpp, 0, (size_t)rightMargin * bpp);
+        pOut += (size_t)pPlayer->regionX * bpp;
+
+        const VideoTap *pTap = &pPlayer->pRowTaps[y - pPlayer->regionY];
+        DWORD top = pTap->x >> pPlayer->rowShift;
+        DWORD bottom = std::min(pTap->x + 1, lastDisplayRow) >> pPlayer->rowShift;
+        const DWORD *pPixels;
+
+        if (pTap->weight == 0 || top == bottom)
+        {
+            pPixels = ScaledRow(pPlayer, pBand, top, NO_ROW);
+            if (bpp == 4)
+            {
+                memcpy(pOut, pPixels, (size_t)pPlayer->regionWidth * 4);
+                continue;
+            }
+        }
+        else
+        {
+            const DWORD *pTop = ScaledRow(pPlayer, pBand, top, bottom);
+            const DWORD *pBottom = ScaledRow(pPlayer, pBand, bottom, top);
+            DWORD *pBlend = (bpp == 4) ? (DWORD *)pOut : pBand->pBlend;
+            pPlayer->kernels.pfnBlend(pBlend, pTop, pBottom, pTap->weight, pPlayer->regionWidth);
+            if (bpp == 4)
+            {
+                continue;
+            }
+            pPixels = pBlend;
+        }
+        pPlayer->kernels.pfnPack565((WORD *)pOut, pPixels, pPlayer->regionWidth);
+    }
+}
+
+static void ConvertBandJob(SmackPlayer *pPlayer, DWORD band)
+{
+    ConvertBand(pPlayer, band);
+}
+
+static void ConvertFrame(SmackPlayer *pPlayer, const FrameSlot *pSlot, BYTE *pDest, DWORD pitch)
+{
+    pPlayer->pConvertSlot = pSlot;
+    pPlayer->pConvertDest = pDest;
+    pPlayer->convertPitch = pitch;
+
+    DWORD pending = 0;
+    for (DWORD band = 1; band < pPlayer->bandCount; band++)
+    {
+        SubmitJob(pPlayer, ConvertBandJob, band, &pending);
+    }
+    ConvertBand(pPlayer, 0);
+    WaitJobs(pPlayer, &pending);
+}
+
+BOOL __cdecl SMKPLAYER_NextFrame(SmackPlayer *pPlayer, void *pDest, DWORD pitch)
+{
+    if (pPlayer->synchronous)
+    {
+        if (pPlayer->decoded == pPlayer->shown)
+        {
+            if (pPlayer->decodeDone.load(std::memory_order_relaxed) || !DecodeNext(pPlayer))
+            {
+                pPlayer->decodeDone.store(TRUE, std::memory_order_release);
+                return FALSE;
+            }
+            pPlayer->decoded++;
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(pPlayer->mutex);
+        pPlayer->slotReady.wait(lock, [pPlayer] {
+            return pPlayer->decoded != pPlayer->shown || pPlayer->decodeDone.load(std::memory_order_acquire);
+        });
+        if (pPlayer->decoded == pPlayer->shown)
+        {
+            return FALSE;
+        }
+    }
+
+    uint64_t start = NowMicros();
+    ConvertFrame(pPlayer, &pPlayer->pSlots[pPlayer->shown % pPlayer->slotCount], (BYTE *)pDest, pitch);
+    pPlayer->convertMicros.fetch_add(NowMicros() - start, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(pPlayer->mutex);
+        pPlayer->shown++;
+    }
+    pPlayer->slotFreed.notify_one();
+    pPlayer->framesShown.fetch_add(1, std::memory_order_relaxed);
+    return TRUE;
+}
+
+// =============================================================================
+// LIFETIME
+// =============================================================================
+
+// Picture area: the whole output, or the largest centred one with the source aspect
+static void PlaceRegion(SmackPlayer *pPlayer, BOOL stretch)
+{
+    uint64_t srcWidth = pPlayer->info.width;
+    uint64_t srcHeight = pPlayer->info.displayHeight;
+    uint64_t outWidth = pPlayer->outputWidth;
+    uint64_t outHeight = pPlayer->outputHeight;
+
+    pPlayer->regionWidth = (DWORD)outWidth;
+    pPlayer->regionHeight = (DWORD)outHeight;
+    if (!stretch)
+    {
+        if (outWidth * srcHeight <= outHeight * srcWidth)
+        {
+            pPlayer->regionHeight = (DWORD)((srcHeight * outWidth + srcWidth / 2) / srcWidth);
+        }
+        else
+        {
+            pPlayer->regionWidth = (DWORD)((srcWidth * outHeight + srcHeight / 2) / srcHeight);
+        }
+        pPlayer->regionWidth = std::max<DWORD>(1, std::min<DWORD>(pPlayer->regionWidth, (DWORD)outWidth));
+        pPlayer->regionHeight = std::max<DWORD>(1, std::min<DWORD>(pPlayer->regionHeight, (DWORD)outHeight));
+    }
+    pPlayer->regionX = (pPlayer->outputWidth - pPlayer->regionWidth) / 2;
+    pPlayer->regionY = (pPlayer->outputHeight - pPlayer->regionHeight) / 2;
+}
+
+static BOOL CreateTrack(SmackPlayer *pPlayer, DWORD track, DWORD mixerRate, DWORD ringFrames)
+{
+    const SmackerTrackInfo *pInfo = &pPlayer->info.tracks[track];
+    PlayerTrack *pTrack = &pPlayer->tracks[track];
+
+    pTrack->pPlayer = pPlayer;
+    pTrack->step = (DWORD)(((uint64_t)pInfo->sampleRate << 16) / mixerRate);
+    if (pInfo->sampleRate == 0 || !pInfo->decodable || pTrack->step == 0)
+    {
+        return TRUE;
+    }
+
+    pTrack->pRing = (int16_t *)malloc((size_t)ringFrames * 2 * sizeof(int16_t));
+    if (!pTrack->pRing)
+    {
+        return FALSE;
+    }
+    pTrack->ringMask = ringFrames - 1;
+    pTrack->channels = pInfo->channels;
+    pTrack->resamplePos = 0x10000;
+    pTrack->mixerStream.pfnRead = TrackRead;
+    pTrack->mixerStream.pContext = pTrack;
+    pTrack->mixerStream.channels = 2;
+    pTrack->active = TRUE;
+    return TRUE;
+}
+
+SmackPlayer *__cdecl SMKPLAYER_Create(const SmackPlayerDesc *pDesc)
+{
+    SmackerFile *pFile = SMACKER_Open(pDesc->pSource);
+    DWORD bits = pDesc->outputBits ? pDesc->outputBits : DEFAULT_OUTPUT_BITS;
+    if (!pFile || (bits != 16 && bits != 32))
+    {
+        SMACKER_Close(pFile);
+        return NULL;
+    }
+
+    SmackPlayer *pPlayer = new SmackPlayer();
+    pPlayer->pFile = pFile;
+    SMACKER_GetInfo(pFile, &pPlayer->info);
+    SMACKER_InitPacket(&pPlayer->packet);
+    VIDEOKERNELS_Select(&pPlayer->kernels, pDesc->forceScalar);
+    pPlayer->synchronous = pDesc->synchronous;
+    pPlayer->decodeDone.store(FALSE);
+    pPlayer->framesDecoded.store(0);
+    pPlayer->framesShown.store(0);
+    pPlayer->framesCorrupt.store(0);
+    pPlayer->decodeMicros.store(0);
+    pPlayer->convertMicros.store(0);
+
+    pPlayer->outputWidth = pDesc->outputWidth ? pDesc->outputWidth : DEFAULT_OUTPUT_WIDTH;
+    pPlayer->outputHeight = pDesc->outputHeight ? pDesc->outputHeight : DEFAULT_OUTPUT_HEIGHT;
+    pPlayer->bytesPerPixel = bits / 8;
+    pPlayer->smooth = pDesc->filter == SMKPLAYER_FILTER_SMOOTH;
+    pPlayer->rowShift = (pPlayer->info.displayHeight != pPlayer->info.height) ? 1 : 0;
+    PlaceRegion(pPlayer, pDesc->stretch);
+    pPlayer->identityColumns = pPlayer->regionWidth == pPlayer->info.width;
+
+    DWORD workers = 0;
+    if (!pDesc->synchronous)
+    {
+        workers = pDesc->workers ? pDesc->workers : std::max(1u, std::thread::hardware_concurrency()) - 1;
+        workers = std::min<DWORD>(workers, SMKPLAYER_MAX_WORKERS);
+    }
+    pPlayer->slotCount = pDesc->synchronous ? 1 : (pDesc->frameSlots ? pDesc->frameSlots : DEFAULT_FRAME_SLOTS);
+    pPlayer->bandCount = std::min<DWORD>(workers + 1, pPlayer->outputHeight);
+
+    size_t pictureSize = (size_t)pPlayer->info.width * pPlayer->info.height;
+    DWORD rowWidth = std::max(pPlayer->regionWidth, pPlayer->info.width);
+    BOOL ok = TRUE;
+
+    pPlayer->pPicture = (BYTE *)calloc(pictureSize, 1);
+    pPlayer->pColumnTaps = (VideoTap *)malloc(pPlayer->regionWidth * sizeof(VideoTap));
+    pPlayer->pRowTaps = (VideoTap *)malloc(pPlayer->regionHeight * sizeof(VideoTap));
+    pPlayer->pSlots = (FrameSlot *)calloc(pPlayer->slotCount, sizeof(FrameSlot));
+    pPlayer->pBands = (BandScratch *)calloc(pPlayer->bandCount, sizeof(BandScratch));
+    ok = pPlayer->pPicture && pPlayer->pColumnTaps && pPlayer->pRowTaps && pPlayer->pSlots && pPlayer->pBands;
+
+    for (DWORD i = 0; ok && i < pPlayer->slotCount; i++)
+    {
+        pPlayer->pSlots[i].pIndices = (BYTE *)malloc(pictureSize);
+        ok = pPlayer->pSlots[i].pIndices != NULL;
+    }
+    for (DWORD i = 0; ok && i < pPlayer->bandCount; i++)
+    {
+        BandScratch *pBand = &pPlayer->pBands[i];
+        pBand->firstRow = (DWORD)((uint64_t)pPlayer->outputHeight * i / pPlayer->bandCount);
+        pBand->endRow = (DWORD)((uint64_t)pPlayer->outputHeight * (i + 1) / pPlayer->bandCount);
+        pBand->pExpanded = (DWORD *)malloc(((size_t)pPlayer->info.width + 1) * sizeof(DWORD));
+        pBand->pRows[0] = (DWORD *)malloc((size_t)rowWidth * sizeof(DWORD));
+        pBand->pRows[1] = (DWORD *)malloc((size_t)rowWidth * sizeof(DWORD));
+        pBand->pBlend = (DWORD *)malloc((size_t)rowWidth * sizeof(DWORD));
+        ok = pBand->pExpanded && pBand->pRows[0] && pBand->pRows[1] && pBand->pBlend;
+    }
+
+    DWORD mixerRate = pDesc->mixerRate ? pDesc->mixerRate : MIXER_DEFAULT_RATE;
+    DWORD ringFrames = D2_NextPow2(pDesc->audioRingFrames ? pDesc->audioRingFrames : DEFAULT_AUDIO_RING_FRAMES);
+    ringFrames = std::max<DWORD>(ringFrames, 2 * MIXER_BLOCK_FRAMES);
+    for (DWORD i = 0; ok && i < SMACKER_MAX_TRACKS; i++)
+    {
+        ok = CreateTrack(pPlayer, i, mixerRate, ringFrames);
+    }
+
+    if (!ok)
+    {
+        SMKPLAYER_Destroy(pPlayer);
+        return NULL;
+    }
+
+    VIDEOKERNELS_BuildTaps(pPlayer->pColumnTaps, pPlayer->regionWidth, pPlayer->info.width, pPlayer->smooth);
+    VIDEOKERNELS_BuildTaps(pPlayer->pRowTaps, pPlayer->regionHeight, pPlayer->info.displayHeight, pPlayer->smooth);
+
+    for (DWORD i = 0; i < workers; i++)
+    {
+        pPlayer->workers.push_back(std::thread(WorkerMain, pPlayer));
+    }
+    if (!pDesc->synchronous)
+    {
+        pPlayer->decoder = std::thread(DecodeMain, pPlayer);
+    }
+    return pPlayer;
+}
+
+void __cdecl SMKPLAYER_Destroy(SmackPlayer *pPlayer)
+{
+    if (!pPlayer)
+    {
+        return;
+    }
+
+    // The decoder may be waiting on audio jobs, so it stops before the workers
+    if (pPlayer->decoder.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(pPlayer->mutex);
+            pPlayer->stopping = TRUE;
+        }
+        pPlayer->slotFreed.notify_all();
+        pPlayer->decoder.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(pPlayer->poolMutex);
+        pPlayer->poolStopping = TRUE;
+    }
+    pPlayer->jobReady.notify_all();
+    for (size_t i = 0; i < pPlayer->workers.size(); i++)
+    {
+        pPlayer->workers[i].join();
+    }
+
+    for (DWORD i = 0; pPlayer->pSlots && i < pPlayer->slotCount; i++)
+    {
+        free(pPlayer->pSlots[i].pIndices);
+    }
+    for (DWORD i = 0; pPlayer->pBands && i < pPlayer->bandCount; i++)
+    {
+        BandScratch *pBand = &pPlayer->pBands[i];
+        free(pBand->pExpanded);
+        free(pBand->pRows[0]);
+        free(pBand->pRows[1]);
+        free(pBand->pBlend);
+    }
+    for (DWORD i = 0; i < SMACKER_MAX_TRACKS; i++)
+    {
+        free(pPlayer->tracks[i].pRing);
+        free(pPlayer->tracks[i].pSamples);
+        free(pPlayer->tracks[i].pFrames);
+    }
+
+    free(pPlayer->pSlots);
+    free(pPlayer->pBands);
+    free(pPlayer->pColumnTaps);
+    free(pPlayer->pRowTaps);
+    free(pPlayer->pPicture);
+    SMACKER_FreePacket(&pPlayer->packet);
+    SMACKER_Close(pPlayer->pFile);
+    delete pPlayer;
+}
+
+void __cdecl SMKPLAYER_GetInfo(const SmackPlayer *pPlayer, SmackerInfo *pInfo)
+{
+    *pInfo = pPlayer->info;
+}
+
+const MixerStream *__cdecl SMKPLAYER_GetMixerStream(SmackPlayer *pPlayer, DWORD track)
+{
+    if (track >= SMACKER_MAX_TRACKS || !pPlayer->tracks[track].active)
+    {
+        return NULL;
+    }
+    return &pPlayer->tracks[track].mixerStream;
+}
+
+void __cdecl SMKPLAYER_GetStats(const SmackPlayer *pPlayer, SmackPlayerStats *pStats)
+{
+    memset(pStats, 0, sizeof(SmackPlayerStats));
+    pStats->framesDecoded = pPlayer->framesDecoded.load(std::memory_order_relaxed);
+    pStats->framesShown = pPlayer->framesShown.load(std::memory_order_relaxed);
+    pStats->framesCorrupt = pPlayer->framesCorrupt.load(std::memory_order_relaxed);
+    pStats->decodeMicros = pPlayer->decodeMicros.load(std::memory_order_relaxed);
+    pStats->convertMicros = pPlayer->convertMicros.load(std::memory_order_relaxed);
+    pStats->threads = (DWORD)pPlayer->workers.size() + (pPlayer->decoder.joinable() ? 1 : 0);
+    pStats->simd = pPlayer->kernels.simd;
+
+    for (DWORD i = 0; i < SMACKER_MAX_TRACKS; i++)
+    {
+        const PlayerTrack *pTrack = &pPlayer->tracks[i];
+        pStats->audioFramesQueued += pTrack->queued.load(std::memory_order_relaxed);
+        pStats->audioFramesDropped += pTrack->dropped.load(std::memory_order_relaxed);
+        pStats->audioUnderruns += pTrack->underruns.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+ * SmackPlayer.hpp - D2Video threaded Smacker playback
+ *
+ * SmackW32 plays a cinematic on the calling thread: SmackDoFrame decodes,
+ * SmackToBuffer converts every pixel through the palette into the DirectDraw
+ * surface, and the 640x480 picture is blitted as is. Decoding, converting
+ * and the game's own presentation take turns, and on a slow machine the
+ * sum of the three is the frame time.
+ *
+ * A SmackPlayer keeps them apart:
+ *   - a decode thread works up to frameSlots frames ahead of what is shown.
+ *     Each frame's audio chunks are decoded and resampled on the workers
+ *     while the thread decodes the video bitstream, which is one serial
+ *     Huffman stream per frame (Smacker.hpp);
+ *   - SMKPLAYER_NextFrame converts the oldest decoded frame to the output
+ *     format, scaled to the output size, in horizontal bands run by the
+ *     workers and the caller together.
+ * Output is the game's screen mode - g_screenWidth x g_screenHeight at
+ * g_colorDepth bits by default - either stretched or letterboxed with the
+ * aspect kept. Sources flagged Y-doubled or interlaced are shown
+ * line-doubled at twice their stored height.
+ *
+ * Audio tracks are offered to the mixer as stereo MixerStreams at the
+ * mixer rate (SMKPLAYER_GetMixerStream). Their rings are filled as frames
+ * are decoded; when the mixer falls behind the decoder by more than a ring,
+ * the newest audio is dropped and counted rather than stalling video.
+ *
+ * With synchronous set nothing runs on other threads: NextFrame decodes
+ * the frame, its audio and the conversion itself, as SmackW32 does.
+ *
+ * Pacing is the caller's: NextFrame returns the next frame as soon as it
+ * is ready, and SmackerInfo.usPerFrame says when to show it.
+ *
+ * Threading: create, NextFrame, stats and destroy on one thread; the mixer
+ * streams from the mixer thread. Stop every voice playing a stream before
+ * SMKPLAYER_Destroy.
+ */
+
+#ifndef SMACKPLAYER_HPP
+#define SMACKPLAYER_HPP
+
+#include "Smacker.hpp"
+
+#define SMKPLAYER_MAX_WORKERS 32
+
+typedef enum SmackPlayerFilter
+{
+    SMKPLAYER_FILTER_SMOOTH = 0, // Bilinear
+    SMKPLAYER_FILTER_NEAREST,
+} SmackPlayerFilter;
+
+typedef struct SmackPlayerDesc
+{
+    const StreamSource *pSource; // Taken over as by SMACKER_Open, also on failure
+    DWORD outputWidth;           // 0 = 800 (g_screenWidth)
+    DWORD outputHeight;          // 0 = 600 (g_screenHeight)
+    DWORD outputBits;            // 32 (XRGB) or 16 (RGB565); 0 = 32 (g_colorDepth)
+    SmackPlayerFilter filter;
+    BOOL stretch;                // Fill the output; otherwise letterbox (black bars)
+    DWORD workers;               // Threads besides the caller and the decode thread (0 = hardware threads - 1)
+    DWORD frameSlots;            // Frames decoded ahead (0 = 3)
+    DWORD mixerRate;             // 0 = MIXER_DEFAULT_RATE
+    DWORD audioRingFrames;       // Per track, stereo frames at mixerRate (0 = 32768)
+    BOOL synchronous;            // No threads at all
+    BOOL forceScalar;            // Scalar conversion kernels even where SSE2 is available
+} SmackPlayerDesc;
+
+typedef struct SmackPlayerStats
+{
+    DWORD framesDecoded;
+    DWORD framesShown;
+    DWORD framesCorrupt;         // Decoded with errors and shown as far as they went
+    uint64_t decodeMicros;       // Video bitstream decoding
+    uint64_t convertMicros;      // Inside SMKPLAYER_NextFrame, waiting excluded
+    uint64_t audioFramesQueued;  // Stereo frames at mixerRate, all tracks
+    uint64_t audioFramesDropped; // Ring full
+    DWORD audioUnderruns;        // Mixer pulls that found a ring short
+    DWORD threads;               // Besides the caller
+    BOOL simd;
+} SmackPlayerStats;
+
+typedef struct SmackPlayer SmackPlayer;
+
+SmackPlayer *__cdecl SMKPLAYER_Create(const SmackPlayerDesc *pDesc);
+void __cdecl SMKPLAYER_Destroy(SmackPlayer *pPlayer);
+
+void __cdecl SMKPLAYER_GetInfo(const SmackPlayer *pPlayer, SmackerInfo *pInfo);
+
+/*
+ * Writes the next frame to pDest (outputWidth x outputHeight pixels of
+ * outputBits, pitch bytes per row), waiting for it to be decoded if need
+ * be. FALSE once every frame has been shown, or when the file could not
+ * be read further.
+ */
+BOOL __cdecl SMKPLAYER_NextFrame(SmackPlayer *pPlayer, void *pDest, DWORD pitch);
+
+// NULL when the track is absent or cannot be decoded. The stream ends
+// (returns short) once the last frame's audio has been played.
+const MixerStream *__cdecl SMKPLAYER_GetMixerStream(SmackPlayer *pPlayer, DWORD track);
+
+void __cdecl SMKPLAYER_GetStats(const SmackPlayer *pPlayer, SmackPlayerStats *pStats);
+
+#endif // SMACKPLAYER_HPP
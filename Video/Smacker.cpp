@@ -0,0 +1,1069 @@
+/*
+ * Smacker.cpp - D2Video Smacker (.smk) container and codec
+ *
+ * See Smacker.hpp. Layout of a file:
+ *   header     104 bytes: signature, size, frame count and rate, flags, the
+ *              largest audio chunk per track, Huffman tree sizes, track
+ *              formats
+ *   frame table  one DWORD per frame (size, bit 0 = keyframe), then one
+ *              BYTE per frame (bit 0 = palette record, bit n+1 = chunk for
+ *              audio track n)
+ *   trees      the four video Huffman trees (block map, block colours, full
+ *              blocks, block types) as one LSB-first bitstream
+ *   frames     palette record, audio chunks, video bitstream
+ *
+ * Video trees decode 16-bit values. A tree is sent as two byte trees (low
+ * and high halves of every leaf) plus three escape values; leaves holding
+ * an escape mark "the most recent value", "the one before" and "the one
+ * before that", which are kept by rewriting those leaves as values are
+ * decoded. Trees are stored flat in preorder - an inner node holds the size
+ * of its left subtree, so a 1 bit skips it - and the first HUFF_LUT_BITS of
+ * every code are resolved with one table lookup.
+ */
+
+#include "Smacker.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SMK_HEADER_BYTES 104
+#define SMK_MAX_DIMENSION 4096
+#define SMK_MAX_FRAMES 1000000
+#define SMK_MAX_TREE_BYTES (16u << 20)
+#define SMK_MAX_FRAME_BYTES (64u << 20)
+
+#define SMK_TRACK_PACKED 0x80
+#define SMK_TRACK_16BIT 0x20
+#define SMK_TRACK_STEREO 0x10
+#define SMK_TRACK_BINK_RDFT 0x08
+#define SMK_TRACK_BINK_DCT 0x04
+
+// Frame type bits
+#define SMK_FRAME_PALETTE 0x01
+
+// Tree order in the header and in SmackerFile.trees
+#define SMK_TREE_MMAP 0
+#define SMK_TREE_MCLR 1
+#define SMK_TREE_FULL 2
+#define SMK_TREE_TYPE 3
+#define SMK_TREE_COUNT 4
+
+// Block types (low two bits of a TYPE value)
+#define SMK_BLOCK_MONO 0
+#define SMK_BLOCK_FULL 1
+#define SMK_BLOCK_SKIP 2
+#define SMK_BLOCK_FILL 3
+
+#define SMK_NODE 0x80000000u
+#define SMK_BYTE_TREE_DEPTH 32
+#define SMK_BIG_TREE_DEPTH 500
+#define SMK_BYTE_TREE_ENTRIES 511 // 256 leaves
+
+#define HUFF_LUT_BITS 10       // Video trees
+#define HUFF_BYTE_LUT_BITS 8   // Byte trees
+#define HUFF_LUT_CONSUMED 0x1F // Lookup entry: position << 5 | bits consumed
+
+// Blocks covered by one TYPE code, by bits 2-7 of the value
+static const WORD s_blockRuns[64] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+    17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+    33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48,
+    49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 128, 256, 512, 1024, 2048,
+};
+
+// A flat preorder tree and its lookup table
+typedef struct HuffTree
+{
+    DWORD *pValues; // SMK_NODE | left subtree size, or a leaf value
+    DWORD count;
+    DWORD capacity;
+    DWORD *pLut;
+    DWORD lutBits;
+    DWORD last[3]; // Video trees: slots holding the three most recent values
+} HuffTree;
+
+// Audio chunks bring their own byte trees; these live on the stack
+typedef struct ByteTree
+{
+    DWORD values[SMK_BYTE_TREE_ENTRIES];
+    DWORD lut[1 << HUFF_BYTE_LUT_BITS];
+    HuffTree tree;
+} ByteTree;
+
+struct SmackerFile
+{
+    StreamSource source;
+    SmackerInfo info;
+    DWORD *pFrameSizes; // Bytes, as stored
+    BYTE *pFrameTypes;
+    uint64_t *pFrameOffsets;
+    HuffTree trees[SMK_TREE_COUNT];
+};
+
+// =============================================================================
+// BIT READER
+// =============================================================================
+
+/*
+ * LSB-first reader over a bounded buffer. The cache is topped up a word at
+ * a time while at least eight bytes remain and a byte at a time after
+ * that; past the end it reads zeroes and records the overrun, which the
+ * callers check once per frame or chunk rather than per code.
+ */
+typedef struct BitReader
+{
+    const BYTE *p;
+    const BYTE *pEnd;
+    uint64_t cache;
+    DWORD count;
+    BOOL overrun;
+} BitReader;
+
+static void InitBits(BitReader *pReader, const BYTE *pData, DWORD size)
+{
+    pReader->p = pData;
+    pReader->pEnd = pData + size;
+    pReader->cache = 0;
+    pReader->count = 0;
+    pReader->overrun = FALSE;
+}
+
+static inline void Refill(BitReader *pReader)
+{
+    if (pReader->count > 56)
+    {
+        return;
+    }
+    if (pReader->pEnd - pReader->p >= 8)
+    {
+        // Little-endian hosts only, like the rest of the tree's file parsing
+        uint64_t word;
+        memcpy(&word, pReader->p, sizeof(word));
+        pReader->cache |= word << pReader->count;
+        pReader->p += (63 - pReader->count) >> 3;
+        pReader->count |= 56;
+        return;
+    }
+    while (pReader->count <= 56 && pReader->p < pReader->pEnd)
+    {
+        pReader->cache |= (uint64_t)*pReader->p++ << pReader->count;
+        pReader->count += 8;
+    }
+}
+
+static inline void SkipBits(BitReader *pReader, DWORD bits)
+{
+    if (bits > pReader->count)
+    {
+        pReader->overrun = TRUE;
+        pReader->cache = 0;
+        pReader->count = 0;
+        return;
+    }
+    pReader->cache >>= bits;
+    pReader->count -= bits;
+}
+
+// bits <= 32
+static inline DWORD GetBits(BitReader *pReader, DWORD bits)
+{
+    Refill(pReader);
+    DWORD value = (DWORD)(pReader->cache & ((1ull << bits) - 1));
+    SkipBits(pReader, bits);
+    return value;
+}
+
+static inline DWORD GetBit(BitReader *pReader)
+{
+    if (pReader->count == 0)
+    {
+        Refill(pReader);
+    }
+    DWORD value = (DWORD)(pReader->cache & 1);
+    SkipBits(pReader, 1);
+    return value;
+}
+
+// =============================================================================
+// HUFFMAN TREES
+// =============================================================================
+
+/*
+ * BuildLut
+ * Every lutBits-bit pattern maps to where the walk from the root stands
+ * after reading it: on the leaf it reached (and how many of the bits that
+ * took) or on an inner node lutBits deep. Filled by walking the tree once,
+ * so building costs 2^lutBits stores however large the tree is.
+ */
+static void BuildLut(HuffTree *pTree)
+{
+    DWORD stack[2 * 32][3]; // Position, depth, code
+    DWORD top = 0;
+    DWORD size = 1u << pTree->lutBits;
+
+    stack[top][0] = 0;
+    stack[top][1] = 0;
+    stack[top][2] = 0;
+    top++;
+
+    while (top > 0)
+    {
+        top--;
+        DWORD pos = stack[top][0];
+        DWORD depth = stack[top][1];
+        DWORD code = stack[top][2];
+        DWORD value = pTree->pValues[pos];
+
+        if (!(value & SMK_NODE) || depth == pTree->lutBits)
+        {
+            for (DWORD index = code; index < size; index += 1u << depth)
+            {
+                pTree->pLut[index] = (pos << 5) | depth;
+            }
+            continue;
+        }
+
+        stack[top][0] = pos + 1;
+        stack[top][1] = depth + 1;
+        stack[top][2] = code;
+        stack[top + 1][0] = pos + 1 + (value & ~SMK_NODE);
+        stack[top + 1][1] = depth + 1;
+        stack[top + 1][2] = code | (1u << depth);
+        top += 2;
+    }
+}
+
+static inline DWORD ReadCode(BitReader *pReader, const HuffTree *pTree)
+{
+    Refill(pReader);
+    DWORD entry = pTree->pLut[pReader->cache & ((1u << pTree->lutBits) - 1)];
+    SkipBits(pReader, entry & HUFF_LUT_CONSUMED);
+
+    const DWORD *pValues = pTree->pValues;
+    DWORD pos = entry >> 5;
+    while (pValues[pos] & SMK_NODE)
+    {
+        if (GetBit(pReader))
+        {
+            pos += pValues[pos] & ~SMK_NODE;
+        }
+        pos++;
+    }
+    return pValues[pos];
+}
+
+// Reads a video tree code and moves it to the front of the recent values
+static inline DWORD GetCode(BitReader *pReader, HuffTree *pTree)
+{
+    DWORD value = ReadCode(pReader, pTree);
+    DWORD *pValues = pTree->pValues;
+
+    if (value != pValues[pTree->last[0]])
+    {
+        pValues[pTree->last[2]] = pValues[pTree->last[1]];
+        pValues[pTree->last[1]] = pValues[pTree->last[0]];
+        pValues[pTree->last[0]] = value;
+    }
+    return value;
+}
+
+static BOOL ReadByteTreeNode(BitReader *pReader, HuffTree *pTree, DWORD depth)
+{
+    if (depth > SMK_BYTE_TREE_DEPTH || pTree->count >= pTree->capacity || pReader->overrun)
+    {
+        return FALSE;
+    }
+
+    if (!GetBit(pReader))
+    {
+        pTree->pValues[pTree->count++] = GetBits(pReader, 8);
+        return TRUE;
+    }
+
+    DWORD node = pTree->count++;
+    if (!ReadByteTreeNode(pReader, pTree, depth + 1))
+    {
+        return FALSE;
+    }
+    pTree->pValues[node] = SMK_NODE | (pTree->count - node - 1);
+    return ReadByteTreeNode(pReader, pTree, depth + 1);
+}
+
+static BOOL ReadByteTree(BitReader *pReader, ByteTree *pByteTree)
+{
+    HuffTree *pTree = &pByteTree->tree;
+
+    memset(pTree, 0, sizeof(HuffTree));
+    pTree->pValues = pByteTree->values;
+    pTree->capacity = SMK_BYTE_TREE_ENTRIES;
+    pTree->pLut = pByteTree->lut;
+    pTree->lutBits = HUFF_BYTE_LUT_BITS;
+
+    if (!ReadByteTreeNode(pReader, pTree, 0) || pReader->overrun)
+    {
+        return FALSE;
+    }
+    BuildLut(pTree);
+    return TRUE;
+}
+
+typedef struct BigTreeContext
+{
+    BitReader *pReader;
+    HuffTree *pTree;
+    const ByteTree *pLow; // NULL = every low byte is 0
+    const ByteTree *pHigh;
+    DWORD escapes[3];
+    DWORD lastSet[3];
+    DWORD limit; // Slots the walk may fill; the three after it are for unused escapes
+} BigTreeContext;
+
+static BOOL ReadBigTreeNode(BigTreeContext *pContext, DWORD depth)
+{
+    HuffTree *pTree = pContext->pTree;
+
+    if (depth > SMK_BIG_TREE_DEPTH || pTree->count >= pContext->limit || pContext->pReader->overrun)
+    {
+        return FALSE;
+    }
+
+    if (!GetBit(pContext->pReader))
+    {
+        DWORD low = pContext->pLow ? ReadCode(pContext->pReader, &pContext->pLow->tree) : 0;
+        DWORD high = pContext->pHigh ? ReadCode(pContext->pReader, &pContext->pHigh->tree) : 0;
+        DWORD value = low | (high << 8);
+
+        for (DWORD i = 0; i < 3; i++)
+        {
+            if (value == pContext->escapes[i])
+            {
+                pTree->last[i] = pTree->count;
+                pContext->lastSet[i] = TRUE;
+                value = 0;
+                break;
+            }
+        }
+        pTree->pValues[pTree->count++] = value;
+        return TRUE;
+    }
+
+    DWORD node = pTree->count++;
+    if (!ReadBigTreeNode(pContext, depth + 1))
+    {
+        return FALSE;
+    }
+    pTree->pValues[node] = SMK_NODE | (pTree->count - node - 1);
+    return ReadBigTreeNode(pContext, depth + 1);
+}
+
+static void FreeTree(HuffTree *pTree)
+{
+    free(pTree->pValues);
+    free(pTree->pLut);
+    memset(pTree, 0, sizeof(HuffTree));
+}
+
+/*
+ * ReadVideoTree
+ * [present] [low byte tree] [high byte tree] [3 x 16-bit escape] [tree] [0].
+ * An absent tree decodes to 0 without reading any bits; so does an absent
+ * byte tree for its half.
+ */
+static BOOL ReadVideoTree(BitReader *pReader, HuffTree *pTree, DWORD sizeBytes)
+{
+    memset(pTree, 0, sizeof(HuffTree));
+
+    if (!GetBit(pReader))
+    {
+        pTree->capacity = 2;
+        pTree->count = 1;
+        pTree->lutBits = 1;
+        pTree->pValues = (DWORD *)calloc(2, sizeof(DWORD));
+        pTree->pLut = (DWORD *)calloc(2, sizeof(DWORD));
+        pTree->last[0] = pTree->last[1] = pTree->last[2] = 1;
+        return pTree->pValues && pTree->pLut;
+    }
+
+    ByteTree *pBytes = (sizeBytes <= SMK_MAX_TREE_BYTES) ? (ByteTree *)malloc(2 * sizeof(ByteTree)) : NULL;
+    if (!pBytes)
+    {
+        return FALSE;
+    }
+
+    BigTreeContext context;
+    memset(&context, 0, sizeof(context));
+    context.pReader = pReader;
+    context.pTree = pTree;
+
+    BOOL ok = TRUE;
+    for (DWORD i = 0; ok && i < 2; i++)
+    {
+        if (GetBit(pReader))
+        {
+            ok = ReadByteTree(pReader, &pBytes[i]);
+            SkipBits(pReader, 1);
+            if (i == 0)
+            {
+                context.pLow = &pBytes[i];
+            }
+            else
+            {
+                context.pHigh = &pBytes[i];
+            }
+        }
+    }
+
+    for (DWORD i = 0; i < 3; i++)
+    {
+        context.escapes[i] = GetBits(pReader, 16);
+    }
+
+    context.limit = (sizeBytes + 3) / 4 + 3;
+    pTree->capacity = context.limit + 3;
+    pTree->pValues = (DWORD *)calloc(pTree->capacity, sizeof(DWORD));
+    ok = ok && pTree->pValues && ReadBigTreeNode(&context, 0) && !pReader->overrun;
+    SkipBits(pReader, 1);
+    free(pBytes);
+
+    // Escapes the tree never uses still need a slot for the rotation
+    for (DWORD i = 0; ok && i < 3; i++)
+    {
+        if (!context.lastSet[i])
+        {
+            pTree->last[i] = pTree->count++;
+        }
+    }
+
+    pTree->lutBits = HUFF_LUT_BITS;
+    pTree->pLut = ok ? (DWORD *)malloc(sizeof(DWORD) << HUFF_LUT_BITS) : NULL;
+    if (!pTree->pLut)
+    {
+        FreeTree(pTree);
+        return FALSE;
+    }
+    BuildLut(pTree);
+    return TRUE;
+}
+
+// =============================================================================
+// OPEN
+// =============================================================================
+
+static DWORD ReadLE32(const BYTE *p)
+{
+    return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static BOOL ReadExact(const StreamSource *pSource, uint64_t offset, void *pBuffer, DWORD bytes)
+{
+    DWORD got = 0;
+    return pSource->pfnRead(pSource->pContext, offset, pBuffer, bytes, &got) && got == bytes;
+}
+
+static BOOL ParseHeader(SmackerFile *pFile, const BYTE *pHeader)
+{
+    SmackerInfo *pInfo = &pFile->info;
+
+    if (memcmp(pHeader, "SMK2", 4) == 0)
+    {
+        pInfo->version = 2;
+    }
+    else if (memcmp(pHeader, "SMK4", 4) == 0)
+    {
+        pInfo->version = 4;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    pInfo->width = ReadLE32(pHeader + 4);
+    pInfo->height = ReadLE32(pHeader + 8);
+    pInfo->frames = ReadLE32(pHeader + 12);
+    pInfo->flags = ReadLE32(pHeader + 20);
+    if (pInfo->width == 0 || pInfo->height == 0 || pInfo->width > SMK_MAX_DIMENSION ||
+        pInfo->height > SMK_MAX_DIMENSION || pInfo->frames == 0 || pInfo->frames > SMK_MAX_FRAMES)
+    {
+        return FALSE;
+    }
+
+    // > 0: milliseconds; < 0: units of 10 us; 0: 10 frames a second
+    int32_t rate = (int32_t)ReadLE32(pHeader + 16);
+    if (rate > 0)
+    {
+        pInfo->usPerFrame = (DWORD)rate * 1000;
+    }
+    else if (rate < 0)
+    {
+        pInfo->usPerFrame = (DWORD)(-(int64_t)rate) * 10;
+    }
+    else
+    {
+        pInfo->usPerFrame = 100000;
+    }
+
+    pInfo->displayHeight = pInfo->height;
+    if (pInfo->flags & (SMACKER_FLAG_Y_INTERLACED | SMACKER_FLAG_Y_DOUBLED))
+    {
+        pInfo->displayHeight *= 2;
+    }
+
+    for (DWORD i = 0; i < SMACKER_MAX_TRACKS; i++)
+    {
+        DWORD format = ReadLE32(pHeader + 72 + i * 4);
+        DWORD flags = format >> 24;
+        SmackerTrackInfo *pTrack = &pInfo->tracks[i];
+
+        pTrack->sampleRate = format & 0xFFFFFF;
+        if (pTrack->sampleRate == 0)
+        {
+            continue;
+        }
+        pTrack->channels = (flags & SMK_TRACK_STEREO) ? 2 : 1;
+        pTrack->bits = (flags & SMK_TRACK_16BIT) ? 16 : 8;
+        pTrack->compressed = (flags & (SMK_TRACK_PACKED | SMK_TRACK_BINK_RDFT | SMK_TRACK_BINK_DCT)) != 0;
+        pTrack->decodable = (flags & (SMK_TRACK_BINK_RDFT | SMK_TRACK_BINK_DCT)) == 0;
+    }
+    return TRUE;
+}
+
+void __cdecl SMACKER_Close(SmackerFile *pFile)
+{
+    if (!pFile)
+    {
+        return;
+    }
+
+    if (pFile->source.pfnClose)
+    {
+        pFile->source.pfnClose(pFile->source.pContext);
+    }
+    for (DWORD i = 0; i < SMK_TREE_COUNT; i++)
+    {
+        FreeTree(&pFile->trees[i]);
+    }
+    free(pFile->pFrameSizes);
+    free(pFile->pFrameTypes);
+    free(pFile->pFrameOffsets);
+    free(pFile);
+}
+
+SmackerFile *__cdecl SMACKER_Open(const StreamSource *pSource)
+{
+    SmackerFile *pFile = (SmackerFile *)calloc(1, sizeof(SmackerFile));
+    if (!pFile)
+    {
+        if (pSource->pfnClose)
+        {
+            pSource->pfnClose(pSource->pContext);
+        }
+        return NULL;
+    }
+    pFile->source = *pSource;
+
+    BYTE header[SMK_HEADER_BYTES];
+    if (!ReadExact(&pFile->source, 0, header, SMK_HEADER_BYTES) || !ParseHeader(pFile, header))
+    {
+        SMACKER_Close(pFile);
+        return NULL;
+    }
+
+    // The ring frame (a copy of frame 0 for looping) follows the others
+    DWORD stored = pFile->info.frames + ((pFile->info.flags & SMACKER_FLAG_RING_FRAME) ? 1 : 0);
+    DWORD treesSize = ReadLE32(header + 52);
+    pFile->pFrameSizes = (DWORD *)malloc(stored * sizeof(DWORD));
+    pFile->pFrameTypes = (BYTE *)malloc(stored);
+    pFile->pFrameOffsets = (uint64_t *)malloc(stored * sizeof(uint64_t));
+    BYTE *pTrees = (treesSize <= SMK_MAX_TREE_BYTES) ? (BYTE *)malloc(treesSize + 1) : NULL;
+
+    uint64_t offset = SMK_HEADER_BYTES;
+    BOOL ok = pFile->pFrameSizes && pFile->pFrameTypes && pFile->pFrameOffsets && pTrees &&
+              ReadExact(&pFile->source, offset, pFile->pFrameSizes, stored * sizeof(DWORD)) &&
+              ReadExact(&pFile->source, offset + stored * sizeof(DWORD), pFile->pFrameTypes, stored) &&
+              ReadExact(&pFile->source, offset + stored * 5ull, pTrees, treesSize);
+
+    if (ok)
+    {
+        BitReader reader;
+        InitBits(&reader, pTrees, treesSize);
+        for (DWORD i = 0; ok && i < SMK_TREE_COUNT; i++)
+        {
+            ok = ReadVideoTree(&reader, &pFile->trees[i], ReadLE32(header + 56 + i * 4));
+        }
+        ok = ok && !reader.overrun;
+    }
+    free(pTrees);
+
+    offset += stored * 5ull + treesSize;
+    for (DWORD i = 0; ok && i < stored; i++)
+    {
+        pFile->pFrameSizes[i] = ReadLE32((const BYTE *)&pFile->pFrameSizes[i]);
+        pFile->pFrameOffsets[i] = offset;
+        offset += pFile->pFrameSizes[i] & ~3u;
+        ok = (pFile->pFrameSizes[i] & ~3u) <= SMK_MAX_FRAME_BYTES;
+    }
+
+    // Offsets only grow, so the last byte of the last frame vouches for all of them
+    BYTE probe;
+    ok = ok && ReadExact(&pFile->source, offset - 1, &probe, 1);
+
+    if (!ok)
+    {
+        SMACKER_Close(pFile);
+        return NULL;
+    }
+    return pFile;
+}
+
+void __cdecl SMACKER_GetInfo(const SmackerFile *pFile, SmackerInfo *pInfo)
+{
+    *pInfo = pFile->info;
+}
+
+// =============================================================================
+// PACKETS
+// =============================================================================
+
+void __cdecl SMACKER_InitPacket(SmackerPacket *pPacket)
+{
+    memset(pPacket, 0, sizeof(SmackerPacket));
+}
+
+void __cdecl SMACKER_FreePacket(SmackerPacket *pPacket)
+{
+    free(pPacket->pData);
+    memset(pPacket, 0, sizeof(SmackerPacket));
+}
+
+BOOL __cdecl SMACKER_ReadPacket(SmackerFile *pFile, DWORD frame, SmackerPacket *pPacket)
+{
+    if (frame >= pFile->info.frames)
+    {
+        return FALSE;
+    }
+
+    DWORD size = pFile->pFrameSizes[frame] & ~3u;
+    if ((uint64_t)size + SMACKER_PACKET_PADDING > pPacket->capacity)
+    {
+        DWORD capacity = size + SMACKER_PACKET_PADDING;
+        BYTE *pData = (BYTE *)realloc(pPacket->pData, capacity);
+        if (!pData)
+        {
+            return FALSE;
+        }
+        pPacket->pData = pData;
+        pPacket->capacity = capacity;
+    }
+
+    if (!ReadExact(&pFile->source, pFile->pFrameOffsets[frame], pPacket->pData, size))
+    {
+        return FALSE;
+    }
+    memset(pPacket->pData + size, 0, SMACKER_PACKET_PADDING);
+
+    pPacket->size = size;
+    pPacket->frame = frame;
+    pPacket->keyframe = (pFile->pFrameSizes[frame] & 1) != 0;
+    pPacket->pPalette = NULL;
+    pPacket->paletteSize = 0;
+
+    const BYTE *p = pPacket->pData;
+    DWORD left = size;
+    BYTE type = pFile->pFrameTypes[frame];
+
+    if (type & SMK_FRAME_PALETTE)
+    {
+        DWORD record = left ? (DWORD)p[0] * 4 : 0;
+        if (record == 0 || record > left)
+        {
+            return FALSE;
+        }
+        pPacket->pPalette = p + 1;
+        pPacket->paletteSize = record - 1;
+        p += record;
+        left -= record;
+    }
+
+    for (DWORD i = 0; i < SMACKER_MAX_TRACKS; i++)
+    {
+        pPacket->pAudio[i] = NULL;
+        pPacket->audioSize[i] = 0;
+        if (!(type & (2u << i)))
+        {
+            continue;
+        }
+
+        DWORD chunk = (left >= 4) ? ReadLE32(p) : 0;
+        if (chunk < 4 || chunk > left)
+        {
+            return FALSE;
+        }
+        pPacket->pAudio[i] = p + 4;
+        pPacket->audioSize[i] = chunk - 4;
+        p += chunk;
+        left -= chunk;
+    }
+
+    pPacket->pVideo = p;
+    pPacket->videoSize = left;
+    return TRUE;
+}
+
+// =============================================================================
+// VIDEO
+// =============================================================================
+
+static BYTE Expand6(DWORD v)
+{
+    return (BYTE)(((v & 0x3F) * 255 + 31) / 63);
+}
+
+/*
+ * DecodePalette
+ * Commands until all 256 entries are covered: 1xxxxxxx keeps the next
+ * x + 1 entries, 01xxxxxx copies x + 1 entries of the previous palette
+ * starting at the index in the next byte, otherwise the byte and the next
+ * two are a new entry's 6-bit components.
+ */
+static BOOL DecodePalette(const BYTE *pRecord, DWORD size, BYTE *pPalette)
+{
+    BYTE previous[SMACKER_PALETTE_BYTES];
+    DWORD entry = 0;
+    DWORD pos = 0;
+
+    memcpy(previous, pPalette, SMACKER_PALETTE_BYTES);
+    while (entry < 256)
+    {
+        if (pos >= size)
+        {
+            return FALSE;
+        }
+        DWORD command = pRecord[pos++];
+
+        if (command & 0x80)
+        {
+            entry += (command & 0x7F) + 1;
+        }
+        else if (command & 0x40)
+        {
+            if (pos >= size)
+            {
+                return FALSE;
+            }
+            DWORD from = pRecord[pos++];
+            DWORD count = (command & 0x3F) + 1;
+            if (from + count > 256)
+            {
+                return FALSE;
+            }
+            for (; count > 0 && entry < 256; count--, entry++, from++)
+            {
+                memcpy(pPalette + entry * 3, previous + from * 3, 3);
+            }
+        }
+        else
+        {
+            if (pos + 2 > size)
+            {
+                return FALSE;
+            }
+            pPalette[entry * 3 + 0] = Expand6(command);
+            pPalette[entry * 3 + 1] = Expand6(pRecord[pos]);
+            pPalette[entry * 3 + 2] = Expand6(pRecord[pos + 1]);
+            pos += 2;
+            entry++;
+        }
+    }
+    return TRUE;
+}
+
+static inline void Store16(BYTE *p, DWORD value)
+{
+    p[0] = (BYTE)value;
+    p[1] = (BYTE)(value >> 8);
+}
+
+BOOL __cdecl SMACKER_DecodeVideo(SmackerFile *pFile, const SmackerPacket *pPacket, BYTE *pIndices, DWORD pitch,
+                                 BYTE *pPalette)
+{
+    if (pPacket->pPalette && !DecodePalette(pPacket->pPalette, pPacket->paletteSize, pPalette))
+    {
+        return FALSE;
+    }
+
+    HuffTree *pMap = &pFile->trees[SMK_TREE_MMAP];
+    HuffTree *pColors = &pFile->trees[SMK_TREE_MCLR];
+    HuffTree *pFull = &pFile->trees[SMK_TREE_FULL];
+    HuffTree *pTypes = &pFile->trees[SMK_TREE_TYPE];
+
+    // Recent values start over with every frame
+    for (DWORD i = 0; i < SMK_TREE_COUNT; i++)
+    {
+        HuffTree *pTree = &pFile->trees[i];
+        pTree->pValues[pTree->last[0]] = 0;
+        pTree->pValues[pTree->last[1]] = 0;
+        pTree->pValues[pTree->last[2]] = 0;
+    }
+
+    BitReader reader;
+    InitBits(&reader, pPacket->pVideo, pPacket->videoSize);
+
+    DWORD columns = pFile->info.width / 4;
+    DWORD blocks = columns * (pFile->info.height / 4);
+    BOOL v4 = pFile->info.version == 4;
+    DWORD block = 0;
+
+    while (block < blocks)
+    {
+        DWORD type = GetCode(&reader, pTypes);
+        DWORD run = s_blockRuns[(type >> 2) & 0x3F];
+        if (run > blocks - block)
+        {
+            run = blocks - block;
+        }
+
+        switch (type & 3)
+        {
+        case SMK_BLOCK_MONO:
+            for (; run > 0; run--, block++)
+            {
+                DWORD colors = GetCode(&reader, pColors);
+                DWORD map = GetCode(&reader, pMap);
+                BYTE pair[2] = {(BYTE)colors, (BYTE)(colors >> 8)};
+                BYTE *pOut = pIndices + (size_t)(block / columns) * 4 * pitch + (block % columns) * 4;
+
+                for (DWORD row = 0; row < 4; row++, map >>= 4, pOut += pitch)
+                {
+                    pOut[0] = pair[map & 1];
+                    pOut[1] = pair[(map >> 1) & 1];
+                    pOut[2] = pair[(map >> 2) & 1];
+                    pOut[3] = pair[(map >> 3) & 1];
+                }
+            }
+            break;
+
+        case SMK_BLOCK_FULL:
+        {
+            // SMK4 adds two modes for pixel-doubled content
+            DWORD mode = 0;
+            if (v4)
+            {
+                if (GetBit(&reader))
+                {
+                    mode = 1;
+                }
+                else if (GetBit(&reader))
+                {
+                    mode = 2;
+                }
+            }
+
+            for (; run > 0; run--, block++)
+            {
+                BYTE *pOut = pIndices + (size_t)(block / columns) * 4 * pitch + (block % columns) * 4;
+
+                if (mode == 0)
+                {
+                    for (DWORD row = 0; row < 4; row++, pOut += pitch)
+                    {
+                        Store16(pOut + 2, GetCode(&reader, pFull));
+                        Store16(pOut, GetCode(&reader, pFull));
+                    }
+                }
+                else if (mode == 1)
+                {
+                    // One value per two rows, each byte doubled across
+                    for (DWORD half = 0; half < 2; half++)
+                    {
+                        DWORD value = GetCode(&reader, pFull);
+                        BYTE row[4] = {(BYTE)value, (BYTE)value, (BYTE)(value >> 8), (BYTE)(value >> 8)};
+                        memcpy(pOut, row, 4);
+                        memcpy(pOut + pitch, row, 4);
+                        pOut += 2 * pitch;
+                    }
+                }
+                else
+                {
+                    // Two values per two rows, right half first
+                    for (DWORD half = 0; half < 2; half++)
+                    {
+                        DWORD right = GetCode(&reader, pFull);
+                        DWORD left = GetCode(&reader, pFull);
+                        Store16(pOut, left);
+                        Store16(pOut + 2, right);
+                        memcpy(pOut + pitch, pOut, 4);
+                        pOut += 2 * pitch;
+                    }
+                }
+            }
+            break;
+        }
+
+        case SMK_BLOCK_SKIP:
+            block += run;
+            break;
+
+        case SMK_BLOCK_FILL:
+        {
+            BYTE color = (BYTE)(type >> 8);
+            for (; run > 0; run--, block++)
+            {
+                BYTE *pOut = pIndices + (size_t)(block / columns) * 4 * pitch + (block % columns) * 4;
+                for (DWORD row = 0; row < 4; row++, pOut += pitch)
+                {
+                    memset(pOut, color, 4);
+                }
+            }
+            break;
+        }
+        }
+
+        if (reader.overrun)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// =============================================================================
+// AUDIO
+// =============================================================================
+
+DWORD __cdecl SMACKER_AudioSamples(const SmackerFile *pFile, DWORD track, const SmackerPacket *pPacket)
+{
+    if (track >= SMACKER_MAX_TRACKS || !pPacket->pAudio[track] || !pFile->info.tracks[track].decodable)
+    {
+        return 0;
+    }
+
+    const SmackerTrackInfo *pTrack = &pFile->info.tracks[track];
+    if (!pTrack->compressed)
+    {
+        return pPacket->audioSize[track] / (pTrack->bits / 8);
+    }
+    return (pPacket->audioSize[track] >= 4) ? ReadLE32(pPacket->pAudio[track]) / (pTrack->bits / 8) : 0;
+}
+
+/*
+ * DecodeDpcm
+ * [has data] [stereo] [16 bit], one byte tree per channel (two for 16-bit:
+ * low and high byte of each delta), the first sample of each channel as
+ * is, then per sample a delta added with wraparound - the codec relies on
+ * it rather than clipping.
+ */
+static int DecodeDpcm(const SmackerTrackInfo *pTrack, const BYTE *pChunk, DWORD size, int16_t *pOut,
+                      DWORD maxSamples)
+{
+    if (size < 4)
+    {
+        return -1;
+    }
+
+    DWORD unpacked = ReadLE32(pChunk);
+    BitReader reader;
+    InitBits(&reader, pChunk + 4, size - 4);
+
+    if (!GetBit(&reader))
+    {
+        return 0;
+    }
+    DWORD stereo = GetBit(&reader);
+    DWORD wide = GetBit(&reader);
+    DWORD bytesPerSample = wide ? 2 : 1;
+    DWORD samples = unpacked / bytesPerSample;
+
+    if (stereo != (DWORD)(pTrack->channels == 2) || wide != (DWORD)(pTrack->bits == 16) ||
+        unpacked % (bytesPerSample << stereo) != 0 || samples > maxSamples || samples < stereo + 1u)
+    {
+        return -1;
+    }
+
+    ByteTree trees[4];
+    for (DWORD i = 0; i < (1u << (wide + stereo)); i++)
+    {
+        SkipBits(&reader, 1);
+        if (!ReadByteTree(&reader, &trees[i]))
+        {
+            return -1;
+        }
+        SkipBits(&reader, 1);
+    }
+
+    DWORD i;
+    if (wide)
+    {
+        int16_t predict[2];
+        for (int c = (int)stereo; c >= 0; c--)
+        {
+            DWORD v = GetBits(&reader, 16);
+            predict[c] = (int16_t)(((v & 0xFF) << 8) | (v >> 8));
+        }
+        for (i = 0; i <= stereo; i++)
+        {
+            pOut[i] = predict[i];
+        }
+        for (; i < samples; i++)
+        {
+            DWORD c = i & stereo;
+            DWORD delta = ReadCode(&reader, &trees[2 * c].tree);
+            delta |= ReadCode(&reader, &trees[2 * c + 1].tree) << 8;
+            predict[c] = (int16_t)(WORD)(predict[c] + delta);
+            pOut[i] = predict[c];
+        }
+    }
+    else
+    {
+        BYTE predict[2];
+        for (int c = (int)stereo; c >= 0; c--)
+        {
+            predict[c] = (BYTE)GetBits(&reader, 8);
+        }
+        for (i = 0; i <= stereo; i++)
+        {
+            pOut[i] = (int16_t)(((int)predict[i] - 128) * 256);
+        }
+        for (; i < samples; i++)
+        {
+            DWORD c = i & stereo;
+            predict[c] = (BYTE)(predict[c] + ReadCode(&reader, &trees[c].tree));
+            pOut[i] = (int16_t)(((int)predict[c] - 128) * 256);
+        }
+    }
+
+    return reader.overrun ? -1 : (int)samples;
+}
+
+int __cdecl SMACKER_DecodeAudio(const SmackerFile *pFile, DWORD track, const SmackerPacket *pPacket,
+                                int16_t *pOut, DWORD maxSamples)
+{
+    if (track >= SMACKER_MAX_TRACKS || !pPacket->pAudio[track])
+    {
+        return 0;
+    }
+
+    const SmackerTrackInfo *pTrack = &pFile->info.tracks[track];
+    const BYTE *pChunk = pPacket->pAudio[track];
+    DWORD size = pPacket->audioSize[track];
+
+    if (!pTrack->decodable)
+    {
+        return -1;
+    }
+    if (pTrack->compressed)
+    {
+        return DecodeDpcm(pTrack, pChunk, size, pOut, maxSamples);
+    }
+
+    DWORD samples = size / (pTrack->bits / 8);
+    if (samples > maxSamples)
+    {
+        return -1;
+    }
+    for (DWORD i = 0; i < samples; i++)
+    {
+        pOut[i] = (pTrack->bits == 16) ? (int16_t)(pChunk[i * 2] | (pChunk[i * 2 + 1] << 8))
+                                       : (int16_t)(((int)pChunk[i] - 128) * 256);
+    }
+    return (int)samples;
+}
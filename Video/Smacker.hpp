@@ -0,0 +1,121 @@
+/*
+ * Smacker.hpp - D2Video Smacker (.smk) container and codec
+ *
+ * Cinematics go through SmackW32.dll (SMACKW32_BINARY_ANALYSIS.md), which
+ * decodes, converts and blits on the calling thread. This is the decoding
+ * half on its own, as plain calls the player (SmackPlayer.hpp) can spread
+ * over threads:
+ *   - SMACKER_ReadPacket reads one frame's bytes and splits them into the
+ *     palette record, one chunk per audio track and the video bitstream;
+ *   - SMACKER_DecodeVideo applies a frame to the 8-bit index picture and
+ *     the palette;
+ *   - SMACKER_DecodeAudio decodes one track's chunk to PCM. Chunks carry
+ *     their own Huffman trees, so any chunk decodes without the others.
+ *
+ * Video frames cannot be split the same way: every 4x4 block is coded in
+ * one Huffman bitstream, and the three most recent values of each tree
+ * carry over from block to block. A frame is therefore decoded whole, in
+ * order, on one thread; what parallelises is everything around it (audio,
+ * palette conversion and scaling, and decoding the next frame while the
+ * previous one is displayed).
+ *
+ * Both versions are supported: SMK2, and SMK4 with its two extra full-block
+ * modes. Audio tracks may be Huffman-DPCM compressed or raw PCM, 8 or 16
+ * bit, mono or stereo; Bink-coded tracks (SMK4) are reported but not
+ * decoded. The ring frame used for seamless loops is not played.
+ *
+ * Threading: one SmackerFile is used by one thread at a time, except that
+ * SMACKER_DecodeAudio only reads it and may run on other threads alongside
+ * SMACKER_DecodeVideo.
+ */
+
+#ifndef SMACKER_HPP
+#define SMACKER_HPP
+
+#include "../Sound/AudioStream.hpp"
+
+#define SMACKER_MAX_TRACKS 7
+#define SMACKER_PALETTE_BYTES 768 // 256 x R, G, B
+// Bytes SMACKER_ReadPacket keeps zeroed past the end of a packet, so the
+// bit readers can fetch whole words without checking for the end
+#define SMACKER_PACKET_PADDING 16
+
+// SmackerInfo.flags, as in the file header
+#define SMACKER_FLAG_RING_FRAME 0x01
+#define SMACKER_FLAG_Y_INTERLACED 0x02 // Each row is shown on every other line
+#define SMACKER_FLAG_Y_DOUBLED 0x04    // Each row is shown twice
+
+typedef struct SmackerTrackInfo
+{
+    DWORD sampleRate; // 0 = no track
+    WORD channels;
+    WORD bits;       // 8 (unsigned) or 16 (signed)
+    BOOL compressed; // Huffman DPCM; raw PCM otherwise
+    BOOL decodable;  // FALSE for Bink-coded tracks
+} SmackerTrackInfo;
+
+typedef struct SmackerInfo
+{
+    DWORD version; // 2 or 4
+    DWORD width;
+    DWORD height;
+    DWORD displayHeight; // height x 2 when interlaced or doubled
+    DWORD frames;
+    DWORD usPerFrame;
+    DWORD flags;
+    SmackerTrackInfo tracks[SMACKER_MAX_TRACKS];
+} SmackerInfo;
+
+typedef struct SmackerPacket
+{
+    BYTE *pData; // The frame as stored, plus SMACKER_PACKET_PADDING
+    DWORD size;
+    DWORD capacity;
+    DWORD frame;
+    BOOL keyframe;
+    const BYTE *pPalette; // Palette record after its length byte; NULL = palette unchanged
+    DWORD paletteSize;
+    const BYTE *pAudio[SMACKER_MAX_TRACKS]; // NULL = no chunk for the track in this frame
+    DWORD audioSize[SMACKER_MAX_TRACKS];
+    const BYTE *pVideo;
+    DWORD videoSize;
+} SmackerPacket;
+
+typedef struct SmackerFile SmackerFile;
+
+/*
+ * Reads the header, frame table and Huffman trees. Takes ownership of the
+ * source, which is closed by SMACKER_Close or right away when the file is
+ * rejected (NULL).
+ */
+SmackerFile *__cdecl SMACKER_Open(const StreamSource *pSource);
+void __cdecl SMACKER_Close(SmackerFile *pFile);
+void __cdecl SMACKER_GetInfo(const SmackerFile *pFile, SmackerInfo *pInfo);
+
+void __cdecl SMACKER_InitPacket(SmackerPacket *pPacket);
+void __cdecl SMACKER_FreePacket(SmackerPacket *pPacket);
+// Reads and splits frame `frame`; the packet's buffer grows as needed.
+// FALSE on a read error or a malformed frame.
+BOOL __cdecl SMACKER_ReadPacket(SmackerFile *pFile, DWORD frame, SmackerPacket *pPacket);
+
+/*
+ * Applies the packet to pIndices (width x height, one byte per pixel,
+ * pitch bytes per row) and pPalette (SMACKER_PALETTE_BYTES, 8 bits per
+ * component). Both must hold the previous frame: skipped blocks and
+ * palette entries keep their values. Start from zeroes for frame 0.
+ */
+BOOL __cdecl SMACKER_DecodeVideo(SmackerFile *pFile, const SmackerPacket *pPacket, BYTE *pIndices, DWORD pitch,
+                                 BYTE *pPalette);
+
+// Interleaved samples in the track's chunk of the packet (0 = none)
+DWORD __cdecl SMACKER_AudioSamples(const SmackerFile *pFile, DWORD track, const SmackerPacket *pPacket);
+/*
+ * Decodes the track's chunk as interleaved 16-bit samples in the track's
+ * channel layout (8-bit tracks are widened). Returns the samples written,
+ * 0 when the packet has none, or -1 when the chunk is malformed or holds
+ * more than maxSamples.
+ */
+int __cdecl SMACKER_DecodeAudio(const SmackerFile *pFile, DWORD track, const SmackerPacket *pPacket,
+                                int16_t *pOut, DWORD maxSamples);
+
+#endif // SMACKER_HPP
@@ -0,0 +1,234 @@
+/*
+ * VideoKernels.cpp - D2Video pixel conversion and scaling kernels
+ *
+ * See VideoKernels.hpp. The SSE2 variants work on four pixels (sixteen
+ * 8-bit channels widened to 16 bits) per iteration and fall through to the
+ * scalar loop for the remainder.
+ */
+
+#include "VideoKernels.hpp"
+
+// =============================================================================
+// SCALAR KERNELS
+// =============================================================================
+
+static void ExpandRow(DWORD *pOut, const BYTE *pIndices, const DWORD *pPalette, DWORD count)
+{
+    DWORD i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        DWORD a = pPalette[pIndices[i]];
+        DWORD b = pPalette[pIndices[i + 1]];
+        DWORD c = pPalette[pIndices[i + 2]];
+        DWORD d = pPalette[pIndices[i + 3]];
+        pOut[i] = a;
+        pOut[i + 1] = b;
+        pOut[i + 2] = c;
+        pOut[i + 3] = d;
+    }
+    for (; i < count; i++)
+    {
+        pOut[i] = pPalette[pIndices[i]];
+    }
+}
+
+static inline DWORD Lerp(DWORD a, DWORD b, DWORD weight)
+{
+    DWORD inverse = 256 - weight;
+    DWORD out = 0;
+
+    for (DWORD shift = 0; shift < 32; shift += 8)
+    {
+        DWORD ca = (a >> shift) & 0xFF;
+        DWORD cb = (b >> shift) & 0xFF;
+        out |= ((ca * inverse + cb * weight) >> 8) << shift;
+    }
+    return out;
+}
+
+static void ScaleSmoothScalar(DWORD *pOut, const DWORD *pRow, const VideoTap *pTaps, DWORD count)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        pOut[i] = Lerp(pRow[pTaps[i].x], pRow[pTaps[i].x + 1], pTaps[i].weight);
+    }
+}
+
+static void ScaleNearest(DWORD *pOut, const DWORD *pRow, const VideoTap *pTaps, DWORD count)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        pOut[i] = pRow[pTaps[i].x];
+    }
+}
+
+static void BlendRowsScalar(DWORD *pOut, const DWORD *pTop, const DWORD *pBottom, DWORD weight, DWORD count)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        pOut[i] = Lerp(pTop[i], pBottom[i], weight);
+    }
+}
+
+static inline WORD ToRgb565(DWORD pixel)
+{
+    return (WORD)(((pixel >> 8) & 0xF800) | ((pixel >> 5) & 0x07E0) | ((pixel >> 3) & 0x001F));
+}
+
+static void PackRgb565Scalar(WORD *pOut, const DWORD *pIn, DWORD count)
+{
+    for (DWORD i = 0; i < count; i++)
+    {
+        pOut[i] = ToRgb565(pIn[i]);
+    }
+}
+
+// =============================================================================
+// SSE2 KERNELS
+// =============================================================================
+
+#if D2_SIMD_SSE2
+
+// Pixels x and x + 1 as eight 16-bit channels (x's in the low half)
+static inline __m128i LoadPair(const DWORD *pRow, DWORD x)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pRow + x)), _mm_setzero_si128());
+}
+
+// Weight repeated over one pixel's four channels, for pixels i and i + 1
+static inline __m128i TapWeights(const VideoTap *pTaps)
+{
+    return _mm_set_epi16((short)pTaps[1].weight, (short)pTaps[1].weight, (short)pTaps[1].weight,
+                         (short)pTaps[1].weight, (short)pTaps[0].weight, (short)pTaps[0].weight,
+                         (short)pTaps[0].weight, (short)pTaps[0].weight);
+}
+
+// (a * (256 - w) + b * w) >> 8 per 16-bit lane; no lane exceeds 255 * 256
+static inline __m128i Lerp16(__m128i a, __m128i b, __m128i weight)
+{
+    __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(256), weight);
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, inverse), _mm_mullo_epi16(b, weight));
+    return _mm_srli_epi16(sum, 8);
+}
+
+static inline __m128i ScaleTwo(const DWORD *pRow, const VideoTap *pTaps)
+{
+    __m128i first = LoadPair(pRow, pTaps[0].x);
+    __m128i second = LoadPair(pRow, pTaps[1].x);
+    __m128i left = _mm_unpacklo_epi64(first, second);
+    __m128i right = _mm_unpackhi_epi64(first, second);
+    return Lerp16(left, right, TapWeights(pTaps));
+}
+
+static void ScaleSmoothSse2(DWORD *pOut, const DWORD *pRow, const VideoTap *pTaps, DWORD count)
+{
+    DWORD i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i low = ScaleTwo(pRow, pTaps + i);
+        __m128i high = ScaleTwo(pRow, pTaps + i + 2);
+        _mm_storeu_si128((__m128i *)(pOut + i), _mm_packus_epi16(low, high));
+    }
+    ScaleSmoothScalar(pOut + i, pRow, pTaps + i, count - i);
+}
+
+static void BlendRowsSse2(DWORD *pOut, const DWORD *pTop, const DWORD *pBottom, DWORD weight, DWORD count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w = _mm_set1_epi16((short)weight);
+    DWORD i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(pTop + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(pBottom + i));
+        __m128i low = Lerp16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), w);
+        __m128i high = Lerp16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), w);
+        _mm_storeu_si128((__m128i *)(pOut + i), _mm_packus_epi16(low, high));
+    }
+    BlendRowsScalar(pOut + i, pTop + i, pBottom + i, weight, count - i);
+}
+
+static inline __m128i Rgb565x4(__m128i pixels)
+{
+    __m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 8), _mm_set1_epi32(0xF800));
+    __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x07E0));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 3), _mm_set1_epi32(0x001F));
+    __m128i v = _mm_or_si128(_mm_or_si128(r, g), b);
+    // Sign-extend so the signed saturating pack keeps all 16 bits
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static void PackRgb565Sse2(WORD *pOut, const DWORD *pIn, DWORD count)
+{
+    DWORD i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i low = Rgb565x4(_mm_loadu_si128((const __m128i *)(pIn + i)));
+        __m128i high = Rgb565x4(_mm_loadu_si128((const __m128i *)(pIn + i + 4)));
+        _mm_storeu_si128((__m128i *)(pOut + i), _mm_packs_epi32(low, high));
+    }
+    PackRgb565Scalar(pOut + i, pIn + i, count - i);
+}
+
+#endif // D2_SIMD_SSE2
+
+// =============================================================================
+// SELECTION AND SETUP
+// =============================================================================
+
+void __cdecl VIDEOKERNELS_Select(VideoKernels *pKernels, BOOL forceScalar)
+{
+    pKernels->pfnExpand = ExpandRow;
+    pKernels->pfnScaleSmooth = ScaleSmoothScalar;
+    pKernels->pfnScaleNearest = ScaleNearest;
+    pKernels->pfnBlend = BlendRowsScalar;
+    pKernels->pfnPack565 = PackRgb565Scalar;
+    pKernels->simd = FALSE;
+
+#if D2_SIMD_SSE2
+    if (!forceScalar)
+    {
+        pKernels->pfnScaleSmooth = ScaleSmoothSse2;
+        pKernels->pfnBlend = BlendRowsSse2;
+        pKernels->pfnPack565 = PackRgb565Sse2;
+        pKernels->simd = TRUE;
+    }
+#else
+    (void)forceScalar;
+#endif
+}
+
+void __cdecl VIDEOKERNELS_BuildTaps(VideoTap *pTaps, DWORD outCount, DWORD srcCount, BOOL smooth)
+{
+    // Source position of output centre i, 16.16: (i + 0.5) * src / out - 0.5
+    uint64_t step = ((uint64_t)srcCount << 16) / outCount;
+    int64_t pos = (int64_t)(step >> 1) - 0x8000;
+    int64_t last = (int64_t)(srcCount - 1) << 16;
+
+    for (DWORD i = 0; i < outCount; i++, pos += (int64_t)step)
+    {
+        if (!smooth)
+        {
+            uint64_t x = (((uint64_t)i * 2 + 1) * srcCount) / ((uint64_t)outCount * 2);
+            pTaps[i].x = (DWORD)x;
+            pTaps[i].weight = 0;
+            continue;
+        }
+
+        int64_t p = (pos < 0) ? 0 : (pos > last ? last : pos);
+        pTaps[i].x = (DWORD)(p >> 16);
+        pTaps[i].weight = (DWORD)((p & 0xFFFF) + 0x80) >> 8;
+    }
+}
+
+void __cdecl VIDEOKERNELS_ConvertPalette(DWORD *pOut, const BYTE *pPalette)
+{
+    for (DWORD i = 0; i < 256; i++)
+    {
+        pOut[i] = ((DWORD)pPalette[i * 3] << 16) | ((DWORD)pPalette[i * 3 + 1] << 8) | pPalette[i * 3 + 2];
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * VideoKernels.hpp - D2Video pixel conversion and scaling kernels
+ *
+ * Inner loops that take a decoded 8-bit frame to the screen format. Pixels
+ * are 32-bit XRGB (0x00RRGGBB) until the last step, which either stores
+ * them as they are or packs them to RGB565 for 16-bit modes.
+ *
+ * Filtering is separable: rows are scaled horizontally, then pairs of
+ * scaled rows are blended vertically. A weight of 0..256 pulls from the
+ * left (upper) pixel toward the next one; every channel is computed as
+ *     (a * (256 - weight) + b * weight) >> 8
+ * Scalar and SSE2 variants evaluate exactly that, so both produce
+ * bit-identical output.
+ */
+
+#ifndef VIDEOKERNELS_HPP
+#define VIDEOKERNELS_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef struct VideoTap
+{
+    DWORD x;      // Source pixel (or row)
+    DWORD weight; // 0..256 toward x + 1
+} VideoTap;
+
+// pRow holds one pixel more than the taps reach (a copy of the last one)
+typedef void (*PFN_ExpandRow)(DWORD *pOut, const BYTE *pIndices, const DWORD *pPalette, DWORD count);
+typedef void (*PFN_ScaleRow)(DWORD *pOut, const DWORD *pRow, const VideoTap *pTaps, DWORD count);
+typedef void (*PFN_BlendRows)(DWORD *pOut, const DWORD *pTop, const DWORD *pBottom, DWORD weight, DWORD count);
+typedef void (*PFN_PackRgb565)(WORD *pOut, const DWORD *pIn, DWORD count);
+
+typedef struct VideoKernels
+{
+    PFN_ExpandRow pfnExpand; // Palette lookup; SSE2 has no gather, so this one is scalar in both sets
+    PFN_ScaleRow pfnScaleSmooth;
+    PFN_ScaleRow pfnScaleNearest;
+    PFN_BlendRows pfnBlend;
+    PFN_PackRgb565 pfnPack565;
+    BOOL simd;
+} VideoKernels;
+
+void __cdecl VIDEOKERNELS_Select(VideoKernels *pKernels, BOOL forceScalar);
+
+/*
+ * Maps outCount output pixels onto srcCount source pixels, pixel centres
+ * aligned. Smooth taps carry the fractional position as the weight;
+ * nearest taps have weight 0. No tap reaches past srcCount - 1 with a
+ * non-zero weight.
+ */
+void __cdecl VIDEOKERNELS_BuildTaps(VideoTap *pTaps, DWORD outCount, DWORD srcCount, BOOL smooth);
+
+// 768-byte R, G, B palette to XRGB
+void __cdecl VIDEOKERNELS_ConvertPalette(DWORD *pOut, const BYTE *pPalette);
+
+#endif // VIDEOKERNELS_HPP
@@ -0,0 +1,240 @@
+/*
+ * GlyphAtlas.cpp - D2Win glyph atlas
+ * Original source: X:\trunk\Diablo2\Source\D2Win\Src\D2WinFont.cpp
+ *
+ * See GlyphAtlas.hpp for the design overview.
+ */
+
+#include "GlyphAtlas.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// INITIALIZATION
+// =============================================================================
+
+/*
+ * GLYPHATLAS_Init
+ * Allocate the atlas surface and bind the glyph callback
+ * Width/height are limited to 65534 so rectangles fit in 16 bits.
+ */
+BOOL __cdecl GLYPHATLAS_Init(GlyphAtlas *pAtlas, DWORD width, DWORD height,
+                             PFN_GetGlyphBitmap pfnGetGlyph, void *pUserData)
+{
+    if (!pAtlas || !pfnGetGlyph || width == 0 || height == 0 ||
+        width >= GLYPHATLAS_NOT_LOADED || height >= GLYPHATLAS_NOT_LOADED)
+    {
+        return FALSE;
+    }
+
+    memset(pAtlas, 0, sizeof(GlyphAtlas));
+
+    pAtlas->pixels = (BYTE *)calloc((size_t)width * height, 1);
+    if (!pAtlas->pixels)
+    {
+        return FALSE;
+    }
+
+    pAtlas->width = width;
+    pAtlas->height = height;
+    pAtlas->pfnGetGlyph = pfnGetGlyph;
+    pAtlas->pUserData = pUserData;
+    pAtlas->epoch = 1;
+    return TRUE;
+}
+
+void __cdecl GLYPHATLAS_Free(GlyphAtlas *pAtlas)
+{
+    if (!pAtlas)
+    {
+        return;
+    }
+
+    for (DWORD f = 0; f < GLYPHATLAS_MAX_FONTS; f++)
+    {
+        for (DWORD p = 0; p < GLYPHATLAS_PAGE_COUNT; p++)
+        {
+            free(pAtlas->fonts[f].pages[p]);
+        }
+    }
+
+    free(pAtlas->pixels);
+    memset(pAtlas, 0, sizeof(GlyphAtlas));
+}
+
+BOOL __cdecl GLYPHATLAS_RegisterFont(GlyphAtlas *pAtlas, DWORD fontId, BYTE lineHeight)
+{
+    if (!pAtlas || fontId >= GLYPHATLAS_MAX_FONTS)
+    {
+        return FALSE;
+    }
+
+    pAtlas->fonts[fontId].registered = TRUE;
+    pAtlas->fonts[fontId].lineHeight = lineHeight;
+    return TRUE;
+}
+
+BYTE __cdecl GLYPHATLAS_GetLineHeight(const GlyphAtlas *pAtlas, DWORD fontId)
+{
+    if (!pAtlas || fontId >= GLYPHATLAS_MAX_FONTS)
+    {
+        return 0;
+    }
+    return pAtlas->fonts[fontId].lineHeight;
+}
+
+/*
+ * GLYPHATLAS_Reset
+ * Forget every packed glyph. Pages stay allocated but are marked unloaded.
+ */
+void __cdecl GLYPHATLAS_Reset(GlyphAtlas *pAtlas)
+{
+    for (DWORD f = 0; f < GLYPHATLAS_MAX_FONTS; f++)
+    {
+        for (DWORD p = 0; p < GLYPHATLAS_PAGE_COUNT; p++)
+        {
+            AtlasGlyph *pPage = pAtlas->fonts[f].pages[p];
+            if (pPage)
+            {
+                for (DWORD i = 0; i < 256; i++)
+                {
+                    pPage[i].srcX = GLYPHATLAS_NOT_LOADED;
+                }
+            }
+        }
+    }
+
+    memset(pAtlas->pixels, 0, (size_t)pAtlas->width * pAtlas->height);
+    pAtlas->shelfX = 0;
+    pAtlas->shelfY = 0;
+    pAtlas->shelfHeight = 0;
+    pAtlas->epoch++;
+    pAtlas->resets++;
+}
+
+// =============================================================================
+// PACKING
+// =============================================================================
+
+/*
+ * AllocateRect
+ * Shelf packer: glyphs fill a row left to right, a new shelf starts when the
+ * current one is full. Font glyphs have near-uniform heights, so shelves waste
+ * very little space.
+ */
+static BOOL AllocateRect(GlyphAtlas *pAtlas, DWORD width, DWORD height, DWORD *pX, DWORD *pY)
+{
+    if (width > pAtlas->width || height > pAtlas->height)
+    {
+        return FALSE;
+    }
+
+    if (pAtlas->shelfX + width > pAtlas->width)
+    {
+        pAtlas->shelfY += pAtlas->shelfHeight;
+        pAtlas->shelfX = 0;
+        pAtlas->shelfHeight = 0;
+    }
+
+    if (pAtlas->shelfY + height > pAtlas->height)
+    {
+        return FALSE;
+    }
+
+    *pX = pAtlas->shelfX;
+    *pY = pAtlas->shelfY;
+
+    pAtlas->shelfX += width;
+    if (height > pAtlas->shelfHeight)
+    {
+        pAtlas->shelfHeight = height;
+    }
+    return TRUE;
+}
+
+static AtlasGlyph *GetGlyphSlot(AtlasFont *pFont, D2UNICHAR ch)
+{
+    DWORD page = ch >> 8;
+
+    if (!pFont->pages[page])
+    {
+        AtlasGlyph *pPage = (AtlasGlyph *)malloc(256 * sizeof(AtlasGlyph));
+        if (!pPage)
+        {
+            return NULL;
+        }
+        for (DWORD i = 0; i < 256; i++)
+        {
+            pPage[i].srcX = GLYPHATLAS_NOT_LOADED;
+        }
+        pFont->pages[page] = pPage;
+    }
+
+    return &pFont->pages[page][ch & 0xFF];
+}
+
+/*
+ * GLYPHATLAS_GetGlyph
+ * Fast path is a two-level table lookup; the callback and packer only run the
+ * first time a (font, character) pair is drawn after a reset.
+ */
+const AtlasGlyph *__cdecl GLYPHATLAS_GetGlyph(GlyphAtlas *pAtlas, DWORD fontId, D2UNICHAR ch)
+{
+    if (fontId >= GLYPHATLAS_MAX_FONTS || !pAtlas->fonts[fontId].registered)
+    {
+        return NULL;
+    }
+
+    AtlasFont *pFont = &pAtlas->fonts[fontId];
+    AtlasGlyph *pGlyph = GetGlyphSlot(pFont, ch);
+    if (!pGlyph)
+    {
+        return NULL;
+    }
+
+    if (pGlyph->srcX != GLYPHATLAS_NOT_LOADED)
+    {
+        return pGlyph;
+    }
+
+    GlyphBitmap bitmap;
+    memset(&bitmap, 0, sizeof(bitmap));
+    if (!pAtlas->pfnGetGlyph(pAtlas->pUserData, fontId, ch, &bitmap))
+    {
+        return NULL;
+    }
+
+    DWORD x = 0, y = 0;
+    BOOL hasPixels = (bitmap.pixels && bitmap.width && bitmap.height);
+
+    if (hasPixels && !AllocateRect(pAtlas, bitmap.width, bitmap.height, &x, &y))
+    {
+        // Atlas full: start over. Everything packed so far is invalidated via
+        // the epoch, so the caller's in-progress layout is rebuilt next time.
+        GLYPHATLAS_Reset(pAtlas);
+        if (!AllocateRect(pAtlas, bitmap.width, bitmap.height, &x, &y))
+        {
+            return NULL;
+        }
+    }
+
+    if (hasPixels)
+    {
+        for (DWORD row = 0; row < bitmap.height; row++)
+        {
+            memcpy(pAtlas->pixels + (size_t)(y + row) * pAtlas->width + x,
+                   bitmap.pixels + (size_t)row * bitmap.pitch,
+                   bitmap.width);
+        }
+        pAtlas->glyphsPacked++;
+    }
+
+    pGlyph->srcX = (WORD)x;
+    pGlyph->srcY = (WORD)y;
+    pGlyph->width = hasPixels ? bitmap.width : 0;
+    pGlyph->height = hasPixels ? bitmap.height : 0;
+    pGlyph->advance = bitmap.advance;
+    pGlyph->offsetY = bitmap.offsetY;
+    return pGlyph;
+}
@@ -0,0 +1,102 @@
+/*
+ * GlyphAtlas.hpp - D2Win glyph atlas
+ * Original source: X:\trunk\Diablo2\Source\D2Win\Src\D2WinFont.cpp
+ *
+ * D2Win draws every character by looking up its width in the D2Lang/.tbl
+ * font table and blitting the matching DC6 frame on its own. The atlas packs
+ * each glyph that has been drawn at least once into a single 8-bit
+ * palette-indexed surface (shelf packing), so layouts can refer to glyphs by
+ * atlas rectangle and blit them in one batch.
+ *
+ * Glyph bitmaps are supplied by a callback (the DC6 font decoder in the game,
+ * a synthetic generator in the benchmark). Glyph tables are paged by the high
+ * byte of the Unicode code point so only pages actually used are allocated.
+ */
+
+#ifndef GLYPHATLAS_HPP
+#define GLYPHATLAS_HPP
+
+#include "../Shared/D2Shared.hpp"
+
+typedef uint16_t D2UNICHAR; // D2Lang strings are UCS-2
+
+#define GLYPHATLAS_MAX_FONTS 16
+#define GLYPHATLAS_PAGE_COUNT 256 // 256 pages x 256 glyphs = UCS-2 range
+
+// Bitmap of a single glyph as returned by the font callback.
+// pixels == NULL (or width/height == 0) means an empty glyph (e.g. space).
+typedef struct GlyphBitmap
+{
+    const BYTE *pixels; // Palette indices, 0 = transparent
+    DWORD pitch;        // Bytes per source row
+    BYTE width;
+    BYTE height;
+    BYTE advance;        // Horizontal advance in pixels
+    signed char offsetY; // Baseline adjustment relative to the line top
+} GlyphBitmap;
+
+typedef BOOL(__cdecl *PFN_GetGlyphBitmap)(void *pUserData, DWORD fontId, D2UNICHAR ch, GlyphBitmap *pOut);
+
+#define GLYPHATLAS_NOT_LOADED 0xFFFF
+
+// Resolved glyph entry (8 bytes). srcX == GLYPHATLAS_NOT_LOADED until packed.
+typedef struct AtlasGlyph
+{
+    WORD srcX;
+    WORD srcY;
+    BYTE width;
+    BYTE height;
+    BYTE advance;
+    signed char offsetY;
+} AtlasGlyph;
+
+typedef struct AtlasFont
+{
+    BOOL registered;
+    BYTE lineHeight;
+    AtlasGlyph *pages[GLYPHATLAS_PAGE_COUNT]; // Lazily allocated 256-glyph pages
+} AtlasFont;
+
+typedef struct GlyphAtlas
+{
+    BYTE *pixels; // width * height palette indices
+    DWORD width;
+    DWORD height;
+
+    // Shelf packer state
+    DWORD shelfX;
+    DWORD shelfY;
+    DWORD shelfHeight;
+
+    // Bumped every time the atlas is reset; layouts built against an older
+    // epoch refer to stale rectangles and must be rebuilt.
+    DWORD epoch;
+
+    PFN_GetGlyphBitmap pfnGetGlyph;
+    void *pUserData;
+
+    AtlasFont fonts[GLYPHATLAS_MAX_FONTS];
+
+    DWORD glyphsPacked;
+    DWORD resets;
+} GlyphAtlas;
+
+BOOL __cdecl GLYPHATLAS_Init(GlyphAtlas *pAtlas, DWORD width, DWORD height,
+                             PFN_GetGlyphBitmap pfnGetGlyph, void *pUserData);
+void __cdecl GLYPHATLAS_Free(GlyphAtlas *pAtlas);
+
+BOOL __cdecl GLYPHATLAS_RegisterFont(GlyphAtlas *pAtlas, DWORD fontId, BYTE lineHeight);
+BYTE __cdecl GLYPHATLAS_GetLineHeight(const GlyphAtlas *pAtlas, DWORD fontId);
+
+// Drop every packed glyph (palette/font reload, or atlas full). Bumps epoch.
+void __cdecl GLYPHATLAS_Reset(GlyphAtlas *pAtlas);
+
+/*
+ * Resolve a glyph, packing it into the atlas on first use.
+ * Returns NULL for unregistered fonts or when the callback fails. If the atlas
+ * is full it is reset and the glyph packed into the fresh atlas; callers
+ * detect this through a changed epoch.
+ */
+const AtlasGlyph *__cdecl GLYPHATLAS_GetGlyph(GlyphAtlas *pAtlas, DWORD fontId, D2UNICHAR ch);
+
+#endif // GLYPHATLAS_HPP
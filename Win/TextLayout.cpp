@@ -0,0 +1,793 @@
+/*
+ * TextLayout.cpp - D2Win cached text layout engine
+ * Original source: X:\trunk\Diablo2\Source\D2Win\Src\D2WinFont.cpp
+ *
+ * See TextLayout.hpp for the design overview.
+ */
+
+#include "TextLayout.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TEXTCACHE_NIL 0xFFFFFFFFu
+
+struct TextCacheEntry
+{
+    DWORD hash;
+    DWORD stringId; // D2Lang id; unused for content-keyed entries
+    DWORD fontId;
+    DWORD maxWidth;
+    BOOL isText; // Keyed by content rather than string id
+
+    D2UNICHAR *text; // Copy of the content for content-keyed entries
+    DWORD textLength;
+    DWORD textCapacity;
+
+    DWORD generation; // String generation the layout was built from
+    DWORD epoch;      // Cache epoch the layout was built in
+
+    DWORD nextInBucket;
+    DWORD lruPrev;
+    DWORD lruNext;
+
+    TextLayout layout;
+};
+
+// =============================================================================
+// LAYOUT
+// =============================================================================
+
+/*
+ * ColorFromCode
+ * Map the character following "\xFFc" to a color index
+ * 0=white 1=red 2=green 3=blue 4=gold 5=gray 6=black 7=tan 8=orange 9=yellow
+ * ;=purple :=dark green .=dark gold (remaining codes fall back to default)
+ */
+static BYTE ColorFromCode(D2UNICHAR code)
+{
+    if (code >= '0' && code <= '9')
+    {
+        return (BYTE)(code - '0');
+    }
+    if (code == ';')
+    {
+        return 10;
+    }
+    if (code == ':')
+    {
+        return 11;
+    }
+    if (code == '.')
+    {
+        return 12;
+    }
+    return TEXT_COLOR_DEFAULT;
+}
+
+static BOOL ReserveQuads(TextLayout *pLayout, DWORD count)
+{
+    if (count <= pLayout->quadCapacity)
+    {
+        return TRUE;
+    }
+
+    DWORD newCapacity = pLayout->quadCapacity ? pLayout->quadCapacity : 32;
+    while (newCapacity < count)
+    {
+        newCapacity *= 2;
+    }
+
+    TextQuad *pQuads = (TextQuad *)realloc(pLayout->quads, newCapacity * sizeof(TextQuad));
+    if (!pQuads)
+    {
+        return FALSE;
+    }
+    pLayout->quads = pQuads;
+    pLayout->quadCapacity = newCapacity;
+    return TRUE;
+}
+
+static BOOL PushLine(TextLayout *pLayout, DWORD width)
+{
+    if (pLayout->lineCount == pLayout->lineCapacity)
+    {
+        DWORD newCapacity = pLayout->lineCapacity ? pLayout->lineCapacity * 2 : 4;
+        WORD *pLines = (WORD *)realloc(pLayout->lineWidths, newCapacity * sizeof(WORD));
+        if (!pLines)
+        {
+            return FALSE;
+        }
+        pLayout->lineWidths = pLines;
+        pLayout->lineCapacity = newCapacity;
+    }
+
+    pLayout->lineWidths[pLayout->lineCount++] = (WORD)width;
+    if (width > pLayout->width)
+    {
+        pLayout->width = (WORD)width;
+    }
+    return TRUE;
+}
+
+/*
+ * ShapeText
+ * Single pass over the string: resolves glyphs, applies color codes and
+ * greedy word wrap. When a word overflows maxWidth, the quads emitted since
+ * the last space are moved down to the next line instead of re-shaping.
+ */
+static BOOL ShapeText(GlyphAtlas *pAtlas, const D2UNICHAR *pText, DWORD fontId,
+                      DWORD maxWidth, TextLayout *pLayout)
+{
+    DWORD lineHeight = GLYPHATLAS_GetLineHeight(pAtlas, fontId);
+    DWORD penX = 0;
+    DWORD inkX = 0; // penX excluding trailing spaces
+    DWORD y = 0;
+    BYTE color = TEXT_COLOR_DEFAULT;
+
+    DWORD breakQuad = TEXTCACHE_NIL; // First quad after the last space on this line
+    DWORD breakWidth = 0;            // Line width before that space
+    DWORD breakResumeX = 0;          // penX after that space
+
+    pLayout->quadCount = 0;
+    pLayout->lineCount = 0;
+    pLayout->width = 0;
+    pLayout->height = 0;
+
+    for (DWORD i = 0; pText[i] && i < TEXT_MAX_LENGTH; i++)
+    {
+        D2UNICHAR ch = pText[i];
+
+        if (ch == TEXT_COLOR_ESCAPE && pText[i + 1] == 'c' && pText[i + 2])
+        {
+            color = ColorFromCode(pText[i + 2]);
+            i += 2;
+            continue;
+        }
+
+        if (ch == '\n')
+        {
+            if (!PushLine(pLayout, inkX))
+            {
+                return FALSE;
+            }
+            y += lineHeight;
+            penX = inkX = 0;
+            breakQuad = TEXTCACHE_NIL;
+            continue;
+        }
+
+        const AtlasGlyph *pGlyph = GLYPHATLAS_GetGlyph(pAtlas, fontId, ch);
+        if (!pGlyph)
+        {
+            continue; // Missing glyph: D2Win skips it as well
+        }
+
+        if (ch == ' ')
+        {
+            breakQuad = pLayout->quadCount;
+            breakWidth = inkX;
+            penX += pGlyph->advance;
+            breakResumeX = penX;
+            continue;
+        }
+
+        if (maxWidth && penX + pGlyph->advance > maxWidth && breakQuad != TEXTCACHE_NIL)
+        {
+            // Wrap at the last space: shift the partial word to a new line
+            if (!PushLine(pLayout, breakWidth))
+            {
+                return FALSE;
+            }
+            y += lineHeight;
+            for (DWORD q = breakQuad; q < pLayout->quadCount; q++)
+            {
+                pLayout->quads[q].dstX = (short)(pLayout->quads[q].dstX - (short)breakResumeX);
+                pLayout->quads[q].dstY = (short)(pLayout->quads[q].dstY + (short)lineHeight);
+            }
+            penX -= breakResumeX;
+            inkX = penX;
+            breakQuad = TEXTCACHE_NIL;
+        }
+
+        if (pGlyph->width)
+        {
+            if (!ReserveQuads(pLayout, pLayout->quadCount + 1))
+            {
+                return FALSE;
+            }
+            TextQuad *pQuad = &pLayout->quads[pLayout->quadCount++];
+            pQuad->dstX = (short)penX;
+            pQuad->dstY = (short)(y + pGlyph->offsetY);
+            pQuad->srcX = pGlyph->srcX;
+            pQuad->srcY = pGlyph->srcY;
+            pQuad->width = pGlyph->width;
+            pQuad->height = pGlyph->height;
+            pQuad->color = color;
+            pQuad->reserved = 0;
+        }
+
+        penX += pGlyph->advance;
+        inkX = penX;
+    }
+
+    if (!PushLine(pLayout, inkX))
+    {
+        return FALSE;
+    }
+    pLayout->height = (WORD)(y + lineHeight);
+    return TRUE;
+}
+
+/*
+ * TEXTLAYOUT_Build
+ * Shape text into a layout. If packing a glyph resets the atlas half way
+ * through, quads emitted earlier point at stale rectangles, so shaping is
+ * retried once against the fresh atlas.
+ */
+BOOL __cdecl TEXTLAYOUT_Build(GlyphAtlas *pAtlas, const D2UNICHAR *pText, DWORD fontId,
+                              DWORD maxWidth, TextLayout *pLayout)
+{
+    if (!pAtlas || !pLayout || fontId >= GLYPHATLAS_MAX_FONTS || !pAtlas->fonts[fontId].registered)
+    {
+        return FALSE;
+    }
+
+    static const D2UNICHAR kEmpty[1] = {0};
+    if (!pText)
+    {
+        pText = kEmpty;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        DWORD epoch = pAtlas->epoch;
+        if (!ShapeText(pAtlas, pText, fontId, maxWidth, pLayout))
+        {
+            return FALSE;
+        }
+        if (pAtlas->epoch == epoch)
+        {
+            pLayout->atlasEpoch = epoch;
+            return TRUE;
+        }
+    }
+
+    // Text needs more glyphs than fit in the atlas at once
+    return FALSE;
+}
+
+void __cdecl TEXTLAYOUT_Free(TextLayout *pLayout)
+{
+    if (!pLayout)
+    {
+        return;
+    }
+    free(pLayout->quads);
+    free(pLayout->lineWidths);
+    memset(pLayout, 0, sizeof(TextLayout));
+}
+
+// =============================================================================
+// STRING GENERATIONS
+// =============================================================================
+
+static DWORD GetGeneration(const TextLayoutCache *pCache, DWORD stringId)
+{
+    DWORD key = stringId + 1;
+    DWORD slot = D2_HashDword(key) & pCache->genMask;
+
+    while (pCache->genKeys[slot])
+    {
+        if (pCache->genKeys[slot] == key)
+        {
+            return pCache->genValues[slot];
+        }
+        slot = (slot + 1) & pCache->genMask;
+    }
+    return 0;
+}
+
+static BOOL GrowGenerations(TextLayoutCache *pCache)
+{
+    DWORD oldSize = pCache->genMask + 1;
+    DWORD newSize = oldSize * 2;
+    DWORD *pKeys = (DWORD *)calloc(newSize, sizeof(DWORD));
+    DWORD *pValues = (DWORD *)calloc(newSize, sizeof(DWORD));
+    if (!pKeys || !pValues)
+    {
+        free(pKeys);
+        free(pValues);
+        return FALSE;
+    }
+
+    for (DWORD i = 0; i < oldSize; i++)
+    {
+        if (pCache->genKeys[i])
+        {
+            DWORD slot = D2_HashDword(pCache->genKeys[i]) & (newSize - 1);
+            while (pKeys[slot])
+            {
+                slot = (slot + 1) & (newSize - 1);
+            }
+            pKeys[slot] = pCache->genKeys[i];
+            pValues[slot] = pCache->genValues[i];
+        }
+    }
+
+    free(pCache->genKeys);
+    free(pCache->genValues);
+    pCache->genKeys = pKeys;
+    pCache->genValues = pValues;
+    pCache->genMask = newSize - 1;
+    return TRUE;
+}
+
+void __cdecl TEXTLAYOUT_InvalidateString(TextLayoutCache *pCache, DWORD stringId)
+{
+    if ((pCache->genCount + 1) * 2 > pCache->genMask + 1 && !GrowGenerations(pCache))
+    {
+        // Out of memory: fall back to rebuilding everything
+        TEXTLAYOUT_InvalidateAll(pCache);
+        return;
+    }
+
+    DWORD key = stringId + 1;
+    DWORD slot = D2_HashDword(key) & pCache->genMask;
+    while (pCache->genKeys[slot] && pCache->genKeys[slot] != key)
+    {
+        slot = (slot + 1) & pCache->genMask;
+    }
+
+    if (!pCache->genKeys[slot])
+    {
+        pCache->genKeys[slot] = key;
+        pCache->genValues[slot] = 0;
+        pCache->genCount++;
+    }
+    pCache->genValues[slot]++;
+}
+
+void __cdecl TEXTLAYOUT_InvalidateAll(TextLayoutCache *pCache)
+{
+    pCache->globalEpoch++;
+}
+
+// =============================================================================
+// CACHE
+// =============================================================================
+
+BOOL __cdecl TEXTLAYOUT_InitCache(TextLayoutCache *pCache, GlyphAtlas *pAtlas, DWORD capacity,
+                                  PFN_GetStringById pfnGetString, void *pUserData)
+{
+    if (!pCache || !pAtlas || capacity == 0)
+    {
+        return FALSE;
+    }
+
+    memset(pCache, 0, sizeof(TextLayoutCache));
+    pCache->pAtlas = pAtlas;
+    pCache->pfnGetString = pfnGetString;
+    pCache->pUserData = pUserData;
+    pCache->capacity = capacity;
+    pCache->bucketMask = D2_NextPow2(capacity) - 1;
+    pCache->genMask = 63;
+    pCache->lruHead = TEXTCACHE_NIL;
+    pCache->lruTail = TEXTCACHE_NIL;
+    pCache->globalEpoch = 1;
+
+    pCache->entries = (TextCacheEntry *)calloc(capacity, sizeof(TextCacheEntry));
+    pCache->buckets = (DWORD *)malloc((pCache->bucketMask + 1) * sizeof(DWORD));
+    pCache->genKeys = (DWORD *)calloc(pCache->genMask + 1, sizeof(DWORD));
+    pCache->genValues = (DWORD *)calloc(pCache->genMask + 1, sizeof(DWORD));
+    if (!pCache->entries || !pCache->buckets || !pCache->genKeys || !pCache->genValues)
+    {
+        TEXTLAYOUT_FreeCache(pCache);
+        return FALSE;
+    }
+
+    memset(pCache->buckets, 0xFF, (pCache->bucketMask + 1) * sizeof(DWORD));
+    return TRUE;
+}
+
+void __cdecl TEXTLAYOUT_FreeCache(TextLayoutCache *pCache)
+{
+    if (!pCache)
+    {
+        return;
+    }
+
+    if (pCache->entries)
+    {
+        for (DWORD i = 0; i < pCache->count; i++)
+        {
+            TEXTLAYOUT_Free(&pCache->entries[i].layout);
+            free(pCache->entries[i].text);
+        }
+    }
+
+    free(pCache->entries);
+    free(pCache->buckets);
+    free(pCache->genKeys);
+    free(pCache->genValues);
+    memset(pCache, 0, sizeof(TextLayoutCache));
+}
+
+static void LruUnlink(TextLayoutCache *pCache, DWORD index)
+{
+    TextCacheEntry *pEntry = &pCache->entries[index];
+
+    if (pEntry->lruPrev != TEXTCACHE_NIL)
+        pCache->entries[pEntry->lruPrev].lruNext = pEntry->lruNext;
+    else
+        pCache->lruHead = pEntry->lruNext;
+
+    if (pEntry->lruNext != TEXTCACHE_NIL)
+        pCache->entries[pEntry->lruNext].lruPrev = pEntry->lruPrev;
+    else
+        pCache->lruTail = pEntry->lruPrev;
+}
+
+static void LruPushFront(TextLayoutCache *pCache, DWORD index)
+{
+    TextCacheEntry *pEntry = &pCache->entries[index];
+
+    pEntry->lruPrev = TEXTCACHE_NIL;
+    pEntry->lruNext = pCache->lruHead;
+    if (pCache->lruHead != TEXTCACHE_NIL)
+        pCache->entries[pCache->lruHead].lruPrev = index;
+    pCache->lruHead = index;
+    if (pCache->lruTail == TEXTCACHE_NIL)
+        pCache->lruTail = index;
+}
+
+static void BucketRemove(TextLayoutCache *pCache, DWORD index)
+{
+    DWORD *pLink = &pCache->buckets[pCache->entries[index].hash & pCache->bucketMask];
+
+    while (*pLink != TEXTCACHE_NIL)
+    {
+        if (*pLink == index)
+        {
+            *pLink = pCache->entries[index].nextInBucket;
+            return;
+        }
+        pLink = &pCache->entries[*pLink].nextInBucket;
+    }
+}
+
+static DWORD HashKey(DWORD keyHash, DWORD fontId, DWORD maxWidth)
+{
+    return D2_HashDword(keyHash ^ (fontId * 0x9E3779B9u) ^ (maxWidth * 0x85EBCA6Bu));
+}
+
+static DWORD HashText(const D2UNICHAR *pText, DWORD *pLength)
+{
+    DWORD hash = 2166136261u; // FNV-1a
+    DWORD length = 0;
+
+    while (pText[length] && length < TEXT_MAX_LENGTH)
+    {
+        hash = (hash ^ pText[length]) * 16777619u;
+        length++;
+    }
+
+    *pLength = length;
+    return hash;
+}
+
+/*
+ * AcquireEntry
+ * Take a free entry, or recycle the least recently used one. Recycled
+ * entries keep their quad/text buffers so steady-state churn never mallocs.
+ */
+static DWORD AcquireEntry(TextLayoutCache *pCache)
+{
+    DWORD index;
+
+    if (pCache->count < pCache->capacity)
+    {
+        index = pCache->count++;
+    }
+    else
+    {
+        index = pCache->lruTail;
+        LruUnlink(pCache, index);
+        BucketRemove(pCache, index);
+        pCache->stats.evictions++;
+    }
+    return index;
+}
+
+static const TextLayout *LookupOrBuild(TextLayoutCache *pCache, BOOL isText, DWORD stringId,
+                                       const D2UNICHAR *pText, DWORD textLength, DWORD keyHash,
+                                       DWORD fontId, DWORD maxWidth)
+{
+    DWORD hash = HashKey(keyHash, fontId, maxWidth) ^ (DWORD)isText;
+    DWORD generation = isText ? 0 : GetGeneration(pCache, stringId);
+    DWORD index = pCache->buckets[hash & pCache->bucketMask];
+
+    while (index != TEXTCACHE_NIL)
+    {
+        TextCacheEntry *pEntry = &pCache->entries[index];
+        if (pEntry->hash == hash && pEntry->isText == isText && pEntry->fontId == fontId &&
+            pEntry->maxWidth == maxWidth &&
+            (isText ? (pEntry->textLength == textLength &&
+                       memcmp(pEntry->text, pText, textLength * sizeof(D2UNICHAR)) == 0)
+                    : pEntry->stringId == stringId))
+        {
+            break;
+        }
+        index = pEntry->nextInBucket;
+    }
+
+    TextCacheEntry *pEntry;
+    if (index != TEXTCACHE_NIL)
+    {
+        pEntry = &pCache->entries[index];
+        LruUnlink(pCache, index);
+        LruPushFront(pCache, index);
+
+        if (pEntry->epoch == pCache->globalEpoch && pEntry->generation == generation &&
+            pEntry->layout.atlasEpoch == pCache->pAtlas->epoch)
+        {
+            pCache->stats.hits++;
+            return &pEntry->layout;
+        }
+        pCache->stats.rebuilds++;
+    }
+    else
+    {
+        index = AcquireEntry(pCache);
+        pEntry = &pCache->entries[index];
+
+        pEntry->hash = hash;
+        pEntry->isText = isText;
+        pEntry->stringId = stringId;
+        pEntry->fontId = fontId;
+        pEntry->maxWidth = maxWidth;
+        pEntry->textLength = 0;
+        pEntry->epoch = 0;
+
+        pEntry->nextInBucket = pCache->buckets[hash & pCache->bucketMask];
+        pCache->buckets[hash & pCache->bucketMask] = index;
+        LruPushFront(pCache, index);
+
+        if (isText)
+        {
+            if (pEntry->textCapacity < textLength)
+            {
+                D2UNICHAR *pCopy = (D2UNICHAR *)realloc(pEntry->text, textLength * sizeof(D2UNICHAR));
+                if (!pCopy)
+                {
+                    pEntry->textLength = TEXTCACHE_NIL; // Never matches; recycled by LRU
+                    return NULL;
+                }
+                pEntry->text = pCopy;
+                pEntry->textCapacity = textLength;
+            }
+            memcpy(pEntry->text, pText, textLength * sizeof(D2UNICHAR));
+            pEntry->textLength = textLength;
+        }
+    }
+
+    pCache->stats.misses++;
+
+    if (!isText)
+    {
+        pText = pCache->pfnGetString ? pCache->pfnGetString(pCache->pUserData, stringId) : NULL;
+    }
+
+    if (!TEXTLAYOUT_Build(pCache->pAtlas, pText, fontId, maxWidth, &pEntry->layout))
+    {
+        pEntry->epoch = 0; // Force a retry on the next lookup
+        return NULL;
+    }
+
+    pEntry->epoch = pCache->globalEpoch;
+    pEntry->generation = generation;
+    return &pEntry->layout;
+}
+
+const TextLayout *__cdecl TEXTLAYOUT_GetString(TextLayoutCache *pCache, DWORD stringId,
+                                               DWORD fontId, DWORD maxWidth)
+{
+    return LookupOrBuild(pCache, FALSE, stringId, NULL, 0, stringId, fontId, maxWidth);
+}
+
+const TextLayout *__cdecl TEXTLAYOUT_GetText(TextLayoutCache *pCache, const D2UNICHAR *pText,
+                                             DWORD fontId, DWORD maxWidth)
+{
+    if (!pText)
+    {
+        return NULL;
+    }
+
+    DWORD length;
+    DWORD keyHash = HashText(pText, &length);
+    return LookupOrBuild(pCache, TRUE, 0, pText, length, keyHash, fontId, maxWidth);
+}
+
+// =============================================================================
+// BATCHED DRAWING
+// =============================================================================
+
+BOOL __cdecl TEXTLAYOUT_InitBatch(TextBatch *pBatch, DWORD capacity)
+{
+    memset(pBatch, 0, sizeof(TextBatch));
+    if (capacity == 0)
+    {
+        capacity = 256;
+    }
+
+    pBatch->quads = (TextQuad *)malloc(capacity * sizeof(TextQuad));
+    if (!pBatch->quads)
+    {
+        return FALSE;
+    }
+    pBatch->capacity = capacity;
+    return TRUE;
+}
+
+void __cdecl TEXTLAYOUT_FreeBatch(TextBatch *pBatch)
+{
+    free(pBatch->quads);
+    memset(pBatch, 0, sizeof(TextBatch));
+}
+
+void __cdecl TEXTLAYOUT_ResetBatch(TextBatch *pBatch)
+{
+    pBatch->count = 0;
+    pBatch->atlasEpoch = 0;
+}
+
+BOOL __cdecl TEXTLAYOUT_AddToBatch(TextBatch *pBatch, const TextLayout *pLayout, int x, int y, BYTE color)
+{
+    if (!pLayout)
+    {
+        return FALSE;
+    }
+
+    DWORD needed = pBatch->count + pLayout->quadCount;
+    if (needed > pBatch->capacity)
+    {
+        DWORD newCapacity = pBatch->capacity ? pBatch->capacity : 256;
+        while (newCapacity < needed)
+        {
+            newCapacity *= 2;
+        }
+        TextQuad *pQuads = (TextQuad *)realloc(pBatch->quads, newCapacity * sizeof(TextQuad));
+        if (!pQuads)
+        {
+            return FALSE;
+        }
+        pBatch->quads = pQuads;
+        pBatch->capacity = newCapacity;
+    }
+
+    // Quads resolved against different atlas epochs cannot all be current
+    if (pLayout->quadCount && pBatch->count == 0)
+    {
+        pBatch->atlasEpoch = pLayout->atlasEpoch;
+    }
+    else if (pLayout->quadCount && pLayout->atlasEpoch != pBatch->atlasEpoch)
+    {
+        pBatch->atlasEpoch = 0;
+    }
+
+    TextQuad *pOut = pBatch->quads + pBatch->count;
+    memcpy(pOut, pLayout->quads, pLayout->quadCount * sizeof(TextQuad));
+    for (DWORD i = 0; i < pLayout->quadCount; i++)
+    {
+        pOut[i].dstX = (short)(pOut[i].dstX + x);
+        pOut[i].dstY = (short)(pOut[i].dstY + y);
+        if (pOut[i].color == TEXT_COLOR_DEFAULT)
+        {
+            pOut[i].color = color;
+        }
+    }
+
+    pBatch->count = needed;
+    return TRUE;
+}
+
+/*
+ * BlitRowCopy
+ * Transparent copy of one glyph row (index 0 keeps the destination)
+ */
+static void BlitRowCopy(BYTE *pDst, const BYTE *pSrc, DWORD width)
+{
+    DWORD i = 0;
+
+#if D2_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= width; i += 16)
+    {
+        __m128i src = _mm_loadu_si128((const __m128i *)(pSrc + i));
+        __m128i dst = _mm_loadu_si128((const __m128i *)(pDst + i));
+        __m128i transparent = _mm_cmpeq_epi8(src, zero);
+        __m128i out = _mm_or_si128(_mm_and_si128(transparent, dst), _mm_andnot_si128(transparent, src));
+        _mm_storeu_si128((__m128i *)(pDst + i), out);
+    }
+#endif
+
+    for (; i < width; i++)
+    {
+        if (pSrc[i])
+        {
+            pDst[i] = pSrc[i];
+        }
+    }
+}
+
+static void BlitRowRemap(BYTE *pDst, const BYTE *pSrc, DWORD width, const BYTE *pRemap)
+{
+    for (DWORD i = 0; i < width; i++)
+    {
+        BYTE s = pSrc[i];
+        if (s)
+        {
+            pDst[i] = pRemap[s];
+        }
+    }
+}
+
+BOOL __cdecl TEXTLAYOUT_FlushBatch(TextBatch *pBatch, const GlyphAtlas *pAtlas, TextSurface *pSurface,
+                                   const BYTE (*pColorRemaps)[256])
+{
+    if (pBatch->count && pBatch->atlasEpoch != pAtlas->epoch)
+    {
+        TEXTLAYOUT_ResetBatch(pBatch);
+        return FALSE;
+    }
+
+    for (DWORD q = 0; q < pBatch->count; q++)
+    {
+        const TextQuad *pQuad = &pBatch->quads[q];
+
+        int x0 = pQuad->dstX;
+        int y0 = pQuad->dstY;
+        int x1 = x0 + pQuad->width;
+        int y1 = y0 + pQuad->height;
+        int srcX = pQuad->srcX;
+        int srcY = pQuad->srcY;
+
+        if (x0 < 0)
+        {
+            srcX -= x0;
+            x0 = 0;
+        }
+        if (y0 < 0)
+        {
+            srcY -= y0;
+            y0 = 0;
+        }
+        if (x1 > (int)pSurface->width)
+            x1 = (int)pSurface->width;
+        if (y1 > (int)pSurface->height)
+            y1 = (int)pSurface->height;
+        if (x0 >= x1 || y0 >= y1)
+        {
+            continue;
+        }
+
+        DWORD width = (DWORD)(x1 - x0);
+        const BYTE *pSrc = pAtlas->pixels + (size_t)srcY * pAtlas->width + srcX;
+        BYTE *pDst = pSurface->pixels + (size_t)y0 * pSurface->pitch + x0;
+        const BYTE *pRemap = (pColorRemaps && pQuad->color < TEXT_COLOR_COUNT) ? pColorRemaps[pQuad->color] : NULL;
+
+        for (int row = y0; row < y1; row++)
+        {
+            if (pRemap)
+                BlitRowRemap(pDst, pSrc, width, pRemap);
+            else
+                BlitRowCopy(pDst, pSrc, width);
+
+            pSrc += pAtlas->width;
+            pDst += pSurface->pitch;
+        }
+    }
+
+    TEXTLAYOUT_ResetBatch(pBatch);
+    return TRUE;
+}
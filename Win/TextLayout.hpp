@@ -0,0 +1,178 @@
+/*
+ * TextLayout.hpp - D2Win cached text layout engine
+ * Original source: X:\trunk\Diablo2\Source\D2Win\Src\D2WinFont.cpp
+ *
+ * Replaces the per-frame measure-and-blit path (CalculateUITextWidth,
+ * TokenizeUnicodeStringImpl, MeasureAndRenderUnicodeText) for static UI text.
+ *
+ * A layout is the fully shaped form of one string in one font at one wrap
+ * width: word wrapping, color codes and per-glyph advances are resolved once
+ * into an array of atlas quads positioned relative to the text origin.
+ * Layouts are cached keyed by (string id, font, width) for D2Lang strings, or
+ * by content for composed text such as item tooltips.
+ *
+ * Drawing appends a layout's quads to a batch (a memcpy plus origin offset);
+ * the batch is blitted to the target surface in a single pass per frame.
+ *
+ * Invalidation is incremental: changing a string bumps that string's
+ * generation so only its layouts are rebuilt, lazily, the next time they are
+ * drawn. An atlas reset or language switch bumps a global epoch instead.
+ */
+
+#ifndef TEXTLAYOUT_HPP
+#define TEXTLAYOUT_HPP
+
+#include "GlyphAtlas.hpp"
+
+// D2 inline color code: 0xFF 'c' <code>, e.g. "\xFFc4" = gold
+#define TEXT_COLOR_ESCAPE 0xFF
+#define TEXT_COLOR_COUNT 13
+#define TEXT_COLOR_DEFAULT 0xFF // Quad uses the color passed at draw time
+
+// Maximum text length accepted for a single layout
+#define TEXT_MAX_LENGTH 4096
+
+// One blit from the atlas to the destination (12 bytes)
+typedef struct TextQuad
+{
+    short dstX; // Relative to layout origin until added to a batch
+    short dstY;
+    WORD srcX;
+    WORD srcY;
+    BYTE width;
+    BYTE height;
+    BYTE color; // TEXT_COLOR_DEFAULT or 0..TEXT_COLOR_COUNT-1
+    BYTE reserved;
+} TextQuad;
+
+typedef struct TextLayout
+{
+    TextQuad *quads;
+    DWORD quadCount;
+    DWORD quadCapacity;
+
+    WORD *lineWidths;
+    DWORD lineCount;
+    DWORD lineCapacity;
+
+    WORD width; // Widest line in pixels
+    WORD height;
+    DWORD atlasEpoch; // GlyphAtlas epoch the quads were resolved against
+} TextLayout;
+
+// D2Lang string lookup (GetStringById). Returns a NUL-terminated UCS-2 string.
+typedef const D2UNICHAR *(__cdecl *PFN_GetStringById)(void *pUserData, DWORD stringId);
+
+typedef struct TextCacheEntry TextCacheEntry;
+
+typedef struct TextLayoutStats
+{
+    DWORD hits;
+    DWORD misses;
+    DWORD rebuilds; // Misses caused by invalidation rather than first use
+    DWORD evictions;
+} TextLayoutStats;
+
+typedef struct TextLayoutCache
+{
+    GlyphAtlas *pAtlas;
+    PFN_GetStringById pfnGetString;
+    void *pUserData;
+
+    TextCacheEntry *entries;
+    DWORD capacity;
+    DWORD count;
+    DWORD *buckets; // Head entry index per bucket, TEXTCACHE_NIL if empty
+    DWORD bucketMask;
+    DWORD lruHead; // Most recently used
+    DWORD lruTail; // Eviction candidate
+
+    // Per-string generation counters (open addressing, stringId -> gen)
+    DWORD *genKeys;
+    DWORD *genValues;
+    DWORD genMask;
+    DWORD genCount;
+    DWORD globalEpoch;
+
+    TextLayoutStats stats;
+} TextLayoutCache;
+
+// Destination surface for batched blits (8-bit palette indices)
+typedef struct TextSurface
+{
+    BYTE *pixels;
+    DWORD pitch;
+    DWORD width;
+    DWORD height;
+} TextSurface;
+
+typedef struct TextBatch
+{
+    TextQuad *quads;
+    DWORD count;
+    DWORD capacity;
+    DWORD atlasEpoch; // Epoch of the quads in the batch; 0 once layouts of different epochs were mixed
+} TextBatch;
+
+// =============================================================================
+// LAYOUT
+// =============================================================================
+
+/*
+ * Shape text into a caller-owned layout (no caching). maxWidth == 0 disables
+ * wrapping; explicit '\n' always breaks. Returns FALSE on allocation failure
+ * or if the font is not registered.
+ */
+BOOL __cdecl TEXTLAYOUT_Build(GlyphAtlas *pAtlas, const D2UNICHAR *pText, DWORD fontId,
+                              DWORD maxWidth, TextLayout *pLayout);
+void __cdecl TEXTLAYOUT_Free(TextLayout *pLayout);
+
+// =============================================================================
+// CACHE
+// =============================================================================
+
+BOOL __cdecl TEXTLAYOUT_InitCache(TextLayoutCache *pCache, GlyphAtlas *pAtlas, DWORD capacity,
+                                  PFN_GetStringById pfnGetString, void *pUserData);
+void __cdecl TEXTLAYOUT_FreeCache(TextLayoutCache *pCache);
+
+/*
+ * Cached lookups. The returned layout stays valid until the next call into
+ * the cache (it may be evicted or rebuilt by a later lookup), so draw it into
+ * a batch before looking up the next one. A lookup that fills the atlas
+ * resets it, which leaves quads already in a batch pointing at repacked
+ * pixels; TEXTLAYOUT_FlushBatch detects that and asks for the batch again.
+ */
+const TextLayout *__cdecl TEXTLAYOUT_GetString(TextLayoutCache *pCache, DWORD stringId,
+                                               DWORD fontId, DWORD maxWidth);
+const TextLayout *__cdecl TEXTLAYOUT_GetText(TextLayoutCache *pCache, const D2UNICHAR *pText,
+                                             DWORD fontId, DWORD maxWidth);
+
+// String table entry changed: only layouts of this string are rebuilt
+void __cdecl TEXTLAYOUT_InvalidateString(TextLayoutCache *pCache, DWORD stringId);
+// Language switch / font reload: every layout is rebuilt on next use
+void __cdecl TEXTLAYOUT_InvalidateAll(TextLayoutCache *pCache);
+
+// =============================================================================
+// BATCHED DRAWING
+// =============================================================================
+
+BOOL __cdecl TEXTLAYOUT_InitBatch(TextBatch *pBatch, DWORD capacity);
+void __cdecl TEXTLAYOUT_FreeBatch(TextBatch *pBatch);
+void __cdecl TEXTLAYOUT_ResetBatch(TextBatch *pBatch);
+
+BOOL __cdecl TEXTLAYOUT_AddToBatch(TextBatch *pBatch, const TextLayout *pLayout, int x, int y, BYTE color);
+
+/*
+ * Blit every quad in the batch, clipped to the surface. Source index 0 is
+ * transparent. Non-zero source pixels are written through
+ * pColorRemaps[quad color] when provided, or copied unchanged otherwise.
+ * The batch is reset afterwards.
+ *
+ * Returns FALSE without drawing anything when the atlas was reset after
+ * some of the quads were resolved: refill the batch (the lookups now pack
+ * into the fresh atlas) and flush again.
+ */
+BOOL __cdecl TEXTLAYOUT_FlushBatch(TextBatch *pBatch, const GlyphAtlas *pAtlas, TextSurface *pSurface,
+                                   const BYTE (*pColorRemaps)[256]);
+
+#endif // TEXTLAYOUT_HPP